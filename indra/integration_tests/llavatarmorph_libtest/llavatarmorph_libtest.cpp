@@ -0,0 +1,533 @@
+/**
+ * @file llavatarmorph_libtest.cpp
+ * @brief Headless benchmark of avatar morph target application
+ *
+ * Usage: llavatarmorph_libtest <character dir> [param sets] [avatars] [workers]
+ *
+ * Loads the morph target params of avatar_lad.xml and the base meshes and
+ * morph targets of the .llm files they apply to from character dir (the
+ * viewer's newview/character), then applies param sets (default 200) of
+ * random weights to them:
+ *  - a morph at a time, renormalizing after each, like the viewer used to
+ *  - all the morphs of a set then renormalizing once, a float at a time
+ *  - the same with LLMorphAccumulator's vectorized code
+ * and reports the milliseconds per param set of each.
+ *
+ * Then applies the param sets to avatars (default 20) at once, on the main
+ * thread and as a job per mesh on an LLThreadPool of workers (default one
+ * per core), and reports the milliseconds per avatar param set of both.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "apr_atomic.h"
+#include "llcommon.h"
+#include "llendianswizzle.h"
+#include "llerrorcontrol.h"
+#include "llmorphaccumulator.h"
+#include "llthread.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+#include "llxmltree.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#include "../test/lltestrand.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+// As in LLPolyMorphTarget
+const F32 NORMAL_SOFTEN_FACTOR = 0.65f;
+
+// Floats per vertex of the vertex data of a mesh, laid out like
+// LLPolyMesh's: coords, normals, scaled normals, binormals, scaled
+// binormals, tex coords, clothing weights
+const S32 VERTEX_DATA_FLOATS = 21;
+
+struct BenchMorph
+{
+	std::string mName;
+	std::vector<U32> mVertexIndices;
+	std::vector<LLVector3> mCoords;
+	std::vector<LLVector3> mNormals;
+	std::vector<LLVector3> mBinormals;
+	std::vector<LLVector2> mTexCoords;
+};
+
+struct BenchMesh
+{
+	std::string mFileName;
+	S32 mNumVertices;
+	std::vector<F32> mBaseData;	// vertex data before any morph
+	std::vector<BenchMorph> mMorphs;
+};
+
+struct BenchParam
+{
+	S32 mMesh;
+	S32 mMorph;
+	F32 mMin;
+	F32 mMax;
+	BOOL mClothing;
+};
+
+typedef std::vector<BenchMesh> mesh_list_t;
+typedef std::vector<BenchParam> param_list_t;
+// weight deltas, per param, of each param set
+typedef std::vector<std::vector<F32> > param_set_list_t;
+
+static LLTestRand sRand;
+
+static bool read_floats(LLFILE* fp, F32* data, S32 count)
+{
+	if (fread(data, sizeof(F32), count, fp) != (size_t)count)
+	{
+		return false;
+	}
+	llendianswizzle(data, sizeof(F32), count);
+	return true;
+}
+
+// Reads the parts of a binary .llm file a reference mesh morphs, see
+// LLPolyMeshSharedData::loadMesh()
+static bool load_mesh(const std::string& path, BenchMesh& mesh)
+{
+	LLFILE* fp = LLFile::fopen(path, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+
+	char header[24];
+	U8 has_weights = 0;
+	U8 has_detail_tex_coords = 0;
+	U16 num_vertices = 0;
+	bool ok = fread(header, 1, 24, fp) == 24 && !strncmp(header, "Linden Binary Mesh 1.0", 22)
+		&& fread(&has_weights, 1, 1, fp) == 1
+		&& fread(&has_detail_tex_coords, 1, 1, fp) == 1
+		&& !fseek(fp, 4 * 3 + 4 * 3 + 1 + 4 * 3, SEEK_CUR)	// position, rotation, order, scale
+		&& fread(&num_vertices, 2, 1, fp) == 1;
+	llendianswizzle(&num_vertices, sizeof(U16), 1);
+
+	const S32 nverts = num_vertices;
+	mesh.mNumVertices = nverts;
+	mesh.mBaseData.assign(nverts * VERTEX_DATA_FLOATS, 0.f);
+	F32* data = &mesh.mBaseData[0];
+	std::vector<F32> skipped(nverts * 2);
+	ok = ok && read_floats(fp, data, nverts * 3)						// coords
+		&& read_floats(fp, data + nverts * 3, nverts * 3)				// normals
+		&& read_floats(fp, data + nverts * 9, nverts * 3)				// binormals
+		&& read_floats(fp, data + nverts * 15, nverts * 2)				// tex coords
+		&& (!has_detail_tex_coords || read_floats(fp, &skipped[0], nverts * 2))
+		&& (!has_weights || read_floats(fp, &skipped[0], nverts));
+	if (ok)
+	{
+		// scaled normals and binormals start as the normals and binormals
+		memcpy(data + nverts * 6, data + nverts * 3, sizeof(F32) * nverts * 3);
+		memcpy(data + nverts * 12, data + nverts * 9, sizeof(F32) * nverts * 3);
+	}
+
+	U16 num_faces = 0;
+	U16 num_joints = 0;
+	ok = ok && fread(&num_faces, 2, 1, fp) == 1;
+	llendianswizzle(&num_faces, sizeof(U16), 1);
+	ok = ok && !fseek(fp, num_faces * 6, SEEK_CUR)
+		&& (!has_weights || fread(&num_joints, 2, 1, fp) == 1);
+	llendianswizzle(&num_joints, sizeof(U16), 1);
+	ok = ok && !fseek(fp, num_joints * 64, SEEK_CUR);
+
+	char name[65];
+	name[64] = '\0';
+	while (ok && fread(name, 1, 64, fp) == 64 && strcmp(name, "End Morphs"))
+	{
+		S32 count = 0;
+		ok = fread(&count, sizeof(S32), 1, fp) == 1;
+		llendianswizzle(&count, sizeof(S32), 1);
+		BenchMorph morph;
+		morph.mName = name;
+		for (S32 i = 0; ok && i < count; i++)
+		{
+			U32 index;
+			F32 v[11];
+			ok = fread(&index, sizeof(U32), 1, fp) == 1 && read_floats(fp, v, 11);
+			llendianswizzle(&index, sizeof(U32), 1);
+			ok = ok && index < (U32)nverts;
+			morph.mVertexIndices.push_back(index);
+			morph.mCoords.push_back(LLVector3(v));
+			morph.mNormals.push_back(LLVector3(v + 3));
+			morph.mBinormals.push_back(LLVector3(v + 6));
+			morph.mTexCoords.push_back(LLVector2(v + 9));
+		}
+		mesh.mMorphs.push_back(morph);
+	}
+	fclose(fp);
+	return ok;
+}
+
+// Reads the morph target params of the reference meshes of avatar_lad.xml
+static bool load_params(const std::string& dir, mesh_list_t& meshes, param_list_t& params)
+{
+	LLXmlTree tree;
+	if (!tree.parseFile(dir + "/avatar_lad.xml", FALSE))
+	{
+		std::cerr << "can't parse " << dir << "/avatar_lad.xml" << std::endl;
+		return false;
+	}
+
+	static LLStdStringHandle file_name_string = LLXmlTree::addAttributeString("file_name");
+	static LLStdStringHandle reference_string = LLXmlTree::addAttributeString("reference");
+	static LLStdStringHandle name_string = LLXmlTree::addAttributeString("name");
+	static LLStdStringHandle value_min_string = LLXmlTree::addAttributeString("value_min");
+	static LLStdStringHandle value_max_string = LLXmlTree::addAttributeString("value_max");
+	static LLStdStringHandle clothing_morph_string = LLXmlTree::addAttributeString("clothing_morph");
+
+	LLXmlTreeNode* root = tree.getRoot();
+	for (LLXmlTreeNode* mesh_node = root->getChildByName("mesh"); mesh_node; mesh_node = root->getNextNamedChild())
+	{
+		std::string file_name;
+		std::string reference;
+		if (!mesh_node->getFastAttributeString(file_name_string, file_name)
+			|| mesh_node->getFastAttributeString(reference_string, reference))
+		{
+			// LODs share the vertices of their reference mesh
+			continue;
+		}
+
+		BenchMesh mesh;
+		mesh.mFileName = file_name;
+		if (!load_mesh(dir + "/" + file_name, mesh))
+		{
+			std::cerr << "can't load " << file_name << std::endl;
+			return false;
+		}
+		meshes.push_back(mesh);
+
+		for (LLXmlTreeNode* param_node = mesh_node->getChildByName("param"); param_node; param_node = mesh_node->getNextNamedChild())
+		{
+			std::string name;
+			if (!param_node->getChildByName("param_morph") || !param_node->getFastAttributeString(name_string, name))
+			{
+				continue;
+			}
+			BenchParam param;
+			param.mMesh = (S32)meshes.size() - 1;
+			param.mMorph = -1;
+			for (S32 i = 0; i < (S32)mesh.mMorphs.size(); i++)
+			{
+				if (mesh.mMorphs[i].mName == name)
+				{
+					param.mMorph = i;
+				}
+			}
+			if (param.mMorph < 0)
+			{
+				continue;
+			}
+			param.mMin = 0.f;
+			param.mMax = 1.f;
+			param.mClothing = FALSE;
+			param_node->getFastAttributeF32(value_min_string, param.mMin);
+			param_node->getFastAttributeF32(value_max_string, param.mMax);
+			param_node->getFastAttributeBOOL(clothing_morph_string, param.mClothing);
+			params.push_back(param);
+		}
+	}
+	return true;
+}
+
+// Random weights for every param, as the weight deltas of each set
+static void make_param_sets(const param_list_t& params, S32 count, param_set_list_t& sets)
+{
+	std::vector<F32> weights(params.size(), 0.f);
+	sets.resize(count);
+	for (S32 i = 0; i < count; i++)
+	{
+		sets[i].resize(params.size());
+		for (U32 p = 0; p < params.size(); p++)
+		{
+			F32 weight = params[p].mMin + sRand.frand(0.f, 1.f) * (params[p].mMax - params[p].mMin);
+			sets[i][p] = weight - weights[p];
+			weights[p] = weight;
+		}
+	}
+}
+
+// The vertices of one mesh of an avatar
+class BenchMeshInstance
+{
+public:
+	BenchMeshInstance(const BenchMesh* mesh)
+	:	mMesh(mesh),
+		mData(mesh->mBaseData),
+		mMorphData(mesh->mBaseData.size())
+	{
+		apr_atomic_set32(&mDone, 1);
+	}
+
+	LLMorphAccumulator* newAccumulator(F32* data)
+	{
+		const S32 n = mMesh->mNumVertices;
+		return new LLMorphAccumulator(n, (LLVector3*)data, (LLVector3*)(data + n * 3), (LLVector3*)(data + n * 6),
+									  (LLVector3*)(data + n * 9), (LLVector3*)(data + n * 12),
+									  (LLVector2*)(data + n * 15), (LLVector4*)(data + n * 17));
+	}
+
+	void addMorph(LLMorphAccumulator* accumulator, S32 morph_index, F32 weight, BOOL clothing, bool reference)
+	{
+		const BenchMorph& morph = mMesh->mMorphs[morph_index];
+		if (reference)
+		{
+			accumulator->addMorphReference(morph.mVertexIndices.size(), &morph.mVertexIndices[0],
+										   &morph.mCoords[0], &morph.mNormals[0], &morph.mBinormals[0],
+										   &morph.mTexCoords[0], NULL, weight, NORMAL_SOFTEN_FACTOR, clothing);
+		}
+		else
+		{
+			accumulator->addMorph(morph.mVertexIndices.size(), &morph.mVertexIndices[0],
+								  &morph.mCoords[0], &morph.mNormals[0], &morph.mBinormals[0],
+								  &morph.mTexCoords[0], NULL, weight, NORMAL_SOFTEN_FACTOR, clothing);
+		}
+	}
+
+	// What a morph job does: copy the vertices, add the morphs, normalize
+	void runJob()
+	{
+		memcpy(&mMorphData[0], &mData[0], sizeof(F32) * mData.size());
+		LLMorphAccumulator* accumulator = newAccumulator(&mMorphData[0]);
+		for (U32 i = 0; i < mPending.size(); i++)
+		{
+			addMorph(accumulator, mPending[i].first, mPending[i].second, FALSE, false);
+		}
+		accumulator->normalize();
+		delete accumulator;
+		mPending.clear();
+		// Full barrier, publishes the vertices to the main thread
+		apr_atomic_xchg32(&mDone, 1);
+	}
+
+	void swap()
+	{
+		mData.swap(mMorphData);
+	}
+
+	const BenchMesh* mMesh;
+	std::vector<F32> mData;
+	std::vector<F32> mMorphData;
+	std::vector<std::pair<S32, F32> > mPending;	// morph and weight delta
+	volatile apr_uint32_t mDone;
+};
+
+class BenchMorphTask : public LLThreadPool::Task
+{
+public:
+	BenchMorphTask(BenchMeshInstance* instance) : mInstance(instance) {}
+	/*virtual*/ void executeTask()
+	{
+		mInstance->runJob();
+		delete this;
+	}
+private:
+	BenchMeshInstance* mInstance;
+};
+
+static void report(const char* test, F64 elapsed, S32 count)
+{
+	std::cout << test << ": " << elapsed * 1000.0 / llmax(count, 1) << " ms" << std::endl;
+}
+
+static F32 checksum(const std::vector<BenchMeshInstance*>& instances)
+{
+	F64 sum = 0.0;
+	for (U32 i = 0; i < instances.size(); i++)
+	{
+		const std::vector<F32>& data = instances[i]->mData;
+		for (U32 j = 0; j < data.size(); j++)
+		{
+			sum += data[j];
+		}
+	}
+	return (F32)sum;
+}
+
+// A mesh instance per mesh, for each of num_avatars avatars
+static void make_avatars(const mesh_list_t& meshes, S32 num_avatars, std::vector<BenchMeshInstance*>& instances)
+{
+	for (S32 a = 0; a < num_avatars; a++)
+	{
+		for (U32 m = 0; m < meshes.size(); m++)
+		{
+			instances.push_back(new BenchMeshInstance(&meshes[m]));
+		}
+	}
+}
+
+static void delete_avatars(std::vector<BenchMeshInstance*>& instances)
+{
+	for (U32 i = 0; i < instances.size(); i++)
+	{
+		delete instances[i];
+	}
+	instances.clear();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <character dir> [param sets] [avatars] [workers]" << std::endl;
+		return 1;
+	}
+	const S32 num_sets = argc > 2 ? llmax(atoi(argv[2]), 1) : 200;
+	const S32 num_avatars = argc > 3 ? llmax(atoi(argv[3]), 1) : 20;
+	const S32 num_workers = argc > 4 ? llmax(atoi(argv[4]), 1) : 0;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	mesh_list_t meshes;
+	param_list_t params;
+	if (!load_params(argv[1], meshes, params))
+	{
+		return 1;
+	}
+	param_set_list_t sets;
+	make_param_sets(params, num_sets, sets);
+
+	S32 num_morph_vertices = 0;
+	for (U32 p = 0; p < params.size(); p++)
+	{
+		num_morph_vertices += meshes[params[p].mMesh].mMorphs[params[p].mMorph].mVertexIndices.size();
+	}
+	std::cout << params.size() << " morph params on " << meshes.size() << " meshes, "
+			  << num_morph_vertices << " morph vertices, " << num_sets << " param sets" << std::endl;
+
+	// One avatar, on the main thread
+	F32 sums[3];
+	for (S32 mode = 0; mode < 3; mode++)
+	{
+		std::vector<BenchMeshInstance*> instances;
+		make_avatars(meshes, 1, instances);
+		std::vector<LLMorphAccumulator*> accumulators;
+		for (U32 m = 0; m < instances.size(); m++)
+		{
+			accumulators.push_back(instances[m]->newAccumulator(&instances[m]->mData[0]));
+		}
+
+		LLTimer timer;
+		for (S32 s = 0; s < num_sets; s++)
+		{
+			for (U32 p = 0; p < params.size(); p++)
+			{
+				const BenchParam& param = params[p];
+				LLMorphAccumulator* accumulator = accumulators[param.mMesh];
+				if (mode == 0)
+				{
+					instances[param.mMesh]->addMorph(accumulator, param.mMorph, sets[s][p], param.mClothing, true);
+					accumulator->normalizeReference();
+				}
+				else
+				{
+					instances[param.mMesh]->addMorph(accumulator, param.mMorph, sets[s][p], param.mClothing, mode == 1);
+				}
+			}
+			for (U32 m = 0; m < instances.size(); m++)
+			{
+				if (mode == 1)
+				{
+					accumulators[m]->normalizeReference();
+				}
+				else if (mode == 2)
+				{
+					accumulators[m]->normalize();
+				}
+			}
+		}
+		static const char* names[] = { "a morph at a time", "batched, reference", "batched, vectorized" };
+		report(names[mode], timer.getElapsedTimeF64(), num_sets);
+		sums[mode] = checksum(instances);
+
+		for (U32 m = 0; m < accumulators.size(); m++)
+		{
+			delete accumulators[m];
+		}
+		delete_avatars(instances);
+	}
+	if (fabs(sums[0] - sums[2]) > 0.001f * fabs(sums[0]) || fabs(sums[1] - sums[2]) > 0.001f * fabs(sums[0]))
+	{
+		std::cerr << "vertices differ: " << sums[0] << " " << sums[1] << " " << sums[2] << std::endl;
+	}
+
+	// Many avatars, on the main thread then on the pool
+	LLThreadPool pool("Morph", num_workers);
+	std::cout << num_avatars << " avatars, " << pool.getNumWorkers() << " workers" << std::endl;
+	for (S32 threaded = 0; threaded < 2; threaded++)
+	{
+		std::vector<BenchMeshInstance*> instances;
+		make_avatars(meshes, num_avatars, instances);
+
+		LLTimer timer;
+		for (S32 s = 0; s < num_sets; s++)
+		{
+			for (S32 a = 0; a < num_avatars; a++)
+			{
+				for (U32 p = 0; p < params.size(); p++)
+				{
+					const BenchParam& param = params[p];
+					instances[a * meshes.size() + param.mMesh]->mPending.push_back(std::make_pair(param.mMorph, sets[s][p]));
+				}
+			}
+			for (U32 i = 0; i < instances.size(); i++)
+			{
+				if (threaded)
+				{
+					apr_atomic_set32(&instances[i]->mDone, 0);
+					pool.post(new BenchMorphTask(instances[i]), LLThreadPool::CLASS_HIGH);
+				}
+				else
+				{
+					instances[i]->runJob();
+				}
+			}
+			for (U32 i = 0; i < instances.size(); i++)
+			{
+				while (!apr_atomic_read32(&instances[i]->mDone))
+				{
+					LLThread::yield();
+				}
+				instances[i]->swap();
+			}
+		}
+		report(threaded ? "per avatar, thread pool" : "per avatar, main thread",
+			   timer.getElapsedTimeF64(), num_sets * num_avatars);
+		delete_avatars(instances);
+	}
+	pool.shutdown();
+
+	LLCommon::cleanupClass();
+	return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file llfrustumcull_libtest.cpp
+ * @brief Headless benchmark of the batched LLCamera box tests
+ *
+ * Usage: llfrustumcull_libtest [boxes] [frames] [batch]
+ *
+ * Makes boxes (default 20000) of random sizes around a camera, most in
+ * front of it, then tests all of them against its frustum once a frame
+ * (default 200): with AABBInFrustumNoFarClip() a box at a time, and with
+ * each LLCamera batch variant this binary has and this CPU runs, batch
+ * boxes per call (default 8, about the children of an octree node, as
+ * LLSpatialPartition culling batches them). Reports the million boxes per
+ * second of each and whether its results are the scalar ones.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcamera.h"
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "llquaternion.h"
+#include "lltimer.h"
+#include "v3math.h"
+
+#include "../test/lltestrand.h"
+
+#include <iostream>
+#include <vector>
+
+static LLTestRand sRand;
+
+static LLVector3 bench_rand_vec(F32 range)
+{
+	F32 x = sRand.frand(-range, range);
+	F32 y = sRand.frand(-range, range);
+	F32 z = sRand.frand(-range, range);
+	return LLVector3(x, y, z);
+}
+
+// A camera looking somewhere, with its agent planes made the way
+// LLViewerCamera makes them, from the corners of its frustum
+static void aim_camera(LLCamera& camera)
+{
+	camera.setOrigin(bench_rand_vec(100.f));
+	camera.setAxes(LLQuaternion(sRand.frand(-F_PI, F_PI), bench_rand_vec(1.f)));
+
+	const F32 near_dist = 0.5f;
+	const F32 far_dist = 128.f;
+	const F32 tan_x = 0.8f;
+	const F32 tan_y = 0.6f;
+	// left bottom, right bottom, right top, left top, near then far
+	const F32 x[] = { -1.f, 1.f, 1.f, -1.f };
+	const F32 y[] = { -1.f, -1.f, 1.f, 1.f };
+	LLVector3 corners[8];
+	for (U32 i = 0; i < 8; i++)
+	{
+		F32 dist = i < 4 ? near_dist : far_dist;
+		corners[i] = camera.getOrigin()
+			+ camera.getAtAxis() * dist
+			- camera.getLeftAxis() * (x[i % 4] * tan_x * dist)
+			+ camera.getUpAxis() * (y[i % 4] * tan_y * dist);
+	}
+	camera.calcAgentFrustumPlanes(corners);
+}
+
+int main(int argc, char** argv)
+{
+	const U32 num_boxes = argc > 1 ? llmax(atoi(argv[1]), 1) : 20000;
+	const S32 num_frames = argc > 2 ? llmax(atoi(argv[2]), 1) : 200;
+	const U32 batch = argc > 3 ? llmax(atoi(argv[3]), 1) : 8;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	LLCamera camera;
+	aim_camera(camera);
+
+	// Each box on its own, the way spatial groups keep their bounds
+	std::vector<LLVector3*> boxes(num_boxes);
+	std::vector<const LLVector3*> bounds(num_boxes);
+	for (U32 i = 0; i < num_boxes; i++)
+	{
+		LLVector3 radius = bench_rand_vec(i % 8 ? 4.f : 32.f);
+		boxes[i] = new LLVector3[2];
+		boxes[i][0] = camera.getOrigin() + camera.getAtAxis() * sRand.frand(-20.f, 180.f) + bench_rand_vec(120.f);
+		boxes[i][1].setVec(fabsf(radius.mV[VX]), fabsf(radius.mV[VY]), fabsf(radius.mV[VZ]));
+		bounds[i] = boxes[i];
+	}
+	std::cout << num_boxes << " boxes, " << num_frames << " frames, batches of " << batch << std::endl;
+
+	std::vector<S32> reference(num_boxes);
+	S32 found[3] = { 0, 0, 0 };
+	const F64 total_boxes = (F64)num_boxes * num_frames;
+	LLTimer timer;
+	for (S32 frame = 0; frame < num_frames; frame++)
+	{
+		for (U32 i = 0; i < num_boxes; i++)
+		{
+			reference[i] = camera.AABBInFrustumNoFarClip(bounds[i][0], bounds[i][1]);
+		}
+	}
+	F64 elapsed = timer.getElapsedTimeF64();
+	for (U32 i = 0; i < num_boxes; i++)
+	{
+		found[reference[i]]++;
+	}
+	std::cout << "out " << found[0] << ", partly in " << found[1] << ", all in " << found[2] << std::endl;
+	std::cout << "scalar: " << total_boxes / llmax(elapsed, 0.000001) / 1000000.0 << " million boxes/s" << std::endl;
+
+	std::vector<S32> results(num_boxes);
+	for (S32 variant = 0; variant < LLCamera::VARIANT_COUNT; variant++)
+	{
+		LLCamera::EBatchVariant v = (LLCamera::EBatchVariant)variant;
+		if (!LLCamera::setBatchVariant(v))
+		{
+			std::cout << LLCamera::getBatchVariantName(v) << ": "
+					  << (LLCamera::isBatchVariantBuilt(v) ? "not supported by this CPU" : "not built") << std::endl;
+			continue;
+		}
+
+		timer.reset();
+		for (S32 frame = 0; frame < num_frames; frame++)
+		{
+			for (U32 i = 0; i < num_boxes; i += batch)
+			{
+				camera.AABBInFrustumBatch(&bounds[i], llmin(batch, num_boxes - i), &results[i], TRUE);
+			}
+		}
+		elapsed = timer.getElapsedTimeF64();
+
+		std::cout << LLCamera::getBatchVariantName(v) << ": "
+				  << total_boxes / llmax(elapsed, 0.000001) / 1000000.0 << " million boxes/s, "
+				  << (results == reference ? "same results" : "DIFFERENT RESULTS") << std::endl;
+	}
+	std::cout << "best: " << LLCamera::getBatchVariantName(LLCamera::getBestBatchVariant()) << std::endl;
+
+	for (U32 i = 0; i < num_boxes; i++)
+	{
+		delete [] boxes[i];
+	}
+	LLCommon::cleanupClass();
+	return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file llimage_libtest.cpp
+ * @brief Headless JPEG2000 decode benchmark for LLImageDecodeThread
+ *
+ * Usage: llimage_libtest <directory of .j2c files> [max decoders] [max discard level] [passes]
+ *
+ * Decodes every .j2c file of the directory at discard levels 0 to max discard
+ * level with 1, 2, 4... up to max decoders (default: one per CPU core) and
+ * reports the decoded images per second for each combination.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcommon.h"
+#include "lldir.h"
+#include "llerrorcontrol.h"
+#include "llimagej2c.h"
+#include "llimageworker.h"
+#include "lltimer.h"
+
+#include <iostream>
+#include <vector>
+
+// Counts the decodes of a run
+class BenchmarkResponder : public LLImageDecodeThread::Responder
+{
+public:
+	BenchmarkResponder(LLAtomicS32* completed, LLAtomicS32* failed)
+	:	mCompleted(completed),
+		mFailed(failed)
+	{
+	}
+
+	/*virtual*/ void completed(bool success, LLImageRaw* raw, LLImageRaw* aux)
+	{
+		if (!success)
+		{
+			(*mFailed)++;
+		}
+		(*mCompleted)++;
+	}
+
+private:
+	LLAtomicS32* mCompleted;
+	LLAtomicS32* mFailed;
+};
+
+// Loads every .j2c file of dirname
+static void load_images(const std::string& dirname, std::vector<LLPointer<LLImageJ2C> >& images)
+{
+	std::string dir = dirname;
+	if (dir.empty() || dir[dir.size() - 1] != gDirUtilp->getDirDelimiter()[0])
+	{
+		dir += gDirUtilp->getDirDelimiter();
+	}
+
+	std::string filename;
+	while (gDirUtilp->getNextFileInDir(dir, "*.j2c", filename))
+	{
+		LLPointer<LLImageJ2C> image = new LLImageJ2C;
+		if (image->load(dir + filename))
+		{
+			images.push_back(image);
+		}
+		else
+		{
+			llwarns << "Could not load " << dir + filename << ": " << LLImage::getLastError() << llendl;
+		}
+	}
+}
+
+// Decodes all the images once at discard, returns the elapsed time in seconds
+static F64 run_decodes(LLImageDecodeThread* decoder, std::vector<LLPointer<LLImageJ2C> >& images, S32 discard, S32& failed)
+{
+	LLAtomicS32 completed(0);
+	LLAtomicS32 failures(0);
+	const S32 count = (S32)images.size();
+
+	LLTimer timer;
+	for (S32 i = 0; i < count; i++)
+	{
+		// Spread the priorities, like the texture fetcher does
+		U32 priority = LLQueuedThread::PRIORITY_NORMAL | (i & LLQueuedThread::PRIORITY_LOWBITS);
+		decoder->decodeImage(images[i], priority, discard, FALSE, new BenchmarkResponder(&completed, &failures));
+	}
+	while (completed < count)
+	{
+		decoder->update(0);
+		ms_sleep(1);
+	}
+	F64 elapsed = timer.getElapsedTimeF64();
+
+	failed = failures;
+	return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <directory of .j2c files> [max decoders] [max discard level] [passes]" << std::endl;
+		return 1;
+	}
+	const std::string dirname = argv[1];
+	const U32 max_decoders = argc > 2 ? llmax(atoi(argv[2]), 1) : LLThreadPool::getNumCPUCores();
+	const S32 max_discard = argc > 3 ? llclamp(atoi(argv[3]), 0, 5) : 3;
+	const S32 passes = argc > 4 ? llmax(atoi(argv[4]), 1) : 3;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+	LLImage::initClass();
+
+	std::vector<LLPointer<LLImageJ2C> > images;
+	load_images(dirname, images);
+	if (images.empty())
+	{
+		std::cerr << "No .j2c file found in " << dirname << std::endl;
+		return 1;
+	}
+	std::cout << images.size() << " images, " << LLImageJ2C::getEngineInfo() << std::endl;
+
+	for (U32 num_decoders = 1; ; num_decoders = llmin(num_decoders * 2, max_decoders))
+	{
+		LLImageDecodeThread* decoder = new LLImageDecodeThread(true, NULL, num_decoders);
+		for (S32 discard = 0; discard <= max_discard; discard++)
+		{
+			F64 elapsed = 0.0;
+			S32 failed = 0;
+			for (S32 pass = 0; pass < passes; pass++)
+			{
+				elapsed += run_decodes(decoder, images, discard, failed);
+			}
+			F64 images_per_sec = (F64)(images.size() * passes) / llmax(elapsed, 0.000001);
+			std::cout << "decoders " << num_decoders << " discard " << discard << ": "
+					  << images_per_sec << " images/s";
+			if (failed)
+			{
+				std::cout << " (" << failed << " failed)";
+			}
+			std::cout << std::endl;
+		}
+		delete decoder;
+
+		if (num_decoders == max_decoders)
+		{
+			break;
+		}
+	}
+
+	images.clear();
+	LLImage::cleanupClass();
+	LLCommon::cleanupClass();
+	return 0;
+}
@@ -0,0 +1,629 @@
+/**
+ * @file llmessage_libtest.cpp
+ * @brief Headless packet capture replay benchmark for LLMessageSystem
+ *
+ * Usage: llmessage_libtest <capture.pcap> <message_template.msg> [max batch size] [passes] [source port]
+ *
+ * Reads the UDP payloads of a libpcap capture (only those sent from source
+ * port if given, 0 for all), sends them over the loopback interface to a
+ * message system in bursts and times how long the message system takes to
+ * read and decode them, receiving 1, 4, 16... up to max batch size (default
+ * 64) packets per system call. Reports the packets decoded per second for
+ * each batch size.
+ *
+ * Then decodes the same messages without the network, to time the template
+ * reader alone, reading no variable, every variable by name and every
+ * variable by LLMessageField, and times zero coding and expanding them a
+ * byte at a time and a run at a time.
+ *
+ * Last, the message system sends reliable messages to itself, dropping 0%,
+ * 5% and 20% of the packets it receives, acks included, and reports the
+ * time the circuit bookkeeping (sending, acking, resending and tracking
+ * lost and duplicate packets) takes per acked message.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "llhost.h"
+#include "llmessagetemplate.h"
+#include "llmessagetemplateparser.h"
+#include "lltemplatemessagereader.h"
+#include "lltimer.h"
+#include "llzerocode.h"
+#include "message.h"
+#include "net.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Packets sent before the message system reads them, small enough for
+// the default socket receive buffer
+const S32 BURST_PACKETS = 128;
+
+typedef std::vector<std::string> packet_list_t;
+
+// libpcap file format, see pcap-savefile(5)
+const U32 PCAP_MAGIC = 0xa1b2c3d4;
+const U32 PCAP_MAGIC_NANOSECONDS = 0xa1b23c4d;
+const U32 PCAP_LINKTYPE_NULL = 0;
+const U32 PCAP_LINKTYPE_ETHERNET = 1;
+const U32 PCAP_LINKTYPE_RAW = 101;
+const U32 PCAP_LINKTYPE_LINUX_SLL = 113;
+const U32 MAX_CAPTURED_LENGTH = 262144;
+
+static U32 swap_u32(U32 value)
+{
+	return (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+}
+
+static U32 read_u16_be(const U8* data)
+{
+	return (data[0] << 8) | data[1];
+}
+
+// Appends the UDP payload of the IPv4 datagram at data to packets
+static void add_udp_payload(const U8* data, U32 length, U32 source_port, packet_list_t& packets)
+{
+	const U32 IP_HEADER_MIN = 20;
+	const U32 UDP_HEADER = 8;
+	if (length < IP_HEADER_MIN || (data[0] >> 4) != 4 || data[9] != 17)
+	{
+		// not UDP over IPv4
+		return;
+	}
+	if (read_u16_be(data + 6) & 0x3fff)
+	{
+		// a fragment, the message system never sends any
+		return;
+	}
+	U32 header = (data[0] & 0x0f) * 4;
+	if (length < header + UDP_HEADER)
+	{
+		return;
+	}
+	const U8* udp = data + header;
+	if (source_port && read_u16_be(udp) != source_port)
+	{
+		return;
+	}
+	U32 udp_length = read_u16_be(udp + 4);
+	if (udp_length < UDP_HEADER)
+	{
+		return;
+	}
+	U32 payload_length = llmin(udp_length - UDP_HEADER, length - header - UDP_HEADER);
+	if (payload_length < (U32)LL_MINIMUM_VALID_PACKET_SIZE || payload_length > NET_BUFFER_SIZE)
+	{
+		return;
+	}
+	packets.push_back(std::string((const char*)udp + UDP_HEADER, payload_length));
+}
+
+// Reads the UDP payloads sent from source_port (any if 0) of a capture
+static bool load_capture(const std::string& filename, U32 source_port, packet_list_t& packets)
+{
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	U32 header[6];
+	if (!file.read((char*)header, sizeof(header)))
+	{
+		std::cerr << "Could not read " << filename << std::endl;
+		return false;
+	}
+	bool swapped = false;
+	if (header[0] == swap_u32(PCAP_MAGIC) || header[0] == swap_u32(PCAP_MAGIC_NANOSECONDS))
+	{
+		swapped = true;
+	}
+	else if (header[0] != PCAP_MAGIC && header[0] != PCAP_MAGIC_NANOSECONDS)
+	{
+		std::cerr << filename << " is not a libpcap capture" << std::endl;
+		return false;
+	}
+	const U32 link_type = swapped ? swap_u32(header[5]) : header[5];
+	U32 link_header = 0;
+	switch (link_type)
+	{
+		case PCAP_LINKTYPE_NULL:		link_header = 4;	break;
+		case PCAP_LINKTYPE_ETHERNET:	link_header = 14;	break;
+		case PCAP_LINKTYPE_RAW:			link_header = 0;	break;
+		case PCAP_LINKTYPE_LINUX_SLL:	link_header = 16;	break;
+		default:
+			std::cerr << "Unsupported link type " << link_type << " in " << filename << std::endl;
+			return false;
+	}
+
+	std::vector<U8> frame;
+	U32 record[4];
+	while (file.read((char*)record, sizeof(record)))
+	{
+		const U32 captured = swapped ? swap_u32(record[2]) : record[2];
+		if (captured > MAX_CAPTURED_LENGTH)
+		{
+			std::cerr << filename << " is corrupt" << std::endl;
+			return false;
+		}
+		frame.resize(llmax(captured, (U32)1));
+		if (!file.read((char*)&frame[0], captured))
+		{
+			break;
+		}
+		U32 offset = link_header;
+		if (link_type == PCAP_LINKTYPE_ETHERNET)
+		{
+			if (captured < offset)
+			{
+				continue;
+			}
+			U32 ether_type = read_u16_be(&frame[12]);
+			if (ether_type == 0x8100 && captured >= offset + 4)
+			{
+				// 802.1Q tagged
+				ether_type = read_u16_be(&frame[16]);
+				offset += 4;
+			}
+			if (ether_type != 0x0800)
+			{
+				continue;
+			}
+		}
+		if (captured > offset)
+		{
+			add_udp_payload(&frame[offset], captured - offset, source_port, packets);
+		}
+	}
+	return true;
+}
+
+// Sends all the packets through the message system once, returns the time
+// the message system spent reading and decoding them
+static F64 run_replay(S32 sender_socket, const LLHost& receiver, const packet_list_t& packets, S64& frame_count, S32& dropped)
+{
+	F64 elapsed = 0.0;
+	S32 sent = 0;
+	S32 in = 0;
+	const S32 count = (S32)packets.size();
+	for (S32 first = 0; first < count; first += BURST_PACKETS)
+	{
+		const S32 last = llmin(first + BURST_PACKETS, count);
+		for (S32 i = first; i < last; i++)
+		{
+			if (send_packet(sender_socket, packets[i].data(), (int)packets[i].size(), receiver.getAddress(), receiver.getPort()))
+			{
+				sent++;
+			}
+		}
+
+		// A frame of the viewer, with all the time it needs
+		LLTimer timer;
+		while (gMessageSystem->checkMessages(frame_count))
+		{
+			in++;
+		}
+		elapsed += timer.getElapsedTimeF64();
+		gMessageSystem->processAcks();
+		frame_count++;
+	}
+	dropped = sent - in;
+	return elapsed;
+}
+
+// What the handlers of the decode benchmark read
+enum EReadMode
+{
+	READ_NOTHING,
+	READ_BY_NAME,
+	READ_BY_FIELD
+};
+
+typedef std::vector<LLMessageField> field_list_t;
+
+struct DecodeBenchmark
+{
+	LLTemplateMessageReader* mReader;
+	EReadMode mMode;
+	std::map<const LLMessageTemplate*, field_list_t> mFields;
+	U32 mBytesRead;
+};
+
+static DecodeBenchmark sDecodeBenchmark;
+
+// Handler of every message of the decode benchmark, reads every variable
+// of every block of the message being decoded
+static void read_message(LLMessageSystem*, void** user_data)
+{
+	const LLMessageTemplate* templatep = (const LLMessageTemplate*)user_data;
+	LLTemplateMessageReader* reader = sDecodeBenchmark.mReader;
+	U8 data[MTUBYTES];
+	if (sDecodeBenchmark.mMode == READ_BY_NAME)
+	{
+		for (std::vector<LLMessageTemplate::DecodeBlock>::const_iterator block = templatep->mDecodeBlocks.begin();
+			 block != templatep->mDecodeBlocks.end(); ++block)
+		{
+			const S32 count = reader->getNumberOfBlocks(block->mName);
+			for (S32 i = 0; i < count; i++)
+			{
+				for (S32 var = 0; var < block->mNumVariables; var++)
+				{
+					const char* name = templatep->mDecodeVariables[block->mFirstVariable + var].mName;
+					sDecodeBenchmark.mBytesRead += reader->getSize(block->mName, i, name);
+					reader->getBinaryData(block->mName, name, data, 0, i, sizeof(data));
+				}
+			}
+		}
+	}
+	else if (sDecodeBenchmark.mMode == READ_BY_FIELD)
+	{
+		field_list_t& fields = sDecodeBenchmark.mFields[templatep];
+		field_list_t::iterator field = fields.begin();
+		for (std::vector<LLMessageTemplate::DecodeBlock>::const_iterator block = templatep->mDecodeBlocks.begin();
+			 block != templatep->mDecodeBlocks.end(); ++block)
+		{
+			const S32 count = reader->getNumberOfBlocks(block->mName);
+			for (S32 i = 0; i < count; i++)
+			{
+				for (S32 var = 0; var < block->mNumVariables; var++)
+				{
+					sDecodeBenchmark.mBytesRead += reader->getSize(field[var], i);
+					reader->getBinaryData(field[var], data, 0, i, sizeof(data));
+				}
+			}
+			field += block->mNumVariables;
+		}
+	}
+}
+
+// Decodes the packets with a template reader of its own, without the
+// network or the circuits, so only the decoding and reading is timed
+static void run_decode(const std::string& message_template, const packet_list_t& packets, S32 passes)
+{
+	std::ifstream file(message_template.c_str());
+	std::stringstream template_body;
+	template_body << file.rdbuf();
+	LLTemplateTokenizer tokens(template_body.str());
+	LLTemplateParser parsed(tokens);
+
+	LLTemplateMessageReader::message_template_number_map_t numbers;
+	for (LLTemplateParser::message_iterator iter = parsed.getMessagesBegin();
+		 iter != parsed.getMessagesEnd(); ++iter)
+	{
+		LLMessageTemplate* templatep = *iter;
+		templatep->compileDecodeTable();
+		templatep->setHandlerFunc(read_message, (void**)templatep);
+		numbers[templatep->mMessageNumber] = templatep;
+
+		field_list_t& fields = sDecodeBenchmark.mFields[templatep];
+		for (std::vector<LLMessageTemplate::DecodeBlock>::const_iterator block = templatep->mDecodeBlocks.begin();
+			 block != templatep->mDecodeBlocks.end(); ++block)
+		{
+			for (S32 var = 0; var < block->mNumVariables; var++)
+			{
+				fields.push_back(LLMessageField(block->mName, templatep->mDecodeVariables[block->mFirstVariable + var].mName));
+			}
+		}
+	}
+
+	// What the message system hands the reader: the packet without the
+	// appended acks, zero coding expanded
+	packet_list_t messages;
+	for (packet_list_t::const_iterator iter = packets.begin(); iter != packets.end(); ++iter)
+	{
+		U8 buffer[NET_BUFFER_SIZE];
+		S32 size = (S32)iter->size();
+		memcpy(buffer, iter->data(), size);
+		if (buffer[0] & LL_ACK_FLAG)
+		{
+			const S32 acks = buffer[--size];
+			if (size < (S32)(acks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE))
+			{
+				continue;
+			}
+			size -= acks * sizeof(TPACKETID);
+		}
+		U8* data = buffer;
+		gMessageSystem->zeroCodeExpand(&data, &size);
+		messages.push_back(std::string((const char*)data, size));
+	}
+
+	LLTemplateMessageReader reader(numbers);
+	sDecodeBenchmark.mReader = &reader;
+	const char* mode_names[] = { "decode only", "read by name", "read by field" };
+	const LLHost sender(ip_string_to_u32(LOOPBACK_ADDRESS_STRING), 13000);
+	for (S32 mode = READ_NOTHING; mode <= READ_BY_FIELD; mode++)
+	{
+		sDecodeBenchmark.mMode = (EReadMode)mode;
+		sDecodeBenchmark.mBytesRead = 0;
+		S32 decoded = 0;
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			for (packet_list_t::const_iterator iter = messages.begin(); iter != messages.end(); ++iter)
+			{
+				const U8* data = (const U8*)iter->data();
+				if (reader.validateMessage(data, (S32)iter->size(), sender, true)
+					&& reader.readMessage(data, sender))
+				{
+					decoded++;
+				}
+				reader.clearMessage();
+			}
+		}
+		const F64 elapsed = timer.getElapsedTimeF64();
+		std::cout << mode_names[mode] << ": " << (F64)decoded / llmax(elapsed, 0.000001) << " messages/s";
+		if (sDecodeBenchmark.mBytesRead)
+		{
+			std::cout << ", " << sDecodeBenchmark.mBytesRead << " bytes read";
+		}
+		std::cout << std::endl;
+	}
+
+	sDecodeBenchmark.mReader = NULL;
+	sDecodeBenchmark.mFields.clear();
+	for_each(numbers.begin(), numbers.end(), DeletePairedPointer());
+}
+
+typedef S32 (*zero_code_encode_func_t)(const U8* in, S32 size, U8* out);
+typedef S32 (*zero_code_expand_func_t)(const U8* in, S32 size, U8* out, S32 out_size, S32& overflows);
+
+// Zero codes and expands the payloads of the packets without their acks
+static void run_zero_code(const packet_list_t& packets, S32 passes)
+{
+	packet_list_t expanded;
+	packet_list_t encoded;
+	for (packet_list_t::const_iterator iter = packets.begin(); iter != packets.end(); ++iter)
+	{
+		U8 buffer[NET_BUFFER_SIZE];
+		S32 size = (S32)iter->size();
+		memcpy(buffer, iter->data(), size);
+		if (buffer[0] & LL_ACK_FLAG)
+		{
+			const S32 acks = buffer[--size];
+			if (size < (S32)(acks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE))
+			{
+				continue;
+			}
+			size -= acks * sizeof(TPACKETID);
+		}
+		if (buffer[0] & LL_ZERO_CODE_FLAG)
+		{
+			U8 out[NET_BUFFER_SIZE];
+			S32 overflows = 0;
+			encoded.push_back(std::string((const char*)buffer, size));
+			size = zero_code_expand(buffer, size, out, NET_BUFFER_SIZE, overflows);
+			expanded.push_back(std::string((const char*)out, size));
+		}
+		else
+		{
+			U8 out[2 * NET_BUFFER_SIZE];
+			expanded.push_back(std::string((const char*)buffer, size));
+			size = zero_code_encode(buffer, size, out);
+			encoded.push_back(std::string((const char*)out, size));
+		}
+	}
+
+	const char* names[] = { "byte at a time", "run at a time" };
+	const zero_code_encode_func_t encoders[] = { zero_code_encode_scalar, zero_code_encode };
+	const zero_code_expand_func_t expanders[] = { zero_code_expand_scalar, zero_code_expand };
+	for (S32 version = 0; version < 2; version++)
+	{
+		U8 out[2 * NET_BUFFER_SIZE];
+		S32 overflows = 0;
+		U64 bytes = 0;
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			for (packet_list_t::const_iterator iter = expanded.begin(); iter != expanded.end(); ++iter)
+			{
+				bytes += encoders[version]((const U8*)iter->data(), (S32)iter->size(), out);
+			}
+		}
+		const F64 encode_time = timer.getElapsedTimeF64();
+		timer.reset();
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			for (packet_list_t::const_iterator iter = encoded.begin(); iter != encoded.end(); ++iter)
+			{
+				bytes += expanders[version]((const U8*)iter->data(), (S32)iter->size(), out, NET_BUFFER_SIZE, overflows);
+			}
+		}
+		const F64 expand_time = timer.getElapsedTimeF64();
+		const F64 packet_count = (F64)expanded.size() * passes;
+		std::cout << "zero code " << names[version] << ": "
+				  << packet_count / llmax(encode_time, 0.000001) << " packets/s encoded, "
+				  << packet_count / llmax(expand_time, 0.000001) << " packets/s expanded"
+				  << " (" << bytes << " bytes)" << std::endl;
+	}
+}
+
+// Acked and given up messages of the reliable traffic benchmark
+static S32 sReliableAcked = 0;
+static S32 sReliableFailed = 0;
+
+static void count_reliable(void**, S32 result)
+{
+	if (result == LL_ERR_NOERR)
+	{
+		sReliableAcked++;
+	}
+	else
+	{
+		sReliableFailed++;
+	}
+}
+
+// Frames of the reliable traffic benchmark, sending messages for
+// RELIABLE_SEND_FRAMES and then waiting for the last acks or resends,
+// which time out after RELIABLE_TIMEOUT seconds, sleeping
+// RELIABLE_FRAME_MSEC between frames like a viewer would render
+const S32 RELIABLE_SEND_FRAMES = 500;
+const S32 RELIABLE_MESSAGES_PER_FRAME = 40;
+const S32 RELIABLE_RETRIES = 3;
+const F32 RELIABLE_TIMEOUT = 0.05f;
+const U32 RELIABLE_FRAME_MSEC = 2;
+
+// Sends reliable messages from the message system to itself over the
+// loopback interface, dropping loss_percent of the packets received, and
+// times the frames without their sleep
+static void run_reliable(F32 loss_percent, S64& frame_count)
+{
+	const LLHost self(ip_string_to_u32(LOOPBACK_ADDRESS_STRING), gMessageSystem->getListenPort());
+	gMessageSystem->mPacketRing.setDropPercentage(loss_percent);
+	sReliableAcked = 0;
+	sReliableFailed = 0;
+	const U32 resent = gMessageSystem->mResentPackets;
+	const U32 dropped = gMessageSystem->mDroppedPackets;
+
+	F64 elapsed = 0.0;
+	S32 sent = 0;
+	for (S32 frame = 0; sReliableAcked + sReliableFailed < sent || frame < RELIABLE_SEND_FRAMES; frame++)
+	{
+		LLTimer timer;
+		for (S32 i = 0; frame < RELIABLE_SEND_FRAMES && i < RELIABLE_MESSAGES_PER_FRAME; i++)
+		{
+			gMessageSystem->newMessageFast(_PREHASH_TestMessage);
+			gMessageSystem->nextBlockFast(_PREHASH_TestBlock1);
+			gMessageSystem->addU32Fast(_PREHASH_Test1, (U32)sent);
+			for (S32 block = 0; block < 4; block++)
+			{
+				gMessageSystem->nextBlockFast(_PREHASH_NeighborBlock);
+				gMessageSystem->addU32Fast(_PREHASH_Test0, (U32)block);
+				gMessageSystem->addU32Fast(_PREHASH_Test1, (U32)frame);
+				gMessageSystem->addU32Fast(_PREHASH_Test2, (U32)i);
+			}
+			gMessageSystem->sendReliable(self, RELIABLE_RETRIES, FALSE, RELIABLE_TIMEOUT, count_reliable, NULL);
+			sent++;
+		}
+		while (gMessageSystem->checkMessages(frame_count))
+		{
+		}
+		gMessageSystem->processAcks();
+		elapsed += timer.getElapsedTimeF64();
+		frame_count++;
+		ms_sleep(RELIABLE_FRAME_MSEC);
+	}
+	gMessageSystem->mPacketRing.setDropPercentage(0.f);
+
+	std::cout << "reliable " << loss_percent << "% loss: "
+			  << 1000000.0 * elapsed / llmax(sReliableAcked, 1) << " usecs per ack ("
+			  << sReliableAcked << " acked, " << sReliableFailed << " failed, "
+			  << gMessageSystem->mResentPackets - resent << " resent, "
+			  << gMessageSystem->mDroppedPackets - dropped << " lost)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <capture.pcap> <message_template.msg> [max batch size] [passes] [source port]" << std::endl;
+		return 1;
+	}
+	const std::string capture = argv[1];
+	const std::string message_template = argv[2];
+	const S32 max_batch_size = argc > 3 ? llmax(atoi(argv[3]), 1) : 64;
+	const S32 passes = argc > 4 ? llmax(atoi(argv[4]), 1) : 3;
+	const U32 source_port = argc > 5 ? (U32)atoi(argv[5]) : 0;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	packet_list_t packets;
+	if (!load_capture(capture, source_port, packets))
+	{
+		return 1;
+	}
+	if (packets.empty())
+	{
+		std::cerr << "No UDP packet found in " << capture << std::endl;
+		return 1;
+	}
+	std::cout << packets.size() << " packets" << std::endl;
+
+	if (!start_messaging_system(message_template, NET_USE_OS_ASSIGNED_PORT, 1, 0, 0, FALSE, std::string(), NULL, false, 5.f, 100.f))
+	{
+		std::cerr << "Could not start the message system with " << message_template << std::endl;
+		return 1;
+	}
+
+	S32 sender_socket = 0;
+	int sender_port = NET_USE_OS_ASSIGNED_PORT;
+	if (start_net(sender_socket, sender_port))
+	{
+		std::cerr << "Could not open the sending socket" << std::endl;
+		return 1;
+	}
+	const U32 loopback = ip_string_to_u32(LOOPBACK_ADDRESS_STRING);
+	gMessageSystem->enableCircuit(LLHost(loopback, sender_port), TRUE);
+	const LLHost receiver(loopback, gMessageSystem->getListenPort());
+
+	// Most of the messages have no handler here, which is warned about,
+	// and the logging would take longer than the decoding
+	LLError::setDefaultLevel(LLError::LEVEL_ERROR);
+
+	S64 frame_count = 0;
+	for (S32 batch_size = 1; ; batch_size = llmin(batch_size * 4, max_batch_size))
+	{
+		gMessageSystem->mPacketRing.setReceiveBatchSize(batch_size);
+		F64 elapsed = 0.0;
+		S32 dropped = 0;
+		const U32 packets_in = gMessageSystem->mPacketsIn;
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			S32 pass_dropped = 0;
+			elapsed += run_replay(sender_socket, receiver, packets, frame_count, pass_dropped);
+			dropped += pass_dropped;
+		}
+		std::cout << "batch " << batch_size << ": "
+				  << (F64)(gMessageSystem->mPacketsIn - packets_in) / llmax(elapsed, 0.000001) << " packets/s";
+		if (dropped)
+		{
+			std::cout << " (" << dropped << " dropped or invalid)";
+		}
+		std::cout << std::endl;
+
+		if (batch_size == max_batch_size)
+		{
+			break;
+		}
+	}
+
+	run_decode(message_template, packets, passes);
+	run_zero_code(packets, passes * 10);
+
+	gMessageSystem->enableCircuit(LLHost(loopback, gMessageSystem->getListenPort()), TRUE);
+	gMessageSystem->setHandlerFuncFast(_PREHASH_TestMessage, null_message_callback, NULL);
+	const F32 losses[] = { 0.f, 5.f, 20.f };
+	for (S32 i = 0; i < 3; i++)
+	{
+		run_reliable(losses[i], frame_count);
+	}
+
+	end_net(sender_socket);
+	end_messaging_system(false);
+	LLCommon::cleanupClass();
+	return 0;
+}
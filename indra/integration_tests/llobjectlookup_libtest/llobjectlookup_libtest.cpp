@@ -0,0 +1,253 @@
+/**
+ * @file llobjectlookup_libtest.cpp
+ * @brief Headless benchmark of the viewer object list lookup tables
+ *
+ * Usage: llobjectlookup_libtest [objects] [passes]
+ *
+ * Builds the tables LLViewerObjectList keeps for its objects (UUID to
+ * object, simulator host to simulator index, simulator index and local id
+ * to UUID) for objects (default 50000) spread over 9 regions, once with
+ * std::map as the viewer used to and once with LLOpenHashMap, then times
+ * in random order over passes (default 10) passes:
+ *  - full updates, looking the object up by UUID
+ *  - terse updates, looking the UUID up by local id then the object
+ *  - kills, removing an object and adding it back under a new local id
+ * and reports the nanoseconds per update of each.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "llopenhashmap.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "lltimer.h"
+#include "lluuid.h"
+
+#include "../test/lltestrand.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+const S32 NUM_REGIONS = 9;
+const U32 REGION_IP = 0x0a000001;
+const U32 REGION_PORT = 13000;
+
+// Stands for LLViewerObject, only the reference count matters here
+class BenchObject : public LLRefCount
+{
+};
+
+struct BenchObjectInfo
+{
+	LLUUID mID;
+	U32 mLocalID;
+	U32 mIP;
+	U32 mPort;
+	LLPointer<BenchObject> mObject;
+};
+
+typedef std::vector<BenchObjectInfo> object_info_list_t;
+
+static LLTestRand sRand;
+
+// The lookups of LLViewerObjectList, over any map type
+template <typename UUIDMap, typename IndexMap, typename LocalMap>
+class BenchObjectTables
+{
+public:
+	BenchObjectTables() : mNextIndex(1) {}
+
+	void addObject(const BenchObjectInfo& info)
+	{
+		mUUIDObjectMap[info.mID] = info.mObject;
+		setUUIDAndLocal(info.mID, info.mLocalID, info.mIP, info.mPort);
+	}
+
+	void removeObject(const BenchObjectInfo& info)
+	{
+		mUUIDObjectMap.erase(info.mID);
+		mIndexAndLocalIDToUUID.erase(getIndexID(info.mLocalID, info.mIP, info.mPort));
+	}
+
+	BenchObject* findObject(const LLUUID& id)
+	{
+		typename UUIDMap::iterator iter = mUUIDObjectMap.find(id);
+		return iter != mUUIDObjectMap.end() ? iter->second.get() : NULL;
+	}
+
+	void getUUIDFromLocal(LLUUID& id, U32 local_id, U32 ip, U32 port)
+	{
+		typename LocalMap::iterator iter = mIndexAndLocalIDToUUID.find(getIndexID(local_id, ip, port));
+		id = iter != mIndexAndLocalIDToUUID.end() ? iter->second : LLUUID::null;
+	}
+
+	void setUUIDAndLocal(const LLUUID& id, U32 local_id, U32 ip, U32 port)
+	{
+		mIndexAndLocalIDToUUID[getIndexID(local_id, ip, port)] = id;
+	}
+
+private:
+	U64 getIndexID(U32 local_id, U32 ip, U32 port)
+	{
+		U64 ipport = (((U64)ip) << 32) | (U64)port;
+		U32& index = mIPAndPortToIndex[ipport];
+		if (!index)
+		{
+			index = mNextIndex++;
+		}
+		return (((U64)index) << 32) | (U64)local_id;
+	}
+
+	UUIDMap mUUIDObjectMap;
+	IndexMap mIPAndPortToIndex;
+	LocalMap mIndexAndLocalIDToUUID;
+	U32 mNextIndex;
+};
+
+typedef BenchObjectTables<std::map<LLUUID, LLPointer<BenchObject> >,
+						  std::map<U64, U32>,
+						  std::map<U64, LLUUID> > map_tables_t;
+typedef BenchObjectTables<LLOpenHashMap<LLUUID, LLPointer<BenchObject>, lluuid_hash>,
+						  LLOpenHashMap<U64, U32>,
+						  LLOpenHashMap<U64, LLUUID> > hash_tables_t;
+
+static void make_objects(S32 count, object_info_list_t& objects)
+{
+	objects.resize(count);
+	for (S32 i = 0; i < count; i++)
+	{
+		BenchObjectInfo& info = objects[i];
+		// UUIDs of objects are random, so are these
+		for (S32 j = 0; j < UUID_BYTES; j++)
+		{
+			info.mID.mData[j] = (U8)sRand.next();
+		}
+		S32 region = i % NUM_REGIONS;
+		info.mLocalID = 1000 + i / NUM_REGIONS;
+		info.mIP = REGION_IP + region;
+		info.mPort = REGION_PORT + region;
+		info.mObject = new BenchObject;
+	}
+}
+
+// Updates come in for objects all over the place
+static void make_update_order(S32 count, std::vector<S32>& order)
+{
+	order.resize(count);
+	for (S32 i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+	for (S32 i = count - 1; i > 0; i--)
+	{
+		std::swap(order[i], order[sRand.rand(i + 1)]);
+	}
+}
+
+static void report(const char* name, const char* test, F64 elapsed, S64 updates)
+{
+	std::cout << name << " " << test << ": " << elapsed * 1000000000.0 / llmax(updates, (S64)1) << " ns/update" << std::endl;
+}
+
+template <typename Tables>
+static void run(const char* name, object_info_list_t objects, const std::vector<S32>& order, S32 passes)
+{
+	Tables tables;
+	LLTimer timer;
+	for (object_info_list_t::const_iterator iter = objects.begin(); iter != objects.end(); ++iter)
+	{
+		tables.addObject(*iter);
+	}
+	report(name, "add", timer.getElapsedTimeF64(), objects.size());
+
+	const S64 updates = (S64)order.size() * passes;
+	S32 found = 0;
+	timer.reset();
+	for (S32 pass = 0; pass < passes; pass++)
+	{
+		for (std::vector<S32>::const_iterator iter = order.begin(); iter != order.end(); ++iter)
+		{
+			found += tables.findObject(objects[*iter].mID) != NULL;
+		}
+	}
+	report(name, "full update", timer.getElapsedTimeF64(), updates);
+
+	timer.reset();
+	for (S32 pass = 0; pass < passes; pass++)
+	{
+		for (std::vector<S32>::const_iterator iter = order.begin(); iter != order.end(); ++iter)
+		{
+			const BenchObjectInfo& info = objects[*iter];
+			LLUUID id;
+			tables.getUUIDFromLocal(id, info.mLocalID, info.mIP, info.mPort);
+			found += tables.findObject(id) != NULL;
+		}
+	}
+	report(name, "terse update", timer.getElapsedTimeF64(), updates);
+
+	// Local ids past those of any object, the region hands out new ones
+	U32 next_local_id = 1000 + objects.size();
+	timer.reset();
+	for (S32 pass = 0; pass < passes; pass++)
+	{
+		for (std::vector<S32>::const_iterator iter = order.begin(); iter != order.end(); ++iter)
+		{
+			BenchObjectInfo& info = objects[*iter];
+			tables.removeObject(info);
+			info.mLocalID = next_local_id++;
+			tables.addObject(info);
+		}
+	}
+	report(name, "kill and add", timer.getElapsedTimeF64(), updates);
+
+	if (found != 2 * updates)
+	{
+		std::cerr << name << ": " << 2 * updates - found << " lookups failed" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const S32 num_objects = argc > 1 ? llmax(atoi(argv[1]), 1) : 50000;
+	const S32 passes = argc > 2 ? llmax(atoi(argv[2]), 1) : 10;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	object_info_list_t objects;
+	make_objects(num_objects, objects);
+	std::vector<S32> order;
+	make_update_order(num_objects, order);
+
+	std::cout << num_objects << " objects in " << NUM_REGIONS << " regions, " << passes << " passes" << std::endl;
+	run<map_tables_t>("std::map", objects, order, passes);
+	run<hash_tables_t>("LLOpenHashMap", objects, order, passes);
+
+	LLCommon::cleanupClass();
+	return 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * @file llskinning_libtest.cpp
+ * @brief Headless benchmark of the avatar skinning kernels
+ *
+ * Usage: llskinning_libtest <character dir> [avatars] [frames]
+ *
+ * Loads the weighted meshes of the .llm files in character dir (the
+ * viewer's newview/character), gives avatars (default 20) each a copy of
+ * them and their own random joint matrices, then skins every avatar once a
+ * frame (default 200), all avatars in one call, with each LLSkinningKernel
+ * variant this binary has and this CPU runs. Reports the vertices per
+ * second of each and how far its vertices are from the reference's.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcommon.h"
+#include "llendianswizzle.h"
+#include "llerrorcontrol.h"
+#include "llskinningkernel.h"
+#include "lltimer.h"
+#include "m4math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#include "../test/lltestrand.h"
+
+#include <iostream>
+#include <vector>
+
+// Bytes per vertex of the avatar vertex buffers: coord, normal, tex coord,
+// weight and clothing weight
+const U32 VERTEX_STRIDE = 12 + 12 + 8 + 4 + 16;
+
+// The .llm meshes the viewer skins
+static const char* MESH_FILES[] =
+{
+	"avatar_eyelashes.llm",
+	"avatar_hair.llm",
+	"avatar_head.llm",
+	"avatar_lower_body.llm",
+	"avatar_skirt.llm",
+	"avatar_upper_body.llm"
+};
+
+struct BenchMesh
+{
+	std::vector<F32> mWeights;
+	std::vector<LLVector3> mCoords;
+	std::vector<LLVector3> mNormals;
+	S32 mNumJoints;
+};
+
+static LLTestRand sRand;
+
+// Reads the coords, normals and weights of a binary .llm file, see
+// LLPolyMeshSharedData::loadMesh()
+static bool load_mesh(const std::string& path, BenchMesh& mesh)
+{
+	LLFILE* fp = LLFile::fopen(path, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+
+	char header[24];
+	U8 has_weights = 0;
+	U8 has_detail_tex_coords = 0;
+	U16 num_vertices = 0;
+	bool ok = fread(header, 1, 24, fp) == 24 && !strncmp(header, "Linden Binary Mesh 1.0", 22)
+		&& fread(&has_weights, 1, 1, fp) == 1
+		&& fread(&has_detail_tex_coords, 1, 1, fp) == 1
+		&& has_weights
+		&& !fseek(fp, 4 * 3 + 4 * 3 + 1 + 4 * 3, SEEK_CUR)	// position, rotation, order, scale
+		&& fread(&num_vertices, 2, 1, fp) == 1;
+	llendianswizzle(&num_vertices, sizeof(U16), 1);
+
+	const S32 nverts = num_vertices;
+	mesh.mCoords.resize(nverts);
+	mesh.mNormals.resize(nverts);
+	mesh.mWeights.resize(nverts);
+	ok = ok && nverts > 0
+		&& fread(&mesh.mCoords[0], sizeof(LLVector3), nverts, fp) == (size_t)nverts
+		&& fread(&mesh.mNormals[0], sizeof(LLVector3), nverts, fp) == (size_t)nverts
+		&& !fseek(fp, nverts * (3 + 2) * 4, SEEK_CUR)		// binormals, tex coords
+		&& !fseek(fp, has_detail_tex_coords ? nverts * 2 * 4 : 0, SEEK_CUR)
+		&& fread(&mesh.mWeights[0], sizeof(F32), nverts, fp) == (size_t)nverts;
+	fclose(fp);
+	if (!ok)
+	{
+		return false;
+	}
+	llendianswizzle(&mesh.mCoords[0], sizeof(F32), nverts * 3);
+	llendianswizzle(&mesh.mNormals[0], sizeof(F32), nverts * 3);
+	llendianswizzle(&mesh.mWeights[0], sizeof(F32), nverts);
+
+	F32 max_weight = 0.f;
+	for (S32 i = 0; i < nverts; i++)
+	{
+		max_weight = llmax(max_weight, mesh.mWeights[i]);
+	}
+	// The kernels read the matrix after the last joint's
+	mesh.mNumJoints = llfloor(max_weight) + 2;
+	return true;
+}
+
+// An avatar's copies of the meshes, its joint matrices and vertex buffer
+struct BenchAvatar
+{
+	std::vector<LLMatrix4> mJointMatrices;
+	std::vector<U8> mVertexBuffer;
+};
+
+static void make_jobs(const std::vector<BenchMesh>& meshes, std::vector<BenchAvatar>& avatars,
+					  std::vector<LLSkinningJob>& jobs)
+{
+	jobs.clear();
+	for (U32 a = 0; a < avatars.size(); a++)
+	{
+		BenchAvatar& avatar = avatars[a];
+		U32 matrix = 0;
+		U32 vertex = 0;
+		for (U32 m = 0; m < meshes.size(); m++)
+		{
+			const BenchMesh& mesh = meshes[m];
+			LLSkinningJob job;
+			job.mNumVertices = mesh.mCoords.size();
+			job.mWeights = &mesh.mWeights[0];
+			job.mCoords = &mesh.mCoords[0];
+			job.mNormals = &mesh.mNormals[0];
+			job.mJointMatrices = &avatar.mJointMatrices[matrix];
+			job.mOutCoords = &avatar.mVertexBuffer[vertex * VERTEX_STRIDE];
+			job.mOutNormals = job.mOutCoords + 12;
+			job.mOutStride = VERTEX_STRIDE;
+			jobs.push_back(job);
+			matrix += mesh.mNumJoints;
+			vertex += job.mNumVertices;
+		}
+	}
+}
+
+// Largest difference between the coords and normals of two sets of avatars
+static F32 max_difference(const std::vector<BenchAvatar>& a, const std::vector<BenchAvatar>& b)
+{
+	F32 diff = 0.f;
+	for (U32 i = 0; i < a.size(); i++)
+	{
+		const std::vector<U8>& va = a[i].mVertexBuffer;
+		const std::vector<U8>& vb = b[i].mVertexBuffer;
+		for (U32 v = 0; v < va.size(); v += VERTEX_STRIDE)
+		{
+			const F32* fa = (const F32*)&va[v];
+			const F32* fb = (const F32*)&vb[v];
+			for (S32 f = 0; f < 6; f++)
+			{
+				diff = llmax(diff, fabsf(fa[f] - fb[f]));
+			}
+		}
+	}
+	return diff;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <character dir> [avatars] [frames]" << std::endl;
+		return 1;
+	}
+	const S32 num_avatars = argc > 2 ? llmax(atoi(argv[2]), 1) : 20;
+	const S32 num_frames = argc > 3 ? llmax(atoi(argv[3]), 1) : 200;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	std::vector<BenchMesh> meshes;
+	U32 num_vertices = 0;
+	U32 num_joints = 0;
+	for (U32 i = 0; i < LL_ARRAY_SIZE(MESH_FILES); i++)
+	{
+		BenchMesh mesh;
+		if (!load_mesh(std::string(argv[1]) + "/" + MESH_FILES[i], mesh))
+		{
+			std::cerr << "can't load " << MESH_FILES[i] << std::endl;
+			return 1;
+		}
+		meshes.push_back(mesh);
+		num_vertices += mesh.mCoords.size();
+		num_joints += mesh.mNumJoints;
+	}
+	std::cout << meshes.size() << " meshes, " << num_vertices << " vertices per avatar, "
+			  << num_avatars << " avatars, " << num_frames << " frames" << std::endl;
+
+	std::vector<BenchAvatar> avatars(num_avatars);
+	for (S32 a = 0; a < num_avatars; a++)
+	{
+		avatars[a].mJointMatrices.resize(num_joints);
+		for (U32 j = 0; j < num_joints; j++)
+		{
+			LLVector4 pos(sRand.frand(-2.f, 2.f), sRand.frand(-2.f, 2.f), sRand.frand(-2.f, 2.f));
+			avatars[a].mJointMatrices[j].initRotTrans(sRand.frand(-3.f, 3.f), sRand.frand(-3.f, 3.f), sRand.frand(-3.f, 3.f), pos);
+		}
+		avatars[a].mVertexBuffer.assign(num_vertices * VERTEX_STRIDE, 0);
+	}
+
+	std::vector<BenchAvatar> reference = avatars;
+	std::vector<LLSkinningJob> jobs;
+	make_jobs(meshes, reference, jobs);
+	LLSkinningKernel::skinReference(&jobs[0], jobs.size());
+
+	const F64 total_vertices = (F64)num_vertices * num_avatars * num_frames;
+	for (S32 variant = 0; variant < LLSkinningKernel::VARIANT_COUNT; variant++)
+	{
+		LLSkinningKernel::EVariant v = (LLSkinningKernel::EVariant)variant;
+		if (!LLSkinningKernel::setVariant(v))
+		{
+			std::cout << LLSkinningKernel::getVariantName(v) << ": "
+					  << (LLSkinningKernel::isBuilt(v) ? "not supported by this CPU" : "not built") << std::endl;
+			continue;
+		}
+
+		make_jobs(meshes, avatars, jobs);
+		LLTimer timer;
+		for (S32 frame = 0; frame < num_frames; frame++)
+		{
+			LLSkinningKernel::skin(&jobs[0], jobs.size());
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		std::cout << LLSkinningKernel::getVariantName(v) << ": "
+				  << total_vertices / llmax(elapsed, 0.000001) / 1000000.0 << " million vertices/s, "
+				  << "max difference " << max_difference(reference, avatars) << std::endl;
+	}
+
+	LLCommon::cleanupClass();
+	return 0;
+}
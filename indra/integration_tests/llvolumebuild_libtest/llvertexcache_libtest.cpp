@@ -0,0 +1,155 @@
+/**
+ * @file llvertexcache_libtest.cpp
+ * @brief Headless report of the vertex cache order of generated volume faces
+ *
+ * Usage: llvertexcache_libtest [shapes]
+ *
+ * Makes shapes (default 2000) random prims and builds each at all the LOD
+ * levels, once in the order LLVolumeFace generates its triangles and once
+ * with LLVolume::sOptimizeCacheOrder, the way the viewer does with
+ * RenderOptimizeVolumeFaces. Reports the average cache miss ratio of both
+ * with FIFO post transform caches of 8, 16 and 32 vertices, and what the
+ * reordering adds to the build time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "lltimer.h"
+#include "llvertexcacheoptimizer.h"
+#include "llvolume.h"
+#include "llvolumemgr.h"
+
+#include "../test/lltestvolumeparams.h"
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+static const S32 CACHE_SIZES[] = { 8, 16, 32 };
+static const S32 NUM_CACHE_SIZES = LL_ARRAY_SIZE(CACHE_SIZES);
+
+static LLTestRand sRand;
+
+struct CacheStats
+{
+	CacheStats() : mTriangles(0), mVertices(0)
+	{
+		for (S32 i = 0; i < NUM_CACHE_SIZES; i++)
+		{
+			mMisses[i] = 0.0;
+		}
+	}
+
+	void add(const LLVolume* volume)
+	{
+		for (S32 f = 0; f < volume->getNumVolumeFaces(); f++)
+		{
+			const LLVolumeFace& face = volume->getVolumeFace(f);
+			if (face.mIndices.empty())
+			{
+				continue;
+			}
+			U32 triangles = face.mIndices.size() / 3;
+			mTriangles += triangles;
+			mVertices += face.mVertices.size();
+			for (S32 i = 0; i < NUM_CACHE_SIZES; i++)
+			{
+				mMisses[i] += LLVertexCacheOptimizer::getACMR(&face.mIndices[0], face.mIndices.size(), CACHE_SIZES[i]) * triangles;
+			}
+		}
+	}
+
+	F64 getACMR(S32 i) const
+	{
+		return mTriangles ? mMisses[i] / (F64)mTriangles : 0.0;
+	}
+
+	U64 mTriangles;
+	U64 mVertices;
+	F64 mMisses[NUM_CACHE_SIZES];
+};
+
+// Builds every LOD of every shape, returns the seconds it took
+static F64 build_all(const std::vector<LLVolumeParams>& shapes, CacheStats& stats)
+{
+	F64 elapsed = 0.0;
+	for (U32 i = 0; i < shapes.size(); i++)
+	{
+		for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+		{
+			LLTimer timer;
+			LLPointer<LLVolume> volume = new LLVolume(shapes[i], LLVolumeLODGroup::getVolumeScaleFromDetail(detail));
+			elapsed += timer.getElapsedTimeF64();
+			stats.add(volume);
+		}
+	}
+	return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+	const U32 num_shapes = argc > 1 ? llmax(atoi(argv[1]), 1) : 2000;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	std::vector<LLVolumeParams> shapes;
+	for (U32 i = 0; i < num_shapes; i++)
+	{
+		shapes.push_back(ll_random_volume_params(sRand));
+	}
+	std::cout << num_shapes << " shapes, " << LLVolumeLODGroup::NUM_LODS << " LODs each" << std::endl;
+
+	CacheStats generated;
+	LLVolume::sOptimizeCacheOrder = FALSE;
+	F64 generated_time = build_all(shapes, generated);
+
+	CacheStats optimized;
+	LLVolume::sOptimizeCacheOrder = TRUE;
+	F64 optimized_time = build_all(shapes, optimized);
+	LLVolume::sOptimizeCacheOrder = FALSE;
+
+	std::cout << generated.mTriangles << " triangles, " << generated.mVertices << " vertices" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	for (S32 i = 0; i < NUM_CACHE_SIZES; i++)
+	{
+		std::cout << "ACMR, " << std::setw(2) << CACHE_SIZES[i] << " vertex cache: generated "
+				  << generated.getACMR(i) << ", optimized " << optimized.getACMR(i) << std::endl;
+	}
+	std::cout << std::setprecision(1) << "build time: generated " << generated_time * 1000.0
+			  << " ms, optimized " << optimized_time * 1000.0 << " ms (+"
+			  << (optimized_time / llmax(generated_time, 0.000001) - 1.0) * 100.0 << "%)" << std::endl;
+
+	bool same = generated.mTriangles == optimized.mTriangles && generated.mVertices == optimized.mVertices;
+	if (!same)
+	{
+		std::cout << "DIFFERENT FACES" << std::endl;
+	}
+
+	LLCommon::cleanupClass();
+	return same ? 0 : 1;
+}
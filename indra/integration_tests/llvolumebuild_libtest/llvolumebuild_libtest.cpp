@@ -0,0 +1,157 @@
+/**
+ * @file llvolumebuild_libtest.cpp
+ * @brief Headless benchmark of the LLVolumeMgr background volume builds
+ *
+ * Usage: llvolumebuild_libtest [shapes] [workers]
+ *
+ * Makes shapes (default 2000) random prims and has an LLVolumeMgr
+ * build each at all the LOD levels: first with no thread pool, each volume
+ * built when it is asked for, then with a pool of workers (default 0, one
+ * per core less one), the way the viewer does with RenderVolumeBuildThreaded.
+ * Reports the volumes per second of each, the time the asking thread was
+ * busy, and whether the pooled builds made the same faces.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#include "linden_common.h"
+
+// linden library includes
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+#include "llvolume.h"
+#include "llvolumemgr.h"
+
+#include "../test/lltestvolumeparams.h"
+
+#include <iostream>
+#include <vector>
+
+static LLTestRand sRand;
+
+static bool same_faces(const LLVolume* a, const LLVolume* b)
+{
+	if (a->getNumVolumeFaces() != b->getNumVolumeFaces())
+	{
+		return false;
+	}
+	for (S32 i = 0; i < a->getNumVolumeFaces(); i++)
+	{
+		const LLVolumeFace& fa = a->getVolumeFace(i);
+		const LLVolumeFace& fb = b->getVolumeFace(i);
+		if (fa.mVertices.size() != fb.mVertices.size() || fa.mIndices != fb.mIndices)
+		{
+			return false;
+		}
+		for (U32 v = 0; v < fa.mVertices.size(); v++)
+		{
+			if (fa.mVertices[v].mPosition != fb.mVertices[v].mPosition
+				|| fa.mVertices[v].mNormal != fb.mVertices[v].mNormal)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Asks mgr for every LOD of every shape, then waits for all of them.
+// Returns the seconds the whole took, busy is the seconds until the last
+// volume was handed out.
+static F64 build_all(LLVolumeMgr& mgr, const std::vector<LLVolumeParams>& shapes,
+					 std::vector<LLPointer<LLVolume> >& volumes, F64& busy)
+{
+	LLTimer timer;
+	for (U32 i = 0; i < shapes.size(); i++)
+	{
+		for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+		{
+			volumes.push_back(mgr.refVolume(shapes[i], detail));
+		}
+	}
+	busy = timer.getElapsedTimeF64();
+	mgr.finishBuilds();
+	return timer.getElapsedTimeF64();
+}
+
+static void unref_all(LLVolumeMgr& mgr, std::vector<LLPointer<LLVolume> >& volumes)
+{
+	for (U32 i = 0; i < volumes.size(); i++)
+	{
+		mgr.unrefVolume(volumes[i]);
+	}
+	volumes.clear();
+}
+
+int main(int argc, char** argv)
+{
+	const U32 num_shapes = argc > 1 ? llmax(atoi(argv[1]), 1) : 2000;
+	const U32 num_workers = argc > 2 ? llmax(atoi(argv[2]), 0) : 0;
+
+	// Must init LLError for llerrs to actually cause errors.
+	LLError::initForApplication(".");
+	LLCommon::initClass();
+
+	std::vector<LLVolumeParams> shapes;
+	for (U32 i = 0; i < num_shapes; i++)
+	{
+		shapes.push_back(ll_random_volume_params(sRand));
+	}
+	const F64 total = (F64)num_shapes * LLVolumeLODGroup::NUM_LODS;
+	std::cout << num_shapes << " shapes, " << LLVolumeLODGroup::NUM_LODS << " LODs each" << std::endl;
+
+	LLVolumeMgr mgr;
+	std::vector<LLPointer<LLVolume> > reference;
+	F64 busy = 0.0;
+	F64 elapsed = build_all(mgr, shapes, reference, busy);
+	std::cout << "serial: " << total / llmax(elapsed, 0.000001) << " volumes/s, asking thread busy "
+			  << busy * 1000.0 << " ms" << std::endl;
+
+	bool same = true;
+	{
+		// A second manager, so that its volumes are new ones
+		LLThreadPool pool("Volume builds", num_workers);
+		LLVolumeMgr pooled_mgr;
+		pooled_mgr.setThreadPool(&pool);
+		std::vector<LLPointer<LLVolume> > pooled;
+		elapsed = build_all(pooled_mgr, shapes, pooled, busy);
+
+		same = pooled.size() == reference.size();
+		for (U32 i = 0; same && i < pooled.size(); i++)
+		{
+			same = !pooled[i]->isBuildPending() && same_faces(pooled[i], reference[i]);
+		}
+		std::cout << "pooled, " << pool.getNumWorkers() << " workers: "
+				  << total / llmax(elapsed, 0.000001) << " volumes/s, asking thread busy "
+				  << busy * 1000.0 << " ms, " << (same ? "same faces" : "DIFFERENT FACES") << std::endl;
+
+		pooled_mgr.setThreadPool(NULL);
+		unref_all(pooled_mgr, pooled);
+		pooled_mgr.cleanup();
+	}
+
+	unref_all(mgr, reference);
+	mgr.cleanup();
+	LLCommon::cleanupClass();
+	return same ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+/**
+ * @file llmorphaccumulator.cpp
+ * @brief Adds the vertex deltas of morph targets to a deformable mesh.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include "linden_common.h"
+
+#include "llmorphaccumulator.h"
+
+#include "llmath.h"
+#include "llv4math.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#if LL_VECTORIZE
+
+//-----------------------------------------------------------------------------
+// SSE helpers. Vectors are loaded and stored a float at a time past the
+// first two, so nothing is read or written past the end of the arrays.
+//-----------------------------------------------------------------------------
+static inline __m128 load_vector3(const LLVector3& v)
+{
+	return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)v.mV), _mm_load_ss(v.mV + 2));
+}
+
+static inline void store_vector3(LLVector3& v, __m128 a)
+{
+	_mm_storel_pi((__m64*)v.mV, a);
+	_mm_store_ss(v.mV + 2, _mm_movehl_ps(a, a));
+}
+
+static inline __m128 load_vector2(const LLVector2& v)
+{
+	return _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)v.mV);
+}
+
+static inline void store_vector2(LLVector2& v, __m128 a)
+{
+	_mm_storel_pi((__m64*)v.mV, a);
+}
+
+// Normalizes four vectors, one per lane, the way LLVector3::normVec() does:
+// vectors too short to normalize become zero
+static inline void normalize4(__m128& x, __m128& y, __m128& z)
+{
+	__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+	__m128 valid = _mm_cmpgt_ps(mag, _mm_set1_ps(FP_MAG_THRESHOLD));
+	__m128 oomag = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.f), mag), valid);
+	x = _mm_mul_ps(x, oomag);
+	y = _mm_mul_ps(y, oomag);
+	z = _mm_mul_ps(z, oomag);
+}
+
+// a % b, one cross product per lane
+static inline void cross4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz,
+						  __m128& x, __m128& y, __m128& z)
+{
+	x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(by, az));
+	y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(bz, ax));
+	z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(bx, ay));
+}
+
+#endif // LL_VECTORIZE
+
+//-----------------------------------------------------------------------------
+// LLMorphAccumulator()
+//-----------------------------------------------------------------------------
+LLMorphAccumulator::LLMorphAccumulator(S32 num_vertices,
+									   LLVector3* coords,
+									   LLVector3* normals,
+									   LLVector3* scaled_normals,
+									   LLVector3* binormals,
+									   LLVector3* scaled_binormals,
+									   LLVector2* tex_coords,
+									   LLVector4* clothing_weights)
+:	mNumVertices(num_vertices),
+	mCoords(coords),
+	mNormals(normals),
+	mScaledNormals(scaled_normals),
+	mBinormals(binormals),
+	mScaledBinormals(scaled_binormals),
+	mTexCoords(tex_coords),
+	mClothingWeights(clothing_weights),
+	mMoved(num_vertices, 0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// addMorph()
+//-----------------------------------------------------------------------------
+void LLMorphAccumulator::addMorph(U32 num_indices,
+								  const U32* vertex_indices,
+								  const LLVector3* coords,
+								  const LLVector3* normals,
+								  const LLVector3* binormals,
+								  const LLVector2* tex_coords,
+								  const F32* mask_weights,
+								  F32 weight,
+								  F32 normal_factor,
+								  BOOL clothing_morph)
+{
+#if LL_VECTORIZE
+	const bool add_clothing = clothing_morph && mClothingWeights;
+	for (U32 i = 0; i < num_indices; i++)
+	{
+		const U32 vertex = vertex_indices[i];
+		const F32 mask_weight = mask_weights ? mask_weights[i] : 1.f;
+		const F32 vertex_weight = weight * mask_weight;
+		const __m128 delta_weight = _mm_set1_ps(vertex_weight);
+		const __m128 normal_weight = _mm_set1_ps(vertex_weight * normal_factor);
+
+		__m128 coord_delta = _mm_mul_ps(load_vector3(coords[i]), delta_weight);
+		store_vector3(mCoords[vertex], _mm_add_ps(load_vector3(mCoords[vertex]), coord_delta));
+		if (add_clothing)
+		{
+			LLVector4& clothing_weight = mClothingWeights[vertex];
+			store_vector3(*(LLVector3*)clothing_weight.mV,
+						  _mm_add_ps(load_vector3(*(const LLVector3*)clothing_weight.mV), coord_delta));
+			clothing_weight.mV[VW] = mask_weight;
+		}
+
+		store_vector3(mScaledNormals[vertex],
+					  _mm_add_ps(load_vector3(mScaledNormals[vertex]),
+								 _mm_mul_ps(load_vector3(normals[i]), normal_weight)));
+		store_vector3(mScaledBinormals[vertex],
+					  _mm_add_ps(load_vector3(mScaledBinormals[vertex]),
+								 _mm_mul_ps(load_vector3(binormals[i]), normal_weight)));
+		store_vector2(mTexCoords[vertex],
+					  _mm_add_ps(load_vector2(mTexCoords[vertex]),
+								 _mm_mul_ps(load_vector2(tex_coords[i]), delta_weight)));
+
+		markMoved(vertex);
+	}
+#else
+	addMorphReference(num_indices, vertex_indices, coords, normals, binormals, tex_coords,
+					  mask_weights, weight, normal_factor, clothing_morph);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// addMorphReference()
+//-----------------------------------------------------------------------------
+void LLMorphAccumulator::addMorphReference(U32 num_indices,
+										   const U32* vertex_indices,
+										   const LLVector3* coords,
+										   const LLVector3* normals,
+										   const LLVector3* binormals,
+										   const LLVector2* tex_coords,
+										   const F32* mask_weights,
+										   F32 weight,
+										   F32 normal_factor,
+										   BOOL clothing_morph)
+{
+	for (U32 i = 0; i < num_indices; i++)
+	{
+		const U32 vertex = vertex_indices[i];
+		const F32 mask_weight = mask_weights ? mask_weights[i] : 1.f;
+		const F32 vertex_weight = weight * mask_weight;
+		const F32 normal_weight = vertex_weight * normal_factor;
+
+		LLVector3 coord_delta = coords[i] * vertex_weight;
+		mCoords[vertex] += coord_delta;
+		if (clothing_morph && mClothingWeights)
+		{
+			LLVector4* clothing_weight = &mClothingWeights[vertex];
+			clothing_weight->mV[VX] += coord_delta.mV[VX];
+			clothing_weight->mV[VY] += coord_delta.mV[VY];
+			clothing_weight->mV[VZ] += coord_delta.mV[VZ];
+			clothing_weight->mV[VW] = mask_weight;
+		}
+
+		mScaledNormals[vertex] += normals[i] * normal_weight;
+		mScaledBinormals[vertex] += binormals[i] * normal_weight;
+		mTexCoords[vertex] += tex_coords[i] * vertex_weight;
+
+		markMoved(vertex);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// normalize()
+//-----------------------------------------------------------------------------
+void LLMorphAccumulator::normalize()
+{
+#if LL_VECTORIZE
+	const S32 num_moved = (S32)mMovedList.size();
+	S32 i = 0;
+	for ( ; i + 4 <= num_moved; i += 4)
+	{
+		const U32* vertices = &mMovedList[i];
+
+		// Four vertices, x, y and z in a register each
+		__m128 nx = load_vector3(mScaledNormals[vertices[0]]);
+		__m128 ny = load_vector3(mScaledNormals[vertices[1]]);
+		__m128 nz = load_vector3(mScaledNormals[vertices[2]]);
+		__m128 nw = load_vector3(mScaledNormals[vertices[3]]);
+		_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+
+		__m128 sbx = load_vector3(mScaledBinormals[vertices[0]]);
+		__m128 sby = load_vector3(mScaledBinormals[vertices[1]]);
+		__m128 sbz = load_vector3(mScaledBinormals[vertices[2]]);
+		__m128 sbw = load_vector3(mScaledBinormals[vertices[3]]);
+		_MM_TRANSPOSE4_PS(sbx, sby, sbz, sbw);
+
+		normalize4(nx, ny, nz);
+
+		// binormal = normal % (scaled binormal % normal)
+		__m128 tx, ty, tz;
+		cross4(sbx, sby, sbz, nx, ny, nz, tx, ty, tz);
+		__m128 bx, by, bz;
+		cross4(nx, ny, nz, tx, ty, tz, bx, by, bz);
+		normalize4(bx, by, bz);
+
+		_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+		store_vector3(mNormals[vertices[0]], nx);
+		store_vector3(mNormals[vertices[1]], ny);
+		store_vector3(mNormals[vertices[2]], nz);
+		store_vector3(mNormals[vertices[3]], nw);
+
+		__m128 bw = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+		store_vector3(mBinormals[vertices[0]], bx);
+		store_vector3(mBinormals[vertices[1]], by);
+		store_vector3(mBinormals[vertices[2]], bz);
+		store_vector3(mBinormals[vertices[3]], bw);
+	}
+
+	// The last few the slow way
+	for ( ; i < num_moved; i++)
+	{
+		const U32 vertex = mMovedList[i];
+		LLVector3 normal = mScaledNormals[vertex];
+		normal.normVec();
+		mNormals[vertex] = normal;
+
+		LLVector3 binormal = normal % (mScaledBinormals[vertex] % normal);
+		binormal.normVec();
+		mBinormals[vertex] = binormal;
+	}
+	clearMoved();
+#else
+	normalizeReference();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// normalizeReference()
+//-----------------------------------------------------------------------------
+void LLMorphAccumulator::normalizeReference()
+{
+	for (std::vector<U32>::const_iterator iter = mMovedList.begin(); iter != mMovedList.end(); ++iter)
+	{
+		const U32 vertex = *iter;
+		LLVector3 normal = mScaledNormals[vertex];
+		normal.normVec();
+		mNormals[vertex] = normal;
+
+		LLVector3 tangent = mScaledBinormals[vertex] % normal;
+		LLVector3 binormal = normal % tangent;
+		binormal.normVec();
+		mBinormals[vertex] = binormal;
+	}
+	clearMoved();
+}
+
+//-----------------------------------------------------------------------------
+// clearMoved()
+//-----------------------------------------------------------------------------
+void LLMorphAccumulator::clearMoved()
+{
+	for (std::vector<U32>::const_iterator iter = mMovedList.begin(); iter != mMovedList.end(); ++iter)
+	{
+		mMoved[*iter] = 0;
+	}
+	mMovedList.clear();
+}
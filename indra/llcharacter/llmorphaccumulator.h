@@ -0,0 +1,134 @@
+/**
+ * @file llmorphaccumulator.h
+ * @brief Adds the vertex deltas of morph targets to a deformable mesh.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMORPHACCUMULATOR_H
+#define LL_LLMORPHACCUMULATOR_H
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include <vector>
+
+class LLVector2;
+class LLVector3;
+class LLVector4;
+
+//-----------------------------------------------------------------------------
+// class LLMorphAccumulator
+// Adds weighted morph target deltas to the vertex arrays of a mesh, the
+// way the avatar meshes are deformed by their visual params, then
+// renormalizes the normals and binormals of the vertices that moved.
+//
+// Normal and binormal deltas are added to the scaled (unnormalized) normals
+// and binormals. The output normal of a vertex is its scaled normal
+// normalized, its binormal the scaled binormal made orthogonal to that
+// normal and normalized. Both only depend on the final scaled vectors, so
+// normalizing once after all the morphs gives the same vertices as
+// normalizing after each of them.
+//
+// An accumulator only touches the arrays it was given, so any thread can
+// run one on arrays nobody else is using.
+//
+// When the whole build uses SSE (see llv4math.h) deltas are added a vector
+// at a time and vertices are normalized four at a time. The reference
+// versions do the same one float at a time, the way the viewer used to.
+//-----------------------------------------------------------------------------
+class LLMorphAccumulator
+{
+public:
+	// All arrays have num_vertices elements
+	LLMorphAccumulator(S32 num_vertices,
+					   LLVector3* coords,
+					   LLVector3* normals,
+					   LLVector3* scaled_normals,
+					   LLVector3* binormals,
+					   LLVector3* scaled_binormals,
+					   LLVector2* tex_coords,
+					   LLVector4* clothing_weights);
+
+	// Adds weight times the deltas of a morph target of num_indices
+	// vertices, the normal and binormal deltas also times normal_factor.
+	// mask_weights, if not NULL, holds a further weight per morph vertex.
+	// A clothing morph also adds its coord deltas to the clothing weights
+	// and sets their W to the mask weight.
+	void addMorph(U32 num_indices,
+				  const U32* vertex_indices,
+				  const LLVector3* coords,
+				  const LLVector3* normals,
+				  const LLVector3* binormals,
+				  const LLVector2* tex_coords,
+				  const F32* mask_weights,
+				  F32 weight,
+				  F32 normal_factor,
+				  BOOL clothing_morph);
+
+	// Renormalizes the normals and binormals of the vertices the morphs
+	// added since the last call moved
+	void normalize();
+
+	// Unvectorized versions of the above
+	void addMorphReference(U32 num_indices,
+						   const U32* vertex_indices,
+						   const LLVector3* coords,
+						   const LLVector3* normals,
+						   const LLVector3* binormals,
+						   const LLVector2* tex_coords,
+						   const F32* mask_weights,
+						   F32 weight,
+						   F32 normal_factor,
+						   BOOL clothing_morph);
+	void normalizeReference();
+
+	// Number of vertices waiting for normalize()
+	S32 getNumMoved() const { return (S32)mMovedList.size(); }
+
+private:
+	void markMoved(U32 vertex)
+	{
+		llassert(vertex < (U32)mNumVertices);
+		if (!mMoved[vertex])
+		{
+			mMoved[vertex] = 1;
+			mMovedList.push_back(vertex);
+		}
+	}
+
+	void clearMoved();
+
+	S32 mNumVertices;
+	LLVector3* mCoords;
+	LLVector3* mNormals;
+	LLVector3* mScaledNormals;
+	LLVector3* mBinormals;
+	LLVector3* mScaledBinormals;
+	LLVector2* mTexCoords;
+	LLVector4* mClothingWeights;
+
+	std::vector<U8> mMoved;			// per mesh vertex, set when in mMovedList
+	std::vector<U32> mMovedList;	// vertices waiting for normalize()
+};
+
+#endif // LL_LLMORPHACCUMULATOR_H
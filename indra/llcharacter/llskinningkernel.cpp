@@ -0,0 +1,181 @@
+/**
+ * @file llskinningkernel.cpp
+ * @brief Blends the vertices of avatar meshes between their joint matrices.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include "linden_common.h"
+
+#include "llskinningkernel.h"
+
+#include "llprocessor.h"
+#include "m4math.h"
+#include "v3math.h"
+
+LLSkinningKernel::skin_func_t LLSkinningKernel::sSkinFunc = &LLSkinningKernel::skinReference;
+LLSkinningKernel::EVariant LLSkinningKernel::sVariant = LLSkinningKernel::VARIANT_REFERENCE;
+
+//-----------------------------------------------------------------------------
+// setVariant()
+//-----------------------------------------------------------------------------
+//static
+BOOL LLSkinningKernel::setVariant(EVariant variant)
+{
+	if (!isAvailable(variant))
+	{
+		return FALSE;
+	}
+
+	switch (variant)
+	{
+	case VARIANT_SSE2:
+		sSkinFunc = &skinSSE2;
+		break;
+	default:
+		sSkinFunc = &skinReference;
+		break;
+	}
+	sVariant = variant;
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// isAvailable()
+//-----------------------------------------------------------------------------
+//static
+BOOL LLSkinningKernel::isAvailable(EVariant variant)
+{
+	if (!isBuilt(variant))
+	{
+		return FALSE;
+	}
+
+	LLProcessorInfo proc;
+	switch (variant)
+	{
+	case VARIANT_SSE2:
+		return proc.hasSSE2();
+	default:
+		return TRUE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// isBuilt()
+//-----------------------------------------------------------------------------
+//static
+BOOL LLSkinningKernel::isBuilt(EVariant variant)
+{
+	switch (variant)
+	{
+	case VARIANT_SSE2:
+		return isSSE2Built();
+	case VARIANT_REFERENCE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// getVariantName()
+//-----------------------------------------------------------------------------
+//static
+const char* LLSkinningKernel::getVariantName(EVariant variant)
+{
+	switch (variant)
+	{
+	case VARIANT_SSE2:
+		return "SSE2";
+	case VARIANT_REFERENCE:
+		return "reference";
+	default:
+		return "unknown";
+	}
+}
+
+//-----------------------------------------------------------------------------
+// skinReference()
+//-----------------------------------------------------------------------------
+//static
+void LLSkinningKernel::skinReference(const LLSkinningJob* jobs, U32 num_jobs)
+{
+	for (U32 i = 0; i < num_jobs; i++)
+	{
+		skinVertices(jobs[i], 0, jobs[i].mNumVertices);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// skinVertices()
+//-----------------------------------------------------------------------------
+//static
+void LLSkinningKernel::skinVertices(const LLSkinningJob& job, U32 begin, U32 end)
+{
+	F32 last_weight = F32_MAX;
+	LLMatrix4 blend_mat;
+
+	for (U32 index = begin; index < end; index++)
+	{
+		// Consecutive vertices often share a weight, and so a matrix
+		const F32 weight = job.mWeights[index];
+		if (weight != last_weight)
+		{
+			last_weight = weight;
+			S32 joint = llfloor(weight);
+			F32 w = weight - joint;
+			const LLMatrix4& m0 = job.mJointMatrices[joint];
+			const LLMatrix4& m1 = job.mJointMatrices[joint + 1];
+			for (S32 row = VX; row <= VW; row++)
+			{
+				for (S32 col = VX; col <= VZ; col++)
+				{
+					F32 a = m0.mMatrix[row][col];
+					blend_mat.mMatrix[row][col] = (m1.mMatrix[row][col] - a) * w + a;
+				}
+			}
+		}
+
+		const LLVector3& v = job.mCoords[index];
+		LLVector3& o_v = *(LLVector3*)(job.mOutCoords + index * job.mOutStride);
+		for (S32 col = VX; col <= VZ; col++)
+		{
+			o_v.mV[col] = v.mV[VX] * blend_mat.mMatrix[VX][col]
+						+ v.mV[VY] * blend_mat.mMatrix[VY][col]
+						+ v.mV[VZ] * blend_mat.mMatrix[VZ][col]
+						+ blend_mat.mMatrix[VW][col];
+		}
+
+		const LLVector3& n = job.mNormals[index];
+		LLVector3& o_n = *(LLVector3*)(job.mOutNormals + index * job.mOutStride);
+		for (S32 col = VX; col <= VZ; col++)
+		{
+			o_n.mV[col] = n.mV[VX] * blend_mat.mMatrix[VX][col]
+						+ n.mV[VY] * blend_mat.mMatrix[VY][col]
+						+ n.mV[VZ] * blend_mat.mMatrix[VZ][col];
+		}
+	}
+}
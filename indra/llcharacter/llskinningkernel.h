@@ -0,0 +1,105 @@
+/**
+ * @file llskinningkernel.h
+ * @brief Blends the vertices of avatar meshes between their joint matrices.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSKINNINGKERNEL_H
+#define LL_LLSKINNINGKERNEL_H
+
+class LLMatrix4;
+class LLVector3;
+
+//-----------------------------------------------------------------------------
+// LLSkinningJob
+// One mesh to skin. Vertex i is blended between joint matrices
+// floor(weights[i]) and floor(weights[i]) + 1 by the fraction of
+// weights[i]: its coord is transformed by the blended matrix, its normal
+// by the rotation of the blended matrix. Both matrices are read even when
+// the fraction is zero, as the viewer always has.
+//-----------------------------------------------------------------------------
+struct LLSkinningJob
+{
+	U32					mNumVertices;
+	const F32*			mWeights;
+	const LLVector3*	mCoords;
+	const LLVector3*	mNormals;
+	const LLMatrix4*	mJointMatrices;	// with the skin offsets applied
+	U8*					mOutCoords;		// first output coord
+	U8*					mOutNormals;	// first output normal
+	U32					mOutStride;		// bytes between output vertices
+};
+
+//-----------------------------------------------------------------------------
+// LLSkinningKernel
+// Skins any number of meshes, of any number of avatars, per call.
+//
+// VARIANT_REFERENCE blends a matrix per run of equal weights, a float at a
+// time, the way the viewer always has. VARIANT_SSE2 does the same with
+// SSE vectors, and is compiled with its own instruction set options (see
+// the CMakeLists.txt), so the build may leave it out.
+//
+// Wider variants, 4 and 8 vertices at a time in SSE4.1 and AVX2, were
+// slower than VARIANT_SSE2 on the avatar meshes: skinning is mostly loads
+// and strided stores into the vertex buffer, and the transposes they need
+// cost more than the width gains.
+//-----------------------------------------------------------------------------
+class LLSkinningKernel
+{
+public:
+	typedef enum e_variant
+	{
+		VARIANT_REFERENCE = 0,
+		VARIANT_SSE2,
+		VARIANT_COUNT
+	} EVariant;
+
+	// Skins jobs with the current variant
+	static void skin(const LLSkinningJob* jobs, U32 num_jobs) { sSkinFunc(jobs, num_jobs); }
+
+	// Use variant from now on, if it is available
+	static BOOL setVariant(EVariant variant);
+	static EVariant getVariant() { return sVariant; }
+
+	// Built into this binary and supported by this CPU
+	static BOOL isAvailable(EVariant variant);
+	// Built into this binary
+	static BOOL isBuilt(EVariant variant);
+
+	static const char* getVariantName(EVariant variant);
+
+	static void skinReference(const LLSkinningJob* jobs, U32 num_jobs);
+	static void skinSSE2(const LLSkinningJob* jobs, U32 num_jobs);
+
+	// Skins vertices [begin, end) of job a vertex at a time
+	static void skinVertices(const LLSkinningJob& job, U32 begin, U32 end);
+
+private:
+	static BOOL isSSE2Built();
+
+	typedef void (*skin_func_t)(const LLSkinningJob* jobs, U32 num_jobs);
+	static skin_func_t sSkinFunc;
+	static EVariant sVariant;
+};
+
+#endif // LL_LLSKINNINGKERNEL_H
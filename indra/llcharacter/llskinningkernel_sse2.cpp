@@ -0,0 +1,119 @@
+/**
+ * @file llskinningkernel_sse2.cpp
+ * @brief SSE2 version of LLSkinningKernel, a vertex at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+
+// Linux compiler settings for this file: -msse2 -mfpmath=sse (see
+// CMakeLists.txt)
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include "linden_common.h"
+
+#include "llskinningkernel.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+#include "m4math.h"
+#include "v3math.h"
+
+#if LL_VECTORIZE && (defined(__SSE2__) || LL_MSVC)
+
+#include <emmintrin.h>
+
+static inline void store_vector3(U8* p, __m128 a)
+{
+	_mm_storel_pi((__m64*)p, a);
+	_mm_store_ss((F32*)p + 2, _mm_movehl_ps(a, a));
+}
+
+//static
+BOOL LLSkinningKernel::isSSE2Built()
+{
+	return TRUE;
+}
+
+//static
+void LLSkinningKernel::skinSSE2(const LLSkinningJob* jobs, U32 num_jobs)
+{
+	for (U32 j = 0; j < num_jobs; j++)
+	{
+		const LLSkinningJob& job = jobs[j];
+		F32 last_weight = F32_MAX;
+		__m128 blend_x = _mm_setzero_ps();
+		__m128 blend_y = _mm_setzero_ps();
+		__m128 blend_z = _mm_setzero_ps();
+		__m128 blend_w = _mm_setzero_ps();
+
+		for (U32 index = 0; index < job.mNumVertices; index++)
+		{
+			const F32 weight = job.mWeights[index];
+			if (weight != last_weight)
+			{
+				last_weight = weight;
+				S32 joint = llfloor(weight);
+				__m128 w = _mm_set1_ps(weight - joint);
+				const LLMatrix4& m0 = job.mJointMatrices[joint];
+				const LLMatrix4& m1 = job.mJointMatrices[joint + 1];
+				__m128 a = _mm_loadu_ps(m0.mMatrix[VX]);
+				blend_x = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(m1.mMatrix[VX]), a), w), a);
+				a = _mm_loadu_ps(m0.mMatrix[VY]);
+				blend_y = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(m1.mMatrix[VY]), a), w), a);
+				a = _mm_loadu_ps(m0.mMatrix[VZ]);
+				blend_z = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(m1.mMatrix[VZ]), a), w), a);
+				a = _mm_loadu_ps(m0.mMatrix[VW]);
+				blend_w = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(m1.mMatrix[VW]), a), w), a);
+			}
+
+			const F32* v = job.mCoords[index].mV;
+			__m128 o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v[VX]), blend_x),
+											 _mm_mul_ps(_mm_set1_ps(v[VY]), blend_y)),
+								  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v[VZ]), blend_z), blend_w));
+			store_vector3(job.mOutCoords + index * job.mOutStride, o);
+
+			const F32* n = job.mNormals[index].mV;
+			o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n[VX]), blend_x),
+									  _mm_mul_ps(_mm_set1_ps(n[VY]), blend_y)),
+						   _mm_mul_ps(_mm_set1_ps(n[VZ]), blend_z));
+			store_vector3(job.mOutNormals + index * job.mOutStride, o);
+		}
+	}
+}
+
+#else
+
+//static
+BOOL LLSkinningKernel::isSSE2Built()
+{
+	return FALSE;
+}
+
+//static
+void LLSkinningKernel::skinSSE2(const LLSkinningJob* jobs, U32 num_jobs)
+{
+	skinReference(jobs, num_jobs);
+}
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ * @file llmorphaccumulator_test.cpp
+ * @brief Tests of LLMorphAccumulator against the viewer's old morph loop
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#include "../llmorphaccumulator.h"
+
+#include "../test/lltestrand.h"
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace tut
+{
+	const S32 NUM_VERTICES = 600;
+	const F32 NORMAL_FACTOR = 0.65f;
+
+	struct TestMesh
+	{
+		TestMesh() :
+			mCoords(NUM_VERTICES), mNormals(NUM_VERTICES), mScaledNormals(NUM_VERTICES),
+			mBinormals(NUM_VERTICES), mScaledBinormals(NUM_VERTICES),
+			mTexCoords(NUM_VERTICES), mClothingWeights(NUM_VERTICES)
+		{
+		}
+
+		LLMorphAccumulator* newAccumulator()
+		{
+			return new LLMorphAccumulator(NUM_VERTICES, &mCoords[0], &mNormals[0], &mScaledNormals[0],
+										  &mBinormals[0], &mScaledBinormals[0], &mTexCoords[0], &mClothingWeights[0]);
+		}
+
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<LLVector3> mScaledNormals;
+		std::vector<LLVector3> mBinormals;
+		std::vector<LLVector3> mScaledBinormals;
+		std::vector<LLVector2> mTexCoords;
+		std::vector<LLVector4> mClothingWeights;
+	};
+
+	struct TestMorph
+	{
+		std::vector<U32> mVertexIndices;
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<LLVector3> mBinormals;
+		std::vector<LLVector2> mTexCoords;
+		std::vector<F32> mMaskWeights;
+		F32 mWeight;
+		BOOL mClothing;
+	};
+
+	struct morphaccumulator_data
+	{
+		LLVector3 randomVector(F32 range)
+		{
+			F32 x = mRand.frand(-range, range);
+			F32 y = mRand.frand(-range, range);
+			F32 z = mRand.frand(-range, range);
+			return LLVector3(x, y, z);
+		}
+
+		void makeMesh(TestMesh& mesh)
+		{
+			for (S32 i = 0; i < NUM_VERTICES; i++)
+			{
+				mesh.mCoords[i] = randomVector(1.f);
+				mesh.mNormals[i] = randomVector(1.f);
+				mesh.mNormals[i].normVec();
+				mesh.mScaledNormals[i] = mesh.mNormals[i];
+				mesh.mBinormals[i] = randomVector(1.f);
+				mesh.mBinormals[i].normVec();
+				mesh.mScaledBinormals[i] = mesh.mBinormals[i];
+				F32 s = mRand.frand(-1.f, 1.f);
+				F32 t = mRand.frand(-1.f, 1.f);
+				mesh.mTexCoords[i].setVec(s, t);
+				mesh.mClothingWeights[i].clearVec();
+			}
+		}
+
+		// Morphs of every size, some of them moving the same vertices
+		void makeMorphs(std::vector<TestMorph>& morphs, S32 count)
+		{
+			morphs.resize(count);
+			for (S32 m = 0; m < count; m++)
+			{
+				TestMorph& morph = morphs[m];
+				S32 num_indices = (S32)(mRand.frand(-0.5f, 0.5f) * NUM_VERTICES + NUM_VERTICES / 2);
+				S32 first = (S32)(mRand.frand(0.f, 1.f) * (NUM_VERTICES - num_indices));
+				for (S32 i = 0; i < num_indices; i++)
+				{
+					morph.mVertexIndices.push_back(first + i);
+					morph.mCoords.push_back(randomVector(0.1f));
+					morph.mNormals.push_back(randomVector(1.f));
+					morph.mBinormals.push_back(randomVector(1.f));
+					F32 s = mRand.frand(-0.05f, 0.05f);
+					F32 t = mRand.frand(-0.05f, 0.05f);
+					morph.mTexCoords.push_back(LLVector2(s, t));
+					morph.mMaskWeights.push_back(mRand.frand(0.f, 1.f));
+				}
+				if (m % 3 == 0)
+				{
+					morph.mMaskWeights.clear();
+				}
+				morph.mWeight = mRand.frand(-1.f, 1.f);
+				morph.mClothing = (m % 4 == 1);
+			}
+		}
+
+		void addMorph(LLMorphAccumulator* accumulator, const TestMorph& morph, bool reference)
+		{
+			const F32* mask_weights = morph.mMaskWeights.empty() ? NULL : &morph.mMaskWeights[0];
+			if (reference)
+			{
+				accumulator->addMorphReference(morph.mVertexIndices.size(), &morph.mVertexIndices[0],
+											   &morph.mCoords[0], &morph.mNormals[0], &morph.mBinormals[0],
+											   &morph.mTexCoords[0], mask_weights, morph.mWeight,
+											   NORMAL_FACTOR, morph.mClothing);
+			}
+			else
+			{
+				accumulator->addMorph(morph.mVertexIndices.size(), &morph.mVertexIndices[0],
+									  &morph.mCoords[0], &morph.mNormals[0], &morph.mBinormals[0],
+									  &morph.mTexCoords[0], mask_weights, morph.mWeight,
+									  NORMAL_FACTOR, morph.mClothing);
+			}
+		}
+
+		// What LLPolyMorphTarget::apply() used to do, normalizing after
+		// every morph
+		void applyMorphOld(TestMesh& mesh, const TestMorph& morph)
+		{
+			for (U32 i = 0; i < morph.mVertexIndices.size(); i++)
+			{
+				S32 v = morph.mVertexIndices[i];
+				F32 mask_weight = morph.mMaskWeights.empty() ? 1.f : morph.mMaskWeights[i];
+				mesh.mCoords[v] += morph.mCoords[i] * morph.mWeight * mask_weight;
+				if (morph.mClothing)
+				{
+					LLVector3 clothing_offset = morph.mCoords[i] * morph.mWeight * mask_weight;
+					mesh.mClothingWeights[v].mV[VX] += clothing_offset.mV[VX];
+					mesh.mClothingWeights[v].mV[VY] += clothing_offset.mV[VY];
+					mesh.mClothingWeights[v].mV[VZ] += clothing_offset.mV[VZ];
+					mesh.mClothingWeights[v].mV[VW] = mask_weight;
+				}
+				mesh.mScaledNormals[v] += morph.mNormals[i] * morph.mWeight * mask_weight * NORMAL_FACTOR;
+				LLVector3 normal = mesh.mScaledNormals[v];
+				normal.normVec();
+				mesh.mNormals[v] = normal;
+				mesh.mScaledBinormals[v] += morph.mBinormals[i] * morph.mWeight * mask_weight * NORMAL_FACTOR;
+				LLVector3 binormal = normal % (mesh.mScaledBinormals[v] % normal);
+				binormal.normVec();
+				mesh.mBinormals[v] = binormal;
+				mesh.mTexCoords[v] += morph.mTexCoords[i] * morph.mWeight * mask_weight;
+			}
+		}
+
+		void ensureClose(const std::string& msg, const TestMesh& a, const TestMesh& b, F32 tolerance)
+		{
+			for (S32 i = 0; i < NUM_VERTICES; i++)
+			{
+				ensure(msg + " coords", dist_vec(a.mCoords[i], b.mCoords[i]) <= tolerance);
+				ensure(msg + " normals", dist_vec(a.mNormals[i], b.mNormals[i]) <= tolerance);
+				ensure(msg + " scaled normals", dist_vec(a.mScaledNormals[i], b.mScaledNormals[i]) <= tolerance);
+				ensure(msg + " binormals", dist_vec(a.mBinormals[i], b.mBinormals[i]) <= tolerance);
+				ensure(msg + " scaled binormals", dist_vec(a.mScaledBinormals[i], b.mScaledBinormals[i]) <= tolerance);
+				ensure(msg + " tex coords", dist_vec(a.mTexCoords[i], b.mTexCoords[i]) <= tolerance);
+				ensure(msg + " clothing weights", dist_vec(a.mClothingWeights[i], b.mClothingWeights[i]) <= tolerance);
+			}
+		}
+
+		LLTestRand mRand;
+	};
+	typedef test_group<morphaccumulator_data> morphaccumulator_test;
+	typedef morphaccumulator_test::object morphaccumulator_object;
+	tut::morphaccumulator_test morphaccumulator_testcase("LLMorphAccumulator");
+
+	template<> template<>
+	void morphaccumulator_object::test<1>()
+	{
+		// the vectorized and reference versions agree
+		TestMesh fast;
+		makeMesh(fast);
+		TestMesh reference = fast;
+		std::vector<TestMorph> morphs;
+		makeMorphs(morphs, 12);
+
+		LLMorphAccumulator* fast_accumulator = fast.newAccumulator();
+		LLMorphAccumulator* reference_accumulator = reference.newAccumulator();
+		for (S32 round = 0; round < 3; round++)
+		{
+			for (S32 m = round; m < (S32)morphs.size(); m += 3)
+			{
+				addMorph(fast_accumulator, morphs[m], false);
+				addMorph(reference_accumulator, morphs[m], true);
+			}
+			ensure_equals("moved", fast_accumulator->getNumMoved(), reference_accumulator->getNumMoved());
+			fast_accumulator->normalize();
+			reference_accumulator->normalizeReference();
+			ensure_equals("normalized", fast_accumulator->getNumMoved(), 0);
+			ensureClose("vectorized", fast, reference, 1.e-6f);
+		}
+		delete fast_accumulator;
+		delete reference_accumulator;
+	}
+
+	template<> template<>
+	void morphaccumulator_object::test<2>()
+	{
+		// normalizing once after all the morphs gives the vertices the old
+		// loop did normalizing after each of them
+		TestMesh accumulated;
+		makeMesh(accumulated);
+		TestMesh old = accumulated;
+		std::vector<TestMorph> morphs;
+		makeMorphs(morphs, 20);
+
+		LLMorphAccumulator* accumulator = accumulated.newAccumulator();
+		for (S32 m = 0; m < (S32)morphs.size(); m++)
+		{
+			addMorph(accumulator, morphs[m], false);
+			applyMorphOld(old, morphs[m]);
+		}
+		accumulator->normalize();
+		delete accumulator;
+		ensureClose("old loop", accumulated, old, 1.e-5f);
+	}
+
+	template<> template<>
+	void morphaccumulator_object::test<3>()
+	{
+		// only the vertices of the morph move, clothing morphs set the mask
+		// weight and removing a morph brings the coords back
+		TestMesh mesh;
+		makeMesh(mesh);
+		TestMesh before = mesh;
+		std::vector<TestMorph> morphs;
+		makeMorphs(morphs, 2);
+		TestMorph& morph = morphs[1];
+		ensure("clothing morph", morph.mClothing);
+		ensure("masked morph", !morph.mMaskWeights.empty());
+
+		LLMorphAccumulator* accumulator = mesh.newAccumulator();
+		addMorph(accumulator, morph, false);
+		ensure_equals("moved", accumulator->getNumMoved(), (S32)morph.mVertexIndices.size());
+		accumulator->normalize();
+
+		U32 first = morph.mVertexIndices.front();
+		U32 last = morph.mVertexIndices.back();
+		for (U32 i = 0; i < (U32)NUM_VERTICES; i++)
+		{
+			if (i < first || i > last)
+			{
+				ensure("coords kept", mesh.mCoords[i] == before.mCoords[i]);
+				ensure("normals kept", mesh.mNormals[i] == before.mNormals[i]);
+				ensure("clothing weights kept", mesh.mClothingWeights[i] == before.mClothingWeights[i]);
+			}
+			else
+			{
+				ensure_equals("mask weight", mesh.mClothingWeights[i].mV[VW], morph.mMaskWeights[i - first]);
+				ensure_distance("normal length", mesh.mNormals[i].magVec(), 1.f, 1.e-5f);
+				ensure_distance("binormal length", mesh.mBinormals[i].magVec(), 1.f, 1.e-5f);
+				ensure_distance("orthogonal", mesh.mNormals[i] * mesh.mBinormals[i], 0.f, 1.e-5f);
+			}
+		}
+
+		morph.mWeight = -morph.mWeight;
+		addMorph(accumulator, morph, false);
+		accumulator->normalize();
+		delete accumulator;
+		for (S32 i = 0; i < NUM_VERTICES; i++)
+		{
+			ensure("coords back", dist_vec(mesh.mCoords[i], before.mCoords[i]) <= 1.e-6f);
+			ensure("tex coords back", dist_vec(mesh.mTexCoords[i], before.mTexCoords[i]) <= 1.e-6f);
+		}
+	}
+}
@@ -0,0 +1,244 @@
+/**
+ * @file llskinningkernel_test.cpp
+ * @brief Tests of LLMorphAccumulator against the viewer's old morph loop
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "m3math.h"
+#include "m4math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#include "../llskinningkernel.h"
+
+#include "../test/lltestrand.h"
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace tut
+{
+	const S32 NUM_JOINTS = 16;
+	// Floats per output vertex, more than a coord and a normal like the
+	// avatar vertex buffers
+	const U32 OUT_STRIDE_FLOATS = 9;
+
+	struct TestSkinMesh
+	{
+		TestSkinMesh(U32 num_vertices) :
+			mWeights(num_vertices), mCoords(num_vertices), mNormals(num_vertices),
+			mJointMatrices(NUM_JOINTS), mOut(num_vertices * OUT_STRIDE_FLOATS)
+		{
+		}
+
+		LLSkinningJob getJob()
+		{
+			LLSkinningJob job;
+			job.mNumVertices = mCoords.size();
+			job.mWeights = &mWeights[0];
+			job.mCoords = &mCoords[0];
+			job.mNormals = &mNormals[0];
+			job.mJointMatrices = &mJointMatrices[0];
+			job.mOutCoords = (U8*)&mOut[0];
+			job.mOutNormals = (U8*)&mOut[3];
+			job.mOutStride = OUT_STRIDE_FLOATS * sizeof(F32);
+			return job;
+		}
+
+		std::vector<F32> mWeights;
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<LLMatrix4> mJointMatrices;
+		std::vector<F32> mOut;
+	};
+
+	struct skinningkernel_data
+	{
+		~skinningkernel_data()
+		{
+			LLSkinningKernel::setVariant(LLSkinningKernel::VARIANT_REFERENCE);
+		}
+
+		LLVector3 randomVector(F32 range)
+		{
+			F32 x = mRand.frand(-range, range);
+			F32 y = mRand.frand(-range, range);
+			F32 z = mRand.frand(-range, range);
+			return LLVector3(x, y, z);
+		}
+
+		// Runs of vertices on one joint, with a few blended between two and a
+		// few runs too short to fill a vector, like the avatar meshes
+		void makeMesh(TestSkinMesh& mesh)
+		{
+			U32 num_vertices = mesh.mCoords.size();
+			U32 index = 0;
+			while (index < num_vertices)
+			{
+				S32 joint = (S32)(mRand.frand(-0.5f, 0.5f) * (NUM_JOINTS - 2) + (NUM_JOINTS - 2) / 2);
+				joint = llclamp(joint, 0, NUM_JOINTS - 2);
+				U32 run = (U32)(mRand.frand(1.f, 21.f));
+				for (U32 i = 0; i < run && index < num_vertices; i++, index++)
+				{
+					F32 frac = mRand.frand(-1.f, 1.f) > 0.5f ? mRand.frand(0.f, 1.f) : 0.f;
+					mesh.mWeights[index] = joint + frac;
+				}
+			}
+			for (U32 i = 0; i < num_vertices; i++)
+			{
+				mesh.mCoords[i] = randomVector(1.f);
+				mesh.mNormals[i] = randomVector(1.f);
+				mesh.mNormals[i].normVec();
+			}
+			for (S32 j = 0; j < NUM_JOINTS; j++)
+			{
+				LLMatrix4& mat = mesh.mJointMatrices[j];
+				mat.initRotTrans(mRand.frand(-3.f, 3.f), mRand.frand(-3.f, 3.f), mRand.frand(-3.f, 3.f), LLVector4(randomVector(2.f)));
+			}
+		}
+
+		void ensureSame(const std::string& msg, const TestSkinMesh& a, const TestSkinMesh& b)
+		{
+			for (U32 i = 0; i < a.mOut.size(); i++)
+			{
+				if (i % OUT_STRIDE_FLOATS >= 6)
+				{
+					// between the vertices
+					ensure_equals(msg + " untouched", b.mOut[i], a.mOut[i]);
+				}
+				else
+				{
+					ensure_approximately_equals(msg.c_str(), b.mOut[i], a.mOut[i], 18);
+				}
+			}
+		}
+
+		LLTestRand mRand;
+	};
+	typedef test_group<skinningkernel_data> skinningkernel_test;
+	typedef skinningkernel_test::object skinningkernel_object;
+	tut::skinningkernel_test skinningkernel_testcase("LLSkinningKernel");
+
+	template<> template<>
+	void skinningkernel_object::test<1>()
+	{
+		// every variant built and runnable here matches the reference, for
+		// several meshes per call and vertex counts that don't fill vectors
+		const U32 sizes[] = { 1, 7, 8, 13, 300, 2211 };
+		const U32 num_meshes = LL_ARRAY_SIZE(sizes);
+		std::vector<TestSkinMesh*> reference;
+		for (U32 i = 0; i < num_meshes; i++)
+		{
+			reference.push_back(new TestSkinMesh(sizes[i]));
+			makeMesh(*reference[i]);
+		}
+
+		std::vector<LLSkinningJob> jobs;
+		for (U32 i = 0; i < num_meshes; i++)
+		{
+			jobs.push_back(reference[i]->getJob());
+		}
+		LLSkinningKernel::skinReference(&jobs[0], jobs.size());
+
+		for (S32 variant = LLSkinningKernel::VARIANT_SSE2; variant < LLSkinningKernel::VARIANT_COUNT; variant++)
+		{
+			if (!LLSkinningKernel::isAvailable((LLSkinningKernel::EVariant)variant))
+			{
+				continue;
+			}
+			ensure("set variant", LLSkinningKernel::setVariant((LLSkinningKernel::EVariant)variant));
+
+			std::vector<TestSkinMesh> meshes;
+			for (U32 i = 0; i < num_meshes; i++)
+			{
+				meshes.push_back(*reference[i]);
+				std::fill(meshes[i].mOut.begin(), meshes[i].mOut.end(), 0.f);
+			}
+			jobs.clear();
+			for (U32 i = 0; i < num_meshes; i++)
+			{
+				jobs.push_back(meshes[i].getJob());
+			}
+			LLSkinningKernel::skin(&jobs[0], jobs.size());
+
+			for (U32 i = 0; i < num_meshes; i++)
+			{
+				ensureSame(LLSkinningKernel::getVariantName((LLSkinningKernel::EVariant)variant),
+						   *reference[i], meshes[i]);
+			}
+		}
+
+		for (U32 i = 0; i < num_meshes; i++)
+		{
+			delete reference[i];
+		}
+	}
+
+	template<> template<>
+	void skinningkernel_object::test<2>()
+	{
+		// the reference transforms coords by the blended matrix, normals by
+		// its rotation
+		TestSkinMesh mesh(2);
+		makeMesh(mesh);
+		mesh.mWeights[0] = 3.f;
+		mesh.mWeights[1] = 4.25f;
+		std::fill(mesh.mOut.begin(), mesh.mOut.end(), 0.f);
+		LLSkinningJob job = mesh.getJob();
+		LLSkinningKernel::skinReference(&job, 1);
+
+		LLVector3 coord = mesh.mCoords[0] * mesh.mJointMatrices[3];
+		LLVector3 normal = mesh.mNormals[0] * mesh.mJointMatrices[3].getMat3();
+		ensure_approximately_equals("unblended x", mesh.mOut[0], coord.mV[VX], 18);
+		ensure_approximately_equals("unblended y", mesh.mOut[1], coord.mV[VY], 18);
+		ensure_approximately_equals("unblended z", mesh.mOut[2], coord.mV[VZ], 18);
+		ensure_approximately_equals("unblended normal x", mesh.mOut[3], normal.mV[VX], 18);
+		ensure_approximately_equals("unblended normal y", mesh.mOut[4], normal.mV[VY], 18);
+		ensure_approximately_equals("unblended normal z", mesh.mOut[5], normal.mV[VZ], 18);
+
+		LLVector3 coord4 = mesh.mCoords[1] * mesh.mJointMatrices[4];
+		LLVector3 coord5 = mesh.mCoords[1] * mesh.mJointMatrices[5];
+		coord = lerp(coord4, coord5, 0.25f);
+		const F32* out = &mesh.mOut[OUT_STRIDE_FLOATS];
+		ensure_approximately_equals("blended x", out[0], coord.mV[VX], 16);
+		ensure_approximately_equals("blended y", out[1], coord.mV[VY], 16);
+		ensure_approximately_equals("blended z", out[2], coord.mV[VZ], 16);
+	}
+
+	template<> template<>
+	void skinningkernel_object::test<3>()
+	{
+		// only available variants can be set
+		ensure("reference available", LLSkinningKernel::isAvailable(LLSkinningKernel::VARIANT_REFERENCE));
+		for (S32 variant = 0; variant < LLSkinningKernel::VARIANT_COUNT; variant++)
+		{
+			LLSkinningKernel::EVariant v = (LLSkinningKernel::EVariant)variant;
+			ensure_equals(LLSkinningKernel::getVariantName(v), LLSkinningKernel::setVariant(v), LLSkinningKernel::isAvailable(v));
+			if (LLSkinningKernel::isAvailable(v))
+			{
+				ensure_equals("current", LLSkinningKernel::getVariant(), v);
+			}
+		}
+	}
+}
@@ -167,6 +167,8 @@ public:
 	void operator +=(Type x) { apr_atomic_add32(&mData, apr_uint32_t(x)); }
 	Type operator ++(int) { return apr_atomic_inc32(&mData); } // Type++
 	Type operator --(int) { return apr_atomic_dec32(&mData); } // Type--
+	// Sets the value to x if it is cmp, returns the previous value
+	Type compareAndSwap(Type cmp, Type x) { return Type(apr_atomic_cas32(&mData, apr_uint32_t(x), apr_uint32_t(cmp))); }
 	
 private:
 	apr_uint32_t mData;
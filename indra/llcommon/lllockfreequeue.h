@@ -0,0 +1,195 @@
+/**
+ * @file lllockfreequeue.h
+ * @brief Bounded lock free FIFO for handing elements over between threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLLOCKFREEQUEUE_H
+#define LL_LLLOCKFREEQUEUE_H
+
+#include "apr_atomic.h"
+
+//============================================================================
+// A fixed capacity ring buffer any number of threads may push to and pop
+// from without taking a lock, so it serves single producer/single consumer
+// and multiple producers/single consumer handoffs alike. It costs one
+// atomic compare and swap per push and per pop.
+//
+// Each slot carries a sequence number telling whether it is free for the
+// push at a given position or full for the pop at that position. A thread
+// claims a position by advancing the push (pop) counter, copies the element
+// and then publishes the slot by updating its sequence number. Nothing ever
+// blocks: tryPush() fails when the ring is full and tryPop() when it is
+// empty, the caller picks the fallback (see LLQueuedThread).
+//
+// Type must be copyable, elements are copied in and out.
+
+template <typename Type>
+class LLLockFreeQueue
+{
+public:
+	// capacity is rounded up to a power of 2
+	LLLockFreeQueue(U32 capacity = 1024);
+	~LLLockFreeQueue();
+
+	// May be called from any thread. Return false when full (empty).
+	bool tryPush(const Type& element);
+	bool tryPop(Type& element);
+
+	// Only exact while no push or pop is in progress
+	U32 size();
+	bool empty() { return size() == 0; }
+	U32 getCapacity() const { return mMask + 1; }
+
+private:
+	// No copy constructor or copy assignment
+	LLLockFreeQueue(const LLLockFreeQueue&);
+	LLLockFreeQueue& operator=(const LLLockFreeQueue&);
+
+	struct Slot
+	{
+		volatile apr_uint32_t mSequence;
+		Type mElement;
+	};
+
+	// Keep the counters the producers and the consumers spin on out of
+	// each other's cache lines
+	enum { CACHE_LINE_SIZE = 64 };
+
+	Slot* mSlots;
+	U32 mMask;
+	char mPad0[CACHE_LINE_SIZE];
+	volatile apr_uint32_t mPushPos;
+	char mPad1[CACHE_LINE_SIZE];
+	volatile apr_uint32_t mPopPos;
+	char mPad2[CACHE_LINE_SIZE];
+};
+
+//----------------------------------------------------------------------------
+
+template <typename Type>
+LLLockFreeQueue<Type>::LLLockFreeQueue(U32 capacity)
+{
+	U32 size = 2;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	mMask = size - 1;
+	mSlots = new Slot[size];
+	for (U32 i = 0; i < size; i++)
+	{
+		apr_atomic_set32(&mSlots[i].mSequence, i);
+	}
+	apr_atomic_set32(&mPushPos, 0);
+	apr_atomic_set32(&mPopPos, 0);
+}
+
+template <typename Type>
+LLLockFreeQueue<Type>::~LLLockFreeQueue()
+{
+	delete[] mSlots;
+}
+
+template <typename Type>
+bool LLLockFreeQueue<Type>::tryPush(const Type& element)
+{
+	Slot* slot;
+	apr_uint32_t pos = apr_atomic_read32(&mPushPos);
+	while (1)
+	{
+		slot = &mSlots[pos & mMask];
+		S32 dif = (S32)(apr_atomic_read32(&slot->mSequence) - pos);
+		if (dif == 0)
+		{
+			// Free for this position, claim it
+			apr_uint32_t prev = apr_atomic_cas32(&mPushPos, pos + 1, pos);
+			if (prev == pos)
+			{
+				break;
+			}
+			pos = prev;
+		}
+		else if (dif < 0)
+		{
+			// Not popped yet since the previous lap: full
+			return false;
+		}
+		else
+		{
+			// Another producer got it first
+			pos = apr_atomic_read32(&mPushPos);
+		}
+	}
+	slot->mElement = element;
+	// Full barrier: the element is visible before the slot reads as full
+	apr_atomic_xchg32(&slot->mSequence, pos + 1);
+	return true;
+}
+
+template <typename Type>
+bool LLLockFreeQueue<Type>::tryPop(Type& element)
+{
+	Slot* slot;
+	apr_uint32_t pos = apr_atomic_read32(&mPopPos);
+	while (1)
+	{
+		slot = &mSlots[pos & mMask];
+		S32 dif = (S32)(apr_atomic_read32(&slot->mSequence) - (pos + 1));
+		if (dif == 0)
+		{
+			// Full for this position, claim it
+			apr_uint32_t prev = apr_atomic_cas32(&mPopPos, pos + 1, pos);
+			if (prev == pos)
+			{
+				break;
+			}
+			pos = prev;
+		}
+		else if (dif < 0)
+		{
+			// Not pushed yet: empty
+			return false;
+		}
+		else
+		{
+			// Another consumer got it first
+			pos = apr_atomic_read32(&mPopPos);
+		}
+	}
+	element = slot->mElement;
+	// Full barrier: the element is copied out before the slot reads as free
+	apr_atomic_xchg32(&slot->mSequence, pos + mMask + 1);
+	return true;
+}
+
+template <typename Type>
+U32 LLLockFreeQueue<Type>::size()
+{
+	apr_uint32_t pop_pos = apr_atomic_read32(&mPopPos);
+	apr_uint32_t push_pos = apr_atomic_read32(&mPushPos);
+	S32 size = (S32)(push_pos - pop_pos);
+	return size > 0 ? (U32)size : 0;
+}
+
+#endif // LL_LLLOCKFREEQUEUE_H
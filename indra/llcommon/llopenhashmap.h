@@ -0,0 +1,305 @@
+/**
+ * @file llopenhashmap.h
+ * @brief Open addressing hash map for small keys looked up in hot loops.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOPENHASHMAP_H
+#define LL_LLOPENHASHMAP_H
+
+#include <utility>
+#include <vector>
+
+//============================================================================
+// A hash map keeping its elements in a single array, for keys that are
+// cheap to copy and compare such as packet ids, hosts or local ids. Lookups
+// hash the key to a slot and walk the following slots (linear probing), so
+// finding an element usually touches one cache line and inserting or
+// erasing one never allocates unless the table grows.
+//
+// The table is a power of 2 slots at most half full. Erasing moves the
+// elements after the erased one back into the hole instead of leaving a
+// tombstone, so lookups never slow down as elements come and go.
+//
+// Like std::map, iterators point to std::pair<Key, Value> and stay valid
+// until the map is modified, except for erase(iterator) which returns the
+// next element. Iteration is in no particular order, and an element moved
+// back by erase(iterator) may be visited a second time, but never skipped.
+//
+// Hash turns a key into a U32, which is scrambled before use, so the
+// identity is fine for integer keys.
+
+template <typename Key>
+struct LLOpenHashMapHash
+{
+	U32 operator()(const Key& key) const { return (U32)key; }
+};
+
+// 64 bit keys often pack two small ids, such as a region index and a
+// local id. Scramble the high half before folding it in, or the ids of
+// different regions would collide.
+template <>
+struct LLOpenHashMapHash<U64>
+{
+	U32 operator()(const U64& key) const { return (U32)key ^ ((U32)(key >> 32) * 2246822519U); }
+};
+
+template <typename Key, typename Value, typename Hash = LLOpenHashMapHash<Key> >
+class LLOpenHashMap
+{
+public:
+	typedef std::pair<Key, Value> value_type;
+
+private:
+	struct Slot
+	{
+		Slot() : mUsed(false) {}
+		value_type mValue;
+		bool mUsed;
+	};
+	typedef std::vector<Slot> slot_list_t;
+
+	template <typename Map, typename Type>
+	class iterator_base
+	{
+	public:
+		iterator_base() : mMap(NULL), mIndex(0) {}
+		iterator_base(Map* map, U32 index) : mMap(map), mIndex(index) {}
+
+		Type& operator*() const { return mMap->mSlots[mIndex].mValue; }
+		Type* operator->() const { return &mMap->mSlots[mIndex].mValue; }
+		iterator_base& operator++()
+		{
+			mIndex = mMap->nextUsed(mIndex + 1);
+			return *this;
+		}
+		bool operator==(const iterator_base& other) const { return mIndex == other.mIndex; }
+		bool operator!=(const iterator_base& other) const { return mIndex != other.mIndex; }
+
+	private:
+		friend class LLOpenHashMap;
+		Map* mMap;
+		U32 mIndex;
+	};
+
+public:
+	template <typename Map, typename Type> friend class iterator_base;
+	typedef iterator_base<LLOpenHashMap, value_type> iterator;
+	typedef iterator_base<const LLOpenHashMap, const value_type> const_iterator;
+
+	// capacity is the number of elements the map takes before growing
+	LLOpenHashMap(U32 capacity = 8) : mSize(0)
+	{
+		allocate(capacity);
+	}
+
+	iterator begin()				{ return iterator(this, nextUsed(0)); }
+	iterator end()					{ return iterator(this, getSlotCount()); }
+	const_iterator begin() const	{ return const_iterator(this, nextUsed(0)); }
+	const_iterator end() const		{ return const_iterator(this, getSlotCount()); }
+
+	U32 size() const				{ return mSize; }
+	bool empty() const				{ return mSize == 0; }
+
+	iterator find(const Key& key)
+	{
+		return iterator(this, findSlot(key));
+	}
+
+	const_iterator find(const Key& key) const
+	{
+		return const_iterator(this, findSlot(key));
+	}
+
+	U32 count(const Key& key) const
+	{
+		return findSlot(key) != getSlotCount() ? 1 : 0;
+	}
+
+	// Returns the element with this key, inserting a default constructed
+	// value first if there is none
+	Value& operator[](const Key& key)
+	{
+		return insert(value_type(key, Value())).first->second;
+	}
+
+	// Like std::map, does nothing and returns false if the key is there
+	std::pair<iterator, bool> insert(const value_type& value)
+	{
+		U32 index = findSlot(value.first);
+		if (index != getSlotCount())
+		{
+			return std::make_pair(iterator(this, index), false);
+		}
+		if ((mSize + 1) * 2 > getSlotCount())
+		{
+			grow();
+		}
+		index = homeSlot(value.first);
+		while (mSlots[index].mUsed)
+		{
+			index = (index + 1) & mMask;
+		}
+		mSlots[index].mValue = value;
+		mSlots[index].mUsed = true;
+		mSize++;
+		return std::make_pair(iterator(this, index), true);
+	}
+
+	// Returns the number of elements erased, 0 or 1
+	U32 erase(const Key& key)
+	{
+		U32 index = findSlot(key);
+		if (index == getSlotCount())
+		{
+			return 0;
+		}
+		eraseSlot(index);
+		return 1;
+	}
+
+	// Returns the element after the erased one, which may be one that was
+	// already visited (see above)
+	iterator erase(iterator iter)
+	{
+		eraseSlot(iter.mIndex);
+		return iterator(this, nextUsed(iter.mIndex));
+	}
+
+	// Keeps the capacity, like std::vector
+	void clear()
+	{
+		if (mSize)
+		{
+			for (typename slot_list_t::iterator iter = mSlots.begin(); iter != mSlots.end(); ++iter)
+			{
+				*iter = Slot();
+			}
+			mSize = 0;
+		}
+	}
+
+	void swap(LLOpenHashMap& other)
+	{
+		mSlots.swap(other.mSlots);
+		std::swap(mMask, other.mMask);
+		std::swap(mShift, other.mShift);
+		std::swap(mSize, other.mSize);
+	}
+
+private:
+	U32 getSlotCount() const { return mMask + 1; }
+
+	// Fibonacci hashing: the top bits of the product depend on all the
+	// bits of the hash, so consecutive ids spread over the table
+	U32 homeSlot(const Key& key) const
+	{
+		return (U32)(mHash(key) * 2654435769U) >> mShift;
+	}
+
+	// Returns getSlotCount() if the key is not there
+	U32 findSlot(const Key& key) const
+	{
+		U32 index = homeSlot(key);
+		while (mSlots[index].mUsed)
+		{
+			if (mSlots[index].mValue.first == key)
+			{
+				return index;
+			}
+			index = (index + 1) & mMask;
+		}
+		return getSlotCount();
+	}
+
+	U32 nextUsed(U32 index) const
+	{
+		const U32 slot_count = getSlotCount();
+		while (index < slot_count && !mSlots[index].mUsed)
+		{
+			index++;
+		}
+		return index;
+	}
+
+	void eraseSlot(U32 hole)
+	{
+		// Move back every element of the run after the hole that would not
+		// be found from its home slot anymore
+		U32 index = hole;
+		while (1)
+		{
+			index = (index + 1) & mMask;
+			if (!mSlots[index].mUsed)
+			{
+				break;
+			}
+			U32 home = homeSlot(mSlots[index].mValue.first);
+			bool reachable = (hole <= index) ? (hole < home && home <= index)
+											 : (hole < home || home <= index);
+			if (!reachable)
+			{
+				mSlots[hole].mValue = mSlots[index].mValue;
+				hole = index;
+			}
+		}
+		mSlots[hole] = Slot();
+		mSize--;
+	}
+
+	void allocate(U32 capacity)
+	{
+		U32 slot_count = 16;
+		mShift = 28;
+		while (slot_count < capacity * 2)
+		{
+			slot_count <<= 1;
+			mShift--;
+		}
+		mSlots.assign(slot_count, Slot());
+		mMask = slot_count - 1;
+	}
+
+	void grow()
+	{
+		slot_list_t slots;
+		slots.swap(mSlots);
+		allocate(slots.size());
+		mSize = 0;
+		for (typename slot_list_t::iterator iter = slots.begin(); iter != slots.end(); ++iter)
+		{
+			if (iter->mUsed)
+			{
+				insert(iter->mValue);
+			}
+		}
+	}
+
+	slot_list_t mSlots;
+	U32 mMask;
+	U32 mShift;
+	U32 mSize;
+	Hash mHash;
+};
+
+#endif // LL_LLOPENHASHMAP_H
@@ -132,7 +132,8 @@ namespace
 		eMONTIOR_MWAIT=33,
 		eCPLDebugStore=34,
 		eThermalMonitor2=35,
-		eAltivec=36
+		eAltivec=36,
+		eAVX2_Ext=37
 	};
 
 	const char* cpu_feature_names[] =
@@ -175,7 +176,9 @@ namespace
 		"CPL Qualified Debug Store",
 		"Thermal Monitor 2",
 
-		"Altivec"
+		"Altivec",
+
+		"AVX2 Extensions"
 	};
 
 	std::string intel_CPUFamilyName(int composed_family) 
@@ -275,6 +278,11 @@ public:
 		return hasExtension("Altivec"); 
 	}
 
+	bool hasAVX2() const
+	{
+		return hasExtension(cpu_feature_names[eAVX2_Ext]);
+	}
+
 	std::string getCPUFamilyName() const { return getInfo(eFamilyName, "Unknown").asString(); }
 	std::string getCPUBrandName() const { return getInfo(eBrandName, "Unknown").asString(); }
 
@@ -494,6 +502,8 @@ private:
 		*((int*)(cpu_vendor+8)) = cpu_info[2];
 		setInfo(eVendor, cpu_vendor);
 
+		bool os_saves_ymm = false;
+
 		// Get the information associated with each valid Id
 		for(unsigned int i=0; i<=ids; ++i)
 		{
@@ -536,6 +546,10 @@ private:
 				{
 					setExtension(cpu_feature_names[eThermalMonitor2]);
 				}
+
+				// AVX also needs the OS to save the YMM registers
+				// (OSXSAVE and AVX bits, then XCR0 bits 1 and 2)
+				os_saves_ymm = (cpu_info[2] & 0x18000000) == 0x18000000;
 						
 				unsigned int feature_info = (unsigned int) cpu_info[3];
 				for(unsigned int index = 0, bit = 1; index < eSSE3_Features; ++index, bit <<= 1)
@@ -548,6 +562,18 @@ private:
 			}
 		}
 
+#if _MSC_FULL_VER >= 160040219
+		// __cpuidex and _xgetbv need VS2010 SP1
+		if (ids >= 7 && os_saves_ymm && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(cpu_info, 7, 0);
+			if (cpu_info[1] & 0x20)
+			{
+				setExtension(cpu_feature_names[eAVX2_Ext]);
+			}
+		}
+#endif
+
 		// Calling __cpuid with 0x80000000 as the InfoType argument
 		// gets the number of valid extended IDs.
 		__cpuid(cpu_info, 0x80000000);
@@ -707,6 +733,11 @@ private:
 #endif // LL_RELEASE_FOR_DOWNLOAD 	
 
 
+		if (getSysctlInt("hw.optional.avx2_0"))
+		{
+			setExtension(cpu_feature_names[eAVX2_Ext]);
+		}
+
 		uint64_t ext_feature_info = getSysctlInt64("machdep.cpu.extfeature_bits");
 		S32 *ext_feature_infos = (S32*)(&ext_feature_info);
 		setConfig(eExtFeatureBits, ext_feature_infos[0]);
@@ -715,6 +746,8 @@ private:
 
 #elif LL_LINUX
 const char CPUINFO_FILE[] = "/proc/cpuinfo";
+// The flags lines of recent CPUs run well past MAX_STRING
+const S32 CPUINFO_LINE_LENGTH = 4096;
 
 class LLProcessorInfoLinuxImpl : public LLProcessorInfoImpl
 {
@@ -733,9 +766,9 @@ private:
 		LLFILE* cpuinfo_fp = LLFile::fopen(CPUINFO_FILE, "rb");
 		if(cpuinfo_fp)
 		{
-			char line[MAX_STRING];
-			memset(line, 0, MAX_STRING);
-			while(fgets(line, MAX_STRING, cpuinfo_fp))
+			char line[CPUINFO_LINE_LENGTH];
+			memset(line, 0, CPUINFO_LINE_LENGTH);
+			while(fgets(line, CPUINFO_LINE_LENGTH, cpuinfo_fp))
 			{
 				// /proc/cpuinfo on Linux looks like:
 				// name\t*: value\n
@@ -820,6 +853,12 @@ private:
 		{
 			setExtension(cpu_feature_names[eSSE2_Ext]);
 		}
+
+		// The kernel leaves avx2 out when it doesn't save the YMM registers
+		if( flags.find( " avx2 " ) != std::string::npos )
+		{
+			setExtension(cpu_feature_names[eAVX2_Ext]);
+		}
 	
 # endif // LL_X86
 	}
@@ -881,6 +920,7 @@ F64 LLProcessorInfo::getCPUFrequency() const { return mImpl->getCPUFrequency();
 bool LLProcessorInfo::hasSSE() const { return mImpl->hasSSE(); }
 bool LLProcessorInfo::hasSSE2() const { return mImpl->hasSSE2(); }
 bool LLProcessorInfo::hasAltivec() const { return mImpl->hasAltivec(); }
+bool LLProcessorInfo::hasAVX2() const { return mImpl->hasAVX2(); }
 std::string LLProcessorInfo::getCPUFamilyName() const { return mImpl->getCPUFamilyName(); }
 std::string LLProcessorInfo::getCPUBrandName() const { return mImpl->getCPUBrandName(); }
 std::string LLProcessorInfo::getCPUFeatureDescription() const { return mImpl->getCPUFeatureDescription(); }
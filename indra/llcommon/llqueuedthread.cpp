@@ -32,14 +32,25 @@
 //============================================================================
 
 // MAIN THREAD
-LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded) :
+LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, LLThreadPool* pool) :
 	LLThread(name),
 	mThreaded(threaded),
 	mIdleThread(TRUE),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mThreadPool(threaded ? pool : NULL),
+	mPoolTask(this),
+	mPoolPriorityClass(LLThreadPool::CLASS_NORMAL),
+	mPoolMaxConcurrency(1),
+	mPoolTasks(0),
+	mPoolTasksAlive(0)
 {
-	if (mThreaded)
+	if (mThreadPool)
+	{
+		// No thread of our own, but we are running as far as LLThread is concerned
+		mStatus = RUNNING;
+	}
+	else if (mThreaded)
 	{
 		start();
 	}
@@ -48,7 +59,7 @@ LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded) :
 // MAIN THREAD
 LLQueuedThread::~LLQueuedThread()
 {
-	if (!mThreaded)
+	if (!mThreaded || mThreadPool)
 	{
 		endThread();
 	}
@@ -61,7 +72,26 @@ void LLQueuedThread::shutdown()
 	setQuitting();
 
 	unpause(); // MAIN THREAD
-	if (mThreaded)
+	if (mThreadPool)
+	{
+		// Wait for the workers to be done with us
+		S32 timeout = 100;
+		for ( ; timeout>0; timeout--)
+		{
+			if (mPoolTasksAlive == 0)
+			{
+				break;
+			}
+			ms_sleep(100);
+			LLThread::yield();
+		}
+		if (timeout == 0)
+		{
+			llwarns << "~LLQueuedThread (" << mName << ") timed out waiting for " << mThreadPool->getName() << "!" << llendl;
+		}
+		mStatus = STOPPED;
+	}
+	else if (mThreaded)
 	{
 		S32 timeout = 100;
 		for ( ; timeout>0; timeout--)
@@ -83,6 +113,11 @@ void LLQueuedThread::shutdown()
 		mStatus = STOPPED;
 	}
 
+	deleteCompletedRequests();
+	lockData();
+	sortIncomingRequests();
+	unlockData();
+
 	QueuedRequest* req;
 	S32 active_count = 0;
 	while ( (req = (QueuedRequest*)mRequestHash.pop_element()) )
@@ -108,7 +143,7 @@ S32 LLQueuedThread::update(U32 max_time_ms)
 {
 	if (!mStarted)
 	{
-		if (!mThreaded)
+		if (!mThreaded || mThreadPool)
 		{
 			startThread();
 			mStarted = TRUE;
@@ -123,6 +158,8 @@ S32 LLQueuedThread::updateQueue(U32 max_time_ms)
 	LLTimer timer;
 	S32 pending = 1;
 
+	deleteCompletedRequests();
+
 	// Frame Update
 	if (mThreaded)
 	{
@@ -130,6 +167,10 @@ S32 LLQueuedThread::updateQueue(U32 max_time_ms)
 		if(pending > 0)
 		{
 		unpause();
+			if (mThreadPool)
+			{
+				postPoolTasks(pending);
+			}
 	}
 	}
 	else
@@ -140,29 +181,91 @@ S32 LLQueuedThread::updateQueue(U32 max_time_ms)
 			if (max_time && timer.getElapsedTimeF64() > max_time)
 				break;
 		}
+		deleteCompletedRequests();
 	}
 	return pending;
 }
 
+// Called with mQueueMutex locked
+void LLQueuedThread::sortIncomingRequests()
+{
+	QueuedRequest* req;
+	while (mIncomingRequests.tryPop(req))
+	{
+		mRequestHash.insert(req);
+		mRequestQueue.insert(req);
+	}
+}
+
+// Called with mQueueMutex locked
+LLQueuedThread::QueuedRequest* LLQueuedThread::findRequest(handle_t handle)
+{
+	sortIncomingRequests();
+	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+	if (req && (req->getFlags() & FLAG_COMPLETED))
+	{
+		// Auto completed, only waiting for update() to delete it
+		return NULL;
+	}
+	return req;
+}
+
+// Called with mQueueMutex locked
+S32 LLQueuedThread::getNumQueued()
+{
+	return mRequestQueue.size() + mIncomingRequests.size();
+}
+
+// Deletes the requests auto completed since the last call
+void LLQueuedThread::deleteCompletedRequests()
+{
+	QueuedRequest* req;
+	if (!mCompletedRequests.tryPop(req))
+	{
+		return;
+	}
+	lockData();
+	do
+	{
+		mRequestHash.erase(req);
+		req->deleteRequest();
+	}
+	while (mCompletedRequests.tryPop(req));
+	unlockData();
+}
+
 void LLQueuedThread::incQueue()
 {
 	// Something has been added to the queue
 	if (!isPaused())
 	{
-		if (mThreaded)
+		if (mThreadPool)
+		{
+			postPoolTasks(1);
+		}
+		else if (mThreaded)
 		{
 			wake(); // Wake the thread up if necessary.
 		}
 	}
 }
 
+// MAIN THREAD
+void LLQueuedThread::setPoolOptions(U32 priority_class, U32 max_concurrency)
+{
+	lockData();
+	mPoolPriorityClass = priority_class;
+	mPoolMaxConcurrency = llmax(max_concurrency, (U32)1);
+	unlockData();
+}
+
 //virtual
 // May be called from any thread
 S32 LLQueuedThread::getPending()
 {
 	S32 res;
 	lockData();
-	res = mRequestQueue.size();
+	res = getNumQueued();
 	unlockData();
 	return res;
 }
@@ -174,7 +277,7 @@ void LLQueuedThread::waitOnPending()
 	{
 		update(0);
 
-		if (mIdleThread)
+		if (mThreadPool ? mPoolTasks == 0 : (BOOL)mIdleThread)
 		{
 			break;
 		}
@@ -190,6 +293,7 @@ void LLQueuedThread::waitOnPending()
 void LLQueuedThread::printQueueStats()
 {
 	lockData();
+	sortIncomingRequests();
 	if (!mRequestQueue.empty())
 	{
 		QueuedRequest *req = *mRequestQueue.begin();
@@ -202,16 +306,16 @@ void LLQueuedThread::printQueueStats()
 	unlockData();
 }
 
-// MAIN thread
+// May be called from any thread. Handles are reused after 2^32 requests,
+// no request lives that long.
 LLQueuedThread::handle_t LLQueuedThread::generateHandle()
 {
-	lockData();
-	while ((mNextHandle == nullHandle()) || (mRequestHash.find(mNextHandle)))
+	handle_t res;
+	do
 	{
-		mNextHandle++;
+		res = mNextHandle++;
 	}
-	const LLQueuedThread::handle_t res = mNextHandle++;
-	unlockData();
+	while (res == nullHandle());
 	return res;
 }
 
@@ -223,14 +327,22 @@ bool LLQueuedThread::addRequest(QueuedRequest* req)
 		return false;
 	}
 	
-	lockData();
 	req->setStatus(STATUS_QUEUED);
-	mRequestQueue.insert(req);
-	mRequestHash.insert(req);
 #if _DEBUG
 // 	llinfos << llformat("LLQueuedThread::Added req [%08d]",handle) << llendl;
 #endif
-	unlockData();
+
+	// The handle is registered by whoever next sorts the ring in under the
+	// data lock: the processing thread or a handle lookup (findRequest()).
+	if (!mIncomingRequests.tryPush(req))
+	{
+		// Ring full, sort it in ourselves
+		lockData();
+		sortIncomingRequests();
+		mRequestHash.insert(req);
+		mRequestQueue.insert(req);
+		unlockData();
+	}
 
 	incQueue();
 
@@ -248,7 +360,7 @@ bool LLQueuedThread::waitForResult(LLQueuedThread::handle_t handle, bool auto_co
 	{
 		update(0); // unpauses
 		lockData();
-		QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+		QueuedRequest* req = findRequest(handle);
 		if (!req)
 		{
 			done = true; // request does not exist
@@ -286,7 +398,7 @@ LLQueuedThread::QueuedRequest* LLQueuedThread::getRequest(handle_t handle)
 		return 0;
 	}
 	lockData();
-	QueuedRequest* res = (QueuedRequest*)mRequestHash.find(handle);
+	QueuedRequest* res = findRequest(handle);
 	unlockData();
 	return res;
 }
@@ -295,7 +407,7 @@ LLQueuedThread::status_t LLQueuedThread::getRequestStatus(handle_t handle)
 {
 	status_t res = STATUS_EXPIRED;
 	lockData();
-	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+	QueuedRequest* req = findRequest(handle);
 	if (req)
 	{
 		res = req->getStatus();
@@ -307,7 +419,7 @@ LLQueuedThread::status_t LLQueuedThread::getRequestStatus(handle_t handle)
 void LLQueuedThread::abortRequest(handle_t handle, bool autocomplete)
 {
 	lockData();
-	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+	QueuedRequest* req = findRequest(handle);
 	if (req)
 	{
 		req->setFlags(FLAG_ABORT | (autocomplete ? FLAG_AUTO_COMPLETE : 0));
@@ -319,7 +431,7 @@ void LLQueuedThread::abortRequest(handle_t handle, bool autocomplete)
 void LLQueuedThread::setFlags(handle_t handle, U32 flags)
 {
 	lockData();
-	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+	QueuedRequest* req = findRequest(handle);
 	if (req)
 	{
 		req->setFlags(flags);
@@ -330,7 +442,7 @@ void LLQueuedThread::setFlags(handle_t handle, U32 flags)
 void LLQueuedThread::setPriority(handle_t handle, U32 priority)
 {
 	lockData();
-	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+	QueuedRequest* req = findRequest(handle);
 	if (req)
 	{
 		if(req->getStatus() == STATUS_INPROGRESS)
@@ -353,7 +465,7 @@ bool LLQueuedThread::completeRequest(handle_t handle)
 {
 	bool res = false;
 	lockData();
-	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+	QueuedRequest* req = findRequest(handle);
 	if (req)
 	{
 		llassert_always(req->getStatus() != STATUS_QUEUED);
@@ -398,6 +510,7 @@ S32 LLQueuedThread::processNextRequest()
 	QueuedRequest *req;
 	// Get next request from pool
 	lockData();
+	sortIncomingRequests();
 	while(1)
 	{
 		req = NULL;
@@ -445,9 +558,13 @@ S32 LLQueuedThread::processNextRequest()
 			req->finishRequest(true);
 			if (req->getFlags() & FLAG_AUTO_COMPLETE)
 			{
-				mRequestHash.erase(req);
-				req->deleteRequest();
-// 				check();
+				req->setFlags(FLAG_COMPLETED);
+				if (!mCompletedRequests.tryPush(req))
+				{
+					mRequestHash.erase(req);
+					req->deleteRequest();
+// 					check();
+				}
 			}
 			unlockData();
 		}
@@ -469,11 +586,80 @@ S32 LLQueuedThread::processNextRequest()
 	return pending;
 }
 
+//============================================================================
+// Shared thread pool
+
+// Posts up to count more PoolTasks, claiming each slot under
+// mPoolMaxConcurrency with a compare and swap on mPoolTasks.
+void LLQueuedThread::postPoolTasks(S32 count)
+{
+	while (count > 0)
+	{
+		S32 tasks = mPoolTasks;
+		if (tasks >= (S32)mPoolMaxConcurrency)
+		{
+			break;
+		}
+		if (mPoolTasks.compareAndSwap(tasks, tasks + 1) != tasks)
+		{
+			continue; // raced with another thread, look again
+		}
+		mPoolTasksAlive++;
+		if (!mThreadPool->post(&mPoolTask, mPoolPriorityClass))
+		{
+			// Pool shut down, the task will never run
+			mPoolTasks--;
+			mPoolTasksAlive--;
+			break;
+		}
+		count--;
+	}
+}
+
+// Runs on a WORKER THREAD of mThreadPool
+void LLQueuedThread::processPoolTask()
+{
+	S32 pending = 0;
+	if (!isQuitting() && !isPaused())
+	{
+		pending = processNextRequest();
+	}
+
+	// Keep this task going while there is enough work for it
+	if (!isQuitting() && !isPaused() && mPoolTasks <= pending)
+	{
+		if (!mThreadPool->post(&mPoolTask, mPoolPriorityClass))
+		{
+			// Pool shut down, retire it
+			mPoolTasks--;
+			mPoolTasksAlive--;
+		}
+		return;
+	}
+
+	// Retire it. unpause() and new requests will post it again, but a request
+	// added before mPoolTasks went down may have found every slot taken.
+	mPoolTasks--;
+	if (!isQuitting() && !isPaused() && getPending() > 0)
+	{
+		postPoolTasks(1);
+	}
+	// Once retired, 'this' may be deleted by the main thread: do not touch it anymore.
+	mPoolTasksAlive--;
+}
+
+//============================================================================
+
 // virtual
 bool LLQueuedThread::runCondition()
 {
 	// mRunCondition must be locked here
-	if (mRequestQueue.empty() && mIdleThread)
+	if (mThreadPool)
+	{
+		// Only reached through checkPause() from request processing on a pool worker
+		return true;
+	}
+	if (mRequestQueue.empty() && mIncomingRequests.empty() && mIdleThread)
 		return false;
 	else
 		return true;
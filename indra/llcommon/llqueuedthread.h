@@ -34,12 +34,30 @@
 
 #include "llapr.h"
 
+#include "lllockfreequeue.h"
 #include "llthread.h"
+#include "llthreadpool.h"
 #include "llsimplehash.h"
 
 //============================================================================
 // Note: ~LLQueuedThread is O(N) N=# of queued threads, assumed to be small
 //   It is assumed that LLQueuedThreads are rarely created/destroyed.
+//
+// A threaded LLQueuedThread given an LLThreadPool does not start a thread of
+// its own: requests are processed by the workers of the pool, by up to
+// setPoolOptions() max_concurrency workers at a time (1 by default, so
+// requests are still processed one at a time). startThread() and endThread()
+// are then called from the main thread and threadedUpdate() is not called.
+//
+// addRequest() hands new requests over to the processing thread through a
+// lock free ring without taking the data lock. Whoever next holds the lock to
+// pick a request or look a handle up moves them into the handle hash and the
+// priority queue, so handles are valid as soon as addRequest() returns.
+// generateHandle() still locks: it is called from several threads and must
+// skip handles in use once the counter wraps.
+// Completed FLAG_AUTO_COMPLETE requests are handed back the same way and
+// deleted in batches by update(). Handle lookups treat them as expired as
+// soon as they complete, as when they were deleted right away.
 
 class LL_COMMON_API LLQueuedThread : public LLThread
 {
@@ -66,7 +84,8 @@ public:
 	enum flags_t {
 		FLAG_AUTO_COMPLETE = 1,
 		FLAG_AUTO_DELETE = 2, // child-class dependent
-		FLAG_ABORT = 4
+		FLAG_ABORT = 4,
+		FLAG_COMPLETED = 0x40000000 // internal: in mCompletedRequests, waiting for update() to delete it
 	};
 
 	typedef U32 handle_t;
@@ -149,15 +168,43 @@ public:
 	static handle_t nullHandle() { return handle_t(0); }
 	
 public:
-	LLQueuedThread(const std::string& name, bool threaded = true);
+	LLQueuedThread(const std::string& name, bool threaded = true, LLThreadPool* pool = NULL);
 	virtual ~LLQueuedThread();	
 	virtual void shutdown();
+
+	// Call before adding requests. priority_class is an LLThreadPool::priority_class_t.
+	void setPoolOptions(U32 priority_class, U32 max_concurrency);
+	LLThreadPool* getThreadPool() { return mThreadPool; }
 	
 private:
 	// No copy constructor or copy assignment
 	LLQueuedThread(const LLQueuedThread&);
 	LLQueuedThread& operator=(const LLQueuedThread&);
 
+	// Processes requests on behalf of this queue on the pool workers.
+	// Each PoolTask posted to the pool counts in mPoolTasks.
+	class PoolTask : public LLThreadPool::Task
+	{
+	public:
+		PoolTask(LLQueuedThread* queued_thread) : mQueuedThread(queued_thread) {}
+		/*virtual*/ void executeTask() { mQueuedThread->processPoolTask(); }
+	private:
+		LLQueuedThread* mQueuedThread;
+	};
+	friend class PoolTask;
+
+	// Lock free, may be called from any thread
+	void postPoolTasks(S32 count);
+	void processPoolTask();
+
+	// mQueueMutex must be locked
+	void sortIncomingRequests();
+	S32 getNumQueued();
+	// mQueueMutex must be locked. NULL for unknown and auto completed requests.
+	QueuedRequest* findRequest(handle_t handle);
+
+	void deleteCompletedRequests();
+
 	virtual bool runCondition(void);
 	virtual void run(void);
 	virtual void startThread(void);
@@ -203,11 +250,25 @@ protected:
 	typedef std::set<QueuedRequest*, queued_request_less> request_queue_t;
 	request_queue_t mRequestQueue;
 
+	typedef LLLockFreeQueue<QueuedRequest*> request_ring_t;
+	request_ring_t mIncomingRequests; // added but not yet in mRequestHash and mRequestQueue
+	request_ring_t mCompletedRequests; // auto completed, deleted by update()
+
 	enum { REQUEST_HASH_SIZE = 512 }; // must be power of 2
 	typedef LLSimpleHash<handle_t, REQUEST_HASH_SIZE> request_hash_t;
 	request_hash_t mRequestHash;
 
-	handle_t mNextHandle;
+	LLAtomicU32 mNextHandle;
+
+	LLThreadPool* mThreadPool;
+	PoolTask mPoolTask;
+	U32 mPoolPriorityClass;
+	U32 mPoolMaxConcurrency;
+	LLAtomicS32 mPoolTasks; // posted and not yet retired PoolTasks, never more than mPoolMaxConcurrency
+	// Same count, decremented by a retiring PoolTask as the last thing it does
+	// with this queue. shutdown() waits for it, not for mPoolTasks: a retiring
+	// worker still looking for new requests must not find it deleted.
+	LLAtomicS32 mPoolTasksAlive;
 };
 
 #endif // LL_LLQUEUEDTHREAD_H
@@ -234,6 +234,8 @@ namespace
 	{
 	public:
 		ImplString(const LLSD::String& v) : Base(v) { }
+		ImplString(const char* s, size_t len) : Base(LLSD::String())
+			{ mValue.assign(s, len); }
 				
 		virtual LLSD::Boolean	asBoolean() const	{ return !mValue.empty(); }
 		virtual LLSD::Integer	asInteger() const;
@@ -319,6 +321,8 @@ namespace
 	{
 	public:
 		ImplBinary(const LLSD::Binary& v) : Base(v) { }
+		ImplBinary(const U8* data, size_t len) : Base(LLSD::Binary())
+			{ mValue.assign(data, data + len); }
 				
 		virtual LLSD::Binary	asBinary() const{ return mValue; }
 	};
@@ -715,6 +719,12 @@ void LLSD::assign(const Date& v)		{ safe(impl).assign(impl, v); }
 void LLSD::assign(const URI& v)			{ safe(impl).assign(impl, v); }
 void LLSD::assign(const Binary& v)		{ safe(impl).assign(impl, v); }
 
+// Buffer Assignment
+void LLSD::assignString(const char* s, size_t len)
+	{ Impl::reset(impl, new ImplString(s, len)); }
+void LLSD::assignBinary(const U8* data, size_t len)
+	{ Impl::reset(impl, new ImplBinary(data, len)); }
+
 // Scalar Accessors
 LLSD::Boolean	LLSD::asBoolean() const	{ return safe(impl).asBoolean(); }
 LLSD::Integer	LLSD::asInteger() const	{ return safe(impl).asInteger(); }
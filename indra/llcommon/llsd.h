@@ -152,6 +152,15 @@ public:
 		LLSD& operator=(const Binary& v)	{ assign(v); return *this; }
 	//@}
 
+	/** @name Buffer Assignment
+		Assign a String or Binary straight from len bytes of a buffer,
+		without first building a temporary String or Binary.
+	 */
+	//@{
+		void assignString(const char* s, size_t len);
+		void assignBinary(const U8* data, size_t len);
+	//@}
+
 	/**
 		@name Scalar Accessors
 		@brief Fetch a scalar value, converting if needed and possible
@@ -294,6 +294,336 @@ static const std::string NOTATION_FALSE_SERIAL("false");
 static const char BINARY_TRUE_SERIAL = '1';
 static const char BINARY_FALSE_SERIAL = '0';
 
+/**
+ * Buffer parsing helpers. pos is the next byte to parse, end one past the
+ * last byte of the buffer; pos never moves past end.
+ */
+namespace
+{
+	inline int buffer_get(const U8*& pos, const U8* end)
+	{
+		return (pos < end) ? *pos++ : EOF;
+	}
+
+	inline int buffer_peek(const U8* pos, const U8* end)
+	{
+		return (pos < end) ? *pos : EOF;
+	}
+
+	inline void buffer_skip_space(const U8*& pos, const U8* end)
+	{
+		while((pos < end) && isspace(*pos)) ++pos;
+	}
+
+	// Copies n bytes off the buffer, false when fewer are left.
+	inline bool buffer_read(const U8*& pos, const U8* end, void* dest, size_t n)
+	{
+		if((size_t)(end - pos) < n) return false;
+		memcpy(dest, pos, n);		/* Flawfinder: ignore */
+		pos += n;
+		return true;
+	}
+
+	// Reads a 4 byte network byte order size.
+	inline bool buffer_read_size(const U8*& pos, const U8* end, S32& size)
+	{
+		U32 size_nbo = 0;
+		if(!buffer_read(pos, end, &size_nbo, sizeof(U32))) return false;
+		size = (S32)ntohl(size_nbo);
+		return true;
+	}
+
+	/**
+	 * A string parsed off the buffer. It stays in place in the buffer
+	 * unless it had escapes to decode, so that assigning it copies the
+	 * bytes once.
+	 */
+	class BufferString
+	{
+	public:
+		BufferString() : mInPlace(false), mData(NULL), mLength(0) { }
+
+		void setInPlace(const U8* data, size_t length)
+		{
+			mInPlace = true;
+			mData = (const char*)data;
+			mLength = length;
+		}
+
+		std::string& decoded()
+		{
+			mInPlace = false;
+			return mDecoded;
+		}
+
+		void assignTo(LLSD& data) const
+		{
+			if(mInPlace) data.assignString(mData, mLength);
+			else data = mDecoded;
+		}
+
+		void assignTo(std::string& value) const
+		{
+			if(mInPlace) value.assign(mData, mLength);
+			else value = mDecoded;
+		}
+
+	private:
+		bool mInPlace;
+		const char* mData;
+		size_t mLength;
+		std::string mDecoded;
+	};
+
+	// Buffer version of deserialize_string_delim(), pos past the delimiter.
+	bool buffer_string_delim(
+		const U8*& pos,
+		const U8* end,
+		char delim,
+		BufferString& value)
+	{
+		// Most strings have nothing escaped and are used in place.
+		const U8* start = pos;
+		while((pos < end) && (*pos != (U8)delim) && (*pos != '\\'))
+		{
+			++pos;
+		}
+		if(pos == end) return false;
+		if(*pos == (U8)delim)
+		{
+			value.setInPlace(start, pos - start);
+			++pos;
+			return true;
+		}
+
+		std::string& write_buffer = value.decoded();
+		write_buffer.assign((const char*)start, pos - start);
+		bool found_escape = false;
+		bool found_hex = false;
+		bool found_digit = false;
+		U8 byte = 0;
+		while(pos < end)
+		{
+			char next_char = (char)*pos++;
+			if(found_escape)
+			{
+				// next character(s) is a special sequence.
+				if(found_hex)
+				{
+					if(found_digit)
+					{
+						found_digit = false;
+						found_hex = false;
+						found_escape = false;
+						byte = byte << 4;
+						byte |= hex_as_nybble(next_char);
+						write_buffer += (char)byte;
+						byte = 0;
+					}
+					else
+					{
+						// next character is the first nybble
+						found_digit = true;
+						byte = hex_as_nybble(next_char);
+					}
+				}
+				else if(next_char == 'x')
+				{
+					found_hex = true;
+				}
+				else
+				{
+					switch(next_char)
+					{
+					case 'a':
+						write_buffer += '\a';
+						break;
+					case 'b':
+						write_buffer += '\b';
+						break;
+					case 'f':
+						write_buffer += '\f';
+						break;
+					case 'n':
+						write_buffer += '\n';
+						break;
+					case 'r':
+						write_buffer += '\r';
+						break;
+					case 't':
+						write_buffer += '\t';
+						break;
+					case 'v':
+						write_buffer += '\v';
+						break;
+					default:
+						write_buffer += next_char;
+						break;
+					}
+					found_escape = false;
+				}
+			}
+			else if(next_char == '\\')
+			{
+				found_escape = true;
+			}
+			else if(next_char == delim)
+			{
+				return true;
+			}
+			else
+			{
+				write_buffer += next_char;
+			}
+		}
+		return false;
+	}
+
+	// Reads the (len) of the notation raw strings and binaries, strtol()
+	// like the stream parsers do.
+	bool buffer_raw_length(const U8*& pos, const U8* end, S32& len)
+	{
+		const S32 MAX_LENGTH_CHARS = 18;
+		if(buffer_peek(pos, end) != '(') return false;
+		const U8* close = pos + 1;
+		while((close < end) && (*close != ')') && (close - pos < MAX_LENGTH_CHARS))
+		{
+			++close;
+		}
+		if((close == end) || (*close != ')')) return false;
+		char buf[MAX_LENGTH_CHARS + 1];		/* Flawfinder: ignore */
+		S32 chars = (S32)(close - pos - 1);
+		memcpy(buf, pos + 1, chars);		/* Flawfinder: ignore */
+		buf[chars] = '\0';
+		len = strtol(buf, NULL, 0);
+		pos = close + 1;
+		return (len >= 0);
+	}
+
+	// Buffer version of deserialize_string_raw(): (len)"raw string"
+	bool buffer_string_raw(const U8*& pos, const U8* end, BufferString& value)
+	{
+		S32 len = 0;
+		if(!buffer_raw_length(pos, end, len)) return false;
+		int c = buffer_get(pos, end);
+		if(!((c == '"') || (c == '\''))) return false;
+		if(len > end - pos) return false;
+		value.setInPlace(pos, len);
+		pos += len;
+		c = buffer_get(pos, end);
+		return ((c == '"') || (c == '\''));
+	}
+
+	// Buffer version of deserialize_string().
+	bool buffer_string(const U8*& pos, const U8* end, BufferString& value)
+	{
+		int c = buffer_get(pos, end);
+		switch(c)
+		{
+		case '\'':
+		case '"':
+			return buffer_string_delim(pos, end, (char)c, value);
+		case 's':
+			return buffer_string_raw(pos, end, value);
+		default:
+			return false;
+		}
+	}
+
+	// Buffer version of deserialize_boolean(), the t or f already consumed.
+	bool buffer_boolean(const U8*& pos, const U8* end, const std::string& compare)
+	{
+		std::string::size_type ii = 1;
+		while((ii < compare.size())
+			  && (pos < end)
+			  && (tolower(*pos) == (int)compare[ii]))
+		{
+			++pos;
+			++ii;
+		}
+		return (compare.size() == ii);
+	}
+
+	// Like istr >> integer: optional white space and sign, decimal digits.
+	bool buffer_integer(const U8*& pos, const U8* end, S32& value)
+	{
+		buffer_skip_space(pos, end);
+		const U8* p = pos;
+		bool negative = false;
+		if((p < end) && ((*p == '-') || (*p == '+')))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+		const U8* digits = p;
+		S64 v = 0;
+		while((p < end) && isdigit(*p))
+		{
+			v = v * 10 + (*p - '0');
+			if(v > (S64)S32_MAX + 1) return false;
+			++p;
+		}
+		if(p == digits) return false;
+		if(negative) v = -v;
+		if(v > S32_MAX) return false;
+		value = (S32)v;
+		pos = p;
+		return true;
+	}
+
+	// Like istr >> real: optional white space, then what strtod() takes
+	// of the characters a real can have.
+	bool buffer_real(const U8*& pos, const U8* end, F64& value)
+	{
+		const S32 MAX_REAL_CHARS = 63;
+		buffer_skip_space(pos, end);
+		char buf[MAX_REAL_CHARS + 1];		/* Flawfinder: ignore */
+		S32 chars = 0;
+		while((pos + chars < end) && (chars < MAX_REAL_CHARS)
+			  && pos[chars] && strchr("+-.0123456789eE", pos[chars]))
+		{
+			buf[chars] = pos[chars];
+			++chars;
+		}
+		buf[chars] = '\0';
+		char* real_end = buf;
+		value = strtod(buf, &real_end);
+		if(real_end == buf) return false;
+		pos += real_end - buf;
+		return true;
+	}
+
+	// Reads a UUID string, like istr >> id.
+	bool buffer_uuid(const U8*& pos, const U8* end, LLUUID& id)
+	{
+		const S32 UUID_CHARS = UUID_STR_LENGTH - 1;
+		buffer_skip_space(pos, end);
+		if(end - pos < UUID_CHARS) return false;
+		char buf[UUID_STR_LENGTH];		/* Flawfinder: ignore */
+		memcpy(buf, pos, UUID_CHARS);		/* Flawfinder: ignore */
+		buf[UUID_CHARS] = '\0';
+		pos += UUID_CHARS;
+		id.set(buf);
+		return true;
+	}
+
+	/**
+	 * streambuf over the buffer for the parsers which only parse streams,
+	 * which knows how much of the buffer they read.
+	 */
+	class BufferStreamBuf : public std::streambuf
+	{
+	public:
+		BufferStreamBuf(const U8* start, const U8* end)
+		{
+			char* s = (char*)start;
+			setg(s, s, (char*)end);
+		}
+
+		S32 consumed() const { return (S32)(gptr() - eback()); }
+	};
+}
+
 
 /**
  * LLSDParser
@@ -323,6 +653,31 @@ S32 LLSDParser::parseLines(std::istream& istr, LLSD& data)
 	return doParse(istr, data);
 }
 
+S32 LLSDParser::parse(const U8* buf, S32 len, LLSD& data, S32* bytes_read)
+{
+	// The buffer parsers stop at the end of the buffer, the limit is for
+	// the stream doParseBuffer() parses by default.
+	mCheckLimits = true;
+	mMaxBytesLeft = len;
+	const U8* pos = buf;
+	S32 parse_count = doParseBuffer(pos, buf + len, data);
+	if(bytes_read)
+	{
+		*bytes_read = (S32)(pos - buf);
+	}
+	return parse_count;
+}
+
+// virtual
+S32 LLSDParser::doParseBuffer(const U8*& pos, const U8* end, LLSD& data) const
+{
+	BufferStreamBuf buf(pos, end);
+	std::istream istr(&buf);
+	S32 parse_count = doParse(istr, data);
+	pos += buf.consumed();
+	return parse_count;
+}
+
 
 int LLSDParser::get(std::istream& istr) const
 {
@@ -846,197 +1201,552 @@ bool LLSDNotationParser::parseBinary(std::istream& istr, LLSD& data) const
 }
 
 
-/**
- * LLSDBinaryParser
- */
-LLSDBinaryParser::LLSDBinaryParser()
-{
-}
-
-// virtual
-LLSDBinaryParser::~LLSDBinaryParser()
-{
-}
-
 // virtual
-S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
+S32 LLSDNotationParser::doParseBuffer(const U8*& pos, const U8* end, LLSD& data) const
 {
-/**
- * Undefined: '!'<br>
- * Boolean: 't' for true 'f' for false<br>
- * Integer: 'i' + 4 bytes network byte order<br>
- * Real: 'r' + 8 bytes IEEE double<br>
- * UUID: 'u' + 16 byte unsigned integer<br>
- * String: 's' + 4 byte integer size + string<br>
- *  strings also secretly support the notation format
- * Date: 'd' + 8 byte IEEE double for seconds since epoch<br>
- * URI: 'l' + 4 byte integer size + string uri<br>
- * Binary: 'b' + 4 byte integer size + binary data<br>
- * Array: '[' + 4 byte integer size  + all values + ']'<br>
- * Map: '{' + 4 byte integer size  every(key + value) + '}'<br>
- *  map keys are serialized as s + 4 byte integer size + string or in the
- *  notation format.
- */
-	char c;
-	c = get(istr);
-	if(!istr.good())
+	// Same grammar as doParse().
+	buffer_skip_space(pos, end);
+	if(pos >= end)
 	{
 		return 0;
 	}
+	int c = *pos;
 	S32 parse_count = 1;
 	switch(c)
 	{
 	case '{':
 	{
-		S32 child_count = parseMap(istr, data);
+		S32 child_count = parseMap(pos, end, data);
 		if((child_count == PARSE_FAILURE) || data.isUndefined())
 		{
+			llinfos << "PARSE FAILURE reading map." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		else
 		{
 			parse_count += child_count;
 		}
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary map." << llendl;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
 	case '[':
 	{
-		S32 child_count = parseArray(istr, data);
+		S32 child_count = parseArray(pos, end, data);
 		if((child_count == PARSE_FAILURE) || data.isUndefined())
 		{
+			llinfos << "PARSE FAILURE reading array." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		else
 		{
 			parse_count += child_count;
 		}
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary array." << llendl;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
 	case '!':
+		++pos;
 		data.clear();
 		break;
 
 	case '0':
+		++pos;
 		data = false;
 		break;
 
+	case 'F':
+	case 'f':
+		++pos;
+		if(isalpha(buffer_peek(pos, end))
+		   && !buffer_boolean(pos, end, NOTATION_FALSE_SERIAL))
+		{
+			llinfos << "PARSE FAILURE reading boolean." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			data = false;
+		}
+		break;
+
 	case '1':
+		++pos;
 		data = true;
 		break;
 
-	case 'i':
-	{
-		U32 value_nbo = 0;
-		read(istr, (char*)&value_nbo, sizeof(U32));	 /*Flawfinder: ignore*/
-		data = (S32)ntohl(value_nbo);
-		if(istr.fail())
+	case 'T':
+	case 't':
+		++pos;
+		if(isalpha(buffer_peek(pos, end))
+		   && !buffer_boolean(pos, end, NOTATION_TRUE_SERIAL))
 		{
-			llinfos << "STREAM FAILURE reading binary integer." << llendl;
+			llinfos << "PARSE FAILURE reading boolean." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			data = true;
 		}
 		break;
-	}
 
-	case 'r':
+	case 'i':
 	{
-		F64 real_nbo = 0.0;
-		read(istr, (char*)&real_nbo, sizeof(F64));	 /*Flawfinder: ignore*/
-		data = ll_ntohd(real_nbo);
-		if(istr.fail())
+		++pos;
+		S32 integer = 0;
+		if(buffer_integer(pos, end, integer))
 		{
-			llinfos << "STREAM FAILURE reading binary real." << llendl;
+			data = integer;
+		}
+		else
+		{
+			llinfos << "PARSE FAILURE reading integer." << llendl;
+			parse_count = PARSE_FAILURE;
 		}
 		break;
 	}
 
-	case 'u':
+	case 'r':
 	{
-		LLUUID id;
-		read(istr, (char*)(&id.mData), UUID_BYTES);	 /*Flawfinder: ignore*/
-		data = id;
-		if(istr.fail())
+		++pos;
+		F64 real = 0.0;
+		if(buffer_real(pos, end, real))
 		{
-			llinfos << "STREAM FAILURE reading binary uuid." << llendl;
+			data = real;
+		}
+		else
+		{
+			llinfos << "PARSE FAILURE reading real." << llendl;
+			parse_count = PARSE_FAILURE;
 		}
 		break;
 	}
 
-	case '\'':
-	case '"':
+	case 'u':
 	{
-		std::string value;
-		int cnt = deserialize_string_delim(istr, value, c);
-		if(PARSE_FAILURE == cnt)
+		++pos;
+		LLUUID id;
+		if(buffer_uuid(pos, end, id))
 		{
-			parse_count = PARSE_FAILURE;
+			data = id;
 		}
 		else
 		{
-			data = value;
-			account(cnt);
-		}
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary (notation-style) string."
-				<< llendl;
+			llinfos << "PARSE FAILURE reading uuid." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		break;
 	}
 
+	case '\"':
+	case '\'':
 	case 's':
 	{
-		std::string value;
-		if(parseString(istr, value))
+		BufferString value;
+		if(buffer_string(pos, end, value))
 		{
-			data = value;
+			value.assignTo(data);
 		}
 		else
 		{
-			parse_count = PARSE_FAILURE;
-		}
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary string." << llendl;
+			llinfos << "PARSE FAILURE reading string." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		break;
 	}
 
 	case 'l':
+	case 'd':
 	{
-		std::string value;
-		if(parseString(istr, value))
+		++pos; // pop the 'l' or 'd'
+		int delim = buffer_get(pos, end);
+		BufferString value;
+		if((delim == EOF) || !buffer_string_delim(pos, end, (char)delim, value))
 		{
-			data = LLURI(value);
+			llinfos << "PARSE FAILURE reading " << ((c == 'l') ? "link." : "date.")
+				<< llendl;
+			parse_count = PARSE_FAILURE;
 		}
 		else
 		{
-			parse_count = PARSE_FAILURE;
+			std::string str;
+			value.assignTo(str);
+			if(c == 'l')
+			{
+				data = LLURI(str);
+			}
+			else
+			{
+				data = LLDate(str);
+			}
 		}
-		if(istr.fail())
+		break;
+	}
+
+	case 'b':
+		if(!parseBinary(pos, end, data))
 		{
-			llinfos << "STREAM FAILURE reading binary link." << llendl;
+			llinfos << "PARSE FAILURE reading data." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		break;
-	}
 
-	case 'd':
-	{
-		F64 real = 0.0;
-		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
+	default:
+		parse_count = PARSE_FAILURE;
+		llinfos << "Unrecognized character while parsing: int(" << c
+			<< ")" << llendl;
+		break;
+	}
+	if(PARSE_FAILURE == parse_count)
+	{
+		data.clear();
+	}
+	return parse_count;
+}
+
+S32 LLSDNotationParser::parseMap(const U8*& pos, const U8* end, LLSD& map) const
+{
+	// map: { string:object, string:object }
+	map = LLSD::emptyMap();
+	S32 parse_count = 0;
+	int c = buffer_get(pos, end);
+	if(c == '{')
+	{
+		// eat commas, white
+		bool found_name = false;
+		BufferString key;
+		std::string name;
+		c = buffer_get(pos, end);
+		while((c != '}') && (c != EOF))
+		{
+			if(!found_name)
+			{
+				if((c == '\"') || (c == '\'') || (c == 's'))
+				{
+					--pos;
+					found_name = true;
+					if(!buffer_string(pos, end, key)) return PARSE_FAILURE;
+					key.assignTo(name);
+				}
+				c = buffer_get(pos, end);
+			}
+			else
+			{
+				if(isspace(c) || (c == ':'))
+				{
+					c = buffer_get(pos, end);
+					continue;
+				}
+				--pos;
+				LLSD child;
+				S32 count = doParseBuffer(pos, end, child);
+				if(count > 0)
+				{
+					// There must be a value for every key, thus
+					// child_count must be greater than 0.
+					parse_count += count;
+					map.insert(name, child);
+				}
+				else
+				{
+					return PARSE_FAILURE;
+				}
+				found_name = false;
+				c = buffer_get(pos, end);
+			}
+		}
+		if(c != '}')
+		{
+			map.clear();
+			return PARSE_FAILURE;
+		}
+	}
+	return parse_count;
+}
+
+S32 LLSDNotationParser::parseArray(const U8*& pos, const U8* end, LLSD& array) const
+{
+	// array: [ object, object, object ]
+	array = LLSD::emptyArray();
+	S32 parse_count = 0;
+	int c = buffer_get(pos, end);
+	if(c == '[')
+	{
+		// eat commas, white
+		c = buffer_get(pos, end);
+		while((c != ']') && (c != EOF))
+		{
+			if(isspace(c) || (c == ','))
+			{
+				c = buffer_get(pos, end);
+				continue;
+			}
+			--pos;
+			LLSD child;
+			S32 count = doParseBuffer(pos, end, child);
+			if(PARSE_FAILURE == count)
+			{
+				return PARSE_FAILURE;
+			}
+			parse_count += count;
+			array.append(child);
+			c = buffer_get(pos, end);
+		}
+		if(c != ']')
+		{
+			return PARSE_FAILURE;
+		}
+	}
+	return parse_count;
+}
+
+bool LLSDNotationParser::parseBinary(const U8*& pos, const U8* end, LLSD& data) const
+{
+	// binary: b##"ff3120ab1"
+	// or: b(len)"..."
+	if(buffer_get(pos, end) != 'b') return false;
+	if(buffer_peek(pos, end) == '(')
+	{
+		S32 len = 0;
+		if(!buffer_raw_length(pos, end, len)) return false;
+		if(buffer_get(pos, end) != '"') return false;
+		if(len > end - pos) return false;
+		data.assignBinary(pos, len);
+		pos += len;
+		// strip off the trailing double-quote
+		return (buffer_get(pos, end) == '"');
+	}
+
+	bool base64 = ((end - pos >= 3) && !memcmp(pos, "64\"", 3));
+	bool base16 = ((end - pos >= 3) && !memcmp(pos, "16\"", 3));
+	if(!base64 && !base16) return false;
+	pos += 3;
+	const U8* coded = pos;
+	while((pos < end) && (*pos != '"')) ++pos;
+	if(pos == end) return false;
+	const U8* coded_end = pos++;
+
+	std::vector<U8> value;
+	if(base64)
+	{
+		// apr wants it null terminated
+		std::string encoded((const char*)coded, coded_end - coded);
+		S32 len = apr_base64_decode_len(encoded.c_str());
+		if(len)
+		{
+			value.resize(len);
+			len = apr_base64_decode_binary(&value[0], encoded.c_str());
+			value.resize(len);
+		}
+	}
+	else
+	{
+		value.reserve((coded_end - coded + 1) / 2);
+		while(coded < coded_end)
+		{
+			U8 byte = hex_as_nybble(*coded++) << 4;
+			if(coded < coded_end)
+			{
+				byte |= hex_as_nybble(*coded++);
+			}
+			value.push_back(byte);
+		}
+	}
+	data = value;
+	return true;
+}
+
+
+/**
+ * LLSDBinaryParser
+ */
+LLSDBinaryParser::LLSDBinaryParser()
+{
+}
+
+// virtual
+LLSDBinaryParser::~LLSDBinaryParser()
+{
+}
+
+// virtual
+S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
+{
+/**
+ * Undefined: '!'<br>
+ * Boolean: 't' for true 'f' for false<br>
+ * Integer: 'i' + 4 bytes network byte order<br>
+ * Real: 'r' + 8 bytes IEEE double<br>
+ * UUID: 'u' + 16 byte unsigned integer<br>
+ * String: 's' + 4 byte integer size + string<br>
+ *  strings also secretly support the notation format
+ * Date: 'd' + 8 byte IEEE double for seconds since epoch<br>
+ * URI: 'l' + 4 byte integer size + string uri<br>
+ * Binary: 'b' + 4 byte integer size + binary data<br>
+ * Array: '[' + 4 byte integer size  + all values + ']'<br>
+ * Map: '{' + 4 byte integer size  every(key + value) + '}'<br>
+ *  map keys are serialized as s + 4 byte integer size + string or in the
+ *  notation format.
+ */
+	char c;
+	c = get(istr);
+	if(!istr.good())
+	{
+		return 0;
+	}
+	S32 parse_count = 1;
+	switch(c)
+	{
+	case '{':
+	{
+		S32 child_count = parseMap(istr, data);
+		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary map." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case '[':
+	{
+		S32 child_count = parseArray(istr, data);
+		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary array." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case '!':
+		data.clear();
+		break;
+
+	case '0':
+		data = false;
+		break;
+
+	case '1':
+		data = true;
+		break;
+
+	case 'i':
+	{
+		U32 value_nbo = 0;
+		read(istr, (char*)&value_nbo, sizeof(U32));	 /*Flawfinder: ignore*/
+		data = (S32)ntohl(value_nbo);
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary integer." << llendl;
+		}
+		break;
+	}
+
+	case 'r':
+	{
+		F64 real_nbo = 0.0;
+		read(istr, (char*)&real_nbo, sizeof(F64));	 /*Flawfinder: ignore*/
+		data = ll_ntohd(real_nbo);
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary real." << llendl;
+		}
+		break;
+	}
+
+	case 'u':
+	{
+		LLUUID id;
+		read(istr, (char*)(&id.mData), UUID_BYTES);	 /*Flawfinder: ignore*/
+		data = id;
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary uuid." << llendl;
+		}
+		break;
+	}
+
+	case '\'':
+	case '"':
+	{
+		std::string value;
+		int cnt = deserialize_string_delim(istr, value, c);
+		if(PARSE_FAILURE == cnt)
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			data = value;
+			account(cnt);
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary (notation-style) string."
+				<< llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 's':
+	{
+		std::string value;
+		if(parseString(istr, value))
+		{
+			data = value;
+		}
+		else
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary string." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'l':
+	{
+		std::string value;
+		if(parseString(istr, value))
+		{
+			data = LLURI(value);
+		}
+		else
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary link." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'd':
+	{
+		F64 real = 0.0;
+		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
 		data = LLDate(real);
 		if(istr.fail())
 		{
@@ -1201,6 +1911,294 @@ bool LLSDBinaryParser::parseString(
 }
 
 
+// virtual
+S32 LLSDBinaryParser::doParseBuffer(const U8*& pos, const U8* end, LLSD& data) const
+{
+	// Same format as doParse().
+	if(pos >= end)
+	{
+		return 0;
+	}
+	char c = *pos++;
+	S32 parse_count = 1;
+	switch(c)
+	{
+	case '{':
+	{
+		S32 child_count = parseMap(pos, end, data);
+		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		{
+			llinfos << "PARSE FAILURE reading binary map." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
+		}
+		break;
+	}
+
+	case '[':
+	{
+		S32 child_count = parseArray(pos, end, data);
+		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		{
+			llinfos << "PARSE FAILURE reading binary array." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
+		}
+		break;
+	}
+
+	case '!':
+		data.clear();
+		break;
+
+	case '0':
+		data = false;
+		break;
+
+	case '1':
+		data = true;
+		break;
+
+	case 'i':
+	{
+		U32 value_nbo = 0;
+		if(buffer_read(pos, end, &value_nbo, sizeof(U32)))
+		{
+			data = (S32)ntohl(value_nbo);
+		}
+		else
+		{
+			llinfos << "BUFFER OVERRUN reading binary integer." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'r':
+	{
+		F64 real_nbo = 0.0;
+		if(buffer_read(pos, end, &real_nbo, sizeof(F64)))
+		{
+			data = ll_ntohd(real_nbo);
+		}
+		else
+		{
+			llinfos << "BUFFER OVERRUN reading binary real." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'u':
+	{
+		LLUUID id;
+		if(buffer_read(pos, end, id.mData, UUID_BYTES))
+		{
+			data = id;
+		}
+		else
+		{
+			llinfos << "BUFFER OVERRUN reading binary uuid." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case '\'':
+	case '"':
+	{
+		BufferString value;
+		if(buffer_string_delim(pos, end, c, value))
+		{
+			value.assignTo(data);
+		}
+		else
+		{
+			llinfos << "PARSE FAILURE reading binary (notation-style) string."
+				<< llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 's':
+	case 'l':
+	{
+		const char* value = NULL;
+		S32 length = 0;
+		if(!parseString(pos, end, value, length))
+		{
+			llinfos << "BUFFER OVERRUN reading binary "
+				<< ((c == 's') ? "string." : "link.") << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		else if(c == 's')
+		{
+			data.assignString(value, length);
+		}
+		else
+		{
+			data = LLURI(std::string(value, length));
+		}
+		break;
+	}
+
+	case 'd':
+	{
+		F64 real = 0.0;
+		if(buffer_read(pos, end, &real, sizeof(F64)))
+		{
+			data = LLDate(real);
+		}
+		else
+		{
+			llinfos << "BUFFER OVERRUN reading binary date." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'b':
+	{
+		S32 size = 0;
+		if(!buffer_read_size(pos, end, size) || (size < 0) || (size > end - pos))
+		{
+			llinfos << "BUFFER OVERRUN reading binary." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			data.assignBinary(pos, size);
+			pos += size;
+		}
+		break;
+	}
+
+	default:
+		parse_count = PARSE_FAILURE;
+		llinfos << "Unrecognized character while parsing: int(" << (int)c
+			<< ")" << llendl;
+		break;
+	}
+	if(PARSE_FAILURE == parse_count)
+	{
+		data.clear();
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseMap(const U8*& pos, const U8* end, LLSD& map) const
+{
+	map = LLSD::emptyMap();
+	S32 size = 0;
+	if(!buffer_read_size(pos, end, size)) return PARSE_FAILURE;
+	S32 parse_count = 0;
+	S32 count = 0;
+	std::string name;
+	int c = buffer_get(pos, end);
+	while((c != '}') && (count < size) && (c != EOF))
+	{
+		name.clear();
+		switch(c)
+		{
+		case 'k':
+		{
+			const char* key = NULL;
+			S32 length = 0;
+			if(!parseString(pos, end, key, length))
+			{
+				return PARSE_FAILURE;
+			}
+			name.assign(key, length);
+			break;
+		}
+		case '\'':
+		case '"':
+		{
+			BufferString key;
+			if(!buffer_string_delim(pos, end, (char)c, key)) return PARSE_FAILURE;
+			key.assignTo(name);
+			break;
+		}
+		}
+		LLSD child;
+		S32 child_count = doParseBuffer(pos, end, child);
+		if(child_count > 0)
+		{
+			// There must be a value for every key, thus child_count
+			// must be greater than 0.
+			parse_count += child_count;
+			map.insert(name, child);
+		}
+		else
+		{
+			return PARSE_FAILURE;
+		}
+		++count;
+		c = buffer_get(pos, end);
+	}
+	if((c != '}') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseArray(const U8*& pos, const U8* end, LLSD& array) const
+{
+	array = LLSD::emptyArray();
+	S32 size = 0;
+	if(!buffer_read_size(pos, end, size)) return PARSE_FAILURE;
+	S32 parse_count = 0;
+	S32 count = 0;
+	int c = buffer_peek(pos, end);
+	while((c != ']') && (count < size) && (c != EOF))
+	{
+		LLSD child;
+		S32 child_count = doParseBuffer(pos, end, child);
+		if(PARSE_FAILURE == child_count)
+		{
+			return PARSE_FAILURE;
+		}
+		if(child_count)
+		{
+			parse_count += child_count;
+			array.append(child);
+		}
+		++count;
+		c = buffer_peek(pos, end);
+	}
+	c = buffer_get(pos, end);
+	if((c != ']') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+bool LLSDBinaryParser::parseString(
+	const U8*& pos,
+	const U8* end,
+	const char*& value,
+	S32& length) const
+{
+	if(!buffer_read_size(pos, end, length)) return false;
+	if((length < 0) || (length > end - pos)) return false;
+	value = (const char*)pos;
+	pos += length;
+	return true;
+}
+
 /**
  * LLSDFormatter
  */
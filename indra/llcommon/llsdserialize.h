@@ -85,6 +85,24 @@ public:
 	 */
 	S32 parseLines(std::istream& istr, LLSD& data);
 
+	/** 
+	 * @brief Call this method to parse a contiguous buffer for LLSD.
+	 *
+	 * Same as parse() on a stream over the buffer, but the notation
+	 * and binary parsers read the buffer directly instead of going
+	 * through an istream a character at a time, and strings and
+	 * binary values are copied once, from the buffer into data.
+	 * Other parsers parse a stream over the buffer.
+	 * @param buf The buffer.
+	 * @param len The number of bytes in buf.
+	 * @param data[out] The newly parse structured data.
+	 * @param bytes_read[out] If not NULL, set to the number of bytes of
+	 * buf parsed, to continue with the next object.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	S32 parse(const U8* buf, S32 len, LLSD& data, S32* bytes_read = NULL);
+
 	/** 
 	 * @brief Resets the parser so parse() or parseLines() can be called again for another <llsd> chunk.
 	 */
@@ -108,6 +126,18 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const = 0;
 
+	/** 
+	 * @brief Virtual for parsing a buffer, the default parses a stream over it.
+	 *
+	 * @param pos[in,out] The first byte to parse, moved past the
+	 * bytes parsed.
+	 * @param end One past the last byte of the buffer.
+	 * @param data[out] The newly parse structured data.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	virtual S32 doParseBuffer(const U8*& pos, const U8* end, LLSD& data) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -246,6 +276,18 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Parse a buffer for LLSD without an istream.
+	 *
+	 * @param pos[in,out] The first byte to parse, moved past the
+	 * bytes parsed.
+	 * @param end One past the last byte of the buffer.
+	 * @param data[out] The newly parse structured data. Undefined on failure.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	virtual S32 doParseBuffer(const U8*& pos, const U8* end, LLSD& data) const;
+
 private:
 	/** 
 	 * @brief Parse a map from the istream
@@ -282,6 +324,122 @@ private:
 	 * @return Retuns true if a complete blob was parsed.
 	 */
 	bool parseBinary(std::istream& istr, LLSD& data) const;
+
+	/** 
+	 * @name Buffer versions of the above
+	 */
+	//@{
+	S32 parseMap(const U8*& pos, const U8* end, LLSD& map) const;
+	S32 parseArray(const U8*& pos, const U8* end, LLSD& array) const;
+	bool parseBinary(const U8*& pos, const U8* end, LLSD& data) const;
+	//@}
+};
+
+/** 
+ * @class LLSDSAXHandler
+ * @brief Receives LLSD as it is parsed, one value at a time.
+ *
+ * For consumers which fill their own structures from large responses,
+ * without building an LLSD first. A map or an array arrives as a
+ * startMap()/startArray() call, its values, then endMap()/endArray(),
+ * and every value in a map comes right after its key(). Strings and
+ * binary data point into the parser and are only valid during the call.
+ */
+class LL_COMMON_API LLSDSAXHandler
+{
+public:
+	virtual ~LLSDSAXHandler() {}
+
+	virtual void startMap() = 0;
+	virtual void endMap() = 0;
+	virtual void startArray() = 0;
+	virtual void endArray() = 0;
+	virtual void key(const char* key, size_t length) = 0;
+
+	virtual void undef() = 0;
+	virtual void boolean(bool value) = 0;
+	virtual void integer(S32 value) = 0;
+	virtual void real(F64 value) = 0;
+	virtual void string(const char* value, size_t length) = 0;
+	virtual void uuid(const LLUUID& value) = 0;
+	virtual void date(const LLDate& value) = 0;
+	virtual void uri(const char* value, size_t length) = 0;
+	virtual void binary(const U8* value, size_t length) = 0;
+};
+
+/** 
+ * @class LLSDSAXBuilder
+ * @brief LLSDSAXHandler which builds an LLSD.
+ *
+ * The values are recorded into two arenas, a flat array of nodes and one
+ * text buffer, and the LLSD is built from them by build(). That way
+ * every key and value is allocated once, straight from the arena, and
+ * every array once at its final size. reset() keeps the arenas' memory
+ * for the next document.
+ */
+class LL_COMMON_API LLSDSAXBuilder : public LLSDSAXHandler
+{
+public:
+	LLSDSAXBuilder();
+
+	/** 
+	 * @brief Forgets the values recorded so far.
+	 */
+	void reset();
+
+	/** 
+	 * @brief Builds the recorded value.
+	 *
+	 * @param data[out] The value, undefined if nothing was recorded.
+	 */
+	void build(LLSD& data) const;
+
+	virtual void startMap();
+	virtual void endMap();
+	virtual void startArray();
+	virtual void endArray();
+	virtual void key(const char* key, size_t length);
+
+	virtual void undef();
+	virtual void boolean(bool value);
+	virtual void integer(S32 value);
+	virtual void real(F64 value);
+	virtual void string(const char* value, size_t length);
+	virtual void uuid(const LLUUID& value);
+	virtual void date(const LLDate& value);
+	virtual void uri(const char* value, size_t length);
+	virtual void binary(const U8* value, size_t length);
+
+private:
+	struct Text
+	{
+		U32 mOffset;
+		U32 mLength;
+	};
+
+	struct Node
+	{
+		LLSD::Type mType;
+		Text mKey;
+		union
+		{
+			bool mBoolean;
+			S32 mInteger;
+			F64 mReal;			// and dates, seconds since epoch
+			Text mText;			// strings, uris, uuids and binaries
+			U32 mChildren;		// maps and arrays
+		};
+	};
+
+	Node& addNode(LLSD::Type type);
+	Text addText(const void* data, size_t length);
+	const char* text(const Text& text) const;
+	U32 buildNode(U32 index, LLSD& value) const;
+
+	std::vector<Node> mNodes;
+	std::vector<char> mText;
+	std::vector<U32> mOpen;		// indices of the maps and arrays not ended
+	Text mKey;					// for the next value
 };
 
 /** 
@@ -302,6 +460,20 @@ public:
 	 */
 	LLSDXMLParser();
 
+	using LLSDParser::parse;
+
+	/** 
+	 * @brief Call this method to parse a stream into handler calls.
+	 *
+	 * Like parse() but hands every value to handler as it is parsed
+	 * instead of building an LLSD.
+	 * @param istr The input stream.
+	 * @param handler Receives the parsed values.
+	 * @return Returns the number of LLSD objects parsed. Returns
+	 * PARSE_FAILURE (-1) on parse failure.
+	 */
+	S32 parse(std::istream& istr, LLSDSAXHandler& handler);
+
 protected:
 	/** 
 	 * @brief Call this method to parse a stream for LLSD.
@@ -367,6 +539,18 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Parse a buffer for LLSD without an istream.
+	 *
+	 * @param pos[in,out] The first byte to parse, moved past the
+	 * bytes parsed.
+	 * @param end One past the last byte of the buffer.
+	 * @param data[out] The newly parse structured data. Undefined on failure.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	virtual S32 doParseBuffer(const U8*& pos, const U8* end, LLSD& data) const;
+
 private:
 	/** 
 	 * @brief Parse a map from the istream
@@ -394,6 +578,17 @@ private:
 	 * @return Retuns true if a complete string was parsed.
 	 */
 	bool parseString(std::istream& istr, std::string& value) const;
+
+	/** 
+	 * @name Buffer versions of the above
+	 *
+	 * parseString() returns the string in place, in the buffer.
+	 */
+	//@{
+	S32 parseMap(const U8*& pos, const U8* end, LLSD& map) const;
+	S32 parseArray(const U8*& pos, const U8* end, LLSD& array) const;
+	bool parseString(const U8*& pos, const U8* end, const char*& value, S32& length) const;
+	//@}
 };
 
 
@@ -28,10 +28,8 @@
 #include "llsdserialize_xml.h"
 
 #include <iostream>
-#include <deque>
 
 #include "apr_base64.h"
-#include <boost/regex.hpp>
 
 extern "C"
 {
@@ -247,6 +245,221 @@ std::string LLSDXMLFormatter::escapeString(const std::string& in)
 
 
 
+/**
+ * LLSDSAXBuilder
+ */
+LLSDSAXBuilder::LLSDSAXBuilder()
+{
+	reset();
+}
+
+void LLSDSAXBuilder::reset()
+{
+	mNodes.clear();
+	mText.clear();
+	mOpen.clear();
+	mKey.mOffset = 0;
+	mKey.mLength = 0;
+}
+
+LLSDSAXBuilder::Node& LLSDSAXBuilder::addNode(LLSD::Type type)
+{
+	if (mOpen.empty())
+	{
+		// a new top level value replaces the last one
+		mNodes.clear();
+		mText.clear();
+	}
+	else
+	{
+		++mNodes[mOpen.back()].mChildren;
+	}
+	Node node;
+	node.mType = type;
+	node.mKey = mKey;
+	node.mReal = 0.0;
+	mKey.mOffset = 0;
+	mKey.mLength = 0;
+	mNodes.push_back(node);
+	return mNodes.back();
+}
+
+LLSDSAXBuilder::Text LLSDSAXBuilder::addText(const void* data, size_t length)
+{
+	Text text;
+	text.mOffset = (U32)mText.size();
+	text.mLength = (U32)length;
+	mText.insert(mText.end(), (const char*)data, (const char*)data + length);
+	return text;
+}
+
+const char* LLSDSAXBuilder::text(const Text& text) const
+{
+	return text.mLength ? &mText[text.mOffset] : "";
+}
+
+void LLSDSAXBuilder::startMap()
+{
+	addNode(LLSD::TypeMap).mChildren = 0;
+	mOpen.push_back((U32)mNodes.size() - 1);
+}
+
+void LLSDSAXBuilder::endMap()
+{
+	if (!mOpen.empty()) mOpen.pop_back();
+}
+
+void LLSDSAXBuilder::startArray()
+{
+	addNode(LLSD::TypeArray).mChildren = 0;
+	mOpen.push_back((U32)mNodes.size() - 1);
+}
+
+void LLSDSAXBuilder::endArray()
+{
+	if (!mOpen.empty()) mOpen.pop_back();
+}
+
+void LLSDSAXBuilder::key(const char* key, size_t length)
+{
+	mKey = addText(key, length);
+}
+
+void LLSDSAXBuilder::undef()
+{
+	addNode(LLSD::TypeUndefined);
+}
+
+void LLSDSAXBuilder::boolean(bool value)
+{
+	addNode(LLSD::TypeBoolean).mBoolean = value;
+}
+
+void LLSDSAXBuilder::integer(S32 value)
+{
+	addNode(LLSD::TypeInteger).mInteger = value;
+}
+
+void LLSDSAXBuilder::real(F64 value)
+{
+	addNode(LLSD::TypeReal).mReal = value;
+}
+
+void LLSDSAXBuilder::string(const char* value, size_t length)
+{
+	Node& node = addNode(LLSD::TypeString);
+	node.mText = addText(value, length);
+}
+
+void LLSDSAXBuilder::uuid(const LLUUID& value)
+{
+	Node& node = addNode(LLSD::TypeUUID);
+	node.mText = addText(value.mData, UUID_BYTES);
+}
+
+void LLSDSAXBuilder::date(const LLDate& value)
+{
+	addNode(LLSD::TypeDate).mReal = value.secondsSinceEpoch();
+}
+
+void LLSDSAXBuilder::uri(const char* value, size_t length)
+{
+	Node& node = addNode(LLSD::TypeURI);
+	node.mText = addText(value, length);
+}
+
+void LLSDSAXBuilder::binary(const U8* value, size_t length)
+{
+	Node& node = addNode(LLSD::TypeBinary);
+	node.mText = addText(value, length);
+}
+
+void LLSDSAXBuilder::build(LLSD& data) const
+{
+	data.clear();
+	if (!mNodes.empty())
+	{
+		buildNode(0, data);
+	}
+}
+
+// Builds the value of the node at index and its children, returns the
+// index of the node after them.
+U32 LLSDSAXBuilder::buildNode(U32 index, LLSD& value) const
+{
+	const Node& node = mNodes[index++];
+	switch (node.mType)
+	{
+		case LLSD::TypeMap:
+		{
+			value = LLSD::emptyMap();
+			for (U32 i = 0; i < node.mChildren; ++i)
+			{
+				const Text& key = mNodes[index].mKey;
+				index = buildNode(index, value[std::string(text(key), key.mLength)]);
+			}
+			break;
+		}
+
+		case LLSD::TypeArray:
+		{
+			value = LLSD::emptyArray();
+			if (node.mChildren)
+			{
+				// sizes the array
+				value[(LLSD::Integer)node.mChildren - 1] = LLSD();
+			}
+			for (U32 i = 0; i < node.mChildren; ++i)
+			{
+				index = buildNode(index, value[(LLSD::Integer)i]);
+			}
+			break;
+		}
+
+		case LLSD::TypeBoolean:
+			value = node.mBoolean;
+			break;
+
+		case LLSD::TypeInteger:
+			value = node.mInteger;
+			break;
+
+		case LLSD::TypeReal:
+			value = node.mReal;
+			break;
+
+		case LLSD::TypeString:
+			value.assignString(text(node.mText), node.mText.mLength);
+			break;
+
+		case LLSD::TypeUUID:
+		{
+			LLUUID id;
+			memcpy(id.mData, text(node.mText), UUID_BYTES);		/* Flawfinder: ignore */
+			value = id;
+			break;
+		}
+
+		case LLSD::TypeDate:
+			value = LLDate(node.mReal);
+			break;
+
+		case LLSD::TypeURI:
+			value = LLURI(std::string(text(node.mText), node.mText.mLength));
+			break;
+
+		case LLSD::TypeBinary:
+			value.assignBinary((const U8*)text(node.mText), node.mText.mLength);
+			break;
+
+		default:
+			value.clear();
+			break;
+	}
+	return index;
+}
+
+
 class LLSDXMLParser::Impl
 {
 public:
@@ -255,12 +468,15 @@ public:
 	
 	S32 parse(std::istream& input, LLSD& data);
 	S32 parseLines(std::istream& input, LLSD& data);
+	S32 parse(std::istream& input, LLSDSAXHandler& handler);
 
 	void parsePart(const char *buf, int len);
 	
 	void reset();
 
 private:
+	S32 parseStream(std::istream& input);
+
 	void startElementHandler(const XML_Char* name, const XML_Char** attributes);
 	void endElementHandler(const XML_Char* name);
 	void characterDataHandler(const XML_Char* data, int length);
@@ -297,14 +513,15 @@ private:
 
 	XML_Parser	mParser;
 
-	LLSD mResult;
+	LLSDSAXHandler* mHandler;		// gets the values, mBuilder unless parsing for a handler
+	LLSDSAXBuilder mBuilder;
 	S32 mParseCount;
 	
 	bool mInLLSDElement;			// true if we're on LLSD
 	bool mGracefullStop;			// true if we found the </llsd
 	
-	typedef std::deque<LLSD*> LLSDRefStack;
-	LLSDRefStack mStack;
+	typedef std::vector<Element> ElementStack;
+	ElementStack mStack;			// values started, not ended
 	
 	int mDepth;
 	bool mSkipping;
@@ -312,10 +529,13 @@ private:
 	
 	std::string mCurrentKey;		// Current XML <tag>
 	std::string mCurrentContent;	// String data between <tag> and </tag>
+	std::string mBase64;			// binary content without white space
+	std::vector<U8> mBinary;		// decoded binary content
 };
 
 
 LLSDXMLParser::Impl::Impl()
+	: mHandler(&mBuilder)
 {
 	mParser = XML_ParserCreate(NULL);
 	reset();
@@ -355,6 +575,28 @@ static unsigned get_till_eol(std::istream& input, char *buf, unsigned bufsize)
 }
 
 S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSD& data)
+{
+	S32 parse_count = parseStream(input);
+	if (parse_count == LLSDParser::PARSE_FAILURE)
+	{
+		data = LLSD();
+	}
+	else
+	{
+		mBuilder.build(data);
+	}
+	return parse_count;
+}
+
+S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSDSAXHandler& handler)
+{
+	mHandler = &handler;
+	S32 parse_count = parseStream(input);
+	mHandler = &mBuilder;
+	return parse_count;
+}
+
+S32 LLSDXMLParser::Impl::parseStream(std::istream& input)
 {
 	XML_Status status;
 	
@@ -400,12 +642,10 @@ S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSD& data)
 			((char*) buffer)[count ? count - 1 : 0] = '\0';
 		}
 		llinfos << "LLSDXMLParser::Impl::parse: XML_STATUS_ERROR parsing:" << (char*) buffer << llendl;
-		data = LLSD();
 		return LLSDParser::PARSE_FAILURE;
 	}
 
 	clear_eol(input);
-	data = mResult;
 	return mParseCount;
 }
 
@@ -482,14 +722,14 @@ S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
 	}
 
 	clear_eol(input);
-	data = mResult;
+	mBuilder.build(data);
 	return mParseCount;
 }
 
 
 void LLSDXMLParser::Impl::reset()
 {
-	mResult.clear();
+	mBuilder.reset();
 	mParseCount = 0;
 
 	mInLLSDElement = false;
@@ -596,7 +836,7 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 			return;
 	
 		case ELEMENT_KEY:
-			if (mStack.empty()  ||  !(mStack.back()->isMap()))
+			if (mStack.empty()  ||  mStack.back() != ELEMENT_MAP)
 			{
 				return startSkipping();
 			}
@@ -619,43 +859,38 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 	
 	if (mStack.empty())
 	{
-		mStack.push_back(&mResult);
+		// the top level value
 	}
-	else if (mStack.back()->isMap())
+	else if (mStack.back() == ELEMENT_MAP)
 	{
 		if (mCurrentKey.empty()) { return startSkipping(); }
 		
-		LLSD& map = *mStack.back();
-		LLSD& newElement = map[mCurrentKey];
-		mStack.push_back(&newElement);		
-
+		mHandler->key(mCurrentKey.data(), mCurrentKey.size());
 		mCurrentKey.clear();
 	}
-	else if (mStack.back()->isArray())
+	else if (mStack.back() == ELEMENT_ARRAY)
 	{
-		LLSD& array = *mStack.back();
-		array.append(LLSD());
-		LLSD& newElement = array[array.size()-1];
-		mStack.push_back(&newElement);
+		// next in the array
 	}
 	else {
 		// improperly nested value in a non-structure
 		return startSkipping();
 	}
 
+	mStack.push_back(element);
 	++mParseCount;
 	switch (element)
 	{
 		case ELEMENT_MAP:
-			*mStack.back() = LLSD::emptyMap();
+			mHandler->startMap();
 			break;
 		
 		case ELEMENT_ARRAY:
-			*mStack.back() = LLSD::emptyArray();
+			mHandler->startArray();
 			break;
 			
 		default:
-			// all the other values will be set in the end element handler
+			// all the other values are handed over in the end element handler
 			;
 	}
 }
@@ -700,17 +935,16 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 	
 	if (!mInLLSDElement) { return; }
 
-	LLSD& value = *mStack.back();
 	mStack.pop_back();
 	
 	switch (element)
 	{
 		case ELEMENT_UNDEF:
-			value.clear();
+			mHandler->undef();
 			break;
 		
 		case ELEMENT_BOOL:
-			value = (mCurrentContent == "true" || mCurrentContent == "1");
+			mHandler->boolean(mCurrentContent == "true" || mCurrentContent == "1");
 			break;
 		
 		case ELEMENT_INTEGER:
@@ -718,11 +952,11 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 				S32 i;
 				if ( sscanf(mCurrentContent.c_str(), "%d", &i ) == 1 )
 				{	// See if sscanf works - it's faster
-					value = i;
+					mHandler->integer(i);
 				}
 				else
 				{
-					value = LLSD(mCurrentContent).asInteger();
+					mHandler->integer(LLSD(mCurrentContent).asInteger());
 				}
 			}
 			break;
@@ -732,55 +966,64 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 				F64 r;
 				if ( sscanf(mCurrentContent.c_str(), "%lf", &r ) == 1 )
 				{	// See if sscanf works - it's faster
-					value = r;
+					mHandler->real(r);
 				}
 				else
 				{
-					value = LLSD(mCurrentContent).asReal();
+					mHandler->real(LLSD(mCurrentContent).asReal());
 				}
 			}
 			break;
 		
 		case ELEMENT_STRING:
-			value = mCurrentContent;
+			mHandler->string(mCurrentContent.data(), mCurrentContent.size());
 			break;
 		
 		case ELEMENT_UUID:
-			value = LLSD(mCurrentContent).asUUID();
+			mHandler->uuid(LLUUID(mCurrentContent));
 			break;
 		
 		case ELEMENT_DATE:
-			value = LLSD(mCurrentContent).asDate();
+			mHandler->date(LLDate(mCurrentContent));
 			break;
 		
 		case ELEMENT_URI:
-			value = LLSD(mCurrentContent).asURI();
+			mHandler->uri(mCurrentContent.data(), mCurrentContent.size());
 			break;
 		
 		case ELEMENT_BINARY:
 		{
-			// Regex is expensive, but only fix for whitespace in base64,
-			// created by python and other non-linden systems - DEV-39358
-			// Fortunately we have very little binary passing now,
-			// so performance impact shold be negligible. + poppy 2009-09-04
-			boost::regex r;
-			r.assign("\\s");
-			std::string stripped = boost::regex_replace(mCurrentContent, r, "");
-			S32 len = apr_base64_decode_len(stripped.c_str());
-			std::vector<U8> data;
-			data.resize(len);
-			len = apr_base64_decode_binary(&data[0], stripped.c_str());
-			data.resize(len);
-			value = data;
+			// Strip the whitespace python and other non-linden systems
+			// put in base64 - DEV-39358
+			mBase64.clear();
+			for (std::string::const_iterator it = mCurrentContent.begin();
+				 it != mCurrentContent.end(); ++it)
+			{
+				if (!isspace((unsigned char)*it))
+				{
+					mBase64 += *it;
+				}
+			}
+			S32 len = apr_base64_decode_len(mBase64.c_str());
+			mBinary.resize(llmax(len, 1));
+			len = apr_base64_decode_binary(&mBinary[0], mBase64.c_str());
+			mHandler->binary(&mBinary[0], len);
 			break;
 		}
 		
 		case ELEMENT_UNKNOWN:
-			value.clear();
+			mHandler->undef();
+			break;
+		
+		case ELEMENT_MAP:
+			mHandler->endMap();
+			break;
+		
+		case ELEMENT_ARRAY:
+			mHandler->endArray();
 			break;
 			
 		default:
-			// other values, map and array, have already been set
 			break;
 	}
 
@@ -903,6 +1146,12 @@ void LLSDXMLParser::parsePart(const char *buf, int len)
 	impl.parsePart(buf, len);
 }
 
+S32 LLSDXMLParser::parse(std::istream& input, LLSDSAXHandler& handler)
+{
+	mCheckLimits = false;
+	return impl.parse(input, handler);
+}
+
 // virtual
 S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 {
@@ -0,0 +1,264 @@
+/**
+ * @file llthreadpool.cpp
+ * @brief Work stealing pool of worker threads shared by LLQueuedThreads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llthreadpool.h"
+
+#include "llstring.h"
+
+#if LL_WINDOWS
+#	define WIN32_LEAN_AND_MEAN
+#	include <winsock2.h>
+#	include <windows.h>
+#else
+#	include <unistd.h>
+#endif
+
+//============================================================================
+// MAIN THREAD
+
+LLThreadPool::LLThreadPool(const std::string& name, U32 num_workers) :
+	mName(name),
+	mNumQueued(0),
+	mNextWorker(0),
+	mNumExecuted(0),
+	mNumStolen(0),
+	mQuitting(FALSE)
+{
+	if (num_workers == 0)
+	{
+		num_workers = getNumCPUCores();
+	}
+	mWorkCondition = new LLCondition(NULL);
+
+	// All the workers must exist before any of them looks for work to steal
+	for (U32 i = 0; i < num_workers; i++)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+	for (U32 i = 0; i < num_workers; i++)
+	{
+		mWorkers[i]->start();
+	}
+	llinfos << "LLThreadPool " << mName << " started " << num_workers << " workers" << llendl;
+}
+
+LLThreadPool::~LLThreadPool()
+{
+	shutdown();
+	delete mWorkCondition;
+}
+
+void LLThreadPool::shutdown()
+{
+	if (mWorkers.empty())
+	{
+		return;
+	}
+
+	mWorkCondition->lock();
+	mQuitting = TRUE;
+	mWorkCondition->broadcast();
+	mWorkCondition->unlock();
+
+	S32 dropped = mNumQueued;
+	for (U32 i = 0; i < mWorkers.size(); i++)
+	{
+		mWorkers[i]->shutdown(); // waits for the worker to finish its current task
+		delete mWorkers[i];
+	}
+	mWorkers.clear();
+
+	if (dropped > 0)
+	{
+		llwarns << "LLThreadPool " << mName << " shut down with " << dropped << " queued tasks" << llendl;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// May be called from any thread
+bool LLThreadPool::post(Task* task, U32 priority_class)
+{
+	llassert(task);
+	if (mWorkers.empty() || mQuitting)
+	{
+		llwarns << "LLThreadPool " << mName << " is not running, task dropped" << llendl;
+		return false;
+	}
+	priority_class = llmin(priority_class, (U32)CLASS_LOW);
+
+	Worker* worker = getCurrentWorker();
+	if (!worker)
+	{
+		worker = mWorkers[mNextWorker++ % mWorkers.size()];
+	}
+	// Counted before the push, a worker may pop the task right away and
+	// mNumQueued must not go below 0
+	mNumQueued++;
+	worker->push(task, priority_class);
+
+	// mNumQueued is tested by waiting workers with mWorkCondition locked, so
+	// signaling with it locked can not be missed
+	mWorkCondition->lock();
+	mWorkCondition->signal();
+	mWorkCondition->unlock();
+	return true;
+}
+
+bool LLThreadPool::isWorkerThread()
+{
+	return getCurrentWorker() != NULL;
+}
+
+LLThreadPool::Worker* LLThreadPool::getCurrentWorker()
+{
+	U32 thread_id = LLThread::currentID();
+	for (U32 i = 0; i < mWorkers.size(); i++)
+	{
+		if (mWorkers[i]->mThreadID == thread_id)
+		{
+			return mWorkers[i];
+		}
+	}
+	return NULL;
+}
+
+//============================================================================
+// WORKER THREADS
+
+LLThreadPool::Task* LLThreadPool::getNextTask(Worker* worker)
+{
+	const U32 num_workers = mWorkers.size();
+	while (1)
+	{
+		if (mQuitting)
+		{
+			return NULL;
+		}
+
+		for (U32 priority_class = 0; priority_class < NUM_CLASSES; priority_class++)
+		{
+			Task* task = worker->popNewest(priority_class);
+			if (task)
+			{
+				return task;
+			}
+			for (U32 i = 1; i < num_workers; i++)
+			{
+				Worker* victim = mWorkers[(worker->mIndex + i) % num_workers];
+				task = victim->popOldest(priority_class);
+				if (task)
+				{
+					mNumStolen++;
+					return task;
+				}
+			}
+		}
+
+		// Nothing to do, sleep until something gets posted
+		mWorkCondition->lock();
+		while (mNumQueued == 0 && !mQuitting)
+		{
+			mWorkCondition->wait();
+		}
+		mWorkCondition->unlock();
+	}
+}
+
+LLThreadPool::Worker::Worker(LLThreadPool* pool, U32 index) :
+	LLThread(llformat("%s worker %d", pool->getName().c_str(), index)),
+	mPool(pool),
+	mIndex(index),
+	mThreadID(0)
+{
+	mQueueMutex = new LLMutex(NULL);
+}
+
+LLThreadPool::Worker::~Worker()
+{
+	delete mQueueMutex;
+}
+
+//virtual
+void LLThreadPool::Worker::run()
+{
+	mThreadID = LLThread::currentID();
+
+	while (Task* task = mPool->getNextTask(this))
+	{
+		task->executeTask();
+		mPool->mNumExecuted++;
+	}
+	llinfos << "LLThreadPool " << mName << " EXITING." << llendl;
+}
+
+void LLThreadPool::Worker::push(Task* task, U32 priority_class)
+{
+	LLMutexLock lock(mQueueMutex);
+	mQueue[priority_class].push_back(task);
+}
+
+LLThreadPool::Task* LLThreadPool::Worker::popNewest(U32 priority_class)
+{
+	LLMutexLock lock(mQueueMutex);
+	if (mQueue[priority_class].empty())
+	{
+		return NULL;
+	}
+	Task* task = mQueue[priority_class].back();
+	mQueue[priority_class].pop_back();
+	mPool->mNumQueued--;
+	return task;
+}
+
+LLThreadPool::Task* LLThreadPool::Worker::popOldest(U32 priority_class)
+{
+	LLMutexLock lock(mQueueMutex);
+	if (mQueue[priority_class].empty())
+	{
+		return NULL;
+	}
+	Task* task = mQueue[priority_class].front();
+	mQueue[priority_class].pop_front();
+	mPool->mNumQueued--;
+	return task;
+}
+
+//============================================================================
+
+// static
+U32 LLThreadPool::getNumCPUCores()
+{
+#if LL_WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	S32 cores = (S32)info.dwNumberOfProcessors;
+#else
+	S32 cores = (S32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (U32)llmax(cores, 1);
+}
@@ -0,0 +1,127 @@
+/**
+ * @file llthreadpool.h
+ * @brief Work stealing pool of worker threads shared by LLQueuedThreads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTHREADPOOL_H
+#define LL_LLTHREADPOOL_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "llapr.h"
+#include "llthread.h"
+
+//============================================================================
+// A fixed set of worker threads executing Tasks.
+//
+// Each worker owns a queue per priority class. A task posted from a worker
+// goes to that worker's own queue, a task posted from any other thread is
+// spread round robin. An idle worker takes the newest task of its own queue
+// and, when that is empty, steals the oldest task of another worker, always
+// emptying a priority class everywhere before looking at the next one.
+//
+// The pool does not own the tasks. Tasks still queued at shutdown are
+// dropped, so shut down the users of the pool (see LLQueuedThread) first.
+
+class LL_COMMON_API LLThreadPool
+{
+public:
+	enum priority_class_t
+	{
+		CLASS_HIGH = 0,
+		CLASS_NORMAL = 1,
+		CLASS_LOW = 2,
+		NUM_CLASSES = 3
+	};
+
+	class LL_COMMON_API Task
+	{
+	public:
+		virtual ~Task() {}
+		// Called from a WORKER THREAD
+		virtual void executeTask() = 0;
+	};
+
+public:
+	// num_workers == 0 creates one worker per CPU core
+	LLThreadPool(const std::string& name, U32 num_workers = 0);
+	~LLThreadPool();
+	void shutdown();
+
+	// May be called from any thread. Returns false, and drops the task, when
+	// the pool is not running.
+	bool post(Task* task, U32 priority_class = CLASS_NORMAL);
+
+	U32 getNumWorkers() const { return mWorkers.size(); }
+	const std::string& getName() const { return mName; }
+	bool isWorkerThread(); // true when called from one of the workers of this pool
+
+	// stats
+	U32 getNumExecuted() { return mNumExecuted; }
+	U32 getNumStolen() { return mNumStolen; }
+	S32 getNumQueued() { return mNumQueued; }
+
+	static U32 getNumCPUCores();
+
+private:
+	// No copy constructor or copy assignment
+	LLThreadPool(const LLThreadPool&);
+	LLThreadPool& operator=(const LLThreadPool&);
+
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLThreadPool* pool, U32 index);
+		~Worker();
+
+		/*virtual*/ void run(void);
+
+		void push(Task* task, U32 priority_class);
+		Task* popNewest(U32 priority_class);
+		Task* popOldest(U32 priority_class);
+
+		LLThreadPool* mPool;
+		U32 mIndex;
+		LLAtomicU32 mThreadID; // set once the thread runs, read by any thread posting to the pool
+		LLMutex* mQueueMutex;
+		std::deque<Task*> mQueue[NUM_CLASSES];
+	};
+
+	Worker* getCurrentWorker();
+	Task* getNextTask(Worker* worker); // blocks until a task is available or the pool is quitting
+
+private:
+	std::string mName;
+	std::vector<Worker*> mWorkers;
+	LLCondition* mWorkCondition; // signaled when a task is posted
+	LLAtomicS32 mNumQueued;
+	LLAtomicU32 mNextWorker; // round robin for tasks posted from outside the pool
+	LLAtomicU32 mNumExecuted;
+	LLAtomicU32 mNumStolen;
+	LLAtomic32<BOOL> mQuitting;
+};
+
+#endif // LL_LLTHREADPOOL_H
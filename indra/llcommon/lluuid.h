@@ -313,6 +313,16 @@ struct lluuid_less
 
 typedef std::set<LLUUID, lluuid_less> uuid_list_t;
 
+// Helper structure for hashing lluuids, folding their random bits.
+// eg: 	LLOpenHashMap<LLUUID, LLWidget*, lluuid_hash> widget_map;
+struct lluuid_hash
+{
+	U32 operator()(const LLUUID& id) const
+	{
+		return id.getCRC32();
+	}
+};
+
 /*
  * Sub-classes for keeping transaction IDs and asset IDs
  * straight.
@@ -34,14 +34,15 @@
 //============================================================================
 // Run on MAIN thread
 
-LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded) :
-	LLQueuedThread(name, threaded)
+LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, LLThreadPool* pool) :
+	LLQueuedThread(name, threaded, pool)
 {
 	mDeleteMutex = new LLMutex(NULL);
 
 	if(!mLocalAPRFilePoolp)
 	{
-		mLocalAPRFilePoolp = new LLVolatileAPRPool() ;
+		// requests may run on several pool workers at once, the file pool then needs its mutex
+		mLocalAPRFilePoolp = new LLVolatileAPRPool(getThreadPool() == NULL) ;
 	}
 }
 
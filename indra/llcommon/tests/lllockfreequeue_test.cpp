@@ -0,0 +1,240 @@
+/**
+ * @file lllockfreequeue_test.cpp
+ * @brief Tests and microbenchmark for LLLockFreeQueue
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lllockfreequeue.h"
+#include "../llthreadsafequeue.h"
+#include "../llthread.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	const U32 NUM_PRODUCERS = 4;
+
+	// Pushes the values producer_id + k * NUM_PRODUCERS, k = 0..count-1, in order
+	class LockFreeProducer : public LLThread
+	{
+	public:
+		LockFreeProducer(LLLockFreeQueue<U32>* queue, U32 id, U32 count) :
+			LLThread("LockFreeProducer"), mQueue(queue), mID(id), mCount(count) {}
+
+		/*virtual*/ void run()
+		{
+			for (U32 k = 0; k < mCount; k++)
+			{
+				while (!mQueue->tryPush(mID + k * NUM_PRODUCERS))
+				{
+					yield();
+				}
+			}
+		}
+
+	private:
+		LLLockFreeQueue<U32>* mQueue;
+		U32 mID;
+		U32 mCount;
+	};
+
+	// Same with the mutex based queue
+	class SafeQueueProducer : public LLThread
+	{
+	public:
+		SafeQueueProducer(LLThreadSafeQueue<U32>* queue, U32 id, U32 count) :
+			LLThread("SafeQueueProducer"), mQueue(queue), mID(id), mCount(count) {}
+
+		/*virtual*/ void run()
+		{
+			for (U32 k = 0; k < mCount; k++)
+			{
+				while (!mQueue->tryPushFront(mID + k * NUM_PRODUCERS))
+				{
+					yield();
+				}
+			}
+		}
+
+	private:
+		LLThreadSafeQueue<U32>* mQueue;
+		U32 mID;
+		U32 mCount;
+	};
+
+	void wait_for_threads(std::vector<LLThread*>& threads)
+	{
+		for (U32 i = 0; i < threads.size(); i++)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		threads.clear();
+	}
+}
+
+namespace tut
+{
+	struct lockfreequeue_test
+	{
+	};
+	typedef test_group<lockfreequeue_test> lockfreequeue_t;
+	typedef lockfreequeue_t::object lockfreequeue_object_t;
+	tut::lockfreequeue_t tut_lockfreequeue("LLLockFreeQueue");
+
+	// Single thread FIFO order, capacity and wrap around
+	template<> template<>
+	void lockfreequeue_object_t::test<1>()
+	{
+		LLLockFreeQueue<U32> queue(5);
+		ensure_equals("capacity rounded up to a power of 2", queue.getCapacity(), (U32)8);
+		ensure("starts empty", queue.empty());
+
+		U32 value = 0;
+		ensure("pop from empty", !queue.tryPop(value));
+		U32 next_push = 0;
+		U32 next_pop = 0;
+		for (S32 lap = 0; lap < 10; lap++)
+		{
+			while (queue.tryPush(next_push))
+			{
+				next_push++;
+			}
+			ensure_equals("full at capacity", queue.size(), (U32)8);
+			for (S32 i = 0; i < 5; i++)
+			{
+				ensure("pop", queue.tryPop(value));
+				ensure_equals("FIFO order", value, next_pop++);
+			}
+		}
+		while (queue.tryPop(value))
+		{
+			ensure_equals("FIFO order", value, next_pop++);
+		}
+		ensure_equals("everything popped", next_pop, next_push);
+		ensure("ends empty", queue.empty());
+	}
+
+	// Several producers, one consumer: nothing lost or duplicated and each
+	// producer's elements come out in order
+	template<> template<>
+	void lockfreequeue_object_t::test<2>()
+	{
+		const U32 COUNT = 200000;
+		LLLockFreeQueue<U32> queue(64);
+		std::vector<LLThread*> producers;
+		for (U32 i = 0; i < NUM_PRODUCERS; i++)
+		{
+			producers.push_back(new LockFreeProducer(&queue, i, COUNT));
+			producers[i]->start();
+		}
+
+		std::vector<U32> next(NUM_PRODUCERS, 0);
+		U32 received = 0;
+		LLTimer timer;
+		while (received < NUM_PRODUCERS * COUNT && timer.getElapsedTimeF32() < 60.f)
+		{
+			U32 value;
+			if (!queue.tryPop(value))
+			{
+				LLThread::yield();
+				continue;
+			}
+			U32 producer = value % NUM_PRODUCERS;
+			ensure_equals("per producer order", value / NUM_PRODUCERS, next[producer]);
+			next[producer]++;
+			received++;
+		}
+		wait_for_threads(producers);
+		ensure_equals("all elements received", received, NUM_PRODUCERS * COUNT);
+		ensure("nothing left", queue.empty());
+	}
+
+	// Microbenchmark: NUM_PRODUCERS threads pushing to one consumer, lock
+	// free ring against the mutex based LLThreadSafeQueue
+	template<> template<>
+	void lockfreequeue_object_t::test<3>()
+	{
+		const U32 COUNT = 250000;
+		const U32 CAPACITY = 1024;
+		F64 lock_free_time;
+		F64 safe_queue_time;
+		{
+			LLLockFreeQueue<U32> queue(CAPACITY);
+			std::vector<LLThread*> producers;
+			LLTimer timer;
+			for (U32 i = 0; i < NUM_PRODUCERS; i++)
+			{
+				producers.push_back(new LockFreeProducer(&queue, i, COUNT));
+				producers[i]->start();
+			}
+			U32 received = 0;
+			U32 value;
+			while (received < NUM_PRODUCERS * COUNT && timer.getElapsedTimeF32() < 60.f)
+			{
+				if (queue.tryPop(value))
+				{
+					received++;
+				}
+			}
+			lock_free_time = llmax(timer.getElapsedTimeF64(), 0.000001);
+			wait_for_threads(producers);
+			ensure_equals("lock free elements received", received, NUM_PRODUCERS * COUNT);
+		}
+		{
+			LLThreadSafeQueue<U32> queue(NULL, CAPACITY);
+			std::vector<LLThread*> producers;
+			LLTimer timer;
+			for (U32 i = 0; i < NUM_PRODUCERS; i++)
+			{
+				producers.push_back(new SafeQueueProducer(&queue, i, COUNT));
+				producers[i]->start();
+			}
+			U32 received = 0;
+			U32 value;
+			while (received < NUM_PRODUCERS * COUNT && timer.getElapsedTimeF32() < 60.f)
+			{
+				if (queue.tryPopBack(value))
+				{
+					received++;
+				}
+			}
+			safe_queue_time = llmax(timer.getElapsedTimeF64(), 0.000001);
+			wait_for_threads(producers);
+			ensure_equals("thread safe queue elements received", received, NUM_PRODUCERS * COUNT);
+		}
+
+		std::cout << "LLLockFreeQueue " << (S32)(NUM_PRODUCERS * COUNT / lock_free_time) << " elements/s, "
+				  << "LLThreadSafeQueue " << (S32)(NUM_PRODUCERS * COUNT / safe_queue_time) << " elements/s ("
+				  << NUM_PRODUCERS << " producers, 1 consumer)" << std::endl;
+	}
+}
@@ -0,0 +1,197 @@
+/**
+ * @file llopenhashmap_test.cpp
+ * @brief Tests of LLOpenHashMap against std::map
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llopenhashmap.h"
+
+#include "../test/lltestrand.h"
+#include "../test/lltut.h"
+
+#include <map>
+
+namespace tut
+{
+	typedef LLOpenHashMap<U32, U32> open_map_t;
+	typedef std::map<U32, U32> std_map_t;
+
+	struct openhashmap_data
+	{
+		void ensureSame(const std::string& msg, const open_map_t& open_map, const std_map_t& std_map)
+		{
+			ensure_equals(msg + " size", open_map.size(), (U32)std_map.size());
+			U32 count = 0;
+			for (open_map_t::const_iterator iter = open_map.begin(); iter != open_map.end(); ++iter)
+			{
+				std_map_t::const_iterator found = std_map.find(iter->first);
+				ensure(msg + " extra key", found != std_map.end());
+				ensure_equals(msg + " value", iter->second, found->second);
+				count++;
+			}
+			ensure_equals(msg + " iterated", count, (U32)std_map.size());
+			for (std_map_t::const_iterator iter = std_map.begin(); iter != std_map.end(); ++iter)
+			{
+				ensure(msg + " missing key", open_map.find(iter->first) != open_map.end());
+			}
+		}
+
+		LLTestRand mRand;
+	};
+	typedef test_group<openhashmap_data> openhashmap_test;
+	typedef openhashmap_test::object openhashmap_object;
+	tut::openhashmap_test openhashmap_testcase("LLOpenHashMap");
+
+	template<> template<>
+	void openhashmap_object::test<1>()
+	{
+		open_map_t open_map;
+		ensure("empty", open_map.empty());
+		ensure("begin is end", open_map.begin() == open_map.end());
+
+		ensure("inserted", open_map.insert(open_map_t::value_type(7, 1)).second);
+		ensure("not inserted twice", !open_map.insert(open_map_t::value_type(7, 2)).second);
+		ensure_equals("kept", open_map[7], 1U);
+		open_map[8] = 3;
+		ensure_equals("size", open_map.size(), 2U);
+		ensure_equals("count", open_map.count(8), 1U);
+		ensure_equals("count missing", open_map.count(9), 0U);
+
+		ensure_equals("erased", open_map.erase(7), 1U);
+		ensure_equals("erased twice", open_map.erase(7), 0U);
+		ensure("not found", open_map.find(7) == open_map.end());
+		ensure_equals("other kept", open_map.find(8)->second, 3U);
+
+		open_map.clear();
+		ensure("cleared", open_map.empty());
+		ensure("nothing left", open_map.find(8) == open_map.end());
+	}
+
+	template<> template<>
+	void openhashmap_object::test<2>()
+	{
+		// packet ids coming and going the way the circuits see them, and
+		// random keys colliding on purpose
+		open_map_t open_map;
+		std_map_t std_map;
+		U32 next_id = 0xfffff0;
+		for (S32 i = 0; i < 20000; i++)
+		{
+			U32 op = mRand.rand(10);
+			if (op < 5)
+			{
+				U32 key = mRand.rand(4) ? next_id++ : mRand.rand(64) << 20;
+				open_map[key] = i;
+				std_map[key] = i;
+			}
+			else if (op < 9 && !std_map.empty())
+			{
+				// erase one of the oldest ids, or one at random
+				U32 key = mRand.rand(2) ? std_map.begin()->first : next_id - mRand.rand(64);
+				ensure_equals("erase", open_map.erase(key), (U32)std_map.erase(key));
+			}
+			else
+			{
+				U32 key = mRand.rand(next_id);
+				ensure_equals("count", open_map.count(key), (U32)std_map.count(key));
+			}
+		}
+		ensureSame("random", open_map, std_map);
+	}
+
+	template<> template<>
+	void openhashmap_object::test<3>()
+	{
+		// erasing while iterating visits every element at least once
+		open_map_t open_map;
+		std_map_t std_map;
+		for (S32 round = 0; round < 50; round++)
+		{
+			for (S32 i = mRand.rand(500); i > 0; i--)
+			{
+				U32 key = mRand.rand(2000);
+				open_map[key] = key;
+				std_map[key] = key;
+			}
+			std::map<U32, S32> visits;
+			for (open_map_t::iterator iter = open_map.begin(); iter != open_map.end(); )
+			{
+				visits[iter->first]++;
+				if (iter->first % 3 == 0)
+				{
+					std_map.erase(iter->first);
+					iter = open_map.erase(iter);
+				}
+				else
+				{
+					++iter;
+				}
+			}
+			for (std::map<U32, S32>::iterator iter = visits.begin(); iter != visits.end(); ++iter)
+			{
+				ensure("visited at most twice", iter->second <= 2);
+			}
+			for (std_map_t::iterator iter = std_map.begin(); iter != std_map.end(); ++iter)
+			{
+				ensure("visited", visits.count(iter->first) == 1);
+			}
+			ensureSame("erase while iterating", open_map, std_map);
+		}
+	}
+
+	template<> template<>
+	void openhashmap_object::test<4>()
+	{
+		// region indexes and local ids packed in 64 bit keys, the way the
+		// object list looks objects up
+		LLOpenHashMap<U64, U32> open_map;
+		std::map<U64, U32> std_map;
+		for (U64 region = 1; region <= 9; region++)
+		{
+			for (U32 local_id = 1000; local_id < 3000; local_id++)
+			{
+				U64 key = (region << 32) | local_id;
+				open_map[key] = local_id;
+				std_map[key] = local_id;
+			}
+		}
+		for (U64 region = 1; region <= 9; region += 2)
+		{
+			for (U32 local_id = 1000; local_id < 3000; local_id += 3)
+			{
+				U64 key = (region << 32) | local_id;
+				ensure_equals("erase", open_map.erase(key), (U32)std_map.erase(key));
+			}
+		}
+		ensure_equals("size", open_map.size(), (U32)std_map.size());
+		for (std::map<U64, U32>::iterator iter = std_map.begin(); iter != std_map.end(); ++iter)
+		{
+			LLOpenHashMap<U64, U32>::iterator found = open_map.find(iter->first);
+			ensure("found", found != open_map.end());
+			ensure_equals("value", found->second, iter->second);
+		}
+		ensure("erased key", open_map.find(((U64)1 << 32) | 1000) == open_map.end());
+	}
+}
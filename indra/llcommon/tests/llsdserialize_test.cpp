@@ -33,6 +33,7 @@
 #include "../llsd.h"
 #include "../llsdserialize.h"
 #include "../llformat.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 
@@ -270,6 +271,15 @@ namespace tut
 			std::cerr << stream.str() << std::endl;
 			throw;
 		}
+
+		// and the same from a buffer
+		std::string str = stream.str();
+		LLSD b;
+		S32 bytes_read = 0;
+		mParser->reset();
+		mParser->parse((const U8*)str.data(), str.size(), b, &bytes_read);
+		ensure_equals((msg + " from buffer").c_str(), b, v);
+		ensure((msg + " buffer read").c_str(), bytes_read > 0 && bytes_read <= (S32)str.size());
 	}
 
 	static void fillmap(LLSD& root, U32 width, U32 depth)
@@ -518,6 +528,13 @@ namespace tut
 			std::string count_msg(msg);
 			count_msg += " (count)";
 			ensure_equals(count_msg, parsed_count, expected_count);
+
+			// the buffer parse agrees with the stream parse
+			LLSD buffer_result;
+			mParser->reset();
+			parsed_count = mParser->parse((const U8*)in.data(), in.size(), buffer_result);
+			ensure_equals((msg + " (buffer)").c_str(), buffer_result, expected_value);
+			ensure_equals(count_msg + " (buffer)", parsed_count, expected_count);
 		}
 
 		LLPointer<parser_t> mParser;
@@ -1494,5 +1511,405 @@ namespace tut
 		ensureBinaryAndNotation("map", test);
 		ensureBinaryAndXML("map", test);
 	}
+
+	/**
+	 * @class TestLLSDBufferParsing
+	 * @brief Parsing contiguous buffers, and a benchmark against the
+	 * stream parsers on an inventory fetch sized payload.
+	 */
+	class TestLLSDBufferParsing
+	{
+	public:
+		// Like an inventory descendents fetch response
+		static LLSD makePayload(S32 folders, S32 items_per_folder)
+		{
+			LLSD payload = LLSD::emptyMap();
+			LLSD& folder_list = payload["folders"] = LLSD::emptyArray();
+			std::vector<U8> thumbnail(64);
+			for(S32 ii = 0; ii < (S32)thumbnail.size(); ++ii)
+			{
+				thumbnail[ii] = (U8)(ii * 7);
+			}
+			for(S32 ff = 0; ff < folders; ++ff)
+			{
+				LLSD folder;
+				folder["folder_id"] = LLUUID::generateNewID();
+				folder["owner_id"] = LLUUID::generateNewID();
+				folder["version"] = ff;
+				folder["descendents"] = items_per_folder;
+				LLSD& items = folder["items"] = LLSD::emptyArray();
+				for(S32 ii = 0; ii < items_per_folder; ++ii)
+				{
+					LLSD item;
+					item["item_id"] = LLUUID::generateNewID();
+					item["parent_id"] = folder["folder_id"];
+					item["name"] = llformat("Object %d/%d \"copy\"", ff, ii);
+					item["desc"] = "(No Description)";
+					item["type"] = 6;
+					item["inv_type"] = 6;
+					item["flags"] = 0;
+					item["created_at"] = LLDate(1262304000.0 + ii);
+					item["sale_info"]["sale_price"] = 10;
+					item["sale_info"]["sale_type"] = "not";
+					item["permissions"]["creator_id"] = LLUUID::generateNewID();
+					item["permissions"]["owner_mask"] = (S32)0x7fffffff;
+					item["permissions"]["group_mask"] = 0;
+					item["permissions"]["is_owner_group"] = false;
+					item["asset_url"] = LLURI("http://example.com/asset");
+					item["scale"] = 0.5;
+					item["thumbnail"] = thumbnail;
+					items.append(item);
+				}
+				folder_list.append(folder);
+			}
+			return payload;
+		}
+
+		static std::string format(LLSDFormatter* formatter, const LLSD& sd)
+		{
+			LLPointer<LLSDFormatter> f(formatter);
+			std::ostringstream ostr;
+			f->format(sd, ostr);
+			return ostr.str();
+		}
+
+		// Every truncation of a serialized map fails, without reading
+		// past the end of the buffer
+		void ensureTruncationFails(const std::string& msg, LLSDParser* parser, const std::string& str)
+		{
+			LLPointer<LLSDParser> p(parser);
+			for(S32 len = 0; len < (S32)str.size(); ++len)
+			{
+				// a copy exactly len long, for valgrind to catch overruns
+				std::vector<U8> buf(str.begin(), str.begin() + len);
+				LLSD sd;
+				p->reset();
+				S32 count = p->parse(buf.empty() ? NULL : &buf[0], len, sd);
+				ensure(llformat("%s truncated to %d", msg.c_str(), len), count <= 0);
+			}
+		}
+
+		// Seconds of the fastest of a few parses of str
+		static F64 timeStream(LLSDParser* parser, const std::string& str, LLSD& sd)
+		{
+			F64 best = 0.0;
+			for(S32 run = 0; run < 3; ++run)
+			{
+				LLTimer timer;
+				std::istringstream istr(str);
+				parser->reset();
+				parser->parse(istr, sd, str.size());
+				F64 elapsed = timer.getElapsedTimeF64();
+				best = run ? llmin(best, elapsed) : elapsed;
+			}
+			return best;
+		}
+
+		static F64 timeBuffer(LLSDParser* parser, const std::string& str, LLSD& sd)
+		{
+			F64 best = 0.0;
+			for(S32 run = 0; run < 3; ++run)
+			{
+				LLTimer timer;
+				parser->reset();
+				parser->parse((const U8*)str.data(), str.size(), sd);
+				F64 elapsed = timer.getElapsedTimeF64();
+				best = run ? llmin(best, elapsed) : elapsed;
+			}
+			return best;
+		}
+
+		void benchmark(const std::string& msg, LLSDParser* parser, const std::string& str, const LLSD& expected)
+		{
+			LLPointer<LLSDParser> p(parser);
+			LLSD stream_sd;
+			LLSD buffer_sd;
+			F64 stream_time = llmax(timeStream(p, str, stream_sd), 0.000001);
+			F64 buffer_time = llmax(timeBuffer(p, str, buffer_sd), 0.000001);
+			ensure_equals((msg + " stream parse").c_str(), stream_sd, expected);
+			ensure_equals((msg + " buffer parse").c_str(), buffer_sd, expected);
+
+			F64 mb = str.size() / (1024.0 * 1024.0);
+			std::cout << msg << " " << llformat("%.1f", mb) << " MB: stream "
+					  << llformat("%.1f", mb / stream_time) << " MB/s, buffer "
+					  << llformat("%.1f", mb / buffer_time) << " MB/s" << std::endl;
+		}
+	};
+
+	typedef tut::test_group<TestLLSDBufferParsing> TestLLSDBufferParsingGroup;
+	typedef TestLLSDBufferParsingGroup::object TestLLSDBufferParsingObject;
+	TestLLSDBufferParsingGroup gTestLLSDBufferParsingGroup("llsd buffer parsing");
+
+	// Objects back to back
+	template<> template<> 
+	void TestLLSDBufferParsingObject::test<1>()
+	{
+		LLSD first = makePayload(1, 2);
+		LLSD second = LLSD::emptyArray();
+		second.append("escaped \\ \"string\"\n");
+		second.append(42);
+		std::string buf = format(new LLSDBinaryFormatter, first) + format(new LLSDBinaryFormatter, second);
+		LLPointer<LLSDParser> parser(new LLSDBinaryParser);
+		LLSD sd;
+		S32 bytes_read = 0;
+		ensure("binary first parsed", parser->parse((const U8*)buf.data(), buf.size(), sd, &bytes_read) > 0);
+		ensure_equals("binary first", sd, first);
+		S32 offset = bytes_read;
+		ensure("binary second parsed", parser->parse((const U8*)buf.data() + offset, buf.size() - offset, sd, &bytes_read) > 0);
+		ensure_equals("binary second", sd, second);
+		ensure_equals("binary all read", offset + bytes_read, (S32)buf.size());
+
+		buf = format(new LLSDNotationFormatter, first) + " " + format(new LLSDNotationFormatter, second);
+		parser = new LLSDNotationParser;
+		ensure("notation first parsed", parser->parse((const U8*)buf.data(), buf.size(), sd, &bytes_read) > 0);
+		ensure_equals("notation first", sd, first);
+		offset = bytes_read;
+		ensure("notation second parsed", parser->parse((const U8*)buf.data() + offset, buf.size() - offset, sd, &bytes_read) > 0);
+		ensure_equals("notation second", sd, second);
+		ensure_equals("notation all read", offset + bytes_read, (S32)buf.size());
+	}
+
+	// Truncated buffers
+	template<> template<> 
+	void TestLLSDBufferParsingObject::test<2>()
+	{
+		LLSD sd = makePayload(1, 2);
+		ensureTruncationFails("binary", new LLSDBinaryParser, format(new LLSDBinaryFormatter, sd));
+		ensureTruncationFails("notation", new LLSDNotationParser, format(new LLSDNotationFormatter, sd));
+	}
+
+	// Benchmark on a few MB
+	template<> template<> 
+	void TestLLSDBufferParsingObject::test<3>()
+	{
+		LLSD payload = makePayload(100, 100);
+		benchmark("binary", new LLSDBinaryParser, format(new LLSDBinaryFormatter, payload), payload);
+		benchmark("notation", new LLSDNotationParser, format(new LLSDNotationFormatter, payload), payload);
+	}
+}
+
+// Counts the heap allocations of the parse benchmarks. Not on Windows,
+// where llcommon is a DLL with its own operator new.
+#if !LL_WINDOWS
+namespace
+{
+	U64 sNewCount = 0;
+}
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+	++sNewCount;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) throw()
+{
+	free(p);
+}
+#endif
+
+namespace tut
+{
+	/**
+	 * @class TestLLSDSAXParsing
+	 * @brief Tests of the XML parser's handler interface and the builder.
+	 */
+	class TestLLSDSAXParsing
+	{
+	public:
+		// Writes down the calls it gets
+		class Recorder : public LLSDSAXHandler
+		{
+		public:
+			virtual void startMap()		{ mCalls << "{ "; }
+			virtual void endMap()		{ mCalls << "} "; }
+			virtual void startArray()	{ mCalls << "[ "; }
+			virtual void endArray()		{ mCalls << "] "; }
+			virtual void key(const char* key, size_t length)
+			{
+				mCalls << "k:" << std::string(key, length) << " ";
+			}
+			virtual void undef()					{ mCalls << "! "; }
+			virtual void boolean(bool value)		{ mCalls << (value ? "t " : "f "); }
+			virtual void integer(S32 value)			{ mCalls << "i:" << value << " "; }
+			virtual void real(F64 value)			{ mCalls << "r:" << value << " "; }
+			virtual void string(const char* value, size_t length)
+			{
+				mCalls << "s:" << std::string(value, length) << " ";
+			}
+			virtual void uuid(const LLUUID& value)	{ mCalls << "u:" << value << " "; }
+			virtual void date(const LLDate& value)	{ mCalls << "d:" << value.asString() << " "; }
+			virtual void uri(const char* value, size_t length)
+			{
+				mCalls << "l:" << std::string(value, length) << " ";
+			}
+			virtual void binary(const U8* value, size_t length)
+			{
+				mCalls << "b:" << std::string((const char*)value, length) << " ";
+			}
+
+			std::ostringstream mCalls;
+		};
+
+		// Fills its own structure, like an inventory fetch would: the
+		// item ids, and how many maps it saw
+		class ItemCollector : public LLSDSAXHandler
+		{
+		public:
+			ItemCollector() : mMaps(0), mItemKey(false) {}
+
+			virtual void startMap()		{ ++mMaps; mItemKey = false; }
+			virtual void endMap()		{}
+			virtual void startArray()	{ mItemKey = false; }
+			virtual void endArray()		{}
+			virtual void key(const char* key, size_t length)
+			{
+				mItemKey = (length == 7) && !strncmp(key, "item_id", length);
+			}
+			virtual void undef()					{ mItemKey = false; }
+			virtual void boolean(bool)				{ mItemKey = false; }
+			virtual void integer(S32)				{ mItemKey = false; }
+			virtual void real(F64)					{ mItemKey = false; }
+			virtual void string(const char*, size_t)	{ mItemKey = false; }
+			virtual void uuid(const LLUUID& value)
+			{
+				if (mItemKey)
+				{
+					mItemIDs.push_back(value);
+				}
+				mItemKey = false;
+			}
+			virtual void date(const LLDate&)		{ mItemKey = false; }
+			virtual void uri(const char*, size_t)	{ mItemKey = false; }
+			virtual void binary(const U8*, size_t)	{ mItemKey = false; }
+
+			S32 mMaps;
+			bool mItemKey;
+			std::vector<LLUUID> mItemIDs;
+		};
+
+		static U64 newCount()
+		{
+#if !LL_WINDOWS
+			return sNewCount;
+#else
+			return 0;
+#endif
+		}
+
+		static void report(const std::string& msg, const std::string& xml, F64 seconds, U64 news, U32 impls)
+		{
+			F64 mb = xml.size() / (1024.0 * 1024.0);
+			std::cout << msg << " " << llformat("%.1f", mb) << " MB: "
+					  << llformat("%.1f", mb / llmax(seconds, 0.000001)) << " MB/s, "
+					  << news << " operator new, " << impls << " LLSD values" << std::endl;
+		}
+	};
+
+	typedef tut::test_group<TestLLSDSAXParsing> TestLLSDSAXParsingGroup;
+	typedef TestLLSDSAXParsingGroup::object TestLLSDSAXParsingObject;
+	TestLLSDSAXParsingGroup gTestLLSDSAXParsingGroup("llsd xml sax parsing");
+
+	// The calls
+	template<> template<> 
+	void TestLLSDSAXParsingObject::test<1>()
+	{
+		std::istringstream xml(
+			"<llsd><map>"
+			"<key>a</key><integer>1</integer>"
+			"<key>b</key><array>"
+			"<string>x</string>"
+			"<uuid>c96f9b1e-f589-4100-9774-d98643ce0bed</uuid>"
+			"<binary encoding=\"base64\">aGVs\n bG8=</binary>"
+			"<undef />"
+			"<foo><integer>2</integer></foo>"
+			"</array>"
+			"<key>c</key><boolean>true</boolean>"
+			"<integer>3</integer>"
+			"<key>d</key><uri>http://example.com/</uri>"
+			"</map></llsd>");
+		Recorder recorder;
+		LLPointer<LLSDXMLParser> parser = new LLSDXMLParser;
+		S32 count = parser->parse(xml, recorder);
+		ensure_equals("calls", recorder.mCalls.str(),
+			"{ k:a i:1 k:b [ s:x u:c96f9b1e-f589-4100-9774-d98643ce0bed b:hello ! ! ] k:c t k:d l:http://example.com/ } ");
+		// the unknown element counts, what is in it and the value
+		// without a key do not
+		ensure_equals("count", count, 10);
+	}
+
+	// The builder builds what the parser does
+	template<> template<> 
+	void TestLLSDSAXParsingObject::test<2>()
+	{
+		LLSD payload = TestLLSDBufferParsing::makePayload(3, 4);
+		payload["folders"].append(LLSD());
+		payload["empty map"] = LLSD::emptyMap();
+		payload["empty array"] = LLSD::emptyArray();
+		std::string xml = TestLLSDBufferParsing::format(new LLSDXMLFormatter, payload);
+
+		LLSDSAXBuilder builder;
+		LLPointer<LLSDXMLParser> parser = new LLSDXMLParser;
+		std::istringstream istr(xml);
+		ensure("parsed", parser->parse(istr, builder) > 0);
+		LLSD built;
+		builder.build(built);
+		ensure_equals("built", built, payload);
+
+		// again with the same arenas
+		builder.reset();
+		LLSD scalar("just a string");
+		std::istringstream scalar_istr(TestLLSDBufferParsing::format(new LLSDXMLFormatter, scalar));
+		parser = new LLSDXMLParser;
+		ensure("scalar parsed", parser->parse(scalar_istr, builder) > 0);
+		builder.build(built);
+		ensure_equals("scalar built", built, scalar);
+
+		builder.reset();
+		builder.build(built);
+		ensure("nothing built", built.isUndefined());
+	}
+
+	// Benchmark: an LLSD, and the item ids straight from the handler
+	template<> template<> 
+	void TestLLSDSAXParsingObject::test<3>()
+	{
+		const S32 FOLDERS = 100;
+		const S32 ITEMS = 100;
+		LLSD payload = TestLLSDBufferParsing::makePayload(FOLDERS, ITEMS);
+		std::string xml = TestLLSDBufferParsing::format(new LLSDXMLFormatter, payload);
+
+		{
+			LLSD parsed;
+			U64 news = TestLLSDSAXParsing::newCount();
+			U32 impls = LLSD::allocationCount();
+			LLTimer timer;
+			std::istringstream istr(xml);
+			LLPointer<LLSDXMLParser> parser = new LLSDXMLParser;
+			parser->parse(istr, parsed, xml.size());
+			F64 elapsed = timer.getElapsedTimeF64();
+			report("xml to LLSD", xml, elapsed, TestLLSDSAXParsing::newCount() - news, LLSD::allocationCount() - impls);
+			ensure_equals("parsed", parsed, payload);
+		}
+		{
+			ItemCollector collector;
+			collector.mItemIDs.reserve(FOLDERS * ITEMS);
+			U64 news = TestLLSDSAXParsing::newCount();
+			U32 impls = LLSD::allocationCount();
+			LLTimer timer;
+			std::istringstream istr(xml);
+			LLPointer<LLSDXMLParser> parser = new LLSDXMLParser;
+			parser->parse(istr, collector);
+			F64 elapsed = timer.getElapsedTimeF64();
+			report("xml to handler", xml, elapsed, TestLLSDSAXParsing::newCount() - news, LLSD::allocationCount() - impls);
+			ensure_equals("items", (S32)collector.mItemIDs.size(), FOLDERS * ITEMS);
+			ensure_equals("first item", collector.mItemIDs[0], payload["folders"][0]["items"][0]["item_id"].asUUID());
+		}
+	}
 }
 
@@ -0,0 +1,384 @@
+/**
+ * @file llthreadpool_test.cpp
+ * @brief Tests and stress test for LLThreadPool and pooled LLQueuedThreads
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llthreadpool.h"
+#include "../llqueuedthread.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	// Counts its executions, optionally posting more of itself from the worker
+	class CountTask : public LLThreadPool::Task
+	{
+	public:
+		CountTask(LLThreadPool* pool, S32 respawn) : mPool(pool), mRespawn(respawn), mCount(0) {}
+
+		/*virtual*/ void executeTask()
+		{
+			mCount++;
+			if (mRespawn > 0)
+			{
+				mRespawn--;
+				mPool->post(this, LLThreadPool::CLASS_LOW);
+			}
+		}
+
+		LLThreadPool* mPool;
+		LLAtomicS32 mRespawn;
+		LLAtomicS32 mCount;
+	};
+
+	// Stands in for the viewer's decode and cache threads: each request
+	// burns some CPU, requests of one queue may run concurrently.
+	class TestQueue : public LLQueuedThread
+	{
+	public:
+		class TestRequest : public LLQueuedThread::QueuedRequest
+		{
+		public:
+			TestRequest(TestQueue* queue, handle_t handle, U32 priority, U32 flags, S32 work) :
+				LLQueuedThread::QueuedRequest(handle, priority, flags),
+				mQueue(queue),
+				mWork(work)
+			{
+			}
+
+			/*virtual*/ bool processRequest()
+			{
+				mQueue->enter();
+				U32 x = mHashKey;
+				for (S32 i = 0; i < mWork; i++)
+				{
+					x = x * 1664525 + 1013904223;
+				}
+				mQueue->mResult += x & 1;
+				mQueue->leave();
+				return true;
+			}
+
+			/*virtual*/ void finishRequest(bool completed)
+			{
+				if (completed)
+				{
+					mQueue->mCompleted++;
+				}
+			}
+
+		private:
+			TestQueue* mQueue;
+			S32 mWork;
+		};
+
+		TestQueue(const std::string& name, LLThreadPool* pool) :
+			LLQueuedThread(name, true, pool),
+			mCompleted(0),
+			mResult(0),
+			mActive(0),
+			mMaxActive(0)
+		{
+			mActiveMutex = new LLMutex(NULL);
+		}
+		~TestQueue()
+		{
+			shutdown(); // requests in progress use mActiveMutex
+			delete mActiveMutex;
+		}
+
+		handle_t addTestRequest(S32 work, U32 flags = FLAG_AUTO_COMPLETE, handle_t handle = nullHandle())
+		{
+			if (handle == nullHandle())
+			{
+				handle = generateHandle();
+			}
+			addRequest(new TestRequest(this, handle, PRIORITY_NORMAL, flags, work));
+			return handle;
+		}
+
+		handle_t newHandle()
+		{
+			return generateHandle();
+		}
+
+		void enter()
+		{
+			LLMutexLock lock(mActiveMutex);
+			mActive++;
+			mMaxActive = llmax(mMaxActive, mActive);
+		}
+		void leave()
+		{
+			LLMutexLock lock(mActiveMutex);
+			mActive--;
+		}
+
+		LLAtomicS32 mCompleted;
+		LLAtomicU32 mResult;
+		LLMutex* mActiveMutex;
+		S32 mActive;
+		S32 mMaxActive;
+	};
+
+	void wait_for(LLQueuedThread* queue, LLAtomicS32& completed, S32 count)
+	{
+		LLTimer timer;
+		while (completed < count && timer.getElapsedTimeF32() < 60.f)
+		{
+			queue->update(0);
+			ms_sleep(1);
+		}
+	}
+}
+
+namespace tut
+{
+	struct threadpool_test
+	{
+	};
+	typedef test_group<threadpool_test> threadpool_t;
+	typedef threadpool_t::object threadpool_object_t;
+	tut::threadpool_t tut_threadpool("LLThreadPool");
+
+	// Every task posted, from the main thread or from a worker, runs once
+	template<> template<>
+	void threadpool_object_t::test<1>()
+	{
+		LLThreadPool pool("test", 4);
+		ensure_equals("workers", pool.getNumWorkers(), (U32)4);
+		ensure("main thread is not a worker", !pool.isWorkerThread());
+
+		const S32 NUM_TASKS = 16;
+		const S32 RESPAWN = 1000;
+		std::vector<CountTask*> tasks;
+		for (S32 i = 0; i < NUM_TASKS; i++)
+		{
+			tasks.push_back(new CountTask(&pool, RESPAWN));
+			pool.post(tasks[i], i % LLThreadPool::NUM_CLASSES);
+		}
+		LLTimer timer;
+		while (pool.getNumExecuted() < (U32)(NUM_TASKS * (RESPAWN + 1)) && timer.getElapsedTimeF32() < 60.f)
+		{
+			ms_sleep(1);
+		}
+		for (S32 i = 0; i < NUM_TASKS; i++)
+		{
+			ensure_equals("task executed once per post", (S32)tasks[i]->mCount, RESPAWN + 1);
+		}
+		ensure_equals("nothing left queued", (S32)pool.getNumQueued(), 0);
+		pool.shutdown();
+		for (S32 i = 0; i < NUM_TASKS; i++)
+		{
+			delete tasks[i];
+		}
+	}
+
+	// The LLQueuedThread API is unchanged on a pool and max_concurrency is honored
+	template<> template<>
+	void threadpool_object_t::test<2>()
+	{
+		LLThreadPool pool("test", 4);
+		{
+			TestQueue queue("serial", &pool);
+			ensure("pooled queue", queue.getThreadPool() == &pool);
+			ensure("pooled queue is running", !queue.isStopped());
+
+			LLQueuedThread::handle_t handle = queue.addTestRequest(1000, 0);
+			ensure("waitForResult", queue.waitForResult(handle, false));
+			ensure_equals("request complete", queue.getRequestStatus(handle), LLQueuedThread::STATUS_COMPLETE);
+			ensure("completeRequest", queue.completeRequest(handle));
+			ensure_equals("request gone", queue.getRequestStatus(handle), LLQueuedThread::STATUS_EXPIRED);
+
+			const S32 NUM_REQUESTS = 500;
+			for (S32 i = 0; i < NUM_REQUESTS; i++)
+			{
+				queue.addTestRequest(20000);
+			}
+			wait_for(&queue, queue.mCompleted, NUM_REQUESTS + 1);
+			ensure_equals("all requests completed", (S32)queue.mCompleted, NUM_REQUESTS + 1);
+			ensure_equals("one request at a time by default", queue.mMaxActive, 1);
+		}
+		{
+			TestQueue queue("parallel", &pool);
+			queue.setPoolOptions(LLThreadPool::CLASS_HIGH, 3);
+			const S32 NUM_REQUESTS = 500;
+			for (S32 i = 0; i < NUM_REQUESTS; i++)
+			{
+				queue.addTestRequest(200000);
+			}
+			wait_for(&queue, queue.mCompleted, NUM_REQUESTS);
+			ensure_equals("all parallel requests completed", (S32)queue.mCompleted, NUM_REQUESTS);
+			ensure("at most max_concurrency requests at a time", queue.mMaxActive <= 3);
+		}
+		{
+			// Requests still queued when the queue is destroyed are aborted
+			TestQueue queue("abandoned", &pool);
+			for (S32 i = 0; i < 100; i++)
+			{
+				queue.addTestRequest(200000);
+			}
+		}
+	}
+
+	// Handles are valid as soon as addRequest() returns, auto completed
+	// requests expire as soon as they complete
+	template<> template<>
+	void threadpool_object_t::test<4>()
+	{
+		LLThreadPool pool("test", 2);
+		TestQueue queue("handles", &pool);
+
+		// Paused: the requests stay in the incoming ring
+		queue.pause();
+		LLQueuedThread::handle_t handle = queue.addTestRequest(1000, 0);
+		LLQueuedThread::handle_t other = queue.addTestRequest(1000, 0);
+		ensure_equals("queued", queue.getRequestStatus(handle), LLQueuedThread::STATUS_QUEUED);
+		queue.setPriority(other, LLQueuedThread::PRIORITY_HIGH);
+		ensure_equals("priority", queue.getRequest(other)->getPriority(), (U32)LLQueuedThread::PRIORITY_HIGH);
+		ensure("waitForResult", queue.waitForResult(handle));
+		ensure_equals("completed and deleted", queue.getRequestStatus(handle), LLQueuedThread::STATUS_EXPIRED);
+		ensure("waitForResult other", queue.waitForResult(other));
+
+		// More requests than the ring holds, added without a lookup in between
+		const S32 NUM_REQUESTS = 3000;
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 i = 0; i < NUM_REQUESTS; i++)
+		{
+			handles.push_back(queue.newHandle());
+		}
+		queue.pause();
+		for (S32 i = 0; i < NUM_REQUESTS; i++)
+		{
+			queue.addTestRequest(1000, 0, handles[i]);
+		}
+		for (S32 i = 0; i < NUM_REQUESTS; i++)
+		{
+			ensure_equals("queued past the ring", queue.getRequestStatus(handles[i]), LLQueuedThread::STATUS_QUEUED);
+		}
+		for (S32 i = 0; i < NUM_REQUESTS; i++)
+		{
+			ensure("waitForResult past the ring", queue.waitForResult(handles[i]));
+		}
+
+		// Expired once complete, before update() deletes it
+		queue.unpause();
+		S32 completed = queue.mCompleted;
+		handle = queue.addTestRequest(1000);
+		LLTimer timer;
+		while (queue.mCompleted == completed && timer.getElapsedTimeF32() < 60.f)
+		{
+			ms_sleep(1);
+		}
+		ensure_equals("auto completed", queue.getRequestStatus(handle), LLQueuedThread::STATUS_EXPIRED);
+		ensure("no request", queue.getRequest(handle) == NULL);
+		ensure("nothing to complete", !queue.completeRequest(handle));
+		ensure("no result to wait for", !queue.waitForResult(handle));
+		queue.update(0);
+		ensure_equals("deleted by update", queue.getRequestStatus(handle), LLQueuedThread::STATUS_EXPIRED);
+	}
+
+	// A task the pool can't take back once it shuts down is retired: the
+	// queue doesn't wait for it when destroyed
+	template<> template<>
+	void threadpool_object_t::test<5>()
+	{
+		LLThreadPool pool("test", 1);
+		TestQueue queue("orphaned", &pool);
+		for (S32 i = 0; i < 4; i++)
+		{
+			queue.addTestRequest(20000000);
+		}
+		LLTimer timer;
+		while (queue.mActive == 0 && timer.getElapsedTimeF32() < 60.f)
+		{
+			ms_sleep(1);
+		}
+		// Finishes the request in progress, its PoolTask can't repost
+		pool.shutdown();
+		ensure("requests left", queue.mCompleted < 4);
+
+		timer.reset();
+		queue.shutdown();
+		ensure("no task left behind", timer.getElapsedTimeF32() < 5.f);
+	}
+
+	// Stress: a CPU bound "decode" queue and a "cache" queue sharing one pool,
+	// throughput for several pool sizes
+	template<> template<>
+	void threadpool_object_t::test<3>()
+	{
+		const S32 NUM_DECODES = 2000;
+		const S32 NUM_CACHE_READS = 2000;
+		const S32 DECODE_WORK = 400000;
+		const S32 CACHE_WORK = 20000;
+		const U32 max_workers = llmax(LLThreadPool::getNumCPUCores(), (U32)8);
+
+		F64 single_time = 0.0;
+		for (U32 num_workers = 1; num_workers <= max_workers; num_workers *= 2)
+		{
+			LLThreadPool pool("stress", num_workers);
+			TestQueue decode("decode", &pool);
+			decode.setPoolOptions(LLThreadPool::CLASS_NORMAL, num_workers);
+			TestQueue cache("cache", &pool);
+			cache.setPoolOptions(LLThreadPool::CLASS_HIGH, 1);
+
+			LLTimer timer;
+			for (S32 i = 0; i < llmax(NUM_DECODES, NUM_CACHE_READS); i++)
+			{
+				if (i < NUM_DECODES)
+				{
+					decode.addTestRequest(DECODE_WORK);
+				}
+				if (i < NUM_CACHE_READS)
+				{
+					cache.addTestRequest(CACHE_WORK);
+				}
+			}
+			wait_for(&decode, decode.mCompleted, NUM_DECODES);
+			wait_for(&cache, cache.mCompleted, NUM_CACHE_READS);
+			F64 elapsed = llmax(timer.getElapsedTimeF64(), 0.000001);
+			if (num_workers == 1)
+			{
+				single_time = elapsed;
+			}
+
+			std::cout << "LLThreadPool " << num_workers << " workers: "
+					  << (S32)((NUM_DECODES + NUM_CACHE_READS) / elapsed) << " requests/s, "
+					  << "speedup " << single_time / elapsed << ", "
+					  << pool.getNumStolen() << " stolen" << std::endl;
+
+			ensure_equals("decodes completed", (S32)decode.mCompleted, NUM_DECODES);
+			ensure_equals("cache reads completed", (S32)cache.mCompleted, NUM_CACHE_READS);
+			ensure_equals("cache stays serial", cache.mMaxActive, 1);
+			ensure("decode concurrency bounded", decode.mMaxActive <= (S32)num_workers);
+		}
+	}
+}
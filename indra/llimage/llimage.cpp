@@ -35,6 +35,7 @@
 #include "llimagebmp.h"
 #include "llimagetga.h"
 #include "llimagej2c.h"
+#include "llimagej2cdecodecache.h"
 #include "llimagejpeg.h"
 #include "llimagepng.h"
 #include "llimagedxt.h"
@@ -53,11 +54,13 @@ void LLImage::initClass()
 {
 	sMutex = new LLMutex(NULL);
 	LLImageJ2C::openDSO();
+	LLImageJ2CDecodeCache::initClass();
 }
 
 //static
 void LLImage::cleanupClass()
 {
+	LLImageJ2CDecodeCache::cleanupClass();
 	LLImageJ2C::closeDSO();
 	delete sMutex;
 	sMutex = NULL;
@@ -29,6 +29,7 @@
 
 #include "lldir.h"
 #include "llimagej2c.h"
+#include "llimagej2cdecodecache.h"
 #include "llmemtype.h"
 #include "lltimer.h"
 #include "llmath.h"
@@ -314,8 +315,19 @@ BOOL LLImageJ2C::decodeChannels(LLImageRaw *raw_imagep, F32 decode_time, S32 fir
 	{
 		// Update the raw discard level
 		updateRawDiscardLevel();
+		// Still decoding when the LLImageJ2CImpl ran out of time last call
+		BOOL resume = mDecoding;
 		mDecoding = TRUE;
-		res = mImpl->decodeImpl(*this, *raw_imagep, decode_time, first_channel, max_channel_count);
+		if (resume || !LLImageJ2CDecodeCache::decode(getData(), getDataSize(), getRawDiscardLevel(),
+													 *raw_imagep, first_channel, max_channel_count))
+		{
+			res = mImpl->decodeImpl(*this, *raw_imagep, decode_time, first_channel, max_channel_count);
+			if (res && mDecoding)
+			{
+				LLImageJ2CDecodeCache::retain(getData(), getDataSize(), getRawDiscardLevel(), getWidth(), getHeight(),
+											  *raw_imagep, first_channel, max_channel_count);
+			}
+		}
 	}
 	
 	if (res)
@@ -0,0 +1,280 @@
+/**
+ * @file llimagej2cdecodecache.cpp
+ * @brief Output of recent J2C decodes, reused for coarser discard levels
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llimagej2cdecodecache.h"
+
+#include "llimage.h"
+#include "llthread.h"
+
+namespace
+{
+	// FNV-1a, a lot cheaper than decoding the code stream again. 64 bits, a
+	// collision would show the wrong texture.
+	U64 hash_code_stream(const U8* data, S32 size)
+	{
+		U64 hash = 14695981039346656037ULL;
+		for (S32 i = 0; i < size; i++)
+		{
+			hash = (hash ^ data[i]) * 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	// Divides a by 2 to the power of b, rounding up, as the J2C resolution levels do
+	S32 ceildivpow2(S32 a, S32 b)
+	{
+		return (a + (1 << b) - 1) >> b;
+	}
+}
+
+LLMutex* LLImageJ2CDecodeCache::sMutex = NULL;
+LLImageJ2CDecodeCache::entry_list_t LLImageJ2CDecodeCache::sEntries;
+LLImageJ2CDecodeCache::entry_map_t LLImageJ2CDecodeCache::sEntryMap;
+S32 LLImageJ2CDecodeCache::sMaxBytes = 0;
+S32 LLImageJ2CDecodeCache::sBytes = 0;
+U32 LLImageJ2CDecodeCache::sHits = 0;
+U32 LLImageJ2CDecodeCache::sReducedHits = 0;
+U32 LLImageJ2CDecodeCache::sMisses = 0;
+
+bool LLImageJ2CDecodeCache::Key::operator<(const Key& rhs) const
+{
+	if (mHash != rhs.mHash)
+	{
+		return mHash < rhs.mHash;
+	}
+	if (mDataSize != rhs.mDataSize)
+	{
+		return mDataSize < rhs.mDataSize;
+	}
+	return mFirstChannel < rhs.mFirstChannel;
+}
+
+//static
+void LLImageJ2CDecodeCache::initClass()
+{
+	sMutex = new LLMutex(NULL);
+}
+
+//static
+void LLImageJ2CDecodeCache::cleanupClass()
+{
+	if (sMutex)
+	{
+		LLMutexLock lock(sMutex);
+		evictEntries(0);
+	}
+	delete sMutex;
+	sMutex = NULL;
+}
+
+//static
+void LLImageJ2CDecodeCache::setCacheSize(S32 max_bytes)
+{
+	max_bytes = llmax(max_bytes, 0);
+	if (!sMutex)
+	{
+		sMaxBytes = max_bytes;
+		return;
+	}
+	LLMutexLock lock(sMutex);
+	sMaxBytes = max_bytes;
+	evictEntries(max_bytes);
+}
+
+//static
+LLImageJ2CDecodeCache::Key LLImageJ2CDecodeCache::makeKey(const U8* data, S32 data_size, S32 first_channel)
+{
+	Key key;
+	key.mHash = hash_code_stream(data, data_size);
+	key.mDataSize = data_size;
+	key.mFirstChannel = first_channel;
+	return key;
+}
+
+//static
+LLImageJ2CDecodeCache::Entry* LLImageJ2CDecodeCache::acquireEntry(const Key& key)
+{
+	LLMutexLock lock(sMutex);
+	entry_map_t::iterator iter = sEntryMap.find(key);
+	if (iter == sEntryMap.end())
+	{
+		return NULL;
+	}
+	Entry* entry = *iter->second;
+	sEntries.erase(iter->second);
+	sEntryMap.erase(iter);
+	sBytes -= entry->mData.size();
+	return entry;
+}
+
+//static
+void LLImageJ2CDecodeCache::retainEntry(Entry* entry)
+{
+	LLMutexLock lock(sMutex);
+	S32 bytes = entry->mData.size();
+	if (bytes > sMaxBytes)
+	{
+		delete entry;
+		return;
+	}
+	entry_map_t::iterator iter = sEntryMap.find(entry->mKey);
+	if (iter != sEntryMap.end())
+	{
+		// decoded meanwhile by another thread
+		Entry* other = *iter->second;
+		sBytes -= other->mData.size();
+		sEntries.erase(iter->second);
+		sEntryMap.erase(iter);
+		delete other;
+	}
+	evictEntries(sMaxBytes - bytes);
+	sEntryMap[entry->mKey] = sEntries.insert(sEntries.begin(), entry);
+	sBytes += bytes;
+}
+
+//static
+void LLImageJ2CDecodeCache::evictEntries(S32 max_bytes)
+{
+	while (!sEntries.empty() && sBytes > max_bytes)
+	{
+		Entry* lru = sEntries.back();
+		sBytes -= lru->mData.size();
+		sEntryMap.erase(lru->mKey);
+		sEntries.pop_back();
+		delete lru;
+	}
+}
+
+//static
+bool LLImageJ2CDecodeCache::decode(const U8* data, S32 data_size, S32 discard,
+								   LLImageRaw& raw_image, S32 first_channel, S32 max_channel_count)
+{
+	if (!sMaxBytes || !sMutex || discard < 0 || max_channel_count < 1)
+	{
+		return false;
+	}
+
+	Entry* entry = acquireEntry(makeKey(data, data_size, first_channel));
+	bool served = entry
+		&& entry->mDiscard <= discard
+		&& (entry->mAllChannels || max_channel_count <= entry->mComponents);
+	if (served)
+	{
+		copyEntry(*entry, discard, raw_image, llmin(entry->mComponents, max_channel_count));
+	}
+
+	{
+		LLMutexLock lock(sMutex);
+		if (!served)
+		{
+			sMisses++;
+		}
+		else if (entry->mDiscard == discard)
+		{
+			sHits++;
+		}
+		else
+		{
+			sReducedHits++;
+		}
+	}
+
+	if (entry)
+	{
+		retainEntry(entry);
+	}
+	return served;
+}
+
+//static
+void LLImageJ2CDecodeCache::retain(const U8* data, S32 data_size, S32 discard, S32 full_width, S32 full_height,
+								   LLImageRaw& raw_image, S32 first_channel, S32 max_channel_count)
+{
+	if (!sMaxBytes || !sMutex || discard < 0
+		|| !raw_image.getData() || raw_image.getComponents() < 1
+		|| raw_image.getWidth() != ceildivpow2(full_width, discard)
+		|| raw_image.getHeight() != ceildivpow2(full_height, discard))
+	{
+		return;
+	}
+
+	Entry* entry = new Entry;
+	entry->mKey = makeKey(data, data_size, first_channel);
+	entry->mDiscard = discard;
+	entry->mFullWidth = full_width;
+	entry->mFullHeight = full_height;
+	entry->mWidth = raw_image.getWidth();
+	entry->mHeight = raw_image.getHeight();
+	entry->mComponents = raw_image.getComponents();
+	entry->mAllChannels = entry->mComponents < max_channel_count;
+	const U8* rawp = raw_image.getData();
+	entry->mData.assign(rawp, rawp + entry->mWidth * entry->mHeight * entry->mComponents);
+	retainEntry(entry);
+}
+
+// Each pixel at discard averages the block of pixels it covers at the kept
+// level, clipped on the right and bottom edges of the image.
+//static
+void LLImageJ2CDecodeCache::copyEntry(const Entry& entry, S32 discard, LLImageRaw& raw_image, S32 channels)
+{
+	const S32 width = ceildivpow2(entry.mFullWidth, discard);
+	const S32 height = ceildivpow2(entry.mFullHeight, discard);
+	const S32 scale = discard - entry.mDiscard;
+	const S32 src_components = entry.mComponents;
+	raw_image.resize(width, height, channels);
+	U8* rawp = raw_image.getData();
+	const U8* src = &entry.mData[0];
+
+	// Rows are numbered from the top of the image here, LLImageRaw stores
+	// them bottom row first
+	for (S32 y = 0; y < height; y++)
+	{
+		U8* dst = rawp + (height - 1 - y) * width * channels;
+		const S32 y0 = y << scale;
+		const S32 y1 = llmin((y + 1) << scale, entry.mHeight);
+		for (S32 x = 0; x < width; x++)
+		{
+			const S32 x0 = x << scale;
+			const S32 x1 = llmin((x + 1) << scale, entry.mWidth);
+			const U32 count = (U32)((y1 - y0) * (x1 - x0));
+			for (S32 c = 0; c < channels; c++)
+			{
+				U32 sum = 0;
+				for (S32 sy = y0; sy < y1; sy++)
+				{
+					const U8* row = src + (entry.mHeight - 1 - sy) * entry.mWidth * src_components;
+					for (S32 sx = x0; sx < x1; sx++)
+					{
+						sum += row[sx * src_components + c];
+					}
+				}
+				*dst++ = (U8)((sum + count / 2) / count);
+			}
+		}
+	}
+}
@@ -0,0 +1,118 @@
+/**
+ * @file llimagej2cdecodecache.h
+ * @brief Output of recent J2C decodes, reused for coarser discard levels
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGEJ2CDECODECACHE_H
+#define LL_LLIMAGEJ2CDECODECACHE_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+class LLImageRaw;
+class LLMutex;
+
+// Keeps the raw images the LLImageJ2CImpl decoded, keyed by the code stream
+// they came from. Decoding the same code stream again, at the same or a
+// coarser discard level, is served from there: coarser levels are box
+// filtered from the kept one. Nothing is parsed here, the code stream is
+// only hashed, and the LLImageJ2CImpl (a prebuilt DSO with KDU) is unchanged.
+//
+// The kept images share one byte budget and are evicted least recently used
+// first.
+class LLImageJ2CDecodeCache
+{
+public:
+	static void initClass();
+	static void cleanupClass();
+
+	// Byte budget of the kept images, 0 disables the cache
+	static void setCacheSize(S32 max_bytes);
+	static S32 getCacheSize() { return sMaxBytes; }
+	static S32 getCacheBytes() { return sBytes; }
+
+	// Fills raw_image with channels [first_channel, first_channel + max_channel_count)
+	// of data at discard level, from an image decoded from the same data at
+	// that level or a finer one. Returns false, and leaves raw_image alone,
+	// when there is none.
+	static bool decode(const U8* data, S32 data_size, S32 discard,
+					   LLImageRaw& raw_image, S32 first_channel, S32 max_channel_count);
+	// Keeps raw_image, decoded from data at discard level with
+	// decodeChannels(first_channel, max_channel_count). full_width and
+	// full_height are the image size at discard level 0.
+	static void retain(const U8* data, S32 data_size, S32 discard, S32 full_width, S32 full_height,
+					   LLImageRaw& raw_image, S32 first_channel, S32 max_channel_count);
+
+	// Decodes served at the same discard level, at a coarser one, not served
+	static U32 getHits() { return sHits; }
+	static U32 getReducedHits() { return sReducedHits; }
+	static U32 getMisses() { return sMisses; }
+
+private:
+	struct Key
+	{
+		U64 mHash;
+		S32 mDataSize;
+		S32 mFirstChannel;
+		bool operator<(const Key& rhs) const;
+	};
+	struct Entry
+	{
+		Key mKey;
+		S32 mDiscard;
+		S32 mFullWidth;			// at discard level 0
+		S32 mFullHeight;
+		S32 mWidth;				// at mDiscard
+		S32 mHeight;
+		S32 mComponents;
+		bool mAllChannels;		// no channel after the kept ones
+		std::vector<U8> mData;	// as in LLImageRaw, bottom row first
+	};
+	typedef std::list<Entry*> entry_list_t;
+	typedef std::map<Key, entry_list_t::iterator> entry_map_t;
+
+	static Key makeKey(const U8* data, S32 data_size, S32 first_channel);
+	// Takes the entry of key out of the cache, so that it can't be evicted
+	// while in use. Returns NULL when there is none.
+	static Entry* acquireEntry(const Key& key);
+	// Puts entry back in the cache as the most recently used one, replacing
+	// any other entry of the same key. Evicts least recently used entries to
+	// stay in budget, entry itself if it alone exceeds it.
+	static void retainEntry(Entry* entry);
+	// sMutex must be locked
+	static void evictEntries(S32 max_bytes);
+	static void copyEntry(const Entry& entry, S32 discard, LLImageRaw& raw_image, S32 channels);
+
+	static LLMutex* sMutex;
+	static entry_list_t sEntries; // most recently used first
+	static entry_map_t sEntryMap;
+	static S32 sMaxBytes;
+	static S32 sBytes;
+	static U32 sHits;
+	static U32 sReducedHits;
+	static U32 sMisses;
+};
+
+#endif
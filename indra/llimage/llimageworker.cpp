@@ -32,10 +32,49 @@
 //----------------------------------------------------------------------------
 
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
-	: LLQueuedThread("imagedecode", threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, LLThreadPool* pool, U32 num_decoders)
+	: LLQueuedThread("imagedecode", threaded, createDecoderPool(threaded, pool, num_decoders)),
+	  mOwnThreadPool(NULL),
+	  mNumDecoders(1)
 {
 	mCreationMutex = new LLMutex(getAPRPool());
+
+	if (getThreadPool())
+	{
+		if (getThreadPool() != pool)
+		{
+			mOwnThreadPool = getThreadPool();
+		}
+		mNumDecoders = num_decoders ? llmin(num_decoders, getThreadPool()->getNumWorkers()) : getThreadPool()->getNumWorkers();
+		// Requests are still taken in priority order, mNumDecoders at a time
+		setPoolOptions(LLThreadPool::CLASS_NORMAL, mNumDecoders);
+	}
+}
+
+// MAIN THREAD
+LLImageDecodeThread::~LLImageDecodeThread()
+{
+	// Done with the pool workers before the pool goes away
+	shutdown();
+	delete mOwnThreadPool;
+	mOwnThreadPool = NULL;
+	delete mCreationMutex;
+	mCreationMutex = NULL;
+}
+
+// static
+LLThreadPool* LLImageDecodeThread::createDecoderPool(bool threaded, LLThreadPool* pool, U32 num_decoders)
+{
+	if (!threaded || pool)
+	{
+		return pool;
+	}
+	if (num_decoders == 0)
+	{
+		num_decoders = LLThreadPool::getNumCPUCores();
+	}
+	// A single decoder keeps the historical dedicated thread
+	return num_decoders > 1 ? new LLThreadPool("imagedecode", num_decoders) : NULL;
 }
 
 // MAIN THREAD
@@ -72,12 +72,18 @@ public:
 	};
 	
 public:
-	LLImageDecodeThread(bool threaded = true);
+	// Up to num_decoders images (0 = one per CPU core) are decoded at once, by
+	// the workers of pool or, when threaded without a pool and num_decoders > 1,
+	// by a pool of our own.
+	LLImageDecodeThread(bool threaded = true, LLThreadPool* pool = NULL, U32 num_decoders = 1);
+	~LLImageDecodeThread();
 	handle_t decodeImage(LLImageFormatted* image,
 						 U32 priority, S32 discard, BOOL needs_aux,
 						 Responder* responder);
 	S32 update(U32 max_time_ms);
 
+	U32 getNumDecoders() const { return mNumDecoders; }
+
 	// Used by unit tests to check the consistency of the thread instance
 	S32 tut_size();
 	
@@ -97,6 +103,10 @@ private:
 	typedef std::list<creation_info> creation_list_t;
 	creation_list_t mCreationList;
 	LLMutex* mCreationMutex;
+
+	static LLThreadPool* createDecoderPool(bool threaded, LLThreadPool* pool, U32 num_decoders);
+	LLThreadPool* mOwnThreadPool; // when not given one
+	U32 mNumDecoders;
 };
 
 #endif
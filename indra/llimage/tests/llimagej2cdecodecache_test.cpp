@@ -0,0 +1,277 @@
+/**
+ * @file llimagej2cdecodecache_test.cpp
+ * @brief Test cases of llimagej2cdecodecache.cpp
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+// Class to test
+#include "../llimagej2cdecodecache.h"
+// Dependencies
+#include "../llimage.h"
+#include "llpointer.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// A simulator of LLImageRaw: resize() allocates the buffer the cache fills.
+
+LLImageBase::LLImageBase()
+	: mData(NULL),
+	  mDataSize(0),
+	  mWidth(0),
+	  mHeight(0),
+	  mComponents(0),
+	  mBadBufferAllocation(false),
+	  mAllowOverSize(false),
+	  mMemType(LLMemType::MTYPE_IMAGEBASE)
+{
+}
+LLImageBase::~LLImageBase() { delete[] mData; }
+void LLImageBase::dump() { }
+void LLImageBase::sanityCheck() { }
+void LLImageBase::deleteData() { delete[] mData; mData = NULL; mDataSize = 0; }
+U8* LLImageBase::allocateData(S32 size) { return NULL; }
+U8* LLImageBase::reallocateData(S32 size) { return NULL; }
+U8* LLImageBase::getData() { return mData; }
+U8* LLImageBase::allocateDataSize(S32 width, S32 height, S32 ncomponents, S32 size)
+{
+	deleteData();
+	mWidth = width;
+	mHeight = height;
+	mComponents = ncomponents;
+	mDataSize = width * height * ncomponents;
+	mData = new U8[mDataSize];
+	return mData;
+}
+
+LLImageRaw::LLImageRaw() { }
+LLImageRaw::~LLImageRaw() { }
+void LLImageRaw::deleteData() { LLImageBase::deleteData(); }
+U8* LLImageRaw::allocateData(S32 size) { return NULL; }
+U8* LLImageRaw::reallocateData(S32 size) { return NULL; }
+BOOL LLImageRaw::resize(U16 width, U16 height, S8 components)
+{
+	allocateDataSize(width, height, components);
+	return TRUE;
+}
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// Value of channel c of pixel (x, y), y from the top of the image
+	U8 pattern(S32 x, S32 y, S32 c)
+	{
+		return (x * 9 + y * 5 + c * 40 + ((x * y) % 7) * 3) & 255;
+	}
+
+	// A decoded image of the pattern, bottom row first as in LLImageRaw
+	LLPointer<LLImageRaw> make_raw(S32 width, S32 height, S32 components)
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw();
+		raw->resize(width, height, components);
+		U8* rawp = raw->getData();
+		for (S32 y = 0; y < height; y++)
+		{
+			for (S32 x = 0; x < width; x++)
+			{
+				for (S32 c = 0; c < components; c++)
+				{
+					rawp[((height - 1 - y) * width + x) * components + c] = pattern(x, y, c);
+				}
+			}
+		}
+		return raw;
+	}
+
+	// Channel c of pixel (x, y), y from the top of the image
+	U8 get_pixel(LLImageRaw* raw, S32 x, S32 y, S32 c)
+	{
+		return raw->getData()[((raw->getHeight() - 1 - y) * raw->getWidth() + x) * raw->getComponents() + c];
+	}
+}
+
+namespace tut
+{
+	struct j2cdecodecache_test
+	{
+		std::vector<U8> mData;
+
+		j2cdecodecache_test()
+		{
+			LLImageJ2CDecodeCache::initClass();
+			LLImageJ2CDecodeCache::setCacheSize(1024 * 1024);
+			// Stands for a code stream, only its bytes matter to the cache
+			for (S32 i = 0; i < 500; i++)
+			{
+				mData.push_back((U8)(i * 7));
+			}
+		}
+		~j2cdecodecache_test()
+		{
+			LLImageJ2CDecodeCache::cleanupClass();
+		}
+
+		bool decode(S32 discard, LLPointer<LLImageRaw>& raw, S32 first_channel = 0, S32 max_channel_count = 4)
+		{
+			raw = new LLImageRaw();
+			return LLImageJ2CDecodeCache::decode(&mData[0], mData.size(), discard, *raw, first_channel, max_channel_count);
+		}
+	};
+	typedef test_group<j2cdecodecache_test> j2cdecodecache_t;
+	typedef j2cdecodecache_t::object j2cdecodecache_object_t;
+	tut::j2cdecodecache_t tut_j2cdecodecache("LLImageJ2CDecodeCache");
+
+	// The same discard level is served as it was decoded
+	template<> template<>
+	void j2cdecodecache_object_t::test<1>()
+	{
+		LLPointer<LLImageRaw> raw;
+		U32 misses = LLImageJ2CDecodeCache::getMisses();
+		ensure("nothing kept yet", !decode(1, raw));
+		ensure_equals("miss counted", LLImageJ2CDecodeCache::getMisses(), misses + 1);
+
+		LLPointer<LLImageRaw> decoded = make_raw(8, 6, 3);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 1, 16, 12, *decoded, 0, 4);
+		ensure_equals("bytes kept", LLImageJ2CDecodeCache::getCacheBytes(), 8 * 6 * 3);
+
+		U32 hits = LLImageJ2CDecodeCache::getHits();
+		ensure("served", decode(1, raw));
+		ensure_equals("hit counted", LLImageJ2CDecodeCache::getHits(), hits + 1);
+		ensure_equals("width", raw->getWidth(), 8);
+		ensure_equals("height", raw->getHeight(), 6);
+		ensure_equals("components", raw->getComponents(), 3);
+		ensure("same pixels", !memcmp(raw->getData(), decoded->getData(), 8 * 6 * 3));
+
+		// Still kept after serving it
+		ensure("served again", decode(1, raw));
+	}
+
+	// Coarser discard levels are box filtered, clipped at the right and
+	// bottom edges, finer ones are not served
+	template<> template<>
+	void j2cdecodecache_object_t::test<2>()
+	{
+		// 21x11 at discard 0 is 11x6 at discard 1, 3x2 at discard 3
+		LLPointer<LLImageRaw> decoded = make_raw(11, 6, 4);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 1, 21, 11, *decoded, 0, 4);
+
+		LLPointer<LLImageRaw> raw;
+		ensure("finer level not served", !decode(0, raw));
+
+		U32 reduced_hits = LLImageJ2CDecodeCache::getReducedHits();
+		ensure("coarser level served", decode(3, raw));
+		ensure_equals("reduced hit counted", LLImageJ2CDecodeCache::getReducedHits(), reduced_hits + 1);
+		ensure_equals("width", raw->getWidth(), 3);
+		ensure_equals("height", raw->getHeight(), 2);
+		for (S32 y = 0; y < 2; y++)
+		{
+			for (S32 x = 0; x < 3; x++)
+			{
+				for (S32 c = 0; c < 4; c++)
+				{
+					U32 sum = 0;
+					U32 count = 0;
+					for (S32 sy = y * 4; sy < llmin(y * 4 + 4, 6); sy++)
+					{
+						for (S32 sx = x * 4; sx < llmin(x * 4 + 4, 11); sx++)
+						{
+							sum += pattern(sx, sy, c);
+							count++;
+						}
+					}
+					ensure_equals("averaged", get_pixel(raw, x, y, c), (U8)((sum + count / 2) / count));
+				}
+			}
+		}
+	}
+
+	// Other data, other channels and more channels than were decoded are not served
+	template<> template<>
+	void j2cdecodecache_object_t::test<3>()
+	{
+		LLPointer<LLImageRaw> decoded = make_raw(4, 4, 4);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 2, 16, 16, *decoded, 0, 4);
+
+		LLPointer<LLImageRaw> raw;
+		ensure("aux channel not served", !decode(2, raw, 4, 1));
+		ensure("fewer channels served", decode(2, raw, 0, 2));
+		ensure_equals("channels", raw->getComponents(), 2);
+		ensure_equals("first channels", get_pixel(raw, 1, 2, 1), pattern(1, 2, 1));
+		// A fifth channel may exist, it wasn't decoded
+		ensure("more channels not served", !decode(2, raw, 0, 5));
+
+		mData[250]++;
+		ensure("other data not served", !decode(2, raw));
+		mData[250]--;
+		mData.push_back(0);
+		ensure("more data not served", !decode(2, raw));
+		mData.pop_back();
+
+		// Every channel was decoded when there were fewer than asked for
+		decoded = make_raw(4, 4, 3);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 2, 16, 16, *decoded, 0, 4);
+		ensure("all channels served", decode(2, raw, 0, 5));
+		ensure_equals("all channels", raw->getComponents(), 3);
+
+		// Output that doesn't match the image size is not kept
+		LLImageJ2CDecodeCache::setCacheSize(0);
+		LLImageJ2CDecodeCache::setCacheSize(1024 * 1024);
+		decoded = make_raw(5, 4, 3);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 2, 16, 16, *decoded, 0, 4);
+		ensure_equals("wrong size not kept", LLImageJ2CDecodeCache::getCacheBytes(), 0);
+	}
+
+	// Least recently used images are evicted to stay in budget, nothing is
+	// served when disabled
+	template<> template<>
+	void j2cdecodecache_object_t::test<4>()
+	{
+		const S32 IMAGE_BYTES = 32 * 32 * 4;
+		LLImageJ2CDecodeCache::setCacheSize(IMAGE_BYTES * 2);
+		std::vector<U8> other_data(mData.begin(), mData.end());
+		other_data[0]++;
+		std::vector<U8> third_data(mData.begin(), mData.end());
+		third_data[0] += 2;
+
+		LLPointer<LLImageRaw> decoded = make_raw(32, 32, 4);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 0, 32, 32, *decoded, 0, 4);
+		LLImageJ2CDecodeCache::retain(&other_data[0], other_data.size(), 0, 32, 32, *decoded, 0, 4);
+		LLPointer<LLImageRaw> raw;
+		ensure("first served", decode(0, raw)); // now the most recently used
+		LLImageJ2CDecodeCache::retain(&third_data[0], third_data.size(), 0, 32, 32, *decoded, 0, 4);
+		ensure_equals("in budget", LLImageJ2CDecodeCache::getCacheBytes(), IMAGE_BYTES * 2);
+		ensure("recently used kept", decode(0, raw));
+		raw = new LLImageRaw();
+		ensure("least recently used evicted",
+			   !LLImageJ2CDecodeCache::decode(&other_data[0], other_data.size(), 0, *raw, 0, 4));
+
+		LLImageJ2CDecodeCache::setCacheSize(0);
+		ensure_equals("all evicted", LLImageJ2CDecodeCache::getCacheBytes(), 0);
+		LLImageJ2CDecodeCache::retain(&mData[0], mData.size(), 0, 32, 32, *decoded, 0, 4);
+		ensure("disabled", !decode(0, raw));
+	}
+}
@@ -232,6 +232,37 @@ namespace tut
 		ensure("LLImageDecodeThread: threaded work unit not processed", done == true);
 	}
 
+	template<> template<>
+	void imagedecodethread_object_t::test<3>()
+	{
+		mThread = new LLImageDecodeThread(true, NULL, 4);
+		ensure("LLImageDecodeThread: multi decoder constructor failed", mThread != NULL);
+		ensure_equals("LLImageDecodeThread: decoder count incorrect", mThread->getNumDecoders(), (U32)4);
+		const S32 NUM_REQUESTS = 16;
+		bool done[NUM_REQUESTS];
+		for (S32 i = 0; i < NUM_REQUESTS; i++)
+		{
+			LLImageDecodeThread::handle_t decodeHandle = mThread->decodeImage(NULL, LLQueuedThread::PRIORITY_NORMAL + i, 0, FALSE, new responder_test(&done[i]));
+			ensure("LLImageDecodeThread: multi decoder decodeImage(), returned handle is null", decodeHandle != 0);
+		}
+		const U32 INCREMENT_TIME = 100;				// 100 milliseconds
+		const U32 MAX_TIME = 100 * INCREMENT_TIME;	// wait 10 seconds but no more
+		U32 total_time = 0;
+		S32 num_done = 0;
+		while ((num_done < NUM_REQUESTS) && (total_time < MAX_TIME))
+		{
+			mThread->update(1);
+			ms_sleep(INCREMENT_TIME);
+			total_time += INCREMENT_TIME;
+			num_done = 0;
+			for (S32 i = 0; i < NUM_REQUESTS; i++)
+			{
+				num_done += done[i] ? 1 : 0;
+			}
+		}
+		ensure_equals("LLImageDecodeThread: multi decoder work units not all processed", num_done, NUM_REQUESTS);
+	}
+
 	// ---------------------------------------------------------------------------------------
 	// Test the LLImageDecodeThread::ImageRequest interface
 	// ---------------------------------------------------------------------------------------
@@ -29,6 +29,8 @@
 #include "llmath.h"
 #include "llcamera.h"
 
+#include "llprocessor.h"
+
 // ---------------- Constructors and destructors ----------------
 
 LLCamera::LLCamera() :
@@ -320,6 +322,161 @@ S32 LLCamera::AABBInFrustumNoFarClip(const LLVector3 &center, const LLVector3& r
 	return result;
 }
 
+// ---------------- batched box tests ----------------
+
+LLCamera::aabb_batch_func_t LLCamera::sAABBBatchFunc = &LLCamera::AABBBatchReference;
+LLCamera::EBatchVariant LLCamera::sBatchVariant = LLCamera::VARIANT_REFERENCE;
+
+void LLCamera::AABBInFrustumBatch(const LLVector3* const* bounds, U32 count, S32* results, BOOL no_far_clip)
+{
+	BatchPlane planes[MAX_BATCH_PLANES];
+	U32 num_planes = getBatchPlanes(planes, no_far_clip);
+	sAABBBatchFunc(planes, num_planes, bounds, count, results);
+}
+
+U32 LLCamera::getBatchPlanes(BatchPlane* planes, BOOL no_far_clip)
+{
+	// The signs of scaler[mask] in AABBInFrustum()
+	U32 num_planes = 0;
+	for (U32 i = 0; i < mPlaneCount; i++)
+	{
+		U8 mask = mAgentPlanes[i].mask;
+		if ((no_far_clip && i == 5) || mask == 0xff)
+		{
+			continue;
+		}
+		const LLPlane& p = mAgentPlanes[i].p;
+		BatchPlane& plane = planes[num_planes++];
+		for (U32 j = 0; j < 3; j++)
+		{
+			plane.mNormal[j] = p.mV[j];
+			plane.mScale[j] = (mask & (1 << j)) ? 1.f : -1.f;
+		}
+		plane.mDist = -p.mV[3];
+	}
+	return num_planes;
+}
+
+//static
+void LLCamera::AABBBatchReference(const BatchPlane* planes, U32 num_planes,
+								  const LLVector3* const* bounds, U32 count, S32* results)
+{
+	for (U32 b = 0; b < count; b++)
+	{
+		const LLVector3& center = bounds[b][0];
+		const LLVector3& radius = bounds[b][1];
+		S32 result = 2;
+		for (U32 i = 0; i < num_planes; i++)
+		{
+			const BatchPlane& plane = planes[i];
+			LLVector3 n(plane.mNormal);
+			LLVector3 rscale = radius.scaledVec(LLVector3(plane.mScale));
+
+			if (n * (center - rscale) > plane.mDist)
+			{
+				result = 0;
+				break;
+			}
+			if (n * (center + rscale) > plane.mDist)
+			{
+				result = 1;
+			}
+		}
+		results[b] = result;
+	}
+}
+
+//static
+BOOL LLCamera::setBatchVariant(EBatchVariant variant)
+{
+	if (!isBatchVariantAvailable(variant))
+	{
+		return FALSE;
+	}
+
+	switch (variant)
+	{
+	case VARIANT_AVX2:
+		sAABBBatchFunc = &AABBBatchAVX2;
+		break;
+	case VARIANT_SSE2:
+		sAABBBatchFunc = &AABBBatchSSE2;
+		break;
+	default:
+		sAABBBatchFunc = &AABBBatchReference;
+		break;
+	}
+	sBatchVariant = variant;
+	return TRUE;
+}
+
+//static
+LLCamera::EBatchVariant LLCamera::getBestBatchVariant()
+{
+	// Unlike skinning, the tests are all arithmetic on a few loads, so the
+	// widest wins (see llfrustumcull_libtest)
+	for (S32 variant = VARIANT_COUNT - 1; variant > VARIANT_REFERENCE; variant--)
+	{
+		if (isBatchVariantAvailable((EBatchVariant)variant))
+		{
+			return (EBatchVariant)variant;
+		}
+	}
+	return VARIANT_REFERENCE;
+}
+
+//static
+BOOL LLCamera::isBatchVariantAvailable(EBatchVariant variant)
+{
+	if (!isBatchVariantBuilt(variant))
+	{
+		return FALSE;
+	}
+
+	LLProcessorInfo proc;
+	switch (variant)
+	{
+	case VARIANT_AVX2:
+		return proc.hasAVX2();
+	case VARIANT_SSE2:
+		return proc.hasSSE2();
+	default:
+		return TRUE;
+	}
+}
+
+//static
+BOOL LLCamera::isBatchVariantBuilt(EBatchVariant variant)
+{
+	switch (variant)
+	{
+	case VARIANT_AVX2:
+		return isAABBBatchAVX2Built();
+	case VARIANT_SSE2:
+		return isAABBBatchSSE2Built();
+	case VARIANT_REFERENCE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+//static
+const char* LLCamera::getBatchVariantName(EBatchVariant variant)
+{
+	switch (variant)
+	{
+	case VARIANT_AVX2:
+		return "AVX2";
+	case VARIANT_SSE2:
+		return "SSE2";
+	case VARIANT_REFERENCE:
+		return "reference";
+	default:
+		return "unknown";
+	}
+}
+
 int LLCamera::sphereInFrustumQuick(const LLVector3 &sphere_center, const F32 radius) 
 {
 	LLVector3 dist = sphere_center-mFrustCenter;
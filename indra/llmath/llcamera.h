@@ -196,6 +196,65 @@ public:
 	S32 AABBInFrustum(const LLVector3 &center, const LLVector3& radius);
 	S32 AABBInFrustumNoFarClip(const LLVector3 &center, const LLVector3& radius);
 
+	// Batched AABBInFrustum(), or AABBInFrustumNoFarClip() when
+	// no_far_clip is TRUE: results[i] is what they return for the box with
+	// center bounds[i][0] and radius bounds[i][1].
+	void AABBInFrustumBatch(const LLVector3* const* bounds, U32 count, S32* results, BOOL no_far_clip = FALSE);
+
+	// A frustum plane of the batched box tests
+	struct BatchPlane
+	{
+		F32 mNormal[3];
+		F32 mScale[3];	// center - radius * scale is the corner least along the normal
+		F32 mDist;		// -d, the box is out when that corner is farther along
+	};
+	static const U32 MAX_BATCH_PLANES = 7;
+
+	// The planes AABBInFrustum() or AABBInFrustumNoFarClip() test, for
+	// running the batched tests on many batches. Returns how many.
+	U32 getBatchPlanes(BatchPlane* planes, BOOL no_far_clip);
+
+	// Tests count boxes against num_planes planes with the current variant
+	static void AABBInPlanesBatch(const BatchPlane* planes, U32 num_planes,
+								  const LLVector3* const* bounds, U32 count, S32* results)
+	{
+		sAABBBatchFunc(planes, num_planes, bounds, count, results);
+	}
+
+	// The batched tests are a box at a time for VARIANT_REFERENCE, and 4
+	// and 8 boxes at a time, one box per vector lane, for VARIANT_SSE2 and
+	// VARIANT_AVX2. All give the same results as AABBInFrustum(). The SSE2
+	// and AVX2 ones are compiled with their instruction set options (see
+	// the CMakeLists.txt), and the build may leave them out.
+	typedef enum e_batch_variant
+	{
+		VARIANT_REFERENCE = 0,
+		VARIANT_SSE2,
+		VARIANT_AVX2,
+		VARIANT_COUNT
+	} EBatchVariant;
+
+	// Use variant from now on, if it is available. Not thread safe, set it
+	// before culling on other threads.
+	static BOOL setBatchVariant(EBatchVariant variant);
+	static EBatchVariant getBatchVariant() { return sBatchVariant; }
+	// The widest available
+	static EBatchVariant getBestBatchVariant();
+
+	// Built into this binary and supported by this CPU
+	static BOOL isBatchVariantAvailable(EBatchVariant variant);
+	// Built into this binary
+	static BOOL isBatchVariantBuilt(EBatchVariant variant);
+
+	static const char* getBatchVariantName(EBatchVariant variant);
+
+	static void AABBBatchReference(const BatchPlane* planes, U32 num_planes,
+								   const LLVector3* const* bounds, U32 count, S32* results);
+	static void AABBBatchSSE2(const BatchPlane* planes, U32 num_planes,
+							  const LLVector3* const* bounds, U32 count, S32* results);
+	static void AABBBatchAVX2(const BatchPlane* planes, U32 num_planes,
+							  const LLVector3* const* bounds, U32 count, S32* results);
+
 	//does a quick 'n dirty sphere-sphere check
 	S32 sphereInFrustumQuick(const LLVector3 &sphere_center, const F32 radius); 
 
@@ -210,6 +269,15 @@ public:
 	
 	friend std::ostream& operator<<(std::ostream &s, const LLCamera &C);
 
+private:
+	static BOOL isAABBBatchSSE2Built();
+	static BOOL isAABBBatchAVX2Built();
+
+	typedef void (*aabb_batch_func_t)(const BatchPlane* planes, U32 num_planes,
+									  const LLVector3* const* bounds, U32 count, S32* results);
+	static aabb_batch_func_t sAABBBatchFunc;
+	static EBatchVariant sBatchVariant;
+
 protected:
 	void calculateFrustumPlanes();
 	void calculateFrustumPlanes(F32 left, F32 right, F32 top, F32 bottom);
@@ -0,0 +1,137 @@
+/**
+ * @file llcamera_avx2.cpp
+ * @brief AVX2 version of the batched LLCamera box tests, eight boxes at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Linux compiler settings for this file: -mavx2 (see CMakeLists.txt)
+
+#include "linden_common.h"
+
+#include "llcamera.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && defined(__AVX2__)
+
+#include <immintrin.h>
+
+static inline __m128 load_vector3(const F32* v)
+{
+	return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)v), _mm_load_ss(v + 2));
+}
+
+// The x, y and z of vector index of 8 boxes, a register each
+static inline void load_boxes(const LLVector3* const* boxes, U32 index, __m256* xyz)
+{
+	__m128 lo[4];
+	__m128 hi[4];
+	for (U32 k = 0; k < 4; k++)
+	{
+		lo[k] = load_vector3(boxes[k][index].mV);
+		hi[k] = load_vector3(boxes[k + 4][index].mV);
+	}
+	_MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+	_MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+	for (U32 j = 0; j < 3; j++)
+	{
+		xyz[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[j]), hi[j], 1);
+	}
+}
+
+//static
+BOOL LLCamera::isAABBBatchAVX2Built()
+{
+	return TRUE;
+}
+
+//static
+void LLCamera::AABBBatchAVX2(const BatchPlane* planes, U32 num_planes,
+							 const LLVector3* const* bounds, U32 count, S32* results)
+{
+	for (U32 b = 0; b < count; b += 8)
+	{
+		// The last batch repeats its last box
+		const LLVector3* boxes[8];
+		for (U32 k = 0; k < 8; k++)
+		{
+			boxes[k] = bounds[llmin(b + k, count - 1)];
+		}
+		__m256 center[3];
+		__m256 radius[3];
+		load_boxes(boxes, 0, center);
+		load_boxes(boxes, 1, radius);
+
+		// Same operations in the same order as AABBInFrustum(), so the
+		// same results. No FMA, which would round differently.
+		__m256 out = _mm256_setzero_ps();
+		__m256 partial = _mm256_setzero_ps();
+		for (U32 i = 0; i < num_planes; i++)
+		{
+			const BatchPlane& plane = planes[i];
+			__m256 min_dot = _mm256_setzero_ps();
+			__m256 max_dot = _mm256_setzero_ps();
+			for (U32 j = 0; j < 3; j++)
+			{
+				__m256 n = _mm256_set1_ps(plane.mNormal[j]);
+				__m256 rscale = _mm256_mul_ps(radius[j], _mm256_set1_ps(plane.mScale[j]));
+				__m256 min_term = _mm256_mul_ps(n, _mm256_sub_ps(center[j], rscale));
+				__m256 max_term = _mm256_mul_ps(n, _mm256_add_ps(center[j], rscale));
+				min_dot = j ? _mm256_add_ps(min_dot, min_term) : min_term;
+				max_dot = j ? _mm256_add_ps(max_dot, max_term) : max_term;
+			}
+			__m256 dist = _mm256_set1_ps(plane.mDist);
+			out = _mm256_or_ps(out, _mm256_cmp_ps(min_dot, dist, _CMP_GT_OQ));
+			partial = _mm256_or_ps(partial, _mm256_cmp_ps(max_dot, dist, _CMP_GT_OQ));
+			if (_mm256_movemask_ps(out) == 0xff)
+			{
+				break;
+			}
+		}
+
+		S32 out_bits = _mm256_movemask_ps(out);
+		S32 partial_bits = _mm256_movemask_ps(partial);
+		U32 n = llmin(count - b, (U32)8);
+		for (U32 k = 0; k < n; k++)
+		{
+			results[b + k] = (out_bits & (1 << k)) ? 0 : (partial_bits & (1 << k)) ? 1 : 2;
+		}
+	}
+}
+
+#else
+
+//static
+BOOL LLCamera::isAABBBatchAVX2Built()
+{
+	return FALSE;
+}
+
+//static
+void LLCamera::AABBBatchAVX2(const BatchPlane* planes, U32 num_planes,
+							 const LLVector3* const* bounds, U32 count, S32* results)
+{
+	AABBBatchReference(planes, num_planes, bounds, count, results);
+}
+
+#endif
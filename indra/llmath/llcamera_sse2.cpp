@@ -0,0 +1,133 @@
+/**
+ * @file llcamera_sse2.cpp
+ * @brief SSE2 version of the batched LLCamera box tests, four boxes at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Linux compiler settings for this file: -msse2 -mfpmath=sse (see
+// CMakeLists.txt)
+
+#include "linden_common.h"
+
+#include "llcamera.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && (defined(__SSE2__) || LL_MSVC)
+
+#include <emmintrin.h>
+
+static inline __m128 load_vector3(const F32* v)
+{
+	return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)v), _mm_load_ss(v + 2));
+}
+
+// The x, y and z of vector index of 4 boxes, a register each
+static inline void load_boxes(const LLVector3* const* boxes, U32 index, __m128* xyz)
+{
+	__m128 r0 = load_vector3(boxes[0][index].mV);
+	__m128 r1 = load_vector3(boxes[1][index].mV);
+	__m128 r2 = load_vector3(boxes[2][index].mV);
+	__m128 r3 = load_vector3(boxes[3][index].mV);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	xyz[0] = r0;
+	xyz[1] = r1;
+	xyz[2] = r2;
+}
+
+//static
+BOOL LLCamera::isAABBBatchSSE2Built()
+{
+	return TRUE;
+}
+
+//static
+void LLCamera::AABBBatchSSE2(const BatchPlane* planes, U32 num_planes,
+							 const LLVector3* const* bounds, U32 count, S32* results)
+{
+	for (U32 b = 0; b < count; b += 4)
+	{
+		// The last batch repeats its last box
+		const LLVector3* boxes[4];
+		for (U32 k = 0; k < 4; k++)
+		{
+			boxes[k] = bounds[llmin(b + k, count - 1)];
+		}
+		__m128 center[3];
+		__m128 radius[3];
+		load_boxes(boxes, 0, center);
+		load_boxes(boxes, 1, radius);
+
+		// Same operations in the same order as AABBInFrustum(), so the
+		// same results
+		__m128 out = _mm_setzero_ps();
+		__m128 partial = _mm_setzero_ps();
+		for (U32 i = 0; i < num_planes; i++)
+		{
+			const BatchPlane& plane = planes[i];
+			__m128 min_dot = _mm_setzero_ps();
+			__m128 max_dot = _mm_setzero_ps();
+			for (U32 j = 0; j < 3; j++)
+			{
+				__m128 n = _mm_set1_ps(plane.mNormal[j]);
+				__m128 rscale = _mm_mul_ps(radius[j], _mm_set1_ps(plane.mScale[j]));
+				__m128 min_term = _mm_mul_ps(n, _mm_sub_ps(center[j], rscale));
+				__m128 max_term = _mm_mul_ps(n, _mm_add_ps(center[j], rscale));
+				min_dot = j ? _mm_add_ps(min_dot, min_term) : min_term;
+				max_dot = j ? _mm_add_ps(max_dot, max_term) : max_term;
+			}
+			__m128 dist = _mm_set1_ps(plane.mDist);
+			out = _mm_or_ps(out, _mm_cmpgt_ps(min_dot, dist));
+			partial = _mm_or_ps(partial, _mm_cmpgt_ps(max_dot, dist));
+			if (_mm_movemask_ps(out) == 0xf)
+			{
+				break;
+			}
+		}
+
+		S32 out_bits = _mm_movemask_ps(out);
+		S32 partial_bits = _mm_movemask_ps(partial);
+		U32 n = llmin(count - b, (U32)4);
+		for (U32 k = 0; k < n; k++)
+		{
+			results[b + k] = (out_bits & (1 << k)) ? 0 : (partial_bits & (1 << k)) ? 1 : 2;
+		}
+	}
+}
+
+#else
+
+//static
+BOOL LLCamera::isAABBBatchSSE2Built()
+{
+	return FALSE;
+}
+
+//static
+void LLCamera::AABBBatchSSE2(const BatchPlane* planes, U32 num_planes,
+							 const LLVector3* const* bounds, U32 count, S32* results)
+{
+	AABBBatchReference(planes, num_planes, bounds, count, results);
+}
+
+#endif
@@ -0,0 +1,321 @@
+/**
+ * @file llvertexcacheoptimizer.cpp
+ * @brief Reorders indexed triangle lists for the GPU vertex caches
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvertexcacheoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Forsyth's tuning
+static const F32 CACHE_DECAY_POWER = 1.5f;
+static const F32 LAST_PRIM_SCORE = 0.75f;
+static const F32 VALENCE_BOOST_SCALE = 2.f;
+static const F32 VALENCE_BOOST_POWER = 0.5f;
+static const S32 MAX_VALENCE_SCORE = 32;
+
+// Scores by cache position and by primitives left, made once
+static struct LLVertexScores
+{
+	LLVertexScores()
+	{
+		// The vertices of the last primitive, fresh of them, score the same:
+		// the order they went in doesn't matter
+		for (S32 fresh = 0; fresh < LLVertexCacheOptimizer::CACHE_SIZE; fresh++)
+		{
+			for (S32 i = 0; i < LLVertexCacheOptimizer::CACHE_SIZE; i++)
+			{
+				mCache[fresh][i] = i < fresh ? LAST_PRIM_SCORE
+					: powf(1.f - (F32)(i - fresh) / (F32)(LLVertexCacheOptimizer::CACHE_SIZE - fresh), CACHE_DECAY_POWER);
+			}
+		}
+		mValence[0] = 0.f;
+		for (S32 i = 1; i <= MAX_VALENCE_SCORE; i++)
+		{
+			mValence[i] = VALENCE_BOOST_SCALE * powf((F32)i, -VALENCE_BOOST_POWER);
+		}
+	}
+
+	F32 mCache[LLVertexCacheOptimizer::CACHE_SIZE][LLVertexCacheOptimizer::CACHE_SIZE];
+	F32 mValence[MAX_VALENCE_SCORE + 1];
+} sScores;
+
+//static
+void LLVertexCacheOptimizer::optimizeIndices(U16* indices, U32 num_indices, U32 num_vertices, U32 prim_size,
+											 std::vector<S32>* prim_remap)
+{
+	const U32 prim_indices = 3 * llmax(prim_size, 1U);
+	const S32 num_prims = num_indices / prim_indices;
+	if (num_prims < 2 || num_prims * prim_indices != num_indices || num_vertices == 0)
+	{
+		if (prim_remap)
+		{
+			prim_remap->resize(llmax(num_prims, 0));
+			for (S32 i = 0; i < num_prims; i++)
+			{
+				(*prim_remap)[i] = i;
+			}
+		}
+		return;
+	}
+
+	// The vertices of each primitive, once each
+	std::vector<U16> prim_verts(num_prims * prim_indices);
+	std::vector<U8> prim_num_verts(num_prims);
+	std::vector<S32> valence(num_vertices, 0);
+	for (S32 p = 0; p < num_prims; p++)
+	{
+		U16* verts = &prim_verts[p * prim_indices];
+		U32 count = 0;
+		for (U32 i = 0; i < prim_indices; i++)
+		{
+			U16 v = indices[p * prim_indices + i];
+			U32 j = 0;
+			while (j < count && verts[j] != v)
+			{
+				j++;
+			}
+			if (j == count)
+			{
+				verts[count++] = v;
+				valence[v]++;
+			}
+		}
+		prim_num_verts[p] = (U8)count;
+	}
+
+	// The primitives of each vertex, those not emitted yet first
+	std::vector<S32> vert_prims_start(num_vertices + 1, 0);
+	for (U32 v = 0; v < num_vertices; v++)
+	{
+		vert_prims_start[v + 1] = vert_prims_start[v] + valence[v];
+	}
+	std::vector<S32> vert_prims(vert_prims_start[num_vertices]);
+	std::vector<S32> remaining(num_vertices, 0);
+	for (S32 p = 0; p < num_prims; p++)
+	{
+		for (U32 j = 0; j < prim_num_verts[p]; j++)
+		{
+			U16 v = prim_verts[p * prim_indices + j];
+			vert_prims[vert_prims_start[v] + remaining[v]++] = p;
+		}
+	}
+
+	const S32 fresh = llmin((S32)prim_size + 2, CACHE_SIZE - 1);
+	// Local copies, the compiler can't know the score updates don't change them
+	F32 cache_score[CACHE_SIZE];
+	memcpy(cache_score, sScores.mCache[fresh], sizeof(cache_score));
+	F32 valence_score[MAX_VALENCE_SCORE + 1];
+	memcpy(valence_score, sScores.mValence, sizeof(valence_score));
+
+	std::vector<F32> vert_score(num_vertices, 0.f);
+	for (U32 v = 0; v < num_vertices; v++)
+	{
+		vert_score[v] = valence_score[llmin(remaining[v], MAX_VALENCE_SCORE)];
+	}
+	// Primitive scores are kept up to date as their vertex scores change
+	std::vector<F32> prim_score(num_prims, 0.f);
+	S32 best = 0;
+	F32 best_score = -1.f;
+	for (S32 p = 0; p < num_prims; p++)
+	{
+		F32 score = 0.f;
+		for (U32 j = 0; j < prim_num_verts[p]; j++)
+		{
+			score += vert_score[prim_verts[p * prim_indices + j]];
+		}
+		prim_score[p] = score;
+		if (score > best_score)
+		{
+			best_score = score;
+			best = p;
+		}
+	}
+
+	std::vector<U8> emitted(num_prims, 0);
+	std::vector<S32> order;
+	order.reserve(num_prims);
+	std::vector<S32> cache;
+	std::vector<S32> new_cache;
+	cache.reserve(CACHE_SIZE + prim_indices);
+	new_cache.reserve(CACHE_SIZE + prim_indices);
+	// The last primitive each vertex was in
+	std::vector<S32> vert_last_prim(num_vertices, -1);
+	S32 scan = 0;
+
+	while ((S32)order.size() < num_prims)
+	{
+		if (best < 0)
+		{
+			// Nothing in the cache is used any more, start anywhere
+			while (emitted[scan])
+			{
+				scan++;
+			}
+			best = scan;
+		}
+
+		order.push_back(best);
+		emitted[best] = 1;
+
+		// Its vertices go to the front of the cache
+		new_cache.clear();
+		const U16* verts = &prim_verts[best * prim_indices];
+		for (U32 j = 0; j < prim_num_verts[best]; j++)
+		{
+			U16 v = verts[j];
+			new_cache.push_back(v);
+			vert_last_prim[v] = best;
+
+			S32* prims = &vert_prims[vert_prims_start[v]];
+			S32 k = 0;
+			while (prims[k] != best)
+			{
+				k++;
+			}
+			prims[k] = prims[--remaining[v]];
+			prims[remaining[v]] = best;
+		}
+		for (U32 i = 0; i < cache.size(); i++)
+		{
+			if (vert_last_prim[cache[i]] != best)
+			{
+				new_cache.push_back(cache[i]);
+			}
+		}
+
+		// Rescore what moved in the cache and what fell out of it, and
+		// pick the best primitive that uses any of it
+		best = -1;
+		best_score = -1.f;
+		for (U32 i = 0; i < new_cache.size(); i++)
+		{
+			S32 v = new_cache[i];
+			F32 score = 0.f;
+			if (remaining[v])
+			{
+				score = valence_score[llmin(remaining[v], MAX_VALENCE_SCORE)];
+				if (i < (U32)CACHE_SIZE)
+				{
+					score += cache_score[i];
+				}
+			}
+			F32 delta = score - vert_score[v];
+			vert_score[v] = score;
+
+			const S32* prims = &vert_prims[vert_prims_start[v]];
+			for (S32 k = 0; k < remaining[v]; k++)
+			{
+				prim_score[prims[k]] += delta;
+			}
+		}
+		for (U32 i = 0; i < new_cache.size() && i < (U32)CACHE_SIZE; i++)
+		{
+			S32 v = new_cache[i];
+			const S32* prims = &vert_prims[vert_prims_start[v]];
+			for (S32 k = 0; k < remaining[v]; k++)
+			{
+				if (prim_score[prims[k]] > best_score)
+				{
+					best_score = prim_score[prims[k]];
+					best = prims[k];
+				}
+			}
+		}
+
+		if (new_cache.size() > (U32)CACHE_SIZE)
+		{
+			new_cache.resize(CACHE_SIZE);
+		}
+		cache.swap(new_cache);
+	}
+
+	std::vector<U16> reordered(num_indices);
+	for (S32 i = 0; i < num_prims; i++)
+	{
+		memcpy(&reordered[i * prim_indices], indices + order[i] * prim_indices, prim_indices * sizeof(U16));
+	}
+	memcpy(indices, &reordered[0], num_indices * sizeof(U16));
+
+	if (prim_remap)
+	{
+		prim_remap->resize(num_prims);
+		for (S32 i = 0; i < num_prims; i++)
+		{
+			(*prim_remap)[order[i]] = i;
+		}
+	}
+}
+
+//static
+void LLVertexCacheOptimizer::makeVertexRemap(const U16* indices, U32 num_indices, U32 num_vertices,
+											 std::vector<U16>& remap)
+{
+	std::vector<U8> used(num_vertices, 0);
+	remap.resize(num_vertices);
+	U32 next = 0;
+	for (U32 i = 0; i < num_indices; i++)
+	{
+		U16 v = indices[i];
+		if (!used[v])
+		{
+			used[v] = 1;
+			remap[v] = (U16)next++;
+		}
+	}
+	for (U32 v = 0; v < num_vertices; v++)
+	{
+		if (!used[v])
+		{
+			remap[v] = (U16)next++;
+		}
+	}
+}
+
+//static
+F32 LLVertexCacheOptimizer::getACMR(const U16* indices, U32 num_indices, S32 cache_size)
+{
+	if (num_indices < 3)
+	{
+		return 0.f;
+	}
+	// The cache holds the last cache_size vertices transformed, oldest
+	// at next
+	std::vector<S32> cache(llmax(cache_size, 1), -1);
+	U32 next = 0;
+	U32 misses = 0;
+	for (U32 i = 0; i < num_indices; i++)
+	{
+		if (std::find(cache.begin(), cache.end(), (S32)indices[i]) == cache.end())
+		{
+			cache[next] = indices[i];
+			next = (next + 1) % cache.size();
+			misses++;
+		}
+	}
+	return (F32)misses / (F32)(num_indices / 3);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file llvertexcacheoptimizer.h
+ * @brief Reorders indexed triangle lists for the GPU vertex caches
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVERTEXCACHEOPTIMIZER_H
+#define LL_LLVERTEXCACHEOPTIMIZER_H
+
+#include <vector>
+
+// Triangle lists in the order they are generated, row after row of a grid,
+// reuse few of the vertices the GPU has just transformed. optimizeIndices()
+// reorders the triangles so that they do, with Tom Forsyth's "Linear-Speed
+// Vertex Cache Optimisation": each vertex is scored by its place in a
+// simulated LRU cache and by how many triangles still use it, and the
+// triangle with the best vertices goes next. makeVertexRemap() then
+// renumbers the vertices in the order the triangles use them, so that
+// vertex fetches walk the buffer forward.
+//
+// Triangles can be kept together in primitives of several triangles, the
+// quads of LLVolumeFace sides, which keep their order and rotation.
+
+class LLVertexCacheOptimizer
+{
+public:
+	// Cache the scores are tuned for, bigger than any real post transform
+	// cache so that the order suits them all
+	static const S32 CACHE_SIZE = 32;
+
+	// Reorders the prim_size triangle primitives of indices. When prim_remap
+	// is given it gets the new place of each primitive.
+	static void optimizeIndices(U16* indices, U32 num_indices, U32 num_vertices, U32 prim_size = 1,
+								std::vector<S32>* prim_remap = NULL);
+
+	// remap gets the new number of each vertex, in the order indices first
+	// use them. Vertices no triangle uses go last.
+	static void makeVertexRemap(const U16* indices, U32 num_indices, U32 num_vertices,
+								std::vector<U16>& remap);
+
+	// Average cache miss ratio: vertices transformed per triangle with a
+	// FIFO post transform cache of cache_size vertices. 0.5 is the best a
+	// regular grid can do, 3 is no reuse at all.
+	static F32 getACMR(const U16* indices, U32 num_indices, S32 cache_size = 16);
+};
+
+#endif // LL_LLVERTEXCACHEOPTIMIZER_H
@@ -40,6 +40,8 @@
 #include "lldarray.h"
 #include "llvolume.h"
 #include "llstl.h"
+#include "llvertexcacheoptimizer.h"
+#include "llapr.h"
 
 #define DEBUG_SILHOUETTE_BINORMALS 0
 #define DEBUG_SILHOUETTE_NORMALS 0 // TomY: Use this to display normals using the silhouette
@@ -1658,14 +1660,18 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+// Volumes are built on worker threads too
+static LLAtomicS32 sNumMeshPoints;
+BOOL LLVolume::sOptimizeCacheOrder = FALSE;
 
-LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
+LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique,
+				   const BOOL build_faces)
 	: mParams(params)
 {
 	LLMemType m1(LLMemType::MTYPE_VOLUME);
 	
 	mUnique = is_unique;
+	mBuildPending = FALSE;
 	mFaceMask = 0x0;
 	mDetail = detail;
 	mSculptLevel = -2;
@@ -1684,12 +1690,55 @@ LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL ge
 	mGenerateSingleFace = generate_single_face;
 
 	generate();
-	if (mParams.getSculptID().isNull() && params.getSculptType() == LL_SCULPT_TYPE_NONE)
+	if (build_faces && !mParams.isSculpt())
 	{
 		createVolumeFaces();
 	}
 }
 
+void LLVolume::swapGeometry(LLVolume* volume)
+{
+	llassert(volume->mParams == mParams);
+	std::swap(mPathp, volume->mPathp);
+	std::swap(mProfilep, volume->mProfilep);
+	mMesh.swap(volume->mMesh);
+	mVolumeFaces.swap(volume->mVolumeFaces);
+	std::swap(mFaceMask, volume->mFaceMask);
+	std::swap(mLODScaleBias, volume->mLODScaleBias);
+	std::swap(mSculptLevel, volume->mSculptLevel);
+}
+
+BOOL LLVolume::copyVolumeFaces(const LLVolume* volume)
+{
+	if (volume->mFaceMask != mFaceMask || volume->getNumVolumeFaces() != getNumFaces())
+	{
+		return FALSE;
+	}
+	mVolumeFaces = volume->mVolumeFaces;
+	return TRUE;
+}
+
+S32 LLVolume::getGeometryBytes() const
+{
+	S32 bytes = sizeof(LLVolume) + sizeof(LLPath) + sizeof(LLProfile);
+	bytes += mPathp->mPath.capacity() * sizeof(LLPath::PathPt);
+	bytes += mProfilep->mProfile.capacity() * sizeof(LLVector3);
+	bytes += mProfilep->mNormals.capacity() * sizeof(LLVector2);
+	bytes += mProfilep->mFaces.capacity() * sizeof(LLProfile::Face);
+	bytes += mProfilep->mEdgeNormals.capacity() * sizeof(LLVector3);
+	bytes += mMesh.capacity() * sizeof(Point);
+	for (S32 i = 0; i < (S32)mVolumeFaces.size(); i++)
+	{
+		const LLVolumeFace& face = mVolumeFaces[i];
+		bytes += sizeof(LLVolumeFace);
+		bytes += face.mVertices.capacity() * sizeof(LLVolumeFace::VertexData);
+		bytes += face.mIndices.capacity() * sizeof(U16);
+		bytes += face.mTriStrip.capacity() * sizeof(U16);
+		bytes += face.mEdge.capacity() * sizeof(S32);
+	}
+	return bytes;
+}
+
 void LLVolume::resizePath(S32 length)
 {
 	mPathp->resizePath(length);
@@ -1848,6 +1897,15 @@ void LLVolume::createVolumeFaces()
 	{
 		S32 num_faces = getNumFaces();
 		BOOL partial_build = TRUE;
+		for (S32 i = 0; i < (S32)mVolumeFaces.size(); i++)
+		{
+			if (mVolumeFaces[i].mCacheOrderOptimized)
+			{
+				// Can't be updated in place
+				mVolumeFaces.clear();
+				break;
+			}
+		}
 		if (num_faces != mVolumeFaces.size())
 		{
 			partial_build = FALSE;
@@ -1926,6 +1984,15 @@ void LLVolume::createVolumeFaces()
 		{
 			(*iter).create(this, partial_build);
 		}
+
+		if (sOptimizeCacheOrder && !mUnique)
+		{
+			for (face_list_t::iterator iter = mVolumeFaces.begin();
+				 iter != mVolumeFaces.end(); ++iter)
+			{
+				(*iter).optimizeCacheOrder();
+			}
+		}
 	}
 }
 
@@ -5091,6 +5158,62 @@ void LLVolumeFace::createBinormals()
 	}
 }
 
+void LLVolumeFace::optimizeCacheOrder()
+{
+	if (mIndices.size() < 6 || mVertices.empty())
+	{
+		return;
+	}
+
+	U32 prim_size = (mTypeMask & CAP_MASK) ? 1 : 2;
+	if (mIndices.size() % (prim_size * 3))
+	{
+		prim_size = 1;
+	}
+	std::vector<S32> prim_remap;
+	LLVertexCacheOptimizer::optimizeIndices(&mIndices[0], mIndices.size(), mVertices.size(), prim_size, &prim_remap);
+
+	// The neighbours in mEdge are triangle numbers
+	const S32 num_tris = mIndices.size() / 3;
+	if (mEdge.size() == mIndices.size())
+	{
+		std::vector<S32> edge(mEdge.size());
+		for (S32 t = 0; t < num_tris; t++)
+		{
+			S32 new_t = prim_remap[t / prim_size] * prim_size + t % prim_size;
+			for (S32 k = 0; k < 3; k++)
+			{
+				S32 n = mEdge[t * 3 + k];
+				if (n >= 0 && n < num_tris)
+				{
+					n = prim_remap[n / prim_size] * prim_size + n % prim_size;
+				}
+				edge[new_t * 3 + k] = n;
+			}
+		}
+		mEdge.swap(edge);
+	}
+
+	std::vector<U16> remap;
+	LLVertexCacheOptimizer::makeVertexRemap(&mIndices[0], mIndices.size(), mVertices.size(), remap);
+	std::vector<VertexData> vertices(mVertices.size());
+	for (U32 i = 0; i < mVertices.size(); i++)
+	{
+		vertices[remap[i]] = mVertices[i];
+	}
+	mVertices.swap(vertices);
+	for (U32 i = 0; i < mIndices.size(); i++)
+	{
+		mIndices[i] = remap[mIndices[i]];
+	}
+	for (U32 i = 0; i < mTriStrip.size(); i++)
+	{
+		mTriStrip[i] = remap[mTriStrip[i]];
+	}
+
+	mCacheOrderOptimized = TRUE;
+}
+
 BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 {
 	LLMemType m1(LLMemType::MTYPE_VOLUME);
@@ -628,6 +628,8 @@ public:
 	const F32&  getSkew() const			{ return mPathParams.getSkew();			}
 	const LLUUID& getSculptID() const	{ return mSculptID;						}
 	const U8& getSculptType() const     { return mSculptType;                   }
+	// Sculpted volumes get their faces from LLVolume::sculpt()
+	BOOL isSculpt() const				{ return mSculptID.notNull() || mSculptType != LL_SCULPT_TYPE_NONE; }
 
 	BOOL isConvex() const;
 
@@ -786,13 +788,18 @@ public:
 		mBeginS(0),
 		mBeginT(0),
 		mNumS(0),
-		mNumT(0)
+		mNumT(0),
+		mCacheOrderOptimized(FALSE)
 	{
 	}
 
 	BOOL create(LLVolume* volume, BOOL partial_build = FALSE);
 	void createBinormals();
 	void makeTriStrip();
+	// Reorders the triangles and then the vertices for the GPU vertex
+	// caches, see LLVertexCacheOptimizer. The quads of sides stay whole, so
+	// createBinormals() still sees their two triangles in turn.
+	void optimizeCacheOrder();
 	
 	class VertexData
 	{
@@ -837,6 +844,9 @@ public:
 	std::vector<U16>	mTriStrip;
 	std::vector<S32>	mEdge;
 
+	// Vertices are no longer in the grid order partial builds write to
+	BOOL mCacheOrderOptimized;
+
 private:
 	BOOL createUnCutCubeCap(LLVolume* volume, BOOL partial_build = FALSE);
 	BOOL createCap(LLVolume* volume, BOOL partial_build = FALSE);
@@ -846,6 +856,7 @@ private:
 class LLVolume : public LLRefCount
 {
 	friend class LLVolumeLODGroup;
+	friend class LLVolumeMgr;
 
 private:
 	LLVolume(const LLVolume&);  // Don't implement
@@ -866,7 +877,9 @@ public:
 		S32 mCountT;
 	};
 
-	LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face = FALSE, const BOOL is_unique = FALSE);
+	// build_faces FALSE leaves the volume faces to the caller
+	LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face = FALSE, const BOOL is_unique = FALSE,
+			 const BOOL build_faces = TRUE);
 	
 	U8 getProfileType()	const								{ return mParams.getProfileParams().getCurveType(); }
 	U8 getPathType() const									{ return mParams.getPathParams().getCurveType(); }
@@ -891,6 +904,14 @@ public:
 	BOOL isFlat(S32 face);
 	BOOL isUnique() const									{ return mUnique; }
 
+	// A shared volume LLVolumeMgr is building on a worker thread. It has
+	// its profile and path, but its volume faces are missing or a copy of
+	// another LOD's until LLVolumeMgr::updateBuilds() swaps the built ones in.
+	BOOL isBuildPending() const								{ return mBuildPending; }
+
+	// Bytes the generated geometry takes: path, profile, mesh and volume faces
+	S32 getGeometryBytes() const;
+
 	S32 getSculptLevel() const                              { return mSculptLevel; }
 	
 	S32 *getTriangleIndices(U32 &num_indices) const;
@@ -931,7 +952,9 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	// Shared volumes optimize the cache order of their faces once built.
+	// Unique ones don't, flexible objects rebuild theirs every frame.
+	static BOOL sOptimizeCacheOrder;
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
@@ -953,8 +976,16 @@ protected:
 	BOOL generate();
 	void createVolumeFaces();
 
+	// Takes the path, profile, mesh and faces of volume, built from the
+	// same params, and gives it this volume's
+	void swapGeometry(LLVolume* volume);
+	// Copies in the faces of another LOD of the same params, as
+	// placeholders. Returns FALSE when its faces don't match this profile.
+	BOOL copyVolumeFaces(const LLVolume* volume);
+
  protected:
 	BOOL mUnique;
+	BOOL mBuildPending;
 	F32 mDetail;
 	S32 mSculptLevel;
 	
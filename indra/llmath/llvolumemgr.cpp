@@ -28,6 +28,7 @@
 #include "llvolumemgr.h"
 #include "llmemtype.h"
 #include "llvolume.h"
+#include "llthreadpool.h"
 
 
 const F32 BASE_THRESHOLD = 0.03f;
@@ -42,10 +43,157 @@ F32 LLVolumeLODGroup::mDetailThresholds[NUM_LODS] = {BASE_THRESHOLD,
 F32 LLVolumeLODGroup::mDetailScales[NUM_LODS] = {1.f, 1.5f, 2.5f, 4.f};
 
 
+//============================================================================
+
+// Builds a volume's geometry into a volume of its own, which only the
+// thread running the job touches until it is done
+class LLVolumeMgr::BuildJob : public LLThreadSafeRefCount
+{
+public:
+	BuildJob(LLVolume* target)
+	:	mTarget(target),
+		mParams(target->getParams()),
+		mDetail(target->getDetail()),
+		mIsSculpt(FALSE),
+		mSculptWidth(0),
+		mSculptHeight(0),
+		mSculptComponents(0),
+		mSculptLevel(0)
+	{
+		apr_atomic_set32(&mState, PENDING);
+	}
+
+	void setSculpt(U16 sculpt_width, U16 sculpt_height, S8 sculpt_components,
+				   const U8* sculpt_data, S32 sculpt_level)
+	{
+		mIsSculpt = TRUE;
+		mSculptWidth = sculpt_width;
+		mSculptHeight = sculpt_height;
+		mSculptComponents = sculpt_components;
+		mSculptLevel = sculpt_level;
+		if (sculpt_data && sculpt_width && sculpt_height && sculpt_components > 0)
+		{
+			mSculptData.assign(sculpt_data, sculpt_data + (size_t)sculpt_width * sculpt_height * sculpt_components);
+		}
+	}
+
+	bool isSameSculpt(U16 sculpt_width, U16 sculpt_height, S8 sculpt_components, S32 sculpt_level) const
+	{
+		return mIsSculpt && mSculptWidth == sculpt_width && mSculptHeight == sculpt_height
+			&& mSculptComponents == sculpt_components && mSculptLevel == sculpt_level;
+	}
+
+	// Any thread. Returns false when another thread has the job.
+	bool run();
+
+	bool isDone() { return apr_atomic_read32(&mState) == DONE; }
+
+	// Main thread. Runs the job unless a worker has it, then waits for it.
+	void finish();
+
+	// Main thread. Makes sure the job is not running and never will.
+	void cancel();
+
+	// Main thread, once done. Drops the volumes so that they are never
+	// released on a worker.
+	void release()
+	{
+		mTarget = NULL;
+		mVolume = NULL;
+	}
+
+	LLPointer<LLVolume> mTarget;	// main thread only
+	LLPointer<LLVolume> mVolume;	// built by run()
+
+protected:
+	/*virtual*/ ~BuildJob() {}
+
+private:
+	enum EState
+	{
+		PENDING = 0,
+		RUNNING = 1,
+		DONE = 2
+	};
+
+	volatile apr_uint32_t mState;
+	const LLVolumeParams mParams;
+	const F32 mDetail;
+	BOOL mIsSculpt;
+	U16 mSculptWidth;
+	U16 mSculptHeight;
+	S8 mSculptComponents;
+	S32 mSculptLevel;
+	std::vector<U8> mSculptData;
+};
+
+class LLVolumeMgr::BuildTask : public LLThreadPool::Task
+{
+public:
+	BuildTask(BuildJob* job) : mJob(job) {}
+	/*virtual*/ void executeTask()
+	{
+		mJob->run();
+		// The pool does not own its tasks
+		delete this;
+	}
+private:
+	LLPointer<BuildJob> mJob;
+};
+
+bool LLVolumeMgr::BuildJob::run()
+{
+	if (apr_atomic_cas32(&mState, RUNNING, PENDING) != PENDING)
+	{
+		return false;
+	}
+
+	LLVolume* volume = new LLVolume(mParams, mDetail);
+	if (mIsSculpt)
+	{
+		volume->sculpt(mSculptWidth, mSculptHeight, mSculptComponents,
+					   mSculptData.empty() ? NULL : &mSculptData[0], mSculptLevel);
+	}
+	mVolume = volume;
+
+	// Full barrier, publishes the volume
+	apr_atomic_set32(&mState, DONE);
+	return true;
+}
+
+void LLVolumeMgr::BuildJob::finish()
+{
+	if (!run())
+	{
+		while (!isDone())
+		{
+			LLThread::yield();
+		}
+	}
+}
+
+void LLVolumeMgr::BuildJob::cancel()
+{
+	if (apr_atomic_cas32(&mState, DONE, PENDING) != PENDING)
+	{
+		while (!isDone())
+		{
+			LLThread::yield();
+		}
+	}
+}
+
 //============================================================================
 
 LLVolumeMgr::LLVolumeMgr()
-:	mDataMutex(NULL)
+:	mDataMutex(NULL),
+	mThreadPool(NULL),
+	mBuildThreadID(LLThread::currentID()),
+	mCacheBudget(0),
+	mCacheBytes(0),
+	mCacheHits(0),
+	mCacheMisses(0),
+	mCacheEvictions(0)
 {
 	// the LLMutex magic interferes with easy unit testing,
 	// so you now must manually call useMutex() to use it
@@ -62,11 +210,16 @@ LLVolumeMgr::~LLVolumeMgr()
 
 BOOL LLVolumeMgr::cleanup()
 {
+	cancelBuilds();
+
 	BOOL no_refs = TRUE;
 	if (mDataMutex)
 	{
 		mDataMutex->lock();
 	}
+	mCache.clear();
+	mCacheIndex.clear();
+	mCacheBytes = 0;
 	for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin(),
 			 end = mVolumeLODGroups.end();
 		 iter != end; iter++)
@@ -106,11 +259,35 @@ LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32
 	{
 		volgroupp = iter->second;
 	}
+	LLVolume* existingp = volgroupp->getLOD(detail);
+	if (existingp)
+	{
+		mCacheHits++;
+		if (volgroupp->getNumLODRefs(detail) == 0)
+		{
+			// back from the cache
+			uncacheVolume(existingp);
+		}
+	}
+	else
+	{
+		mCacheMisses++;
+	}
 	if (mDataMutex)
 	{
 		mDataMutex->unlock();
 	}
-	return volgroupp->refLOD(detail);
+	LLVolume* volumep = volgroupp->refLOD(detail, mThreadPool == NULL);
+	if (volumep->isBuildPending())
+	{
+		llassert(isBuildThread());
+		if (mBuildJobs.find(volumep) == mBuildJobs.end())
+		{
+			// new, build its faces
+			startBuild(new BuildJob(volumep));
+		}
+	}
+	return volumep;
 }
 
 // virtual
@@ -159,12 +336,25 @@ void LLVolumeMgr::unrefVolume(LLVolume *volumep)
 	{
 		LLVolumeLODGroup* volgroupp = iter->second;
 
-		volgroupp->derefLOD(volumep);
-		if (volgroupp->getNumRefs() == 0)
+		volgroupp->derefLOD(volumep, mCacheBudget > 0);
+		if (volgroupp->getNumRefs() == 0 && !volgroupp->hasLODs())
 		{
 			mVolumeLODGroups.erase(params);
 			delete volgroupp;
 		}
+		else
+		{
+			for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+			{
+				if (volgroupp->getLOD(i) == volumep && volgroupp->getNumLODRefs(i) == 0)
+				{
+					cacheVolume(volgroupp, i);
+					// may delete volgroupp
+					evictVolumes(mCacheBudget);
+					break;
+				}
+			}
+		}
 	}
 	if (mDataMutex)
 	{
@@ -210,6 +400,8 @@ void LLVolumeMgr::dump()
 		mDataMutex->unlock();
 	}
 	llinfos << "Average usage of LODs " << avg << llendl;
+	llinfos << "Volume cache " << mCache.size() << " volumes, " << mCacheBytes << " of " << mCacheBudget
+			<< " bytes, hits " << mCacheHits << " misses " << mCacheMisses << " evictions " << mCacheEvictions << llendl;
 }
 
 void LLVolumeMgr::useMutex()
@@ -220,6 +412,187 @@ void LLVolumeMgr::useMutex()
 	}
 }
 
+void LLVolumeMgr::setThreadPool(LLThreadPool* pool)
+{
+	if (!pool)
+	{
+		finishBuilds();
+	}
+	mThreadPool = pool;
+}
+
+void LLVolumeMgr::sculpt(LLVolume* volume, U16 sculpt_width, U16 sculpt_height, S8 sculpt_components,
+						 const U8* sculpt_data, S32 sculpt_level)
+{
+	llassert(isBuildThread());
+	build_job_map_t::iterator iter = mBuildJobs.find(volume);
+	if (iter != mBuildJobs.end())
+	{
+		if (iter->second->isSameSculpt(sculpt_width, sculpt_height, sculpt_components, sculpt_level))
+		{
+			// already on its way
+			return;
+		}
+		// superseded
+		iter->second->cancel();
+		iter->second->release();
+		mBuildJobs.erase(iter);
+		volume->mBuildPending = FALSE;
+	}
+
+	if (!mThreadPool || volume->isUnique())
+	{
+		volume->sculpt(sculpt_width, sculpt_height, sculpt_components, sculpt_data, sculpt_level);
+		return;
+	}
+
+	BuildJob* job = new BuildJob(volume);
+	job->setSculpt(sculpt_width, sculpt_height, sculpt_components, sculpt_data, sculpt_level);
+	startBuild(job);
+}
+
+void LLVolumeMgr::startBuild(BuildJob* job)
+{
+	llassert(isBuildThread());
+	LLVolume* volume = job->mTarget;
+	volume->mBuildPending = TRUE;
+	mBuildJobs[volume] = job;
+	if (mThreadPool)
+	{
+		mThreadPool->post(new BuildTask(job), LLThreadPool::CLASS_NORMAL);
+	}
+}
+
+S32 LLVolumeMgr::updateBuilds()
+{
+	llassert(isBuildThread());
+	S32 count = 0;
+	// Swapping geometry changes the size of cached volumes
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	build_job_map_t::iterator iter = mBuildJobs.begin();
+	while (iter != mBuildJobs.end())
+	{
+		BuildJob* job = iter->second;
+		if (!job->isDone())
+		{
+			++iter;
+			continue;
+		}
+
+		LLVolume* volume = job->mTarget;
+		// Not worth swapping in when only the job holds the volume
+		if (volume->getNumRefs() > 1 && job->mVolume.notNull())
+		{
+			volume->swapGeometry(job->mVolume);
+			count++;
+
+			// Went unused while it was built
+			cache_index_t::iterator cached = mCacheIndex.find(volume);
+			if (cached != mCacheIndex.end())
+			{
+				S32 bytes = volume->getGeometryBytes();
+				mCacheBytes += bytes - cached->second->mBytes;
+				cached->second->mBytes = bytes;
+			}
+		}
+		volume->mBuildPending = FALSE;
+		// The built volume now has the old geometry
+		job->release();
+		mBuildJobs.erase(iter++);
+	}
+
+	if (count && mCacheBytes > mCacheBudget)
+	{
+		evictVolumes(mCacheBudget);
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+	return count;
+}
+
+S32 LLVolumeMgr::finishBuilds()
+{
+	for (build_job_map_t::iterator iter = mBuildJobs.begin(); iter != mBuildJobs.end(); ++iter)
+	{
+		iter->second->finish();
+	}
+	return updateBuilds();
+}
+
+void LLVolumeMgr::cancelBuilds()
+{
+	llassert(isBuildThread() || mBuildJobs.empty());
+	for (build_job_map_t::iterator iter = mBuildJobs.begin(); iter != mBuildJobs.end(); ++iter)
+	{
+		BuildJob* job = iter->second;
+		job->cancel();
+		job->mTarget->mBuildPending = FALSE;
+		job->release();
+	}
+	mBuildJobs.clear();
+}
+
+void LLVolumeMgr::setCacheBudget(S32 bytes)
+{
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	mCacheBudget = llmax(bytes, 0);
+	evictVolumes(mCacheBudget);
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+}
+
+void LLVolumeMgr::cacheVolume(LLVolumeLODGroup* volgroupp, S32 detail)
+{
+	LLVolume* volumep = volgroupp->getLOD(detail);
+	CacheEntry entry;
+	entry.mGroup = volgroupp;
+	entry.mDetail = detail;
+	entry.mBytes = volumep->getGeometryBytes();
+	mCacheIndex[volumep] = mCache.insert(mCache.end(), entry);
+	mCacheBytes += entry.mBytes;
+}
+
+void LLVolumeMgr::uncacheVolume(LLVolume* volumep)
+{
+	cache_index_t::iterator iter = mCacheIndex.find(volumep);
+	if (iter != mCacheIndex.end())
+	{
+		mCacheBytes -= iter->second->mBytes;
+		mCache.erase(iter->second);
+		mCacheIndex.erase(iter);
+	}
+}
+
+void LLVolumeMgr::evictVolumes(S32 budget)
+{
+	while (mCacheBytes > budget && !mCache.empty())
+	{
+		CacheEntry entry = mCache.front();
+		mCache.pop_front();
+		mCacheIndex.erase(entry.mGroup->getLOD(entry.mDetail));
+		mCacheBytes -= entry.mBytes;
+		mCacheEvictions++;
+
+		LLVolumeLODGroup* volgroupp = entry.mGroup;
+		volgroupp->dropLOD(entry.mDetail);
+		if (volgroupp->getNumRefs() == 0 && !volgroupp->hasLODs())
+		{
+			mVolumeLODGroups.erase(volgroupp->getVolumeParams());
+			delete volgroupp;
+		}
+	}
+}
+
 std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr)
 {
 	s << "{ numLODgroups=" << volume_mgr.mVolumeLODGroups.size() << ", ";
@@ -289,7 +662,7 @@ bool LLVolumeLODGroup::cleanupRefs()
 	return res;
 }
 
-LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
+LLVolume* LLVolumeLODGroup::refLOD(const S32 detail, BOOL build_faces)
 {
 	llassert(detail >=0 && detail < NUM_LODS);
 	mAccessCount[detail]++;
@@ -298,13 +671,35 @@ LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
 	if (mVolumeLODs[detail].isNull())
 	{
 		LLMemType m1(LLMemType::MTYPE_VOLUME);
-		mVolumeLODs[detail] = new LLVolume(mVolumeParams, mDetailScales[detail]);
+		LLVolume* volumep = new LLVolume(mVolumeParams, mDetailScales[detail], FALSE, FALSE, build_faces);
+		mVolumeLODs[detail] = volumep;
+		if (!build_faces && !mVolumeParams.isSculpt())
+		{
+			volumep->mBuildPending = TRUE;
+			// Until it is built, show the nearest LOD that is
+			for (S32 i = 1; i < NUM_LODS; i++)
+			{
+				LLVolume* otherp = NULL;
+				if (detail - i >= 0 && mVolumeLODs[detail - i].notNull() && !mVolumeLODs[detail - i]->isBuildPending())
+				{
+					otherp = mVolumeLODs[detail - i];
+				}
+				else if (detail + i < NUM_LODS && mVolumeLODs[detail + i].notNull() && !mVolumeLODs[detail + i]->isBuildPending())
+				{
+					otherp = mVolumeLODs[detail + i];
+				}
+				if (otherp && volumep->copyVolumeFaces(otherp))
+				{
+					break;
+				}
+			}
+		}
 	}
 	mLODRefs[detail]++;
 	return mVolumeLODs[detail];
 }
 
-BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
+BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep, BOOL keep_unused)
 {
 	llassert_always(mRefs > 0);
 	mRefs--;
@@ -314,12 +709,10 @@ BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 		{
 			llassert_always(mLODRefs[i] > 0);
 			mLODRefs[i]--;
-#if 1 // SJB: Possible opt: keep other lods around
-			if (!mLODRefs[i])
+			if (!mLODRefs[i] && !keep_unused)
 			{
 				mVolumeLODs[i] = NULL;
 			}
-#endif
 			return TRUE;
 		}
 	}
@@ -327,6 +720,24 @@ BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 	return FALSE;
 }
 
+void LLVolumeLODGroup::dropLOD(const S32 detail)
+{
+	llassert_always(mLODRefs[detail] == 0);
+	mVolumeLODs[detail] = NULL;
+}
+
+BOOL LLVolumeLODGroup::hasLODs() const
+{
+	for (S32 i = 0; i < NUM_LODS; i++)
+	{
+		if (mVolumeLODs[i].notNull())
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 S32 LLVolumeLODGroup::getDetailFromTan(const F32 tan_angle)
 {
 	S32 i = 0;
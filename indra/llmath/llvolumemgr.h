@@ -27,6 +27,7 @@
 #ifndef LL_LLVOLUMEMGR_H
 #define LL_LLVOLUMEMGR_H
 
+#include <list>
 #include <map>
 
 #include "llvolume.h"
@@ -35,6 +36,7 @@
 
 class LLVolumeParams;
 class LLVolumeLODGroup;
+class LLThreadPool;
 
 class LLVolumeLODGroup
 {
@@ -54,9 +56,16 @@ public:
 	static void getDetailProximity(const F32 tan_angle, F32 &to_lower, F32& to_higher);
 	static F32 getVolumeScaleFromDetail(const S32 detail);
 
-	LLVolume* refLOD(const S32 detail);
-	BOOL derefLOD(LLVolume *volumep);
+	// build_faces FALSE hands out new volumes before their faces are built,
+	// see LLVolume::isBuildPending()
+	LLVolume* refLOD(const S32 detail, BOOL build_faces = TRUE);
+	// keep_unused keeps a volume nothing refers to any more, until dropLOD()
+	BOOL derefLOD(LLVolume *volumep, BOOL keep_unused = FALSE);
+	void dropLOD(const S32 detail);
 	S32 getNumRefs() const { return mRefs; }
+	S32 getNumLODRefs(const S32 detail) const { return mLODRefs[detail]; }
+	LLVolume* getLOD(const S32 detail) const { return mVolumeLODs[detail]; }
+	BOOL hasLODs() const;
 	
 	const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
 
@@ -94,6 +103,46 @@ public:
 	// manually call this for mutex magic
 	void useMutex();
 
+	// Background builds. With a thread pool, refVolume() hands out new
+	// shared volumes right away and builds their faces on a worker, and
+	// sculpt() does the same for sculpted ones. The built geometry is
+	// swapped in by updateBuilds(), until then LLVolume::isBuildPending().
+	// Builds are started and swapped in on one thread, the main thread
+	// (the one that constructed the manager): mBuildJobs is not guarded by
+	// mDataMutex.
+	//
+	// NULL builds everything right away, after finishing the builds in
+	// progress.
+	void setThreadPool(LLThreadPool* pool);
+	LLThreadPool* getThreadPool() const { return mThreadPool; }
+
+	// LLVolume::sculpt(), on a worker for shared volumes. The sculpt data
+	// is copied.
+	void sculpt(LLVolume* volume, U16 sculpt_width, U16 sculpt_height, S8 sculpt_components,
+				const U8* sculpt_data, S32 sculpt_level);
+
+	// Swaps the geometry of the finished builds into their volumes.
+	// Returns how many volumes changed.
+	S32 updateBuilds();
+	// Waits for all the builds, running those no worker has started here,
+	// and swaps them in
+	S32 finishBuilds();
+	S32 getNumPendingBuilds() const { return mBuildJobs.size(); }
+
+	// Volume cache. Shared volumes nothing refers to any more are kept, up
+	// to budget bytes of geometry, and handed out again by refVolume()
+	// instead of being generated anew. The least recently used go first.
+	// A budget of 0 keeps none.
+	void setCacheBudget(S32 bytes);
+	S32 getCacheBudget() const { return mCacheBudget; }
+	S32 getCacheBytes() const { return mCacheBytes; }
+	S32 getNumCachedVolumes() const { return mCache.size(); }
+	// Running totals. A hit is a refVolume() served by a volume that was
+	// already there, in use or cached, a miss one that made a new volume.
+	U32 getCacheHits() const { return mCacheHits; }
+	U32 getCacheMisses() const { return mCacheMisses; }
+	U32 getCacheEvictions() const { return mCacheEvictions; }
+
 	friend std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr);
 
 protected:
@@ -101,11 +150,46 @@ protected:
 	// Overridden in llphysics/abstract/utils/llphysicsvolumemanager.h
 	virtual LLVolumeLODGroup* createNewGroup(const LLVolumeParams& volume_params);
 
+	class BuildJob;
+	class BuildTask;
+	// Marks volume pending and posts the job building it
+	void startBuild(BuildJob* job);
+	// Drops all the builds, their volumes keep what they have
+	void cancelBuilds();
+	bool isBuildThread() const { return LLThread::currentID() == mBuildThreadID; }
+
+	// Caller holds mDataMutex
+	void cacheVolume(LLVolumeLODGroup* volgroupp, S32 detail);
+	void uncacheVolume(LLVolume* volumep);
+	void evictVolumes(S32 budget);
+
 protected:
 	typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
 	volume_lod_group_map_t mVolumeLODGroups;
 
 	LLMutex* mDataMutex;
+
+	LLThreadPool* mThreadPool;
+	// by the volume being built, at most one build each
+	typedef std::map<LLVolume*, LLPointer<BuildJob> > build_job_map_t;
+	build_job_map_t mBuildJobs;
+	U32 mBuildThreadID;
+
+	struct CacheEntry
+	{
+		LLVolumeLODGroup* mGroup;
+		S32 mDetail;
+		S32 mBytes;
+	};
+	typedef std::list<CacheEntry> cache_list_t;
+	cache_list_t mCache;	// least recently used first
+	typedef std::map<LLVolume*, cache_list_t::iterator> cache_index_t;
+	cache_index_t mCacheIndex;
+	S32 mCacheBudget;
+	S32 mCacheBytes;
+	U32 mCacheHits;
+	U32 mCacheMisses;
+	U32 mCacheEvictions;
 };
 
 #endif // LL_LLVOLUMEMGR_H
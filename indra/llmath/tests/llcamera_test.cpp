@@ -0,0 +1,202 @@
+/**
+ * @file llcamera_test.cpp
+ * @brief Tests of the batched LLCamera box tests against the scalar ones
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llcamera.h"
+#include "../llquaternion.h"
+#include "../v3math.h"
+
+#include "../test/lltestrand.h"
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace tut
+{
+	struct camera_data
+	{
+		~camera_data()
+		{
+			LLCamera::setBatchVariant(LLCamera::VARIANT_REFERENCE);
+		}
+
+		LLVector3 randomVector(F32 range)
+		{
+			F32 x = mRand.frand(-range, range);
+			F32 y = mRand.frand(-range, range);
+			F32 z = mRand.frand(-range, range);
+			return LLVector3(x, y, z);
+		}
+
+		// Points the camera somewhere and gives it agent planes the way
+		// LLViewerCamera does, from the corners of its frustum
+		void aimCamera(LLCamera& camera)
+		{
+			camera.setOrigin(randomVector(100.f));
+			camera.setAxes(LLQuaternion(mRand.frand(-F_PI, F_PI), randomVector(1.f)));
+
+			const F32 near_dist = 0.5f;
+			const F32 far_dist = mRand.frand(10.f, 90.f);
+			const F32 tan_x = mRand.frand(0.5f, 1.1f);
+			const F32 tan_y = mRand.frand(0.3f, 0.9f);
+			// left bottom, right bottom, right top, left top, near then far
+			const F32 x[] = { -1.f, 1.f, 1.f, -1.f };
+			const F32 y[] = { -1.f, -1.f, 1.f, 1.f };
+			LLVector3 corners[8];
+			for (U32 i = 0; i < 8; i++)
+			{
+				F32 dist = i < 4 ? near_dist : far_dist;
+				corners[i] = camera.getOrigin()
+					+ camera.getAtAxis() * dist
+					- camera.getLeftAxis() * (x[i % 4] * tan_x * dist)
+					+ camera.getUpAxis() * (y[i % 4] * tan_y * dist);
+			}
+			camera.calcAgentFrustumPlanes(corners);
+		}
+
+		// Boxes of all sizes, in, out and across the frustum
+		void makeBoxes(const LLCamera& camera, U32 count, std::vector<LLVector3>& boxes,
+					   std::vector<const LLVector3*>& bounds)
+		{
+			boxes.resize(count * 2);
+			bounds.resize(count);
+			for (U32 i = 0; i < count; i++)
+			{
+				F32 dist = mRand.frand(-10.f, 110.f);
+				boxes[i * 2] = camera.getOrigin() + camera.getAtAxis() * dist + randomVector(dist);
+				F32 size = i % 7 ? mRand.frand(0.f, 10.f) : mRand.frand(0.f, 100.f);
+				LLVector3 radius = randomVector(size);
+				radius.setVec(fabsf(radius.mV[VX]), fabsf(radius.mV[VY]), fabsf(radius.mV[VZ]));
+				boxes[i * 2 + 1] = i % 11 ? radius : LLVector3::zero;
+				bounds[i] = &boxes[i * 2];
+			}
+		}
+
+		// Every available variant gives what the scalar tests give
+		void ensureSameResults(LLCamera& camera, const std::vector<const LLVector3*>& bounds,
+							   BOOL no_far_clip, S32 found[3])
+		{
+			U32 count = bounds.size();
+			std::vector<S32> expected(count);
+			for (U32 i = 0; i < count; i++)
+			{
+				expected[i] = no_far_clip ? camera.AABBInFrustumNoFarClip(bounds[i][0], bounds[i][1])
+										  : camera.AABBInFrustum(bounds[i][0], bounds[i][1]);
+				found[expected[i]]++;
+			}
+
+			for (S32 variant = 0; variant < LLCamera::VARIANT_COUNT; variant++)
+			{
+				if (!LLCamera::setBatchVariant((LLCamera::EBatchVariant)variant))
+				{
+					continue;
+				}
+				std::vector<S32> results(count + 1, -1);
+				camera.AABBInFrustumBatch(&bounds[0], count, &results[0], no_far_clip);
+				for (U32 i = 0; i < count; i++)
+				{
+					ensure_equals(LLCamera::getBatchVariantName((LLCamera::EBatchVariant)variant),
+								  results[i], expected[i]);
+				}
+				ensure_equals("past the end untouched", results[count], -1);
+			}
+		}
+
+		LLTestRand mRand;
+	};
+
+	typedef test_group<camera_data> camera_test;
+	typedef camera_test::object camera_object;
+	tut::camera_test tc("LLCamera");
+
+	template<> template<>
+	void camera_object::test<1>()
+	{
+		// Random boxes against random frustums, with and without far clip
+		// and a user clip plane, and with a plane ignored
+		S32 found[3] = { 0, 0, 0 };
+		for (U32 pass = 0; pass < 40; pass++)
+		{
+			LLCamera camera;
+			aimCamera(camera);
+			if (pass % 4 == 1)
+			{
+				camera.setUserClipPlane(LLPlane(camera.getOrigin() + randomVector(20.f), randomVector(1.f)));
+			}
+			else if (pass % 4 == 2)
+			{
+				camera.ignoreAgentFrustumPlane(LLCamera::AGENT_PLANE_NEAR);
+			}
+
+			std::vector<LLVector3> boxes;
+			std::vector<const LLVector3*> bounds;
+			makeBoxes(camera, 1000, boxes, bounds);
+			ensureSameResults(camera, bounds, FALSE, found);
+			ensureSameResults(camera, bounds, TRUE, found);
+		}
+		ensure("some out", found[0] > 0);
+		ensure("some partly in", found[1] > 0);
+		ensure("some all in", found[2] > 0);
+	}
+
+	template<> template<>
+	void camera_object::test<2>()
+	{
+		// Batches that don't fill the vectors
+		LLCamera camera;
+		aimCamera(camera);
+		std::vector<LLVector3> boxes;
+		std::vector<const LLVector3*> bounds;
+		makeBoxes(camera, 17, boxes, bounds);
+		S32 found[3] = { 0, 0, 0 };
+		for (U32 count = 1; count <= bounds.size(); count++)
+		{
+			std::vector<const LLVector3*> batch(bounds.begin(), bounds.begin() + count);
+			ensureSameResults(camera, batch, FALSE, found);
+		}
+
+		// Nothing to test
+		S32 result = -1;
+		camera.AABBInFrustumBatch(&bounds[0], 0, &result);
+		ensure_equals("no boxes", result, -1);
+	}
+
+	template<> template<>
+	void camera_object::test<3>()
+	{
+		// Picking variants
+		ensure("reference available", LLCamera::isBatchVariantAvailable(LLCamera::VARIANT_REFERENCE));
+		ensure("count not available", !LLCamera::isBatchVariantAvailable(LLCamera::VARIANT_COUNT));
+		ensure("best available", LLCamera::isBatchVariantAvailable(LLCamera::getBestBatchVariant()));
+
+		ensure("set reference", LLCamera::setBatchVariant(LLCamera::VARIANT_REFERENCE));
+		ensure("can't set count", !LLCamera::setBatchVariant(LLCamera::VARIANT_COUNT));
+		ensure_equals("still reference", LLCamera::getBatchVariant(), LLCamera::VARIANT_REFERENCE);
+		ensure("set best", LLCamera::setBatchVariant(LLCamera::getBestBatchVariant()));
+		ensure_equals("best", LLCamera::getBatchVariant(), LLCamera::getBestBatchVariant());
+	}
+}
@@ -0,0 +1,269 @@
+/**
+ * @file llvertexcacheoptimizer_test.cpp
+ * @brief Tests for LLVertexCacheOptimizer and the cache order of LLVolumeFace
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvertexcacheoptimizer.h"
+#include "../llvolume.h"
+#include "../llvolumemgr.h"
+
+#include "../test/lltut.h"
+
+#include <map>
+
+namespace
+{
+	// width x height quads, row after row, as LLVolumeFace::createSide() makes them
+	std::vector<U16> make_grid(S32 width, S32 height)
+	{
+		std::vector<U16> indices;
+		S32 row = width + 1;
+		for (S32 t = 0; t < height; t++)
+		{
+			for (S32 s = 0; s < width; s++)
+			{
+				indices.push_back(s + row * t);
+				indices.push_back(s + 1 + row * (t + 1));
+				indices.push_back(s + row * (t + 1));
+				indices.push_back(s + row * t);
+				indices.push_back(s + 1 + row * t);
+				indices.push_back(s + 1 + row * (t + 1));
+			}
+		}
+		return indices;
+	}
+
+	typedef std::map<std::vector<U16>, S32> triangle_map_t;
+
+	std::vector<U16> triangle(const U16* indices)
+	{
+		return std::vector<U16>(indices, indices + 3);
+	}
+
+	// The first use of each vertex comes in vertex order
+	bool in_first_use_order(const std::vector<U16>& indices)
+	{
+		S32 next = 0;
+		for (U32 i = 0; i < indices.size(); i++)
+		{
+			if (indices[i] > next)
+			{
+				return false;
+			}
+			if (indices[i] == next)
+			{
+				next++;
+			}
+		}
+		return true;
+	}
+
+	LLVolumeParams torus_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_SQUARE | LL_PCODE_HOLE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setBeginAndEndS(0.1f, 0.9f);
+		params.setHollow(0.4f);
+		params.setRatio(1.f, 0.25f);
+		params.setTwistEnd(0.5f);
+		return params;
+	}
+}
+
+namespace tut
+{
+	struct vertexcacheoptimizer_data
+	{
+	};
+
+	typedef test_group<vertexcacheoptimizer_data> vertexcacheoptimizer_test;
+	typedef vertexcacheoptimizer_test::object vertexcacheoptimizer_object;
+	tut::vertexcacheoptimizer_test tut_vertexcacheoptimizer("LLVertexCacheOptimizer");
+
+	template<> template<>
+	void vertexcacheoptimizer_object::test<1>()
+	{
+		// A wide grid gets no reuse from its rows, reordered it gets most
+		// of it, with the same quads, whole and in their own order
+		const S32 width = 40;
+		const S32 height = 30;
+		std::vector<U16> grid = make_grid(width, height);
+		const U32 num_vertices = (width + 1) * (height + 1);
+		F32 before = LLVertexCacheOptimizer::getACMR(&grid[0], grid.size());
+		ensure("a vertex per triangle", before > 0.95f);
+
+		std::vector<U16> indices = grid;
+		std::vector<S32> remap;
+		LLVertexCacheOptimizer::optimizeIndices(&indices[0], indices.size(), num_vertices, 2, &remap);
+		F32 after = LLVertexCacheOptimizer::getACMR(&indices[0], indices.size());
+		ensure("much better", after < 0.75f);
+		ensure("never worse with a bigger cache", LLVertexCacheOptimizer::getACMR(&indices[0], indices.size(), 32) <= after);
+
+		ensure_equals("a place per quad", (S32)remap.size(), width * height);
+		std::vector<S32> seen(remap.size(), 0);
+		for (U32 q = 0; q < remap.size(); q++)
+		{
+			S32 to = remap[q];
+			ensure("in range", to >= 0 && to < (S32)remap.size());
+			seen[to]++;
+			for (U32 i = 0; i < 6; i++)
+			{
+				ensure_equals("same quad", indices[to * 6 + i], grid[q * 6 + i]);
+			}
+		}
+		for (U32 q = 0; q < seen.size(); q++)
+		{
+			ensure_equals("each once", seen[q], 1);
+		}
+	}
+
+	template<> template<>
+	void vertexcacheoptimizer_object::test<2>()
+	{
+		// Vertices are renumbered in the order they are first used, unused
+		// ones last, and too few triangles are left alone
+		U16 indices[] = { 4, 2, 0, 2, 4, 5 };
+		std::vector<U16> remap;
+		LLVertexCacheOptimizer::makeVertexRemap(indices, 6, 6, remap);
+		ensure_equals("first", remap[4], 0);
+		ensure_equals("second", remap[2], 1);
+		ensure_equals("third", remap[0], 2);
+		ensure_equals("fourth", remap[5], 3);
+		ensure_equals("unused", remap[1], 4);
+		ensure_equals("unused last", remap[3], 5);
+
+		std::vector<S32> prim_remap;
+		U16 one[] = { 0, 1, 2 };
+		LLVertexCacheOptimizer::optimizeIndices(one, 3, 3, 1, &prim_remap);
+		ensure("unchanged", one[0] == 0 && one[1] == 1 && one[2] == 2);
+		ensure_equals("identity", prim_remap.size(), 1U);
+
+		ensure_distance("no reuse", LLVertexCacheOptimizer::getACMR(indices, 6), 2.f, 0.0001f);
+		ensure_distance("nothing", LLVertexCacheOptimizer::getACMR(indices, 0), 0.f, 0.0001f);
+	}
+
+	template<> template<>
+	void vertexcacheoptimizer_object::test<3>()
+	{
+		// Every face of a volume keeps its triangles, with the same vertices
+		// in the same rotation, the side quads whole, and its edge map
+		LLPointer<LLVolume> volume = new LLVolume(torus_params(), LLVolumeLODGroup::getVolumeScaleFromDetail(3));
+		ensure("not optimized unless asked", !volume->getVolumeFace(0).mCacheOrderOptimized);
+
+		for (S32 f = 0; f < volume->getNumVolumeFaces(); f++)
+		{
+			const LLVolumeFace& original = volume->getVolumeFace(f);
+			LLVolumeFace face = original;
+			// tag each vertex with its original number
+			for (U32 v = 0; v < face.mVertices.size(); v++)
+			{
+				face.mVertices[v].mTexCoord.mV[0] = (F32)v;
+			}
+			face.optimizeCacheOrder();
+			ensure("optimized", face.mCacheOrderOptimized);
+			ensure_equals("vertices", face.mVertices.size(), original.mVertices.size());
+			ensure_equals("indices", face.mIndices.size(), original.mIndices.size());
+			ensure("first use order", in_first_use_order(face.mIndices));
+			ensure("not worse", LLVertexCacheOptimizer::getACMR(&face.mIndices[0], face.mIndices.size())
+				   <= LLVertexCacheOptimizer::getACMR(&original.mIndices[0], original.mIndices.size()) + 0.001f);
+
+			triangle_map_t triangles;
+			for (U32 t = 0; t < original.mIndices.size() / 3; t++)
+			{
+				triangles[triangle(&original.mIndices[t * 3])] = t;
+			}
+			std::vector<S32> tri_orig(face.mIndices.size() / 3);
+			for (U32 t = 0; t < tri_orig.size(); t++)
+			{
+				U16 tagged[3];
+				for (U32 k = 0; k < 3; k++)
+				{
+					const LLVolumeFace::VertexData& vertex = face.mVertices[face.mIndices[t * 3 + k]];
+					tagged[k] = (U16)vertex.mTexCoord.mV[0];
+					ensure("same position", vertex.mPosition == original.mVertices[tagged[k]].mPosition);
+				}
+				triangle_map_t::iterator iter = triangles.find(triangle(tagged));
+				ensure("same triangle", iter != triangles.end());
+				tri_orig[t] = iter->second;
+				triangles.erase(iter);
+			}
+			ensure("all triangles", triangles.empty());
+
+			if (!(face.mTypeMask & LLVolumeFace::CAP_MASK))
+			{
+				for (U32 t = 0; t < tri_orig.size(); t += 2)
+				{
+					ensure("quads whole", tri_orig[t] % 2 == 0 && tri_orig[t + 1] == tri_orig[t] + 1);
+				}
+			}
+
+			ensure_equals("edges", face.mEdge.size(), original.mEdge.size());
+			if (face.mEdge.size() == face.mIndices.size())
+			{
+				for (U32 t = 0; t < tri_orig.size(); t++)
+				{
+					for (U32 k = 0; k < 3; k++)
+					{
+						S32 neighbor = face.mEdge[t * 3 + k];
+						S32 original_neighbor = original.mEdge[tri_orig[t] * 3 + k];
+						ensure("same neighbor", neighbor < 0 ? neighbor == original_neighbor : tri_orig[neighbor] == original_neighbor);
+					}
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void vertexcacheoptimizer_object::test<4>()
+	{
+		// With sOptimizeCacheOrder shared volumes are built optimized, and
+		// rebuilt from scratch rather than in place, unique ones are not
+		LLVolumeParams params = torus_params();
+		F32 detail = LLVolumeLODGroup::getVolumeScaleFromDetail(2);
+		LLPointer<LLVolume> plain = new LLVolume(params, detail);
+
+		LLVolume::sOptimizeCacheOrder = TRUE;
+		LLPointer<LLVolume> shared = new LLVolume(params, detail);
+		LLPointer<LLVolume> unique = new LLVolume(params, detail, FALSE, TRUE);
+		F32 plain_acmr = 0.f;
+		F32 shared_acmr = 0.f;
+		for (S32 f = 0; f < shared->getNumVolumeFaces(); f++)
+		{
+			const LLVolumeFace& face = shared->getVolumeFace(f);
+			ensure("optimized", face.mCacheOrderOptimized || face.mIndices.size() < 6);
+			ensure("unique not", !unique->getVolumeFace(f).mCacheOrderOptimized);
+			ensure_equals("same size", face.mVertices.size(), plain->getVolumeFace(f).mVertices.size());
+			plain_acmr += LLVertexCacheOptimizer::getACMR(&plain->getVolumeFace(f).mIndices[0], plain->getVolumeFace(f).mIndices.size());
+			shared_acmr += LLVertexCacheOptimizer::getACMR(&face.mIndices[0], face.mIndices.size());
+		}
+		ensure("fewer misses", shared_acmr < plain_acmr);
+
+		shared->regen();
+		ensure("rebuilt optimized", shared->getVolumeFace(0).mCacheOrderOptimized);
+		ensure_equals("same faces", shared->getNumVolumeFaces(), plain->getNumVolumeFaces());
+		LLVolume::sOptimizeCacheOrder = FALSE;
+	}
+}
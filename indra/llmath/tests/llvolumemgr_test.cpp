@@ -0,0 +1,317 @@
+/**
+ * @file llvolumemgr_test.cpp
+ * @brief Tests for the background volume builds of LLVolumeMgr
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolumemgr.h"
+#include "../llvolume.h"
+#include "llthreadpool.h"
+
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace
+{
+	// A twisted, hollow torus segment: several faces of every kind
+	LLVolumeParams torus_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_SQUARE | LL_PCODE_HOLE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setBeginAndEndS(0.1f, 0.9f);
+		params.setBeginAndEndT(0.f, 0.75f);
+		params.setHollow(0.4f);
+		params.setRatio(1.f, 0.25f);
+		params.setTwistEnd(0.5f);
+		return params;
+	}
+
+	LLVolumeParams sculpt_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setSculptID(LLUUID("a1b2c3d4-0000-1111-2222-333344445555"), LL_SCULPT_TYPE_SPHERE);
+		return params;
+	}
+
+	// A bumpy sphere map
+	std::vector<U8> sculpt_map(S32 width, S32 height)
+	{
+		std::vector<U8> data(width * height * 3);
+		for (S32 t = 0; t < height; t++)
+		{
+			for (S32 s = 0; s < width; s++)
+			{
+				U8* p = &data[(t * width + s) * 3];
+				F32 theta = F_TWO_PI * s / (width - 1);
+				F32 phi = F_PI * t / (height - 1);
+				F32 r = 100.f + 20.f * ((s + t) % 3);
+				p[0] = (U8)llclamp(128.f + r * sinf(phi) * cosf(theta), 0.f, 255.f);
+				p[1] = (U8)llclamp(128.f + r * sinf(phi) * sinf(theta), 0.f, 255.f);
+				p[2] = (U8)llclamp(128.f + r * cosf(phi), 0.f, 255.f);
+			}
+		}
+		return data;
+	}
+
+	bool same_faces(const LLVolume* a, const LLVolume* b)
+	{
+		if (a->getNumVolumeFaces() != b->getNumVolumeFaces() || a->mFaceMask != b->mFaceMask)
+		{
+			return false;
+		}
+		for (S32 i = 0; i < a->getNumVolumeFaces(); i++)
+		{
+			const LLVolumeFace& fa = a->getVolumeFace(i);
+			const LLVolumeFace& fb = b->getVolumeFace(i);
+			if (fa.mID != fb.mID || fa.mVertices.size() != fb.mVertices.size() || fa.mIndices != fb.mIndices)
+			{
+				return false;
+			}
+			for (U32 v = 0; v < fa.mVertices.size(); v++)
+			{
+				if (fa.mVertices[v].mPosition != fb.mVertices[v].mPosition
+					|| fa.mVertices[v].mNormal != fb.mVertices[v].mNormal
+					|| fa.mVertices[v].mTexCoord != fb.mVertices[v].mTexCoord)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+namespace tut
+{
+	struct volumemgr_data
+	{
+		volumemgr_data() : mPool("volumemgr_test", 2) {}
+
+		LLThreadPool mPool;
+	};
+
+	typedef test_group<volumemgr_data> volumemgr_test;
+	typedef volumemgr_test::object volumemgr_object;
+	tut::volumemgr_test tut_volumemgr("LLVolumeMgr");
+
+	template<> template<>
+	void volumemgr_object::test<1>()
+	{
+		// Without a pool volumes are built right away, with one they are
+		// handed out with their profile and built on a worker
+		LLVolumeParams params = torus_params();
+		LLPointer<LLVolume> reference = new LLVolume(params, LLVolumeLODGroup::getVolumeScaleFromDetail(2));
+
+		LLVolumeMgr mgr;
+		LLPointer<LLVolume> volume = mgr.refVolume(params, 2);
+		ensure("built right away", !volume->isBuildPending());
+		ensure("same as a new volume", same_faces(volume, reference));
+		mgr.unrefVolume(volume);
+		volume = NULL;
+
+		mgr.setThreadPool(&mPool);
+		volume = mgr.refVolume(params, 2);
+		ensure("pending", volume->isBuildPending());
+		ensure_equals("profile faces", volume->getNumFaces(), reference->getNumFaces());
+		ensure_equals("no volume faces yet", volume->getNumVolumeFaces(), 0);
+		ensure_equals("one build", mgr.getNumPendingBuilds(), 1);
+
+		LLPointer<LLVolume> again = mgr.refVolume(params, 2);
+		ensure("shared", again == volume);
+		ensure_equals("still one build", mgr.getNumPendingBuilds(), 1);
+
+		ensure_equals("swapped in", mgr.finishBuilds(), 1);
+		ensure("built", !volume->isBuildPending());
+		ensure("same as built here", same_faces(volume, reference));
+		ensure_equals("no builds", mgr.getNumPendingBuilds(), 0);
+
+		mgr.unrefVolume(again);
+		mgr.unrefVolume(volume);
+		again = NULL;
+		volume = NULL;
+		ensure("no refs left", mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object::test<2>()
+	{
+		// A new LOD shows a built one of the same params until it is built,
+		// a volume nobody holds any more is not swapped
+		LLVolumeParams params = torus_params();
+		LLVolumeMgr mgr;
+		mgr.setThreadPool(&mPool);
+
+		LLPointer<LLVolume> high = mgr.refVolume(params, 3);
+		mgr.finishBuilds();
+		LLPointer<LLVolume> low = mgr.refVolume(params, 0);
+		ensure("pending", low->isBuildPending());
+		ensure("placeholder faces", same_faces(low, high));
+
+		LLPointer<LLVolume> reference = new LLVolume(params, LLVolumeLODGroup::getVolumeScaleFromDetail(0));
+		mgr.finishBuilds();
+		ensure("own faces", same_faces(low, reference));
+		ensure("fewer vertices", low->getVolumeFace(0).mVertices.size() < high->getVolumeFace(0).mVertices.size());
+
+		LLPointer<LLVolume> dropped = mgr.refVolume(params, 1);
+		ensure("pending", dropped->isBuildPending());
+		mgr.unrefVolume(dropped);
+		dropped = NULL;
+		ensure_equals("nothing to swap in", mgr.finishBuilds(), 0);
+
+		mgr.unrefVolume(low);
+		mgr.unrefVolume(high);
+		low = NULL;
+		high = NULL;
+		ensure("no refs left", mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object::test<3>()
+	{
+		// Sculpts are built on a worker, asking again for the same level
+		// doesn't start another build and a new level replaces it
+		LLVolumeParams params = sculpt_params();
+		std::vector<U8> map = sculpt_map(32, 32);
+		F32 detail = LLVolumeLODGroup::getVolumeScaleFromDetail(3);
+		LLPointer<LLVolume> reference = new LLVolume(params, detail);
+		reference->sculpt(32, 32, 3, &map[0], 1);
+
+		LLVolumeMgr mgr;
+		mgr.setThreadPool(&mPool);
+		LLPointer<LLVolume> volume = mgr.refVolume(params, 3);
+		ensure("sculpts wait for their map", !volume->isBuildPending());
+		ensure_equals("no faces", volume->getNumVolumeFaces(), 0);
+
+		mgr.sculpt(volume, 16, 16, 3, &map[0], 2);
+		ensure("pending", volume->isBuildPending());
+		mgr.sculpt(volume, 32, 32, 3, &map[0], 1);
+		ensure_equals("replaced", mgr.getNumPendingBuilds(), 1);
+		mgr.sculpt(volume, 32, 32, 3, &map[0], 1);
+		ensure_equals("one build", mgr.getNumPendingBuilds(), 1);
+		ensure_equals("level once built", volume->getSculptLevel(), -2);
+
+		mgr.finishBuilds();
+		ensure_equals("sculpt level", volume->getSculptLevel(), 1);
+		ensure("same as sculpted here", same_faces(volume, reference));
+
+		// Without a pool sculpts happen right away
+		mgr.setThreadPool(NULL);
+		mgr.sculpt(volume, 0, 0, 0, NULL, -1);
+		ensure("right away", !volume->isBuildPending());
+		ensure_equals("placeholder level", volume->getSculptLevel(), -1);
+
+		mgr.unrefVolume(volume);
+		volume = NULL;
+		ensure("no refs left", mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object::test<4>()
+	{
+		// Unused volumes stay cached within the budget and come back from
+		// it, the least recently used are evicted first
+		LLVolumeParams params = torus_params();
+		LLVolumeParams other = torus_params();
+		other.setHollow(0.2f);
+
+		LLVolumeMgr mgr;
+		LLPointer<LLVolume> volume = mgr.refVolume(params, 2);
+		LLVolume* first = volume;
+		S32 bytes = volume->getGeometryBytes();
+		ensure("has geometry", bytes > (S32)sizeof(LLVolume));
+		mgr.unrefVolume(volume);
+		volume = NULL;
+		ensure_equals("no budget, not kept", mgr.getNumCachedVolumes(), 0);
+		ensure("group gone", mgr.getGroup(params) == NULL);
+
+		mgr.setCacheBudget(bytes * 3);
+		volume = mgr.refVolume(params, 2);
+		ensure_equals("another miss", mgr.getCacheMisses(), 2U);
+		first = volume;
+		mgr.unrefVolume(volume);
+		volume = NULL;
+		ensure_equals("kept", mgr.getNumCachedVolumes(), 1);
+		ensure_equals("bytes", mgr.getCacheBytes(), bytes);
+		ensure("group kept", mgr.getGroup(params) != NULL);
+
+		volume = mgr.refVolume(params, 2);
+		ensure("same volume", volume.get() == first);
+		ensure_equals("hit", mgr.getCacheHits(), 1U);
+		ensure_equals("in use again", mgr.getNumCachedVolumes(), 0);
+		ensure_equals("no bytes", mgr.getCacheBytes(), 0);
+
+		// other, then params, are cached, a third volume pushes other out
+		LLPointer<LLVolume> second = mgr.refVolume(other, 2);
+		LLPointer<LLVolume> third = mgr.refVolume(params, 3);
+		mgr.unrefVolume(second);
+		mgr.unrefVolume(volume);
+		second = NULL;
+		volume = NULL;
+		ensure_equals("both kept", mgr.getNumCachedVolumes(), 2);
+		mgr.unrefVolume(third);
+		third = NULL;
+		ensure("over budget", mgr.getCacheBytes() <= mgr.getCacheBudget());
+		ensure("evicted", mgr.getCacheEvictions() > 0);
+		ensure("least recent gone", mgr.getGroup(other) == NULL);
+		ensure("most recent kept", mgr.getGroup(params)->getLOD(3) != NULL);
+
+		mgr.setCacheBudget(0);
+		ensure_equals("all evicted", mgr.getNumCachedVolumes(), 0);
+		ensure_equals("no bytes left", mgr.getCacheBytes(), 0);
+		ensure("no groups", mgr.getGroup(params) == NULL);
+		ensure("no refs left", mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object::test<5>()
+	{
+		// A volume dropped while it is built stays cached, and its bytes are
+		// those of its built faces once they are in
+		LLVolumeParams params = torus_params();
+		LLVolumeMgr mgr;
+		mgr.setThreadPool(&mPool);
+		mgr.setCacheBudget(16 * 1024 * 1024);
+
+		LLPointer<LLVolume> volume = mgr.refVolume(params, 3);
+		LLVolume* pending = volume;
+		ensure("pending", volume->isBuildPending());
+		mgr.unrefVolume(volume);
+		volume = NULL;
+		S32 placeholder_bytes = mgr.getCacheBytes();
+		ensure_equals("swapped in", mgr.finishBuilds(), 1);
+		ensure("built bytes", mgr.getCacheBytes() > placeholder_bytes);
+		ensure_equals("bytes of the built faces", mgr.getCacheBytes(), pending->getGeometryBytes());
+
+		volume = mgr.refVolume(params, 3);
+		ensure("cached", volume.get() == pending);
+		ensure("built", !volume->isBuildPending());
+		ensure_equals("no build", mgr.getNumPendingBuilds(), 0);
+		mgr.unrefVolume(volume);
+		volume = NULL;
+		ensure("no refs left", mgr.cleanup());
+	}
+}
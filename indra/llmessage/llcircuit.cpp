@@ -64,6 +64,40 @@ const F32 TARGET_PERIOD_LENGTH = 5.f;	// seconds
 const F32 LL_DUPLICATE_SUPPRESSION_TIMEOUT = 60.f; //seconds - this can be long, as time-based cleanup is
 													// only done when wrapping packetids, now...
 
+LLReliablePacket* LLReliablePacketList::find(TPACKETID packet_id) const
+{
+	LLOpenHashMap<TPACKETID, iterator>::const_iterator it = mIndex.find(packet_id);
+	if (it == mIndex.end())
+	{
+		return NULL;
+	}
+	return *(it->second);
+}
+
+void LLReliablePacketList::push_back(LLReliablePacket* packetp)
+{
+	mIndex[packetp->mPacketID] = mPackets.insert(mPackets.end(), packetp);
+}
+
+LLReliablePacket* LLReliablePacketList::remove(TPACKETID packet_id)
+{
+	LLOpenHashMap<TPACKETID, iterator>::iterator it = mIndex.find(packet_id);
+	if (it == mIndex.end())
+	{
+		return NULL;
+	}
+	LLReliablePacket* packetp = *(it->second);
+	mPackets.erase(it->second);
+	mIndex.erase(it);
+	return packetp;
+}
+
+LLReliablePacketList::iterator LLReliablePacketList::erase(iterator iter)
+{
+	mIndex.erase((*iter)->mPacketID);
+	return mPackets.erase(iter);
+}
+
 LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id, 
 							 const F32 circuit_heartbeat_interval, const F32 circuit_timeout)
 :	mHost (host),
@@ -135,7 +169,7 @@ LLCircuitData::~LLCircuitData()
 	reliable_iter end = mUnackedPackets.end();
 	for(iter = mUnackedPackets.begin(); iter != end; ++iter)
 	{
-		packetp = iter->second;
+		packetp = *iter;
 		gMessageSystem->mFailedResendPackets++;
 		if(gMessageSystem->mVerboseLog)
 		{
@@ -157,7 +191,7 @@ LLCircuitData::~LLCircuitData()
 	end = mFinalRetryPackets.end();
 	for(iter = mFinalRetryPackets.begin(); iter != end; ++iter)
 	{
-		packetp = iter->second;
+		packetp = *iter;
 		gMessageSystem->mFailedResendPackets++;
 		if(gMessageSystem->mVerboseLog)
 		{
@@ -189,80 +223,43 @@ LLCircuitData::~LLCircuitData()
 
 void LLCircuitData::ackReliablePacket(TPACKETID packet_num)
 {
-	reliable_iter iter;
-	LLReliablePacket *packetp;
-
-	iter = mUnackedPackets.find(packet_num);
-	if (iter != mUnackedPackets.end())
+	LLReliablePacket *packetp = mUnackedPackets.remove(packet_num);
+	if (!packetp)
 	{
-		packetp = iter->second;
-
-		if(gMessageSystem->mVerboseLog)
-		{
-			std::ostringstream str;
-			str << "MSG: <- " << packetp->mHost << "\tRELIABLE ACKED:\t"
-				<< packetp->mPacketID;
-			llinfos << str.str() << llendl;
-		}
-		if (packetp->mCallback)
-		{
-			if (packetp->mTimeout < 0.f)   // negative timeout will always return timeout even for successful ack, for debugging
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);					
-			}
-			else
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_NOERR);
-			}
-		}
-
-		// Update stats
-		mUnackedPacketCount--;
-		mUnackedPacketBytes -= packetp->mBufferLength;
-
-		// Cleanup
-		delete packetp;
-		mUnackedPackets.erase(iter);
+		packetp = mFinalRetryPackets.remove(packet_num);
+	}
+	if (!packetp)
+	{
+		// Couldn't find this packet on either of the unacked lists.
+		// maybe it's a duplicate ack?
 		return;
 	}
 
-	iter = mFinalRetryPackets.find(packet_num);
-	if (iter != mFinalRetryPackets.end())
+	if(gMessageSystem->mVerboseLog)
 	{
-		packetp = iter->second;
-		// llinfos << "Packet " << packet_num << " removed from the pending list" << llendl;
-		if(gMessageSystem->mVerboseLog)
+		std::ostringstream str;
+		str << "MSG: <- " << packetp->mHost << "\tRELIABLE ACKED:\t"
+			<< packetp->mPacketID;
+		llinfos << str.str() << llendl;
+	}
+	if (packetp->mCallback)
+	{
+		if (packetp->mTimeout < 0.f)   // negative timeout will always return timeout even for successful ack, for debugging
 		{
-			std::ostringstream str;
-			str << "MSG: <- " << packetp->mHost << "\tRELIABLE ACKED:\t"
-				<< packetp->mPacketID;
-			llinfos << str.str() << llendl;
+			packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);					
 		}
-		if (packetp->mCallback)
+		else
 		{
-			if (packetp->mTimeout < 0.f)   // negative timeout will always return timeout even for successful ack, for debugging
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);					
-			}
-			else
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_NOERR);
-			}
+			packetp->mCallback(packetp->mCallbackData,LL_ERR_NOERR);
 		}
+	}
 
-		// Update stats
-		mUnackedPacketCount--;
-		mUnackedPacketBytes -= packetp->mBufferLength;
+	// Update stats
+	mUnackedPacketCount--;
+	mUnackedPacketBytes -= packetp->mBufferLength;
 
-		// Cleanup
-		delete packetp;
-		mFinalRetryPackets.erase(iter);
-	}
-	else
-	{
-		// Couldn't find this packet on either of the unacked lists.
-		// maybe it's a duplicate ack?
-	}
+	// Cleanup
+	delete packetp;
 }
 
 
@@ -274,17 +271,15 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 
 
 	//
-	// Theoretically we should search through the list for the packet with the oldest
-	// packet ID, as otherwise when we WRAP we will resend reliable packets out of order.
-	// Since resends are ALREADY out of order, and wrapping is highly rare (16+million packets),
-	// I'm not going to worry about this for now - djs
+	// The unacked packets are kept in the order they were sent, so the oldest
+	// get resent first even when the packet ids wrap.
 	//
 
 	reliable_iter iter;
 	BOOL have_resend_overflow = FALSE;
 	for (iter = mUnackedPackets.begin(); iter != mUnackedPackets.end();)
 	{
-		packetp = iter->second;
+		packetp = *iter;
 
 		// Only check overflow if we haven't had one yet.
 		if (!have_resend_overflow)
@@ -305,8 +300,8 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 					// This circuit has overflowed.  Do not retry.  Do not pass go.
 					packetp->mRetries = 0;
 					// Remove it from this list and add it to the final list.
-					mUnackedPackets.erase(iter++);
-					mFinalRetryPackets[packetp->mPacketID] = packetp;
+					iter = mUnackedPackets.erase(iter);
+					mFinalRetryPackets.push_back(packetp);
 				}
 				else
 				{
@@ -365,8 +360,8 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 			if (!packetp->mRetries)
 			{
 				// Last resend, remove it from this list and add it to the final list.
-				mUnackedPackets.erase(iter++);
-				mFinalRetryPackets[packetp->mPacketID] = packetp;
+				iter = mUnackedPackets.erase(iter);
+				mFinalRetryPackets.push_back(packetp);
 			}
 			else
 			{
@@ -385,7 +380,7 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 
 	for (iter = mFinalRetryPackets.begin(); iter != mFinalRetryPackets.end();)
 	{
-		packetp = iter->second;
+		packetp = *iter;
 		if (now > packetp->mExpirationTime)
 		{
 			// fail (too many retries)
@@ -413,7 +408,7 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 			mUnackedPacketCount--;
 			mUnackedPacketBytes -= packetp->mBufferLength;
 
-			mFinalRetryPackets.erase(iter++);
+			iter = mFinalRetryPackets.erase(iter);
 			delete packetp;
 		}
 		else
@@ -447,6 +442,7 @@ LLCircuitData *LLCircuit::addCircuitData(const LLHost &host, TPACKETID in_id)
 	llinfos << "LLCircuit::addCircuitData for " << host << llendl;
 	LLCircuitData *tempp = new LLCircuitData(host, in_id, mHeartbeatInterval, mHeartbeatTimeout);
 	mCircuitData.insert(circuit_data_map::value_type(host, tempp));
+	mCircuitIndex.insert(circuit_index_t::value_type(host, tempp));
 	mPingSet.insert(tempp);
 
 	mLastCircuit = tempp;
@@ -462,6 +458,7 @@ void LLCircuit::removeCircuitData(const LLHost &host)
 	{
 		LLCircuitData *cdp = it->second;
 		mCircuitData.erase(it);
+		mCircuitIndex.erase(host);
 
 		LLCircuit::ping_set_t::iterator psit = mPingSet.find(cdp);
 		if (psit != mPingSet.end())
@@ -572,11 +569,11 @@ void LLCircuitData::addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLR
 
 	if (params && params->mRetries)
 	{
-		mUnackedPackets[packet_info->mPacketID] = packet_info;
+		mUnackedPackets.push_back(packet_info);
 	}
 	else
 	{
-		mFinalRetryPackets[packet_info->mPacketID] = packet_info;
+		mFinalRetryPackets.push_back(packet_info);
 	}
 }
 
@@ -621,8 +618,8 @@ LLCircuitData* LLCircuit::findCircuit(const LLHost& host) const
 		return mLastCircuit;
 	}
 
-	circuit_data_map::const_iterator it = mCircuitData.find(host);
-	if(it == mCircuitData.end())
+	circuit_index_t::const_iterator it = mCircuitIndex.find(host);
+	if(it == mCircuitIndex.end())
 	{
 		return NULL;
 	}
@@ -862,90 +859,26 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 	// the ping was sent.
 
 	// Find the current oldest reliable packetID
-	// This is to handle the case if we actually manage to wrap our
-	// packet IDs - the oldest will actually have a higher packet ID
-	// than the current.
-	BOOL wrapped = FALSE;
-	reliable_iter iter;
-	iter = mUnackedPackets.upper_bound(getPacketOutID());
-	if (iter == mUnackedPackets.end())
+	// Packet IDs wrap, so the oldest is the one furthest behind the last
+	// one sent. The unacked packets are in the order they were sent, but
+	// the final retry ones are in the order they got their last chance.
+	// If there are no unacked packets at all, send the ID of the last
+	// packet we sent out. This will flush all of the destination's
+	// unacked packets, theoretically.
+	TPACKETID packet_id = getPacketOutID();
+	U32 oldest_age = 0;
+	if (!mUnackedPackets.empty())
 	{
-		// Nothing AFTER this one, so we want the lowest packet ID
-		// then.
-		iter = mUnackedPackets.begin();
-		wrapped = TRUE;
-	}
-
-	TPACKETID packet_id = 0;
-
-	// Check against the "final" packets
-	BOOL wrapped_final = FALSE;
-	reliable_iter iter_final;
-	iter_final = mFinalRetryPackets.upper_bound(getPacketOutID());
-	if (iter_final == mFinalRetryPackets.end())
-	{
-		iter_final = mFinalRetryPackets.begin();
-		wrapped_final = TRUE;
-	}
-
-	//llinfos << mHost << " - unacked count " << mUnackedPackets.size() << llendl;
-	//llinfos << mHost << " - final count " << mFinalRetryPackets.size() << llendl;
-	if (wrapped != wrapped_final)
-	{
-		// One of the "unacked" or "final" lists hasn't wrapped.  Whichever one
-		// hasn't has the oldest packet.
-		if (!wrapped)
-		{
-			// Hasn't wrapped, so the one on the
-			// unacked packet list is older
-			packet_id = iter->first;
-			//llinfos << mHost << ": nowrapped unacked" << llendl;
-		}
-		else
-		{
-			packet_id = iter_final->first;
-			//llinfos << mHost << ": nowrapped final" << llendl;
-		}
+		packet_id = (*mUnackedPackets.begin())->mPacketID;
+		oldest_age = (getPacketOutID() - packet_id) % LL_MAX_OUT_PACKET_ID;
 	}
-	else
+	for (reliable_iter iter = mFinalRetryPackets.begin(); iter != mFinalRetryPackets.end(); ++iter)
 	{
-		// They both wrapped, we can just use the minimum of the two.
-		if ((iter == mUnackedPackets.end()) && (iter_final == mFinalRetryPackets.end()))
+		U32 age = (getPacketOutID() - (*iter)->mPacketID) % LL_MAX_OUT_PACKET_ID;
+		if (age > oldest_age)
 		{
-			// Wow!  No unacked packets at all!
-			// Send the ID of the last packet we sent out.
-			// This will flush all of the destination's
-			// unacked packets, theoretically.
-			//llinfos << mHost << ": No unacked!" << llendl;
-			packet_id = getPacketOutID();
-		}
-		else
-		{
-			BOOL had_unacked = FALSE;
-			if (iter != mUnackedPackets.end())
-			{
-				// Unacked list has the lowest so far
-				packet_id = iter->first;
-				had_unacked = TRUE;
-				//llinfos << mHost << ": Unacked" << llendl;
-			}
-
-			if (iter_final != mFinalRetryPackets.end())
-			{
-				// Use the lowest of the unacked list and the final list
-				if (had_unacked)
-				{
-					// Both had a packet, use the lowest.
-					packet_id = llmin(packet_id, iter_final->first);
-					//llinfos << mHost << ": Min of unacked/final" << llendl;
-				}
-				else
-				{
-					// Only the final had a packet, use it.
-					packet_id = iter_final->first;
-					//llinfos << mHost << ": Final!" << llendl;
-				}
-			}
+			packet_id = (*iter)->mPacketID;
+			oldest_age = age;
 		}
 	}
 
@@ -980,7 +913,7 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 					<< (*it).first;
 				llinfos << str.str() << llendl;
 			}
-			mPotentialLostPackets.erase(it++);
+			it = mPotentialLostPackets.erase(it);
 		}
 		else
 		{
@@ -1000,42 +933,41 @@ void LLCircuitData::clearDuplicateList(TPACKETID oldest_id)
 
 	//llinfos << mHost << ": clearing before oldest " << oldest_id << llendl;
 	//llinfos << "Recent list before: " << mRecentlyReceivedReliablePackets.size() << llendl;
-	if (oldest_id < mHighestPacketID)
-	{
-		// Clean up everything with a packet ID less than oldest_id.
-		packet_time_map::iterator pit_start;
-		packet_time_map::iterator pit_end;
-		pit_start = mRecentlyReceivedReliablePackets.begin();
-		pit_end = mRecentlyReceivedReliablePackets.lower_bound(oldest_id);
-		mRecentlyReceivedReliablePackets.erase(pit_start, pit_end);
-	}
+	const BOOL clear_older = (oldest_id < mHighestPacketID);
 
-	// Do timeout checks on everything with an ID > mHighestPacketID.
-	// This should be empty except for wrapping IDs.  Thus, this should be
+	// Clean up everything with a packet ID less than oldest_id, and do
+	// timeout checks on everything with an ID > mHighestPacketID.
+	// The latter should be empty except for wrapping IDs.  Thus, this should be
 	// highly rare.
 	U64 mt_usec = LLMessageSystem::getMessageTimeUsecs();
 
 	packet_time_map::iterator pit;
-	for(pit = mRecentlyReceivedReliablePackets.upper_bound(mHighestPacketID);
+	for(pit = mRecentlyReceivedReliablePackets.begin();
 		pit != mRecentlyReceivedReliablePackets.end(); )
 	{
-		// Validate that the packet ID seems far enough away
-		if ((pit->first - mHighestPacketID) < 100)
+		if (clear_older && (pit->first < oldest_id))
 		{
-			llwarns << "Probably incorrectly timing out non-wrapped packets!" << llendl;
+			pit = mRecentlyReceivedReliablePackets.erase(pit);
+			continue;
 		}
-		U64 delta_t_usec = mt_usec - (*pit).second;
-		F64 delta_t_sec = delta_t_usec * SEC_PER_USEC;
-		if (delta_t_sec > LL_DUPLICATE_SUPPRESSION_TIMEOUT)
+		if (pit->first > mHighestPacketID)
 		{
-			// enough time has elapsed we're not likely to get a duplicate on this one
-			llinfos << "Clearing " << pit->first << " from recent list" << llendl;
-			mRecentlyReceivedReliablePackets.erase(pit++);
-		}
-		else
-		{
-			++pit;
+			// Validate that the packet ID seems far enough away
+			if ((pit->first - mHighestPacketID) < 100)
+			{
+				llwarns << "Probably incorrectly timing out non-wrapped packets!" << llendl;
+			}
+			U64 delta_t_usec = mt_usec - (*pit).second;
+			F64 delta_t_sec = delta_t_usec * SEC_PER_USEC;
+			if (delta_t_sec > LL_DUPLICATE_SUPPRESSION_TIMEOUT)
+			{
+				// enough time has elapsed we're not likely to get a duplicate on this one
+				llinfos << "Clearing " << pit->first << " from recent list" << llendl;
+				pit = mRecentlyReceivedReliablePackets.erase(pit);
+				continue;
+			}
 		}
+		++pit;
 	}
 	//llinfos << "Recent list after: " << mRecentlyReceivedReliablePackets.size() << llendl;
 }
@@ -28,6 +28,7 @@
 #ifndef LL_LLCIRCUIT_H
 #define LL_LLCIRCUIT_H
 
+#include <list>
 #include <map>
 #include <vector>
 
@@ -41,6 +42,7 @@
 #include "lluuid.h"
 #include "llthrottle.h"
 #include "llstat.h"
+#include "llopenhashmap.h"
 
 //
 // Constants
@@ -72,6 +74,34 @@ class LLSD;
 // Classes
 //
 
+// Reliable packets waiting for their ack, in the order they were added,
+// which is the order they were sent in (or given their last chance in, for
+// the final retry list). Looking a packet up by id and removing it take
+// constant time, as acking happens for every reliable packet sent.
+class LLReliablePacketList
+{
+public:
+	typedef std::list<LLReliablePacket*>::iterator iterator;
+
+	iterator begin()	{ return mPackets.begin(); }
+	iterator end()		{ return mPackets.end(); }
+	bool empty() const	{ return mPackets.empty(); }
+	U32 size() const	{ return mIndex.size(); }
+
+	// Returns NULL if there is no such packet
+	LLReliablePacket* find(TPACKETID packet_id) const;
+	void push_back(LLReliablePacket* packetp);
+
+	// Returns the removed packet, or NULL if there is no such packet
+	LLReliablePacket* remove(TPACKETID packet_id);
+	// Returns the packet after the erased one
+	iterator erase(iterator iter);
+
+private:
+	std::list<LLReliablePacket*> mPackets;
+	LLOpenHashMap<TPACKETID, iterator> mIndex;
+};
+
 
 class LLCircuitData
 {
@@ -233,17 +263,18 @@ protected:
 	U32		mPingDelay;             // raw ping delay
 	F32		mPingDelayAveraged;     // averaged ping delay (fast attack/slow decay)
 
-	typedef std::map<TPACKETID, U64> packet_time_map;
+	// Packet ids and the time in usecs they were noticed missing or
+	// received, hashed since every packet received looks them up
+	typedef LLOpenHashMap<TPACKETID, U64> packet_time_map;
 
 	packet_time_map							mPotentialLostPackets;
 	packet_time_map							mRecentlyReceivedReliablePackets;
 	std::vector<TPACKETID> mAcks;
 
-	typedef std::map<TPACKETID, LLReliablePacket *> reliable_map;
-	typedef reliable_map::iterator					reliable_iter;
+	typedef LLReliablePacketList::iterator			reliable_iter;
 
-	reliable_map							mUnackedPackets;
-	reliable_map							mFinalRetryPackets;
+	LLReliablePacketList					mUnackedPackets;
+	LLReliablePacketList					mFinalRetryPackets;
 
 	S32										mUnackedPacketCount;
 	S32										mUnackedPacketBytes;
@@ -333,6 +364,10 @@ public:
 protected:
 	circuit_data_map mCircuitData;
 
+	// The same circuits hashed, for findCircuit()
+	typedef LLOpenHashMap<LLHost, LLCircuitData*, LLHostHash> circuit_index_t;
+	circuit_index_t mCircuitIndex;
+
 	typedef std::set<LLCircuitData *, LLCircuitData::less> ping_set_t; // Circuits sorted by next ping time
 	ping_set_t mPingSet;
 
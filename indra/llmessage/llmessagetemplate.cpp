@@ -67,6 +67,56 @@ void LLMsgData::addDataFast(char *blockname, char *varname, const void *data, S3
 	}
 }
 
+void LLMessageTemplate::compileDecodeTable()
+{
+	mDecodeBlocks.clear();
+	mDecodeVariables.clear();
+	for (message_block_map_t::const_iterator iter = mMemberBlocks.begin();
+		 iter != mMemberBlocks.end(); ++iter)
+	{
+		const LLMessageBlock* blockp = *iter;
+		DecodeBlock block;
+		block.mName = blockp->mName;
+		block.mType = blockp->mType;
+		block.mNumber = blockp->mNumber;
+		block.mFirstVariable = (S32)mDecodeVariables.size();
+		block.mNumVariables = (S32)blockp->mMemberVariables.size();
+		mDecodeBlocks.push_back(block);
+
+		for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = blockp->mMemberVariables.begin();
+			 var_iter != blockp->mMemberVariables.end(); ++var_iter)
+		{
+			const LLMessageVariable* variablep = *var_iter;
+			DecodeVariable variable;
+			variable.mName = variablep->getName();
+			variable.mType = variablep->getType();
+			variable.mSize = variablep->getSize();
+			mDecodeVariables.push_back(variable);
+		}
+	}
+}
+
+S32 LLMessageTemplate::getBlockIndex(const char* name) const
+{
+	message_block_map_t::const_iterator iter = mMemberBlocks.find((char*)name);
+	if (iter == mMemberBlocks.end())
+	{
+		return -1;
+	}
+	return (S32)(iter - mMemberBlocks.begin());
+}
+
+S32 LLMessageTemplate::getVariableIndex(S32 block_index, const char* name) const
+{
+	const LLMessageBlock* blockp = *(mMemberBlocks.begin() + block_index);
+	LLMessageBlock::message_variable_map_t::const_iterator iter = blockp->mMemberVariables.find(name);
+	if (iter == blockp->mMemberVariables.end())
+	{
+		return -1;
+	}
+	return (S32)(iter - blockp->mMemberVariables.begin());
+}
+
 // LLMessageVariable functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageVariable &msg)
@@ -391,6 +391,34 @@ public:
 		return iter != mMemberBlocks.end()? *iter : NULL;
 	}
 
+	// The blocks and variables in flat arrays, in template order, so the
+	// reader decodes without going through the block and variable maps.
+	struct DecodeBlock
+	{
+		char*				mName;
+		EMsgBlockType		mType;
+		S32					mNumber;
+		S32					mFirstVariable;		// in mDecodeVariables
+		S32					mNumVariables;
+	};
+
+	struct DecodeVariable
+	{
+		char*				mName;
+		EMsgVariableType	mType;
+		S32					mSize;				// size of the size for MVT_VARIABLE
+	};
+
+	// Builds mDecodeBlocks and mDecodeVariables, once all the blocks are added
+	void compileDecodeTable();
+	bool isDecodeTableCompiled() const			{ return mDecodeBlocks.size() == mMemberBlocks.size(); }
+
+	// Index of the named block in mDecodeBlocks, -1 if there is none
+	S32 getBlockIndex(const char* name) const;
+	// Index of the named variable among those of the block at block_index,
+	// -1 if there is none
+	S32 getVariableIndex(S32 block_index, const char* name) const;
+
 public:
 	typedef LLDynamicArrayIndexed<LLMessageBlock*, char*, 8> message_block_map_t;
 	message_block_map_t						mMemberBlocks;
@@ -412,6 +440,9 @@ public:
 	bool									mBanFromTrusted;
 	bool									mBanFromUntrusted;
 
+	std::vector<DecodeBlock>				mDecodeBlocks;
+	std::vector<DecodeVariable>				mDecodeVariables;
+
 private:
 	// message handler function (this is set by each application)
 	void									(*mHandlerFunc)(LLMessageSystem *msgsystem, void **user_data);
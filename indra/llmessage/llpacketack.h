@@ -93,6 +93,7 @@ public:
 	};
 
 	friend class LLCircuitData;
+	friend class LLReliablePacketList;
 protected:
 	S32 mSocket;
 	LLHost mHost;
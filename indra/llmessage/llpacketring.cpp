@@ -47,7 +47,10 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mBatchSize(0),
+	mBatchCount(0),
+	mBatchNext(0)
 {
 }
 
@@ -108,6 +111,48 @@ void LLPacketRing::setOutBandwidth(const F32 bps)
 {
 	mOutThrottle.setRate(bps);
 }
+
+void LLPacketRing::setReceiveBatchSize(S32 batch_size)
+{
+	// The slab is resized by the next batch receive, once the packets
+	// it holds have been handed out
+	const S32 MAX_BATCH_SIZE = 1024;
+	mBatchSize = llclamp(batch_size, 0, MAX_BATCH_SIZE);
+}
+
+///////////////////////////////////////////////////////////
+S32 LLPacketRing::receiveFromBatch (S32 socket, char *datap)
+{
+	if (mBatchNext >= mBatchCount)
+	{
+		mBatchNext = 0;
+		mBatchCount = 0;
+		if (mBatchSize <= 1)
+		{
+			return 0;
+		}
+
+		if ((S32)mBatchSizes.size() != mBatchSize)
+		{
+			mBatchData.resize(mBatchSize * NET_BUFFER_SIZE);
+			mBatchSizes.resize(mBatchSize);
+			mBatchSenders.resize(mBatchSize);
+			mBatchReceivingIFs.resize(mBatchSize);
+		}
+		mBatchCount = receive_packets(socket, &mBatchData[0], &mBatchSizes[0], &mBatchSenders[0], &mBatchReceivingIFs[0], mBatchSize);
+		if (!mBatchCount)
+		{
+			return 0;
+		}
+	}
+
+	S32 packet_size = mBatchSizes[mBatchNext];
+	memcpy(datap, &mBatchData[mBatchNext * NET_BUFFER_SIZE], packet_size);	/*Flawfinder: ignore*/
+	mLastSender = mBatchSenders[mBatchNext];
+	mLastReceivingIF = mBatchReceivingIFs[mBatchNext];
+	mBatchNext++;
+	return packet_size;
+}
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 {
@@ -216,9 +261,16 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 	else
 	{
 		// no delay, pull straight from net
-		packet_size = receive_packet(socket, datap);		
-		mLastSender = ::get_sender();
-		mLastReceivingIF = ::get_receiving_interface();
+		if (mBatchSize > 1 || mBatchNext < mBatchCount)
+		{
+			packet_size = receiveFromBatch(socket, datap);
+		}
+		else
+		{
+			packet_size = receive_packet(socket, datap);		
+			mLastSender = ::get_sender();
+			mLastReceivingIF = ::get_receiving_interface();
+		}
 
 		if (packet_size)  // did we actually get a packet?
 		{
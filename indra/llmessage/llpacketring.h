@@ -29,6 +29,7 @@
 #define LL_LLPACKETRING_H
 
 #include <queue>
+#include <vector>
 
 #include "llpacketbuffer.h"
 #include "llhost.h"
@@ -53,6 +54,12 @@ public:
 	S32  receivePacket (S32 socket, char *datap);
 	S32  receiveFromRing (S32 socket, char *datap);
 
+	// Receive up to batch_size packets per system call when not throttling
+	// the input, 0 or 1 receives them one at a time. Packets already
+	// received are still handed out first, in order.
+	void setReceiveBatchSize(S32 batch_size);
+	S32  getReceiveBatchSize() const			{ return mBatchSize; }
+
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
 	inline LLHost getLastSender();
@@ -61,6 +68,8 @@ public:
 	S32 getAndResetActualInBits()				{ S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
 	S32 getAndResetActualOutBits()				{ S32 bits = mActualBitsOut; mActualBitsOut = 0; return bits;}
 protected:
+	S32  receiveFromBatch(S32 socket, char *datap);
+
 	BOOL mUseInThrottle;
 	BOOL mUseOutThrottle;
 	
@@ -80,6 +89,16 @@ protected:
 	std::queue<LLPacketBuffer *> mReceiveQueue;
 	std::queue<LLPacketBuffer *> mSendQueue;
 
+	// Packets received by the last batch receive, mBatchNext is the next
+	// one to hand out
+	S32 mBatchSize;
+	S32 mBatchCount;
+	S32 mBatchNext;
+	std::vector<char> mBatchData;			// NET_BUFFER_SIZE bytes per packet
+	std::vector<S32> mBatchSizes;
+	std::vector<LLHost> mBatchSenders;
+	std::vector<LLHost> mBatchReceivingIFs;
+
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 };
@@ -41,16 +41,14 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 												 number_template_map) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
-	mCurrentRMessageData(NULL),
-	mMessageNumbers(number_template_map)
+	mMessageNumbers(number_template_map),
+	mDecoded(false)
 {
 }
 
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
 }
 
 //virtual
@@ -58,8 +56,7 @@ void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = NULL;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
+	mDecoded = false;
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -71,77 +68,95 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{
 		llerrs << "Invalid mCurrentMessageData in getData!" << llendl;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block = mCurrentRMessageTemplate->getBlockIndex(blockname);
+	if (block < 0 || blocknum < 0 || blocknum >= mBlockCounts[block])
 	{
 		llerrs << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << llendl;
+			<< " not in message " << mCurrentRMessageTemplate->mName << llendl;
+		return;
+	}
+
+	S32 variable = mCurrentRMessageTemplate->getVariableIndex(block, varname);
+	if (variable < 0)
+	{
+		llerrs << "Variable "<< varname << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << llendl;
 		return;
 	}
 
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
+	copyData(block, variable, blocknum, datap, size, max_size);
+}
+
+void LLTemplateMessageReader::getData(LLMessageField& field, void *datap, S32 size, S32 blocknum, S32 max_size)
+{
+	// is there a message ready to go?
+	if (mReceiveSize == -1 || !mDecoded)
+	{
+		llerrs << "No message waiting for decode 2!" << llendl;
+		return;
+	}
 
-	if (!vardata.getName())
+	S32 block;
+	S32 variable;
+	field.getIndices(mCurrentRMessageTemplate, block, variable);
+	if (block < 0 || blocknum < 0 || blocknum >= mBlockCounts[block])
+	{
+		llerrs << "Block " << field.getBlockName() << " #" << blocknum
+			<< " not in message " << mCurrentRMessageTemplate->mName << llendl;
+		return;
+	}
+	if (variable < 0)
 	{
-		llerrs << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << llendl;
+		llerrs << "Variable "<< field.getVariableName() << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << field.getBlockName() << llendl;
 		return;
 	}
 
-	if (size && size != vardata.getSize())
+	copyData(block, variable, blocknum, datap, size, max_size);
+}
+
+void LLTemplateMessageReader::copyData(S32 block, S32 variable, S32 blocknum, void *datap, S32 size, S32 max_size) const
+{
+	const LLMessageTemplate::DecodeBlock& decode_block = mCurrentRMessageTemplate->mDecodeBlocks[block];
+	const LLMessageTemplate::DecodeVariable& decode_variable = 
+		mCurrentRMessageTemplate->mDecodeVariables[decode_block.mFirstVariable + variable];
+	const Field& field = mFields[mBlockFields[block] + blocknum * decode_block.mNumVariables + variable];
+
+	if (size && size != field.mSize)
 	{
-		llerrs << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		llerrs << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << decode_variable.mName
+			<< " is size " << field.mSize
 			<< " but copying into buffer of size " << size
 			<< llendl;
 		return;
 	}
 
+	if (!field.mSize)
+	{
+		return;
+	}
 
-	const S32 vardata_size = vardata.getSize();
-	if( max_size >= vardata_size )
+	const U8* data = &mData[field.mOffset];
+	if( max_size >= field.mSize )
 	{   
-		switch( vardata_size )
-		{ 
-		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
-			break;
-		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
-			break;
-		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
-			break;
-		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
-			break;
-		default:
-			memcpy(datap, vardata.getData(), vardata_size);
-			break;
-		}
+		htonmemcpy(datap, data, decode_variable.mType, field.mSize);
 	}
 	else
 	{
-		llwarns << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		llwarns << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << decode_variable.mName
+			<< " is size " << field.mSize
 			<< " but truncated to max size of " << max_size
 			<< llendl;
 
-		memcpy(datap, vardata.getData(), max_size);
+		memcpy(datap, data, max_size);
 	}
 }
 
@@ -154,22 +169,19 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{
 		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block = mCurrentRMessageTemplate->getBlockIndex(blockname);
+	if (block < 0)
 	{
 		return 0;
 	}
 
-	return (iter->second)->mBlockNumber;
+	return mBlockCounts[block];
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -181,43 +193,22 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{	// This is a serious error - crash
 		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
-	{	// don't crash
-		llinfos << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << llendl;
-		return LL_BLOCK_NOT_IN_MESSAGE;
-	}
-
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
-	{	// don't crash
-		llinfos << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << llendl;
-		return LL_VARIABLE_NOT_IN_BLOCK;
-	}
-
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	S32 block = mCurrentRMessageTemplate->getBlockIndex(blockname);
+	if (block >= 0 && mCurrentRMessageTemplate->mDecodeBlocks[block].mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		llerrs << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		llerrs << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	S32 variable = block >= 0 ? mCurrentRMessageTemplate->getVariableIndex(block, varname) : -1;
+	return getFieldSize(block, variable, 0, blockname, varname);
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -229,35 +220,51 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{	// This is a serious error - crash
 		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
+	S32 block = mCurrentRMessageTemplate->getBlockIndex(blockname);
+	S32 variable = block >= 0 ? mCurrentRMessageTemplate->getVariableIndex(block, varname) : -1;
+	return getFieldSize(block, variable, blocknum, blockname, varname);
+}
 
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+S32 LLTemplateMessageReader::getSize(LLMessageField& field, S32 blocknum)
+{
+	// is there a message ready to go?
+	if (mReceiveSize == -1 || !mDecoded)
+	{	// This is a serious error - crash
+		llerrs << "No message waiting for decode 5!" << llendl;
+		return LL_MESSAGE_ERROR;
+	}
+
+	S32 block;
+	S32 variable;
+	field.getIndices(mCurrentRMessageTemplate, block, variable);
+	return getFieldSize(block, variable, blocknum, field.getBlockName(), field.getVariableName());
+}
+
+S32 LLTemplateMessageReader::getFieldSize(S32 block, S32 variable, S32 blocknum,
+										  const char* blockname, const char* varname) const
+{
+	if (block < 0 || blocknum < 0 || blocknum >= mBlockCounts[block])
 	{	// don't crash
-		llinfos << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << llendl;
+		llinfos << "Block " << blockname << " not in message "
+			<< mCurrentRMessageTemplate->mName << llendl;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	if (variable < 0)
 	{	// don't crash
-		llinfos << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << llendl;
+		llinfos << "Variable " << varname << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << llendl;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	const LLMessageTemplate::DecodeBlock& decode_block = mCurrentRMessageTemplate->mDecodeBlocks[block];
+	return mFields[mBlockFields[block] + blocknum * decode_block.mNumVariables + variable].mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -433,6 +440,66 @@ inline void LLTemplateMessageReader::getString(const char *block, const char *va
 	outstr = s;
 }
 
+void LLTemplateMessageReader::getBinaryData(LLMessageField& field, void *datap, 
+											S32 size, S32 blocknum, S32 max_size)
+{
+	getData(field, datap, size, blocknum, max_size);
+}
+
+void LLTemplateMessageReader::getU8(LLMessageField& field, U8 &u, S32 blocknum)
+{
+	getData(field, &u, sizeof(U8), blocknum);
+}
+
+void LLTemplateMessageReader::getU16(LLMessageField& field, U16 &d, S32 blocknum)
+{
+	getData(field, &d, sizeof(U16), blocknum);
+}
+
+void LLTemplateMessageReader::getS32(LLMessageField& field, S32 &d, S32 blocknum)
+{
+	getData(field, &d, sizeof(S32), blocknum);
+}
+
+void LLTemplateMessageReader::getU32(LLMessageField& field, U32 &d, S32 blocknum)
+{
+	getData(field, &d, sizeof(U32), blocknum);
+}
+
+void LLTemplateMessageReader::getU64(LLMessageField& field, U64 &d, S32 blocknum)
+{
+	getData(field, &d, sizeof(U64), blocknum);
+}
+
+void LLTemplateMessageReader::getF32(LLMessageField& field, F32 &d, S32 blocknum)
+{
+	getData(field, &d, sizeof(F32), blocknum);
+
+	if( !llfinite( d ) )
+	{
+		llwarns << "non-finite in getF32Fast " << field.getBlockName() << " " 
+				<< field.getVariableName() << llendl;
+		d = 0;
+	}
+}
+
+void LLTemplateMessageReader::getVector3(LLMessageField& field, LLVector3 &v, S32 blocknum)
+{
+	getData(field, &v.mV[0], sizeof(v.mV), blocknum);
+
+	if( !v.isFinite() )
+	{
+		llwarns << "non-finite in getVector3Fast " << field.getBlockName() << " " 
+				<< field.getVariableName() << llendl;
+		v.zeroVec();
+	}
+}
+
+void LLTemplateMessageReader::getUUID(LLMessageField& field, LLUUID &u, S32 blocknum)
+{
+	getData(field, &u.mData[0], sizeof(u.mData), blocknum);
+}
+
 //virtual 
 S32 LLTemplateMessageReader::getMessageSize() const
 {
@@ -524,6 +591,14 @@ void LLTemplateMessageReader::logRanOffEndOfPacket( const LLHost& host, const S3
 	gMessageSystem->callExceptionFunc(MX_RAN_OFF_END_OF_PACKET);
 }
 
+// Appends size zeroes to the decoded data, returns where they start
+S32 LLTemplateMessageReader::addZeroes(S32 size)
+{
+	S32 offset = (S32)mData.size();
+	mData.resize(offset + size, 0);
+	return offset;
+}
+
 static LLFastTimer::DeclareTimer FTM_PROCESS_MESSAGES("Process Messages");
 
 // decode a given message
@@ -531,40 +606,48 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 {
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
+
+	if (!mCurrentRMessageTemplate->isDecodeTableCompiled())
+	{
+		// a block or variable was added to the template after it was
+		// added to the message system
+		mCurrentRMessageTemplate->compileDecodeTable();
+	}
+	const std::vector<LLMessageTemplate::DecodeBlock>& blocks = mCurrentRMessageTemplate->mDecodeBlocks;
+	const std::vector<LLMessageTemplate::DecodeVariable>& variables = mCurrentRMessageTemplate->mDecodeVariables;
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
+	// reset the working data set, keeping its storage
+	mData.assign(buffer, buffer + mReceiveSize);
+	mFields.clear();
+	mBlockFields.resize(blocks.size());
+	mBlockCounts.resize(blocks.size());
+	S32 total_blocks = 0;
 	
-	// loop through the template building the data structure as we go
-	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
-		++iter)
+	// loop through the template recording where each variable is as we go
+	for (S32 block = 0; block < (S32)blocks.size(); ++block)
 	{
-		LLMessageBlock* mbci = *iter;
+		const LLMessageTemplate::DecodeBlock& mbci = blocks[block];
 		U8	repeat_number;
 		S32	i;
 
 		// how many of this block?
 
-		if (mbci->mType == MBT_SINGLE)
+		if (mbci.mType == MBT_SINGLE)
 		{
 			// just one
 			repeat_number = 1;
 		}
-		else if (mbci->mType == MBT_MULTIPLE)
+		else if (mbci.mType == MBT_MULTIPLE)
 		{
 			// a known number
-			repeat_number = mbci->mNumber;
+			repeat_number = mbci.mNumber;
 		}
-		else if (mbci->mType == MBT_VARIABLE)
+		else if (mbci.mType == MBT_VARIABLE)
 		{
 			// need to read the number from the message
 			// repeat number is a single byte
@@ -589,42 +672,24 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = NULL;
+		mBlockFields[block] = (S32)mFields.size();
+		mBlockCounts[block] = repeat_number;
+		total_blocks += repeat_number;
 
 		// now loop through the block
 		for (i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
-			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-			}
-
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
-
 			// now read the variables
-			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
-					 mbci->mMemberVariables.begin();
-				 iter != mbci->mMemberVariables.end(); iter++)
+			for (S32 var = 0; var < mbci.mNumVariables; ++var)
 			{
-				const LLMessageVariable& mvci = **iter;
-
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				const LLMessageTemplate::DecodeVariable& mvci = variables[mbci.mFirstVariable + var];
+				Field field;
 
 				// what type of variable?
-				if (mvci.getType() == MVT_VARIABLE)
+				if (mvci.mType == MVT_VARIABLE)
 				{
 					// variable, get the number of bytes to read from the template
-					S32 data_size = mvci.getSize();
+					S32 data_size = mvci.mSize;
 					U8 tsizeb = 0;
 					U16 tsizeh = 0;
 					U32 tsize = 0;
@@ -658,38 +723,42 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+					if (decode_pos + (S32)tsize > mReceiveSize || (S32)tsize < 0)
+					{
+						logRanOffEndOfPacket(sender, decode_pos, tsize);
+
+						// keep what there is
+						tsize = llmax(mReceiveSize - decode_pos, 0);
+					}
+					field.mOffset = decode_pos;
+					field.mSize = tsize;
 					decode_pos += tsize;
 				}
 				else
 				{
 					// fixed!
-					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					// so, record data offset and set data size to fixed size
+					field.mSize = mvci.mSize;
+					if ((decode_pos + mvci.mSize) > mReceiveSize)
 					{
-						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+						logRanOffEndOfPacket(sender, decode_pos, mvci.mSize);
 
 						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
+						field.mOffset = addZeroes(mvci.mSize);
 					}
 					else
 					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
+						field.mOffset = decode_pos;
 					}
-					decode_pos += mvci.getSize();
+					decode_pos += mvci.mSize;
 				}
+				mFields.push_back(field);
 			}
 		}
 	}
+	mDecoded = true;
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (!total_blocks && !blocks.empty())
 	{
 		lldebugs << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << llendl;
 		return FALSE;
@@ -823,5 +892,37 @@ void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+	if (!mDecoded)
+	{
+		return;
+	}
+
+	// rebuild the message data the builder copies from
+	const std::vector<LLMessageTemplate::DecodeBlock>& blocks = mCurrentRMessageTemplate->mDecodeBlocks;
+	const std::vector<LLMessageTemplate::DecodeVariable>& variables = mCurrentRMessageTemplate->mDecodeVariables;
+	LLMsgData data(mCurrentRMessageTemplate->mName);
+	for (S32 block = 0; block < (S32)blocks.size(); ++block)
+	{
+		const LLMessageTemplate::DecodeBlock& mbci = blocks[block];
+		const Field* fieldp = &mFields[mBlockFields[block]];
+		for (S32 i = 0; i < mBlockCounts[block]; ++i)
+		{
+			LLMsgBlkData* cur_data_block = new LLMsgBlkData(mbci.mName, mBlockCounts[block]);
+			if (i)
+			{
+				// build new name to prevent collisions
+				cur_data_block->mName = mbci.mName + i;
+			}
+			data.addBlock(cur_data_block);
+
+			for (S32 var = 0; var < mbci.mNumVariables; ++var, ++fieldp)
+			{
+				const LLMessageTemplate::DecodeVariable& mvci = variables[mbci.mFirstVariable + var];
+				cur_data_block->addVariable(mvci.mName, mvci.mType);
+				cur_data_block->addData(mvci.mName, fieldp->mSize ? &mData[fieldp->mOffset] : NULL,
+										fieldp->mSize, mvci.mType);
+			}
+		}
+	}
+	builder.copyFromMessageData(data);
 }
@@ -30,9 +30,10 @@
 #include "llmessagereader.h"
 
 #include <map>
+#include <vector>
 
+class LLMessageField;
 class LLMessageTemplate;
-class LLMsgData;
 
 class LLTemplateMessageReader : public LLMessageReader
 {
@@ -98,6 +99,19 @@ public:
 
 	virtual void copyToBuilder(LLMessageBuilder&) const;
 
+	// Constant time accessors, see LLMessageField
+	void getBinaryData(LLMessageField& field, void *datap, S32 size, 
+					   S32 blocknum = 0, S32 max_size = S32_MAX);
+	void getU8(LLMessageField& field, U8 &data, S32 blocknum = 0);
+	void getU16(LLMessageField& field, U16 &data, S32 blocknum = 0);
+	void getS32(LLMessageField& field, S32 &data, S32 blocknum = 0);
+	void getU32(LLMessageField& field, U32 &data, S32 blocknum = 0);
+	void getU64(LLMessageField& field, U64 &data, S32 blocknum = 0);
+	void getF32(LLMessageField& field, F32 &data, S32 blocknum = 0);
+	void getVector3(LLMessageField& field, LLVector3 &vec, S32 blocknum = 0);
+	void getUUID(LLMessageField& field, LLUUID &uuid, S32 blocknum = 0);
+	S32	getSize(LLMessageField& field, S32 blocknum);
+
 	BOOL validateMessage(const U8* buffer, S32 buffer_size, 
 						 const LLHost& sender, bool trusted = false);
 	BOOL readMessage(const U8* buffer, const LLHost& sender);
@@ -110,6 +124,13 @@ private:
 
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
+	void getData(LLMessageField& field, void *datap, 
+				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
+	void copyData(S32 block, S32 variable, S32 blocknum, void *datap, 
+				  S32 size, S32 max_size) const;
+	S32 getFieldSize(S32 block, S32 variable, S32 blocknum, 
+					 const char* blockname, const char* varname) const;
+	S32 addZeroes(S32 size);
 
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template ); // outputs
@@ -118,10 +139,25 @@ private:
 
 	BOOL decodeData(const U8* buffer, const LLHost& sender );
 
+	// Where the value of a variable is in mData
+	struct Field
+	{
+		S32 mOffset;
+		S32 mSize;
+	};
+
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
 	message_template_number_map_t& mMessageNumbers;
+
+	// The decoded message: a copy of its data, followed by zeroes for the
+	// variables past its end, and every variable of every block in template
+	// order. Kept between messages, so decoding does not allocate.
+	bool mDecoded;
+	std::vector<U8> mData;
+	std::vector<Field> mFields;
+	std::vector<S32> mBlockFields;		// first field of each template block
+	std::vector<S32> mBlockCounts;		// number of each template block
 };
 
 #endif // LL_LLTEMPLATEMESSAGEREADER_H
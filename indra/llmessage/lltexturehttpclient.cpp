@@ -0,0 +1,573 @@
+/**
+ * @file lltexturehttpclient.cpp
+ * @brief HTTP client for texture fetches: persistent connections per host,
+ * pipelining and adaptive request concurrency
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltexturehttpclient.h"
+
+#include "llbufferstream.h"
+#include "llhttpstatuscodes.h"
+#include "llstl.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+static const S32 MULTI_PERFORM_CALL_REPEAT	= 5;
+static const S32 TEXTURE_REQUEST_TIMEOUT	= 30; // seconds
+static const S32 MAX_REDIRECTS				= 5;
+static const S32 DEFAULT_MAX_HOST_REQUESTS	= 32;
+static const S32 DEFAULT_MAX_HOST_CONNECTIONS = 8;
+static const F32 DEFAULT_HOST_IDLE_TIMEOUT	= 60.f; // seconds
+
+// The server queues our requests when the time to first byte grows past
+// twice the best seen
+static const F32 RTT_QUEUEING_FACTOR	= 2.f;
+static const F32 RTT_SMOOTHING			= 0.125f;
+// The best time to first byte is forgotten every so many samples, in case
+// the route to the host got slower
+static const S32 RTT_MIN_RESET_SAMPLES	= 256;
+// A round must be this much faster than the previous one to count as faster
+static const F64 THROUGHPUT_GAIN		= 1.1;
+
+const S32 LLTextureHttpClient::INITIAL_HOST_REQUESTS = 8;
+const S32 LLTextureHttpClient::MIN_HOST_REQUESTS = 2;
+
+LLTextureHttpClient::Host::Host()
+	: mActive(0),
+	  mLimit((F32)INITIAL_HOST_REQUESTS),
+	  mSlowStart(true),
+	  mRoundCompleted(0),
+	  mRoundTarget(INITIAL_HOST_REQUESTS),
+	  mRoundBytes(0.0),
+	  mRoundStart(LLTimer::getTotalSeconds()),
+	  mLastThroughput(0.0),
+	  mSmoothedRTT(0.f),
+	  mMinRTT(0.f),
+	  mRTTSamples(0),
+	  mLastUsed(LLTimer::getTotalSeconds())
+{
+}
+
+LLTextureHttpClient::LLTextureHttpClient()
+	: mNumQueued(0),
+	  mNumActive(0),
+	  mNumConnects(0),
+	  mNumCompleted(0),
+	  mPipelining(false),
+	  mMaxHostRequests(DEFAULT_MAX_HOST_REQUESTS),
+	  mMaxHostConnections(DEFAULT_MAX_HOST_CONNECTIONS),
+	  mHostIdleTimeout(DEFAULT_HOST_IDLE_TIMEOUT)
+{
+	mThreadID = LLThread::currentID();
+	mMulti = curl_multi_init();
+	if (!mMulti)
+	{
+		llwarns << "curl_multi_init() returned NULL!" << llendl;
+		return;
+	}
+	setPipelining(mPipelining);
+}
+
+LLTextureHttpClient::~LLTextureHttpClient()
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	for (active_map_t::iterator iter = mActive.begin(); iter != mActive.end(); ++iter)
+	{
+		Request* request = iter->second;
+		curl_multi_remove_handle(mMulti, request->mEasy);
+		curl_easy_cleanup(request->mEasy);
+		curl_slist_free_all(request->mHeaders);
+		delete request;
+	}
+	mActive.clear();
+	for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		deleteHost(iter->second);
+	}
+	mHosts.clear();
+	if (mMulti)
+	{
+		curl_multi_cleanup(mMulti);
+	}
+}
+
+void LLTextureHttpClient::setPipelining(bool pipelining)
+{
+	mPipelining = pipelining;
+	if (!mMulti)
+	{
+		return;
+	}
+#if LIBCURL_VERSION_NUM >= 0x073e00
+	// libcurl 7.62 dropped HTTP/1.1 pipelining: multiplex when the host speaks HTTP/2
+	curl_multi_setopt(mMulti, CURLMOPT_PIPELINING, pipelining ? (long)CURLPIPE_MULTIPLEX : (long)CURLPIPE_NOTHING);
+#else
+	curl_multi_setopt(mMulti, CURLMOPT_PIPELINING, pipelining ? 1L : 0L);
+#endif
+	setMaxHostConnections(mMaxHostConnections);
+}
+
+void LLTextureHttpClient::setMaxHostRequests(S32 max_requests)
+{
+	mMaxHostRequests = llmax(max_requests, MIN_HOST_REQUESTS);
+	for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		iter->second->mLimit = llmin(iter->second->mLimit, (F32)mMaxHostRequests);
+	}
+	setMaxHostConnections(mMaxHostConnections);
+}
+
+void LLTextureHttpClient::setMaxHostConnections(S32 max_connections)
+{
+	mMaxHostConnections = llmax(max_connections, 1);
+	if (!mMulti)
+	{
+		return;
+	}
+#if LIBCURL_VERSION_NUM >= 0x071e00 && LIBCURL_VERSION_NUM < 0x073e00
+	if (mPipelining)
+	{
+		curl_multi_setopt(mMulti, CURLMOPT_MAX_HOST_CONNECTIONS, (long)mMaxHostConnections);
+		// deep enough for all the requests of a host to fit in its connections
+		curl_multi_setopt(mMulti, CURLMOPT_MAX_PIPELINE_LENGTH, (long)((mMaxHostRequests + mMaxHostConnections - 1) / mMaxHostConnections));
+	}
+	else
+	{
+		curl_multi_setopt(mMulti, CURLMOPT_MAX_HOST_CONNECTIONS, (long)mMaxHostRequests);
+	}
+#elif LIBCURL_VERSION_NUM >= 0x073e00
+	// Without HTTP/1.1 pipelining every request in flight needs its own
+	// connection, unless the host multiplexes them over HTTP/2
+	curl_multi_setopt(mMulti, CURLMOPT_MAX_HOST_CONNECTIONS, (long)mMaxHostRequests);
+#endif
+}
+
+S32 LLTextureHttpClient::getRequestLimit() const
+{
+	if (mHosts.empty())
+	{
+		return INITIAL_HOST_REQUESTS;
+	}
+	S32 limit = 0;
+	for (host_map_t::const_iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		limit += (S32)iter->second->mLimit;
+	}
+	return limit;
+}
+
+F32 LLTextureHttpClient::getAverageRTT() const
+{
+	F32 total = 0.f;
+	S32 count = 0;
+	for (host_map_t::const_iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		if (iter->second->mRTTSamples > 0)
+		{
+			total += iter->second->mSmoothedRTT;
+			count++;
+		}
+	}
+	return count ? total / count : 0.f;
+}
+
+LLTextureHttpClient::Host* LLTextureHttpClient::getHost(const std::string& url)
+{
+	// scheme://host:port, the part of the url a connection is for
+	std::string::size_type start = url.find("://");
+	start = (start == std::string::npos) ? 0 : start + 3;
+	std::string key = url.substr(0, url.find_first_of("/?", start));
+
+	host_map_t::iterator iter = mHosts.find(key);
+	if (iter != mHosts.end())
+	{
+		iter->second->mLastUsed = LLTimer::getTotalSeconds();
+		return iter->second;
+	}
+	Host* host = new Host;
+	host->mLimit = llmin(host->mLimit, (F32)mMaxHostRequests);
+	mHosts[key] = host;
+	return host;
+}
+
+bool LLTextureHttpClient::getByteRange(const std::string& url,
+									   const headers_t& headers,
+									   S32 offset, S32 length,
+									   LLCurl::ResponderPtr responder)
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	if (!mMulti)
+	{
+		return false;
+	}
+	Request* request = new Request;
+	request->mURL = url;
+	request->mHeaderStrings = headers;
+	request->mOffset = offset;
+	request->mLength = length;
+	request->mResponder = responder;
+	Host* host = getHost(url);
+	request->mHost = host;
+	if (host->mWaiting.empty() && host->mActive < (S32)host->mLimit)
+	{
+		if (host->mActive == 0)
+		{
+			startRound(host);
+		}
+		if (!startRequest(request))
+		{
+			delete request;
+			return false;
+		}
+		return true;
+	}
+	host->mWaiting.push_back(request);
+	mNumQueued++;
+	return true;
+}
+
+void LLTextureHttpClient::dispatch(Host* host)
+{
+	while (!host->mWaiting.empty() && host->mActive < (S32)host->mLimit)
+	{
+		Request* request = host->mWaiting.front();
+		host->mWaiting.pop_front();
+		mNumQueued--;
+		if (host->mActive == 0)
+		{
+			startRound(host);
+		}
+		if (!startRequest(request))
+		{
+			if (request->mResponder)
+			{
+				request->mResponder->completedRaw(499, "Failed to start the request", request->mChannels, request->mOutput);
+			}
+			delete request;
+		}
+	}
+}
+
+bool LLTextureHttpClient::startRequest(Request* request)
+{
+	Host* host = request->mHost;
+	CURL* easy = NULL;
+	if (!host->mIdleEasy.empty())
+	{
+		// Most recently used first, its connection is the most likely to still be open
+		easy = host->mIdleEasy.back();
+		host->mIdleEasy.pop_back();
+		// Drops every option of the previous request, keeps the connection
+		curl_easy_reset(easy);
+	}
+	else
+	{
+		easy = curl_easy_init();
+		if (!easy)
+		{
+			llwarns << "curl_easy_init() returned NULL! Active: " << mNumActive << llendl;
+			return false;
+		}
+	}
+
+	request->mEasy = easy;
+	request->mErrorBuffer[0] = 0;
+	request->mOutput.reset(new LLBufferArray);
+
+	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &writeCallback);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void*)request);
+	curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, request->mErrorBuffer);
+	if (request->mResponder && request->mResponder->followRedir())
+	{
+		curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(easy, CURLOPT_MAXREDIRS, (long)MAX_REDIRECTS);
+	}
+	if (!LLCurl::getCAPath().empty())
+	{
+		curl_easy_setopt(easy, CURLOPT_CAPATH, LLCurl::getCAPath().c_str());
+	}
+	if (!LLCurl::getCAFile().empty())
+	{
+		curl_easy_setopt(easy, CURLOPT_CAINFO, LLCurl::getCAFile().c_str());
+	}
+	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 1L);
+	curl_easy_setopt(easy, CURLOPT_TIMEOUT, (long)TEXTURE_REQUEST_TIMEOUT);
+	curl_easy_setopt(easy, CURLOPT_URL, request->mURL.c_str());
+	curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+
+	request->mHeaders = curl_slist_append(request->mHeaders, "Connection: keep-alive");
+	request->mHeaders = curl_slist_append(request->mHeaders, "Keep-alive: 300");
+	for (headers_t::const_iterator iter = request->mHeaderStrings.begin();
+		 iter != request->mHeaderStrings.end(); ++iter)
+	{
+		request->mHeaders = curl_slist_append(request->mHeaders, iter->c_str());
+	}
+	if (request->mLength > 0)
+	{
+		std::string range = llformat("Range: bytes=%d-%d", request->mOffset, request->mOffset + request->mLength - 1);
+		request->mHeaders = curl_slist_append(request->mHeaders, range.c_str());
+	}
+	curl_easy_setopt(easy, CURLOPT_HTTPHEADER, request->mHeaders);
+
+	CURLMcode mcode = curl_multi_add_handle(mMulti, easy);
+	if (mcode != CURLM_OK)
+	{
+		llwarns << "Curl Error: " << curl_multi_strerror(mcode) << llendl;
+		curl_easy_cleanup(easy);
+		curl_slist_free_all(request->mHeaders);
+		request->mHeaders = NULL;
+		request->mEasy = NULL;
+		return false;
+	}
+	mActive[easy] = request;
+	host->mActive++;
+	mNumActive++;
+	return true;
+}
+
+S32 LLTextureHttpClient::process()
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	pruneHosts();
+	if (!mMulti || mActive.empty())
+	{
+		return 0;
+	}
+
+	int running = 0;
+	for (S32 call_count = 0; call_count < MULTI_PERFORM_CALL_REPEAT; call_count++)
+	{
+		CURLMcode code = curl_multi_perform(mMulti, &running);
+		if (CURLM_CALL_MULTI_PERFORM != code || running == 0)
+		{
+			break;
+		}
+	}
+
+	S32 completed = 0;
+	CURLMsg* msg;
+	int msgs_in_queue;
+	while ((msg = curl_multi_info_read(mMulti, &msgs_in_queue)))
+	{
+		if (msg->msg != CURLMSG_DONE)
+		{
+			continue;
+		}
+		active_map_t::iterator iter = mActive.find(msg->easy_handle);
+		if (iter == mActive.end())
+		{
+			llwarns << "Completed curl request not found" << llendl;
+			continue;
+		}
+		Request* request = iter->second;
+		mActive.erase(iter);
+		finishRequest(request, msg->data.result);
+		completed++;
+	}
+
+	if (completed > 0)
+	{
+		// Fill the slots freed, and send the new requests right away
+		for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+		{
+			dispatch(iter->second);
+		}
+		curl_multi_perform(mMulti, &running);
+	}
+	return completed;
+}
+
+void LLTextureHttpClient::finishRequest(Request* request, CURLcode code)
+{
+	Host* host = request->mHost;
+	CURL* easy = request->mEasy;
+
+	U32 status = 0;
+	std::string reason;
+	if (code == CURLE_OK)
+	{
+		long response_code = 0;
+		curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response_code);
+		status = (U32)response_code;
+	}
+	else
+	{
+		status = 499;
+		reason = LLCurl::strerror(code) + " : " + request->mErrorBuffer;
+	}
+
+	long connects = 0;
+	curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+	mNumConnects += (S32)connects;
+	updateLimit(host, easy, status);
+
+	curl_multi_remove_handle(mMulti, easy);
+	host->mLastUsed = LLTimer::getTotalSeconds();
+	host->mActive--;
+	mNumActive--;
+	mNumCompleted++;
+	releaseEasy(host, easy);
+	curl_slist_free_all(request->mHeaders);
+	request->mHeaders = NULL;
+
+	if (request->mResponder)
+	{
+		request->mResponder->completedRaw(status, reason, request->mChannels, request->mOutput);
+	}
+	delete request;
+}
+
+void LLTextureHttpClient::updateLimit(Host* host, CURL* easy, U32 status)
+{
+	if (status == HTTP_SERVICE_UNAVAILABLE)
+	{
+		// Server overloaded
+		host->mLimit = llmax(host->mLimit * 0.5f, (F32)MIN_HOST_REQUESTS);
+		host->mSlowStart = false;
+		startRound(host);
+		return;
+	}
+	if (!LLCurl::Responder::isGoodStatus(status))
+	{
+		return;
+	}
+
+	double rtt = 0.0;
+	double bytes = 0.0;
+	curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME, &rtt);
+	curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD, &bytes);
+	if (host->mRTTSamples == 0)
+	{
+		host->mSmoothedRTT = host->mMinRTT = (F32)rtt;
+	}
+	else
+	{
+		host->mSmoothedRTT += ((F32)rtt - host->mSmoothedRTT) * RTT_SMOOTHING;
+		host->mMinRTT = llmin(host->mMinRTT, (F32)rtt);
+	}
+	if (++host->mRTTSamples % RTT_MIN_RESET_SAMPLES == 0)
+	{
+		host->mMinRTT = host->mSmoothedRTT;
+	}
+
+	host->mRoundCompleted++;
+	host->mRoundBytes += bytes;
+	if (host->mRoundCompleted < host->mRoundTarget)
+	{
+		return;
+	}
+
+	// One round trip worth of requests: compare with the previous round
+	F64 now = LLTimer::getTotalSeconds();
+	F64 throughput = host->mRoundBytes / llmax(now - host->mRoundStart, 0.001);
+	bool faster = throughput > host->mLastThroughput * THROUGHPUT_GAIN;
+	bool queueing = host->mSmoothedRTT > host->mMinRTT * RTT_QUEUEING_FACTOR;
+	// Only a limit that holds requests back is worth raising
+	bool limited = !host->mWaiting.empty();
+	if (queueing && !faster)
+	{
+		host->mLimit *= 0.75f;
+		host->mSlowStart = false;
+	}
+	else if (limited && !queueing)
+	{
+		if (host->mSlowStart && faster)
+		{
+			host->mLimit *= 2.f;
+		}
+		else
+		{
+			host->mSlowStart = false;
+			host->mLimit += 1.f;
+		}
+	}
+	host->mLimit = llclamp(host->mLimit, (F32)MIN_HOST_REQUESTS, (F32)mMaxHostRequests);
+	host->mLastThroughput = throughput;
+	startRound(host);
+}
+
+void LLTextureHttpClient::startRound(Host* host)
+{
+	host->mRoundCompleted = 0;
+	host->mRoundBytes = 0.0;
+	host->mRoundTarget = (S32)host->mLimit;
+	host->mRoundStart = LLTimer::getTotalSeconds();
+}
+
+void LLTextureHttpClient::releaseEasy(Host* host, CURL* easy)
+{
+	if ((S32)host->mIdleEasy.size() < mMaxHostRequests)
+	{
+		// Keeps the connection to the host
+		host->mIdleEasy.push_back(easy);
+	}
+	else
+	{
+		curl_easy_cleanup(easy);
+	}
+}
+
+void LLTextureHttpClient::pruneHosts()
+{
+	F64 expired = LLTimer::getTotalSeconds() - mHostIdleTimeout;
+	host_map_t::iterator iter = mHosts.begin();
+	while (iter != mHosts.end())
+	{
+		Host* host = iter->second;
+		if (host->mActive == 0 && host->mWaiting.empty() && host->mLastUsed < expired)
+		{
+			deleteHost(host);
+			mHosts.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+//static
+void LLTextureHttpClient::deleteHost(Host* host)
+{
+	for_each(host->mWaiting.begin(), host->mWaiting.end(), DeletePointer());
+	for (std::vector<CURL*>::iterator iter = host->mIdleEasy.begin(); iter != host->mIdleEasy.end(); ++iter)
+	{
+		curl_easy_cleanup(*iter);
+	}
+	delete host;
+}
+
+//static
+size_t LLTextureHttpClient::writeCallback(char* data, size_t size, size_t nmemb, void* user_data)
+{
+	Request* request = (Request*)user_data;
+	size_t n = size * nmemb;
+	request->mOutput->append(request->mChannels.in(), (const U8*)data, n);
+	return n;
+}
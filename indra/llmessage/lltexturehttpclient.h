@@ -0,0 +1,168 @@
+/**
+ * @file lltexturehttpclient.h
+ * @brief HTTP client for texture fetches: persistent connections per host,
+ * pipelining and adaptive request concurrency
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREHTTPCLIENT_H
+#define LL_LLTEXTUREHTTPCLIENT_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llcurl.h"
+
+// Texture downloads are thousands of small range GETs to the same few
+// region hosts. LLCurlRequest creates a new multi handle every 100 requests
+// and keeps 5 easy handles, so most requests pay for a new TCP connection.
+// This client keeps a single multi handle and, for every host, the easy
+// handles (and so the connections) it used last, asks curl to pipeline the
+// requests on them and lets as many requests run at once as the host
+// sustains:
+//  - the host starts at INITIAL_HOST_REQUESTS and doubles every round trip
+//    of requests that raised the throughput (slow start),
+//  - then grows by one request per round while the time to first byte stays
+//    close to the best seen,
+//  - and backs off by a quarter when the time to first byte grows (the
+//    requests queue up on the server) without any throughput gain, by half
+//    on 503.
+// Requests over the limit wait in a FIFO per host.
+// Hosts nothing was asked of for a while (regions left behind) are dropped,
+// with their connections.
+//
+// Not thread safe, process() and getByteRange() must run on the thread that
+// constructed the client, like LLCurlRequest.
+
+class LLTextureHttpClient
+{
+	LOG_CLASS(LLTextureHttpClient);
+public:
+	typedef std::vector<std::string> headers_t;
+
+	LLTextureHttpClient();
+	~LLTextureHttpClient();
+
+	// Same as LLCurlRequest::getByteRange(). length <= 0 gets the whole file.
+	bool getByteRange(const std::string& url, const headers_t& headers, S32 offset, S32 length, LLCurl::ResponderPtr responder);
+	// Starts queued requests and completes the finished ones. Returns the
+	// number of requests completed.
+	S32  process();
+	// Requests queued or in flight
+	S32  getQueued() const { return mNumQueued + mNumActive; }
+	S32  getNumActive() const { return mNumActive; }
+	// Sum of the per host request limits, to keep enough requests queued for
+	// the pipelines to stay full
+	S32  getRequestLimit() const;
+
+	// HTTP/1.1 pipelining on the persistent connections, off by default:
+	// some proxies and servers mix up pipelined responses
+	void setPipelining(bool pipelining);
+	// Upper bound of the adaptive limit of each host
+	void setMaxHostRequests(S32 max_requests);
+	// Connections curl may have open to a host when pipelining, the requests
+	// share them. Without pipelining (or with libcurl 7.62 and later, which
+	// only multiplexes over HTTP/2) each request in flight has its own.
+	void setMaxHostConnections(S32 max_connections);
+	// Seconds a host without requests keeps its connections and limit
+	void setHostIdleTimeout(F32 seconds) { mHostIdleTimeout = seconds; }
+
+	// Stats
+	S32  getNumConnects() const { return mNumConnects; }	// connections opened so far
+	S32  getNumCompleted() const { return mNumCompleted; }
+	F32  getAverageRTT() const;		// smoothed time to first byte over the hosts, seconds
+	S32  getNumHosts() const { return (S32)mHosts.size(); }
+
+	static const S32 INITIAL_HOST_REQUESTS;
+	static const S32 MIN_HOST_REQUESTS;
+
+private:
+	struct Host;
+
+	struct Request
+	{
+		Request() : mOffset(0), mLength(0), mHeaders(NULL), mEasy(NULL), mHost(NULL) {}
+		std::string mURL;
+		headers_t mHeaderStrings;
+		S32 mOffset;
+		S32 mLength;
+		LLCurl::ResponderPtr mResponder;
+		struct curl_slist* mHeaders;
+		CURL* mEasy;
+		Host* mHost;
+		LLChannelDescriptors mChannels;
+		LLIOPipe::buffer_ptr_t mOutput;
+		char mErrorBuffer[CURL_ERROR_SIZE];
+	};
+
+	struct Host
+	{
+		Host();
+		std::deque<Request*> mWaiting;
+		std::vector<CURL*> mIdleEasy;	// still connected to this host
+		S32 mActive;
+		F32 mLimit;				// adaptive, fractional for additive increase
+		bool mSlowStart;
+		// current round: as many completions as the limit when it started
+		S32 mRoundCompleted;
+		S32 mRoundTarget;
+		F64 mRoundBytes;
+		F64 mRoundStart;
+		F64 mLastThroughput;	// bytes/s of the previous round
+		F32 mSmoothedRTT;		// time to first byte, seconds
+		F32 mMinRTT;
+		S32 mRTTSamples;
+		F64 mLastUsed;			// last request queued or completed
+	};
+
+	Host* getHost(const std::string& url);
+	void dispatch(Host* host);
+	bool startRequest(Request* request);
+	void finishRequest(Request* request, CURLcode code);
+	void updateLimit(Host* host, CURL* easy, U32 status);
+	void startRound(Host* host);
+	void releaseEasy(Host* host, CURL* easy);
+	void pruneHosts();
+	static void deleteHost(Host* host);
+
+	static size_t writeCallback(char* data, size_t size, size_t nmemb, void* user_data);
+
+	CURLM* mMulti;
+	typedef std::map<std::string, Host*> host_map_t;
+	host_map_t mHosts;
+	typedef std::map<CURL*, Request*> active_map_t;
+	active_map_t mActive;
+	S32 mNumQueued;
+	S32 mNumActive;
+	S32 mNumConnects;
+	S32 mNumCompleted;
+	bool mPipelining;
+	S32 mMaxHostRequests;
+	S32 mMaxHostConnections;
+	F32 mHostIdleTimeout;
+	U32 mThreadID; // debug
+};
+
+#endif // LL_LLTEXTUREHTTPCLIENT_H
@@ -0,0 +1,287 @@
+/**
+ * @file llzerocode.cpp
+ * @brief Zero coding of message system packets
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llzerocode.h"
+
+#include "llcircuit.h"
+#include "net.h"
+
+#if LL_ZERO_CODE_SSE2
+#include <emmintrin.h>
+#if LL_MSVC
+#include <intrin.h>
+#endif
+#endif
+
+// Number of the bytes from begin to end before the first zero
+static inline S32 non_zero_run(const U8* begin, const U8* end)
+{
+	const U8* ptr = begin;
+#if LL_ZERO_CODE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	while (end - ptr >= 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)ptr);
+		int zeroes = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero));
+		if (zeroes)
+		{
+#if LL_MSVC
+			unsigned long first;
+			_BitScanForward(&first, zeroes);
+			return (S32)(ptr - begin) + (S32)first;
+#else
+			return (S32)(ptr - begin) + __builtin_ctz(zeroes);
+#endif
+		}
+		ptr += 16;
+	}
+#endif
+	while (ptr < end && *ptr)
+	{
+		++ptr;
+	}
+	return (S32)(ptr - begin);
+}
+
+S32 zero_code_encode(const U8* in, S32 size, U8* out)
+{
+	const S32 header = llclamp(size, 0, (S32)LL_PACKET_ID_SIZE);
+	memcpy(out, in, header);
+
+	const U8* inptr = in + header;
+	const U8* end = in + size;
+	U8* outptr = out + header;
+	while (inptr < end)
+	{
+		// copy the run of non-zero bytes as is
+		S32 run = non_zero_run(inptr, end);
+		memcpy(outptr, inptr, run);
+		inptr += run;
+		outptr += run;
+
+		// replace the zeroes after it with their count, up to 255 at a time
+		const U8* zeroes = inptr;
+		while (inptr < end && !*inptr)
+		{
+			++inptr;
+		}
+		S32 count = (S32)(inptr - zeroes);
+		while (count > 0)
+		{
+			S32 chunk = llmin(count, 255);
+			*outptr++ = 0;
+			*outptr++ = (U8)chunk;
+			count -= chunk;
+		}
+	}
+	return (S32)(outptr - out);
+}
+
+S32 zero_code_expand(const U8* in, S32 size, U8* out, S32 out_size, S32& overflows)
+{
+	overflows = 0;
+	const S32 header = llclamp(size, 0, (S32)LL_PACKET_ID_SIZE);
+	memcpy(out, in, header);
+
+	const U8* inptr = in + header;
+	const U8* end = in + size;
+	S32 out_pos = header;
+	while (inptr < end)
+	{
+		// copy the run of non-zero bytes as is, the way the whole
+		// expansion ends if any of it does not fit
+		S32 run = non_zero_run(inptr, end);
+		if (out_pos + run > out_size)
+		{
+			overflows++;
+			return 0;
+		}
+		memcpy(out + out_pos, inptr, run);
+		inptr += run;
+		out_pos += run;
+		if (inptr == end)
+		{
+			break;
+		}
+
+		// a zero, more zeroes for 256 zeroes each, and the count
+		if (out_pos >= out_size)
+		{
+			overflows++;
+			return 0;
+		}
+		out[out_pos++] = *inptr++;
+		while (inptr < end && !*inptr)
+		{
+			if (out_pos + 1 > out_size - 256)
+			{
+				overflows++;
+				return 0;
+			}
+			out[out_pos++] = *inptr++;
+			memset(out + out_pos, 0, 255);
+			out_pos += 255;
+		}
+		if (inptr == end)
+		{
+			break;
+		}
+		if (out_pos > out_size - *inptr)
+		{
+			// restart at the beginning of the buffer
+			overflows++;
+			out_pos = 0;
+		}
+		memset(out + out_pos, 0, *inptr - 1);
+		out_pos += *inptr - 1;
+		inptr++;
+	}
+	return out_pos;
+}
+
+S32 zero_code_encode_scalar(const U8* in, S32 size, U8* out)
+{
+	S32 count = size;
+	U8 num_zeroes = 0;
+
+	const U8 *inptr = in;
+	U8 *outptr = out;
+
+// skip the packet id field
+
+	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE && count > 0; ++ii)
+	{
+		count--;
+		*outptr++ = *inptr++;
+	}
+
+// sequential zero bytes are encoded as 0 [U8 count]
+
+	while (count-- > 0)
+	{
+		if (!(*inptr))   // in a zero count
+		{
+			if (num_zeroes)
+			{
+				if (++num_zeroes > 254)
+				{
+					*outptr++ = num_zeroes;
+					num_zeroes = 0;
+				}
+			}
+			else
+			{
+				*outptr++ = 0;
+				num_zeroes = 1;
+			}
+			inptr++;
+		}
+		else
+		{
+			if (num_zeroes)
+			{
+				*outptr++ = num_zeroes;
+				num_zeroes = 0;
+			}
+			*outptr++ = *inptr++;
+		}
+	}
+
+	if (num_zeroes)
+	{
+		*outptr++ = num_zeroes;
+	}
+
+	return (S32)(outptr - out);
+}
+
+S32 zero_code_expand_scalar(const U8* in, S32 size, U8* out, S32 out_size, S32& overflows)
+{
+	overflows = 0;
+	S32 count = size;
+
+	const U8 *inptr = in;
+	U8 *outptr = out;
+
+// skip the packet id field
+
+	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE && count > 0; ++ii)
+	{
+		count--;
+		*outptr++ = *inptr++;
+	}
+
+// sequential zero bytes are encoded as 0 [U8 count]
+// with 0 0 [count] representing wrap (>256 zeroes)
+
+	while (count-- > 0)
+	{
+		if (outptr > (&out[out_size-1]))
+		{
+			overflows++;
+			outptr = out;
+			break;
+		}
+		if (!((*outptr++ = *inptr++)))
+		{
+			while (((count--)) && (!(*inptr)))
+			{
+				// checked before writing the zero, which may not fit
+				if (outptr + 1 > (&out[out_size-256]))
+				{
+					overflows++;
+					outptr = out;
+					count = -1;
+					break;
+				}
+				*outptr++ = *inptr++;
+				memset(outptr,0,255);
+				outptr += 255;
+			}
+
+			if (count < 0)
+			{
+				break;
+			}
+
+			else
+			{
+				if (outptr > (&out[out_size-(*inptr)]))
+				{
+					overflows++;
+					outptr = out;
+				}
+				memset(outptr,0,(*inptr) - 1);
+				outptr += ((*inptr) - 1);
+				inptr++;
+			}
+		}
+	}
+
+	return (S32)(outptr - out);
+}
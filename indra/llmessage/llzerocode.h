@@ -0,0 +1,59 @@
+/**
+ * @file llzerocode.h
+ * @brief Zero coding of message system packets
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLZEROCODE_H
+#define LL_LLZEROCODE_H
+
+// Zero coding replaces every run of zero bytes after the packet header
+// with a zero followed by the length of the run, runs of more than 255
+// zeroes being split. Expanding also accepts a zero followed by more
+// zeroes, each of which stands for 256 zeroes.
+//
+// Runs of non-zero bytes are found 16 bytes at a time when the whole build
+// uses SSE2, like the rest of the vectorized code (see llv4math.h).
+#if (LL_GNUC && defined(__SSE2__)) || (LL_MSVC && (_M_IX86_FP >= 2 || defined(_M_X64)))
+#define LL_ZERO_CODE_SSE2	1
+#else
+#define LL_ZERO_CODE_SSE2	0
+#endif
+
+// Encodes the size bytes of the packet at in into out, which must have
+// room for 2 * size bytes. Returns the size of the encoded packet, which
+// may be larger than size. Does not set LL_ZERO_CODE_FLAG.
+S32 zero_code_encode(const U8* in, S32 size, U8* out);
+
+// Expands the size bytes of the zero coded packet at in into the out_size
+// bytes at out. Returns the size of the expanded packet, 0 if it does not
+// fit. overflows is set to the number of times the expansion ran past the
+// end of out, where runs that do not fit restart at the beginning of out
+// like they always have.
+S32 zero_code_expand(const U8* in, S32 size, U8* out, S32 out_size, S32& overflows);
+
+// Byte at a time versions of the above, for testing
+S32 zero_code_encode_scalar(const U8* in, S32 size, U8* out);
+S32 zero_code_expand_scalar(const U8* in, S32 size, U8* out, S32 out_size, S32& overflows);
+
+#endif // LL_LLZEROCODE_H
@@ -79,6 +79,7 @@
 #include "v3dmath.h"
 #include "v3math.h"
 #include "v4math.h"
+#include "llzerocode.h"
 #include "lltransfertargetvfile.h"
 #include "llmemtype.h"
 
@@ -2891,72 +2892,18 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	
 	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	// sequential zero bytes are encoded as 0 [U8 count] 
+	// with 0 0 [count] representing wrap (>256 zeroes)
+	S32 overflows = 0;
+	S32 expanded_size = zero_code_expand(*data, *data_size, mEncodedRecvBuffer, MAX_BUFFER_SIZE, overflows);
+	if (overflows)
 	{
-		count--;
-		*outptr++ = *inptr++;
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << llendl;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
 	}
 
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << llendl;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << llendl;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << llendl;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
-	}
-	
 	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
+	*data_size = expanded_size;
 	mUncompressedBytesIn += *data_size;
 
 	return(in_size);
@@ -2970,6 +2917,7 @@ void LLMessageSystem::addTemplate(LLMessageTemplate *templatep)
 		LL_ERRS("Messaging") << templatep->mName << " already  used as a template name!"
 			<< llendl;
 	}
+	templatep->compileDecodeTable();
 	mMessageTemplates[templatep->mName] = templatep;
 	mMessageNumbers[templatep->mMessageNumber] = templatep;
 }
@@ -3959,6 +3907,149 @@ void LLMessageSystem::getString(const char *block, const char *var,
 				  blocknum);
 }
 
+LLMessageField::LLMessageField(const char* block, const char* variable) :
+	mBlockName(LLMessageStringTable::getInstance()->getString(block)),
+	mVariableName(LLMessageStringTable::getInstance()->getString(variable)),
+	mNextTemplate(0)
+{
+	for (S32 i = 0; i < CACHED_TEMPLATES; i++)
+	{
+		mTemplates[i] = NULL;
+		mBlocks[i] = -1;
+		mVariables[i] = -1;
+	}
+}
+
+void LLMessageField::getIndices(const LLMessageTemplate* templatep, S32& block, S32& variable)
+{
+	for (S32 i = 0; i < CACHED_TEMPLATES; i++)
+	{
+		if (mTemplates[i] == templatep)
+		{
+			block = mBlocks[i];
+			variable = mVariables[i];
+			return;
+		}
+	}
+
+	block = templatep->getBlockIndex(mBlockName);
+	variable = block >= 0 ? templatep->getVariableIndex(block, mVariableName) : -1;
+
+	mTemplates[mNextTemplate] = templatep;
+	mBlocks[mNextTemplate] = block;
+	mVariables[mNextTemplate] = variable;
+	mNextTemplate = (mNextTemplate + 1) % CACHED_TEMPLATES;
+}
+
+void LLMessageSystem::getBinaryData(LLMessageField& field, void *datap, S32 size, 
+									S32 blocknum, S32 max_size)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getBinaryData(field, datap, size, blocknum, max_size);
+	}
+	else
+	{
+		mMessageReader->getBinaryData(field.getBlockName(), field.getVariableName(), datap, size, blocknum, max_size);
+	}
+}
+
+void LLMessageSystem::getU8(LLMessageField& field, U8 &d, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getU8(field, d, blocknum);
+	}
+	else
+	{
+		mMessageReader->getU8(field.getBlockName(), field.getVariableName(), d, blocknum);
+	}
+}
+
+void LLMessageSystem::getU16(LLMessageField& field, U16 &d, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getU16(field, d, blocknum);
+	}
+	else
+	{
+		mMessageReader->getU16(field.getBlockName(), field.getVariableName(), d, blocknum);
+	}
+}
+
+void LLMessageSystem::getS32(LLMessageField& field, S32 &d, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getS32(field, d, blocknum);
+	}
+	else
+	{
+		mMessageReader->getS32(field.getBlockName(), field.getVariableName(), d, blocknum);
+	}
+}
+
+void LLMessageSystem::getU32(LLMessageField& field, U32 &d, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getU32(field, d, blocknum);
+	}
+	else
+	{
+		mMessageReader->getU32(field.getBlockName(), field.getVariableName(), d, blocknum);
+	}
+}
+
+void LLMessageSystem::getU64(LLMessageField& field, U64 &d, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getU64(field, d, blocknum);
+	}
+	else
+	{
+		mMessageReader->getU64(field.getBlockName(), field.getVariableName(), d, blocknum);
+	}
+}
+
+void LLMessageSystem::getF32(LLMessageField& field, F32 &d, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getF32(field, d, blocknum);
+	}
+	else
+	{
+		mMessageReader->getF32(field.getBlockName(), field.getVariableName(), d, blocknum);
+	}
+}
+
+void LLMessageSystem::getVector3(LLMessageField& field, LLVector3 &v, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getVector3(field, v, blocknum);
+	}
+	else
+	{
+		mMessageReader->getVector3(field.getBlockName(), field.getVariableName(), v, blocknum);
+	}
+}
+
+void LLMessageSystem::getUUID(LLMessageField& field, LLUUID &u, S32 blocknum)
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		mTemplateMessageReader->getUUID(field, u, blocknum);
+	}
+	else
+	{
+		mMessageReader->getUUID(field.getBlockName(), field.getVariableName(), u, blocknum);
+	}
+}
+
 BOOL	LLMessageSystem::has(const char *blockname) const
 {
 	return getNumberOfBlocks(blockname) > 0;
@@ -3999,6 +4090,15 @@ S32	LLMessageSystem::getSize(const char *blockname, S32 blocknum,
 					   LLMessageStringTable::getInstance()->getString(varname));
 }
 
+S32	LLMessageSystem::getSize(LLMessageField& field, S32 blocknum) const
+{
+	if (mMessageReader == mTemplateMessageReader)
+	{
+		return mTemplateMessageReader->getSize(field, blocknum);
+	}
+	return mMessageReader->getSize(field.getBlockName(), blocknum, field.getVariableName());
+}
+
 S32 LLMessageSystem::getReceiveSize() const
 {
 	return mMessageReader->getMessageSize();
@@ -193,6 +193,36 @@ class LLTemplateMessageReader;
 class LLSDMessageReader;
 
 
+// A variable of a message block, for handlers that read it from every
+// message they get. The names are looked up in the template of a message
+// once, after which the variable is read in constant time. Remembers the
+// indices for the last few templates, for handlers of several messages.
+// Use function static instances with prehashed names:
+//	static LLMessageField object_id(_PREHASH_ObjectData, _PREHASH_ID);
+//	msg->getU32(object_id, local_id, i);
+class LLMessageField
+{
+public:
+	LLMessageField(const char* block, const char* variable);
+
+	const char* getBlockName() const		{ return mBlockName; }
+	const char* getVariableName() const		{ return mVariableName; }
+
+	// Indices of the block and variable in the decode table of templatep,
+	// -1 if it has no such block or variable
+	void getIndices(const LLMessageTemplate* templatep, S32& block, S32& variable);
+
+private:
+	enum { CACHED_TEMPLATES = 4 };
+
+	const char*					mBlockName;
+	const char*					mVariableName;
+	const LLMessageTemplate*	mTemplates[CACHED_TEMPLATES];
+	S32							mBlocks[CACHED_TEMPLATES];
+	S32							mVariables[CACHED_TEMPLATES];
+	S32							mNextTemplate;
+};
+
 
 class LLUseCircuitCodeResponder
 {
@@ -560,6 +590,18 @@ public:
 	void getStringFast(	const char *block, const char *var, std::string& outstr, S32 blocknum = 0);
 	void	getString(	const char *block, const char *var, std::string& outstr, S32 blocknum = 0);
 
+	// Constant time versions of the above for hot handlers, see LLMessageField.
+	// Messages that did not come as templates are read by name.
+	void	getBinaryData(LLMessageField& field, void *datap, S32 size, S32 blocknum = 0, S32 max_size = S32_MAX);
+	void	getU8(		LLMessageField& field, U8 &data, S32 blocknum = 0);
+	void	getU16(		LLMessageField& field, U16 &data, S32 blocknum = 0);
+	void	getS32(		LLMessageField& field, S32 &data, S32 blocknum = 0);
+	void	getU32(		LLMessageField& field, U32 &data, S32 blocknum = 0);
+	void	getU64(		LLMessageField& field, U64 &data, S32 blocknum = 0);
+	void	getF32(		LLMessageField& field, F32 &data, S32 blocknum = 0);
+	void	getVector3(	LLMessageField& field, LLVector3 &vec, S32 blocknum = 0);
+	void	getUUID(	LLMessageField& field, LLUUID &uuid, S32 blocknum = 0);
+
 
 	// Utility functions to generate a replay-resistant digest check
 	// against the shared secret. The window specifies how much of a
@@ -655,6 +697,7 @@ public:
 	S32		getSizeFast(const char *blockname, S32 blocknum, 
 						const char *varname) const; // size in bytes of data
 	S32		getSize(const char *blockname, S32 blocknum, const char *varname) const;
+	S32		getSize(LLMessageField& field, S32 blocknum) const;
 
 	void	resetReceiveCounts();				// resets receive counts for all message types to 0
 	void	dumpReceiveCounts();				// dumps receive count for each message type to llinfos
@@ -526,12 +526,32 @@ void end_net(S32& socket_out)
 }
 
 #if LL_LINUX
+// Reads the address the datagram of msg was sent to from its IP_PKTINFO
+static void get_destip( struct msghdr *msg, U32 *dstip )
+{
+	struct cmsghdr *cmsgptr;
+
+	for( cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR( msg, cmsgptr ) )
+	{
+		if( cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO )
+		{
+			in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
+			if( pktinfo )
+			{
+				// Two choices. routed and specified. ipi_addr is routed, ipi_spec_dst is
+				// routed. We should stay with specified until we go to multiple
+				// interfaces
+				*dstip = pktinfo->ipi_spec_dst.s_addr;
+			}
+		}
+	}
+}
+
 static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *from, socklen_t *fromlen, U32 *dstip )
 {
 	int size;
 	struct iovec iov[1];
 	char cmsg[CMSG_SPACE(sizeof(struct in_pktinfo))];
-	struct cmsghdr *cmsgptr;
 	struct msghdr msg = {0};
 
 	iov[0].iov_base = buf;
@@ -552,20 +572,7 @@ static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *fro
 		return -1;
 	}
 
-	for( cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR( &msg, cmsgptr ) )
-	{
-		if( cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO )
-		{
-			in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
-			if( pktinfo )
-			{
-				// Two choices. routed and specified. ipi_addr is routed, ipi_spec_dst is
-				// routed. We should stay with specified until we go to multiple
-				// interfaces
-				*dstip = pktinfo->ipi_spec_dst.s_addr;
-			}
-		}
-	}
+	get_destip( &msg, dstip );
 
 	return size;
 }
@@ -663,4 +670,96 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 
 #endif
 
+// Receives the packets one receive_packet() at a time
+static S32 receive_packets_singly(int hSocket, char* buffers, S32* sizes, LLHost* senders, LLHost* receiving_ifs, S32 max_packets)
+{
+	S32 count = 0;
+	while (count < max_packets)
+	{
+		S32 size = receive_packet(hSocket, buffers + count * NET_BUFFER_SIZE);
+		if (!size)
+		{
+			break;
+		}
+		sizes[count] = size;
+		senders[count] = get_sender();
+		receiving_ifs[count] = get_receiving_interface();
+		count++;
+	}
+	return count;
+}
+
+#if LL_LINUX && defined(MSG_WAITFORONE)
+S32 receive_packets(int hSocket, char* buffers, S32* sizes, LLHost* senders, LLHost* receiving_ifs, S32 max_packets)
+{
+	// Kernels before 2.6.33 do not have recvmmsg()
+	static bool have_recvmmsg = true;
+	if (!have_recvmmsg)
+	{
+		return receive_packets_singly(hSocket, buffers, sizes, senders, receiving_ifs, max_packets);
+	}
+
+	const S32 MAX_PACKETS_PER_CALL = 64;
+	struct mmsghdr msgs[MAX_PACKETS_PER_CALL];
+	struct iovec iovs[MAX_PACKETS_PER_CALL];
+	struct sockaddr_in from[MAX_PACKETS_PER_CALL];
+	char cmsgs[MAX_PACKETS_PER_CALL][CMSG_SPACE(sizeof(struct in_pktinfo))];
+
+	S32 count = 0;
+	while (count < max_packets)
+	{
+		const S32 wanted = llmin(max_packets - count, MAX_PACKETS_PER_CALL);
+		memset(msgs, 0, wanted * sizeof(msgs[0]));
+		for (S32 i = 0; i < wanted; i++)
+		{
+			iovs[i].iov_base = buffers + (count + i) * NET_BUFFER_SIZE;
+			iovs[i].iov_len = NET_BUFFER_SIZE;
+			msgs[i].msg_hdr.msg_name = &from[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_control = cmsgs[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof(cmsgs[i]);
+		}
+
+		int received = recvmmsg(hSocket, msgs, wanted, 0, NULL);
+		if (received == -1)
+		{
+			if (errno == ENOSYS)
+			{
+				llinfos << "No recvmmsg(), receiving one packet at a time" << llendl;
+				have_recvmmsg = false;
+				count += receive_packets_singly(hSocket, buffers + count * NET_BUFFER_SIZE, sizes + count,
+												senders + count, receiving_ifs + count, max_packets - count);
+			}
+			// else EAGAIN, nothing more to receive
+			break;
+		}
+
+		for (S32 i = 0; i < received; i++)
+		{
+			gsnReceivingIFAddr = INVALID_HOST_IP_ADDRESS;
+			get_destip(&msgs[i].msg_hdr, &gsnReceivingIFAddr);
+			stSrcAddr = from[i];
+			sizes[count + i] = msgs[i].msg_len;
+			senders[count + i] = get_sender();
+			receiving_ifs[count + i] = get_receiving_interface();
+		}
+		count += received;
+
+		if (received < wanted)
+		{
+			// the socket is empty
+			break;
+		}
+	}
+	return count;
+}
+#else
+S32 receive_packets(int hSocket, char* buffers, S32* sizes, LLHost* senders, LLHost* receiving_ifs, S32 max_packets)
+{
+	return receive_packets_singly(hSocket, buffers, sizes, senders, receiving_ifs, max_packets);
+}
+#endif
+
 //EOF
@@ -43,6 +43,11 @@ void	end_net(S32& socket_out);
 // returns size of packet or -1 in case of error
 S32		receive_packet(int hSocket, char * receiveBuffer);
 
+// Receives up to max_packets packets, each into its own NET_BUFFER_SIZE bytes of buffers,
+// with their sizes, senders and receiving interfaces. Returns the number of packets received,
+// zero if none was waiting. Uses one system call for the lot where the platform has recvmmsg().
+S32		receive_packets(int hSocket, char* buffers, S32* sizes, LLHost* senders, LLHost* receiving_ifs, S32 max_packets);
+
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
 //void	get_sender(char * tmp);
@@ -0,0 +1,338 @@
+/**
+ * @file llcircuit_test.cpp
+ * @brief Reliable packet bookkeeping test cases of llcircuit.cpp
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#if !LL_WINDOWS
+#include <netinet/in.h>
+#else
+#include "winsock2.h"
+#endif
+
+#include "../llcircuit.h"
+#include "../llpacketack.h"
+#include "../message.h"
+#include "../lltransfermanager.h"
+
+#include "../test/lltut.h"
+
+#include <vector>
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Only the counters and mVerboseLog of the message system are used by the
+// reliable packet bookkeeping: they live in zeroed storage, the constructor
+// of LLMessageSystem needs all of it.
+
+namespace
+{
+	U64 sMessageSystemStorage[sizeof(LLMessageSystem) / sizeof(U64) + 1];
+
+	// Packet ids passed to LLPacketRing::sendPacket(), in order
+	std::vector<TPACKETID> sSentPackets;
+	bool sResentFlag = true;
+	// Returned by LLThrottleGroup::checkOverflow()
+	BOOL sThrottleOverflow = FALSE;
+}
+
+LLMessageSystem* gMessageSystem = reinterpret_cast<LLMessageSystem*>(sMessageSystemStorage);
+LLTransferManager gTransferManager;
+
+LLTransferManager::LLTransferManager() { }
+LLTransferManager::~LLTransferManager() { }
+void LLTransferManager::cleanupConnection(const LLHost& host) { }
+
+LLHost& LLHost::operator=(const LLHost& rhs)
+{
+	mIP = rhs.mIP;
+	mPort = rhs.mPort;
+	return *this;
+}
+std::string LLHost::getIPandPort() const { return std::string(); }
+std::ostream& operator<<(std::ostream& os, const LLHost& host) { return os; }
+
+LLThrottleGroup::LLThrottleGroup() { }
+BOOL LLThrottleGroup::checkOverflow(S32 throttle_cat, F32 bits) { return sThrottleOverflow; }
+BOOL LLThrottleGroup::throttleOverflow(S32 throttle_cat, F32 bits) { return FALSE; }
+BOOL LLThrottleGroup::dynamicAdjust() { return FALSE; }
+
+BOOL LLPacketRing::sendPacket(int h_socket, char* send_buffer, S32 buf_size, LLHost host)
+{
+	sSentPackets.push_back(ntohl(*((U32*)(&send_buffer[PHL_PACKET_ID]))));
+	sResentFlag = sResentFlag && (send_buffer[0] & LL_RESENT_FLAG);
+	return TRUE;
+}
+
+U64 LLMessageSystem::getMessageTimeUsecs(const BOOL update) { return totalTime(); }
+F64 LLMessageSystem::getMessageTimeSeconds(const BOOL update) { return (F64)totalTime() / 1000000.0; }
+void LLMessageSystem::newMessageFast(const char* name) { }
+void LLMessageSystem::nextBlockFast(const char* blockname) { }
+void LLMessageSystem::nextBlock(const char* blockname) { }
+void LLMessageSystem::addU8Fast(const char* varname, U8 u) { }
+void LLMessageSystem::addU32Fast(const char* varname, U32 u) { }
+S32 LLMessageSystem::sendMessage(const LLHost& host) { return 0; }
+
+char* _PREHASH_ID = NULL;
+char* _PREHASH_OldestUnacked = NULL;
+char* _PREHASH_PacketAck = NULL;
+char* _PREHASH_Packets = NULL;
+char* _PREHASH_PingID = NULL;
+char* _PREHASH_StartPingCheck = NULL;
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// Sends reliable packets without a message system
+	class LLTestCircuitData : public LLCircuitData
+	{
+	public:
+		LLTestCircuitData() : LLCircuitData(LLHost(), 0, 5.f, 100.f) { }
+		using LLCircuitData::addReliablePacket;
+	};
+}
+
+namespace tut
+{
+	struct circuit_data
+	{
+		enum { NO_RESULT = 1, MAX_PACKETS = 5000 };
+
+		LLTestCircuitData* mCircuit;
+		std::vector<S32> mResults; // last callback result of each packet, never reallocated
+		std::vector<U8> mBuffer;
+
+		circuit_data()
+		{
+			memset(sMessageSystemStorage, 0, sizeof(sMessageSystemStorage));
+			sSentPackets.clear();
+			sResentFlag = true;
+			sThrottleOverflow = FALSE;
+			mResults.reserve(MAX_PACKETS);
+			mCircuit = new LLTestCircuitData();
+		}
+		~circuit_data()
+		{
+			delete mCircuit;
+		}
+
+		static void callback(void** data, S32 result)
+		{
+			*reinterpret_cast<S32*>(data) = result;
+		}
+
+		// Sends a reliable packet of size bytes, resent retries times every
+		// timeout seconds. Its callback result goes to mResults[index].
+		void send(TPACKETID packet_id, U32 index, S32 retries, F32 timeout, S32 size = 64)
+		{
+			if (mResults.size() <= index)
+			{
+				mResults.resize(index + 1, (S32)NO_RESULT);
+			}
+			mBuffer.assign(size, 0);
+			*((U32*)(&mBuffer[PHL_PACKET_ID])) = htonl(packet_id);
+			LLReliablePacketParams params;
+			params.set(LLHost(), retries, FALSE, timeout, &callback, (void**)&mResults[index], NULL);
+			mCircuit->addReliablePacket(0, &mBuffer[0], size, &params);
+		}
+
+		F64 now()
+		{
+			return (F64)totalTime() / 1000000.0;
+		}
+	};
+	typedef test_group<circuit_data> circuit_t;
+	typedef circuit_t::object circuit_object_t;
+	tut::circuit_t tut_circuit("LLCircuit");
+
+	// Acks find their packet among many, across a packet id wrap, duplicate
+	// and unknown acks are ignored
+	template<> template<>
+	void circuit_object_t::test<1>()
+	{
+		const U32 NUM_PACKETS = MAX_PACKETS;
+		const TPACKETID first_id = LL_MAX_OUT_PACKET_ID - NUM_PACKETS / 2;
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			send((first_id + i) % LL_MAX_OUT_PACKET_ID, i, 3, 100.f);
+		}
+		ensure_equals("all unacked", mCircuit->getUnackedPacketCount(), (S32)NUM_PACKETS);
+		ensure_equals("unacked bytes", mCircuit->getUnackedPacketBytes(), (S32)NUM_PACKETS * 64);
+
+		// Every third one, from both ends, to mix up the hash index
+		for (U32 i = 0; i < NUM_PACKETS; i += 3)
+		{
+			U32 index = (i % 2) ? i : NUM_PACKETS - 1 - i;
+			mCircuit->ackReliablePacket((first_id + index) % LL_MAX_OUT_PACKET_ID);
+		}
+		S32 acked = 0;
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			if (mResults[i] == LL_ERR_NOERR)
+			{
+				acked++;
+			}
+			else
+			{
+				ensure_equals("not acked yet", mResults[i], (S32)NO_RESULT);
+			}
+		}
+		ensure_equals("acked", acked, (S32)(NUM_PACKETS + 2) / 3);
+		ensure_equals("unacked", mCircuit->getUnackedPacketCount(), (S32)NUM_PACKETS - acked);
+
+		// Duplicate and unknown acks
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			mResults[i] = NO_RESULT;
+		}
+		for (U32 i = 0; i < NUM_PACKETS; i += 3)
+		{
+			U32 index = (i % 2) ? i : NUM_PACKETS - 1 - i;
+			mCircuit->ackReliablePacket((first_id + index) % LL_MAX_OUT_PACKET_ID);
+		}
+		mCircuit->ackReliablePacket(first_id - 1);
+		mCircuit->ackReliablePacket(first_id + NUM_PACKETS);
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			ensure_equals("no callback", mResults[i], (S32)NO_RESULT);
+		}
+		ensure_equals("still unacked", mCircuit->getUnackedPacketCount(), (S32)NUM_PACKETS - acked);
+
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			mCircuit->ackReliablePacket((first_id + i) % LL_MAX_OUT_PACKET_ID);
+		}
+		ensure_equals("none unacked", mCircuit->getUnackedPacketCount(), 0);
+		ensure_equals("no unacked bytes", mCircuit->getUnackedPacketBytes(), 0);
+		ensure("no resend", sSentPackets.empty());
+	}
+
+	// Expired packets are resent oldest first across a packet id wrap, move
+	// to the final retry list on their last retry, can be acked there, and
+	// time out
+	template<> template<>
+	void circuit_object_t::test<2>()
+	{
+		const TPACKETID first_id = LL_MAX_OUT_PACKET_ID - 3;
+		for (U32 i = 0; i < 6; i++)
+		{
+			// Packets 0, 2 and 4 have one retry left, 1, 3 and 5 two
+			send((first_id + i) % LL_MAX_OUT_PACKET_ID, i, 1 + i % 2, 1.f);
+		}
+		// Never resent, only times out
+		send(100, 6, 0, 3.f);
+
+		F64 t = now() + 2.0;
+		ensure_equals("unacked", mCircuit->resendUnackedPackets(t), 7);
+		ensure_equals("all resent", sSentPackets.size(), (size_t)6);
+		for (U32 i = 0; i < 6; i++)
+		{
+			ensure_equals("resent in send order", sSentPackets[i], (first_id + i) % LL_MAX_OUT_PACKET_ID);
+		}
+		ensure("flagged as resent", sResentFlag);
+
+		// Acks find packets in both lists
+		mCircuit->ackReliablePacket(first_id);					// final retry
+		mCircuit->ackReliablePacket(first_id + 1);				// unacked
+		ensure_equals("acked on final retry", mResults[0], LL_ERR_NOERR);
+		ensure_equals("acked", mResults[1], LL_ERR_NOERR);
+
+		// Not expired yet
+		sSentPackets.clear();
+		ensure_equals("nothing expired", mCircuit->resendUnackedPackets(t + 0.5), 5);
+		ensure("nothing resent", sSentPackets.empty());
+
+		// 2, 4 and 6 time out, 3 and 5 get their last retry
+		t += 1.5;
+		ensure_equals("timed out", mCircuit->resendUnackedPackets(t), 2);
+		ensure_equals("last retries", sSentPackets.size(), (size_t)2);
+		ensure_equals("last retry 3", sSentPackets[0], (first_id + 3) % LL_MAX_OUT_PACKET_ID);
+		ensure_equals("last retry 5", sSentPackets[1], (first_id + 5) % LL_MAX_OUT_PACKET_ID);
+		ensure_equals("2 timed out", mResults[2], LL_ERR_TCP_TIMEOUT);
+		ensure_equals("4 timed out", mResults[4], LL_ERR_TCP_TIMEOUT);
+		ensure_equals("never resent packet timed out", mResults[6], LL_ERR_TCP_TIMEOUT);
+		ensure_equals("3 waiting", mResults[3], (S32)NO_RESULT);
+
+		mCircuit->ackReliablePacket(first_id + 2);				// gone already
+		ensure_equals("late ack ignored", mResults[2], LL_ERR_TCP_TIMEOUT);
+
+		t += 1.5;
+		ensure_equals("all timed out", mCircuit->resendUnackedPackets(t), 0);
+		ensure_equals("3 timed out", mResults[3], LL_ERR_TCP_TIMEOUT);
+		ensure_equals("5 timed out", mResults[5], LL_ERR_TCP_TIMEOUT);
+		ensure_equals("no unacked bytes", mCircuit->getUnackedPacketBytes(), 0);
+	}
+
+	// With the resend throttle full and too many bytes unacked, expired
+	// packets are dropped without being resent, the others are kept
+	template<> template<>
+	void circuit_object_t::test<3>()
+	{
+		const U32 NUM_PACKETS = 600;
+		const S32 PACKET_SIZE = 1000;
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			send(i, i, 3, (i % 2) ? 100.f : 1.f, PACKET_SIZE);
+		}
+		ensure("over the unacked limit", mCircuit->getUnackedPacketBytes() > 512000);
+
+		sThrottleOverflow = TRUE;
+		ensure_equals("expired dropped", mCircuit->resendUnackedPackets(now() + 10.0), (S32)NUM_PACKETS / 2);
+		ensure("nothing resent", sSentPackets.empty());
+		for (U32 i = 0; i < NUM_PACKETS; i++)
+		{
+			ensure_equals("timed out or waiting", mResults[i], (i % 2) ? (S32)NO_RESULT : LL_ERR_TCP_TIMEOUT);
+		}
+		ensure_equals("unacked bytes", mCircuit->getUnackedPacketBytes(), (S32)(NUM_PACKETS / 2) * PACKET_SIZE);
+
+		// Under the limit now: the throttle only stops the resends
+		ensure_equals("kept", mCircuit->resendUnackedPackets(now() + 200.0), (S32)NUM_PACKETS / 2);
+		ensure("still nothing resent", sSentPackets.empty());
+
+		sThrottleOverflow = FALSE;
+		for (U32 i = 1; i < NUM_PACKETS; i += 2)
+		{
+			mCircuit->ackReliablePacket(i);
+			ensure_equals("acked", mResults[i], LL_ERR_NOERR);
+		}
+		ensure_equals("all acked", mCircuit->getUnackedPacketCount(), 0);
+	}
+
+	// Packets still unacked when the circuit goes away get their callback
+	template<> template<>
+	void circuit_object_t::test<4>()
+	{
+		send(1, 0, 3, 1.f);
+		send(2, 1, 0, 1.f);
+		mCircuit->ackReliablePacket(1);
+		delete mCircuit;
+		mCircuit = NULL;
+		ensure_equals("acked", mResults[0], LL_ERR_NOERR);
+		ensure_equals("circuit gone", mResults[1], LL_ERR_CIRCUIT_GONE);
+		ensure_equals("failed resends", gMessageSystem->mFailedResendPackets, (U32)1);
+	}
+}
@@ -0,0 +1,274 @@
+/**
+ * @file lltexturehttpclient_test.cpp
+ * @brief Tests and loopback benchmark for LLTextureHttpClient
+ *
+ * Runs through test_lltexturehttpclient_peer.py, which serves the textures.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltexturehttpclient.h"
+
+#include "llhttpstatuscodes.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <iostream>
+
+namespace
+{
+	// What test_lltexturehttpclient_peer.py serves for a texture
+	const S32 TEXTURE_SIZE = 20000;
+	U8 texture_byte(S32 i) { return (U8)(i % 251); }
+
+	struct Results
+	{
+		Results() : mCompleted(0), mBadData(0) {}
+		S32 mCompleted;
+		S32 mBadData;
+		std::map<U32, S32> mStatusCount;
+	};
+
+	class TextureResponder : public LLCurl::Responder
+	{
+	public:
+		TextureResponder(Results* results, S32 offset) : mResults(results), mOffset(offset) {}
+
+		virtual void completedRaw(U32 status, const std::string& reason,
+								  const LLChannelDescriptors& channels,
+								  const LLIOPipe::buffer_ptr_t& buffer)
+		{
+			mResults->mCompleted++;
+			mResults->mStatusCount[status]++;
+			if (!isGoodStatus(status))
+			{
+				return;
+			}
+			S32 size = buffer->count(channels.in());
+			std::vector<U8> data(llmax(size, 1));
+			buffer->readAfter(channels.in(), NULL, &data[0], size);
+			for (S32 i = 0; i < size; i++)
+			{
+				if (data[i] != texture_byte(mOffset + i))
+				{
+					mResults->mBadData++;
+					break;
+				}
+			}
+		}
+
+	private:
+		Results* mResults;
+		S32 mOffset;
+	};
+
+	std::string texture_url(const std::string& texture_id)
+	{
+		const char* port = getenv("LL_TEXTURE_HTTP_PORT");	/* Flawfinder: ignore */
+		return llformat("http://127.0.0.1:%s/?texture_id=%s", port ? port : "0", texture_id.c_str());
+	}
+
+	LLTextureHttpClient::headers_t texture_headers()
+	{
+		LLTextureHttpClient::headers_t headers;
+		headers.push_back("Accept: image/x-j2c");
+		return headers;
+	}
+
+	// Processes the requests until they are all done, at most timeout seconds
+	template <class CLIENT>
+	void wait_for(CLIENT& client, Results& results, S32 count, F32 timeout = 60.f)
+	{
+		LLTimer timer;
+		while (results.mCompleted < count && timer.getElapsedTimeF32() < timeout)
+		{
+			client.process();
+			ms_sleep(1);
+		}
+	}
+}
+
+namespace tut
+{
+	struct texturehttpclient_test
+	{
+		texturehttpclient_test()
+		{
+			static bool curl_initialized = false;
+			if (!curl_initialized)
+			{
+				curl_global_init(CURL_GLOBAL_ALL);
+				curl_initialized = true;
+			}
+		}
+	};
+	typedef test_group<texturehttpclient_test> texturehttpclient_t;
+	typedef texturehttpclient_t::object texturehttpclient_object_t;
+	tut::texturehttpclient_t tut_texturehttpclient("LLTextureHttpClient");
+
+	// Range requests come back complete and in one piece, over few connections
+	template<> template<>
+	void texturehttpclient_object_t::test<1>()
+	{
+		ensure("LL_TEXTURE_HTTP_PORT set, run through test_lltexturehttpclient_peer.py", getenv("LL_TEXTURE_HTTP_PORT") != NULL);
+
+		const S32 COUNT = 100;
+		const S32 FIRST_PACKET = 600;
+		const S32 MAX_REQUESTS = 16;
+		LLTextureHttpClient client;
+		client.setMaxHostRequests(MAX_REQUESTS);
+		client.setMaxHostConnections(4);
+		Results results;
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			std::string id = llformat("%d", i);
+			// header packet then the rest, like the fetcher does
+			ensure("first request queued", client.getByteRange(texture_url(id), texture_headers(), 0, FIRST_PACKET,
+															   new TextureResponder(&results, 0)));
+			ensure("second request queued", client.getByteRange(texture_url(id), texture_headers(), FIRST_PACKET, TEXTURE_SIZE - FIRST_PACKET,
+																new TextureResponder(&results, FIRST_PACKET)));
+		}
+		ensure("limit holds requests back", client.getNumActive() <= client.getRequestLimit());
+		wait_for(client, results, COUNT * 2);
+
+		ensure_equals("all completed", results.mCompleted, COUNT * 2);
+		ensure_equals("all partial content", results.mStatusCount[HTTP_PARTIAL_CONTENT], COUNT * 2);
+		ensure_equals("data intact", results.mBadData, 0);
+		ensure_equals("nothing left", client.getQueued(), 0);
+		ensure("connections reused", client.getNumConnects() <= MAX_REQUESTS);
+		ensure("round trip measured", client.getAverageRTT() > 0.f);
+	}
+
+	// Errors reach the responder, 503 backs off
+	template<> template<>
+	void texturehttpclient_object_t::test<2>()
+	{
+		LLTextureHttpClient client;
+		Results results;
+		ensure("missing queued", client.getByteRange(texture_url("missing"), texture_headers(), 0, 600, new TextureResponder(&results, 0)));
+		wait_for(client, results, 1);
+		ensure_equals("404", results.mStatusCount[HTTP_NOT_FOUND], 1);
+		ensure_equals("404 does not change the limit", client.getRequestLimit(), LLTextureHttpClient::INITIAL_HOST_REQUESTS);
+
+		ensure("busy queued", client.getByteRange(texture_url("busy"), texture_headers(), 0, 600, new TextureResponder(&results, 0)));
+		wait_for(client, results, 2);
+		ensure_equals("503", results.mStatusCount[HTTP_SERVICE_UNAVAILABLE], 1);
+		ensure_equals("503 halves the limit", client.getRequestLimit(), LLTextureHttpClient::INITIAL_HOST_REQUESTS / 2);
+
+		ensure("unreachable queued", client.getByteRange("http://127.0.0.1:1/?texture_id=0", texture_headers(), 0, 600, new TextureResponder(&results, 0)));
+		wait_for(client, results, 3);
+		ensure_equals("connection failure", results.mStatusCount[499], 1);
+	}
+
+	// Hosts left idle are dropped with their connections, and come back on the next request
+	template<> template<>
+	void texturehttpclient_object_t::test<4>()
+	{
+		LLTextureHttpClient client;
+		client.setHostIdleTimeout(0.2f);
+		Results results;
+		ensure("first queued", client.getByteRange(texture_url("0"), texture_headers(), 0, 600, new TextureResponder(&results, 0)));
+		ensure_equals("host added", client.getNumHosts(), 1);
+		wait_for(client, results, 1);
+		ensure_equals("first partial content", results.mStatusCount[HTTP_PARTIAL_CONTENT], 1);
+		client.process();
+		ensure_equals("host kept while recently used", client.getNumHosts(), 1);
+
+		ms_sleep(300);
+		client.process();
+		ensure_equals("idle host dropped", client.getNumHosts(), 0);
+
+		ensure("second queued", client.getByteRange(texture_url("1"), texture_headers(), 0, 600, new TextureResponder(&results, 0)));
+		ensure_equals("host added again", client.getNumHosts(), 1);
+		wait_for(client, results, 2);
+		ensure_equals("second partial content", results.mStatusCount[HTTP_PARTIAL_CONTENT], 2);
+	}
+
+	// Benchmark: a region worth of small textures, the fetcher's first
+	// packet of each, through LLCurlRequest with the fetcher's former fixed
+	// cap of 32 requests and through LLTextureHttpClient with its adaptive
+	// limit. The latency of the server is LL_TEXTURE_HTTP_LATENCY_MS.
+	template<> template<>
+	void texturehttpclient_object_t::test<3>()
+	{
+		const S32 COUNT = 1000;
+		const S32 FIRST_PACKET = 600;
+		F64 curl_request_time;
+		F64 texture_client_time;
+		{
+			const S32 MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE = 32;
+			LLCurlRequest request;
+			Results results;
+			LLTimer timer;
+			S32 sent = 0;
+			while (results.mCompleted < COUNT && timer.getElapsedTimeF32() < 120.f)
+			{
+				while (sent < COUNT && sent - results.mCompleted < MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE)
+				{
+					request.getByteRange(texture_url(llformat("%d", sent)), texture_headers(), 0, FIRST_PACKET,
+										 new TextureResponder(&results, 0));
+					sent++;
+				}
+				request.process();
+				ms_sleep(1);
+			}
+			curl_request_time = llmax(timer.getElapsedTimeF64(), 0.000001);
+			ensure_equals("LLCurlRequest completed", results.mCompleted, COUNT);
+			ensure_equals("LLCurlRequest data intact", results.mBadData, 0);
+		}
+		S32 connects;
+		S32 final_limit;
+		F32 rtt;
+		{
+			LLTextureHttpClient client;
+			Results results;
+			LLTimer timer;
+			S32 sent = 0;
+			while (results.mCompleted < COUNT && timer.getElapsedTimeF32() < 120.f)
+			{
+				// the fetcher keeps twice the limit handed to the client
+				while (sent < COUNT && sent - results.mCompleted < 2 * client.getRequestLimit())
+				{
+					client.getByteRange(texture_url(llformat("%d", sent)), texture_headers(), 0, FIRST_PACKET,
+										new TextureResponder(&results, 0));
+					sent++;
+				}
+				client.process();
+				ms_sleep(1);
+			}
+			texture_client_time = llmax(timer.getElapsedTimeF64(), 0.000001);
+			ensure_equals("LLTextureHttpClient completed", results.mCompleted, COUNT);
+			ensure_equals("LLTextureHttpClient data intact", results.mBadData, 0);
+			connects = client.getNumConnects();
+			final_limit = client.getRequestLimit();
+			rtt = client.getAverageRTT();
+		}
+
+		std::cout << "LLCurlRequest " << (S32)(COUNT / curl_request_time) << " textures/s, "
+				  << "LLTextureHttpClient " << (S32)(COUNT / texture_client_time) << " textures/s ("
+				  << connects << " connections, request limit " << final_limit
+				  << ", time to first byte " << (S32)(rtt * 1000.f) << " ms)" << std::endl;
+	}
+}
@@ -0,0 +1,155 @@
+/**
+ * @file llzerocode_test.cpp
+ * @brief Zero coding test cases.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llzerocode.h"
+#include "../llcircuit.h"
+#include "../net.h"
+
+#include "../test/lltestrand.h"
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace tut
+{
+	struct zerocode_data
+	{
+		// A packet of the given size in which about one byte in
+		// zero_odds is the start of a run of up to max_run zeroes
+		std::vector<U8> makePacket(S32 size, U32 zero_odds, U32 max_run)
+		{
+			std::vector<U8> packet(size);
+			for (S32 i = 0; i < size; )
+			{
+				if (!mRand.rand(zero_odds))
+				{
+					S32 run = llmin((S32)mRand.rand(max_run) + 1, size - i);
+					memset(&packet[i], 0, run);
+					i += run;
+				}
+				else
+				{
+					packet[i++] = (U8)(mRand.rand(255) + 1);
+				}
+			}
+			return packet;
+		}
+
+		// Encodes, compares with the scalar encoding, expands and compares
+		// with the packet
+		void ensureRoundTrip(const std::string& msg, const std::vector<U8>& packet)
+		{
+			const S32 size = (S32)packet.size();
+			std::vector<U8> encoded(2 * size + 1);
+			std::vector<U8> scalar_encoded(2 * size + 1);
+			S32 encoded_size = zero_code_encode(&packet[0], size, &encoded[0]);
+			S32 scalar_encoded_size = zero_code_encode_scalar(&packet[0], size, &scalar_encoded[0]);
+			ensure_equals(msg + " encoded size", encoded_size, scalar_encoded_size);
+			ensure(msg + " encoded", !memcmp(&encoded[0], &scalar_encoded[0], encoded_size));
+
+			U8 expanded[NET_BUFFER_SIZE];
+			S32 overflows = -1;
+			S32 expanded_size = zero_code_expand(&encoded[0], encoded_size, expanded, NET_BUFFER_SIZE, overflows);
+			ensure_equals(msg + " overflows", overflows, 0);
+			ensure_equals(msg + " expanded size", expanded_size, size);
+			ensure(msg + " expanded", !memcmp(expanded, &packet[0], size));
+		}
+
+		// Expands in with both versions and compares the results
+		void ensureSameExpansion(const std::string& msg, const std::vector<U8>& in, S32 out_size)
+		{
+			std::vector<U8> out(out_size, 0xaa);
+			std::vector<U8> scalar_out(out_size, 0xaa);
+			S32 overflows = -1;
+			S32 scalar_overflows = -1;
+			S32 size = zero_code_expand(&in[0], (S32)in.size(), &out[0], out_size, overflows);
+			S32 scalar_size = zero_code_expand_scalar(&in[0], (S32)in.size(), &scalar_out[0], out_size, scalar_overflows);
+			ensure_equals(msg + " size", size, scalar_size);
+			ensure_equals(msg + " overflows", overflows, scalar_overflows);
+			ensure(msg + " data", !memcmp(&out[0], &scalar_out[0], size));
+		}
+
+		LLTestRand mRand;
+	};
+	typedef test_group<zerocode_data> zerocode_test;
+	typedef zerocode_test::object zerocode_object;
+	tut::zerocode_test zerocode_testcase("LLZeroCode");
+
+	template<> template<>
+	void zerocode_object::test<1>()
+	{
+		// header, 3 zeroes, 2 bytes, trailing zero
+		const U8 packet[] = { 0x40, 0, 0, 0, 1, 0, 0, 0, 0, 7, 8, 0 };
+		const U8 encoded[] = { 0x40, 0, 0, 0, 1, 0, 0, 3, 7, 8, 0, 1 };
+		U8 out[NET_BUFFER_SIZE];
+		ensure_equals("encoded size", zero_code_encode(packet, sizeof(packet), out), (S32)sizeof(encoded));
+		ensure("encoded", !memcmp(out, encoded, sizeof(encoded)));
+
+		S32 overflows;
+		ensure_equals("expanded size", zero_code_expand(encoded, sizeof(encoded), out, NET_BUFFER_SIZE, overflows), (S32)sizeof(packet));
+		ensure("expanded", !memcmp(out, packet, sizeof(packet)));
+
+		// a zero followed by zeroes stands for 256 zeroes each
+		const U8 wrapped[] = { 0x40, 0, 0, 0, 1, 0, 9, 0, 0, 2, 9 };
+		ensure_equals("wrapped size", zero_code_expand(wrapped, sizeof(wrapped), out, NET_BUFFER_SIZE, overflows), 6 + 1 + 258 + 1);
+		ensure_equals("wrapped zeroes", out[6 + 1 + 257], 0);
+		ensure_equals("wrapped end", out[6 + 1 + 258], 9);
+	}
+
+	template<> template<>
+	void zerocode_object::test<2>()
+	{
+		// object updates: mostly short runs of zeroes
+		for (S32 i = 0; i < 500; i++)
+		{
+			ensureRoundTrip("short runs", makePacket(mRand.rand(MTUBYTES) + LL_PACKET_ID_SIZE, 8, 12));
+		}
+		// long runs, split at 255 zeroes
+		for (S32 i = 0; i < 200; i++)
+		{
+			ensureRoundTrip("long runs", makePacket(mRand.rand(MTUBYTES) + LL_PACKET_ID_SIZE, 64, 700));
+		}
+		// no zeroes, and nothing but zeroes
+		ensureRoundTrip("no zeroes", makePacket(MTUBYTES, MTUBYTES * 2, 1));
+		ensureRoundTrip("all zeroes", std::vector<U8>(MTUBYTES, 0));
+		ensureRoundTrip("header only", makePacket(LL_PACKET_ID_SIZE, 2, 4));
+	}
+
+	template<> template<>
+	void zerocode_object::test<3>()
+	{
+		// arbitrary input expands the way it always has, even when it
+		// does not fit
+		for (S32 i = 0; i < 2000; i++)
+		{
+			std::vector<U8> in = makePacket(mRand.rand(MTUBYTES) + LL_PACKET_ID_SIZE, 4, 3);
+			ensureSameExpansion("fuzz", in, NET_BUFFER_SIZE);
+			ensureSameExpansion("fuzz small buffer", in, 512 + mRand.rand(512));
+		}
+	}
+}
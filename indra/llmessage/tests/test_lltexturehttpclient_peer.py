@@ -0,0 +1,135 @@
+#!/usr/bin/python
+"""\
+@file   test_lltexturehttpclient_peer.py
+@brief  This script runs the executable (with args) specified on the command
+        line, returning its result code. While that executable is running, we
+        serve textures over HTTP/1.1 on a loopback port for the
+        LLTextureHttpClient tests.
+
+        The port is passed to the executable in LL_TEXTURE_HTTP_PORT.
+        LL_TEXTURE_HTTP_LATENCY_MS sets the delay before each response
+        (default 20), LL_TEXTURE_HTTP_DIR a directory of <texture id>.j2c
+        files to serve. Textures not found there are synthetic:
+        LL_TEXTURE_HTTP_SIZE bytes (default 20000), byte i being i % 251.
+        The texture id "missing" answers 404 and "busy" 503.
+
+$LicenseInfo:firstyear=2010&license=viewerlgpl$
+Second Life Viewer Source Code
+Copyright (C) 2010, Linden Research, Inc.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation;
+version 2.1 of the License only.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+$/LicenseInfo$
+"""
+
+import os
+import re
+import sys
+import time
+import urlparse
+from threading import Thread
+from BaseHTTPServer import HTTPServer, BaseHTTPRequestHandler
+from SocketServer import ThreadingMixIn
+
+from testrunner import run, debug
+
+LATENCY = float(os.environ.get("LL_TEXTURE_HTTP_LATENCY_MS", "20")) / 1000.0
+TEXTURE_DIR = os.environ.get("LL_TEXTURE_HTTP_DIR")
+SYNTHETIC_SIZE = int(os.environ.get("LL_TEXTURE_HTTP_SIZE", "20000"))
+SYNTHETIC_DATA = "".join([chr(i % 251) for i in xrange(SYNTHETIC_SIZE)])
+
+class TextureRequestHandler(BaseHTTPRequestHandler):
+    """Answers GET /?texture_id=<id> like the region texture capability,
+    honoring Range: bytes=<first>-<last>, on keep-alive connections.
+    """
+    protocol_version = "HTTP/1.1"
+
+    def texture(self, texture_id):
+        if TEXTURE_DIR:
+            path = os.path.join(TEXTURE_DIR, os.path.basename(texture_id) + ".j2c")
+            if os.path.isfile(path):
+                f = open(path, "rb")
+                try:
+                    return f.read()
+                finally:
+                    f.close()
+        return SYNTHETIC_DATA
+
+    def do_GET(self):
+        query = urlparse.parse_qs(urlparse.urlparse(self.path).query)
+        texture_id = query.get("texture_id", [""])[0]
+        if LATENCY > 0:
+            time.sleep(LATENCY)
+        if texture_id == "missing":
+            self.send_error(404, "Texture not found")
+            return
+        if texture_id == "busy":
+            self.send_error(503, "Texture server busy")
+            return
+
+        data = self.texture(texture_id)
+        status = 200
+        first = 0
+        last = len(data) - 1
+        match = re.match(r"bytes=(\d+)-(\d*)", self.headers.get("Range", ""))
+        if match:
+            first = int(match.group(1))
+            if match.group(2):
+                last = min(int(match.group(2)), last)
+            status = 206
+        body = data[first:last + 1]
+        self.send_response(status)
+        self.send_header("Content-Type", "image/x-j2c")
+        self.send_header("Content-Length", str(len(body)))
+        if status == 206:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (first, first + len(body) - 1, len(data)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_error(self, code, message=None):
+        # BaseHTTPRequestHandler.send_error() closes the connection, the
+        # texture server keeps it
+        self.send_response(code, message)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_request(self, code, size=None):
+        # For present purposes, we don't want the request splattered onto
+        # stderr, as it would upset devs watching the test run
+        pass
+
+    def log_error(self, format, *args):
+        # Suppress error output as well
+        pass
+
+class ThreadingHTTPServer(ThreadingMixIn, HTTPServer):
+    # one thread per connection, like a real server with keep-alive
+    daemon_threads = True
+
+class TestTextureServer(Thread):
+    def __init__(self, httpd, **kwds):
+        Thread.__init__(self, **kwds)
+        self.httpd = httpd
+
+    def run(self):
+        debug("Starting texture server...\n")
+        self.httpd.serve_forever()
+
+if __name__ == "__main__":
+    # any free port, the executable finds it in the environment
+    httpd = ThreadingHTTPServer(('127.0.0.1', 0), TextureRequestHandler)
+    os.environ["LL_TEXTURE_HTTP_PORT"] = str(httpd.server_address[1])
+    sys.exit(run(server=TestTextureServer(httpd, name="texture_httpd"), *sys.argv[1:]))
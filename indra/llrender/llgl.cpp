@@ -185,6 +185,11 @@ PFNGLBLENDFUNCSEPARATEEXTPROC glBlendFuncSeparateEXT = NULL;
 // GL_ARB_draw_buffers
 PFNGLDRAWBUFFERSARBPROC glDrawBuffersARB = NULL;
 
+// GL_ARB_sync
+PFNGLFENCESYNCPROC glFenceSync = NULL;
+PFNGLDELETESYNCPROC glDeleteSync = NULL;
+PFNGLCLIENTWAITSYNCPROC glClientWaitSync = NULL;
+
 //shader object prototypes
 PFNGLDELETEOBJECTARBPROC glDeleteObjectARB = NULL;
 PFNGLGETHANDLEARBPROC glGetHandleARB = NULL;
@@ -324,6 +329,8 @@ LLGLManager::LLGLManager() :
 	mHasBlendFuncSeparate(FALSE),
 
 	mHasVertexBufferObject(FALSE),
+	mHasPixelBufferObject(FALSE),
+	mHasSync(FALSE),
 	mHasPBuffer(FALSE),
 	mHasShaderObjects(FALSE),
 	mHasVertexShader(FALSE),
@@ -630,6 +637,12 @@ void LLGLManager::initExtensions()
 # else
 	mHasVertexBufferObject = FALSE;
 # endif
+# ifdef GL_ARB_pixel_buffer_object
+	mHasPixelBufferObject = mHasVertexBufferObject;
+# else
+	mHasPixelBufferObject = FALSE;
+# endif
+	mHasSync = FALSE;
 # ifdef GL_EXT_framebuffer_object
 	mHasFramebufferObject = TRUE;
 # else
@@ -676,6 +689,11 @@ void LLGLManager::initExtensions()
 	mHasCompressedTextures = glh_init_extensions("GL_ARB_texture_compression");
 	mHasOcclusionQuery = ExtensionExists("GL_ARB_occlusion_query", gGLHExts.mSysExts);
 	mHasVertexBufferObject = ExtensionExists("GL_ARB_vertex_buffer_object", gGLHExts.mSysExts);
+	// pixel buffers share the buffer object entry points with vertex buffers
+	mHasPixelBufferObject = mHasVertexBufferObject && ExtensionExists("GL_ARB_pixel_buffer_object", gGLHExts.mSysExts);
+#if !LL_DARWIN
+	mHasSync = ExtensionExists("GL_ARB_sync", gGLHExts.mSysExts);
+#endif
 	mHasDepthClamp = ExtensionExists("GL_ARB_depth_clamp", gGLHExts.mSysExts) || ExtensionExists("GL_NV_depth_clamp", gGLHExts.mSysExts);
 	// mask out FBO support when packed_depth_stencil isn't there 'cause we need it for LLRenderTarget -Brad
 	mHasFramebufferObject = ExtensionExists("GL_EXT_framebuffer_object", gGLHExts.mSysExts)
@@ -704,6 +722,8 @@ void LLGLManager::initExtensions()
 		mHasARBEnvCombine = FALSE;
 		mHasCompressedTextures = FALSE;
 		mHasVertexBufferObject = FALSE;
+		mHasPixelBufferObject = FALSE;
+		mHasSync = FALSE;
 		mHasFramebufferObject = FALSE;
 		mHasFramebufferMultisample = FALSE;
 		mHasDrawBuffers = FALSE;
@@ -763,6 +783,8 @@ void LLGLManager::initExtensions()
 		if (strchr(blacklist,'t')) mHasTextureRectangle = FALSE;
 		if (strchr(blacklist,'u')) mHasBlendFuncSeparate = FALSE;//S
 		if (strchr(blacklist,'v')) mHasDepthClamp = FALSE;
+		if (strchr(blacklist,'w') || !mHasVertexBufferObject) mHasPixelBufferObject = FALSE;
+		if (strchr(blacklist,'x')) mHasSync = FALSE;
 		
 	}
 #endif // LL_LINUX || LL_SOLARIS
@@ -819,6 +841,14 @@ void LLGLManager::initExtensions()
 	{
 		LL_INFOS("RenderInit") << "Couldn't initialize GL_ARB_draw_buffers" << LL_ENDL;
 	}
+	if (!mHasPixelBufferObject)
+	{
+		LL_INFOS("RenderInit") << "Couldn't initialize GL_ARB_pixel_buffer_object" << LL_ENDL;
+	}
+	if (!mHasSync)
+	{
+		LL_INFOS("RenderInit") << "Couldn't initialize GL_ARB_sync" << LL_ENDL;
+	}
 
 	// Disable certain things due to known bugs
 	if (mIsIntel && mHasMipMapGeneration)
@@ -857,6 +887,7 @@ void LLGLManager::initExtensions()
 		else
 		{
 			mHasVertexBufferObject = FALSE;
+			mHasPixelBufferObject = FALSE;
 		}
 	}
 	if (mHasFramebufferObject)
@@ -893,6 +924,13 @@ void LLGLManager::initExtensions()
 	{
 		glBlendFuncSeparateEXT = (PFNGLBLENDFUNCSEPARATEEXTPROC) GLH_EXT_GET_PROC_ADDRESS("glBlendFuncSeparateEXT");
 	}
+	if (mHasSync)
+	{
+		glFenceSync = (PFNGLFENCESYNCPROC) GLH_EXT_GET_PROC_ADDRESS("glFenceSync");
+		glDeleteSync = (PFNGLDELETESYNCPROC) GLH_EXT_GET_PROC_ADDRESS("glDeleteSync");
+		glClientWaitSync = (PFNGLCLIENTWAITSYNCPROC) GLH_EXT_GET_PROC_ADDRESS("glClientWaitSync");
+		mHasSync = glFenceSync && glDeleteSync && glClientWaitSync;
+	}
 #if (!LL_LINUX && !LL_SOLARIS) || LL_LINUX_NV_GL_HEADERS
 	// This is expected to be a static symbol on Linux GL implementations, except if we use the nvidia headers - bah
 	glDrawRangeElements = (PFNGLDRAWRANGEELEMENTSPROC)GLH_EXT_GET_PROC_ADDRESS("glDrawRangeElements");
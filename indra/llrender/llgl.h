@@ -85,6 +85,8 @@ public:
 	
 	// ARB Extensions
 	BOOL mHasVertexBufferObject;
+	BOOL mHasPixelBufferObject;
+	BOOL mHasSync;
 	BOOL mHasPBuffer;
 	BOOL mHasShaderObjects;
 	BOOL mHasVertexShader;
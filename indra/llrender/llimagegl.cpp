@@ -37,9 +37,17 @@
 #include "llmath.h"
 #include "llgl.h"
 #include "llrender.h"
+#include "lltimer.h"
 //----------------------------------------------------------------------------
 const F32 MIN_TEXTURE_LIFETIME = 10.f;
 
+#ifndef GL_PIXEL_UNPACK_BUFFER_ARB
+#define GL_PIXEL_UNPACK_BUFFER_ARB 0x88EC
+#endif
+
+// Smaller uploads (most mip levels) are not worth a pixel buffer of the ring
+const S32 MIN_STAGED_UPLOAD_BYTES = 64 * 1024;
+
 //statics
 LLGLuint LLImageGL::sCurrentBoundTextures[MAX_GL_TEXTURE_UNITS] = { 0 };
 
@@ -56,6 +64,18 @@ F32 LLImageGL::sLastFrameTime			= 0.f;
 BOOL LLImageGL::sAllowReadBackRaw       = FALSE ;
 LLImageGL* LLImageGL::sDefaultGLTexture = NULL ;
 
+S32 LLImageGL::sUploadBytesLastFrame	= 0;
+F32 LLImageGL::sUploadStallTimeLastFrame = 0.f;
+std::vector<LLImageGL::PixelBuffer> LLImageGL::sPixelBuffers;
+S32 LLImageGL::sNumPixelBuffers			= 0;
+S32 LLImageGL::sNextPixelBuffer			= 0;
+BOOL LLImageGL::sPixelBuffersFull		= FALSE;
+S32 LLImageGL::sUnpackRowLength			= 0;
+S32 LLImageGL::sUnpackAlignment			= 4;
+S32 LLImageGL::sUploadBudget			= 0;
+S32 LLImageGL::sCurUploadBytes			= 0;
+F32 LLImageGL::sCurUploadStallTime		= 0.f;
+
 std::set<LLImageGL*> LLImageGL::sImageList;
 
 //****************************************************************************************************
@@ -283,6 +303,12 @@ void LLImageGL::updateStats(F32 current_time)
 	sLastFrameTime = current_time;
 	sBoundTextureMemoryInBytes = sCurBoundTextureMemory;
 	sCurBoundTextureMemory = 0;
+	sUploadBytesLastFrame = sCurUploadBytes;
+	sCurUploadBytes = 0;
+	sUploadStallTimeLastFrame = sCurUploadStallTime;
+	sCurUploadStallTime = 0.f;
+	// Look at the ring again next frame
+	sPixelBuffersFull = FALSE;
 
 	if(gAuditTexture)
 	{
@@ -321,6 +347,7 @@ void LLImageGL::destroyGL(BOOL save_state)
 	{
 		gGL.getTexUnit(stage)->unbind(LLTexUnit::TT_TEXTURE);
 	}
+	deletePixelBuffers();
 	
 	sAllowReadBackRaw = true ;
 	for (std::set<LLImageGL*>::iterator iter = sImageList.begin();
@@ -934,7 +961,7 @@ BOOL LLImageGL::preAddToAtlas(S32 discard_level, const LLImageRaw* raw_image)
 	mLastBindTime = sLastFrameTime;
 	mGLTextureCreated = false ;
 	
-	glPixelStorei(GL_UNPACK_ROW_LENGTH, raw_image->getWidth());
+	setUnpackRowLength(raw_image->getWidth());
 	stop_glerror();
 
 	if(mFormatSwapBytes)
@@ -954,7 +981,7 @@ void LLImageGL::postAddToAtlas()
 		stop_glerror();
 	}
 
-	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	setUnpackRowLength(0);
 	gGL.getTexUnit(0)->setTextureFilteringOption(mFilterOption);	
 	stop_glerror();	
 }
@@ -1020,7 +1047,7 @@ BOOL LLImageGL::setSubImage(const U8* datap, S32 data_width, S32 data_height, S3
 		}
 
 
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, data_width);
+		setUnpackRowLength(data_width);
 		stop_glerror();
 
 		if(mFormatSwapBytes)
@@ -1046,7 +1073,7 @@ BOOL LLImageGL::setSubImage(const U8* datap, S32 data_width, S32 data_height, S3
 			stop_glerror();
 		}
 
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		setUnpackRowLength(0);
 		stop_glerror();
 		mGLTextureCreated = true;
 	}
@@ -1099,11 +1126,222 @@ void LLImageGL::deleteTextures(S32 numTextures, U32 *textures)
 	}
 }
 
+// Size of the client side pixel data glTexImage2D() reads, 0 for formats we do not stage
+static S32 unpack_data_bytes(S32 width, S32 height, U32 pixformat, U32 pixtype, S32 row_length, S32 alignment)
+{
+	S32 components;
+	switch (pixformat)
+	{
+	  case GL_LUMINANCE:
+	  case GL_ALPHA:
+		components = 1;
+		break;
+	  case GL_LUMINANCE_ALPHA:
+		components = 2;
+		break;
+	  case GL_RGB:
+		components = 3;
+		break;
+	  case GL_RGBA:
+	  case GL_BGRA:
+		components = 4;
+		break;
+	  default:
+		return 0;
+	}
+	S32 component_bytes;
+	switch (pixtype)
+	{
+	  case GL_UNSIGNED_BYTE:
+	  case GL_UNSIGNED_INT_8_8_8_8_REV:
+		component_bytes = 1;
+		break;
+	  case GL_FLOAT:
+		component_bytes = 4;
+		break;
+	  default:
+		return 0;
+	}
+
+	S32 row_bytes = width * components * component_bytes;
+	S32 stride = (row_length > 0 ? row_length : width) * components * component_bytes;
+	stride = (stride + alignment - 1) / alignment * alignment;
+	// the last row is not padded
+	return stride * (height - 1) + row_bytes;
+}
+
+// GL_ARB_sync entry points are only loaded where llgl loads extensions by hand
+#if (LL_WINDOWS || LL_LINUX || LL_SOLARIS) && !LL_MESA_HEADLESS
+#define LL_PIXEL_BUFFER_FENCES 1
+#else
+#define LL_PIXEL_BUFFER_FENCES 0
+#endif
+
+// Marks the point after which the GPU is done reading buffer
+static void fence_pixel_buffer(LLImageGL::PixelBuffer& buffer)
+{
+#if LL_PIXEL_BUFFER_FENCES
+	if (gGLManager.mHasSync)
+	{
+		buffer.mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+#endif
+}
+
+static void delete_pixel_buffer_fence(LLImageGL::PixelBuffer& buffer)
+{
+#if LL_PIXEL_BUFFER_FENCES
+	if (buffer.mFence)
+	{
+		glDeleteSync((GLsync)buffer.mFence);
+	}
+#endif
+	buffer.mFence = NULL;
+}
+
+// TRUE while an upload sourced from buffer may still be reading it. Never waits.
+static BOOL is_pixel_buffer_busy(LLImageGL::PixelBuffer& buffer)
+{
+#if LL_PIXEL_BUFFER_FENCES
+	if (buffer.mFence)
+	{
+		if (glClientWaitSync((GLsync)buffer.mFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			return TRUE;
+		}
+		delete_pixel_buffer_fence(buffer);
+	}
+#endif
+	return FALSE;
+}
+
 // static
 void LLImageGL::setManualImage(U32 target, S32 miplevel, S32 intformat, S32 width, S32 height, U32 pixformat, U32 pixtype, const void *pixels)
 {
-	glTexImage2D(target, miplevel, intformat, width, height, 0, pixformat, pixtype, pixels);
+	LLTimer upload_timer;
+	S32 bytes = pixels && width > 0 && height > 0 ? unpack_data_bytes(width, height, pixformat, pixtype, sUnpackRowLength, sUnpackAlignment) : 0;
+	if (bytes < MIN_STAGED_UPLOAD_BYTES || !stagePixels(target, miplevel, intformat, width, height, pixformat, pixtype, pixels, bytes))
+	{
+		glTexImage2D(target, miplevel, intformat, width, height, 0, pixformat, pixtype, pixels);
+	}
 	stop_glerror();
+	sCurUploadBytes += bytes;
+	sCurUploadStallTime += upload_timer.getElapsedTimeF32();
+}
+
+// Copies pixels into the next buffer of the ring and sources the upload from there,
+// so glTexImage2D() returns without waiting for the driver to consume the data.
+// With GL_ARB_sync each buffer is fenced after its upload and only refilled once
+// the GPU has passed the fence, without it buffers are orphaned instead.
+// Returns FALSE if the caller has to upload from client memory.
+//static
+BOOL LLImageGL::stagePixels(U32 target, S32 miplevel, S32 intformat, S32 width, S32 height, U32 pixformat, U32 pixtype, const void *pixels, S32 bytes)
+{
+	if (!sNumPixelBuffers || !gGLManager.mHasPixelBufferObject)
+	{
+		return FALSE;
+	}
+	if (sPixelBuffers.empty())
+	{
+		std::vector<U32> names(sNumPixelBuffers);
+		glGenBuffersARB(sNumPixelBuffers, &names[0]);
+		sPixelBuffers.resize(sNumPixelBuffers);
+		for (S32 i = 0; i < sNumPixelBuffers; ++i)
+		{
+			sPixelBuffers[i].mName = names[i];
+		}
+		sNextPixelBuffer = 0;
+	}
+
+	PixelBuffer& buffer = sPixelBuffers[sNextPixelBuffer];
+	if (is_pixel_buffer_busy(buffer))
+	{
+		// Every buffer is in flight. isUploadBudgetSpent() holds back further
+		// textures until the GPU catches up, this one is already on its way.
+		sPixelBuffersFull = TRUE;
+		return FALSE;
+	}
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, buffer.mName);
+	if (!gGLManager.mHasSync || buffer.mSize < bytes)
+	{
+		// Without a fence orphan the previous contents so the map does not wait on a pending upload
+		glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, llmax(bytes, buffer.mSize), NULL, GL_STREAM_DRAW_ARB);
+		buffer.mSize = llmax(bytes, buffer.mSize);
+	}
+	void* dst = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+	if (!dst)
+	{
+		glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		stop_glerror();
+		return FALSE;
+	}
+	memcpy(dst, pixels, bytes);		/* Flawfinder: ignore */
+	if (!glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB))
+	{
+		// Buffer contents got lost (mode switch...), upload from client memory instead
+		glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		stop_glerror();
+		return FALSE;
+	}
+	glTexImage2D(target, miplevel, intformat, width, height, 0, pixformat, pixtype, NULL);
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	fence_pixel_buffer(buffer);
+	sNextPixelBuffer = (sNextPixelBuffer + 1) % sNumPixelBuffers;
+	return TRUE;
+}
+
+//static
+void LLImageGL::deletePixelBuffers()
+{
+	for (std::vector<PixelBuffer>::iterator iter = sPixelBuffers.begin(); iter != sPixelBuffers.end(); ++iter)
+	{
+		delete_pixel_buffer_fence(*iter);
+		glDeleteBuffersARB(1, &iter->mName);
+	}
+	sPixelBuffers.clear();
+	sPixelBuffersFull = FALSE;
+}
+
+//static
+void LLImageGL::setPixelBufferUploads(S32 num_buffers)
+{
+	num_buffers = llmax(num_buffers, 0);
+	if (num_buffers != sNumPixelBuffers)
+	{
+		deletePixelBuffers();
+		sNumPixelBuffers = num_buffers;
+	}
+}
+
+//static
+void LLImageGL::setUploadBudget(S32 bytes_per_frame)
+{
+	sUploadBudget = llmax(bytes_per_frame, 0);
+}
+
+//static
+BOOL LLImageGL::isUploadBudgetSpent()
+{
+	return sPixelBuffersFull || (sUploadBudget > 0 && sCurUploadBytes >= sUploadBudget);
+}
+
+//static
+void LLImageGL::setUnpackRowLength(S32 row_length)
+{
+	if (row_length != sUnpackRowLength)
+	{
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+		sUnpackRowLength = row_length;
+	}
+}
+
+//static
+void LLImageGL::setUnpackAlignment(S32 alignment)
+{
+	// Always set: GL state is back to its defaults after the context got recreated
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	sUnpackAlignment = alignment;
 }
 
 //create an empty GL texture: just create a texture name
@@ -247,6 +247,30 @@ public:
 	static LLImageGL* sDefaultGLTexture ;	
 	static BOOL sAutomatedTest;
 
+	// Texture uploads through setManualImage()
+	static S32 sUploadBytesLastFrame;		// Bytes handed to GL last completed frame
+	static F32 sUploadStallTimeLastFrame;	// Seconds spent in glTexImage2D last completed frame
+
+	// Stage uploads through a ring of num_buffers pixel unpack buffers, 0 uploads straight from client memory
+	static void setPixelBufferUploads(S32 num_buffers);
+	// Bytes that may be uploaded per frame before isUploadBudgetSpent() returns TRUE, 0 for no limit
+	static void setUploadBudget(S32 bytes_per_frame);
+	// TRUE when the frame's budget is used up or every pixel buffer still feeds an upload
+	static BOOL isUploadBudgetSpent();
+
+	// Set GL_UNPACK_ROW_LENGTH / GL_UNPACK_ALIGNMENT and remember them, so that
+	// uploads know the size of their data without asking GL
+	static void setUnpackRowLength(S32 row_length);
+	static void setUnpackAlignment(S32 alignment);
+
+	struct PixelBuffer
+	{
+		PixelBuffer() : mName(0), mSize(0), mFence(NULL) {}
+		U32 mName;
+		S32 mSize;		// Bytes allocated
+		void* mFence;	// GLsync set after the upload sourced from it, NULL once passed
+	};
+
 #if DEBUG_MISS
 	BOOL mMissed; // Missed on last bind?
 	BOOL getMissed() const { return mMissed; };
@@ -263,6 +287,19 @@ private:
 	//the flag to allow to call readBackRaw(...).
 	//can be removed if we do not use that function at all.
 	static BOOL sAllowReadBackRaw ;
+
+	static BOOL stagePixels(U32 target, S32 miplevel, S32 intformat, S32 width, S32 height, U32 pixformat, U32 pixtype, const void *pixels, S32 bytes);
+	static void deletePixelBuffers();
+
+	static std::vector<PixelBuffer> sPixelBuffers;	// Generated on first use
+	static S32 sNumPixelBuffers;
+	static S32 sNextPixelBuffer;
+	static BOOL sPixelBuffersFull;	// The next buffer was still in flight this frame
+	static S32 sUnpackRowLength;
+	static S32 sUnpackAlignment;
+	static S32 sUploadBudget;
+	static S32 sCurUploadBytes;
+	static F32 sCurUploadStallTime;
 //
 //****************************************************************************************************
 //The below for texture auditing use only
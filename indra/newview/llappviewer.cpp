@@ -87,6 +87,7 @@
 // Linden library includes
 #include "llavatarnamecache.h"
 #include "llimagej2c.h"
+#include "llimagej2cdecodecache.h"
 #include "llmemory.h"
 #include "llprimitive.h"
 #include "llurlaction.h"
@@ -561,6 +562,7 @@ const std::string LLAppViewer::sGlobalSettingsName = "Global";
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
+LLThreadPool* LLAppViewer::sThreadPool = NULL; 
 
 LLAppViewer::LLAppViewer() : 
 	mMarkerFile(),
@@ -1646,6 +1648,9 @@ bool LLAppViewer::cleanup()
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	// after all of its users are gone
+	delete sThreadPool;
+	sThreadPool = NULL;
 	delete mFastTimerLogThread;
 	mFastTimerLogThread = NULL;
 	
@@ -1765,11 +1770,29 @@ bool LLAppViewer::initThreads()
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
+	// Worker threads shared by the texture cache and image decoding
+	if (enable_threads)
+	{
+		LLAppViewer::sThreadPool = new LLThreadPool("SharedWorkers", gSavedSettings.getU32("ThreadPoolSize"));
+	}
+
 	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
-	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true, sThreadPool, gSavedSettings.getU32("ImageDecodeThreads"));
+	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true, sThreadPool);
+	if (sThreadPool)
+	{
+		// cache reads are short and the fetcher waits on them
+		sTextureCache->setPoolOptions(LLThreadPool::CLASS_HIGH, 1);
+	}
+	// Prim and sculpt geometry
+	if (sThreadPool && gSavedSettings.getBOOL("RenderVolumeBuildThreaded"))
+	{
+		LLPrimitive::getVolumeManager()->setThreadPool(sThreadPool);
+	}
+	llinfos << "Decoding up to " << sImageDecodeThread->getNumDecoders() << " images at once" << llendl;
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
 	LLImage::initClass();
+	LLImageJ2CDecodeCache::setCacheSize(gSavedSettings.getU32("ImageDecodeCacheSize") * 1024 * 1024);
 
 	if (LLFastTimer::sLog || LLFastTimer::sMetricLog)
 	{
@@ -2289,6 +2312,8 @@ bool LLAppViewer::initConfiguration()
 	//LLVolumeMgr::initClass();
 	LLVolumeMgr* volume_manager = new LLVolumeMgr();
 	volume_manager->useMutex();	// LLApp and LLMutex magic must be manually enabled
+	volume_manager->setCacheBudget((S32)llmin(gSavedSettings.getU32("RenderVolumeCacheMB"), (U32)1024) * 1024 * 1024);
+	LLVolume::sOptimizeCacheOrder = gSavedSettings.getBOOL("RenderOptimizeVolumeFaces");
 	LLPrimitive::setVolumeManager(volume_manager);
 
 	// Note: this is where we used to initialize gFeatureManagerp.
@@ -4183,8 +4208,7 @@ void LLAppViewer::idleNameCache()
 #define TIME_THROTTLE_MESSAGES
 
 #ifdef TIME_THROTTLE_MESSAGES
-#define CHECK_MESSAGES_DEFAULT_MAX_TIME .020f // 50 ms = 50 fps (just for messages!)
-static F32 CheckMessagesMaxTime = CHECK_MESSAGES_DEFAULT_MAX_TIME;
+static F32 CheckMessagesMaxTime = 0.f; // MessageMaxTimePerFrame, grown while we are behind
 #endif
 
 static LLFastTimer::DeclareTimer FTM_IDLE_NETWORK("Idle Network");
@@ -4200,6 +4224,13 @@ void LLAppViewer::idleNetwork()
 	if (!gSavedSettings.getBOOL("SpeedTest"))
 	{
 		LLFastTimer t(FTM_IDLE_NETWORK); // decode
+
+		static LLCachedControl<S32> max_messages_per_frame(gSavedSettings, "MessageMaxPacketsPerFrame");
+		const S32 max_decoded = llmax((S32)max_messages_per_frame, 1);
+#ifdef TIME_THROTTLE_MESSAGES
+		static LLCachedControl<F32> max_message_time(gSavedSettings, "MessageMaxTimePerFrame");
+		CheckMessagesMaxTime = llmax(CheckMessagesMaxTime, (F32)max_message_time);
+#endif
 		
 		LLTimer check_message_timer;
 		//  Read all available packets from network 
@@ -4219,7 +4250,7 @@ void LLAppViewer::idleNetwork()
 			total_decoded++;
 			gPacketsIn++;
 
-			if (total_decoded > MESSAGE_MAX_PER_FRAME)
+			if (total_decoded > max_decoded)
 			{
 				break;
 			}
@@ -4247,7 +4278,7 @@ void LLAppViewer::idleNetwork()
 		else
 		{
 			// Reset CheckMessagesMaxTime to default value
-			CheckMessagesMaxTime = CHECK_MESSAGES_DEFAULT_MAX_TIME;
+			CheckMessagesMaxTime = max_message_time;
 		}
 #endif
 		
@@ -4257,11 +4288,11 @@ void LLAppViewer::idleNetwork()
 		gAgent.resetControlFlags();
 				
 		// Decode enqueued messages...
-		S32 remaining_possible_decodes = MESSAGE_MAX_PER_FRAME - total_decoded;
+		S32 remaining_possible_decodes = max_decoded - total_decoded;
 
 		if( remaining_possible_decodes <= 0 )
 		{
-			llinfos << "Maxed out number of messages per frame at " << MESSAGE_MAX_PER_FRAME << llendl;
+			llinfos << "Maxed out number of messages per frame at " << max_decoded << llendl;
 		}
 
 		if (gPrintMessagesThisFrame)
@@ -37,6 +37,7 @@ class LLFrameTimer;
 class LLPumpIO;
 class LLTextureCache;
 class LLImageDecodeThread;
+class LLThreadPool;
 class LLTextureFetch;
 class LLWatchdogTimeout;
 class LLUpdaterService;
@@ -93,6 +94,7 @@ public:
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
+	static LLThreadPool* getThreadPool() { return sThreadPool; }
 
 	static U32 getTextureCacheVersion() ;
 	static U32 getObjectCacheVersion() ;
@@ -233,6 +235,7 @@ private:
 	static LLTextureCache* sTextureCache; 
 	static LLImageDecodeThread* sImageDecodeThread; 
 	static LLTextureFetch* sTextureFetch;
+	static LLThreadPool* sThreadPool; // shared by the texture cache and image decode threads
 
 	S32 mNumSessions;
 
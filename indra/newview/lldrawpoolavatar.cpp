@@ -679,15 +679,15 @@ void LLDrawPoolAvatar::renderAvatars(LLVOAvatar* single_avatar, S32 pass)
 
 		if (impostor)
 		{
-			if (LLPipeline::sRenderDeferred && avatarp->mImpostor.isComplete()) 
+			if (LLPipeline::sRenderDeferred && LLVOAvatar::sImpostorTarget.isComplete()) 
 			{
 				if (normal_channel > -1)
 				{
-					avatarp->mImpostor.bindTexture(2, normal_channel);
+					LLVOAvatar::sImpostorTarget.bindTexture(2, normal_channel);
 				}
 				if (specular_channel > -1)
 				{
-					avatarp->mImpostor.bindTexture(1, specular_channel);
+					LLVOAvatar::sImpostorTarget.bindTexture(1, specular_channel);
 				}
 			}
 			avatarp->renderImpostor(LLColor4U(255,255,255,255), diffuse_channel);
@@ -0,0 +1,410 @@
+/**
+ * @file llimpostoratlas.cpp
+ * @brief Packs avatar impostor sprites into one texture and schedules their refreshes
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llimpostoratlas.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Refresh order of the pending impostors, most urgent first
+	struct Candidate
+	{
+		Candidate(BOOL has_sprite, F32 key, LLImpostorAtlas::handle_t handle)
+			: mHasSprite(has_sprite), mKey(key), mHandle(handle) {}
+		bool operator<(const Candidate& rhs) const
+		{
+			if (mHasSprite != rhs.mHasSprite)
+			{
+				return !mHasSprite;
+			}
+			return mKey > rhs.mKey;
+		}
+		BOOL mHasSprite;
+		F32 mKey;
+		LLImpostorAtlas::handle_t mHandle;
+	};
+}
+
+static const LLRect NO_RECT;
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLImpostorAtlas::LLImpostorAtlas(S32 width, S32 height)
+	: mWidth(0),
+	  mHeight(0),
+	  mNumImpostors(0),
+	  mNumPending(0),
+	  mUsedArea(0)
+{
+	resize(width, height);
+}
+
+void LLImpostorAtlas::resize(S32 width, S32 height)
+{
+	mWidth = llmax(width, 0);
+	mHeight = llmax(height, 0);
+	clear();
+}
+
+void LLImpostorAtlas::clear()
+{
+	mFreeRows.clear();
+	if (mHeight > 0)
+	{
+		mFreeRows.push_back(Span(0, mHeight));
+	}
+	mShelves.clear();
+	mImpostors.clear();
+	mFreeImpostors.clear();
+	mScheduled.clear();
+	mNumImpostors = 0;
+	mNumPending = 0;
+	mUsedArea = 0;
+}
+
+F32 LLImpostorAtlas::getFill() const
+{
+	if (mWidth <= 0 || mHeight <= 0)
+	{
+		return 0.f;
+	}
+	return (F32)mUsedArea / ((F32)mWidth * (F32)mHeight);
+}
+
+LLImpostorAtlas::Impostor* LLImpostorAtlas::getImpostor(handle_t handle)
+{
+	if (handle <= 0 || handle > (S32)mImpostors.size() || !mImpostors[handle - 1].mInUse)
+	{
+		return NULL;
+	}
+	return &mImpostors[handle - 1];
+}
+
+const LLImpostorAtlas::Impostor* LLImpostorAtlas::getImpostor(handle_t handle) const
+{
+	if (handle <= 0 || handle > (S32)mImpostors.size() || !mImpostors[handle - 1].mInUse)
+	{
+		return NULL;
+	}
+	return &mImpostors[handle - 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLImpostorAtlas::handle_t LLImpostorAtlas::addImpostor(void* user_data)
+{
+	handle_t handle;
+	if (!mFreeImpostors.empty())
+	{
+		handle = mFreeImpostors.back();
+		mFreeImpostors.pop_back();
+	}
+	else
+	{
+		mImpostors.push_back(Impostor());
+		handle = (handle_t)mImpostors.size();
+	}
+	Impostor& impostor = mImpostors[handle - 1];
+	impostor.mInUse = TRUE;
+	impostor.mPending = FALSE;
+	impostor.mHasSprite = FALSE;
+	impostor.mWidth = 0;
+	impostor.mHeight = 0;
+	impostor.mPriority = 0.f;
+	impostor.mWaitFrames = 0;
+	impostor.mRect = NO_RECT;
+	impostor.mUserData = user_data;
+	mNumImpostors++;
+	return handle;
+}
+
+void LLImpostorAtlas::removeImpostor(handle_t handle)
+{
+	Impostor* impostor = getImpostor(handle);
+	if (!impostor)
+	{
+		return;
+	}
+	if (impostor->mHasSprite)
+	{
+		release(impostor->mRect);
+	}
+	if (impostor->mPending)
+	{
+		mNumPending--;
+	}
+	impostor->mInUse = FALSE;
+	impostor->mUserData = NULL;
+	mFreeImpostors.push_back(handle);
+	mNumImpostors--;
+}
+
+void LLImpostorAtlas::requestUpdate(handle_t handle, S32 width, S32 height, F32 priority)
+{
+	Impostor* impostor = getImpostor(handle);
+	if (!impostor)
+	{
+		return;
+	}
+	if (!impostor->mPending)
+	{
+		impostor->mPending = TRUE;
+		impostor->mWaitFrames = 0;
+		mNumPending++;
+	}
+	impostor->mWidth = llmax(width, 1);
+	impostor->mHeight = llmax(height, 1);
+	impostor->mPriority = llmax(priority, 0.f);
+}
+
+const std::vector<LLImpostorAtlas::handle_t>& LLImpostorAtlas::schedule(S32 max_updates)
+{
+	mScheduled.clear();
+	if (mNumPending == 0)
+	{
+		return mScheduled;
+	}
+
+	std::vector<Candidate> candidates;
+	candidates.reserve(mNumPending);
+	for (U32 i = 0; i < mImpostors.size(); i++)
+	{
+		Impostor& impostor = mImpostors[i];
+		if (impostor.mInUse && impostor.mPending)
+		{
+			impostor.mWaitFrames++;
+			candidates.push_back(Candidate(impostor.mHasSprite, impostor.mPriority * (F32)impostor.mWaitFrames, (handle_t)(i + 1)));
+		}
+	}
+
+	S32 count = llclamp(max_updates, 0, (S32)candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+
+	for (S32 i = 0; i < count; i++)
+	{
+		Impostor& impostor = mImpostors[candidates[i].mHandle - 1];
+		if (!impostor.mHasSprite
+			|| impostor.mRect.getWidth() != impostor.mWidth
+			|| impostor.mRect.getHeight() != impostor.mHeight)
+		{
+			// Give the old rectangle back first, the new one may go there
+			if (impostor.mHasSprite)
+			{
+				release(impostor.mRect);
+				impostor.mHasSprite = FALSE;
+				impostor.mRect = NO_RECT;
+			}
+
+			S32 width = impostor.mWidth;
+			S32 height = impostor.mHeight;
+			while (!allocate(width, height, impostor.mRect))
+			{
+				if (width <= MIN_SPRITE_SIZE && height <= MIN_SPRITE_SIZE)
+				{
+					break;
+				}
+				width = llmax(width / 2, llmin(width, MIN_SPRITE_SIZE));
+				height = llmax(height / 2, llmin(height, MIN_SPRITE_SIZE));
+			}
+			if (impostor.mRect.isEmpty())
+			{
+				// Doesn't fit at all, wait for others to go away
+				continue;
+			}
+		}
+
+		impostor.mHasSprite = TRUE;
+		impostor.mPending = FALSE;
+		impostor.mWaitFrames = 0;
+		mNumPending--;
+		mScheduled.push_back(candidates[i].mHandle);
+	}
+
+	return mScheduled;
+}
+
+const LLRect& LLImpostorAtlas::getRect(handle_t handle) const
+{
+	const Impostor* impostor = getImpostor(handle);
+	return impostor && impostor->mHasSprite ? impostor->mRect : NO_RECT;
+}
+
+BOOL LLImpostorAtlas::hasSprite(handle_t handle) const
+{
+	const Impostor* impostor = getImpostor(handle);
+	return impostor ? impostor->mHasSprite : FALSE;
+}
+
+BOOL LLImpostorAtlas::isPending(handle_t handle) const
+{
+	const Impostor* impostor = getImpostor(handle);
+	return impostor ? impostor->mPending : FALSE;
+}
+
+void* LLImpostorAtlas::getUserData(handle_t handle) const
+{
+	const Impostor* impostor = getImpostor(handle);
+	return impostor ? impostor->mUserData : NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+BOOL LLImpostorAtlas::allocate(S32 width, S32 height, LLRect& rect)
+{
+	rect = NO_RECT;
+	if (width <= 0 || height <= 0 || width > mWidth || height > mHeight)
+	{
+		return FALSE;
+	}
+
+	for (U32 i = 0; i < mShelves.size(); i++)
+	{
+		Shelf& shelf = mShelves[i];
+		if (shelf.mHeight >= height && shelf.mHeight <= height * 2)
+		{
+			S32 left = allocateSpan(shelf.mFree, width);
+			if (left >= 0)
+			{
+				rect.setOriginAndSize(left, shelf.mBottom, width, height);
+				mUsedArea += width * height;
+				return TRUE;
+			}
+		}
+	}
+
+	S32 bottom = allocateSpan(mFreeRows, height);
+	if (bottom < 0)
+	{
+		// No room for a new shelf, any shelf tall enough will do
+		for (U32 i = 0; i < mShelves.size(); i++)
+		{
+			Shelf& shelf = mShelves[i];
+			if (shelf.mHeight > height * 2)
+			{
+				S32 left = allocateSpan(shelf.mFree, width);
+				if (left >= 0)
+				{
+					rect.setOriginAndSize(left, shelf.mBottom, width, height);
+					mUsedArea += width * height;
+					return TRUE;
+				}
+			}
+		}
+		return FALSE;
+	}
+
+	Shelf shelf;
+	shelf.mBottom = bottom;
+	shelf.mHeight = height;
+	shelf.mFree.push_back(Span(0, mWidth));
+	S32 left = allocateSpan(shelf.mFree, width);
+	U32 i = 0;
+	while (i < mShelves.size() && mShelves[i].mBottom < bottom)
+	{
+		i++;
+	}
+	mShelves.insert(mShelves.begin() + i, shelf);
+
+	rect.setOriginAndSize(left, bottom, width, height);
+	mUsedArea += width * height;
+	return TRUE;
+}
+
+void LLImpostorAtlas::release(const LLRect& rect)
+{
+	for (U32 i = 0; i < mShelves.size(); i++)
+	{
+		Shelf& shelf = mShelves[i];
+		if (shelf.mBottom == rect.mBottom)
+		{
+			releaseSpan(shelf.mFree, rect.mLeft, rect.getWidth());
+			mUsedArea -= rect.getWidth() * rect.getHeight();
+			if (shelf.mFree.size() == 1 && shelf.mFree[0].mSize == mWidth)
+			{
+				releaseSpan(mFreeRows, shelf.mBottom, shelf.mHeight);
+				mShelves.erase(mShelves.begin() + i);
+			}
+			return;
+		}
+	}
+	llwarns << "Releasing impostor rectangle not in the atlas: " << rect << llendl;
+}
+
+//static
+S32 LLImpostorAtlas::allocateSpan(span_list_t& spans, S32 size)
+{
+	for (span_list_t::iterator iter = spans.begin(); iter != spans.end(); ++iter)
+	{
+		if (iter->mSize >= size)
+		{
+			S32 start = iter->mStart;
+			iter->mStart += size;
+			iter->mSize -= size;
+			if (iter->mSize == 0)
+			{
+				spans.erase(iter);
+			}
+			return start;
+		}
+	}
+	return -1;
+}
+
+//static
+void LLImpostorAtlas::releaseSpan(span_list_t& spans, S32 start, S32 size)
+{
+	span_list_t::iterator next = spans.begin();
+	while (next != spans.end() && next->mStart < start)
+	{
+		++next;
+	}
+
+	// Merge with the span before and after
+	if (next != spans.begin())
+	{
+		span_list_t::iterator prev = next - 1;
+		if (prev->mStart + prev->mSize == start)
+		{
+			prev->mSize += size;
+			if (next != spans.end() && prev->mStart + prev->mSize == next->mStart)
+			{
+				prev->mSize += next->mSize;
+				spans.erase(next);
+			}
+			return;
+		}
+	}
+	if (next != spans.end() && start + size == next->mStart)
+	{
+		next->mStart = start;
+		next->mSize += size;
+		return;
+	}
+	spans.insert(next, Span(start, size));
+}
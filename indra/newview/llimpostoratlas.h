@@ -0,0 +1,146 @@
+/**
+ * @file llimpostoratlas.h
+ * @brief Packs avatar impostor sprites into one texture and schedules their refreshes
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMPOSTORATLAS_H
+#define LL_LLIMPOSTORATLAS_H
+
+#include "llrect.h"
+
+#include <vector>
+
+// Every impostored avatar draws its sprite from a rectangle of one shared
+// texture, instead of from a render target of its own. The atlas hands out
+// those rectangles and decides which sprites get redrawn each frame.
+//
+// Rectangles are packed in shelves: horizontal strips as tall as the first
+// sprite placed in them, filled left to right. A sprite goes on the lowest
+// shelf it fits, that is not more than twice its height, or opens a new
+// shelf, or when there is no room left for one, goes on any shelf tall
+// enough. Freed spans are merged with their neighbours, and a shelf left
+// empty gives its strip back to the atlas.
+//
+// Avatars ask for a refresh with requestUpdate(), with their on screen
+// pixel area as priority. schedule() picks the ones to redraw this frame:
+// those with no sprite yet first, as they can't be drawn at all, then by
+// priority times the frames they have waited, so that small far away
+// avatars still get their turn. A sprite that doesn't fit the atlas is
+// halved until it does.
+//
+// The atlas does not know about GL or LLVOAvatar, impostors are handles.
+
+class LLImpostorAtlas
+{
+public:
+	typedef S32 handle_t; // 0 is no impostor
+
+	// Smallest side a sprite is halved to when the atlas is full
+	static const S32 MIN_SPRITE_SIZE = 16;
+
+	LLImpostorAtlas(S32 width, S32 height);
+
+	// Drops all the impostors
+	void resize(S32 width, S32 height);
+	void clear();
+
+	// user_data is handed back by getUserData()
+	handle_t addImpostor(void* user_data);
+	void removeImpostor(handle_t handle);
+
+	// The impostor's sprite is out of date and should be redrawn at width x
+	// height. Calling it again before schedule() picks the impostor updates
+	// the size and priority.
+	void requestUpdate(handle_t handle, S32 width, S32 height, F32 priority);
+	// Picks up to max_updates impostors to redraw this frame and gives each
+	// its rectangle. Their sprites count as drawn from then on.
+	const std::vector<handle_t>& schedule(S32 max_updates);
+
+	// Where the impostor's sprite is, empty when it has none
+	const LLRect& getRect(handle_t handle) const;
+	BOOL hasSprite(handle_t handle) const;
+	BOOL isPending(handle_t handle) const;
+	void* getUserData(handle_t handle) const;
+
+	S32 getWidth() const			{ return mWidth; }
+	S32 getHeight() const			{ return mHeight; }
+	S32 getNumImpostors() const		{ return mNumImpostors; }
+	S32 getNumPending() const		{ return mNumPending; }
+	S32 getUsedArea() const			{ return mUsedArea; }
+	// Fraction of the texture the sprites cover
+	F32 getFill() const;
+
+private:
+	// A free run [mStart, mStart + mSize) of a shelf, or of the atlas height
+	struct Span
+	{
+		Span(S32 start, S32 size) : mStart(start), mSize(size) {}
+		S32 mStart;
+		S32 mSize;
+	};
+	typedef std::vector<Span> span_list_t;
+
+	struct Shelf
+	{
+		S32 mBottom;
+		S32 mHeight;
+		span_list_t mFree;	// by mStart
+	};
+
+	struct Impostor
+	{
+		BOOL mInUse;
+		BOOL mPending;
+		BOOL mHasSprite;
+		S32 mWidth;			// requested
+		S32 mHeight;
+		F32 mPriority;
+		S32 mWaitFrames;	// schedule() calls since requestUpdate()
+		LLRect mRect;
+		void* mUserData;
+	};
+
+	Impostor* getImpostor(handle_t handle);
+	const Impostor* getImpostor(handle_t handle) const;
+
+	// Packing, rect is set on success
+	BOOL allocate(S32 width, S32 height, LLRect& rect);
+	void release(const LLRect& rect);
+	// First fit, returns the start or -1
+	static S32 allocateSpan(span_list_t& spans, S32 size);
+	static void releaseSpan(span_list_t& spans, S32 start, S32 size);
+
+	S32 mWidth;
+	S32 mHeight;
+	span_list_t mFreeRows;		// rows no shelf has
+	std::vector<Shelf> mShelves;	// by mBottom
+	std::vector<Impostor> mImpostors;	// handle - 1
+	std::vector<S32> mFreeImpostors;
+	std::vector<handle_t> mScheduled;
+	S32 mNumImpostors;
+	S32 mNumPending;
+	S32 mUsedArea;
+};
+
+#endif // LL_LLIMPOSTORATLAS_H
@@ -31,6 +31,8 @@
 
 #include "llpolymesh.h"
 
+#include "apr_atomic.h"
+
 #include "llviewercontrol.h"
 #include "llxmltree.h"
 #include "llvoavatar.h"
@@ -38,6 +40,9 @@
 #include "lldir.h"
 #include "llvolume.h"
 #include "llendianswizzle.h"
+#include "llmorphaccumulator.h"
+#include "llthread.h"
+#include "llthreadpool.h"
 
 #include "llfasttimer.h"
 
@@ -46,6 +51,152 @@
 
 extern LLControlGroup gSavedSettings;				// read only
 
+// Layout of the vertex data of a mesh, allocated as a single array of
+// floats holding each array in turn. These are the offsets of the arrays
+// in floats per vertex.
+// NOTE: This makes asusmptions about the size of LLVector[234]
+enum
+{
+	COORDS_OFFSET = 0,
+	NORMALS_OFFSET = 3,
+	SCALED_NORMALS_OFFSET = 6,
+	BINORMALS_OFFSET = 9,
+	SCALED_BINORMALS_OFFSET = 12,
+	TEX_COORDS_OFFSET = 15,
+	CLOTHING_WEIGHTS_OFFSET = 17,
+	VERTEX_DATA_FLOATS = 21
+};
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::MorphJob
+// Adds the morphs recorded on a mesh to a copy of its vertices. Only
+// touches the two blocks of vertex data and its own copy of the morphs, so
+// it can run on any thread.
+//-----------------------------------------------------------------------------
+class LLPolyMesh::MorphJob : public LLThreadSafeRefCount
+{
+public:
+	// Takes the morphs and mask weights, leaving the lists empty
+	MorphJob(const F32* vertex_data, F32* morph_vertex_data, S32 num_vertices,
+			 pending_morph_list_t& morphs, std::vector<F32>& mask_weights)
+	:	mVertexData(vertex_data),
+		mMorphVertexData(morph_vertex_data),
+		mNumVertices(num_vertices)
+	{
+		mMorphs.swap(morphs);
+		mMaskWeights.swap(mask_weights);
+		apr_atomic_set32(&mState, PENDING);
+	}
+
+	// Any thread. Returns false when another thread has the job.
+	bool run();
+
+	bool isDone() { return apr_atomic_read32(&mState) == DONE; }
+
+	// Main thread. Runs the job unless a worker has it, then waits for it.
+	void finish();
+
+	// Main thread. Makes sure the job is not running and never will.
+	void cancel();
+
+protected:
+	/*virtual*/ ~MorphJob() {}
+
+private:
+	enum EState
+	{
+		PENDING = 0,
+		RUNNING = 1,
+		DONE = 2
+	};
+
+	volatile apr_uint32_t mState;
+	const F32* mVertexData;
+	F32* mMorphVertexData;
+	S32 mNumVertices;
+	pending_morph_list_t mMorphs;
+	std::vector<F32> mMaskWeights;
+};
+
+// Runs a morph job on a worker, holding a reference to it in case the
+// mesh is done with it first
+class LLPolyMesh::MorphTask : public LLThreadPool::Task
+{
+public:
+	MorphTask(MorphJob* job) : mJob(job) {}
+	/*virtual*/ void executeTask()
+	{
+		mJob->run();
+		// The pool does not own its tasks
+		delete this;
+	}
+private:
+	LLPointer<MorphJob> mJob;
+};
+
+bool LLPolyMesh::MorphJob::run()
+{
+	if (apr_atomic_cas32(&mState, RUNNING, PENDING) != PENDING)
+	{
+		return false;
+	}
+
+	const S32 num_vertices = mNumVertices;
+	memcpy(mMorphVertexData, mVertexData, sizeof(F32) * VERTEX_DATA_FLOATS * num_vertices);	/*Flawfinder: ignore*/
+
+	F32* data = mMorphVertexData;
+	LLMorphAccumulator accumulator(num_vertices,
+								   (LLVector3*)(data + COORDS_OFFSET * num_vertices),
+								   (LLVector3*)(data + NORMALS_OFFSET * num_vertices),
+								   (LLVector3*)(data + SCALED_NORMALS_OFFSET * num_vertices),
+								   (LLVector3*)(data + BINORMALS_OFFSET * num_vertices),
+								   (LLVector3*)(data + SCALED_BINORMALS_OFFSET * num_vertices),
+								   (LLVector2*)(data + TEX_COORDS_OFFSET * num_vertices),
+								   (LLVector4*)(data + CLOTHING_WEIGHTS_OFFSET * num_vertices));
+	for (pending_morph_list_t::const_iterator iter = mMorphs.begin(); iter != mMorphs.end(); ++iter)
+	{
+		const LLPolyMorphData* morph_data = iter->mMorphData;
+		accumulator.addMorph(morph_data->mNumIndices,
+							 morph_data->mVertexIndices,
+							 morph_data->mCoords,
+							 morph_data->mNormals,
+							 morph_data->mBinormals,
+							 morph_data->mTexCoords,
+							 iter->mMaskOffset < 0 ? NULL : &mMaskWeights[iter->mMaskOffset],
+							 iter->mWeight,
+							 NORMAL_SOFTEN_FACTOR,
+							 iter->mIsClothingMorph);
+	}
+	accumulator.normalize();
+
+	// Full barrier, publishes the vertices to the main thread
+	apr_atomic_xchg32(&mState, DONE);
+	return true;
+}
+
+void LLPolyMesh::MorphJob::finish()
+{
+	if (!run())
+	{
+		// A worker has it, which takes a millisecond at most
+		while (!isDone())
+		{
+			LLThread::yield();
+		}
+	}
+}
+
+void LLPolyMesh::MorphJob::cancel()
+{
+	if (apr_atomic_cas32(&mState, DONE, PENDING) != PENDING)
+	{
+		while (!isDone())
+		{
+			LLThread::yield();
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Global table of loaded LLPolyMeshes
 //-----------------------------------------------------------------------------
@@ -684,6 +835,7 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 	mReferenceMesh = reference_mesh;
 	mAvatarp = NULL;
 	mVertexData = NULL;
+	mMorphVertexData = NULL;
 
 	mCurVertexCount = 0;
 	mFaceIndexCount = 0;
@@ -693,39 +845,17 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 
 	if (shared_data->isLOD() && reference_mesh)
 	{
-		mCoords = reference_mesh->mCoords;
-		mNormals = reference_mesh->mNormals;
-		mScaledNormals = reference_mesh->mScaledNormals;
-		mBinormals = reference_mesh->mBinormals;
-		mScaledBinormals = reference_mesh->mScaledBinormals;
-		mTexCoords = reference_mesh->mTexCoords;
-		mClothingWeights = reference_mesh->mClothingWeights;
+		// Renders the vertices of the reference mesh, whichever block of
+		// vertex data is current
+		mVertexMesh = reference_mesh;
+		setVertexData(NULL);
 	}
 	else
 	{
-#if 1	// Allocate memory without initializing every vector
-		// NOTE: This makes asusmptions about the size of LLVector[234]
-		int nverts = mSharedData->mNumVertices;
-		int nfloats = nverts * (3*5 + 2 + 4);
-		mVertexData = new F32[nfloats];
-		int offset = 0;
-		mCoords = 				(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mNormals = 				(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mScaledNormals = 		(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mBinormals = 			(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mScaledBinormals = 		(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mTexCoords = 			(LLVector2*)(mVertexData + offset); offset += 2*nverts;
-		mClothingWeights = 	(LLVector4*)(mVertexData + offset); offset += 4*nverts;
-#else
-		mCoords = new LLVector3[mSharedData->mNumVertices];
-		mNormals = new LLVector3[mSharedData->mNumVertices];
-		mScaledNormals = new LLVector3[mSharedData->mNumVertices];
-		mBinormals = new LLVector3[mSharedData->mNumVertices];
-		mScaledBinormals = new LLVector3[mSharedData->mNumVertices];
-		mTexCoords = new LLVector2[mSharedData->mNumVertices];
-		mClothingWeights = new LLVector4[mSharedData->mNumVertices];
-		memset(mClothingWeights, 0, sizeof(LLVector4) * mSharedData->mNumVertices);
-#endif
+		// Allocate memory without initializing every vector
+		mVertexMesh = this;
+		mVertexData = new F32[mSharedData->mNumVertices * VERTEX_DATA_FLOATS];
+		setVertexData(mVertexData);
 		initializeForMorph();
 	}
 }
@@ -742,6 +872,12 @@ LLPolyMesh::~LLPolyMesh()
 		delete mJointRenderData[i];
 		mJointRenderData[i] = NULL;
 	}
+	if (mMorphJob.notNull())
+	{
+		// A worker may be writing to mMorphVertexData
+		mMorphJob->cancel();
+		mMorphJob = NULL;
+	}
 #if 0 // These are now allocated as one big uninitialized chunk
 	delete [] mCoords;
 	delete [] mNormals;
@@ -752,6 +888,7 @@ LLPolyMesh::~LLPolyMesh()
 	delete [] mTexCoords;
 #else
 	delete [] mVertexData;
+	delete [] mMorphVertexData;
 #endif
 }
 
@@ -860,7 +997,7 @@ void LLPolyMesh::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getWritableCoords()
 {
-	return mCoords;
+	return mVertexMesh->mCoords;
 }
 
 //-----------------------------------------------------------------------------
@@ -868,7 +1005,7 @@ LLVector3 *LLPolyMesh::getWritableCoords()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getWritableNormals()
 {
-	return mNormals;
+	return mVertexMesh->mNormals;
 }
 
 //-----------------------------------------------------------------------------
@@ -876,7 +1013,7 @@ LLVector3 *LLPolyMesh::getWritableNormals()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getWritableBinormals()
 {
-	return mBinormals;
+	return mVertexMesh->mBinormals;
 }
 
 
@@ -885,7 +1022,7 @@ LLVector3 *LLPolyMesh::getWritableBinormals()
 //-----------------------------------------------------------------------------
 LLVector4	*LLPolyMesh::getWritableClothingWeights()
 {
-	return mClothingWeights;
+	return mVertexMesh->mClothingWeights;
 }
 
 //-----------------------------------------------------------------------------
@@ -893,7 +1030,7 @@ LLVector4	*LLPolyMesh::getWritableClothingWeights()
 //-----------------------------------------------------------------------------
 LLVector2	*LLPolyMesh::getWritableTexCoords()
 {
-	return mTexCoords;
+	return mVertexMesh->mTexCoords;
 }
 
 //-----------------------------------------------------------------------------
@@ -901,7 +1038,7 @@ LLVector2	*LLPolyMesh::getWritableTexCoords()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getScaledNormals()
 {
-	return mScaledNormals;
+	return mVertexMesh->mScaledNormals;
 }
 
 //-----------------------------------------------------------------------------
@@ -909,7 +1046,117 @@ LLVector3 *LLPolyMesh::getScaledNormals()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getScaledBinormals()
 {
-	return mScaledBinormals;
+	return mVertexMesh->mScaledBinormals;
+}
+
+//-----------------------------------------------------------------------------
+// setVertexData()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::setVertexData(F32* vertex_data)
+{
+	if (!vertex_data)
+	{
+		mCoords = NULL;
+		mNormals = NULL;
+		mScaledNormals = NULL;
+		mBinormals = NULL;
+		mScaledBinormals = NULL;
+		mTexCoords = NULL;
+		mClothingWeights = NULL;
+		return;
+	}
+
+	const S32 nverts = mSharedData->mNumVertices;
+	mCoords =			(LLVector3*)(vertex_data + COORDS_OFFSET * nverts);
+	mNormals =			(LLVector3*)(vertex_data + NORMALS_OFFSET * nverts);
+	mScaledNormals =	(LLVector3*)(vertex_data + SCALED_NORMALS_OFFSET * nverts);
+	mBinormals =		(LLVector3*)(vertex_data + BINORMALS_OFFSET * nverts);
+	mScaledBinormals =	(LLVector3*)(vertex_data + SCALED_BINORMALS_OFFSET * nverts);
+	mTexCoords =		(LLVector2*)(vertex_data + TEX_COORDS_OFFSET * nverts);
+	mClothingWeights =	(LLVector4*)(vertex_data + CLOTHING_WEIGHTS_OFFSET * nverts);
+}
+
+//-----------------------------------------------------------------------------
+// addMorph()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::addMorph(LLPolyMorphData* morph_data, const F32* mask_weights, F32 weight, BOOL is_clothing_morph)
+{
+	llassert(!isLOD());
+
+	PendingMorph morph;
+	morph.mMorphData = morph_data;
+	morph.mMaskOffset = -1;
+	if (mask_weights)
+	{
+		morph.mMaskOffset = (S32)mPendingMaskWeights.size();
+		mPendingMaskWeights.insert(mPendingMaskWeights.end(), mask_weights, mask_weights + morph_data->mNumIndices);
+	}
+	morph.mWeight = weight;
+	morph.mIsClothingMorph = is_clothing_morph;
+	mPendingMorphs.push_back(morph);
+}
+
+//-----------------------------------------------------------------------------
+// updateMorphs()
+//-----------------------------------------------------------------------------
+BOOL LLPolyMesh::updateMorphs(LLThreadPool* pool)
+{
+	BOOL changed = FALSE;
+	if (mMorphJob.notNull())
+	{
+		if (!mMorphJob->isDone())
+		{
+			return FALSE;
+		}
+		swapMorphedVertices();
+		changed = TRUE;
+	}
+
+	if (!mPendingMorphs.empty())
+	{
+		if (!mMorphVertexData)
+		{
+			mMorphVertexData = new F32[mSharedData->mNumVertices * VERTEX_DATA_FLOATS];
+		}
+		mMorphJob = new MorphJob(mVertexData, mMorphVertexData, mSharedData->mNumVertices,
+								 mPendingMorphs, mPendingMaskWeights);
+		if (pool)
+		{
+			pool->post(new MorphTask(mMorphJob), LLThreadPool::CLASS_HIGH);
+		}
+		else
+		{
+			mMorphJob->run();
+			swapMorphedVertices();
+			changed = TRUE;
+		}
+	}
+	return changed;
+}
+
+//-----------------------------------------------------------------------------
+// finishMorphs()
+//-----------------------------------------------------------------------------
+BOOL LLPolyMesh::finishMorphs()
+{
+	BOOL changed = FALSE;
+	if (mMorphJob.notNull())
+	{
+		mMorphJob->finish();
+		swapMorphedVertices();
+		changed = TRUE;
+	}
+	return updateMorphs(NULL) || changed;
+}
+
+//-----------------------------------------------------------------------------
+// swapMorphedVertices()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::swapMorphedVertices()
+{
+	mMorphJob = NULL;
+	std::swap(mVertexData, mMorphVertexData);
+	setVertexData(mVertexData);
 }
 
 
@@ -29,6 +29,7 @@
 
 #include <string>
 #include <map>
+#include "llpointer.h"
 #include "llstl.h"
 
 #include "v3math.h"
@@ -39,6 +40,7 @@
 //#include "lldarray.h"
 
 class LLSkinJoint;
+class LLThreadPool;
 class LLVOAvatar;
 class LLWearable;
 
@@ -218,7 +220,7 @@ public:
 
 	// Get coords
 	const LLVector3	*getCoords() const{
-		return mCoords;
+		return mVertexMesh->mCoords;
 	}
 
 	// non const version
@@ -226,12 +228,12 @@ public:
 
 	// Get normals
 	const LLVector3	*getNormals() const{ 
-		return mNormals; 
+		return mVertexMesh->mNormals; 
 	}
 
 	// Get normals
 	const LLVector3	*getBinormals() const{ 
-		return mBinormals; 
+		return mVertexMesh->mBinormals; 
 	}
 
 	// Get base mesh normals
@@ -255,7 +257,7 @@ public:
 
 	// Get texCoords
 	const LLVector2	*getTexCoords() const { 
-		return mTexCoords; 
+		return mVertexMesh->mTexCoords; 
 	}
 
 	// non const version
@@ -279,7 +281,7 @@ public:
 
 	const LLVector4		*getClothingWeights()
 	{
-		return mClothingWeights;	
+		return mVertexMesh->mClothingWeights;	
 	}
 
 	//--------------------------------------------------------------------
@@ -322,6 +324,28 @@ public:
 	void setAvatar(LLVOAvatar* avatarp) { mAvatarp = avatarp; }
 	LLVOAvatar* getAvatar() { return mAvatarp; }
 
+	//--------------------------------------------------------------------
+	// Morphing
+	// Morph targets do not change the vertices directly. They record their
+	// deltas with addMorph() and a morph job adds them to a copy of the
+	// vertices, on a worker thread or right away. The copy is swapped in by
+	// the first updateMorphs() after the job is done, so the vertices being
+	// rendered never change under the main thread.
+	//--------------------------------------------------------------------
+	// Records weight times the deltas of morph_data for the next morph
+	// job. mask_weights, if not NULL, has a weight per morph vertex and is
+	// copied.
+	void addMorph(LLPolyMorphData* morph_data, const F32* mask_weights, F32 weight, BOOL is_clothing_morph);
+
+	// Swaps in the vertices of the last morph job if it is done and starts
+	// a job adding the morphs recorded since, on pool or without one right
+	// here. Returns TRUE when the vertices changed.
+	BOOL updateMorphs(LLThreadPool* pool);
+
+	// Waits for the morph job and adds all the morphs recorded since, so
+	// the vertices can be changed directly. Returns TRUE when they changed.
+	BOOL finishMorphs();
+
 	LLDynamicArray<LLJointRenderData*>	mJointRenderData;
 
 	U32				mFaceVertexOffset;
@@ -332,6 +356,25 @@ public:
 private:
 	void initializeForMorph();
 
+	// Points the vertex arrays at a block of vertex data
+	void setVertexData(F32* vertex_data);
+
+	// Makes the vertices of the morph job the current ones
+	void swapMorphedVertices();
+
+	class MorphJob;
+	class MorphTask;
+
+	// A morph recorded by addMorph()
+	struct PendingMorph
+	{
+		LLPolyMorphData*	mMorphData;
+		S32					mMaskOffset;	// in mPendingMaskWeights, -1 when not masked
+		F32					mWeight;
+		BOOL				mIsClothingMorph;
+	};
+	typedef std::vector<PendingMorph> pending_morph_list_t;
+
 	// Dumps diagnostic information about the global mesh table
 	static void dumpDiagInfo();
 
@@ -340,6 +383,8 @@ protected:
 	LLPolyMeshSharedData	*mSharedData;
 	// Single array of floats for allocation / deletion
 	F32						*mVertexData;
+	// copy of mVertexData the morph job works on
+	F32						*mMorphVertexData;
 	// deformed vertices (resulting from application of morph targets)
 	LLVector3				*mCoords;
 	// deformed normals (resulting from application of morph targets)
@@ -356,6 +401,14 @@ protected:
 	LLVector2				*mTexCoords;
 	
 	LLPolyMesh				*mReferenceMesh;
+	// mesh whose arrays this one renders, the reference mesh for an LOD
+	LLPolyMesh				*mVertexMesh;
+
+	// morphs waiting for the next morph job
+	pending_morph_list_t	mPendingMorphs;
+	std::vector<F32>		mPendingMaskWeights;
+	// running or done, not swapped in yet
+	LLPointer<MorphJob>		mMorphJob;
 
 	// global mesh list
 	typedef std::map<std::string, LLPolyMeshSharedData*> LLPolyMeshSharedDataTable; 
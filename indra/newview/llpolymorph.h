@@ -38,6 +38,9 @@ class LLVector2;
 class LLViewerJointCollisionVolume;
 class LLWearable;
 
+// Scales the normal and binormal deltas of morph targets
+const F32 NORMAL_SOFTEN_FACTOR = 0.65f;
+
 //-----------------------------------------------------------------------------
 // LLPolyMorphData()
 //-----------------------------------------------------------------------------
@@ -42,9 +42,13 @@
 #include "lloctree.h"
 #include "llvoavatar.h"
 #include "lltextureatlas.h"
+#include "llthreadpool.h"
 
 static LLFastTimer::DeclareTimer FTM_FRUSTUM_CULL("Frustum Culling");
 static LLFastTimer::DeclareTimer FTM_CULL_REBOUND("Cull Rebound");
+static LLFastTimer::DeclareTimer FTM_CULL_THREADED("Threaded Frustum Culling");
+static LLFastTimer::DeclareTimer FTM_CULL_WAIT("Cull Wait For Workers");
+static LLFastTimer::DeclareTimer FTM_CULL_REPLAY("Cull Occlusion Replay");
 
 const F32 SG_OCCLUSION_FUDGE = 0.25f;
 #define SG_DISCARD_TOLERANCE 0.01f
@@ -1758,11 +1762,29 @@ void LLSpatialPartition::shift(const LLVector3 &offset)
 	shifter.traverse(mOctree);
 }
 
+// A group the walk of a threaded cull entered, see LLOctreeCull::record()
+struct LLCullNode
+{
+	LLCullNode(LLSpatialGroup* group)
+		: mGroup(group), mEnd(0), mProcess(FALSE) { }
+	LLSpatialGroup* mGroup;
+	U32 mEnd;		// index of the first node past this one's subtree
+	BOOL mProcess;	// objects in the frustum, processGroup() it
+};
+typedef std::vector<LLCullNode> cull_node_list_t;
+
+// Most children an octree node has
+const U32 MAX_OCTREE_CHILDREN = 8;
+
 class LLOctreeCull : public LLSpatialGroup::OctreeTraveler
 {
 public:
 	LLOctreeCull(LLCamera* camera)
-		: mCamera(camera), mRes(0) { }
+		: mCamera(camera), mRes(0), mChecked(-1)
+	{
+		mNumPlanes = camera->getBatchPlanes(mPlanes, FALSE);
+		mNumNoFarClipPlanes = camera->getBatchPlanes(mNoFarClipPlanes, TRUE);
+	}
 
 	virtual bool earlyFail(LLSpatialGroup* group)
 	{
@@ -1783,6 +1805,10 @@ public:
 	{
 		LLSpatialGroup* group = (LLSpatialGroup*) n->getListener(0);
 
+		// frustum check done with the siblings, if any
+		S32 checked = mChecked;
+		mChecked = -1;
+
 		if (earlyFail(group))
 		{
 			return;
@@ -1791,20 +1817,54 @@ public:
 		if (mRes == 2 || 
 			(mRes && group->isState(LLSpatialGroup::SKIP_FRUSTUM_CHECK)))
 		{	//fully in, just add everything
-			LLSpatialGroup::OctreeTraveler::traverse(n);
+			traverseChildren(n);
 		}
 		else
 		{
-			mRes = frustumCheck(group);
+			mRes = checked < 0 ? frustumCheck(group) : checked;
 				
 			if (mRes)
 			{ //at least partially in, run on down
-				LLSpatialGroup::OctreeTraveler::traverse(n);
+				traverseChildren(n);
 			}
 
 			mRes = 0;
 		}
 	}
+
+	// LLOctreeTraveler::traverse(), with the children's frustum checks in
+	// one batch unless they are all in
+	void traverseChildren(const LLSpatialGroup::OctreeNode* n)
+	{
+		n->accept(this);
+
+		S32 checked[MAX_OCTREE_CHILDREN];
+		bool batched = mRes != 2 && frustumCheckChildren(n, checked);
+		for (U32 i = 0; i < n->getChildCount(); i++)
+		{
+			mChecked = batched ? checked[i] : -1;
+			traverse(n->getChild(i));
+		}
+	}
+
+	// frustumCheck() of each of n's children, false when there are too few
+	// to batch
+	bool frustumCheckChildren(const LLSpatialGroup::OctreeNode* n, S32* results)
+	{
+		U32 count = n->getChildCount();
+		if (count < 2 || count > MAX_OCTREE_CHILDREN)
+		{
+			return false;
+		}
+
+		const LLSpatialGroup* groups[MAX_OCTREE_CHILDREN];
+		for (U32 i = 0; i < count; i++)
+		{
+			groups[i] = (LLSpatialGroup*) n->getChild(i)->getListener(0);
+		}
+		frustumCheckBatch(groups, count, results);
+		return true;
+	}
 	
 	virtual S32 frustumCheck(const LLSpatialGroup* group)
 	{
@@ -1816,6 +1876,25 @@ public:
 		return res;
 	}
 
+	// frustumCheck() of count groups, a culler overriding one overrides both
+	virtual void frustumCheckBatch(const LLSpatialGroup* const* groups, U32 count, S32* results)
+	{
+		const LLVector3* bounds[MAX_OCTREE_CHILDREN];
+		for (U32 i = 0; i < count; i++)
+		{
+			bounds[i] = groups[i]->mBounds;
+		}
+		LLCamera::AABBInPlanesBatch(mNoFarClipPlanes, mNumNoFarClipPlanes, bounds, count, results);
+
+		for (U32 i = 0; i < count; i++)
+		{
+			if (results[i] != 0)
+			{
+				results[i] = llmin(results[i], AABBSphereIntersect(groups[i]->mExtents[0], groups[i]->mExtents[1], mCamera->getOrigin(), mCamera->mFrustumCornerDist));
+			}
+		}
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		S32 res = mCamera->AABBInFrustumNoFarClip(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -1871,8 +1950,76 @@ public:
 		}
 	}
 
+	// The frustum checks of traverse(), safe on any thread as they only read
+	// the octree. Appends the groups entered to nodes in traversal order,
+	// leaving the occlusion checks to replay(). res is the frustum result of
+	// n's parent. As occluded subtrees aren't known here, each child gets its
+	// parent's result rather than the one its previous sibling left.
+	// checked is n's frustum result when it was batched with its siblings.
+	// Returns n's frustum result.
+	S32 record(const LLSpatialGroup::OctreeNode* n, S32 res, cull_node_list_t& nodes, bool children,
+			   S32 checked = -1)
+	{
+		LLSpatialGroup* group = (LLSpatialGroup*) n->getListener(0);
+		U32 index = nodes.size();
+		nodes.push_back(LLCullNode(group));
+
+		mRes = res;
+		if (mRes != 2 &&
+			(!mRes || !group->isState(LLSpatialGroup::SKIP_FRUSTUM_CHECK)))
+		{
+			mRes = checked < 0 ? frustumCheck(group) : checked;
+		}
+
+		S32 node_res = mRes;
+		if (node_res)
+		{
+			nodes[index].mProcess = checkObjects(n, group);
+			if (children)
+			{
+				S32 child_checked[MAX_OCTREE_CHILDREN];
+				bool batched = node_res != 2 && frustumCheckChildren(n, child_checked);
+				for (U32 i = 0; i < n->getChildCount(); i++)
+				{
+					record(n->getChild(i), node_res, nodes, true, batched ? child_checked[i] : -1);
+				}
+			}
+		}
+
+		nodes[index].mEnd = nodes.size();
+		mRes = res;
+		return node_res;
+	}
+
+	// Main thread, does what traverse() would have for the recorded groups
+	void replay(const cull_node_list_t& nodes)
+	{
+		U32 i = 0;
+		while (i < nodes.size())
+		{
+			const LLCullNode& node = nodes[i];
+			if (earlyFail(node.mGroup))
+			{
+				i = node.mEnd;
+				continue;
+			}
+			if (node.mProcess)
+			{
+				processGroup(node.mGroup);
+			}
+			i++;
+		}
+	}
+
 	LLCamera *mCamera;
 	S32 mRes;
+	S32 mChecked;	// for the next traverse(), -1 when not batched
+
+	// For the batched frustum checks
+	LLCamera::BatchPlane mPlanes[LLCamera::MAX_BATCH_PLANES];
+	U32 mNumPlanes;
+	LLCamera::BatchPlane mNoFarClipPlanes[LLCamera::MAX_BATCH_PLANES];
+	U32 mNumNoFarClipPlanes;
 };
 
 class LLOctreeCullNoFarClip : public LLOctreeCull
@@ -1886,6 +2033,16 @@ public:
 		return mCamera->AABBInFrustumNoFarClip(group->mBounds[0], group->mBounds[1]);
 	}
 
+	virtual void frustumCheckBatch(const LLSpatialGroup* const* groups, U32 count, S32* results)
+	{
+		const LLVector3* bounds[MAX_OCTREE_CHILDREN];
+		for (U32 i = 0; i < count; i++)
+		{
+			bounds[i] = groups[i]->mBounds;
+		}
+		LLCamera::AABBInPlanesBatch(mNoFarClipPlanes, mNumNoFarClipPlanes, bounds, count, results);
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		S32 res = mCamera->AABBInFrustumNoFarClip(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -1904,6 +2061,16 @@ public:
 		return mCamera->AABBInFrustum(group->mBounds[0], group->mBounds[1]);
 	}
 
+	virtual void frustumCheckBatch(const LLSpatialGroup* const* groups, U32 count, S32* results)
+	{
+		const LLVector3* bounds[MAX_OCTREE_CHILDREN];
+		for (U32 i = 0; i < count; i++)
+		{
+			bounds[i] = groups[i]->mBounds;
+		}
+		LLCamera::AABBInPlanesBatch(mPlanes, mNumPlanes, bounds, count, results);
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		return mCamera->AABBInFrustum(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -2236,6 +2403,205 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 	return 0;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// LLParallelCull
+
+class LLParallelCull::Batch : public LLThreadSafeRefCount
+{
+public:
+	enum ECullType
+	{
+		CULL_FAR_CLIP = 0,
+		CULL_NO_FAR_CLIP,
+		CULL_SHADOW
+	};
+
+	struct Partition
+	{
+		LLSpatialPartition* mPartition;
+		LLCamera mCamera;
+		U32 mCullType;
+		cull_node_list_t mNodes;	// the root's
+		U32 mFirstJob;
+		U32 mNumJobs;
+	};
+
+	// The walk of one child of a partition's root
+	struct Job
+	{
+		U32 mPartition;
+		const LLSpatialGroup::OctreeNode* mNode;
+		S32 mRes;
+		cull_node_list_t mNodes;
+	};
+
+	Batch() : mNextJob(0), mJobsDone(0) { }
+
+	// Any thread, records jobs until none are left
+	void runJobs()
+	{
+		U32 count = mJobs.size();
+		U32 index;
+		while ((index = mNextJob++) < count)
+		{
+			Job& job = mJobs[index];
+			Partition& part = mPartitions[job.mPartition];
+			record(part.mCullType, &part.mCamera, job.mNode, job.mRes, job.mNodes, true);
+			// Full barrier, publishes the job's nodes
+			mJobsDone++;
+		}
+	}
+
+	static S32 record(U32 cull_type, LLCamera* camera, const LLSpatialGroup::OctreeNode* node,
+					  S32 res, cull_node_list_t& nodes, bool children)
+	{
+		switch (cull_type)
+		{
+		case CULL_SHADOW:
+			{
+				LLOctreeCullShadow culler(camera);
+				return culler.record(node, res, nodes, children);
+			}
+		case CULL_NO_FAR_CLIP:
+			{
+				LLOctreeCullNoFarClip culler(camera);
+				return culler.record(node, res, nodes, children);
+			}
+		default:
+			{
+				LLOctreeCull culler(camera);
+				return culler.record(node, res, nodes, children);
+			}
+		}
+	}
+
+	std::vector<Partition> mPartitions;
+	std::vector<Job> mJobs;
+	LLAtomicU32 mNextJob;
+	LLAtomicU32 mJobsDone;
+
+protected:
+	/*virtual*/ ~Batch() { }
+};
+
+// Runs jobs on a worker, holding a reference to the batch in case the main
+// thread is done with it first
+class LLParallelCull::CullTask : public LLThreadPool::Task
+{
+public:
+	CullTask(Batch* batch) : mBatch(batch) { }
+	/*virtual*/ void executeTask()
+	{
+		mBatch->runJobs();
+		// The pool does not own its tasks
+		delete this;
+	}
+private:
+	LLPointer<Batch> mBatch;
+};
+
+LLParallelCull::LLParallelCull()
+	: mBatch(new Batch)
+{
+}
+
+LLParallelCull::~LLParallelCull()
+{
+}
+
+void LLParallelCull::addPartition(LLSpatialPartition* part, LLCamera& camera)
+{
+	LLMemType mt(LLMemType::MTYPE_SPACE_PARTITION);
+	{
+		LLFastTimer ftm(FTM_CULL_REBOUND);
+		LLSpatialGroup* group = (LLSpatialGroup*) part->mOctree->getListener(0);
+		group->rebound();
+	}
+
+	mBatch->mPartitions.push_back(Batch::Partition());
+	Batch::Partition& entry = mBatch->mPartitions.back();
+	entry.mPartition = part;
+	entry.mCamera = camera;
+	if (LLPipeline::sShadowRender)
+	{
+		entry.mCullType = Batch::CULL_SHADOW;
+	}
+	else if (part->mInfiniteFarClip || !LLPipeline::sUseFarClip)
+	{
+		entry.mCullType = Batch::CULL_NO_FAR_CLIP;
+	}
+	else
+	{
+		entry.mCullType = Batch::CULL_FAR_CLIP;
+	}
+	entry.mFirstJob = 0;
+	entry.mNumJobs = 0;
+}
+
+void LLParallelCull::cull(LLThreadPool* pool)
+{
+	LLMemType mt(LLMemType::MTYPE_SPACE_PARTITION);
+	Batch* batch = mBatch;
+	{
+		LLFastTimer ftm(FTM_CULL_THREADED);
+
+		// The roots are checked here, which also sets up the frustum
+		// checks' static tables before any worker uses them
+		for (U32 i = 0; i < batch->mPartitions.size(); i++)
+		{
+			Batch::Partition& part = batch->mPartitions[i];
+			const LLSpatialGroup::OctreeNode* root = part.mPartition->mOctree;
+			S32 res = Batch::record(part.mCullType, &part.mCamera, root, 0, part.mNodes, false);
+			part.mFirstJob = batch->mJobs.size();
+			if (res)
+			{
+				for (U32 c = 0; c < root->getChildCount(); c++)
+				{
+					batch->mJobs.push_back(Batch::Job());
+					Batch::Job& job = batch->mJobs.back();
+					job.mPartition = i;
+					job.mNode = root->getChild(c);
+					job.mRes = res;
+				}
+			}
+			part.mNumJobs = batch->mJobs.size() - part.mFirstJob;
+		}
+
+		U32 num_jobs = batch->mJobs.size();
+		if (pool && num_jobs > 1)
+		{
+			U32 num_tasks = llmin(pool->getNumWorkers(), num_jobs - 1);
+			for (U32 i = 0; i < num_tasks; i++)
+			{
+				pool->post(new CullTask(batch), LLThreadPool::CLASS_HIGH);
+			}
+		}
+		batch->runJobs();
+	}
+
+	{
+		// Only for the jobs workers are in the middle of
+		LLFastTimer ftm(FTM_CULL_WAIT);
+		while (batch->mJobsDone < batch->mJobs.size())
+		{
+			LLThread::yield();
+		}
+	}
+
+	LLFastTimer ftm(FTM_CULL_REPLAY);
+	for (U32 i = 0; i < batch->mPartitions.size(); i++)
+	{
+		// The root is never occlusion culled, its children always follow it
+		Batch::Partition& part = batch->mPartitions[i];
+		LLOctreeCull culler(&part.mCamera);
+		culler.replay(part.mNodes);
+		for (U32 j = part.mFirstJob; j < part.mFirstJob + part.mNumJobs; j++)
+		{
+			culler.replay(batch->mJobs[j].mNodes);
+		}
+	}
+}
+
 BOOL earlyFail(LLCamera* camera, LLSpatialGroup* group)
 {
 	if (camera->getOrigin().isExactlyZero())
@@ -50,6 +50,7 @@ class LLSpatialBridge;
 class LLSpatialGroup;
 class LLTextureAtlas;
 class LLTextureAtlasSlot;
+class LLThreadPool;
 
 S32 AABBSphereIntersect(const LLVector3& min, const LLVector3& max, const LLVector3 &origin, const F32 &rad);
 S32 AABBSphereIntersectR2(const LLVector3& min, const LLVector3& max, const LLVector3 &origin, const F32 &radius_squared);
@@ -542,6 +543,32 @@ private:
 };
 
 
+// Culls a frame's partitions with the frustum checks spread over a thread
+// pool. The octree below each partition's root is walked a child of the
+// root per job, recording the groups in the frustum. Occlusion queries and
+// the cull result are the main thread's, which replays the recorded walks
+// in the order the partitions were added once all jobs are done, so the
+// result doesn't depend on how the jobs were scheduled.
+class LLParallelCull
+{
+public:
+	LLParallelCull();
+	~LLParallelCull();
+
+	// Rebounds the partition's octree and keeps a copy of camera, with its
+	// user clip plane, to cull it against
+	void addPartition(LLSpatialPartition* part, LLCamera& camera);
+	// Main thread. Runs the jobs here and, when pool is not NULL, on its
+	// workers, then marks the groups not culled as LLSpatialPartition::cull()
+	// would have.
+	void cull(LLThreadPool* pool);
+
+private:
+	class Batch;
+	class CullTask;
+	LLPointer<Batch> mBatch;
+};
+
 //spatial partition for water (implemented in LLVOWater.cpp)
 class LLWaterPartition : public LLSpatialPartition
 {
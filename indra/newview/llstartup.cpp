@@ -609,6 +609,7 @@ bool idle_startup()
 
 			F32 dropPercent = gSavedSettings.getF32("PacketDropPercentage");
 			msg->mPacketRing.setDropPercentage(dropPercent);
+			msg->mPacketRing.setReceiveBatchSize(gSavedSettings.getS32("PacketReceiveBatchSize"));
 
             F32 inBandwidth = gSavedSettings.getF32("InBandwidth"); 
             F32 outBandwidth = gSavedSettings.getF32("OutBandwidth"); 
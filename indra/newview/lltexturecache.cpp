@@ -38,17 +38,22 @@
 #include "llappviewer.h" 
 
 // Cache organization:
-// cache/texture.entries
+// cache/texturecache/texture.index
+//  Memory mapped hash table of Entry structs, see lltexturecacheindex.h
+// cache/texturecache/texture.header
+//  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture, in the record given by its entry in texture.index
+// cache/texturecache/[0-F]/UUID.texture
+//  Actual texture body files
+//
+// Legacy organization (imported into the index on first run, then deleted):
+// cache/texturecache/texture.entries
 //  Unordered array of Entry structs
-// cache/texture.cache
+// cache/texturecache/texture.cache
 //  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
-// cache/textures/[0-F]/UUID.texture
-//  Actual texture body files
 
 //note: there is no good to define 1024 for TEXTURE_CACHE_ENTRY_SIZE while FIRST_PACKET_SIZE is 600 on sim side.
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE;//1024;
 const F32 TEXTURE_CACHE_PURGE_AMOUNT = .20f; // % amount to reduce the cache by when it exceeds its limit
-const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead to regenerate)
 
 class LLTextureCacheWorker : public LLWorkerClass
 {
@@ -413,7 +418,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		}
 	}
 
-	// Third state / stage : read data from the header cache (texture.entries) file
+	// Third state / stage : read data from the header cache (texture.header) file
 	if (!done && (mState == HEADER))
 	{
 		llassert_always(idx >= 0);	// we need an entry here or reading the header makes no sense
@@ -541,7 +546,7 @@ bool LLTextureCacheRemoteWorker::doWrite()
 	
 	// No LOCAL state for write(): because it doesn't make much sense to cache a local file...
 
-	// Second state / stage : set an entry in the headers entry (texture.entries) file
+	// Second state / stage : set an entry in the index (texture.index)
 	if (!done && (mState == CACHE))
 	{
 		bool alreadyCached = false;
@@ -580,7 +585,7 @@ bool LLTextureCacheRemoteWorker::doWrite()
 		}
 	}
 
-	// Third stage / state : write the header record in the header file (texture.cache)
+	// Third stage / state : write the header record in the header file (texture.header)
 	if (!done && (mState == HEADER))
 	{
 		llassert_always(idx >= 0);	// we need an entry here or storing the header makes no sense
@@ -732,14 +737,12 @@ void LLTextureCacheWorker::endWork(S32 param, bool aborted)
 
 //////////////////////////////////////////////////////////////////////////////
 
-LLTextureCache::LLTextureCache(bool threaded)
-	: LLWorkerThread("TextureCache", threaded),
+LLTextureCache::LLTextureCache(bool threaded, LLThreadPool* pool)
+	: LLWorkerThread("TextureCache", threaded, pool),
 	  mWorkersMutex(NULL),
 	  mHeaderMutex(NULL),
 	  mListMutex(NULL),
-	  mHeaderAPRFile(NULL),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
-	  mTexturesSizeTotal(0),
 	  mDoPurge(FALSE)
 {
 }
@@ -747,7 +750,7 @@ LLTextureCache::LLTextureCache(bool threaded)
 LLTextureCache::~LLTextureCache()
 {
 	clearDeleteList() ;
-	writeUpdatedEntries() ;
+	mIndex.close() ;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -755,9 +758,6 @@ LLTextureCache::~LLTextureCache()
 //virtual
 S32 LLTextureCache::update(U32 max_time_ms)
 {
-	static LLFrameTimer timer ;
-	static const F32 MAX_TIME_INTERVAL = 300.f ; //seconds.
-
 	S32 res;
 	res = LLWorkerThread::update(max_time_ms);
 
@@ -792,12 +792,6 @@ S32 LLTextureCache::update(U32 max_time_ms)
 		bool success = iter1->second;
 		responder->completed(success);
 	}
-	
-	if(!res && timer.getElapsedTimeF32() > MAX_TIME_INTERVAL)
-	{
-		timer.reset() ;
-		writeUpdatedEntries() ;
-	}
 
 	return res;
 }
@@ -824,10 +818,8 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
-	LLMutexLock lock(&mHeaderMutex);
-	id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-	
-	return (iter != mHeaderIDMap.end()) ;
+	Entry entry;
+	return (mIndex.find(id, entry) >= 0) ;
 }
 
 //debug
@@ -873,9 +865,11 @@ BOOL LLTextureCache::isInLocal(const LLUUID& id)
 
 //static
 const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
-F32 LLTextureCache::sHeaderCacheVersion = 1.4f;
+F32 LLTextureCache::sHeaderCacheVersion = 1.4f; // version of the legacy texture.entries that can be imported
 U32 LLTextureCache::sCacheMaxEntries = MAX_REASONABLE_FILE_SIZE / TEXTURE_CACHE_ENTRY_SIZE;
 S64 LLTextureCache::sCacheMaxTexturesSize = 0; // no limit
+const char* index_filename = "texture.index";
+const char* header_filename = "texture.header";
 const char* entries_filename = "texture.entries";
 const char* cache_filename = "texture.cache";
 const char* old_textures_dirname = "textures";
@@ -886,8 +880,10 @@ void LLTextureCache::setDirNames(ELLPath location)
 {
 	std::string delem = gDirUtilp->getDirDelimiter();
 
-	mHeaderEntriesFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, entries_filename);
-	mHeaderDataFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, cache_filename);
+	mIndexFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, index_filename);
+	mHeaderDataFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, header_filename);
+	mLegacyEntriesFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, entries_filename);
+	mLegacyHeaderDataFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, cache_filename);
 	mTexturesDirName = gDirUtilp->getExpandedFilename(location, textures_dirname);
 }
 
@@ -898,7 +894,6 @@ void LLTextureCache::purgeCache(ELLPath location)
 	if (!mReadOnly)
 	{
 		setDirNames(location);
-		llassert_always(mHeaderAPRFile == NULL);
 
 		//remove the legacy cache if exists
 		std::string texture_dir = mTexturesDirName ;
@@ -971,7 +966,7 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 		}
 	}
 	readHeaderCache();
-	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
+	purgeTextures(true); // make some room in the texture cache if we need it
 
 	llassert_always(getPending() == 0) ; //should not start accessing the texture cache before initialized.
 
@@ -979,512 +974,177 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 }
 
 //----------------------------------------------------------------------------
-// mHeaderMutex must be locked for the following functions!
 
-LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
+// Called from the main thread
+void LLTextureCache::readHeaderCache()
 {
-	llassert_always(mHeaderAPRFile == NULL);
-	apr_int32_t flags = readonly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_BINARY;
-	mHeaderAPRFile = new LLAPRFile(mHeaderEntriesFileName, flags, getLocalAPRFilePool());
-	if(offset > 0)
-	{
-		mHeaderAPRFile->seek(APR_SET, offset);
-	}
-	return mHeaderAPRFile;
-}
+	LLMutexLock lock(&mHeaderMutex);
 
-void LLTextureCache::closeHeaderEntriesFile()
-{
-	if(!mHeaderAPRFile)
+	bool created = false;
+	if (!mIndex.open(mIndexFileName, sCacheMaxEntries, mReadOnly, created))
 	{
-		return ;
+		if (!mReadOnly)
+		{
+			clearCorruptedCache();
+		}
+		return;
 	}
 
-	delete mHeaderAPRFile;
-	mHeaderAPRFile = NULL;
-}
-
-void LLTextureCache::readEntriesHeader()
-{
-	// mHeaderEntriesInfo initializes to default values so safe not to read it
-	llassert_always(mHeaderAPRFile == NULL);
-	if (LLAPRFile::isExist(mHeaderEntriesFileName, getLocalAPRFilePool()))
+	if (mReadOnly)
 	{
-		LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
-						  getLocalAPRFilePool());
+		return;
 	}
-	else //create an empty entries header.
+
+	if (created)
 	{
-		mHeaderEntriesInfo.mVersion = sHeaderCacheVersion ;
-		mHeaderEntriesInfo.mEntries = 0 ;
-		writeEntriesHeader() ;
+		importLegacyEntries();
 	}
-}
-
-void LLTextureCache::writeEntriesHeader()
-{
-	llassert_always(mHeaderAPRFile == NULL);
-	if (!mReadOnly)
+	else if (mIndex.getNumSlots() != LLTextureCacheIndex::NUM_SHARDS * LLTextureCacheIndex::getSlotsPerShard(sCacheMaxEntries))
 	{
-		LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
-						   getLocalAPRFilePool());
+		// Special case: cache size was changed, the index needs to be rebuilt
+		resizeIndex();
 	}
 }
 
-//mHeaderMutex is locked before calling this.
-S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
+// Moves the entries of a cache written by a viewer using texture.entries into the index.
+// mHeaderMutex must be locked before calling this.
+void LLTextureCache::importLegacyEntries()
 {
-	S32 idx = -1;
-	
-	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-	if (iter1 != mHeaderIDMap.end())
+	if (!LLAPRFile::isExist(mLegacyEntriesFileName, getLocalAPRFilePool()))
 	{
-		idx = iter1->second;
+		return;
 	}
 
-	if (idx < 0)
+	LLTextureCacheIndex::entry_list_t entries;
+	bool valid = false;
 	{
-		if (create && !mReadOnly)
+		LLAPRFile infile(mLegacyEntriesFileName, LL_APR_RB, getLocalAPRFilePool());
+		EntriesInfo info;
+		if (infile.read((void*)&info, (S32)sizeof(EntriesInfo)) == sizeof(EntriesInfo)
+			&& info.mVersion == sHeaderCacheVersion)
 		{
-			if (mHeaderEntriesInfo.mEntries < sCacheMaxEntries)
-			{
-				// Add an entry to the end of the list
-				idx = mHeaderEntriesInfo.mEntries++;
-
-			}
-			else if (!mFreeList.empty())
+			valid = true;
+			entries.reserve(info.mEntries);
+			for (U32 idx = 0; idx < info.mEntries; idx++)
 			{
-				idx = *(mFreeList.begin());
-				mFreeList.erase(mFreeList.begin());
-			}
-			else
-			{
-				// Look for a still valid entry in the LRU
-				for (std::set<LLUUID>::iterator iter2 = mLRU.begin(); iter2 != mLRU.end();)
+				Entry entry;
+				if (infile.read((void*)&entry, (S32)sizeof(Entry)) != sizeof(Entry))
 				{
-					std::set<LLUUID>::iterator curiter2 = iter2++;
-					LLUUID oldid = *curiter2;
-					// Erase entry from LRU regardless
-					mLRU.erase(curiter2);
-					// Look up entry and use it if it is valid
-					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
-					{
-						idx = iter3->second;
-						removeCachedTexture(oldid) ;//remove the existing cached texture to release the entry index.
-						break;
-					}
+					llwarns << "Corrupted header entries, failed at " << idx << " / " << info.mEntries << llendl;
+					valid = false;
+					break;
 				}
-				// if (idx < 0) at this point, we will rebuild the LRU 
-				//  and retry if called from setHeaderCacheEntry(),
-				//  otherwise this shouldn't happen and will trigger an error
-			}
-			if (idx >= 0)
-			{
-				entry.mID = id ;
-				entry.mImageSize = -1 ; //mark it is a brand-new entry.					
-				entry.mBodySize = 0 ;
+				entries.push_back(std::make_pair((S32)idx, entry));
 			}
 		}
 	}
-	else
-	{
-		// Remove this entry from the LRU if it exists
-		mLRU.erase(id);
-		// Read the entry
-		idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx) ;
-		if(iter != mUpdatedEntryMap.end())
-		{
-			entry = iter->second ;
-		}
-		else
-		{
-			readEntryFromHeaderImmediately(idx, entry) ;
-		}
-		if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
-		{
-			llwarns << "corrupted entry: " << id << " entry image size: " << entry.mImageSize << " entry body size: " << entry.mBodySize << llendl ;
-
-			//erase this entry and the cached texture from the cache.
-			std::string tex_filename = getTextureFileName(id);
-			removeEntry(idx, entry, tex_filename) ;
-			mUpdatedEntryMap.erase(idx) ;
-			idx = -1 ;
-		}
-	}
-	return idx;
-}
 
-//mHeaderMutex is locked before calling this.
-void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
-{	
-	LLAPRFile* aprfile ;
-	S32 bytes_written ;
-	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-	if(write_header)
-	{
-		aprfile = openHeaderEntriesFile(false, 0);		
-		bytes_written = aprfile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo)) ;
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache() ; //clear the cache.
-			idx = -1 ;//mark the idx invalid.
-			return ;
-		}
-
-		mHeaderAPRFile->seek(APR_SET, offset);
-	}
-	else
+	if (valid)
 	{
-		aprfile = openHeaderEntriesFile(false, offset);
+		llinfos << "Importing " << entries.size() << " texture cache entries from " << mLegacyEntriesFileName << llendl;
+		importEntries(entries, mLegacyHeaderDataFileName);
 	}
-	bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-	if(bytes_written != sizeof(Entry))
+	else
 	{
-		clearCorruptedCache() ; //clear the cache.
-		idx = -1 ;//mark the idx invalid.
-
-		return ;
+		// Nothing tells what the body files are, start over
+		purgeAllTextures(false);
 	}
 
-	closeHeaderEntriesFile();
-	mUpdatedEntryMap.erase(idx) ;
+	LLAPRFile::remove(mLegacyEntriesFileName, getLocalAPRFilePool());
+	LLAPRFile::remove(mLegacyHeaderDataFileName, getLocalAPRFilePool());
 }
 
-//mHeaderMutex is locked before calling this.
-void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
+// Rebuilds the index with the number of slots of the current cache size.
+// mHeaderMutex must be locked before calling this.
+void LLTextureCache::resizeIndex()
 {
-	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-	LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
-	S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
-	closeHeaderEntriesFile();
+	llinfos << "Texture cache index has " << mIndex.getNumSlots() << " slots, resizing it for "
+			<< sCacheMaxEntries << " entries." << llendl;
 
-	if(bytes_read != sizeof(Entry))
-	{
-		clearCorruptedCache() ; //clear the cache.
-		idx = -1 ;//mark the idx invalid.
-	}
-}
+	LLTextureCacheIndex::entry_list_t entries;
+	mIndex.getEntries(entries);
+	mIndex.close();
 
-//mHeaderMutex is locked before calling this.
-//update an existing entry time stamp, delay writing.
-void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
-{
-	static const U32 MAX_ENTRIES_WITHOUT_TIME_STAMP = (U32)(LLTextureCache::sCacheMaxEntries * 0.75f) ;
+	std::string old_header_filename = mHeaderDataFileName + ".old";
+	LLAPRFile::remove(old_header_filename, getLocalAPRFilePool());
+	LLAPRFile::rename(mHeaderDataFileName, old_header_filename, getLocalAPRFilePool());
+	LLAPRFile::remove(mIndexFileName, getLocalAPRFilePool());
 
-	if(mHeaderEntriesInfo.mEntries < MAX_ENTRIES_WITHOUT_TIME_STAMP)
+	bool created = false;
+	if (mIndex.open(mIndexFileName, sCacheMaxEntries, false, created))
 	{
-		return ; //there are enough empty entry index space, no need to stamp time.
+		importEntries(entries, old_header_filename);
 	}
-
-	if (idx >= 0)
+	else
 	{
-		if (!mReadOnly)
-		{
-			entry.mTime = time(NULL);			
-			mUpdatedEntryMap[idx] = entry ;
-		}
+		clearCorruptedCache();
 	}
+	LLAPRFile::remove(old_header_filename, getLocalAPRFilePool());
 }
 
-//update an existing entry, write to header file immediately.
-bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
+struct lru_entry_more
 {
-	S32 new_body_size = llmax(0, new_data_size - TEXTURE_CACHE_ENTRY_SIZE) ;
-	
-	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize)
-	{
-		return true ; //nothing changed.
-	}
-	else 
+	bool operator()(const std::pair<S32, LLTextureCacheIndex::Entry>& lhs,
+					const std::pair<S32, LLTextureCacheIndex::Entry>& rhs) const
 	{
-		bool purge = false ;
-
-		lockHeaders() ;
-
-		bool update_header = false ;
-		if(entry.mImageSize < 0) //is a brand-new entry
-		{
-			mHeaderIDMap[entry.mID] = idx;
-			mTexturesSizeMap[entry.mID] = new_body_size ;
-			mTexturesSizeTotal += new_body_size ;
-			
-			// Update Header
-			update_header = true ;
-		}				
-		else if (entry.mBodySize != new_body_size)
-		{
-			//already in mHeaderIDMap.
-			mTexturesSizeMap[entry.mID] = new_body_size ;
-			mTexturesSizeTotal -= entry.mBodySize ;
-			mTexturesSizeTotal += new_body_size ;
-		}
-		entry.mTime = time(NULL);
-		entry.mImageSize = new_image_size ; 
-		entry.mBodySize = new_body_size ;
-		
-		writeEntryToHeaderImmediately(idx, entry, update_header) ;
-	
-		if (mTexturesSizeTotal > sCacheMaxTexturesSize)
-		{
-			purge = true;
-		}
-		
-		unlockHeaders() ;
-
-		if (purge)
-		{
-			mDoPurge = TRUE;
-		}
+		return lhs.second.mTime > rhs.second.mTime;
 	}
+};
 
-	return false ;
-}
-
-U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
+// Adds entries to the (empty) index, most recently used first, copying their header
+// record from the record given with each entry in header_data_filename to mHeaderDataFileName.
+// Entries which do not fit are removed along with their body file.
+// mHeaderMutex must be locked before calling this.
+void LLTextureCache::importEntries(LLTextureCacheIndex::entry_list_t& entries, const std::string& header_data_filename)
 {
-	U32 num_entries = mHeaderEntriesInfo.mEntries;
+	std::sort(entries.begin(), entries.end(), lru_entry_more());
 
-	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
-	mFreeList.clear();
-	mTexturesSizeTotal = 0;
+	LLAPRFile infile(header_data_filename, LL_APR_RB, getLocalAPRFilePool());
+	LLAPRFile outfile(mHeaderDataFileName, APR_CREATE|APR_READ|APR_WRITE|APR_BINARY, getLocalAPRFilePool());
+	U8* buffer = new U8[TEXTURE_CACHE_ENTRY_SIZE];
 
-	LLAPRFile* aprfile = NULL; 
-	if(mUpdatedEntryMap.empty())
+	LLTextureCacheIndex::entry_list_t evicted;
+	U32 imported = 0;
+	for (LLTextureCacheIndex::entry_list_t::iterator iter = entries.begin(); iter != entries.end(); ++iter)
 	{
-		aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
-	}
-	else //update the header file first.
-	{
-		aprfile = openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile() ;
-		if(!aprfile)
+		const Entry& entry = iter->second;
+		if (entry.mID.isNull() || entry.mImageSize <= 0)
 		{
-			return 0;
+			continue; // free entry
 		}
-		aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
-	}
-	for (U32 idx=0; idx<num_entries; idx++)
-	{
-		Entry entry;
-		S32 bytes_read = aprfile->read((void*)(&entry), (S32)sizeof(Entry));
-		if (bytes_read < sizeof(Entry))
-		{
-			llwarns << "Corrupted header entries, failed at " << idx << " / " << num_entries << llendl;
-			closeHeaderEntriesFile();
-			purgeAllTextures(false);
-			return 0;
-		}
-		entries.push_back(entry);
-// 		llinfos << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << llendl;
-		if(entry.mImageSize > entry.mBodySize)
-		{
-			mHeaderIDMap[entry.mID] = idx;
-			mTexturesSizeMap[entry.mID] = entry.mBodySize;
-			mTexturesSizeTotal += entry.mBodySize;
-		}
-		else
-		{
-			mFreeList.insert(idx);
-		}
-	}
-	closeHeaderEntriesFile();
-	return num_entries;
-}
-
-void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
-{
-	S32 num_entries = entries.size();
-	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
-	
-	if (!mReadOnly)
-	{
-		LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-		for (S32 idx=0; idx<num_entries; idx++)
-		{
-			S32 bytes_written = aprfile->write((void*)(&entries[idx]), (S32)sizeof(Entry));
-			if(bytes_written != sizeof(Entry))
-			{
-				clearCorruptedCache() ; //clear the cache.
-				return ;
-			}
-		}
-		closeHeaderEntriesFile();
-	}
-}
 
-void LLTextureCache::writeUpdatedEntries()
-{
-	lockHeaders() ;
-	if (!mReadOnly && !mUpdatedEntryMap.empty())
-	{
-		openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile() ;
-		closeHeaderEntriesFile();
-	}
-	unlockHeaders() ;
-}
-
-//mHeaderMutex is locked and mHeaderAPRFile is created before calling this.
-void LLTextureCache::updatedHeaderEntriesFile()
-{
-	if (!mReadOnly && !mUpdatedEntryMap.empty() && mHeaderAPRFile)
-	{
-		//entriesInfo
-		mHeaderAPRFile->seek(APR_SET, 0);
-		S32 bytes_written = mHeaderAPRFile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo)) ;
-		if(bytes_written != sizeof(EntriesInfo))
+		S32 record = -1;
+		if (entry.mImageSize > entry.mBodySize
+			&& infile.getFileHandle() && outfile.getFileHandle()
+			&& infile.seek(APR_SET, iter->first * TEXTURE_CACHE_ENTRY_SIZE) >= 0
+			&& infile.read(buffer, TEXTURE_CACHE_ENTRY_SIZE) == TEXTURE_CACHE_ENTRY_SIZE)
 		{
-			clearCorruptedCache() ; //clear the cache.
-			return ;
+			record = mIndex.insert(entry, evicted, false);
 		}
-		
-		//write each updated entry
-		S32 entry_size = (S32)sizeof(Entry) ;
-		S32 prev_idx = -1 ;
-		S32 delta_idx ;
-		for (idx_entry_map_t::iterator iter = mUpdatedEntryMap.begin(); iter != mUpdatedEntryMap.end(); ++iter)
+		if (record >= 0)
 		{
-			delta_idx = iter->first - prev_idx - 1;
-			prev_idx = iter->first ;
-			if(delta_idx)
+			if (outfile.seek(APR_SET, record * TEXTURE_CACHE_ENTRY_SIZE) >= 0
+				&& outfile.write(buffer, TEXTURE_CACHE_ENTRY_SIZE) == TEXTURE_CACHE_ENTRY_SIZE)
 			{
-				mHeaderAPRFile->seek(APR_CUR, delta_idx * entry_size);
-			}
-			
-			bytes_written = mHeaderAPRFile->write((void*)(&iter->second), entry_size);
-			if(bytes_written != entry_size)
-			{
-				clearCorruptedCache() ; //clear the cache.
-				return ;
+				++imported;
+				continue;
 			}
+			Entry removed;
+			mIndex.remove(entry.mID, removed);
 		}
-		mUpdatedEntryMap.clear() ;
+		LLAPRFile::remove(getTextureFileName(entry.mID), getLocalAPRFilePool());
 	}
-}
-//----------------------------------------------------------------------------
-
-// Called from either the main thread or the worker thread
-void LLTextureCache::readHeaderCache()
-{
-	mHeaderMutex.lock();
-
-	mLRU.clear(); // always clear the LRU
+	delete[] buffer;
 
-	readEntriesHeader();
-	
-	if (mHeaderEntriesInfo.mVersion != sHeaderCacheVersion)
-	{
-		if (!mReadOnly)
-		{
-			purgeAllTextures(false);
-		}
-	}
-	else
-	{
-		std::vector<Entry> entries;
-		U32 num_entries = openAndReadEntries(entries);
-		if (num_entries)
-		{
-			U32 empty_entries = 0;
-			typedef std::pair<U32, S32> lru_data_t;
-			std::set<lru_data_t> lru;
-			std::set<U32> purge_list;
-			for (U32 i=0; i<num_entries; i++)
-			{
-				Entry& entry = entries[i];
-				if (entry.mImageSize <= 0)
-				{
-					// This will be in the Free List, don't put it in the LRU
-					++empty_entries;
-				}
-				else
-				{
-					lru.insert(std::make_pair(entry.mTime, i));
-					if (entry.mBodySize > 0)
-					{
-						if (entry.mBodySize > entry.mImageSize)
-						{
-							// Shouldn't happen, failsafe only
-							llwarns << "Bad entry: " << i << ": " << entry.mID << ": BodySize: " << entry.mBodySize << llendl;
-							purge_list.insert(i);
-						}
-					}
-				}
-			}
-			if (num_entries > sCacheMaxEntries)
-			{
-				// Special case: cache size was reduced, need to remove entries
-				// Note: After we prune entries, we will call this again and create the LRU
-				U32 entries_to_purge = (num_entries-empty_entries) - sCacheMaxEntries;
-				llinfos << "Texture Cache Entries: " << num_entries << " Max: " << sCacheMaxEntries << " Empty: " << empty_entries << " Purging: " << entries_to_purge << llendl;
-				if (entries_to_purge > 0)
-				{
-					for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
-					{
-						purge_list.insert(iter->second);
-						if (purge_list.size() >= entries_to_purge)
-							break;
-					}
-				}
-				llassert_always(purge_list.size() >= entries_to_purge);
-			}
-			else
-			{
-				S32 lru_entries = (S32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE);
-				for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
-				{
-					mLRU.insert(entries[iter->second].mID);
-// 					llinfos << "LRU: " << iter->first << " : " << iter->second << llendl;
-					if (--lru_entries <= 0)
-						break;
-				}
-			}
-			
-			if (purge_list.size() > 0)
-			{
-				for (std::set<U32>::iterator iter = purge_list.begin(); iter != purge_list.end(); ++iter)
-				{
-					std::string tex_filename = getTextureFileName(entries[*iter].mID);
-					removeEntry((S32)*iter, entries[*iter], tex_filename);
-				}
-				// If we removed any entries, we need to rebuild the entries list,
-				// write the header, and call this again
-				std::vector<Entry> new_entries;
-				for (U32 i=0; i<num_entries; i++)
-				{
-					const Entry& entry = entries[i];
-					if (entry.mImageSize > 0)
-					{
-						new_entries.push_back(entry);
-					}
-				}
-				llassert_always(new_entries.size() <= sCacheMaxEntries);
-				mHeaderEntriesInfo.mEntries = new_entries.size();
-				writeEntriesHeader();
-				writeEntriesAndClose(new_entries);
-				mHeaderMutex.unlock(); // unlock the mutex before calling again
-				readHeaderCache(); // repeat with new entries file
-				mHeaderMutex.lock();
-			}
-			else
-			{
-				//entries are not changed, nothing here.
-			}
-		}
-	}
-	mHeaderMutex.unlock();
+	llinfos << "Texture cache: imported " << imported << " entries." << llendl;
 }
 
-//////////////////////////////////////////////////////////////////////////////
-
 //the header mutex is locked before calling this.
 void LLTextureCache::clearCorruptedCache()
 {
 	llwarns << "the texture cache is corrupted, need to be cleared." << llendl ;
 
-	closeHeaderEntriesFile();//close possible file handler
+	mIndex.close();
 	purgeAllTextures(false) ; //clear the cache.
 	
 	if (!mReadOnly) //regenerate the directory tree if not exists.
@@ -1497,6 +1157,14 @@ void LLTextureCache::clearCorruptedCache()
 			std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
 			LLFile::mkdir(dirname);
 		}
+
+		LLAPRFile::remove(mIndexFileName, getLocalAPRFilePool());
+		LLAPRFile::remove(mHeaderDataFileName, getLocalAPRFilePool());
+		bool created = false;
+		if (!mIndex.open(mIndexFileName, sCacheMaxEntries, false, created))
+		{
+			llwarns << "Unable to create the texture cache index, textures will not be cached." << llendl;
+		}
 	}
 
 	return ;
@@ -1506,6 +1174,12 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 {
 	if (!mReadOnly)
 	{
+		if (purge_directories)
+		{
+			// The index is in mTexturesDirName, it can not be deleted while mapped
+			mIndex.close();
+		}
+
 		const char* subdirs = "0123456789abcdef";
 		std::string delem = gDirUtilp->getDirDelimiter();
 		std::string mask = delem + "*";
@@ -1524,18 +1198,11 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 			gDirUtilp->deleteFilesInDir(mTexturesDirName, mask);
 			LLFile::rmdir(mTexturesDirName);
 		}		
+		else
+		{
+			mIndex.clear();
+		}
 	}
-	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
-	mTexturesSizeTotal = 0;
-	mFreeList.clear();
-	mTexturesSizeTotal = 0;
-	mUpdatedEntryMap.clear();
-
-	// Info with 0 entries
-	mHeaderEntriesInfo.mVersion = sHeaderCacheVersion;
-	mHeaderEntriesInfo.mEntries = 0;
-	writeEntriesHeader();
 
 	llinfos << "The entire texture cache is cleared." << llendl ;
 }
@@ -1557,33 +1224,19 @@ void LLTextureCache::purgeTextures(bool validate)
 
 	llinfos << "TEXTURE CACHE: Purging." << llendl;
 
-	// Read the entries list
-	std::vector<Entry> entries;
-	U32 num_entries = openAndReadEntries(entries);
-	if (!num_entries)
-	{
-		return; // nothing to purge
-	}
+	// Snapshot of the entries
+	LLTextureCacheIndex::entry_list_t entries;
+	mIndex.getEntries(entries);
+	U32 num_entries = entries.size();
 	
-	// Use mTexturesSizeMap to collect UUIDs of textures with bodies
+	// Collect the textures with bodies, oldest first
 	typedef std::set<std::pair<U32,S32> > time_idx_set_t;
 	std::set<std::pair<U32,S32> > time_idx_set;
-	for (size_map_t::iterator iter1 = mTexturesSizeMap.begin();
-		 iter1 != mTexturesSizeMap.end(); ++iter1)
+	for (U32 i = 0; i < num_entries; i++)
 	{
-		if (iter1->second > 0)
+		if (entries[i].second.mBodySize > 0)
 		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
-			{
-				S32 idx = iter2->second;
-				time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
-// 				llinfos << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << llendl;
-			}
-			else
-			{
-				llerrs << "mTexturesSizeMap / mHeaderIDMap corrupted." << llendl ;
-			}
+			time_idx_set.insert(std::make_pair(entries[i].second.mTime, (S32)i));
 		}
 	}
 	
@@ -1597,15 +1250,15 @@ void LLTextureCache::purgeTextures(bool validate)
 		LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Validating: " << validate_idx << LL_ENDL;
 	}
 
-	S64 cache_size = mTexturesSizeTotal;
+	S64 cache_size = mIndex.getBodySizeTotal();
 	S64 purged_cache_size = (sCacheMaxTexturesSize * (S64)((1.f-TEXTURE_CACHE_PURGE_AMOUNT)*100)) / 100;
 	S32 purge_count = 0;
 	for (time_idx_set_t::iterator iter = time_idx_set.begin();
 		 iter != time_idx_set.end(); ++iter)
 	{
-		S32 idx = iter->second;
+		const Entry& entry = entries[iter->second].second;
 		bool purge_entry = false;
-		std::string filename = getTextureFileName(entries[idx].mID);
+		std::string filename = getTextureFileName(entry.mID);
 		if (cache_size >= purged_cache_size)
 		{
 			purge_entry = true;
@@ -1613,14 +1266,14 @@ void LLTextureCache::purgeTextures(bool validate)
 		else if (validate)
 		{
 			// make sure file exists and is the correct size
-			U32 uuididx = entries[idx].mID.mData[0];
+			U32 uuididx = entry.mID.mData[0];
 			if (uuididx == validate_idx)
 			{
- 				LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entries[idx].mBodySize << LL_ENDL;
+ 				LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entry.mBodySize << LL_ENDL;
 				S32 bodysize = LLAPRFile::size(filename, getLocalAPRFilePool());
-				if (bodysize != entries[idx].mBodySize)
+				if (bodysize != entry.mBodySize)
 				{
-					LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entries[idx].mBodySize
+					LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entry.mBodySize
 							<< filename << LL_ENDL;
 					purge_entry = true;
 				}
@@ -1635,22 +1288,22 @@ void LLTextureCache::purgeTextures(bool validate)
 		{
 			purge_count++;
 	 		LL_DEBUGS("TextureCache") << "PURGING: " << filename << LL_ENDL;
-			removeEntry(idx, entries[idx], filename) ;
-			cache_size -= entries[idx].mBodySize;
+			Entry removed;
+			if (mIndex.remove(entry.mID, removed) >= 0)
+			{
+				cache_size -= removed.mBodySize;
+			}
+			LLAPRFile::remove(filename, getLocalAPRFilePool());
 		}
 	}
 
-	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Writing Entries: " << num_entries << LL_ENDL;
-
-	writeEntriesAndClose(entries);
-	
 	// *FIX:Mani - watchdog back on.
 	LLAppViewer::instance()->resumeMainloopTimeout();
 	
 	LL_INFOS("TextureCache") << "TEXTURE CACHE:"
 			<< " PURGED: " << purge_count
 			<< " ENTRIES: " << num_entries
-			<< " CACHE SIZE: " << mTexturesSizeTotal / 1024*1024 << " MB"
+			<< " CACHE SIZE: " << mIndex.getBodySizeTotal() / (1024*1024) << " MB"
 			<< llendl;
 }
 
@@ -1685,11 +1338,14 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 // Reads imagesize from the header, updates timestamp
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 {
-	LLMutexLock lock(&mHeaderMutex);	
-	S32 idx = openAndReadEntry(id, entry, false);
-	if (idx >= 0)
-	{		
-		updateEntryTimeStamp(idx, entry); // updates time
+	S32 idx = mIndex.find(id, entry, time(NULL));
+	if (idx >= 0 && entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
+	{
+		llwarns << "corrupted entry: " << id << " entry image size: " << entry.mImageSize << " entry body size: " << entry.mBodySize << llendl ;
+
+		//erase this entry and the cached texture from the cache.
+		removeFromCache(id);
+		idx = -1;
 	}
 	return idx;
 }
@@ -1697,26 +1353,58 @@ S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 // Writes imagesize to the header, updates timestamp
 S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize)
 {
-	mHeaderMutex.lock();
-	S32 idx = openAndReadEntry(id, entry, true);
-	mHeaderMutex.unlock();
+	S32 bodysize = llmax(0, datasize - TEXTURE_CACHE_ENTRY_SIZE);
+	entry = Entry(id, imagesize, bodysize, time(NULL));
+
+	LLTextureCacheIndex::entry_list_t evicted;
+	S32 idx = mIndex.insert(entry, evicted);
+	removeEvictedEntries(evicted);
 
-	if (idx >= 0)
+	if (idx >= 0 && mIndex.getBodySizeTotal() > sCacheMaxTexturesSize)
 	{
-		updateEntry(idx, entry, imagesize, datasize);				
+		mDoPurge = TRUE;
 	}
+	return idx;
+}
 
-	if(idx < 0) // retry
-	{
-		readHeaderCache(); // We couldn't write an entry, so refresh the LRU
+//update an existing entry, write to the index immediately.
+//returns true if the entry did not change.
+bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
+{
+	S32 new_body_size = llmax(0, new_data_size - TEXTURE_CACHE_ENTRY_SIZE) ;
 	
-		mHeaderMutex.lock();
-		llassert_always(!mLRU.empty() || mHeaderEntriesInfo.mEntries < sCacheMaxEntries);
-		mHeaderMutex.unlock();
+	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize)
+	{
+		return true ; //nothing changed.
+	}
 
-		idx = setHeaderCacheEntry(id, entry, imagesize, datasize); // assert above ensures no inf. recursion
+	entry.mTime = time(NULL);
+	entry.mImageSize = new_image_size ; 
+	entry.mBodySize = new_body_size ;
+	if (!mIndex.update(idx, entry))
+	{
+		// Evicted by another thread since it was read, add it again.
+		idx = setHeaderCacheEntry(entry.mID, entry, new_image_size, new_data_size);
+	}
+	else if (mIndex.getBodySizeTotal() > sCacheMaxTexturesSize)
+	{
+		mDoPurge = TRUE;
+	}
+
+	return false ;
+}
+
+// Deletes the body files of the entries the index dropped to make room.
+void LLTextureCache::removeEvictedEntries(const LLTextureCacheIndex::entry_list_t& evicted)
+{
+	for (LLTextureCacheIndex::entry_list_t::const_iterator iter = evicted.begin();
+		 iter != evicted.end(); ++iter)
+	{
+		if (iter->second.mBodySize > 0)
+		{
+			LLAPRFile::remove(getTextureFileName(iter->second.mID), getLocalAPRFilePool());
+		}
 	}
-	return idx;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1843,54 +1531,15 @@ void LLTextureCache::addCompleted(Responder* responder, bool success)
 
 //////////////////////////////////////////////////////////////////////////////
 
-//called after mHeaderMutex is locked.
-void LLTextureCache::removeCachedTexture(const LLUUID& id)
-{
-	if(mTexturesSizeMap.find(id) != mTexturesSizeMap.end())
-	{
-		mTexturesSizeTotal -= mTexturesSizeMap[id] ;
-		mTexturesSizeMap.erase(id);
-	}
-	mHeaderIDMap.erase(id);
-	LLAPRFile::remove(getTextureFileName(id), getLocalAPRFilePool());		
-}
-
-//called after mHeaderMutex is locked.
-void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
-{
-	if(idx >= 0) //valid entry
-	{
-		entry.mImageSize = -1;
-		entry.mBodySize = 0;
-		mHeaderIDMap.erase(entry.mID);
-		mTexturesSizeMap.erase(entry.mID);
-
-		mTexturesSizeTotal -= entry.mBodySize;
-		mFreeList.insert(idx);	
-	}
-
-	LLAPRFile::remove(filename, getLocalAPRFilePool());		
-}
-
 bool LLTextureCache::removeFromCache(const LLUUID& id)
 {
 	//llwarns << "Removing texture from cache: " << id << llendl;
 	bool ret = false ;
 	if (!mReadOnly)
 	{
-		lockHeaders() ;
-
 		Entry entry;
-		S32 idx = openAndReadEntry(id, entry, false);
-		std::string tex_filename = getTextureFileName(id);
-		removeEntry(idx, entry, tex_filename) ;
-		if (idx >= 0)
-		{			
-			writeEntryToHeaderImmediately(idx, entry);					
-			ret = true;
-		}
-
-		unlockHeaders() ;
+		ret = (mIndex.remove(id, entry) >= 0);
+		LLAPRFile::remove(getTextureFileName(id), getLocalAPRFilePool());
 	}
 	return ret ;
 }
@@ -0,0 +1,634 @@
+/**
+ * @file lltexturecacheindex.cpp
+ * @brief Memory mapped, lock sharded index of the texture cache entries.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturecacheindex.h"
+
+#include <algorithm>
+
+#include "apr_file_io.h"
+#include "apr_mmap.h"
+
+const U32 INDEX_MAGIC = 0x58495854; // "TXIX"
+const U32 INDEX_VERSION = 1;
+const U32 INDEX_MIN_SLOTS_PER_SHARD = 16;
+const F32 INDEX_EVICT_AMOUNT = .10f; // % of a full shard to evict at once, amortizes the scan for the oldest entries
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLTextureCacheIndex::LLTextureCacheIndex()
+	: mPool(NULL),
+	  mFile(NULL),
+	  mMap(NULL),
+	  mReadOnly(true),
+	  mHeader(NULL),
+	  mShardInfo(NULL),
+	  mSlots(NULL),
+	  mSlotsPerShard(0),
+	  mMaxShardEntries(0)
+{
+	for (S32 i = 0; i < NUM_SHARDS; i++)
+	{
+		mShardMutex[i] = new LLMutex(NULL);
+		mFreeRecordsValid[i] = false;
+	}
+}
+
+LLTextureCacheIndex::~LLTextureCacheIndex()
+{
+	close();
+	for (S32 i = 0; i < NUM_SHARDS; i++)
+	{
+		delete mShardMutex[i];
+	}
+}
+
+//static
+U32 LLTextureCacheIndex::getSlotsPerShard(U32 max_entries)
+{
+	return llmax((max_entries + NUM_SHARDS - 1) / NUM_SHARDS, INDEX_MIN_SLOTS_PER_SHARD);
+}
+
+bool LLTextureCacheIndex::open(const std::string& filename, U32 max_entries, bool read_only, bool& created)
+{
+	close();
+
+	created = false;
+	mReadOnly = read_only;
+	mPool = new LLAPRPool();
+
+	apr_int32_t flags = read_only ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_CREATE|APR_BINARY;
+	apr_status_t s = apr_file_open(&mFile, filename.c_str(), flags, APR_OS_DEFAULT, mPool->getAPRPool());
+	if (s != APR_SUCCESS)
+	{
+		if (!read_only)
+		{
+			ll_apr_warn_status(s);
+		}
+		close();
+		return false;
+	}
+
+	apr_finfo_t finfo;
+	apr_off_t file_size = 0;
+	if (apr_file_info_get(&finfo, APR_FINFO_SIZE, mFile) == APR_SUCCESS)
+	{
+		file_size = finfo.size;
+	}
+
+	// Validate the existing header, if any
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	bool valid = false;
+	if (file_size >= (apr_off_t)sizeof(Header))
+	{
+		apr_size_t bytes_read = sizeof(Header);
+		apr_off_t offset = 0;
+		apr_file_seek(mFile, APR_SET, &offset);
+		if (apr_file_read(mFile, &header, &bytes_read) == APR_SUCCESS && bytes_read == sizeof(Header)
+			&& header.mMagic == INDEX_MAGIC
+			&& header.mNumShards == NUM_SHARDS
+			&& header.mSlotsPerShard >= INDEX_MIN_SLOTS_PER_SHARD)
+		{
+			apr_off_t table_size = sizeof(Header) + NUM_SHARDS * sizeof(ShardInfo);
+			apr_off_t num_slots = (apr_off_t)header.mNumShards * header.mSlotsPerShard;
+			valid = header.mVersion == INDEX_VERSION
+				&& file_size == table_size + num_slots * (apr_off_t)sizeof(Slot);
+		}
+	}
+
+	if (!valid)
+	{
+		if (read_only)
+		{
+			close();
+			return false;
+		}
+		if (file_size > 0)
+		{
+			llwarns << "Texture cache index " << filename << " is invalid, recreating it." << llendl;
+		}
+		if (!create(filename, getSlotsPerShard(max_entries), file_size))
+		{
+			close();
+			return false;
+		}
+		created = true;
+	}
+	else if (!mapFile(file_size))
+	{
+		close();
+		return false;
+	}
+
+	if (!read_only)
+	{
+		if (!mHeader->mClean)
+		{
+			// The viewer did not close the index, the shard totals may be out of date
+			recount();
+		}
+		mHeader->mClean = 0;
+	}
+
+	return true;
+}
+
+// Maps the first file_size bytes of mFile.
+bool LLTextureCacheIndex::mapFile(apr_off_t file_size)
+{
+	apr_int32_t mmap_flags = mReadOnly ? APR_MMAP_READ : APR_MMAP_READ|APR_MMAP_WRITE;
+	apr_status_t s = apr_mmap_create(&mMap, mFile, 0, (apr_size_t)file_size, mmap_flags, mPool->getAPRPool());
+	if (s != APR_SUCCESS)
+	{
+		ll_apr_warn_status(s);
+		mMap = NULL;
+		return false;
+	}
+
+	U8* base = (U8*)mMap->mm;
+	mHeader = (Header*)base;
+	mShardInfo = (ShardInfo*)(base + sizeof(Header));
+	mSlots = (Slot*)(base + sizeof(Header) + NUM_SHARDS * sizeof(ShardInfo));
+	mSlotsPerShard = mHeader->mSlotsPerShard;
+	// Keep some empty slots in each shard so that probe sequences stay short
+	mMaxShardEntries = mSlotsPerShard - mSlotsPerShard / 8;
+	return true;
+}
+
+// Makes mFile an empty index of slots_per_shard slots per shard and maps it.
+bool LLTextureCacheIndex::create(const std::string& filename, U32 slots_per_shard, apr_off_t& file_size)
+{
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	header.mMagic = INDEX_MAGIC;
+	header.mVersion = INDEX_VERSION;
+	header.mNumShards = NUM_SHARDS;
+	header.mSlotsPerShard = slots_per_shard;
+	header.mClean = 1;
+	file_size = sizeof(Header) + NUM_SHARDS * sizeof(ShardInfo)
+		+ (apr_off_t)header.mNumShards * header.mSlotsPerShard * sizeof(Slot);
+
+	// Truncate first so that all the ShardInfo and Slot records read back as zeros (empty)
+	apr_size_t bytes_written = sizeof(Header);
+	apr_off_t offset = 0;
+	if (apr_file_trunc(mFile, 0) != APR_SUCCESS
+		|| apr_file_trunc(mFile, file_size) != APR_SUCCESS
+		|| apr_file_seek(mFile, APR_SET, &offset) != APR_SUCCESS
+		|| apr_file_write(mFile, &header, &bytes_written) != APR_SUCCESS
+		|| bytes_written != sizeof(Header))
+	{
+		llwarns << "Unable to create texture cache index " << filename << llendl;
+		return false;
+	}
+	return mapFile(file_size);
+}
+
+void LLTextureCacheIndex::close()
+{
+	if (mMap)
+	{
+		if (!mReadOnly)
+		{
+			mHeader->mClean = 1;
+		}
+		apr_mmap_delete(mMap);
+		mMap = NULL;
+	}
+	if (mFile)
+	{
+		apr_file_close(mFile);
+		mFile = NULL;
+	}
+	delete mPool;
+	mPool = NULL;
+
+	mHeader = NULL;
+	mShardInfo = NULL;
+	mSlots = NULL;
+	mSlotsPerShard = 0;
+	mMaxShardEntries = 0;
+	for (U32 shard = 0; shard < NUM_SHARDS; shard++)
+	{
+		mFreeRecords[shard].clear();
+		mFreeRecordsValid[shard] = false;
+	}
+}
+
+void LLTextureCacheIndex::clear()
+{
+	if (!isOpen() || mReadOnly)
+	{
+		return;
+	}
+	for (U32 shard = 0; shard < NUM_SHARDS; shard++)
+	{
+		LLMutexLock lock(mShardMutex[shard]);
+		memset(mSlots + shard * mSlotsPerShard, 0, mSlotsPerShard * sizeof(Slot));
+		memset(mShardInfo + shard, 0, sizeof(ShardInfo));
+		mFreeRecords[shard].clear();
+		mFreeRecordsValid[shard] = false;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+U32 LLTextureCacheIndex::getShard(const LLUUID& id) const
+{
+	const U32* words = (const U32*)id.mData;
+	return words[0] & (NUM_SHARDS - 1);
+}
+
+U32 LLTextureCacheIndex::getHomeSlot(const LLUUID& id) const
+{
+	const U32* words = (const U32*)id.mData;
+	return (words[1] ^ words[3]) % mSlotsPerShard;
+}
+
+// mShardMutex[shard] must be locked before calling this.
+// Returns the slot holding id or -1. If free_slot is not NULL it receives the
+// empty slot that ends the probe sequence, where id would be inserted.
+S32 LLTextureCacheIndex::findLocked(U32 shard, const LLUUID& id, U32* free_slot)
+{
+	const Slot* slots = mSlots + shard * mSlotsPerShard;
+	// A shard always has empty slots (mMaxShardEntries), the bound only
+	// matters for a damaged file
+	U32 idx = getHomeSlot(id);
+	for (U32 probe = 0; probe < mSlotsPerShard; probe++)
+	{
+		if (slots[idx].mEntry.mID.isNull())
+		{
+			if (free_slot)
+			{
+				*free_slot = idx;
+			}
+			return -1;
+		}
+		if (slots[idx].mEntry.mID == id)
+		{
+			return idx;
+		}
+		if (++idx == mSlotsPerShard)
+		{
+			idx = 0;
+		}
+	}
+	llassert_always(!free_slot);
+	return -1;
+}
+
+// mShardMutex[shard] must be locked before calling this.
+void LLTextureCacheIndex::insertLocked(U32 shard, U32 slot, const Entry& entry, S32 record)
+{
+	Slot& dest = mSlots[shard * mSlotsPerShard + slot];
+	dest.mEntry = entry;
+	dest.mRecord = record;
+	mShardInfo[shard].mEntries++;
+	mShardInfo[shard].mBodySize += entry.mBodySize;
+}
+
+// mShardMutex[shard] must be locked before calling this.
+// Returns an unused record of the shard. The shard must not be full.
+// A shard whose entries don't own distinct records of their own shard is
+// damaged and is rebuilt first.
+S32 LLTextureCacheIndex::allocRecordLocked(U32 shard)
+{
+	std::vector<S32>& free_records = mFreeRecords[shard];
+	const S32 first = shard * mSlotsPerShard;
+	if (!mFreeRecordsValid[shard])
+	{
+		std::vector<U8> used(mSlotsPerShard, 0);
+		for (U32 slot = 0; slot < mSlotsPerShard; slot++)
+		{
+			const Slot& cur = mSlots[first + slot];
+			if (cur.mEntry.mID.isNull())
+			{
+				continue;
+			}
+			S32 record = cur.mRecord - first;
+			if (record < 0 || record >= (S32)mSlotsPerShard || used[record])
+			{
+				llwarns << "Texture cache index shard " << shard << " is damaged, rebuilding it." << llendl;
+				rebuildShardLocked(shard);
+				return allocRecordLocked(shard);
+			}
+			used[record] = 1;
+		}
+		free_records.clear();
+		// Highest first, records are handed out from the start of the shard
+		for (S32 i = mSlotsPerShard - 1; i >= 0; i--)
+		{
+			if (!used[i])
+			{
+				free_records.push_back(first + i);
+			}
+		}
+		mFreeRecordsValid[shard] = true;
+	}
+	llassert_always(!free_records.empty());
+	S32 record = free_records.back();
+	free_records.pop_back();
+	return record;
+}
+
+// mShardMutex[shard] must be locked before calling this.
+void LLTextureCacheIndex::eraseLocked(U32 shard, U32 slot)
+{
+	Slot* slots = mSlots + shard * mSlotsPerShard;
+	ShardInfo& info = mShardInfo[shard];
+	info.mEntries--;
+	info.mBodySize -= slots[slot].mEntry.mBodySize;
+	if (mFreeRecordsValid[shard])
+	{
+		mFreeRecords[shard].push_back(slots[slot].mRecord);
+	}
+
+	// Move back every entry of the run after the hole that would not be
+	// found from its home slot anymore
+	U32 hole = slot;
+	U32 idx = slot;
+	while (1)
+	{
+		if (++idx == mSlotsPerShard)
+		{
+			idx = 0;
+		}
+		if (slots[idx].mEntry.mID.isNull())
+		{
+			break;
+		}
+		U32 home = getHomeSlot(slots[idx].mEntry.mID);
+		bool reachable = (hole <= idx) ? (hole < home && home <= idx)
+									   : (hole < home || home <= idx);
+		if (!reachable)
+		{
+			slots[hole] = slots[idx];
+			hole = idx;
+		}
+	}
+	memset(&slots[hole], 0, sizeof(Slot));
+}
+
+// mShardMutex[shard] must be locked before calling this.
+void LLTextureCacheIndex::evictLocked(U32 shard, entry_list_t& evicted)
+{
+	// Erasing moves entries around, keep the ids rather than the slots
+	typedef std::pair<U32, LLUUID> time_id_t;
+	std::vector<time_id_t> lru;
+	lru.reserve(mShardInfo[shard].mEntries);
+	const Slot* slots = mSlots + shard * mSlotsPerShard;
+	for (U32 slot = 0; slot < mSlotsPerShard; slot++)
+	{
+		if (slots[slot].mEntry.mID.notNull())
+		{
+			lru.push_back(std::make_pair(slots[slot].mEntry.mTime, slots[slot].mEntry.mID));
+		}
+	}
+	U32 count = llclamp((U32)(mMaxShardEntries * INDEX_EVICT_AMOUNT), (U32)1, (U32)lru.size());
+	if (count < lru.size())
+	{
+		std::nth_element(lru.begin(), lru.begin() + count, lru.end());
+	}
+	for (U32 i = 0; i < count; i++)
+	{
+		S32 slot = findLocked(shard, lru[i].second, NULL);
+		llassert_always(slot >= 0);
+		evicted.push_back(std::make_pair(slots[slot].mRecord, slots[slot].mEntry));
+		eraseLocked(shard, slot);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+S32 LLTextureCacheIndex::find(const LLUUID& id, Entry& entry, U32 touch_time)
+{
+	if (!isOpen() || id.isNull())
+	{
+		return -1;
+	}
+	U32 shard = getShard(id);
+	LLMutexLock lock(mShardMutex[shard]);
+	S32 slot = findLocked(shard, id, NULL);
+	if (slot < 0)
+	{
+		return -1;
+	}
+	Slot& cur = mSlots[shard * mSlotsPerShard + slot];
+	if (touch_time && !mReadOnly)
+	{
+		cur.mEntry.mTime = touch_time;
+	}
+	entry = cur.mEntry;
+	return cur.mRecord;
+}
+
+S32 LLTextureCacheIndex::insert(const Entry& entry, entry_list_t& evicted, bool evict)
+{
+	if (!isOpen() || mReadOnly || entry.mID.isNull())
+	{
+		return -1;
+	}
+	llassert_always(entry.mImageSize >= 0);
+	U32 shard = getShard(entry.mID);
+	LLMutexLock lock(mShardMutex[shard]);
+	ShardInfo& info = mShardInfo[shard];
+
+	U32 free_slot = 0;
+	S32 slot = findLocked(shard, entry.mID, &free_slot);
+	if (slot >= 0)
+	{
+		// Already indexed, replace it in place
+		Slot& cur = mSlots[shard * mSlotsPerShard + slot];
+		info.mBodySize += entry.mBodySize - cur.mEntry.mBodySize;
+		cur.mEntry = entry;
+		return cur.mRecord;
+	}
+
+	if (info.mEntries >= mMaxShardEntries)
+	{
+		if (!evict)
+		{
+			return -1;
+		}
+		evictLocked(shard, evicted);
+	}
+
+	// Eviction, or the rebuild of a damaged shard, moves entries: the probe
+	// sequence may end earlier
+	S32 record = allocRecordLocked(shard);
+	findLocked(shard, entry.mID, &free_slot);
+	insertLocked(shard, free_slot, entry, record);
+	return record;
+}
+
+bool LLTextureCacheIndex::update(S32 record, const Entry& entry)
+{
+	if (!isOpen() || mReadOnly || entry.mID.isNull())
+	{
+		return false;
+	}
+	U32 shard = getShard(entry.mID);
+	LLMutexLock lock(mShardMutex[shard]);
+	S32 slot = findLocked(shard, entry.mID, NULL);
+	if (slot < 0)
+	{
+		// Evicted or removed by another thread
+		return false;
+	}
+	Slot& cur = mSlots[shard * mSlotsPerShard + slot];
+	if (cur.mRecord != record)
+	{
+		// Removed and added again since record was handed out
+		return false;
+	}
+	if (entry.mImageSize < 0)
+	{
+		eraseLocked(shard, slot);
+		return true;
+	}
+	mShardInfo[shard].mBodySize += entry.mBodySize - cur.mEntry.mBodySize;
+	cur.mEntry = entry;
+	return true;
+}
+
+S32 LLTextureCacheIndex::remove(const LLUUID& id, Entry& entry)
+{
+	if (!isOpen() || mReadOnly || id.isNull())
+	{
+		return -1;
+	}
+	U32 shard = getShard(id);
+	LLMutexLock lock(mShardMutex[shard]);
+	S32 slot = findLocked(shard, id, NULL);
+	if (slot < 0)
+	{
+		return -1;
+	}
+	const Slot& cur = mSlots[shard * mSlotsPerShard + slot];
+	S32 record = cur.mRecord;
+	entry = cur.mEntry;
+	eraseLocked(shard, slot);
+	return record;
+}
+
+void LLTextureCacheIndex::getEntries(entry_list_t& entries)
+{
+	if (!isOpen())
+	{
+		return;
+	}
+	entries.reserve(entries.size() + getNumEntries());
+	for (U32 shard = 0; shard < NUM_SHARDS; shard++)
+	{
+		LLMutexLock lock(mShardMutex[shard]);
+		const Slot* slots = mSlots + shard * mSlotsPerShard;
+		for (U32 slot = 0; slot < mSlotsPerShard; slot++)
+		{
+			if (slots[slot].mEntry.mID.notNull())
+			{
+				entries.push_back(std::make_pair(slots[slot].mRecord, slots[slot].mEntry));
+			}
+		}
+	}
+}
+
+U32 LLTextureCacheIndex::getNumEntries()
+{
+	U32 res = 0;
+	if (isOpen())
+	{
+		for (U32 shard = 0; shard < NUM_SHARDS; shard++)
+		{
+			LLMutexLock lock(mShardMutex[shard]);
+			res += mShardInfo[shard].mEntries;
+		}
+	}
+	return res;
+}
+
+S64 LLTextureCacheIndex::getBodySizeTotal()
+{
+	S64 res = 0;
+	if (isOpen())
+	{
+		for (U32 shard = 0; shard < NUM_SHARDS; shard++)
+		{
+			LLMutexLock lock(mShardMutex[shard]);
+			res += mShardInfo[shard].mBodySize;
+		}
+	}
+	return res;
+}
+
+// Rebuilds the ShardInfo totals from the entries. Called from open() only.
+void LLTextureCacheIndex::recount()
+{
+	llinfos << "Texture cache index was not closed properly, recounting entries." << llendl;
+	for (U32 shard = 0; shard < NUM_SHARDS; shard++)
+	{
+		rebuildShardLocked(shard);
+	}
+}
+
+// mShardMutex[shard] must be locked before calling this, or the index not
+// shared yet.
+// Reinserts the valid entries of the shard and recounts its totals. A crash
+// in the middle of a backward shift can leave an entry in two slots, the copy
+// found second is dropped, as are entries with a record outside of their
+// shard or used by an entry before them.
+void LLTextureCacheIndex::rebuildShardLocked(U32 shard)
+{
+	std::vector<U8> used(mSlotsPerShard, 0);
+	std::vector<Slot> kept;
+	kept.reserve(mSlotsPerShard);
+	Slot* slots = mSlots + shard * mSlotsPerShard;
+	const S32 first = shard * mSlotsPerShard;
+	for (U32 slot = 0; slot < mSlotsPerShard; slot++)
+	{
+		const Slot& cur = slots[slot];
+		S32 record = cur.mRecord - first;
+		if (cur.mEntry.mID.notNull()
+			&& record >= 0 && record < (S32)mSlotsPerShard && !used[record]
+			&& findLocked(shard, cur.mEntry.mID, NULL) == (S32)slot
+			&& kept.size() < mMaxShardEntries)
+		{
+			used[record] = 1;
+			kept.push_back(cur);
+		}
+	}
+
+	memset(slots, 0, mSlotsPerShard * sizeof(Slot));
+	memset(mShardInfo + shard, 0, sizeof(ShardInfo));
+	mFreeRecords[shard].clear();
+	mFreeRecordsValid[shard] = false;
+	for (U32 i = 0; i < kept.size(); i++)
+	{
+		U32 free_slot = 0;
+		findLocked(shard, kept[i].mEntry.mID, &free_slot);
+		insertLocked(shard, free_slot, kept[i].mEntry, kept[i].mRecord);
+	}
+}
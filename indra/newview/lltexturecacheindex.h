@@ -0,0 +1,176 @@
+/**
+ * @file lltexturecacheindex.h
+ * @brief Memory mapped, lock sharded index of the texture cache entries.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURECACHEINDEX_H
+#define LL_LLTEXTURECACHEINDEX_H
+
+#include <vector>
+
+#include "llapr.h"
+#include "llthread.h"
+#include "lluuid.h"
+
+struct apr_mmap_t;
+
+// Index file organization (texture.index):
+//  Header
+//  ShardInfo[NUM_SHARDS]
+//  Slot[NUM_SHARDS * slots per shard]
+//
+// The slot table is an open addressing hash table split into NUM_SHARDS
+// contiguous shards. The shard and the home slot of a texture are taken from
+// the bits of its UUID and each shard has its own mutex, so lookups for
+// different textures from different threads rarely contend.
+// Removing an entry moves the entries after it back into the hole (backward
+// shift deletion), so there are no deleted slots and a lookup ends at the
+// first empty slot. Since entries move, each one also holds its record number
+// in the header data file (texture.header), which is taken from the records of
+// its shard when it is inserted and never changes.
+//
+// The file is mapped into memory: opening the index does not read it, pages
+// are brought in by the OS on first use.
+
+class LLTextureCacheIndex
+{
+public:
+	enum { NUM_SHARDS = 64 }; // must be power of 2
+
+	// Binary compatible with the Entry records of the legacy texture.entries file
+	struct Entry
+	{
+		Entry() :
+			mImageSize(0),
+			mBodySize(0),
+			mTime(0)
+		{
+		}
+		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time) :
+			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time) {}
+		LLUUID mID; // 16 bytes, null for an empty slot
+		S32 mImageSize; // total size of image if known
+		S32 mBodySize; // size of body file in body cache
+		U32 mTime; // seconds since 1/1/1970
+	};
+
+	typedef std::vector<std::pair<S32, Entry> > entry_list_t; // (record, entry)
+
+	LLTextureCacheIndex();
+	~LLTextureCacheIndex();
+
+	// Maps filename into memory. An existing valid index is used with its own
+	// geometry; otherwise, unless read_only, an empty index sized for max_entries
+	// is created and 'created' is set. Returns false on failure.
+	bool open(const std::string& filename, U32 max_entries, bool read_only, bool& created);
+	void close();
+	bool isOpen() const { return mSlots != NULL; }
+
+	// Removes every entry.
+	void clear();
+
+	// All of the following are thread safe.
+
+	// Returns the record of id or -1. A non zero touch_time is stored as the new
+	// access time of the entry.
+	S32 find(const LLUUID& id, Entry& entry, U32 touch_time = 0);
+	// Adds or replaces entry.mID and returns its record. When the shard is full
+	// its oldest entries are removed and appended to 'evicted', unless 'evict'
+	// is false in which case -1 is returned.
+	S32 insert(const Entry& entry, entry_list_t& evicted, bool evict = true);
+	// Rewrites the entry of entry.mID. Returns false if it is not indexed with
+	// that record anymore. An entry with a negative mImageSize is removed.
+	bool update(S32 record, const Entry& entry);
+	// Removes id, returns its former record or -1.
+	S32 remove(const LLUUID& id, Entry& entry);
+	// Snapshot of all the valid entries.
+	void getEntries(entry_list_t& entries);
+
+	U32 getNumSlots() const { return NUM_SHARDS * mSlotsPerShard; }
+	U32 getNumEntries();
+	S64 getBodySizeTotal();
+
+	static U32 getSlotsPerShard(U32 max_entries);
+
+private:
+	struct Header
+	{
+		U32 mMagic;
+		U32 mVersion;
+		U32 mNumShards;
+		U32 mSlotsPerShard;
+		U32 mClean; // 0 while mapped for writing, used to detect stale ShardInfo after a crash
+		U32 mPad[3];
+	};
+	struct ShardInfo
+	{
+		U32 mEntries; // valid entries
+		U32 mPad;
+		S64 mBodySize; // sum of mBodySize of the valid entries
+	};
+	struct Slot
+	{
+		Entry mEntry;
+		S32 mRecord; // record number in the header data file, fixed for the life of the entry
+	};
+
+	// No copy constructor or copy assignment
+	LLTextureCacheIndex(const LLTextureCacheIndex&);
+	LLTextureCacheIndex& operator=(const LLTextureCacheIndex&);
+
+	U32 getShard(const LLUUID& id) const;
+	U32 getHomeSlot(const LLUUID& id) const;
+
+	// mShardMutex[shard] must be locked for the following functions!
+	// Slots are numbered within their shard.
+	S32 findLocked(U32 shard, const LLUUID& id, U32* free_slot);
+	void insertLocked(U32 shard, U32 slot, const Entry& entry, S32 record);
+	void evictLocked(U32 shard, entry_list_t& evicted);
+	void eraseLocked(U32 shard, U32 slot);
+	S32 allocRecordLocked(U32 shard);
+	void rebuildShardLocked(U32 shard);
+
+	bool mapFile(apr_off_t file_size);
+	bool create(const std::string& filename, U32 slots_per_shard, apr_off_t& file_size);
+	void recount();
+
+private:
+	LLAPRPool* mPool;
+	apr_file_t* mFile;
+	apr_mmap_t* mMap;
+	bool mReadOnly;
+
+	Header* mHeader;
+	ShardInfo* mShardInfo;
+	Slot* mSlots;
+	U32 mSlotsPerShard;
+	U32 mMaxShardEntries;
+
+	LLMutex* mShardMutex[NUM_SHARDS];
+	// Unused records of each shard, built on first need
+	std::vector<S32> mFreeRecords[NUM_SHARDS];
+	bool mFreeRecordsValid[NUM_SHARDS];
+};
+
+#endif // LL_LLTEXTURECACHEINDEX_H
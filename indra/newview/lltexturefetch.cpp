@@ -861,9 +861,10 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			//control the number of the http requests issued for:
 			//1, not openning too many file descriptors at the same time;
 			//2, control the traffic of http so udp gets bandwidth.
+			//The http client limits the requests in flight to what each host sustains,
+			//keep twice that handed to it so its connections never wait for the next request.
 			//
-			static const S32 MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE = 32 ;
-			if(mFetcher->getNumHTTPRequests() > MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE)
+			if(mFetcher->getNumHTTPRequests() > 2 * mFetcher->mCurlGetRequest->getRequestLimit())
 			{
 				return false ; //wait.
 			}
@@ -1538,6 +1539,8 @@ LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* image
 	  mCurlGetRequest(NULL)
 {
 	mMaxBandwidth = gSavedSettings.getF32("ThrottleBandwidthKBPS");
+	mHTTPPipelining = gSavedSettings.getBOOL("ImagePipelineHTTPPipelining");
+	mMaxHTTPRequests = (S32)gSavedSettings.getU32("ImagePipelineHTTPMaxRequests");
 	mTextureInfo.setUpLogging(gSavedSettings.getBOOL("LogTextureDownloadsToViewerLog"), gSavedSettings.getBOOL("LogTextureDownloadsToSimulator"), gSavedSettings.getU32("TextureLoggingThreshold"));
 }
 
@@ -1888,7 +1891,9 @@ void LLTextureFetch::shutDownImageDecodeThread()
 void LLTextureFetch::startThread()
 {
 	// Construct mCurlGetRequest from Worker Thread
-	mCurlGetRequest = new LLCurlRequest();
+	mCurlGetRequest = new LLTextureHttpClient();
+	mCurlGetRequest->setPipelining(mHTTPPipelining);
+	mCurlGetRequest->setMaxHostRequests(mMaxHTTPRequests);
 }
 
 // WORKER THREAD
@@ -1904,8 +1909,9 @@ void LLTextureFetch::threadedUpdate()
 {
 	llassert_always(mCurlGetRequest);
 	
-	// Limit update frequency
-	const F32 PROCESS_TIME = 0.05f; 
+	// Limit update frequency, higher while requests are in flight so the
+	// freed connections get their next request soon
+	const F32 PROCESS_TIME = mCurlGetRequest->getQueued() > 0 ? 0.01f : 0.05f; 
 	static LLFrameTimer process_timer;
 	if (process_timer.getElapsedTimeF32() < PROCESS_TIME)
 	{
@@ -32,6 +32,7 @@
 #include "lluuid.h"
 #include "llworkerthread.h"
 #include "llcurl.h"
+#include "lltexturehttpclient.h"
 #include "lltextureinfo.h"
 
 class LLViewerTexture;
@@ -112,7 +113,9 @@ private:
 
 	LLTextureCache* mTextureCache;
 	LLImageDecodeThread* mImageDecodeThread;
-	LLCurlRequest* mCurlGetRequest;
+	LLTextureHttpClient* mCurlGetRequest;
+	bool mHTTPPipelining;	// ImagePipelineHTTPPipelining
+	S32 mMaxHTTPRequests;	// ImagePipelineHTTPMaxRequests, per host
 	
 	// Map of all requests by UUID
 	typedef std::map<LLUUID,LLTextureFetchWorker*> map_t;
@@ -0,0 +1,409 @@
+/**
+ * @file lltextureresidencymanager.cpp
+ * @brief Keeps the GL memory of the fetched textures within a byte budget
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltextureresidencymanager.h"
+
+#include <algorithm>
+#include <istream>
+#include <map>
+#include <ostream>
+
+// While over budget, aim this much lower so the next textures coming in do
+// not immediately push the total back over it
+const F32 RESIDENCY_LOW_WATER = 0.9f;
+// Importance gained by a texture each time it goes one level coarser:
+// a level has a quarter of the texels of the previous one
+const F32 RESIDENCY_LEVEL_WEIGHT = 4.f;
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLTextureResidencyManager::LLTextureResidencyManager()
+	: mNumTextures(0),
+	  mNumLimited(0),
+	  mBudget(0),
+	  mResidentBytes(0),
+	  mWantedBytes(0),
+	  mPlannedBytes(0),
+	  mTrace(NULL)
+{
+}
+
+LLTextureResidencyManager::~LLTextureResidencyManager()
+{
+}
+
+//static
+S64 LLTextureResidencyManager::calcBytes(S32 full_width, S32 full_height, S32 components, BOOL mipmapped, S32 discard)
+{
+	// Same as LLImageGL::getMipBytes()
+	S32 w = full_width >> discard;
+	S32 h = full_height >> discard;
+	S64 bytes = ((S64)w * h * components + 3) & ~3;
+	if (mipmapped)
+	{
+		while (w > 1 && h > 1)
+		{
+			w >>= 1;
+			h >>= 1;
+			bytes += ((S64)w * h * components + 3) & ~3;
+		}
+	}
+	return bytes;
+}
+
+S64 LLTextureResidencyManager::getBytes(const Texture& texture, S32 discard) const
+{
+	if (discard < 0 || (texture.mWanted >= 0 && discard > texture.mMaxDiscard))
+	{
+		return 0;
+	}
+	return calcBytes(texture.mWidth, texture.mHeight, texture.mComponents, texture.mMipMapped, discard);
+}
+
+LLTextureResidencyManager::Texture* LLTextureResidencyManager::getTexture(handle_t handle)
+{
+	if (handle <= 0 || handle > (S32)mTextures.size() || !mTextures[handle - 1].mInUse)
+	{
+		return NULL;
+	}
+	return &mTextures[handle - 1];
+}
+
+const LLTextureResidencyManager::Texture* LLTextureResidencyManager::getTexture(handle_t handle) const
+{
+	if (handle <= 0 || handle > (S32)mTextures.size() || !mTextures[handle - 1].mInUse)
+	{
+		return NULL;
+	}
+	return &mTextures[handle - 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLTextureResidencyManager::handle_t LLTextureResidencyManager::addTexture(S32 full_width, S32 full_height, S32 components, BOOL mipmapped, void* user_data)
+{
+	handle_t handle;
+	if (!mFreeTextures.empty())
+	{
+		handle = mFreeTextures.back();
+		mFreeTextures.pop_back();
+	}
+	else
+	{
+		mTextures.push_back(Texture());
+		handle = (handle_t)mTextures.size();
+	}
+	Texture& texture = mTextures[handle - 1];
+	texture.mWidth = full_width;
+	texture.mHeight = full_height;
+	texture.mComponents = components;
+	texture.mMipMapped = mipmapped;
+	texture.mPinned = TRUE;
+	texture.mInUse = TRUE;
+	texture.mWanted = -1;
+	texture.mMaxDiscard = 0;
+	texture.mResident = -1;
+	texture.mLimit = -1;
+	texture.mPrevLimit = -1;
+	texture.mPriority = 0.f;
+	texture.mUserData = user_data;
+	mNumTextures++;
+
+	if (mTrace)
+	{
+		*mTrace << "add " << handle << ' ' << full_width << ' ' << full_height << ' ' << components << ' ' << (S32)mipmapped << '\n';
+	}
+	return handle;
+}
+
+void LLTextureResidencyManager::removeTexture(handle_t handle)
+{
+	Texture* texture = getTexture(handle);
+	if (!texture)
+	{
+		return;
+	}
+	mResidentBytes -= getBytes(*texture, texture->mResident);
+	texture->mInUse = FALSE;
+	texture->mUserData = NULL;
+	mFreeTextures.push_back(handle);
+	mNumTextures--;
+
+	if (mTrace)
+	{
+		*mTrace << "remove " << handle << '\n';
+	}
+}
+
+void LLTextureResidencyManager::setTextureSize(handle_t handle, S32 full_width, S32 full_height, S32 components, BOOL mipmapped)
+{
+	Texture* texture = getTexture(handle);
+	if (!texture ||
+		(texture->mWidth == full_width && texture->mHeight == full_height &&
+		 texture->mComponents == components && texture->mMipMapped == mipmapped))
+	{
+		return;
+	}
+	mResidentBytes -= getBytes(*texture, texture->mResident);
+	texture->mWidth = full_width;
+	texture->mHeight = full_height;
+	texture->mComponents = components;
+	texture->mMipMapped = mipmapped;
+	mResidentBytes += getBytes(*texture, texture->mResident);
+
+	if (mTrace)
+	{
+		*mTrace << "size " << handle << ' ' << full_width << ' ' << full_height << ' ' << components << ' ' << (S32)mipmapped << '\n';
+	}
+}
+
+void LLTextureResidencyManager::setWanted(handle_t handle, S32 discard, S32 max_discard, F32 priority, BOOL pinned)
+{
+	Texture* texture = getTexture(handle);
+	if (!texture)
+	{
+		return;
+	}
+	discard = llmax(discard, 0);
+	max_discard = llmax(max_discard, 0);
+	if (texture->mWanted == discard && texture->mMaxDiscard == max_discard &&
+		texture->mPriority == priority && texture->mPinned == pinned)
+	{
+		return;
+	}
+	// mMaxDiscard changes what the resident level costs
+	mResidentBytes -= getBytes(*texture, texture->mResident);
+	texture->mWanted = discard;
+	texture->mMaxDiscard = max_discard;
+	texture->mPriority = priority;
+	texture->mPinned = pinned;
+	mResidentBytes += getBytes(*texture, texture->mResident);
+
+	if (mTrace)
+	{
+		*mTrace << "wanted " << handle << ' ' << discard << ' ' << max_discard << ' ' << priority << ' ' << (S32)pinned << '\n';
+	}
+}
+
+void LLTextureResidencyManager::setResident(handle_t handle, S32 discard)
+{
+	Texture* texture = getTexture(handle);
+	if (!texture || texture->mResident == discard)
+	{
+		return;
+	}
+	mResidentBytes -= getBytes(*texture, texture->mResident);
+	texture->mResident = discard;
+	mResidentBytes += getBytes(*texture, texture->mResident);
+
+	if (mTrace)
+	{
+		*mTrace << "resident " << handle << ' ' << discard << '\n';
+	}
+}
+
+S32 LLTextureResidencyManager::getDiscardLimit(handle_t handle) const
+{
+	const Texture* texture = getTexture(handle);
+	return texture ? texture->mLimit : -1;
+}
+
+void* LLTextureResidencyManager::getUserData(handle_t handle) const
+{
+	const Texture* texture = getTexture(handle);
+	return texture ? texture->mUserData : NULL;
+}
+
+void LLTextureResidencyManager::clear()
+{
+	// swap to release the memory, textures destroyed after us still call removeTexture()
+	std::vector<Texture>().swap(mTextures);
+	std::vector<S32>().swap(mFreeTextures);
+	std::vector<Candidate>().swap(mHeap);
+	std::vector<handle_t>().swap(mChangedTextures);
+	mNumTextures = 0;
+	mNumLimited = 0;
+	mResidentBytes = 0;
+	mWantedBytes = 0;
+	mPlannedBytes = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LLTextureResidencyManager::update()
+{
+	if (mTrace)
+	{
+		*mTrace << "update " << mBudget << '\n';
+	}
+
+	mWantedBytes = 0;
+	mHeap.clear();
+	const S32 count = (S32)mTextures.size();
+	for (S32 i = 0; i < count; i++)
+	{
+		Texture& texture = mTextures[i];
+		if (!texture.mInUse)
+		{
+			continue;
+		}
+		texture.mPrevLimit = texture.mLimit;
+		texture.mLimit = texture.mWanted >= 0 ? texture.mWanted : texture.mResident;
+		mWantedBytes += getBytes(texture, texture.mLimit);
+		if (!texture.mPinned && texture.mLimit >= 0 && texture.mLimit < texture.mMaxDiscard)
+		{
+			mHeap.push_back(Candidate(llmax(texture.mPriority, 0.f), i));
+		}
+	}
+
+	S64 target = mBudget;
+	if (mResidentBytes > mBudget)
+	{
+		target = (S64)(mBudget * RESIDENCY_LOW_WATER);
+	}
+
+	mPlannedBytes = mWantedBytes;
+	mNumLimited = 0;
+	if (mBudget > 0 && mPlannedBytes > target)
+	{
+		reduce(target);
+	}
+
+	mChangedTextures.clear();
+	for (S32 i = 0; i < count; i++)
+	{
+		const Texture& texture = mTextures[i];
+		if (texture.mInUse && texture.mWanted >= 0 && texture.mLimit != texture.mPrevLimit)
+		{
+			mChangedTextures.push_back(i + 1);
+		}
+	}
+}
+
+void LLTextureResidencyManager::reduce(S64 target)
+{
+	std::make_heap(mHeap.begin(), mHeap.end());
+	while (mPlannedBytes > target && !mHeap.empty())
+	{
+		std::pop_heap(mHeap.begin(), mHeap.end());
+		Candidate candidate = mHeap.back();
+		mHeap.pop_back();
+
+		Texture& texture = mTextures[candidate.mIndex];
+		if (texture.mLimit == texture.mWanted)
+		{
+			mNumLimited++;
+		}
+		mPlannedBytes -= getBytes(texture, texture.mLimit) - getBytes(texture, texture.mLimit + 1);
+		texture.mLimit++;
+		if (texture.mLimit < texture.mMaxDiscard)
+		{
+			mHeap.push_back(Candidate(candidate.mKey * RESIDENCY_LEVEL_WEIGHT, candidate.mIndex));
+			std::push_heap(mHeap.begin(), mHeap.end());
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+S32 LLTextureResidencyManager::replayTrace(std::istream& trace)
+{
+	// handles of the recorded session to ours
+	std::map<handle_t, handle_t> handles;
+	S32 updates = 0;
+	std::string op;
+	while (trace >> op)
+	{
+		handle_t handle = 0;
+		if (op == "update")
+		{
+			S64 budget;
+			if (!(trace >> budget))
+			{
+				return -1;
+			}
+			setBudget(budget);
+			update();
+			updates++;
+			continue;
+		}
+		if (!(trace >> handle))
+		{
+			return -1;
+		}
+		if (op == "add" || op == "size")
+		{
+			S32 width, height, components, mipmapped;
+			if (!(trace >> width >> height >> components >> mipmapped))
+			{
+				return -1;
+			}
+			if (op == "add")
+			{
+				handles[handle] = addTexture(width, height, components, mipmapped);
+			}
+			else
+			{
+				setTextureSize(handles[handle], width, height, components, mipmapped);
+			}
+		}
+		else if (op == "remove")
+		{
+			std::map<handle_t, handle_t>::iterator iter = handles.find(handle);
+			if (iter != handles.end())
+			{
+				removeTexture(iter->second);
+				handles.erase(iter);
+			}
+		}
+		else if (op == "wanted")
+		{
+			S32 discard, max_discard, pinned;
+			F32 priority;
+			if (!(trace >> discard >> max_discard >> priority >> pinned))
+			{
+				return -1;
+			}
+			setWanted(handles[handle], discard, max_discard, priority, pinned);
+		}
+		else if (op == "resident")
+		{
+			S32 discard;
+			if (!(trace >> discard))
+			{
+				return -1;
+			}
+			setResident(handles[handle], discard);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	return updates;
+}
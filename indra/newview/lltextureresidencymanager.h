@@ -0,0 +1,148 @@
+/**
+ * @file lltextureresidencymanager.h
+ * @brief Keeps the GL memory of the fetched textures within a byte budget
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURERESIDENCYMANAGER_H
+#define LL_LLTEXTURERESIDENCYMANAGER_H
+
+#include <iosfwd>
+#include <vector>
+
+// Each texture reports the discard level it would load without any memory
+// constraint (its wanted level) and how important it is. Once per frame
+// update() assigns every texture a discard limit, the finest level it may
+// load, such that the wanted textures fit the budget: starting from the
+// wanted levels, the least important texture is pushed one level coarser
+// until the total fits. Each step down makes a texture 4 times more
+// important for the next pass, so the cost is spread over the least visible
+// textures instead of blurring everything like a global discard bias does.
+//
+// Bytes are exact: the same accounting LLImageGL does for the mip chain of an
+// uncompressed 8 bit per component texture.
+//
+// The manager does not know about LLViewerFetchedTexture, textures are
+// handles, so recorded traces (see setTraceStream()) can be replayed
+// without a viewer.
+
+class LLTextureResidencyManager
+{
+public:
+	typedef S32 handle_t; // 0 is no texture
+
+	LLTextureResidencyManager();
+	~LLTextureResidencyManager();
+
+	static S64 calcBytes(S32 full_width, S32 full_height, S32 components, BOOL mipmapped, S32 discard);
+
+	// user_data is handed back by getUserData()
+	handle_t addTexture(S32 full_width, S32 full_height, S32 components, BOOL mipmapped, void* user_data = NULL);
+	void removeTexture(handle_t handle);
+	void setTextureSize(handle_t handle, S32 full_width, S32 full_height, S32 components, BOOL mipmapped);
+	// Pinned textures (UI, sculpts...) always get their wanted level. A
+	// wanted level above max_discard means the texture is not needed.
+	void setWanted(handle_t handle, S32 discard, S32 max_discard, F32 priority, BOOL pinned);
+	// The discard level the texture has in GL, -1 when it has no GL texture.
+	// Textures that never called setWanted() are planned at this level.
+	void setResident(handle_t handle, S32 discard);
+	// As of the last update(), -1 for unknown handles
+	S32 getDiscardLimit(handle_t handle) const;
+	void* getUserData(handle_t handle) const;
+
+	void setBudget(S64 bytes) { mBudget = bytes; }
+	// Recomputes the discard limits. While the resident textures are over
+	// budget the limits aim below it, so the fetcher does not bring back
+	// what scaling down just released.
+	void update();
+	// Textures taking part through setWanted() whose discard limit changed in the last update()
+	const std::vector<handle_t>& getChangedTextures() const { return mChangedTextures; }
+	// Drops all the textures
+	void clear();
+
+	S64 getBudget() const			{ return mBudget; }
+	S64 getResidentBytes() const	{ return mResidentBytes; }
+	S64 getWantedBytes() const		{ return mWantedBytes; }	// as of the last update()
+	S64 getPlannedBytes() const		{ return mPlannedBytes; }	// as of the last update()
+	S32 getNumTextures() const		{ return mNumTextures; }
+	S32 getNumLimited() const		{ return mNumLimited; }		// textures held above their wanted level
+
+	// Writes every call to trace, NULL stops. The format is one call per line:
+	//  add <handle> <width> <height> <components> <mipmapped>
+	//  size <handle> <width> <height> <components> <mipmapped>
+	//  remove <handle>
+	//  wanted <handle> <discard> <max discard> <priority> <pinned>
+	//  resident <handle> <discard>
+	//  update <budget>
+	void setTraceStream(std::ostream* trace) { mTrace = trace; }
+	// Applies a trace to this manager. Returns the number of updates
+	// replayed, -1 on a malformed line.
+	S32 replayTrace(std::istream& trace);
+
+private:
+	struct Texture
+	{
+		S32 mWidth;
+		S32 mHeight;
+		S32 mComponents;
+		BOOL mMipMapped;
+		BOOL mPinned;
+		BOOL mInUse;
+		S32 mWanted;		// -1 until setWanted()
+		S32 mMaxDiscard;
+		S32 mResident;		// -1 when not in GL
+		S32 mLimit;
+		S32 mPrevLimit;		// before the last update()
+		F32 mPriority;
+		void* mUserData;
+	};
+
+	// Eviction candidate: the texture with the smallest key goes one level coarser
+	struct Candidate
+	{
+		Candidate(F32 key, S32 index) : mKey(key), mIndex(index) {}
+		bool operator<(const Candidate& rhs) const { return mKey > rhs.mKey; } // min heap
+		F32 mKey;
+		S32 mIndex;
+	};
+
+	Texture* getTexture(handle_t handle);
+	const Texture* getTexture(handle_t handle) const;
+	S64 getBytes(const Texture& texture, S32 discard) const;
+	// Pushes the least important textures coarser until the plan fits target
+	void reduce(S64 target);
+
+	std::vector<Texture> mTextures;		// handle - 1
+	std::vector<S32> mFreeTextures;
+	std::vector<Candidate> mHeap;		// kept to not reallocate every frame
+	std::vector<handle_t> mChangedTextures;
+	S32 mNumTextures;
+	S32 mNumLimited;
+	S64 mBudget;
+	S64 mResidentBytes;
+	S64 mWantedBytes;
+	S64 mPlannedBytes;
+	std::ostream* mTrace;
+};
+
+#endif // LL_LLTEXTURERESIDENCYMANAGER_H
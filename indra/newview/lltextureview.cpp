@@ -34,6 +34,7 @@
 #include "llerror.h"
 #include "lllfsthread.h"
 #include "llui.h"
+#include "llimagej2cdecodecache.h"
 #include "llimageworker.h"
 #include "llrender.h"
 
@@ -538,6 +539,28 @@ void LLGLTexMemBar::draw()
 	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*3,
 											 text_color, LLFontGL::LEFT, LLFontGL::TOP);
 
+	text = llformat("Decode Cache: %.1f/%.1f MB Hits: %d Reduced: %d Misses: %d",
+					(F32)LLImageJ2CDecodeCache::getCacheBytes() / (1024 * 1024),
+					(F32)LLImageJ2CDecodeCache::getCacheSize() / (1024 * 1024),
+					LLImageJ2CDecodeCache::getHits(),
+					LLImageJ2CDecodeCache::getReducedHits(),
+					LLImageJ2CDecodeCache::getMisses());
+
+	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*4,
+											 text_color, LLFontGL::LEFT, LLFontGL::TOP);
+
+	LLTextureResidencyManager& residency = gTextureList.getResidencyManager();
+	text = llformat("Residency: %d/%d MB Planned: %d MB Wanted: %d MB Limited: %d/%d",
+					(S32)BYTES_TO_MEGA_BYTES(residency.getResidentBytes()),
+					(S32)BYTES_TO_MEGA_BYTES(residency.getBudget()),
+					(S32)BYTES_TO_MEGA_BYTES(residency.getPlannedBytes()),
+					(S32)BYTES_TO_MEGA_BYTES(residency.getWantedBytes()),
+					residency.getNumLimited(),
+					residency.getNumTextures());
+
+	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*5,
+											 text_color, LLFontGL::LEFT, LLFontGL::TOP);
+
 	//----------------------------------------------------------------------------
 #if 0
 	S32 bar_left = 400;
@@ -54,6 +54,7 @@
 #include "llvosky.h"
 #include "llvotree.h"
 #include "llvovolume.h"
+#include "llvolumemgr.h"
 #include "llworld.h"
 #include "pipeline.h"
 #include "llviewerjoystick.h"
@@ -151,6 +152,18 @@ static bool handleAnisotropicChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleTexturePixelBuffersChanged(const LLSD& newvalue)
+{
+	LLImageGL::setPixelBufferUploads((S32)newvalue.asInteger());
+	return true;
+}
+
+static bool handleTextureUploadBudgetChanged(const LLSD& newvalue)
+{
+	LLImageGL::setUploadBudget((S32)newvalue.asInteger() * 1024);
+	return true;
+}
+
 static bool handleVolumeLODChanged(const LLSD& newvalue)
 {
 	LLVOVolume::sLODFactor = (F32) newvalue.asReal();
@@ -333,6 +346,30 @@ static bool handleRenderDynamicLODChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleRenderCullThreadedChanged(const LLSD& newvalue)
+{
+	LLPipeline::sCullThreaded = newvalue.asBoolean();
+	return true;
+}
+
+static bool handleRenderVolumeBuildThreadedChanged(const LLSD& newvalue)
+{
+	LLPrimitive::getVolumeManager()->setThreadPool(newvalue.asBoolean() ? LLAppViewer::getThreadPool() : NULL);
+	return true;
+}
+
+static bool handleRenderVolumeCacheMBChanged(const LLSD& newvalue)
+{
+	LLPrimitive::getVolumeManager()->setCacheBudget((S32)llmin(newvalue.asInteger(), 1024) * 1024 * 1024);
+	return true;
+}
+
+static bool handleRenderOptimizeVolumeFacesChanged(const LLSD& newvalue)
+{
+	LLVolume::sOptimizeCacheOrder = newvalue.asBoolean();
+	return true;
+}
+
 static bool handleRenderUseFBOChanged(const LLSD& newvalue)
 {
 	LLRenderTarget::sUseFBO = newvalue.asBoolean();
@@ -408,6 +445,7 @@ bool handleEffectColorChanged(const LLSD& newvalue)
 bool handleVectorizeChanged(const LLSD& newvalue)
 {
 	LLViewerJointMesh::updateVectorize();
+	LLPipeline::updateCullVariant();
 	return true;
 }
 
@@ -531,6 +569,8 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("RenderSpecularExponent")->getSignal()->connect(boost::bind(&handleReleaseGLBufferChanged, _2));
 	gSavedSettings.getControl("RenderFSAASamples")->getSignal()->connect(boost::bind(&handleReleaseGLBufferChanged, _2));
 	gSavedSettings.getControl("RenderAnisotropic")->getSignal()->connect(boost::bind(&handleAnisotropicChanged, _2));
+	gSavedSettings.getControl("RenderTexturePixelBuffers")->getSignal()->connect(boost::bind(&handleTexturePixelBuffersChanged, _2));
+	gSavedSettings.getControl("TextureUploadBudgetKBPerFrame")->getSignal()->connect(boost::bind(&handleTextureUploadBudgetChanged, _2));
 	gSavedSettings.getControl("RenderShadowResolutionScale")->getSignal()->connect(boost::bind(&handleReleaseGLBufferChanged, _2));
 	gSavedSettings.getControl("RenderGlow")->getSignal()->connect(boost::bind(&handleReleaseGLBufferChanged, _2));
 	gSavedSettings.getControl("RenderGlow")->getSignal()->connect(boost::bind(&handleSetShaderChanged, _2));
@@ -550,6 +590,10 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("RenderFogRatio")->getSignal()->connect(boost::bind(&handleFogRatioChanged, _2));
 	gSavedSettings.getControl("RenderMaxPartCount")->getSignal()->connect(boost::bind(&handleMaxPartCountChanged, _2));
 	gSavedSettings.getControl("RenderDynamicLOD")->getSignal()->connect(boost::bind(&handleRenderDynamicLODChanged, _2));
+	gSavedSettings.getControl("RenderCullThreaded")->getSignal()->connect(boost::bind(&handleRenderCullThreadedChanged, _2));
+	gSavedSettings.getControl("RenderVolumeBuildThreaded")->getSignal()->connect(boost::bind(&handleRenderVolumeBuildThreadedChanged, _2));
+	gSavedSettings.getControl("RenderVolumeCacheMB")->getSignal()->connect(boost::bind(&handleRenderVolumeCacheMBChanged, _2));
+	gSavedSettings.getControl("RenderOptimizeVolumeFaces")->getSignal()->connect(boost::bind(&handleRenderOptimizeVolumeFacesChanged, _2));
 	gSavedSettings.getControl("RenderDebugTextureBind")->getSignal()->connect(boost::bind(&handleResetVertexBuffersChanged, _2));
 	gSavedSettings.getControl("RenderAutoMaskAlphaDeferred")->getSignal()->connect(boost::bind(&handleResetVertexBuffersChanged, _2));
 	gSavedSettings.getControl("RenderAutoMaskAlphaNonDeferred")->getSignal()->connect(boost::bind(&handleResetVertexBuffersChanged, _2));
@@ -51,6 +51,7 @@
 #include "llsky.h"
 #include "pipeline.h"
 #include "llviewershadermgr.h"
+#include "llskinningkernel.h"
 #include "llmath.h"
 #include "v4math.h"
 #include "m3math.h"
@@ -892,6 +893,11 @@ static U32 sUpdateGeometryLastProcessor		= 0 ;
 static BOOL sVectorizePerfTest 				= FALSE;
 static U32 sVectorizeProcessor 				= 0;
 
+// Meshes waiting for flushSkinning(), and the joint matrices of each
+static std::vector<LLSkinningJob> sSkinningJobs;
+static std::vector<U32> sSkinningJobMatrices;	// offset of each job's matrices
+static std::vector<LLMatrix4> sSkinningMatrices;
+
 //static
 void (*LLViewerJointMesh::sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
 
@@ -918,7 +924,14 @@ void LLViewerJointMesh::updateVectorize()
 		switch(sVectorizeProcessor)
 		{
 			case 2:
-				sUpdateGeometryFunc = &updateGeometrySSE2;
+				if (LLSkinningKernel::setVariant(LLSkinningKernel::VARIANT_SSE2))
+				{
+					sUpdateGeometryFunc = &updateGeometryBatched;
+				}
+				else
+				{
+					sUpdateGeometryFunc = &updateGeometrySSE2;
+				}
 				break;
 			case 1:
 				sUpdateGeometryFunc = &updateGeometrySSE;
@@ -966,6 +979,8 @@ void LLViewerJointMesh::updateJointGeometry()
 				uploadJointMatrices();
 			// call accelerated version for this processor
 			sUpdateGeometryFunc(mFace, mMesh);
+			// time the batched version's skinning too
+			flushSkinning();
 		}
 		else
 		{
@@ -1071,6 +1086,71 @@ void LLViewerJointMesh::updateJointGeometry()
 	}
 }
 
+// static
+void LLViewerJointMesh::updateGeometryBatched(LLFace *face, LLPolyMesh *mesh)
+{
+	LLStrider<LLVector3> o_vertices;
+	LLStrider<LLVector3> o_normals;
+
+	LLVertexBuffer *buffer = face->mVertexBuffer;
+	if (!buffer->getVertexStrider(o_vertices, mesh->mFaceVertexOffset)
+		|| !buffer->getNormalStrider(o_normals, mesh->mFaceVertexOffset))
+	{
+		return;
+	}
+	llassert(o_vertices.getSkip() == o_normals.getSkip());
+
+	// joint matrices with the skin offsets, as updateGeometrySSE2() has them
+	LLDynamicArray<LLJointRenderData*>& joint_data = mesh->getReferenceMesh()->mJointRenderData;
+	U32 first_matrix = sSkinningMatrices.size();
+	for (S32 j = 0, jend = joint_data.count(); j < jend; ++j)
+	{
+		const LLVector3& offset = joint_data[j]->mSkinJoint ?
+			joint_data[j]->mSkinJoint->mRootToJointSkinOffset
+			: joint_data[j+1]->mSkinJoint->mRootToParentJointSkinOffset;
+		sSkinningMatrices.push_back(*joint_data[j]->mWorldMatrix);
+		LLMatrix4& mat = sSkinningMatrices.back();
+		for (S32 i = VX; i <= VW; i++)
+		{
+			mat.mMatrix[VW][i] += offset.mV[VX] * mat.mMatrix[VX][i]
+								+ offset.mV[VY] * mat.mMatrix[VY][i]
+								+ offset.mV[VZ] * mat.mMatrix[VZ][i];
+		}
+	}
+
+	LLSkinningJob job;
+	job.mNumVertices = mesh->getNumVertices();
+	job.mWeights = mesh->getWeights();
+	job.mCoords = mesh->getCoords();
+	job.mNormals = mesh->getNormals();
+	job.mJointMatrices = NULL;		// set by flushSkinning()
+	job.mOutCoords = (U8*)o_vertices.get();
+	job.mOutNormals = (U8*)o_normals.get();
+	job.mOutStride = o_vertices.getSkip();
+	sSkinningJobs.push_back(job);
+	sSkinningJobMatrices.push_back(first_matrix);
+}
+
+// static
+void LLViewerJointMesh::flushSkinning()
+{
+	if (sSkinningJobs.empty())
+	{
+		return;
+	}
+
+	// the matrices may have moved as the jobs were queued
+	for (U32 i = 0; i < sSkinningJobs.size(); i++)
+	{
+		sSkinningJobs[i].mJointMatrices = &sSkinningMatrices[sSkinningJobMatrices[i]];
+	}
+	LLSkinningKernel::skin(&sSkinningJobs[0], sSkinningJobs.size());
+
+	sSkinningJobs.clear();
+	sSkinningJobMatrices.clear();
+	sSkinningMatrices.clear();
+}
+
 void LLViewerJointMesh::dump()
 {
 	if (mValid)
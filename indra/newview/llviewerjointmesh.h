@@ -144,6 +144,11 @@ public:
 	/*virtual*/ BOOL isAnimatable() const { return FALSE; }
 	
 	static void updateVectorize(); // Update globals when settings variables change
+
+	// Skins the meshes updateJointGeometry() queued for the batched
+	// skinning kernel. Must be called before their vertex buffers are
+	// unmapped.
+	static void flushSkinning();
 	
 private:
 	// Avatar vertex skinning is a significant performance issue on computers
@@ -157,6 +162,9 @@ private:
 	static void updateGeometryVectorized(LLFace* face, LLPolyMesh* mesh);
 	static void updateGeometrySSE(LLFace* face, LLPolyMesh* mesh);
 	static void updateGeometrySSE2(LLFace* face, LLPolyMesh* mesh);
+	// queues the mesh for flushSkinning(), which skins a batch of meshes
+	// with the SSE2 LLSkinningKernel
+	static void updateGeometryBatched(LLFace* face, LLPolyMesh* mesh);
 
 	// Use a fuction pointer to indicate which version we are running.
 	static void (*sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
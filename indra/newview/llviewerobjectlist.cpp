@@ -88,8 +88,8 @@ extern LLPipeline	gPipeline;
 
 // Statics for object lookup tables.
 U32						LLViewerObjectList::sSimulatorMachineIndex = 1; // Not zero deliberately, to speed up index check.
-std::map<U64, U32>			LLViewerObjectList::sIPAndPortToIndex;
-std::map<U64, LLUUID>	LLViewerObjectList::sIndexAndLocalIDToUUID;
+LLOpenHashMap<U64, U32>		LLViewerObjectList::sIPAndPortToIndex;
+LLOpenHashMap<U64, LLUUID>	LLViewerObjectList::sIndexAndLocalIDToUUID;
 
 LLViewerObjectList::LLViewerObjectList()
 {
@@ -140,7 +140,8 @@ void LLViewerObjectList::getUUIDFromLocal(LLUUID &id,
 
 	U64	indexid = (((U64)index) << 32) | (U64)local_id;
 
-	id = get_if_there(sIndexAndLocalIDToUUID, indexid, LLUUID::null);
+	LLOpenHashMap<U64, LLUUID>::const_iterator iter = sIndexAndLocalIDToUUID.find(indexid);
+	id = (iter != sIndexAndLocalIDToUUID.end()) ? iter->second : LLUUID::null;
 }
 
 U64 LLViewerObjectList::getIndex(const U32 local_id,
@@ -179,7 +180,7 @@ BOOL LLViewerObjectList::removeFromLocalIDTable(const LLViewerObject &object)
 		
 		U64	indexid = (((U64)index) << 32) | (U64)local_id;
 		
-		std::map<U64, LLUUID>::iterator iter = sIndexAndLocalIDToUUID.find(indexid);
+		LLOpenHashMap<U64, LLUUID>::iterator iter = sIndexAndLocalIDToUUID.find(indexid);
 		if (iter == sIndexAndLocalIDToUUID.end())
 		{
 			return FALSE;
@@ -345,6 +346,13 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 	U8 compressed_dpbuffer[2048];
 	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
 	LLDataPacker *cached_dpp = NULL;
+
+	// Read for every object of every update, see LLMessageField
+	static LLMessageField object_id(_PREHASH_ObjectData, _PREHASH_ID);
+	static LLMessageField object_crc(_PREHASH_ObjectData, _PREHASH_CRC);
+	static LLMessageField object_update_flags(_PREHASH_ObjectData, _PREHASH_UpdateFlags);
+	static LLMessageField object_data(_PREHASH_ObjectData, _PREHASH_Data);
+	static LLMessageField object_full_id(_PREHASH_ObjectData, _PREHASH_FullID);
 	
 	for (i = 0; i < num_objects; i++)
 	{
@@ -355,8 +363,8 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		{
 			U32 id;
 			U32 crc;
-			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, id, i);
-			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_CRC, crc, i);
+			mesgsys->getU32(object_id, id, i);
+			mesgsys->getU32(object_crc, crc, i);
 		
 			// Lookup data packer and add this id to cache miss lists if necessary.
 			cached_dpp = regionp->getDP(id, crc);
@@ -382,13 +390,13 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			U32 flags = 0;
 			if (update_type != OUT_TERSE_IMPROVED)
 			{
-				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
+				mesgsys->getU32(object_update_flags, flags, i);
 			}
 			
 			if (flags & FLAGS_ZLIB_COMPRESSED)
 			{
-				compressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compbuffer, 0, i);
+				compressed_length = mesgsys->getSize(object_data, i);
+				mesgsys->getBinaryData(object_data, compbuffer, 0, i);
 				uncompressed_length = 2048;
 				uncompress(compressed_dpbuffer, (unsigned long *)&uncompressed_length,
 						   compbuffer, compressed_length);
@@ -396,8 +404,8 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			}
 			else
 			{
-				uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compressed_dpbuffer, 0, i);
+				uncompressed_length = mesgsys->getSize(object_data, i);
+				mesgsys->getBinaryData(object_data, compressed_dpbuffer, 0, i);
 				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
 			}
 
@@ -424,7 +432,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		}
 		else if (update_type != OUT_FULL)
 		{
-			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			mesgsys->getU32(object_id, local_id, i);
 			getUUIDFromLocal(fullid,
 							local_id,
 							gMessageSystem->getSenderIP(),
@@ -437,8 +445,8 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		}
 		else
 		{
-			mesgsys->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, fullid, i);
-			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			mesgsys->getUUID(object_full_id, fullid, i);
+			mesgsys->getU32(object_id, local_id, i);
 			// llinfos << "Full Update, obj " << local_id << ", global ID" << fullid << "from " << mesgsys->getSender() << llendl;
 		}
 		objectp = findObject(fullid);
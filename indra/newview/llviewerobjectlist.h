@@ -31,6 +31,7 @@
 #include <set>
 
 // common includes
+#include "llopenhashmap.h"
 #include "llstat.h"
 #include "llstring.h"
 
@@ -183,16 +184,19 @@ protected:
 	typedef std::map<LLUUID, LLPointer<LLViewerObject> > vo_map;
 	vo_map mDeadObjects;	// Need to keep multiple entries per UUID
 
-	std::map<LLUUID, LLPointer<LLViewerObject> > mUUIDObjectMap;
+	// Looked up for every object of every update, hashed rather than sorted
+	typedef LLOpenHashMap<LLUUID, LLPointer<LLViewerObject>, lluuid_hash> uuid_object_map_t;
+	uuid_object_map_t mUUIDObjectMap;
 
 	std::vector<LLDebugBeacon> mDebugBeacons;
 
 	S32 mCurLazyUpdateIndex;
 
 	static U32 sSimulatorMachineIndex;
-	static std::map<U64, U32> sIPAndPortToIndex;
+	static LLOpenHashMap<U64, U32> sIPAndPortToIndex;
 
-	static std::map<U64, LLUUID> sIndexAndLocalIDToUUID;
+	// Keyed on the simulator index in the high 32 bits and the local id
+	static LLOpenHashMap<U64, LLUUID> sIndexAndLocalIDToUUID;
 
 	std::set<LLViewerObject *> mSelectPickList;
 
@@ -231,7 +235,7 @@ extern LLViewerObjectList gObjectList;
  */
 inline LLViewerObject *LLViewerObjectList::findObject(const LLUUID &id)
 {
-	std::map<LLUUID, LLPointer<LLViewerObject> >::iterator iter = mUUIDObjectMap.find(id);
+	uuid_object_map_t::iterator iter = mUUIDObjectMap.find(id);
 	if(iter != mUUIDObjectMap.end())
 	{
 		return iter->second;
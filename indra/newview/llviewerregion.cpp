@@ -211,7 +211,7 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mProductName("unknown"),
 	mHttpUrl(""),
 	mCacheLoaded(FALSE),
-	mCacheDirty(FALSE),
+	mCacheFile(NULL),
 	mCacheID(),
 	mEventPoll(NULL),
 	mReleaseNotesRequested(FALSE),
@@ -333,7 +333,13 @@ void LLViewerRegion::loadObjectCache()
 
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->readFromCache(mHandle, mCacheID, mCacheMap) ;
+		LLTimer timer;
+		mCacheFile = LLVOCache::getInstance()->openRegionCache(mHandle, mCacheID) ;
+		if (mCacheFile)
+		{
+			llinfos << "Opened object cache of " << getName() << ", " << mCacheFile->getNumEntries()
+					<< " entries in " << timer.getElapsedTimeF32() * 1000.f << " ms" << llendl;
+		}
 	}
 }
 
@@ -345,22 +351,31 @@ void LLViewerRegion::saveObjectCache()
 		return;
 	}
 
-	if (mCacheMap.empty())
-	{
-		return;
-	}
-
-	if(LLVOCache::hasInstance())
-	{
-		LLVOCache::getInstance()->writeToCache(mHandle, mCacheID, mCacheMap, mCacheDirty) ;
-		mCacheDirty = FALSE;
-	}
-
+	// The entries are in the file already, only their counters changed
+	LLTimer timer;
 	for(LLVOCacheEntry::vocache_entry_map_t::iterator iter = mCacheMap.begin(); iter != mCacheMap.end(); ++iter)
 	{
+		if (mCacheFile)
+		{
+			mCacheFile->updateCounts(*iter->second);
+		}
 		delete iter->second;
 	}
 	mCacheMap.clear();
+
+	if (mCacheFile)
+	{
+		if(LLVOCache::hasInstance())
+		{
+			LLVOCache::getInstance()->closeRegionCache(mHandle, mCacheFile) ;
+		}
+		else
+		{
+			delete mCacheFile;
+		}
+		mCacheFile = NULL;
+		llinfos << "Closed object cache of " << getName() << " in " << timer.getElapsedTimeF32() * 1000.f << " ms" << llendl;
+	}
 }
 
 void LLViewerRegion::sendMessage()
@@ -1038,6 +1053,18 @@ void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinary
 	U32 crc = objectp->getCRC();
 
 	LLVOCacheEntry* entry = get_if_there(mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	U32 cached_crc = 0;
+	BOOL in_file = mCacheFile && mCacheFile->getCRC(local_id, cached_crc);
+	if (!entry && in_file && cached_crc == crc)
+	{
+		// we've seen this object on an earlier visit, read it back so
+		// the dupe is counted
+		entry = mCacheFile->readEntry(local_id);
+		if (entry)
+		{
+			mCacheMap[local_id] = entry;
+		}
+	}
 
 	if (entry)
 	{
@@ -1046,30 +1073,29 @@ void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinary
 		{
 			// Record a hit
 			entry->recordDupe();
+			return;
 		}
-		else
-		{
-			// Update the cache entry
-			mCacheMap.erase(local_id);
-			delete entry;
-			entry = new LLVOCacheEntry(local_id, crc, dp);
-			mCacheMap[local_id] = entry;
-		}
+
+		// Update the cache entry
+		mCacheMap.erase(local_id);
+		delete entry;
 	}
-	else
+	else if (mCacheMap.size() > MAX_OBJECT_CACHE_ENTRIES)
 	{
-		// we haven't seen this object before
+		// we haven't seen this object before, make room for it
+		delete mCacheMap.begin()->second;
+		mCacheMap.erase(mCacheMap.begin());
+	}
 
-		// Create new entry and add to map
-		if (mCacheMap.size() > MAX_OBJECT_CACHE_ENTRIES)
-		{
-			mCacheMap.erase(mCacheMap.begin());
-		}
-		entry = new LLVOCacheEntry(local_id, crc, dp);
+	entry = new LLVOCacheEntry(local_id, crc, dp);
+	mCacheMap[local_id] = entry;
 
-		mCacheMap[local_id] = entry;
+	// Write the change through, the file does not take new objects past
+	// the same limit
+	if (mCacheFile && (in_file || mCacheFile->getNumEntries() < MAX_OBJECT_CACHE_ENTRIES))
+	{
+		mCacheFile->writeEntry(*entry);
 	}
-	return ;
 }
 
 // Get data packer for this object, if we have cached data
@@ -1079,6 +1105,15 @@ LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc)
 	llassert(mCacheLoaded);
 
 	LLVOCacheEntry* entry = get_if_there(mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	if (!entry && mCacheFile)
+	{
+		// Read the entry only now that the region asks for it
+		entry = mCacheFile->readEntry(local_id);
+		if (entry)
+		{
+			mCacheMap[local_id] = entry;
+		}
+	}
 
 	if (entry)
 	{
@@ -1181,8 +1216,6 @@ void LLViewerRegion::requestCacheMisses()
 	}
 	mCacheMissFull.reset();
 	mCacheMissCRC.reset();
-
-	mCacheDirty = TRUE ;
 	// llinfos << "KILLDEBUG Sent cache miss full " << full_count << " crc " << crc_count << llendl;
 }
 
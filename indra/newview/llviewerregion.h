@@ -62,6 +62,7 @@ class LLViewerParcelOverlay;
 class LLSurface;
 class LLVOCache;
 class LLVOCacheEntry;
+class LLVOCacheFile;
 class LLSpatialPartition;
 class LLEventPump;
 
@@ -386,12 +387,13 @@ private:
 	std::string mHttpUrl ;
 	
 	
-	// Maps local ids to cache entries.
+	// Maps local ids to the cache entries received or read back from
+	// mCacheFile during this visit.
 	// Regions can have order 10,000 objects, so assume
 	// a structure of size 2^14 = 16,000
 	BOOL									mCacheLoaded;
-	BOOL                                    mCacheDirty;
 	LLVOCacheEntry::vocache_entry_map_t		mCacheMap;
+	LLVOCacheFile*							mCacheFile;
 	LLDynamicArray<U32>						mCacheMissFull;
 	LLDynamicArray<U32>						mCacheMissCRC;
 	// time?
@@ -257,6 +257,14 @@ LLViewerStats::LLViewerStats() :
 	mNumRawImagesStat("numrawimagesstat", 32, TRUE),
 	mGLTexMemStat("gltexmemstat", 32, TRUE),
 	mGLBoundMemStat("glboundmemstat", 32, TRUE),
+	mTextureUploadKBStat("textureuploadkbstat", 32, TRUE),
+	mTextureUploadStallStat("textureuploadstallstat", 32, TRUE),
+	mImpostorAtlasFillStat("impostoratlasfillstat", 32, TRUE),
+	mImpostorUpdatesStat("impostorupdatesstat", 32, TRUE),
+	mImpostorUpdateTimeStat("impostorupdatetimestat", 32, TRUE),
+	mVolumeCacheMemStat("volumecachememstat", 32, TRUE),
+	mVolumeCacheHitStat("volumecachehitstat", 32, TRUE),
+	mVolumeBuildsStat("volumebuildsstat", 32, TRUE),
 	mRawMemStat("rawmemstat", 32, TRUE),
 	mFormattedMemStat("formattedmemstat", 32, TRUE),
 	mNumObjectsStat("numobjectsstat"),
@@ -101,6 +101,14 @@ public:
 	LLStat mNumRawImagesStat;
 	LLStat mGLTexMemStat;
 	LLStat mGLBoundMemStat;
+	LLStat mTextureUploadKBStat;	// KB handed to GL per frame
+	LLStat mTextureUploadStallStat;	// msec spent in texture uploads per frame
+	LLStat mImpostorAtlasFillStat;	// percent of the impostor atlas in use
+	LLStat mImpostorUpdatesStat;	// impostors redrawn per frame
+	LLStat mImpostorUpdateTimeStat;	// msec spent redrawing impostors per frame
+	LLStat mVolumeCacheMemStat;		// MB of unused volumes kept by LLVolumeMgr
+	LLStat mVolumeCacheHitStat;		// percent of volume requests served by an existing volume
+	LLStat mVolumeBuildsStat;		// new volumes per frame
 	LLStat mRawMemStat;
 	LLStat mFormattedMemStat;
 
@@ -427,7 +427,13 @@ void LLViewerTexture::updateClass(const F32 velocity, const F32 angular_velocity
 	sMaxTotalTextureMemInMegaBytes = gTextureList.getMaxTotalTextureMem() ;//in MB
 	sMaxDesiredTextureMemInBytes = MEGA_BYTES_TO_BYTES(sMaxTotalTextureMemInMegaBytes) ; //in Bytes, by default and when total used texture memory is small.
 
-	if (BYTES_TO_MEGA_BYTES(sBoundTextureMemoryInBytes) >= sMaxBoundTextureMemInMegaBytes ||
+	static LLCachedControl<bool> use_residency(gSavedSettings,"TextureResidencyManager");
+	if (use_residency)
+	{
+		// LLTextureResidencyManager picks the discard level of each texture, no global bias
+		sDesiredDiscardBias = 0.f;
+	}
+	else if (BYTES_TO_MEGA_BYTES(sBoundTextureMemoryInBytes) >= sMaxBoundTextureMemInMegaBytes ||
 		BYTES_TO_MEGA_BYTES(sTotalTextureMemoryInBytes) >= sMaxTotalTextureMemInMegaBytes)
 	{
 		//when texture memory overflows, lower down the threashold to release the textures more aggressively.
@@ -1133,6 +1139,7 @@ void LLViewerFetchedTexture::init(bool firstinit)
 	{
 		mDecodePriority = 0.f;
 		mInImageList = 0;
+		mResidencyHandle = 0;
 	}
 
 	// Only set mIsMissingAsset true when we know for certain that the database
@@ -1180,6 +1187,10 @@ LLViewerFetchedTexture::~LLViewerFetchedTexture()
 	{
 		LLAppViewer::getTextureFetch()->deleteRequest(getID(), true);
 	}
+	if (mResidencyHandle)
+	{
+		gTextureList.getResidencyManager().removeTexture(mResidencyHandle);
+	}
 	cleanup();	
 }
 
@@ -1308,6 +1319,7 @@ void LLViewerFetchedTexture::destroyTexture()
 	
 	destroyGLTexture() ;
 	mFullyLoaded = FALSE ;
+	updateResidency() ;
 }
 
 void LLViewerFetchedTexture::addToCreateTexture()
@@ -1473,9 +1485,28 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 		mNeedsAux = FALSE;
 		destroyRawImage();
 	}
+	updateResidency() ;
 	return res;
 }
 
+void LLViewerFetchedTexture::updateResidency()
+{
+	if (!mFullWidth || !mFullHeight || mGLTexturep.isNull())
+	{
+		return ;
+	}
+	LLTextureResidencyManager& residency = gTextureList.getResidencyManager() ;
+	if (!mResidencyHandle)
+	{
+		mResidencyHandle = residency.addTexture(mFullWidth, mFullHeight, mComponents, mUseMipMaps, this) ;
+	}
+	else
+	{
+		residency.setTextureSize(mResidencyHandle, mFullWidth, mFullHeight, mComponents, mUseMipMaps) ;
+	}
+	residency.setResident(mResidencyHandle, hasGLTexture() ? getDiscardLevel() : -1) ;
+}
+
 // Call with 0,0 to turn this feature off.
 //virtual
 void LLViewerFetchedTexture::setKnownDrawSize(S32 width, S32 height)
@@ -1496,6 +1527,8 @@ void LLViewerFetchedTexture::processTextureStats()
 {
 	static LLCachedControl<bool> textures_fullres(gSavedSettings,"TextureLoadFullRes");
 
+	updateResidency() ;
+
 	if(mFullyLoaded)
 	{
 		if(needsToSaveRawImage())//needs to reload
@@ -2966,8 +2999,10 @@ BOOL LLViewerLODTexture::isUpdateFrozen()
 void LLViewerLODTexture::processTextureStats()
 {
 	updateVirtualSize() ;
+	updateResidency() ;
 	
 	static LLCachedControl<bool> textures_fullres(gSavedSettings,"TextureLoadFullRes");
+	static LLCachedControl<bool> use_residency(gSavedSettings,"TextureResidencyManager");
 	
 	if (textures_fullres)
 	{
@@ -3049,6 +3084,20 @@ void LLViewerLODTexture::processTextureStats()
 		// Clamp to min desired discard
 		mDesiredDiscardLevel = llmin(mMinDesiredDiscardLevel, mDesiredDiscardLevel);
 
+		// Hold the texture at the discard level its share of the texture memory budget allows
+		S32 residency_limit = -1;
+		if (use_residency && mResidencyHandle)
+		{
+			LLTextureResidencyManager& residency = gTextureList.getResidencyManager() ;
+			residency.setWanted(mResidencyHandle, mDesiredDiscardLevel, getMaxDiscardLevel(), mMaxVirtualSize,
+								mBoostLevel >= LLViewerTexture::BOOST_SCULPTED) ;
+			residency_limit = residency.getDiscardLimit(mResidencyHandle) ;
+			if (residency_limit > mDesiredDiscardLevel)
+			{
+				mDesiredDiscardLevel = (S8)residency_limit ;
+			}
+		}
+
 		//
 		// At this point we've calculated the quality level that we want,
 		// if possible.  Now we check to see if we have it, and take the
@@ -3072,6 +3121,12 @@ void LLViewerLODTexture::processTextureStats()
 				
 			}
 		}
+		else if (residency_limit > current_discard && current_discard >= 0 && mBoostLevel < LLViewerTexture::BOOST_SCULPTED &&
+				 (!getBoundRecently() || mDesiredDiscardLevel >= mCachedRawDiscardLevel))
+		{
+			// Over its share of the budget
+			scaleDown() ;
+		}
 	}
 
 	if(mForceToSaveRawImage && mDesiredSavedRawDiscardLevel >= 0)
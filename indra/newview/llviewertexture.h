@@ -396,6 +396,8 @@ public:
 	
 	virtual void processTextureStats() ;
 	F32  calcDecodePriority() ;
+	// Reports the size and GL discard level to the texture residency manager
+	void updateResidency() ;
 
 	BOOL needsAux() const { return mNeedsAux; }
 
@@ -568,6 +570,8 @@ protected:
 	BOOL   mForSculpt ; //a flag if the texture is used as sculpt data.
 	BOOL   mIsFetched ; //is loaded from remote or from cache, not generated locally.
 
+	S32    mResidencyHandle ; //LLTextureResidencyManager handle, 0 until the size is known.
+
 public:
 	static LLPointer<LLViewerFetchedTexture> sMissingAssetImagep;	// Texture to show for an image asset that is not in the database
 	static LLPointer<LLViewerFetchedTexture> sWhiteImagep;	// Texture to show NOTHING (whiteness)
@@ -82,7 +82,8 @@ LLViewerTextureList::LLViewerTextureList()
 	: mForceResetTextureStats(FALSE),
 	mUpdateStats(FALSE),
 	mMaxResidentTexMemInMegaBytes(0),
-	mMaxTotalTextureMemInMegaBytes(0)
+	mMaxTotalTextureMemInMegaBytes(0),
+	mResidencyTrace(NULL)
 {
 }
 
@@ -101,6 +102,15 @@ void LLViewerTextureList::init()
 	
 	// Update how much texture RAM we're allowed to use.
 	updateMaxResidentTexMem(0); // 0 = use current
+
+	if (gSavedSettings.getBOOL("TextureResidencyTrace") && !mResidencyTrace)
+	{
+		// replay with LL_TEXTURE_RESIDENCY_TRACE=<file> lltextureresidencymanager test
+		std::string filename = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "texture_residency.trace");
+		mResidencyTrace = new llofstream(filename);
+		mResidencyManager.setTraceStream(mResidencyTrace);
+		llinfos << "Recording texture residency trace to " << filename << llendl;
+	}
 	
 	doPreloadImages();
 }
@@ -279,6 +289,11 @@ void LLViewerTextureList::shutdown()
 	mUUIDMap.clear();
 	
 	mImageList.clear();
+
+	mResidencyManager.setTraceStream(NULL);
+	delete mResidencyTrace;
+	mResidencyTrace = NULL;
+	mResidencyManager.clear();
 }
 
 void LLViewerTextureList::dump()
@@ -582,9 +597,12 @@ void LLViewerTextureList::updateImages(F32 max_time)
 	LLViewerStats::getInstance()->mNumRawImagesStat.addValue(LLImageRaw::sRawImageCount);
 	LLViewerStats::getInstance()->mGLTexMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageGL::sGlobalTextureMemoryInBytes));
 	LLViewerStats::getInstance()->mGLBoundMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageGL::sBoundTextureMemoryInBytes));
+	LLViewerStats::getInstance()->mTextureUploadKBStat.addValue((F32)LLImageGL::sUploadBytesLastFrame / 1024.f);
+	LLViewerStats::getInstance()->mTextureUploadStallStat.addValue(LLImageGL::sUploadStallTimeLastFrame * 1000.f);
 	LLViewerStats::getInstance()->mRawMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageRaw::sGlobalRawMemory));
 	LLViewerStats::getInstance()->mFormattedMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageFormatted::sGlobalFormattedMemory));
 	
+	updateImagesResidency();
 	updateImagesDecodePriorities();
 
 	F32 total_max_time = max_time;
@@ -693,24 +711,58 @@ void LLViewerTextureList::updateImagesDecodePriorities()
 				}
 			}
 			
-			imagep->processTextureStats();
-			F32 old_priority = imagep->getDecodePriority();
-			F32 old_priority_test = llmax(old_priority, 0.0f);
-			F32 decode_priority = imagep->calcDecodePriority();
-			F32 decode_priority_test = llmax(decode_priority, 0.0f);
-			// Ignore < 20% difference
-			if ((decode_priority_test < old_priority_test * .8f) ||
-				(decode_priority_test > old_priority_test * 1.25f))
-			{
-				removeImageFromList(imagep);
-				imagep->setDecodePriority(decode_priority);
-				addImageToList(imagep);
-			}
+			updateImageDecodePriority(imagep);
 			update_counter--;
 		}
 	}
 }
 
+void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imagep)
+{
+	imagep->processTextureStats();
+	F32 old_priority = imagep->getDecodePriority();
+	F32 old_priority_test = llmax(old_priority, 0.0f);
+	F32 decode_priority = imagep->calcDecodePriority();
+	F32 decode_priority_test = llmax(decode_priority, 0.0f);
+	// Ignore < 20% difference
+	if ((decode_priority_test < old_priority_test * .8f) ||
+		(decode_priority_test > old_priority_test * 1.25f))
+	{
+		removeImageFromList(imagep);
+		imagep->setDecodePriority(decode_priority);
+		addImageToList(imagep);
+	}
+}
+
+static LLFastTimer::DeclareTimer FTM_IMAGE_RESIDENCY("Texture Residency");
+
+void LLViewerTextureList::updateImagesResidency()
+{
+	static LLCachedControl<bool> use_residency(gSavedSettings, "TextureResidencyManager");
+	if (!use_residency)
+	{
+		return;
+	}
+	LLFastTimer t(FTM_IMAGE_RESIDENCY);
+
+	mResidencyManager.setBudget(MEGA_BYTES_TO_BYTES((S64)mMaxResidentTexMemInMegaBytes));
+	mResidencyManager.update();
+
+	// Apply the new discard limits right away, to a bounded number of textures
+	// per frame: the others catch up in updateImagesDecodePriorities().
+	const S32 MAX_RESIDENCY_UPDATES = 256;
+	const std::vector<LLTextureResidencyManager::handle_t>& changed = mResidencyManager.getChangedTextures();
+	const S32 count = llmin((S32)changed.size(), MAX_RESIDENCY_UPDATES);
+	for (S32 i = 0; i < count; i++)
+	{
+		LLViewerFetchedTexture* imagep = (LLViewerFetchedTexture*)mResidencyManager.getUserData(changed[i]);
+		if (imagep && imagep->isInImageList() && !imagep->isDeleted())
+		{
+			updateImageDecodePriority(imagep);
+		}
+	}
+}
+
 /*
  static U8 get_image_type(LLViewerFetchedTexture* imagep, LLHost target_host)
  {
@@ -758,7 +810,8 @@ F32 LLViewerTextureList::updateImagesCreateTextures(F32 max_time)
 		enditer = iter;
 		LLViewerFetchedTexture *imagep = *curiter;
 		imagep->createTexture();
-		if (create_timer.getElapsedTimeF32() > max_time)
+		// The rest waits for the next frame once the time or upload byte budget is spent
+		if (create_timer.getElapsedTimeF32() > max_time || LLImageGL::isUploadBudgetSpent())
 		{
 			break;
 		}
@@ -31,6 +31,7 @@
 //#include "message.h"
 #include "llgl.h"
 #include "llstat.h"
+#include "lltextureresidencymanager.h"
 #include "llviewertexture.h"
 #include "llui.h"
 #include <list>
@@ -104,6 +105,7 @@ public:
 	S32 getNumImages()					{ return mImageList.size(); }
 
 	void updateMaxResidentTexMem(S32 mem);
+	LLTextureResidencyManager& getResidencyManager() { return mResidencyManager; }
 	
 	void doPreloadImages();
 	void doPrefetchImages();
@@ -113,6 +115,8 @@ public:
 	
 private:
 	void updateImagesDecodePriorities();
+	void updateImageDecodePriority(LLViewerFetchedTexture* imagep);
+	void updateImagesResidency();
 	F32  updateImagesCreateTextures(F32 max_time);
 	F32  updateImagesFetchTextures(F32 max_time);
 	void updateImagesUpdateStats();
@@ -191,6 +195,9 @@ private:
 	S32	mMaxResidentTexMemInMegaBytes;
 	S32 mMaxTotalTextureMemInMegaBytes;
 	LLFrameTimer mForceDecodeTimer;
+
+	LLTextureResidencyManager mResidencyManager;
+	llofstream* mResidencyTrace;	// TextureResidencyTrace
 	
 public:
 	static U32 sTextureBits;
@@ -1439,6 +1439,8 @@ LLViewerWindow::LLViewerWindow(
 	// Init the image list.  Must happen after GL is initialized and before the images that
 	// LLViewerWindow needs are requested.
 	LLImageGL::initClass(LLViewerTexture::MAX_GL_IMAGE_CATEGORY) ;
+	LLImageGL::setPixelBufferUploads(gSavedSettings.getU32("RenderTexturePixelBuffers"));
+	LLImageGL::setUploadBudget(gSavedSettings.getU32("TextureUploadBudgetKBPerFrame") * 1024);
 	gTextureList.init();
 	LLViewerTextureManager::init() ;
 	gBumpImageList.init();
@@ -1489,7 +1491,7 @@ void LLViewerWindow::initGLDefaults()
 	glMaterialfv(GL_FRONT_AND_BACK,GL_DIFFUSE,diffuse);
 	
 	glPixelStorei(GL_PACK_ALIGNMENT,1);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	LLImageGL::setUnpackAlignment(1);
 
 	gGL.getTexUnit(0)->enable(LLTexUnit::TT_TEXTURE);
 
@@ -46,6 +46,7 @@
 #include "llagentcamera.h"
 #include "llagentwearables.h"
 #include "llanimationstates.h"
+#include "llappviewer.h"
 #include "llavatarnamecache.h"
 #include "llavatarpropertiesprocessor.h"
 #include "llviewercontrol.h"
@@ -81,6 +82,7 @@
 #include "llviewerobjectlist.h"
 #include "llviewerparcelmgr.h"
 #include "llviewerstats.h"
+#include "llviewerwindow.h"
 #include "llvoavatarself.h"
 #include "llvovolume.h"
 #include "llworld.h"
@@ -621,6 +623,8 @@ BOOL LLVOAvatar::sShowFootPlane = FALSE;
 BOOL LLVOAvatar::sVisibleInFirstPerson = FALSE;
 F32 LLVOAvatar::sLODFactor = 1.f;
 BOOL LLVOAvatar::sUseImpostors = FALSE;
+LLImpostorAtlas LLVOAvatar::sImpostorAtlas(0, 0);
+LLRenderTarget LLVOAvatar::sImpostorTarget;
 BOOL LLVOAvatar::sJointDebug = FALSE;
 
 F32 LLVOAvatar::sUnbakedTime = 0.f;
@@ -724,6 +728,7 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mNeedsImpostorUpdate = TRUE;
 	mNeedsAnimUpdate = TRUE;
 
+	mImpostorHandle = 0;
 	mImpostorDistance = 0;
 	mImpostorPixelArea = 0;
 
@@ -786,6 +791,7 @@ LLVOAvatar::~LLVOAvatar()
 	}
 	lldebugs << "LLVOAvatar Destructor (0x" << this << ") id:" << mID << llendl;
 
+	releaseImpostor(this);
 	mRoot.removeAllChildren();
 
 	deleteAndClearArray(mSkeleton);
@@ -845,6 +851,7 @@ void LLVOAvatar::markDead()
 	}
 	mVoiceVisualizer->markDead();
 	LLLoadedCallbackEntry::cleanUpCallbackList(&mCallbackTextureList) ;
+	releaseImpostor(this);
 	LLViewerObject::markDead();
 }
 
@@ -1018,8 +1025,11 @@ void LLVOAvatar::resetImpostors()
 		 iter != LLCharacter::sInstances.end(); ++iter)
 	{
 		LLVOAvatar* avatar = (LLVOAvatar*) *iter;
-		avatar->mImpostor.release();
+		avatar->mImpostorHandle = 0;
+		avatar->mNeedsImpostorUpdate = TRUE;
 	}
+	sImpostorAtlas.clear();
+	sImpostorTarget.release();
 }
 
 // static
@@ -2271,6 +2281,8 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	}
 
 	checkTextureLoading() ;
+
+	updateMeshMorphs();
 	
 	// force immediate pixel area update on avatars using last frames data (before drawable or camera updates)
 	setPixelAreaAndAngle(gAgent);
@@ -3963,6 +3975,8 @@ U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
 				mMeshLOD[MESH_ID_HEAD]->updateJointGeometry();
 				mMeshLOD[MESH_ID_HAIR]->updateJointGeometry();
 			}
+			// skins the meshes queued for the batched skinning kernel
+			LLViewerJointMesh::flushSkinning();
 			mNeedsSkin = FALSE;
 			
 			LLVertexBuffer* vb = mDrawable->getFace(0)->mVertexBuffer;
@@ -4191,7 +4205,7 @@ U32 LLVOAvatar::renderRigid()
 
 U32 LLVOAvatar::renderImpostor(LLColor4U color, S32 diffuse_channel)
 {
-	if (!mImpostor.isComplete())
+	if (!sImpostorTarget.isComplete() || !hasImpostorSprite())
 	{
 		return 0;
 	}
@@ -4208,16 +4222,22 @@ U32 LLVOAvatar::renderImpostor(LLColor4U color, S32 diffuse_channel)
 	LLGLEnable test(GL_ALPHA_TEST);
 	gGL.setAlphaRejectSettings(LLRender::CF_GREATER, 0.f);
 
+	const LLRect& rect = getImpostorRect();
+	F32 s0 = (F32)rect.mLeft / sImpostorTarget.getWidth();
+	F32 s1 = (F32)rect.mRight / sImpostorTarget.getWidth();
+	F32 t0 = (F32)rect.mBottom / sImpostorTarget.getHeight();
+	F32 t1 = (F32)rect.mTop / sImpostorTarget.getHeight();
+
 	gGL.color4ubv(color.mV);
-	gGL.getTexUnit(diffuse_channel)->bind(&mImpostor);
+	gGL.getTexUnit(diffuse_channel)->bind(&sImpostorTarget);
 	gGL.begin(LLRender::QUADS);
-	gGL.texCoord2f(0,0);
+	gGL.texCoord2f(s0,t0);
 	gGL.vertex3fv((pos+left-up).mV);
-	gGL.texCoord2f(1,0);
+	gGL.texCoord2f(s1,t0);
 	gGL.vertex3fv((pos-left-up).mV);
-	gGL.texCoord2f(1,1);
+	gGL.texCoord2f(s1,t1);
 	gGL.vertex3fv((pos-left+up).mV);
-	gGL.texCoord2f(0,1);
+	gGL.texCoord2f(s0,t1);
 	gGL.vertex3fv((pos+left+up).mV);
 	gGL.end();
 	gGL.flush();
@@ -5485,6 +5505,7 @@ void LLVOAvatar::updateVisualParams()
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
 	LLCharacter::updateVisualParams();
+	updateMeshMorphs();
 
 	if (mLastSkeletonSerialNum != mSkeletonSerialNum)
 	{
@@ -5666,6 +5687,32 @@ void LLVOAvatar::dirtyMesh(S32 priority)
 {
 	mDirtyMesh = llmax(mDirtyMesh, priority);
 }
+
+//-----------------------------------------------------------------------------
+// updateMeshMorphs()
+// Morph targets applied by the visual params are added to the vertices by
+// jobs on the viewer's thread pool. Dummy avatars, such as the one of the
+// image preview, are rendered right after their params change and morph
+// right away.
+//-----------------------------------------------------------------------------
+void LLVOAvatar::updateMeshMorphs()
+{
+	static LLCachedControl<bool> morph_threaded(gSavedSettings, "AvatarMorphThreaded");
+	LLThreadPool* pool = (morph_threaded && !mIsDummy) ? LLAppViewer::getThreadPool() : NULL;
+
+	BOOL changed = FALSE;
+	for (polymesh_map_t::iterator iter = mMeshes.begin(); iter != mMeshes.end(); ++iter)
+	{
+		if (iter->second->updateMorphs(pool))
+		{
+			changed = TRUE;
+		}
+	}
+	if (changed)
+	{
+		dirtyMesh();
+	}
+}
 //-----------------------------------------------------------------------------
 // hideSkirt()
 //-----------------------------------------------------------------------------
@@ -7242,6 +7289,9 @@ void LLVOAvatar::useBakedTexture( const LLUUID& id )
 					mBakedTextureDatas[BAKED_HAIR].mMeshes[i]->setColor( 1.f, 1.f, 1.f, 1.f );
 				}
 			}
+
+			// The impostor sprite shows the old appearance
+			mNeedsImpostorUpdate = TRUE;
 		}
 	}
 
@@ -7995,14 +8045,60 @@ U32 LLVOAvatar::getPartitionType() const
 //static
 void LLVOAvatar::updateImpostors() 
 {
+	static LLCachedControl<U32> atlas_size(gSavedSettings, "RenderImpostorAtlasSize");
+	static LLCachedControl<U32> max_updates(gSavedSettings, "RenderImpostorMaxUpdates");
+
+	S32 size = (S32)llclamp(nhpo2(atlas_size), (U32)512, (U32)4096);
+	if (size != sImpostorAtlas.getWidth())
+	{
+		resetImpostors();
+		sImpostorAtlas.resize(size, size);
+	}
+
+	LLTimer update_timer;
 	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
 		 iter != LLCharacter::sInstances.end(); ++iter)
 	{
 		LLVOAvatar* avatar = (LLVOAvatar*) *iter;
-		if (!avatar->isDead() && avatar->needsImpostorUpdate() && avatar->isVisible() && avatar->isImpostor())
+		if (avatar->isDead() || !avatar->isImpostor())
 		{
-			gPipeline.generateImpostor(avatar);
+			// Close enough to be drawn in full, the sprite's room goes to others
+			releaseImpostor(avatar);
 		}
+		else if (avatar->needsImpostorUpdate() && avatar->isVisible() && avatar->mDrawable.notNull())
+		{
+			if (!avatar->mImpostorHandle)
+			{
+				avatar->mImpostorHandle = sImpostorAtlas.addImpostor(avatar);
+			}
+			LLCamera camera;
+			LLVector2 tdim;
+			U32 res_x, res_y;
+			avatar->getImpostorProjection(camera, tdim, res_x, res_y);
+			sImpostorAtlas.requestUpdate(avatar->mImpostorHandle, res_x, res_y, avatar->mImpostorPixelArea);
+		}
+	}
+
+	// Refresh a bounded number of sprites, the largest on screen first
+	const std::vector<LLImpostorAtlas::handle_t>& updates = sImpostorAtlas.schedule((S32)max_updates);
+	for (U32 i = 0; i < updates.size(); i++)
+	{
+		gPipeline.generateImpostor((LLVOAvatar*) sImpostorAtlas.getUserData(updates[i]));
+	}
+
+	LLViewerStats::getInstance()->mImpostorUpdatesStat.addValue((F32)updates.size());
+	LLViewerStats::getInstance()->mImpostorUpdateTimeStat.addValue(update_timer.getElapsedTimeF32() * 1000.f);
+	LLViewerStats::getInstance()->mImpostorAtlasFillStat.addValue(sImpostorAtlas.getFill() * 100.f);
+}
+
+//static
+void LLVOAvatar::releaseImpostor(LLVOAvatar* avatar)
+{
+	if (avatar->mImpostorHandle)
+	{
+		sImpostorAtlas.removeImpostor(avatar->mImpostorHandle);
+		avatar->mImpostorHandle = 0;
+		avatar->mNeedsImpostorUpdate = TRUE;
 	}
 }
 
@@ -8032,6 +8128,47 @@ void LLVOAvatar::setImpostorDim(const LLVector2& dim)
 	mImpostorDim = dim;
 }
 
+BOOL LLVOAvatar::hasImpostorSprite() const
+{
+	return sImpostorAtlas.hasSprite(mImpostorHandle);
+}
+
+const LLRect& LLVOAvatar::getImpostorRect() const
+{
+	return sImpostorAtlas.getRect(mImpostorHandle);
+}
+
+void LLVOAvatar::getImpostorProjection(LLCamera& camera, LLVector2& tdim, U32& res_x, U32& res_y) const
+{
+	LLViewerCamera* viewer_camera = LLViewerCamera::getInstance();
+	const LLVector3* ext = mDrawable->getSpatialExtents();
+	LLVector3 pos(getRenderPosition()+mImpostorOffset);
+
+	camera = *viewer_camera;
+	camera.lookAt(viewer_camera->getOrigin(), pos, viewer_camera->getUpAxis());
+
+	LLVector3 half_height = (ext[1]-ext[0])*0.5f;
+
+	LLVector3 left = camera.getLeftAxis();
+	left *= left;
+	left.normalize();
+
+	LLVector3 up = camera.getUpAxis();
+	up *= up;
+	up.normalize();
+
+	tdim.mV[0] = fabsf(half_height * left);
+	tdim.mV[1] = fabsf(half_height * up);
+
+	// get the number of pixels per angle
+	F32 distance = (pos-camera.getOrigin()).length();
+	F32 pa = gViewerWindow->getWindowHeightRaw() / (RAD_TO_DEG * viewer_camera->getView());
+
+	//get resolution based on angle width and height of impostor (double desired resolution to prevent aliasing)
+	res_y = llmin(nhpo2((U32) (atanf(tdim.mV[1]/distance)*2.f*RAD_TO_DEG*pa)), (U32) 512);
+	res_x = llmin(nhpo2((U32) (atanf(tdim.mV[0]/distance)*2.f*RAD_TO_DEG*pa)), (U32) 512);
+}
+
 void LLVOAvatar::cacheImpostorValues()
 {
 	getImpostorValues(mImpostorExtents, mImpostorAngle, mImpostorDistance);
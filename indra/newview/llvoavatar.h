@@ -42,6 +42,7 @@
 #include "llcharacter.h"
 #include "llviewerjointmesh.h"
 #include "llviewerjointattachment.h"
+#include "llimpostoratlas.h"
 #include "llrendertarget.h"
 #include "llvoavatardefines.h"
 #include "lltexglobalcolor.h"
@@ -59,6 +60,7 @@ extern const LLUUID ANIM_AGENT_PELVIS_FIX;
 extern const LLUUID ANIM_AGENT_TARGET;
 extern const LLUUID ANIM_AGENT_WALK_ADJUST;
 
+class LLCamera;
 class LLTexLayerSet;
 class LLVoiceVisualizer;
 class LLHUDNameTag;
@@ -405,11 +407,19 @@ public:
 	void 		getImpostorValues(LLVector3* extents, LLVector3& angle, F32& distance) const;
 	void 		cacheImpostorValues();
 	void 		setImpostorDim(const LLVector2& dim);
+	// Camera looking at the impostor, its half size and the resolution of its sprite
+	void		getImpostorProjection(LLCamera& camera, LLVector2& tdim, U32& res_x, U32& res_y) const;
+	BOOL		hasImpostorSprite() const;
+	// Where the sprite is in sImpostorTarget
+	const LLRect& getImpostorRect() const;
 	static void	resetImpostors();
 	static void updateImpostors();
-	LLRenderTarget mImpostor;
+	static void	releaseImpostor(LLVOAvatar* avatar);
 	BOOL		mNeedsImpostorUpdate;
+	static LLImpostorAtlas sImpostorAtlas;	// sprite rectangles and refresh order
+	static LLRenderTarget sImpostorTarget;	// all the sprites
 private:
+	LLImpostorAtlas::handle_t mImpostorHandle;
 	LLVector3	mImpostorOffset;
 	LLVector2	mImpostorDim;
 	BOOL		mNeedsAnimUpdate;
@@ -586,6 +596,7 @@ protected:
 	virtual void restoreMeshData();
 private:
 	void 			dirtyMesh(S32 priority); // Dirty the avatar mesh, with priority
+	void			updateMeshMorphs(); // Swap in morphed vertices, start morph jobs
 	S32 			mDirtyMesh; // 0 -- not dirty, 1 -- morphed, 2 -- LOD
 	BOOL			mMeshTexturesDirty;
 
@@ -26,10 +26,14 @@
 
 #include "llviewerprecompiledheaders.h"
 #include "llvocache.h"
+#include "llcrc.h"
 #include "llerror.h"
 #include "llregionhandle.h"
 #include "llviewercontrol.h"
 
+#include "apr_file_io.h"
+#include "apr_mmap.h"
+
 BOOL check_read(LLAPRFile* apr_file, void* src, S32 n_bytes) 
 {
 	return apr_file->read(src, n_bytes) == n_bytes ;
@@ -218,11 +222,555 @@ BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
 	return success ;
 }
 
+//-------------------------------------------------------------------
+// LLVOCacheFile
+//-------------------------------------------------------------------
+const U32 REGION_CACHE_MAGIC = 0x46434f56; // "VOCF"
+const U32 REGION_CACHE_VERSION = 1;
+const U32 REGION_CACHE_MIN_SLOTS = 1024; // power of 2
+const U32 REGION_CACHE_MIN_RECORDS = 64 * 1024; // room for records in a new file
+const U32 REGION_CACHE_MIN_COMPACT = 64 * 1024; // dead bytes worth compacting
+const U32 REGION_CACHE_MAX_RECORD = 10000; // same limit as the previous format
+
+// Fibonacci hashing, consecutive local ids spread over the table
+static inline U32 hash_local_id(U32 local_id, U32 shift)
+{
+	return (local_id * 2654435769U) >> shift;
+}
+
+static U32 get_record_checksum(const U8* data, U32 size)
+{
+	LLCRC crc;
+	crc.update(data, size);
+	return crc.getCRC();
+}
+
+static U32 get_slot_shift(U32 num_slots)
+{
+	U32 shift = 32;
+	while (num_slots > 1)
+	{
+		num_slots >>= 1;
+		shift--;
+	}
+	return shift;
+}
+
+LLVOCacheFile::LLVOCacheFile()
+	: mPool(NULL),
+	  mFile(NULL),
+	  mMap(NULL),
+	  mMapSize(0),
+	  mReadOnly(true),
+	  mHeader(NULL),
+	  mSlots(NULL),
+	  mShift(0)
+{
+}
+
+LLVOCacheFile::~LLVOCacheFile()
+{
+	close();
+}
+
+bool LLVOCacheFile::open(const std::string& filename, const LLUUID& id, bool read_only)
+{
+	close();
+
+	mFilename = filename;
+	mReadOnly = read_only;
+	mPool = new LLAPRPool();
+
+	if (!openFile())
+	{
+		close();
+		return false;
+	}
+
+	apr_finfo_t finfo;
+	apr_off_t file_size = 0;
+	if (apr_file_info_get(&finfo, APR_FINFO_SIZE, mFile) == APR_SUCCESS)
+	{
+		file_size = finfo.size;
+	}
+
+	// Validate the existing header, if any
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	bool valid = false;
+	if (file_size >= (apr_off_t)sizeof(Header))
+	{
+		apr_size_t bytes_read = sizeof(Header);
+		apr_off_t offset = 0;
+		apr_file_seek(mFile, APR_SET, &offset);
+		if (apr_file_read(mFile, &header, &bytes_read) == APR_SUCCESS && bytes_read == sizeof(Header))
+		{
+			apr_off_t records_start = sizeof(Header) + (apr_off_t)header.mNumSlots * sizeof(Slot);
+			valid = header.mMagic == REGION_CACHE_MAGIC
+				&& header.mVersion == REGION_CACHE_VERSION
+				&& header.mNumSlots >= REGION_CACHE_MIN_SLOTS
+				&& (header.mNumSlots & (header.mNumSlots - 1)) == 0
+				&& (apr_off_t)header.mDataEnd >= records_start
+				&& (apr_off_t)header.mDataEnd <= file_size;
+			if (valid && header.mRegionID != id)
+			{
+				llinfos << "Cache ID doesn't match for this region, discarding" << llendl;
+				valid = false;
+			}
+		}
+	}
+
+	if (!valid)
+	{
+		if (read_only || !rebuild(id, REGION_CACHE_MIN_SLOTS))
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	if (!map((apr_size_t)file_size))
+	{
+		close();
+		return false;
+	}
+
+	// Count the slots in use rather than trust the header, a lookup in a
+	// table without free slots would never end
+	U32 num_used = 0;
+	for (U32 i = 0; i < mHeader->mNumSlots; i++)
+	{
+		if (mSlots[i].mLocalID)
+		{
+			num_used++;
+		}
+	}
+	if (!mHeader->mClean || num_used != mHeader->mNumEntries || num_used * 4 > mHeader->mNumSlots * 3)
+	{
+		if (read_only)
+		{
+			llwarns << "Object cache " << filename << " was not closed, ignoring it" << llendl;
+			close();
+			return false;
+		}
+		llwarns << "Object cache " << filename << " was not closed, repairing it" << llendl;
+		return rebuild(id, mHeader->mNumSlots);
+	}
+
+	if (!read_only)
+	{
+		mHeader->mClean = 0;
+	}
+	return true;
+}
+
+void LLVOCacheFile::close()
+{
+	if (mHeader && !mReadOnly)
+	{
+		// Drop the room reserved for new records
+		U32 data_end = mHeader->mDataEnd;
+		mHeader->mClean = 1;
+		unmap();
+		apr_file_trunc(mFile, data_end);
+	}
+	unmap();
+	if (mFile)
+	{
+		apr_file_close(mFile);
+		mFile = NULL;
+	}
+	delete mPool;
+	mPool = NULL;
+}
+
+bool LLVOCacheFile::openFile()
+{
+	apr_int32_t flags = mReadOnly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_CREATE|APR_BINARY;
+	apr_status_t s = apr_file_open(&mFile, mFilename.c_str(), flags, APR_OS_DEFAULT, mPool->getAPRPool());
+	if (s != APR_SUCCESS)
+	{
+		if (!mReadOnly)
+		{
+			ll_apr_warn_status(s);
+		}
+		mFile = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool LLVOCacheFile::map(apr_size_t size)
+{
+	apr_int32_t mmap_flags = mReadOnly ? APR_MMAP_READ : APR_MMAP_READ|APR_MMAP_WRITE;
+	apr_status_t s = apr_mmap_create(&mMap, mFile, 0, size, mmap_flags, mPool->getAPRPool());
+	if (s != APR_SUCCESS)
+	{
+		ll_apr_warn_status(s);
+		mMap = NULL;
+		return false;
+	}
+	mMapSize = size;
+	mHeader = (Header*)mMap->mm;
+	mSlots = (Slot*)((U8*)mMap->mm + sizeof(Header));
+	mShift = get_slot_shift(mHeader->mNumSlots);
+	return true;
+}
+
+void LLVOCacheFile::unmap()
+{
+	if (mMap)
+	{
+		apr_mmap_delete(mMap);
+		mMap = NULL;
+	}
+	mMapSize = 0;
+	mHeader = NULL;
+	mSlots = NULL;
+}
+
+bool LLVOCacheFile::reserve(U32 size)
+{
+	apr_size_t needed = (apr_size_t)mHeader->mDataEnd + size;
+	if (needed <= mMapSize)
+	{
+		return true;
+	}
+
+	// Grow geometrically so appending stays cheap
+	apr_size_t new_size = llmax(mMapSize * 2, needed);
+	unmap();
+	if (apr_file_trunc(mFile, (apr_off_t)new_size) != APR_SUCCESS || !map(new_size))
+	{
+		llwarns << "Unable to grow object cache " << mFilename << llendl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool LLVOCacheFile::rebuild(const LLUUID& id, U32 num_slots)
+{
+	// Copy the intact records out first, then write them to a temporary
+	// file that replaces this one
+	std::vector<Slot> live;
+	std::vector<U8> records;
+	if (mHeader)
+	{
+		const U8* base = (const U8*)mHeader;
+		for (U32 i = 0; i < mHeader->mNumSlots; i++)
+		{
+			const Slot& old_slot = mSlots[i];
+			if (old_slot.mLocalID && isIntact(old_slot))
+			{
+				live.push_back(old_slot);
+				live.back().mOffset = records.size();
+				records.insert(records.end(), base + old_slot.mOffset, base + old_slot.mOffset + old_slot.mSize);
+			}
+		}
+	}
+	while (live.size() * 4 > num_slots * 3)
+	{
+		num_slots *= 2;
+	}
+
+	const U32 records_start = sizeof(Header) + num_slots * sizeof(Slot);
+	const U32 shift = get_slot_shift(num_slots);
+	std::vector<Slot> slots(num_slots);
+
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	header.mMagic = REGION_CACHE_MAGIC;
+	header.mVersion = REGION_CACHE_VERSION;
+	header.mRegionID = id;
+	header.mNumSlots = num_slots;
+	header.mClean = 1;
+
+	for (U32 i = 0; i < live.size(); i++)
+	{
+		U32 index = hash_local_id(live[i].mLocalID, shift);
+		while (slots[index].mLocalID && slots[index].mLocalID != live[i].mLocalID)
+		{
+			index = (index + 1) & (num_slots - 1);
+		}
+		if (slots[index].mLocalID)
+		{
+			// Only in a damaged file, keep the first one
+			continue;
+		}
+		slots[index] = live[i];
+		slots[index].mOffset += records_start;
+		header.mNumEntries++;
+	}
+	header.mDataEnd = records_start + records.size();
+
+	// Close this file first, an open file can't be replaced everywhere
+	unmap();
+	if (mFile)
+	{
+		apr_file_close(mFile);
+		mFile = NULL;
+	}
+
+	const std::string temp_filename = mFilename + ".tmp";
+	apr_size_t file_size = header.mDataEnd + llmax((U32)records.size(), REGION_CACHE_MIN_RECORDS);
+	apr_file_t* temp_file = NULL;
+	apr_size_t bytes_written;
+	bool success = apr_file_open(&temp_file, temp_filename.c_str(), APR_WRITE|APR_CREATE|APR_TRUNCATE|APR_BINARY,
+								 APR_OS_DEFAULT, mPool->getAPRPool()) == APR_SUCCESS;
+	if (success)
+	{
+		bytes_written = sizeof(Header);
+		success = apr_file_write(temp_file, &header, &bytes_written) == APR_SUCCESS && bytes_written == sizeof(Header);
+	}
+	if (success)
+	{
+		bytes_written = num_slots * sizeof(Slot);
+		success = apr_file_write(temp_file, &slots[0], &bytes_written) == APR_SUCCESS && bytes_written == num_slots * sizeof(Slot);
+	}
+	if (success && !records.empty())
+	{
+		bytes_written = records.size();
+		success = apr_file_write(temp_file, &records[0], &bytes_written) == APR_SUCCESS && bytes_written == records.size();
+	}
+	if (success)
+	{
+		// Room for new records
+		success = apr_file_trunc(temp_file, (apr_off_t)file_size) == APR_SUCCESS;
+	}
+	if (temp_file)
+	{
+		success = apr_file_close(temp_file) == APR_SUCCESS && success;
+	}
+	if (success)
+	{
+		success = apr_file_rename(temp_filename.c_str(), mFilename.c_str(), mPool->getAPRPool()) == APR_SUCCESS;
+	}
+	if (!success)
+	{
+		llwarns << "Unable to write object cache " << mFilename << llendl;
+		apr_file_remove(temp_filename.c_str(), mPool->getAPRPool());
+		close();
+		return false;
+	}
+
+	if (!openFile() || !map(file_size))
+	{
+		llwarns << "Unable to open object cache " << mFilename << llendl;
+		close();
+		return false;
+	}
+	if (!mReadOnly)
+	{
+		mHeader->mClean = 0;
+	}
+	return true;
+}
+
+LLVOCacheFile::Slot* LLVOCacheFile::findSlot(U32 local_id) const
+{
+	const U32 mask = mHeader->mNumSlots - 1;
+	U32 index = hash_local_id(local_id, mShift);
+	for (U32 i = 0; i < mHeader->mNumSlots; i++)
+	{
+		if (!mSlots[index].mLocalID || mSlots[index].mLocalID == local_id)
+		{
+			return &mSlots[index];
+		}
+		index = (index + 1) & mask;
+	}
+	return NULL;
+}
+
+bool LLVOCacheFile::isIntact(const Slot& slot) const
+{
+	const U32 records_start = sizeof(Header) + mHeader->mNumSlots * sizeof(Slot);
+	if (slot.mSize < 1 || slot.mSize > REGION_CACHE_MAX_RECORD
+		|| slot.mOffset < records_start
+		|| slot.mOffset > mHeader->mDataEnd
+		|| slot.mSize > mHeader->mDataEnd - slot.mOffset)
+	{
+		return false;
+	}
+	return get_record_checksum((const U8*)mHeader + slot.mOffset, slot.mSize) == slot.mChecksum;
+}
+
+U32 LLVOCacheFile::getNumEntries() const
+{
+	return mHeader ? mHeader->mNumEntries : 0;
+}
+
+BOOL LLVOCacheFile::getCRC(U32 local_id, U32& crc) const
+{
+	if (!mHeader || !local_id)
+	{
+		return FALSE;
+	}
+	const Slot* slot = findSlot(local_id);
+	if (!slot || !slot->mLocalID)
+	{
+		return FALSE;
+	}
+	crc = slot->mCRC;
+	return TRUE;
+}
+
+LLVOCacheEntry* LLVOCacheFile::readEntry(U32 local_id) const
+{
+	if (!mHeader || !local_id)
+	{
+		return NULL;
+	}
+	const Slot* slot = findSlot(local_id);
+	if (!slot || !slot->mLocalID)
+	{
+		return NULL;
+	}
+	if (!isIntact(*slot))
+	{
+		llwarns << "Bogus cache entry for " << local_id << " in " << mFilename << llendl;
+		return NULL;
+	}
+
+	LLVOCacheEntry* entry = new LLVOCacheEntry();
+	entry->mLocalID = slot->mLocalID;
+	entry->mCRC = slot->mCRC;
+	entry->mHitCount = slot->mHitCount;
+	entry->mDupeCount = slot->mDupeCount;
+	entry->mCRCChangeCount = slot->mCRCChangeCount;
+	entry->mBuffer = new U8[slot->mSize];
+	memcpy(entry->mBuffer, (const U8*)mHeader + slot->mOffset, slot->mSize);
+	entry->mDP.assignBuffer(entry->mBuffer, slot->mSize);
+	return entry;
+}
+
+BOOL LLVOCacheFile::writeEntry(const LLVOCacheEntry& entry)
+{
+	const U32 size = entry.mDP.getBufferSize();
+	if (!mHeader || mReadOnly || !entry.mLocalID || size < 1 || size > REGION_CACHE_MAX_RECORD)
+	{
+		return FALSE;
+	}
+
+	// Keep a quarter of the slots free so probe sequences stay short
+	Slot* slot = findSlot(entry.mLocalID);
+	if (!slot || (!slot->mLocalID && (mHeader->mNumEntries + 1) * 4 > mHeader->mNumSlots * 3))
+	{
+		LLUUID id = mHeader->mRegionID;
+		if (!rebuild(id, mHeader->mNumSlots * 2))
+		{
+			return FALSE;
+		}
+	}
+	if (!reserve(size))
+	{
+		return FALSE;
+	}
+
+	// The record goes in first, the slot points at it once it is complete
+	const U32 offset = mHeader->mDataEnd;
+	memcpy((U8*)mHeader + offset, entry.mBuffer, size);
+	mHeader->mDataEnd += size;
+
+	slot = findSlot(entry.mLocalID);
+	if (!slot)
+	{
+		return FALSE;
+	}
+	if (slot->mLocalID)
+	{
+		mHeader->mDeadSize += slot->mSize;
+	}
+	else
+	{
+		mHeader->mNumEntries++;
+	}
+	slot->mCRC = entry.mCRC;
+	slot->mOffset = offset;
+	slot->mSize = size;
+	slot->mChecksum = get_record_checksum(entry.mBuffer, size);
+	slot->mHitCount = entry.mHitCount;
+	slot->mDupeCount = entry.mDupeCount;
+	slot->mCRCChangeCount = entry.mCRCChangeCount;
+	slot->mLocalID = entry.mLocalID;
+	return TRUE;
+}
+
+void LLVOCacheFile::updateCounts(const LLVOCacheEntry& entry)
+{
+	if (!mHeader || mReadOnly || !entry.mLocalID)
+	{
+		return;
+	}
+	Slot* slot = findSlot(entry.mLocalID);
+	if (slot && slot->mLocalID && slot->mCRC == entry.mCRC)
+	{
+		slot->mHitCount = entry.mHitCount;
+		slot->mDupeCount = entry.mDupeCount;
+		slot->mCRCChangeCount = entry.mCRCChangeCount;
+	}
+}
+
+BOOL LLVOCacheFile::compact(BOOL force)
+{
+	if (!mHeader || mReadOnly)
+	{
+		return FALSE;
+	}
+	const U32 records_size = mHeader->mDataEnd - sizeof(Header) - mHeader->mNumSlots * sizeof(Slot);
+	if (!force && (mHeader->mDeadSize < REGION_CACHE_MIN_COMPACT || mHeader->mDeadSize * 2 < records_size))
+	{
+		return FALSE;
+	}
+	LLUUID id = mHeader->mRegionID;
+	return rebuild(id, mHeader->mNumSlots);
+}
+
+S32 LLVOCacheFile::importLegacyFile(const std::string& filename, const LLUUID& id, LLVolatileAPRPool* pool)
+{
+	if (!mHeader || mReadOnly)
+	{
+		return -1;
+	}
+
+	LLAPRFile apr_file(filename, APR_READ|APR_BINARY, pool);
+	if (!apr_file.getFileHandle())
+	{
+		return -1;
+	}
+	LLUUID cache_id;
+	S32 num_entries = 0;
+	if (!check_read(&apr_file, cache_id.mData, UUID_BYTES) || cache_id != id
+		|| !check_read(&apr_file, &num_entries, sizeof(S32)))
+	{
+		return -1;
+	}
+
+	S32 imported = 0;
+	for (S32 i = 0; i < num_entries; i++)
+	{
+		LLVOCacheEntry entry(&apr_file);
+		if (!entry.getLocalID())
+		{
+			llwarns << "Aborting cache file conversion for " << filename << ", cache file corruption!" << llendl;
+			break;
+		}
+		if (writeEntry(entry))
+		{
+			imported++;
+		}
+	}
+	return imported;
+}
+
 //-------------------------------------------------------------------
 //LLVOCache
 //-------------------------------------------------------------------
 // Format string used to construct filename for the object cache
-static const char OBJECT_CACHE_FILENAME[] = "objects_%d_%d.slc";
+static const char OBJECT_CACHE_FILENAME[] = "objects_%d_%d.slm";
+// Same for the cache files read and written whole, converted when found
+static const char LEGACY_OBJECT_CACHE_FILENAME[] = "objects_%d_%d.slc";
 
 const U32 NUM_ENTRIES_TO_PURGE = 16 ;
 const char* object_cache_dirname = "objectcache";
@@ -375,6 +923,15 @@ void LLVOCache::getObjectCacheFilename(U64 handle, std::string& filename)
 	return ;
 }
 
+void LLVOCache::getLegacyObjectCacheFilename(U64 handle, std::string& filename) 
+{
+	U32 region_x, region_y;
+
+	grid_from_region_handle(handle, &region_x, &region_y);
+	filename = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, object_cache_dirname,
+			   llformat(LEGACY_OBJECT_CACHE_FILENAME, region_x, region_y));
+}
+
 void LLVOCache::removeFromCache(U64 handle)
 {
 	if(mReadOnly)
@@ -385,6 +942,12 @@ void LLVOCache::removeFromCache(U64 handle)
 	std::string filename;
 	getObjectCacheFilename(handle, filename);
 	LLAPRFile::remove(filename, mLocalAPRFilePoolp);	
+
+	getLegacyObjectCacheFilename(handle, filename);
+	if (LLAPRFile::isExist(filename, mLocalAPRFilePoolp))
+	{
+		LLAPRFile::remove(filename, mLocalAPRFilePoolp);
+	}
 }
 
 BOOL LLVOCache::checkRead(LLAPRFile* apr_file, void* src, S32 n_bytes) 
@@ -511,71 +1074,101 @@ BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
 	return checkWrite(apr_file, (void*)entry, sizeof(HeaderEntryInfo)) ;
 }
 
-void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
+LLVOCacheFile* LLVOCache::openRegionCache(U64 handle, const LLUUID& id) 
 {
 	if(!mEnabled)
 	{
-		return ;
+		return NULL;
 	}
 	llassert_always(mInitialized);
 
-	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
-	if(iter == mHandleEntryMap.end()) //no cache
-	{
-		return ;
-	}
-
 	std::string filename;
 	getObjectCacheFilename(handle, filename);
-	LLAPRFile* apr_file = new LLAPRFile(filename, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
+	if(mReadOnly && (mHandleEntryMap.find(handle) == mHandleEntryMap.end()
+					 || !LLAPRFile::isExist(filename, mLocalAPRFilePoolp)))
+	{
+		return NULL;
+	}
 
-	LLUUID cache_id ;
-	if(!checkRead(apr_file, cache_id.mData, UUID_BYTES))
+	LLVOCacheFile* cache_file = new LLVOCacheFile();
+	if(!cache_file->open(filename, id, mReadOnly))
 	{
-		return ;
+		delete cache_file;
+		return NULL;
 	}
-	if(cache_id != id)
+
+	if(!mReadOnly)
 	{
-		llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+		// Pin the region before touchEntry() gets to purge regions
+		mOpenRegions.insert(handle);
+		touchEntry(handle);
+		convertLegacyCache(handle, id, cache_file);
+		if(!cache_file->isOpen())
+		{
+			mOpenRegions.erase(handle);
+			delete cache_file;
+			return NULL;
+		}
+	}
+	return cache_file;
+}
 
-		delete apr_file ;
-		return ;
+void LLVOCache::closeRegionCache(U64 handle, LLVOCacheFile* cache_file) 
+{
+	if(!cache_file)
+	{
+		return;
 	}
+	mOpenRegions.erase(handle);
+	if(cache_file->compact())
+	{
+		llinfos << "Compacted object cache of region " << handle << llendl;
+	}
+	delete cache_file;
+}
 
-	S32 num_entries;
-	if(!checkRead(apr_file, &num_entries, sizeof(S32)))
+// Reads the whole cache file the viewer used to write on leaving the region
+// and adds its entries to cache_file
+void LLVOCache::convertLegacyCache(U64 handle, const LLUUID& id, LLVOCacheFile* cache_file)
+{
+	std::string filename;
+	getLegacyObjectCacheFilename(handle, filename);
+	if(!LLAPRFile::isExist(filename, mLocalAPRFilePoolp))
 	{
-		return ;
+		return;
 	}
-	
-	for (S32 i = 0; i < num_entries; i++)
+
+	S32 converted = cache_file->importLegacyFile(filename, id, mLocalAPRFilePoolp);
+	if(converted > 0)
 	{
-		LLVOCacheEntry* entry = new LLVOCacheEntry(apr_file);
-		if (!entry->getLocalID())
+		// Keep the old file until the converted entries are written out
+		if(!cache_file->compact(TRUE))
 		{
-			llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-			delete entry ;
-			break;
+			llwarns << "Unable to convert " << filename << llendl;
+			return;
 		}
-		cache_entry_map[entry->getLocalID()] = entry;
+		llinfos << "Converted " << converted << " object cache entries from " << filename << llendl;
 	}
-	num_entries = cache_entry_map.size() ;
-
-	delete apr_file ;
-	return ;
+	LLAPRFile::remove(filename, mLocalAPRFilePoolp);
 }
 	
 void LLVOCache::purgeEntries()
 {
 	U32 limit = mCacheSize - NUM_ENTRIES_TO_PURGE ;
-	while(mHeaderEntryQueue.size() > limit)
+	header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin() ;
+	while(mHeaderEntryQueue.size() > limit && iter != mHeaderEntryQueue.end())
 	{
-		header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin() ;
 		HeaderEntryInfo* entry = *iter ;
+		if(mOpenRegions.find(entry->mHandle) != mOpenRegions.end())
+		{
+			// still mapped by its region
+			++iter ;
+			continue ;
+		}
 		
 		removeFromCache(entry->mHandle) ;
 		mHandleEntryMap.erase(entry->mHandle) ;		
-		mHeaderEntryQueue.erase(iter) ;
+		mHeaderEntryQueue.erase(iter++) ;
 		delete entry ;
 	}
 
@@ -584,19 +1177,9 @@ void LLVOCache::purgeEntries()
 	mNumEntries = mHandleEntryMap.size() ;
 }
 
-void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) 
+// Moves the region to the back of the queue of regions to purge
+void LLVOCache::touchEntry(U64 handle) 
 {
-	if(!mEnabled)
-	{
-		return ;
-	}
-	llassert_always(mInitialized);
-
-	if(mReadOnly)
-	{
-		return ;
-	}
-
 	HeaderEntryInfo* entry;
 	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
 	if(iter == mHandleEntryMap.end()) //new entry
@@ -624,44 +1207,5 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 	}
 
 	//update cache header
-	if(!updateEntry(entry))
-	{
-		return ; //update failed.
-	}
-
-	if(!dirty_cache)
-	{
-		return ; //nothing changed, no need to update.
-	}
-
-	//write to cache file
-	std::string filename;
-	getObjectCacheFilename(handle, filename);
-	LLAPRFile* apr_file = new LLAPRFile(filename, APR_CREATE|APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
-	
-	if(!checkWrite(apr_file, (void*)id.mData, UUID_BYTES))
-	{
-		return ;
-	}
-
-	S32 num_entries = cache_entry_map.size() ;
-	if(!checkWrite(apr_file, &num_entries, sizeof(S32)))
-	{
-		return ;
-	}
-
-	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
-	{
-		if(!iter->second->writeToFile(apr_file))
-		{
-			//failed
-			delete apr_file ;
-			removeCache() ;
-			return ;
-		}
-	}
-
-	delete apr_file ;
-	return ;
+	updateEntry(entry);
 }
-
@@ -27,11 +27,13 @@
 #ifndef LL_LLVOCACHE_H
 #define LL_LLVOCACHE_H
 
+#include "llapr.h"
 #include "lluuid.h"
 #include "lldatapacker.h"
 #include "lldlinked.h"
 #include "lldir.h"
 
+struct apr_mmap_t;
 
 //---------------------------------------------------------------------------
 // Cache entries
@@ -61,6 +63,8 @@ public:
 	typedef std::map<U32, LLVOCacheEntry*>	vocache_entry_map_t;
 
 protected:
+	friend class LLVOCacheFile;
+
 	U32							mLocalID;
 	U32							mCRC;
 	S32							mHitCount;
@@ -70,6 +74,112 @@ protected:
 	U8							*mBuffer;
 };
 
+//---------------------------------------------------------------------------
+// Object cache file of one region (objects_<x>_<y>.slm), mapped into
+// memory. An entry is appended to the file as soon as its CRC changes and
+// read back only when the region sends a cached update for it, so entering
+// a region does not read the whole file and leaving it does not rewrite it.
+//
+// File organization:
+//  Header
+//  Slot[mNumSlots]		open addressing table of the entries by local id
+//  records				the data of the entries, appended one after the other
+//
+// A replaced record stays in the file until compact() rewrites it without
+// the dead records. The file is rewritten into a temporary file that is then
+// renamed over it, so a crash leaves either the old or the new file. Each
+// record has a checksum in its slot and a file left open by a crash is
+// repaired on the next open by dropping the slots of torn records.
+class LLVOCacheFile
+{
+public:
+	LLVOCacheFile();
+	~LLVOCacheFile();
+
+	// Maps filename, creating it unless read_only. A file for another
+	// region id than id is emptied, a file that was not closed is repaired,
+	// or rejected if read_only. Returns false on failure.
+	bool open(const std::string& filename, const LLUUID& id, bool read_only);
+	void close();
+	bool isOpen() const { return mHeader != NULL; }
+
+	U32 getNumEntries() const;
+
+	// Returns FALSE if there is no entry for local_id
+	BOOL getCRC(U32 local_id, U32& crc) const;
+	// Returns a new entry read from the file, NULL if there is none
+	LLVOCacheEntry* readEntry(U32 local_id) const;
+	// Adds entry or replaces the entry with the same local id
+	BOOL writeEntry(const LLVOCacheEntry& entry);
+	// Stores the counters of entry without touching its data
+	void updateCounts(const LLVOCacheEntry& entry);
+
+	// Rewrites the file without its dead records if they take a large
+	// enough part of it, or always if force is set
+	BOOL compact(BOOL force = FALSE);
+
+	// Adds the entries of a cache file of the previous format
+	// (objects_<x>_<y>.slc). Returns the number of entries added, -1 if the
+	// file can't be read or is for another region id than id.
+	S32 importLegacyFile(const std::string& filename, const LLUUID& id, LLVolatileAPRPool* pool = NULL);
+
+private:
+	struct Header
+	{
+		U32 mMagic;
+		U32 mVersion;
+		LLUUID mRegionID;
+		U32 mNumSlots;		// power of 2
+		U32 mNumEntries;
+		U32 mDataEnd;		// offset of the next record
+		U32 mDeadSize;		// bytes of replaced records
+		U32 mClean;			// 0 while open for writing
+		U32 mPad;
+	};
+
+	struct Slot
+	{
+		U32 mLocalID;		// 0 for an empty slot
+		U32 mCRC;
+		U32 mOffset;		// of the record in the file
+		U32 mSize;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mChecksum;		// of the record
+	};
+
+	// No copy constructor or copy assignment
+	LLVOCacheFile(const LLVOCacheFile&);
+	LLVOCacheFile& operator=(const LLVOCacheFile&);
+
+	// Returns the slot of local_id or the empty slot where it goes, NULL
+	// if the table is full
+	Slot* findSlot(U32 local_id) const;
+	// Returns false if the record of slot is out of the file or does not
+	// match its checksum
+	bool isIntact(const Slot& slot) const;
+	bool openFile();
+	bool map(apr_size_t size);
+	void unmap();
+	// Makes room for size more bytes of records
+	bool reserve(U32 size);
+	// Rewrites the file for region id with at least num_slots slots and
+	// only the live, intact records
+	bool rebuild(const LLUUID& id, U32 num_slots);
+
+	LLAPRPool* mPool;
+	apr_file_t* mFile;
+	apr_mmap_t* mMap;
+	apr_size_t mMapSize;
+	bool mReadOnly;
+	std::string mFilename;
+
+	Header* mHeader;
+	Slot* mSlots;
+	U32 mShift;			// turns a hashed local id into a slot number
+};
+
 //
 //Note: LLVOCache is not thread-safe
 //
@@ -100,6 +210,7 @@ private:
 	};
 	typedef std::set<HeaderEntryInfo*, header_entry_less> header_entry_queue_t;
 	typedef std::map<U64, HeaderEntryInfo*> handle_entry_map_t;
+	typedef std::set<U64> handle_set_t;
 private:
 	LLVOCache() ;
 
@@ -109,8 +220,11 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
-	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
-	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
+	// Opens the cache file of the region, converting a cache file of the
+	// previous format if there is one. Returns NULL if the cache is off.
+	LLVOCacheFile* openRegionCache(U64 handle, const LLUUID& id) ;
+	// Compacts the file if it needs it and deletes it
+	void closeRegionCache(U64 handle, LLVOCacheFile* cache_file) ;
 
 	void setReadOnly(BOOL read_only) {mReadOnly = read_only;} 
 
@@ -118,7 +232,10 @@ private:
 	void setDirNames(ELLPath location);	
 	// determine the cache filename for the region from the region handle	
 	void getObjectCacheFilename(U64 handle, std::string& filename);
+	void getLegacyObjectCacheFilename(U64 handle, std::string& filename);
 	void removeFromCache(U64 handle);
+	void touchEntry(U64 handle);
+	void convertLegacyCache(U64 handle, const LLUUID& id, LLVOCacheFile* cache_file);
 	void readCacheHeader();
 	void writeCacheHeader();
 	void clearCacheInMemory();
@@ -140,6 +257,7 @@ private:
 	LLVolatileAPRPool*   mLocalAPRFilePoolp ; 	
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
+	handle_set_t         mOpenRegions; // not purged while their file is open
 
 	static LLVOCache* sInstance ;
 public:
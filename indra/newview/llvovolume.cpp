@@ -54,6 +54,7 @@
 #include "llviewercamera.h"
 #include "llviewertexturelist.h"
 #include "llviewerregion.h"
+#include "llviewerstats.h"
 #include "llviewertextureanim.h"
 #include "llworld.h"
 #include "llselectmgr.h"
@@ -77,6 +78,9 @@ F32 LLVOVolume::sLODFactor = 1.f;
 F32	LLVOVolume::sLODSlopDistanceFactor = 0.5f; //Changing this to zero, effectively disables the LOD transition slop 
 F32 LLVOVolume::sDistanceFactor = 1.0f;
 S32 LLVOVolume::sNumLODChanges = 0;
+std::vector<LLPointer<LLVOVolume> > LLVOVolume::sWaitingForVolumeBuild;
+U32 LLVOVolume::sLastVolumeCacheHits = 0;
+U32 LLVOVolume::sLastVolumeCacheMisses = 0;
 LLPointer<LLObjectMediaDataClient> LLVOVolume::sObjectMediaClient = NULL;
 LLPointer<LLObjectMediaNavigateClient> LLVOVolume::sObjectMediaNavigateClient = NULL;
 
@@ -200,6 +204,7 @@ LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *re
 	mNumFaces = 0;
 	mLODChanged = FALSE;
 	mSculptChanged = FALSE;
+	mWaitingForVolumeBuild = FALSE;
 	mSpotLightPriority = 0.f;
 
 	mMediaImplList.resize(getNumTEs());
@@ -277,6 +282,7 @@ void LLVOVolume::cleanupClass()
 {
     sObjectMediaClient = NULL;
     sObjectMediaNavigateClient = NULL;
+	sWaitingForVolumeBuild.clear();
 }
 
 U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
@@ -1067,7 +1073,7 @@ void LLVOVolume::sculpt()
 				mSculptTexture->updateBindStatsForTester() ;
 			}
 		}
-		getVolume()->sculpt(sculpt_width, sculpt_height, sculpt_components, sculpt_data, discard_level);
+		LLPrimitive::getVolumeManager()->sculpt(getVolume(), sculpt_width, sculpt_height, sculpt_components, sculpt_data, discard_level);
 
 		//notify rebuild any other VOVolumes that reference this sculpty volume
 		for (S32 i = 0; i < mSculptTexture->getNumVolumes(); ++i)
@@ -1075,7 +1081,14 @@ void LLVOVolume::sculpt()
 			LLVOVolume* volume = (*(mSculptTexture->getVolumeList()))[i];
 			if (volume != this && volume->getVolume() == getVolume())
 			{
-				gPipeline.markRebuild(volume->mDrawable, LLDrawable::REBUILD_GEOMETRY, FALSE);
+				if (getVolume()->isBuildPending())
+				{
+					volume->waitForVolumeBuild();
+				}
+				else
+				{
+					gPipeline.markRebuild(volume->mDrawable, LLDrawable::REBUILD_GEOMETRY, FALSE);
+				}
 			}
 		}
 	}
@@ -1521,9 +1534,23 @@ BOOL LLVOVolume::updateGeometry(LLDrawable *drawable)
 	mSculptChanged = FALSE;
 	mFaceMappingChanged = FALSE;
 
+	if (getVolume()->isBuildPending())
+	{
+		waitForVolumeBuild();
+	}
+
 	return LLViewerObject::updateGeometry(drawable);
 }
 
+void LLVOVolume::waitForVolumeBuild()
+{
+	if (!mWaitingForVolumeBuild)
+	{
+		mWaitingForVolumeBuild = TRUE;
+		sWaitingForVolumeBuild.push_back(this);
+	}
+}
+
 void LLVOVolume::updateFaceSize(S32 idx)
 {
 	LLFace* facep = mDrawable->getFace(idx);
@@ -2901,9 +2928,46 @@ U32 LLVOVolume::getRenderCost(std::set<LLUUID> &textures) const
 }
 
 //static
+static LLFastTimer::DeclareTimer FTM_VOLUME_BUILDS("Volume Builds");
+
 void LLVOVolume::preUpdateGeom()
 {
 	sNumLODChanges = 0;
+
+	LLFastTimer t(FTM_VOLUME_BUILDS);
+	LLVolumeMgr* volume_mgr = LLPrimitive::getVolumeManager();
+	volume_mgr->updateBuilds();
+
+	U32 hits = volume_mgr->getCacheHits() - sLastVolumeCacheHits;
+	U32 misses = volume_mgr->getCacheMisses() - sLastVolumeCacheMisses;
+	sLastVolumeCacheHits = volume_mgr->getCacheHits();
+	sLastVolumeCacheMisses = volume_mgr->getCacheMisses();
+	LLViewerStats::getInstance()->mVolumeCacheMemStat.addValue((F32)volume_mgr->getCacheBytes() / (1024.f * 1024.f));
+	LLViewerStats::getInstance()->mVolumeBuildsStat.addValue((F32)misses);
+	if (hits + misses > 0)
+	{
+		LLViewerStats::getInstance()->mVolumeCacheHitStat.addValue(100.f * hits / (F32)(hits + misses));
+	}
+
+	// Rebuild the objects whose volumes were swapped in
+	U32 i = 0;
+	while (i < sWaitingForVolumeBuild.size())
+	{
+		LLVOVolume* volobjp = sWaitingForVolumeBuild[i];
+		if (!volobjp->isDead() && volobjp->getVolume() && volobjp->getVolume()->isBuildPending())
+		{
+			i++;
+			continue;
+		}
+
+		volobjp->mWaitingForVolumeBuild = FALSE;
+		if (!volobjp->isDead() && volobjp->mDrawable.notNull())
+		{
+			gPipeline.markRebuild(volobjp->mDrawable, LLDrawable::REBUILD_VOLUME, TRUE);
+		}
+		sWaitingForVolumeBuild[i] = sWaitingForVolumeBuild.back();
+		sWaitingForVolumeBuild.pop_back();
+	}
 }
 
 void LLVOVolume::parameterChanged(U16 param_type, bool local_origin)
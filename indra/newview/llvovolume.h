@@ -283,6 +283,10 @@ protected:
 	void cleanUpMediaImpls();
 	void addMediaImpl(LLViewerMediaImpl* media_impl, S32 texture_index) ;
 	void removeMediaImpl(S32 texture_index) ;
+
+	// Rebuilds the drawable once the volume, built in the background, is
+	// swapped in
+	void waitForVolumeBuild();
 public:
 	LLViewerTextureAnim *mTextureAnimp;
 	U8 mTexAnimMode;
@@ -294,6 +298,7 @@ private:
 	S32			mLOD;
 	BOOL		mLODChanged;
 	BOOL		mSculptChanged;
+	BOOL		mWaitingForVolumeBuild;
 	F32			mSpotLightPriority;
 	LLMatrix4	mRelativeXform;
 	LLMatrix3	mRelativeXformInvTrans;
@@ -319,6 +324,11 @@ public:
 
 protected:
 	static S32 sNumLODChanges;
+	// objects whose volumes are still being built, see waitForVolumeBuild()
+	static std::vector<LLPointer<LLVOVolume> > sWaitingForVolumeBuild;
+	// volume cache totals at the previous preUpdateGeom()
+	static U32 sLastVolumeCacheHits;
+	static U32 sLastVolumeCacheMisses;
 	
 	friend class LLVolumeImplFlexible;
 };
@@ -51,6 +51,7 @@
 // newview includes
 #include "llagent.h"
 #include "llagentcamera.h"
+#include "llappviewer.h"
 #include "lldrawable.h"
 #include "lldrawpoolalpha.h"
 #include "lldrawpoolavatar.h"
@@ -252,6 +253,7 @@ S32		LLPipeline::sCompiles = 0;
 
 BOOL	LLPipeline::sPickAvatar = TRUE;
 BOOL	LLPipeline::sDynamicLOD = TRUE;
+BOOL	LLPipeline::sCullThreaded = TRUE;
 BOOL	LLPipeline::sShowHUDAttachments = TRUE;
 BOOL	LLPipeline::sRenderPhysicalBeacons = TRUE;
 BOOL	LLPipeline::sRenderScriptedBeacons = FALSE;
@@ -355,6 +357,8 @@ void LLPipeline::init()
 	LLMemType mt(LLMemType::MTYPE_PIPELINE_INIT);
 
 	sDynamicLOD = gSavedSettings.getBOOL("RenderDynamicLOD");
+	sCullThreaded = gSavedSettings.getBOOL("RenderCullThreaded");
+	updateCullVariant();
 	sRenderBump = gSavedSettings.getBOOL("RenderObjectBump");
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
@@ -638,6 +642,16 @@ void LLPipeline::updateRenderDeferred()
 	sRenderDeferred = deferred;			
 }
 
+//static
+void LLPipeline::updateCullVariant()
+{
+	// The widest variant is fastest on the octree's small batches
+	LLCamera::EBatchVariant variant = gSavedSettings.getBOOL("VectorizeEnable") ?
+		LLCamera::getBestBatchVariant() : LLCamera::VARIANT_REFERENCE;
+	LLCamera::setBatchVariant(variant);
+	LL_INFOS("AppInit") << "Frustum checks        : " << LLCamera::getBatchVariantName(variant) << LL_ENDL;
+}
+
 void LLPipeline::releaseGLBuffers()
 {
 	assertInitialized();
@@ -1607,6 +1621,9 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 
 	LLGLDepthTest depth(GL_TRUE, GL_FALSE);
 
+	LLThreadPool* pool = sCullThreaded ? LLAppViewer::getThreadPool() : NULL;
+	LLParallelCull parallel_cull;
+
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
@@ -1628,12 +1645,24 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 			{
 				if (hasRenderType(part->mDrawableType))
 				{
-					part->cull(camera);
+					if (pool)
+					{
+						parallel_cull.addPartition(part, camera);
+					}
+					else
+					{
+						part->cull(camera);
+					}
 				}
 			}
 		}
 	}
 
+	if (pool)
+	{
+		parallel_cull.cull(pool);
+	}
+
 	camera.disableUserClipPlane();
 
 	if (hasRenderType(LLPipeline::RENDER_TYPE_SKY) && 
@@ -8626,7 +8655,7 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	result.clear();
 	grabReferences(result);
 	
-	if (!avatar || !avatar->mDrawable)
+	if (!avatar || !avatar->mDrawable || !avatar->hasImpostorSprite())
 	{
 		return;
 	}
@@ -8692,27 +8721,17 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 
 	stateSort(*LLViewerCamera::getInstance(), result);
 	
-	const LLVector3* ext = avatar->mDrawable->getSpatialExtents();
 	LLVector3 pos(avatar->getRenderPosition()+avatar->getImpostorOffset());
 
-	LLCamera camera = *viewer_camera;
-
-	camera.lookAt(viewer_camera->getOrigin(), pos, viewer_camera->getUpAxis());
-	
+	LLCamera camera;
 	LLVector2 tdim;
+	U32 resX, resY;
+	avatar->getImpostorProjection(camera, tdim, resX, resY);
 
-	LLVector3 half_height = (ext[1]-ext[0])*0.5f;
-
-	LLVector3 left = camera.getLeftAxis();
-	left *= left;
-	left.normalize();
-
-	LLVector3 up = camera.getUpAxis();
-	up *= up;
-	up.normalize();
-
-	tdim.mV[0] = fabsf(half_height * left);
-	tdim.mV[1] = fabsf(half_height * up);
+	// The atlas may have given the sprite less room than it asked for
+	const LLRect& rect = avatar->getImpostorRect();
+	resX = rect.getWidth();
+	resY = rect.getHeight();
 
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
@@ -8739,39 +8758,41 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	glStencilMask(0xFFFFFFFF);
 	glClearStencil(0);
 
-	// get the number of pixels per angle
-	F32 pa = gViewerWindow->getWindowHeightRaw() / (RAD_TO_DEG * viewer_camera->getView());
-
-	//get resolution based on angle width and height of impostor (double desired resolution to prevent aliasing)
-	U32 resY = llmin(nhpo2((U32) (fov*pa)), (U32) 512);
-	U32 resX = llmin(nhpo2((U32) (atanf(tdim.mV[0]/distance)*2.f*RAD_TO_DEG*pa)), (U32) 512);
-
-	if (!avatar->mImpostor.isComplete() || resX != avatar->mImpostor.getWidth() ||
-		resY != avatar->mImpostor.getHeight())
+	LLRenderTarget& atlas = LLVOAvatar::sImpostorTarget;
+	if (!atlas.isComplete() || (S32)atlas.getWidth() != LLVOAvatar::sImpostorAtlas.getWidth() ||
+		(S32)atlas.getHeight() != LLVOAvatar::sImpostorAtlas.getHeight())
 	{
-		avatar->mImpostor.allocate(resX,resY,GL_RGBA,TRUE,TRUE);
+		atlas.allocate(LLVOAvatar::sImpostorAtlas.getWidth(), LLVOAvatar::sImpostorAtlas.getHeight(),
+					   GL_RGBA, TRUE, TRUE, LLTexUnit::TT_TEXTURE, TRUE);
 		
 		if (LLPipeline::sRenderDeferred)
 		{
-			addDeferredAttachments(avatar->mImpostor);
+			addDeferredAttachments(atlas);
 		}
 		
-		gGL.getTexUnit(0)->bind(&avatar->mImpostor);
+		gGL.getTexUnit(0)->bind(&atlas);
 		gGL.getTexUnit(0)->setTextureFilteringOption(LLTexUnit::TFO_POINT);
 		gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
 	}
 
+	// Draw into the sprite's rectangle of the atlas. Without FBOs the
+	// target is the back buffer: draw at its corner and copy the
+	// rectangle over afterwards.
+	BOOL use_fbo = gGLManager.mHasFramebufferObject;
+	S32 originX = use_fbo ? rect.mLeft : 0;
+	S32 originY = use_fbo ? rect.mBottom : 0;
+
 	LLGLEnable stencil(GL_STENCIL_TEST);
 	glStencilMask(0xFFFFFFFF);
 	glStencilFunc(GL_ALWAYS, 1, 0xFFFFFFFF);
 	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
-	{
-		LLGLEnable scissor(GL_SCISSOR_TEST);
-		glScissor(0, 0, resX, resY);
-		avatar->mImpostor.bindTarget();
-		avatar->mImpostor.clear();
-	}
+	// Keep the neighbours' sprites out of the clear and the draw
+	LLGLEnable scissor(GL_SCISSOR_TEST);
+	glScissor(originX, originY, resX, resY);
+	atlas.bindTarget();
+	glViewport(originX, originY, resX, resY);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	
 	if (LLPipeline::sRenderDeferred)
 	{
@@ -8827,7 +8848,17 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	}
 
 
-	avatar->mImpostor.flush();
+	if (use_fbo)
+	{
+		atlas.flush();
+	}
+	else
+	{
+		gGL.flush();
+		gGL.getTexUnit(0)->bind(&atlas);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, rect.mLeft, rect.mBottom, 0, 0, resX, resY);
+		gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
+	}
 
 	avatar->setImpostorDim(tdim);
 
@@ -0,0 +1,208 @@
+/**
+ * @file llimpostoratlas_test.cpp
+ * @brief Tests for LLImpostorAtlas
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llimpostoratlas.h"
+// Dependencies
+#include "llrand.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	typedef LLImpostorAtlas::handle_t handle_t;
+
+	// The sprites are inside the atlas and none overlap
+	bool check_packing(const LLImpostorAtlas& atlas, const std::vector<handle_t>& handles)
+	{
+		S32 area = 0;
+		for (U32 i = 0; i < handles.size(); i++)
+		{
+			if (!atlas.hasSprite(handles[i]))
+			{
+				continue;
+			}
+			const LLRect& a = atlas.getRect(handles[i]);
+			if (a.mLeft < 0 || a.mBottom < 0 || a.mRight > atlas.getWidth() || a.mTop > atlas.getHeight())
+			{
+				return false;
+			}
+			area += a.getWidth() * a.getHeight();
+			for (U32 j = i + 1; j < handles.size(); j++)
+			{
+				if (!atlas.hasSprite(handles[j]))
+				{
+					continue;
+				}
+				const LLRect& b = atlas.getRect(handles[j]);
+				if (a.mLeft < b.mRight && b.mLeft < a.mRight && a.mBottom < b.mTop && b.mBottom < a.mTop)
+				{
+					return false;
+				}
+			}
+		}
+		return area == atlas.getUsedArea();
+	}
+}
+
+namespace tut
+{
+	struct impostoratlas_test
+	{
+	};
+
+	typedef test_group<impostoratlas_test> impostoratlas_t;
+	typedef impostoratlas_t::object impostoratlas_object_t;
+	tut::impostoratlas_t tut_impostoratlas("LLImpostorAtlas");
+
+	template<> template<>
+	void impostoratlas_object_t::test<1>()
+	{
+		// Sprites of impostor sizes are packed without overlaps, refreshed
+		// at new sizes, and removing all of them gives back the whole atlas
+		LLImpostorAtlas atlas(1024, 1024);
+		std::vector<handle_t> handles;
+		for (S32 i = 0; i < 40; i++)
+		{
+			handles.push_back(atlas.addImpostor(NULL));
+			atlas.requestUpdate(handles.back(), 32 << (i % 3), 64 << (i % 3), 1.f);
+		}
+		ensure_equals("all pending", atlas.getNumPending(), 40);
+		ensure_equals("all scheduled", (S32)atlas.schedule(40).size(), 40);
+		ensure_equals("none pending", atlas.getNumPending(), 0);
+		ensure("packed", check_packing(atlas, handles));
+
+		for (S32 frame = 0; frame < 50; frame++)
+		{
+			for (S32 i = 0; i < 10; i++)
+			{
+				handle_t handle = handles[ll_rand(handles.size())];
+				S32 size = 16 << ll_rand(4);
+				atlas.requestUpdate(handle, size, size * 2, ll_frand(100.f));
+			}
+			if (frame % 5 == 0)
+			{
+				U32 i = ll_rand(handles.size());
+				atlas.removeImpostor(handles[i]);
+				handles[i] = atlas.addImpostor(NULL);
+				atlas.requestUpdate(handles[i], 64, 128, 1.f);
+			}
+			atlas.schedule(8);
+			ensure("still packed", check_packing(atlas, handles));
+		}
+
+		for (U32 i = 0; i < handles.size(); i++)
+		{
+			atlas.removeImpostor(handles[i]);
+		}
+		ensure_equals("empty", atlas.getNumImpostors(), 0);
+		ensure_equals("nothing used", atlas.getUsedArea(), 0);
+		ensure_equals("nothing pending", atlas.getNumPending(), 0);
+
+		handle_t full = atlas.addImpostor(NULL);
+		atlas.requestUpdate(full, 1024, 1024, 1.f);
+		atlas.schedule(1);
+		ensure_equals("whole atlas free again", atlas.getRect(full).getWidth(), 1024);
+		ensure_distance("full", atlas.getFill(), 1.f, 0.0001f);
+	}
+
+	template<> template<>
+	void impostoratlas_object_t::test<2>()
+	{
+		// Impostors with no sprite go first, then the largest on screen,
+		// and waiting makes small ones catch up
+		LLImpostorAtlas atlas(1024, 1024);
+		handle_t near_avatar = atlas.addImpostor(NULL);
+		handle_t far_avatar = atlas.addImpostor(NULL);
+		handle_t new_avatar = atlas.addImpostor(NULL);
+		atlas.requestUpdate(near_avatar, 64, 128, 1000.f);
+		atlas.requestUpdate(far_avatar, 64, 128, 10.f);
+		atlas.schedule(2);
+		ensure("both drawn", atlas.hasSprite(near_avatar) && atlas.hasSprite(far_avatar));
+
+		atlas.requestUpdate(near_avatar, 64, 128, 1000.f);
+		atlas.requestUpdate(far_avatar, 64, 128, 10.f);
+		atlas.requestUpdate(new_avatar, 64, 128, 1.f);
+		const std::vector<handle_t>& first = atlas.schedule(1);
+		ensure_equals("one update", (S32)first.size(), 1);
+		ensure_equals("no sprite first", first[0], new_avatar);
+
+		ensure_equals("near next", atlas.schedule(1)[0], near_avatar);
+
+		// The far avatar has waited 3 frames, the near one asks again
+		atlas.requestUpdate(near_avatar, 64, 128, 15.f);
+		ensure_equals("waited long enough", atlas.schedule(1)[0], far_avatar);
+		ensure("near still pending", atlas.isPending(near_avatar));
+		ensure_equals("near last", atlas.schedule(4)[0], near_avatar);
+		ensure("nothing left", atlas.schedule(4).empty());
+	}
+
+	template<> template<>
+	void impostoratlas_object_t::test<3>()
+	{
+		// A refresh at the same size keeps its rectangle, sprites that don't
+		// fit are halved, and ones that can't fit at all wait
+		LLImpostorAtlas atlas(256, 256);
+		handle_t a = atlas.addImpostor((void*)1);
+		atlas.requestUpdate(a, 128, 256, 1.f);
+		atlas.schedule(1);
+		LLRect rect = atlas.getRect(a);
+		atlas.requestUpdate(a, 128, 256, 1.f);
+		atlas.schedule(1);
+		ensure_equals("same rect", atlas.getRect(a), rect);
+		ensure("user data", atlas.getUserData(a) == (void*)1);
+
+		handle_t b = atlas.addImpostor(NULL);
+		atlas.requestUpdate(b, 256, 256, 1.f);
+		atlas.schedule(1);
+		ensure_equals("halved width", atlas.getRect(b).getWidth(), 128);
+		ensure_equals("halved height", atlas.getRect(b).getHeight(), 128);
+		ensure_distance("fill", atlas.getFill(), 0.75f, 0.0001f);
+
+		handle_t c = atlas.addImpostor(NULL);
+		atlas.requestUpdate(c, 64, 64, 1.f);
+		ensure("no room", atlas.schedule(1).empty());
+		ensure("waits", atlas.isPending(c) && !atlas.hasSprite(c));
+		atlas.removeImpostor(b);
+		ensure_equals("room again", atlas.schedule(1)[0], c);
+		std::vector<handle_t> handles;
+		handles.push_back(a);
+		handles.push_back(c);
+		ensure("packed", check_packing(atlas, handles));
+
+		// stale handles are ignored
+		atlas.removeImpostor(b);
+		atlas.requestUpdate(b, 64, 64, 1.f);
+		ensure("stale", !atlas.hasSprite(b) && !atlas.isPending(b) && atlas.getRect(b).isEmpty());
+		ensure_equals("impostors", atlas.getNumImpostors(), 2);
+
+		atlas.clear();
+		ensure_equals("cleared", atlas.getNumImpostors(), 0);
+		ensure("cleared sprite", !atlas.hasSprite(a));
+	}
+}
@@ -0,0 +1,399 @@
+/**
+ * @file lltexturecacheindex_test.cpp
+ * @brief Tests and lookup benchmark for LLTextureCacheIndex
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../lltexturecacheindex.h"
+// Dependencies
+#include "llfile.h"
+#include "llrand.h"
+#include "lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+#include <iostream>
+#include <set>
+
+namespace
+{
+	const char* TEST_INDEX_FILENAME = "lltexturecacheindex_test.index";
+
+	// Looks up the same ids as fast as it can, either in the index or in
+	// a std::map behind a single mutex, which is how LLTextureCache
+	// organized its entries before the index.
+	class LookupThread : public LLThread
+	{
+	public:
+		LookupThread(LLTextureCacheIndex* index, LLMutex* map_mutex, std::map<LLUUID, S32>* map,
+					 const std::vector<LLUUID>& ids, S32 offset, S32 count) :
+			LLThread("LookupThread"),
+			mIndex(index),
+			mMapMutex(map_mutex),
+			mMap(map),
+			mIDs(ids),
+			mOffset(offset),
+			mCount(count),
+			mFound(0),
+			mDone(FALSE)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			const S32 num_ids = mIDs.size();
+			for (S32 i = 0; i < mCount; i++)
+			{
+				const LLUUID& id = mIDs[(mOffset + i * 7919) % num_ids];
+				if (mIndex)
+				{
+					LLTextureCacheIndex::Entry entry;
+					if (mIndex->find(id, entry) >= 0)
+					{
+						mFound++;
+					}
+				}
+				else
+				{
+					LLMutexLock lock(mMapMutex);
+					if (mMap->find(id) != mMap->end())
+					{
+						mFound++;
+					}
+				}
+			}
+			mDone = TRUE;
+		}
+
+		LLTextureCacheIndex* mIndex;
+		LLMutex* mMapMutex;
+		std::map<LLUUID, S32>* mMap;
+		const std::vector<LLUUID>& mIDs;
+		S32 mOffset;
+		S32 mCount;
+		S32 mFound;
+		LLAtomic32<BOOL> mDone;
+	};
+
+	F64 run_lookups(LLTextureCacheIndex* index, LLMutex* map_mutex, std::map<LLUUID, S32>* map,
+					const std::vector<LLUUID>& ids, S32 num_threads, S32 lookups_per_thread, S32& found)
+	{
+		std::vector<LookupThread*> threads;
+		for (S32 i = 0; i < num_threads; i++)
+		{
+			threads.push_back(new LookupThread(index, map_mutex, map, ids, i * 104729, lookups_per_thread));
+		}
+		LLTimer timer;
+		for (S32 i = 0; i < num_threads; i++)
+		{
+			threads[i]->start();
+		}
+		found = 0;
+		for (S32 i = 0; i < num_threads; i++)
+		{
+			while (!threads[i]->mDone)
+			{
+				ms_sleep(1);
+			}
+			found += threads[i]->mFound;
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		for (S32 i = 0; i < num_threads; i++)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		return elapsed;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct texturecacheindex_test
+	{
+		LLTextureCacheIndex mIndex;
+
+		texturecacheindex_test()
+		{
+			LLFile::remove(TEST_INDEX_FILENAME);
+		}
+		~texturecacheindex_test()
+		{
+			mIndex.close();
+			LLFile::remove(TEST_INDEX_FILENAME);
+		}
+
+		void openIndex(U32 max_entries, bool expect_created)
+		{
+			bool created = false;
+			ensure("index opened", mIndex.open(TEST_INDEX_FILENAME, max_entries, false, created));
+			ensure_equals("index created", created, expect_created);
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<texturecacheindex_test> texturecacheindex_t;
+	typedef texturecacheindex_t::object texturecacheindex_object_t;
+	tut::texturecacheindex_t tut_texturecacheindex("LLTextureCacheIndex");
+
+	// Insert, find, update and remove
+	template<> template<>
+	void texturecacheindex_object_t::test<1>()
+	{
+		openIndex(1024, true);
+
+		LLUUID id;
+		id.generate();
+		LLTextureCacheIndex::Entry entry;
+		ensure("not indexed yet", mIndex.find(id, entry) < 0);
+
+		LLTextureCacheIndex::entry_list_t evicted;
+		S32 slot = mIndex.insert(LLTextureCacheIndex::Entry(id, 4000, 2000, 100), evicted);
+		ensure("inserted", slot >= 0);
+		ensure("nothing evicted", evicted.empty());
+		ensure_equals("found with the same record", mIndex.find(id, entry, 200), slot);
+		ensure_equals("image size", entry.mImageSize, 4000);
+		ensure_equals("touched", entry.mTime, (U32)200);
+		ensure_equals("one entry", mIndex.getNumEntries(), (U32)1);
+		ensure_equals("body total", mIndex.getBodySizeTotal(), (S64)2000);
+
+		ensure("updated", mIndex.update(slot, LLTextureCacheIndex::Entry(id, 4000, 3400, 300)));
+		ensure_equals("body total after update", mIndex.getBodySizeTotal(), (S64)3400);
+
+		ensure_equals("removed", mIndex.remove(id, entry), slot);
+		ensure_equals("removed body size", entry.mBodySize, 3400);
+		ensure("gone", mIndex.find(id, entry) < 0);
+		ensure("stale update rejected", !mIndex.update(slot, LLTextureCacheIndex::Entry(id, 4000, 3400, 300)));
+		ensure_equals("no entries", mIndex.getNumEntries(), (U32)0);
+		ensure_equals("no bodies", mIndex.getBodySizeTotal(), (S64)0);
+	}
+
+	// Entries survive closing and reopening the index
+	template<> template<>
+	void texturecacheindex_object_t::test<2>()
+	{
+		openIndex(4096, true);
+
+		std::vector<LLUUID> ids(1000);
+		std::vector<S32> slots(ids.size());
+		LLTextureCacheIndex::entry_list_t evicted;
+		for (U32 i = 0; i < ids.size(); i++)
+		{
+			ids[i].generate();
+			slots[i] = mIndex.insert(LLTextureCacheIndex::Entry(ids[i], 5000 + i, i, i), evicted);
+		}
+		ensure("nothing evicted", evicted.empty());
+		mIndex.close();
+
+		openIndex(4096, false);
+		ensure_equals("entry count restored", mIndex.getNumEntries(), (U32)ids.size());
+		for (U32 i = 0; i < ids.size(); i++)
+		{
+			LLTextureCacheIndex::Entry entry;
+			ensure_equals("same record after reopening", mIndex.find(ids[i], entry), slots[i]);
+			ensure_equals("same image size after reopening", entry.mImageSize, (S32)(5000 + i));
+		}
+	}
+
+	// A full shard evicts its least recently used entries
+	template<> template<>
+	void texturecacheindex_object_t::test<3>()
+	{
+		openIndex(LLTextureCacheIndex::NUM_SHARDS * 16, true);
+
+		LLTextureCacheIndex::entry_list_t evicted;
+		U32 num_inserted = 0;
+		for (U32 i = 0; i < 10000 && evicted.empty(); i++)
+		{
+			LLUUID id;
+			id.generate();
+			ensure("inserted", mIndex.insert(LLTextureCacheIndex::Entry(id, 100, 0, 1000 + i), evicted) >= 0);
+			num_inserted++;
+		}
+		ensure("eviction happened", !evicted.empty());
+		ensure_equals("entries accounted for", mIndex.getNumEntries() + evicted.size(), num_inserted);
+
+		// Evicted entries are the oldest of their shard
+		for (U32 i = 0; i < evicted.size(); i++)
+		{
+			LLTextureCacheIndex::Entry entry;
+			ensure("evicted entry gone", mIndex.find(evicted[i].second.mID, entry) < 0);
+		}
+		LLTextureCacheIndex::entry_list_t entries;
+		mIndex.getEntries(entries);
+		S32 shard_slots = mIndex.getNumSlots() / LLTextureCacheIndex::NUM_SHARDS;
+		for (U32 i = 0; i < entries.size(); i++)
+		{
+			for (U32 j = 0; j < evicted.size(); j++)
+			{
+				if (entries[i].first / shard_slots == evicted[j].first / shard_slots)
+				{
+					ensure("kept entries are more recent", entries[i].second.mTime >= evicted[j].second.mTime);
+				}
+			}
+		}
+	}
+
+	// Churn: removing entries moves others but never their record, and
+	// leaves nothing behind that lookups have to step over
+	template<> template<>
+	void texturecacheindex_object_t::test<5>()
+	{
+		openIndex(LLTextureCacheIndex::NUM_SHARDS * 64, true);
+
+		std::vector<std::pair<LLUUID, S32> > live;
+		LLTextureCacheIndex::entry_list_t evicted;
+		for (U32 i = 0; i < 100000; i++)
+		{
+			if (live.size() < 1500 && ll_rand(3))
+			{
+				LLUUID id;
+				id.generate();
+				S32 record = mIndex.insert(LLTextureCacheIndex::Entry(id, 100, 10, i), evicted, false);
+				ensure("inserted", record >= 0);
+				live.push_back(std::make_pair(id, record));
+			}
+			else if (!live.empty())
+			{
+				U32 pick = ll_rand(live.size());
+				LLTextureCacheIndex::Entry entry;
+				ensure_equals("removed with its record", mIndex.remove(live[pick].first, entry), live[pick].second);
+				live[pick] = live.back();
+				live.pop_back();
+			}
+		}
+		ensure("nothing evicted", evicted.empty());
+		ensure_equals("entry count", mIndex.getNumEntries(), (U32)live.size());
+		ensure_equals("body total", mIndex.getBodySizeTotal(), (S64)live.size() * 10);
+
+		std::set<S32> records;
+		for (U32 i = 0; i < live.size(); i++)
+		{
+			LLTextureCacheIndex::Entry entry;
+			ensure_equals("record kept", mIndex.find(live[i].first, entry), live[i].second);
+			ensure("record used once", records.insert(live[i].second).second);
+		}
+
+		// After closing and reopening, records still go to new entries only when free
+		mIndex.close();
+		openIndex(LLTextureCacheIndex::NUM_SHARDS * 64, false);
+		for (U32 i = 0; i < 200; i++)
+		{
+			LLUUID id;
+			id.generate();
+			ensure("new record", records.insert(mIndex.insert(LLTextureCacheIndex::Entry(id, 100, 10, i), evicted, false)).second);
+		}
+	}
+
+	// Entries whose record is outside of their shard, as in a damaged file,
+	// get their shard rebuilt instead of records handed out twice
+	template<> template<>
+	void texturecacheindex_object_t::test<6>()
+	{
+		const U32 SLOTS_PER_SHARD = 16;
+		const U32 NUM_SLOTS = LLTextureCacheIndex::NUM_SHARDS * SLOTS_PER_SHARD;
+		openIndex(NUM_SLOTS, true);
+		LLTextureCacheIndex::entry_list_t evicted;
+		for (U32 i = 0; i < NUM_SLOTS / 8; i++)
+		{
+			LLUUID id;
+			id.generate();
+			mIndex.insert(LLTextureCacheIndex::Entry(id, 100, 10, i), evicted, false);
+		}
+		mIndex.close();
+
+		// Header, ShardInfo[NUM_SHARDS], then Slot (Entry, S32 record) records
+		{
+			const long SLOTS_START = 32 + LLTextureCacheIndex::NUM_SHARDS * 16;
+			const long SLOT_SIZE = sizeof(LLTextureCacheIndex::Entry) + sizeof(S32);
+			LLFILE* file = LLFile::fopen(TEST_INDEX_FILENAME, "r+b");
+			ensure("index file", file != NULL);
+			for (U32 slot = 0; slot < NUM_SLOTS; slot++)
+			{
+				S32 record = (slot % 2) ? -1000 : 1000000;
+				fseek(file, SLOTS_START + slot * SLOT_SIZE + sizeof(LLTextureCacheIndex::Entry), SEEK_SET);
+				fwrite(&record, sizeof(S32), 1, file);
+			}
+			fclose(file);
+		}
+
+		openIndex(NUM_SLOTS, false);
+		std::set<S32> records;
+		for (U32 i = 0; i < NUM_SLOTS / 8; i++)
+		{
+			LLUUID id;
+			id.generate();
+			U32 shard = ((const U32*)id.mData)[0] & (LLTextureCacheIndex::NUM_SHARDS - 1);
+			S32 record = mIndex.insert(LLTextureCacheIndex::Entry(id, 100, 10, i), evicted, false);
+			ensure("record in its shard", record >= (S32)(shard * SLOTS_PER_SHARD)
+				   && record < (S32)((shard + 1) * SLOTS_PER_SHARD));
+			ensure("record used once", records.insert(record).second);
+			LLTextureCacheIndex::Entry entry;
+			ensure_equals("found with its record", mIndex.find(id, entry), record);
+		}
+	}
+
+	// Lookup throughput with 128k entries, index vs. the legacy map + mutex organization
+	template<> template<>
+	void texturecacheindex_object_t::test<4>()
+	{
+		const U32 NUM_ENTRIES = 128 * 1024;
+		const S32 LOOKUPS_PER_THREAD = 200000;
+		openIndex(NUM_ENTRIES + NUM_ENTRIES / 4, true);
+
+		std::vector<LLUUID> ids(NUM_ENTRIES);
+		std::map<LLUUID, S32> map;
+		LLMutex map_mutex(NULL);
+		LLTextureCacheIndex::entry_list_t evicted;
+		for (U32 i = 0; i < NUM_ENTRIES; i++)
+		{
+			ids[i].generate();
+			map[ids[i]] = mIndex.insert(LLTextureCacheIndex::Entry(ids[i], 5000, 1000, i), evicted);
+		}
+
+		for (S32 num_threads = 1; num_threads <= 8; num_threads *= 2)
+		{
+			S32 found_index = 0;
+			S32 found_map = 0;
+			F64 index_time = run_lookups(&mIndex, NULL, NULL, ids, num_threads, LOOKUPS_PER_THREAD, found_index);
+			F64 map_time = run_lookups(NULL, &map_mutex, &map, ids, num_threads, LOOKUPS_PER_THREAD, found_map);
+			F64 lookups = (F64)num_threads * LOOKUPS_PER_THREAD;
+			std::cout << "LLTextureCacheIndex " << NUM_ENTRIES << " entries, " << num_threads << " threads: "
+					  << (S32)(lookups / llmax(index_time, 0.000001)) << " lookups/s (index) vs "
+					  << (S32)(lookups / llmax(map_time, 0.000001)) << " lookups/s (map+mutex)" << std::endl;
+			ensure("index lookups succeeded", found_index > 0);
+			ensure("map lookups succeeded", found_map > 0);
+		}
+	}
+}
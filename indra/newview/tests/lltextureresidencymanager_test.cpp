@@ -0,0 +1,246 @@
+/**
+ * @file lltextureresidencymanager_test.cpp
+ * @brief Tests and trace replay benchmark for LLTextureResidencyManager
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../lltextureresidencymanager.h"
+// Dependencies
+#include "llfile.h"
+#include "llrand.h"
+#include "lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const S32 MAX_DISCARD = 5;
+
+	// Writes the trace of a session with num_textures textures seen by a
+	// camera moving around: every frame the on screen size of some of them
+	// changes, some are dropped and replaced by new ones, and the fetcher
+	// catches up with the discard limits over a few frames.
+	void record_session(std::ostream& trace, S32 num_textures, S32 frames, S64 budget)
+	{
+		LLTextureResidencyManager manager;
+		manager.setTraceStream(&trace);
+		std::vector<LLTextureResidencyManager::handle_t> handles;
+		std::vector<F32> areas;
+		for (S32 i = 0; i < num_textures; i++)
+		{
+			S32 size = 64 << (i % 5); // 64 to 1024
+			handles.push_back(manager.addTexture(size, size, (i % 3) ? 3 : 4, TRUE));
+			areas.push_back(ll_frand(512.f * 512.f));
+		}
+		for (S32 frame = 0; frame < frames; frame++)
+		{
+			for (S32 n = 0; n < num_textures / 32; n++)
+			{
+				S32 i = ll_rand(num_textures);
+				if (ll_frand() < .05f)
+				{
+					// out of the scene, something else comes in
+					manager.removeTexture(handles[i]);
+					S32 size = 64 << ll_rand(5);
+					handles[i] = manager.addTexture(size, size, 3, TRUE);
+				}
+				areas[i] = llclamp(areas[i] * (.5f + ll_frand()), 1.f, 1024.f * 1024.f);
+				S32 size = 1024;
+				S32 wanted = llclamp((S32)(log(size * size / areas[i]) / log(4.0)), 0, MAX_DISCARD);
+				manager.setWanted(handles[i], wanted, MAX_DISCARD, areas[i], FALSE);
+			}
+			// the fetcher brings a few textures to their limit
+			for (S32 n = 0; n < num_textures / 16; n++)
+			{
+				S32 i = ll_rand(num_textures);
+				manager.setResident(handles[i], manager.getDiscardLimit(handles[i]));
+			}
+			manager.setBudget(budget);
+			manager.update();
+		}
+		manager.setTraceStream(NULL);
+	}
+}
+
+namespace tut
+{
+	struct textureresidency_test
+	{
+	};
+	typedef test_group<textureresidency_test> textureresidency_t;
+	typedef textureresidency_t::object textureresidency_object_t;
+	tut::textureresidency_t tut_textureresidency("LLTextureResidencyManager");
+
+	// Byte accounting
+	template<> template<>
+	void textureresidency_object_t::test<1>()
+	{
+		// 256x256 RGBA with the mip chain down to 1x1
+		S64 expected = 0;
+		for (S32 size = 256; size >= 1; size >>= 1)
+		{
+			expected += size * size * 4;
+		}
+		ensure_equals("mip chain", LLTextureResidencyManager::calcBytes(256, 256, 4, TRUE, 0), expected);
+		ensure_equals("no mips", LLTextureResidencyManager::calcBytes(256, 256, 4, FALSE, 0), (S64)(256 * 256 * 4));
+		ensure_equals("discard 2", LLTextureResidencyManager::calcBytes(256, 256, 3, FALSE, 2), (S64)(64 * 64 * 3));
+		ensure_equals("4 byte aligned", LLTextureResidencyManager::calcBytes(3, 3, 3, FALSE, 0), (S64)28);
+
+		LLTextureResidencyManager manager;
+		S32 user_data = 0;
+		LLTextureResidencyManager::handle_t a = manager.addTexture(256, 256, 4, FALSE, &user_data);
+		LLTextureResidencyManager::handle_t b = manager.addTexture(128, 128, 3, FALSE);
+		ensure_equals("two textures", manager.getNumTextures(), 2);
+		ensure("user data", manager.getUserData(a) == &user_data);
+		ensure_equals("nothing resident", manager.getResidentBytes(), (S64)0);
+		manager.setResident(a, 1);
+		manager.setResident(b, 0);
+		ensure_equals("resident bytes", manager.getResidentBytes(), (S64)(128 * 128 * 4 + 128 * 128 * 3));
+		manager.setResident(a, 0);
+		ensure_equals("resident bytes after change", manager.getResidentBytes(), (S64)(256 * 256 * 4 + 128 * 128 * 3));
+		manager.removeTexture(b);
+		ensure_equals("resident bytes after remove", manager.getResidentBytes(), (S64)(256 * 256 * 4));
+		ensure_equals("removed limit", manager.getDiscardLimit(b), -1);
+		ensure_equals("handle reused", manager.addTexture(64, 64, 4, FALSE), b);
+	}
+
+	// The least important textures get coarser first, pinned ones never
+	template<> template<>
+	void textureresidency_object_t::test<2>()
+	{
+		LLTextureResidencyManager manager;
+		LLTextureResidencyManager::handle_t low = manager.addTexture(512, 512, 4, FALSE);
+		LLTextureResidencyManager::handle_t high = manager.addTexture(512, 512, 4, FALSE);
+		LLTextureResidencyManager::handle_t pinned = manager.addTexture(512, 512, 4, FALSE);
+		manager.setWanted(low, 0, MAX_DISCARD, 10.f, FALSE);
+		manager.setWanted(high, 0, MAX_DISCARD, 1000.f, FALSE);
+		manager.setWanted(pinned, 0, MAX_DISCARD, 0.f, TRUE);
+
+		const S64 full = 512 * 512 * 4;
+		manager.setBudget(full * 3);
+		manager.update();
+		ensure_equals("fits: low", manager.getDiscardLimit(low), 0);
+		ensure_equals("fits: high", manager.getDiscardLimit(high), 0);
+		ensure_equals("nothing limited", manager.getNumLimited(), 0);
+		ensure_equals("planned is wanted", manager.getPlannedBytes(), full * 3);
+
+		manager.setBudget(full * 2 + full / 2);
+		manager.update();
+		ensure_equals("low priority goes first", manager.getDiscardLimit(low), 1);
+		ensure_equals("high priority kept", manager.getDiscardLimit(high), 0);
+		ensure_equals("pinned kept", manager.getDiscardLimit(pinned), 0);
+		ensure("within budget", manager.getPlannedBytes() <= manager.getBudget());
+		ensure_equals("one limit changed", manager.getChangedTextures().size(), (size_t)1);
+		ensure_equals("changed texture", manager.getChangedTextures()[0], low);
+
+		manager.setBudget(full + full / 4);
+		manager.update();
+		ensure_equals("pinned still kept", manager.getDiscardLimit(pinned), 0);
+		ensure("both limited", manager.getDiscardLimit(low) > 0 && manager.getDiscardLimit(high) > 0);
+		ensure("high priority at least as fine", manager.getDiscardLimit(high) <= manager.getDiscardLimit(low));
+		ensure_equals("two limited", manager.getNumLimited(), 2);
+		ensure("within budget", manager.getPlannedBytes() <= manager.getBudget());
+
+		// Not wanted anymore: frees its share for the others
+		manager.setWanted(low, MAX_DISCARD + 1, MAX_DISCARD, 10.f, FALSE);
+		manager.setBudget(full * 2);
+		manager.update();
+		ensure_equals("high back to full resolution", manager.getDiscardLimit(high), 0);
+
+		// Over budget resident textures aim below the budget
+		manager.setResident(high, 0);
+		manager.setResident(pinned, 0);
+		manager.setResident(low, 0);
+		manager.update();
+		ensure("under low water", manager.getPlannedBytes() < manager.getBudget());
+	}
+
+	// A recorded trace replays to the same discard limits
+	template<> template<>
+	void textureresidency_object_t::test<3>()
+	{
+		std::ostringstream trace;
+		LLTextureResidencyManager recorder;
+		recorder.setTraceStream(&trace);
+		LLTextureResidencyManager replayer;
+		std::vector<LLTextureResidencyManager::handle_t> handles;
+		for (S32 i = 0; i < 64; i++)
+		{
+			handles.push_back(recorder.addTexture(256, 128, 3, TRUE));
+			recorder.setWanted(handles[i], i % 3, MAX_DISCARD, (F32)(i * 37 % 101), i % 7 == 0);
+			recorder.setResident(handles[i], i % 4);
+		}
+		recorder.removeTexture(handles[5]);
+		recorder.setBudget(64 * LLTextureResidencyManager::calcBytes(256, 128, 3, TRUE, 2));
+		recorder.update();
+
+		std::istringstream input(trace.str());
+		ensure_equals("one update replayed", replayer.replayTrace(input), 1);
+		ensure_equals("same resident bytes", replayer.getResidentBytes(), recorder.getResidentBytes());
+		ensure_equals("same planned bytes", replayer.getPlannedBytes(), recorder.getPlannedBytes());
+		ensure_equals("same number limited", replayer.getNumLimited(), recorder.getNumLimited());
+
+		std::istringstream garbage("add 1 2 3\nfoo 2\n");
+		LLTextureResidencyManager other;
+		ensure_equals("malformed trace", other.replayTrace(garbage), -1);
+	}
+
+	// Replay benchmark. Replays the trace named by LL_TEXTURE_RESIDENCY_TRACE
+	// (written by the viewer with TextureResidencyTrace set) or a generated one.
+	template<> template<>
+	void textureresidency_object_t::test<4>()
+	{
+		std::stringstream trace;
+		const char* filename = getenv("LL_TEXTURE_RESIDENCY_TRACE");	/* Flawfinder: ignore */
+		if (filename)
+		{
+			llifstream file(filename);
+			ensure("trace file opened", file.is_open());
+			trace << file.rdbuf();
+		}
+		else
+		{
+			// 2 GB card: about 1.5 GB for textures, not enough for everything at full resolution
+			record_session(trace, 8000, 300, 1536LL << 20);
+		}
+
+		LLTextureResidencyManager manager;
+		LLTimer timer;
+		S32 updates = manager.replayTrace(trace);
+		F64 elapsed = timer.getElapsedTimeF64();
+		ensure("trace replayed", updates > 0);
+
+		std::cout << "LLTextureResidencyManager: " << updates << " updates, " << manager.getNumTextures() << " textures, "
+				  << (elapsed * 1000.0 / updates) << " ms per frame (trace parsing included), "
+				  << (manager.getPlannedBytes() >> 20) << "/" << (manager.getBudget() >> 20) << " MB planned, "
+				  << (manager.getWantedBytes() >> 20) << " MB wanted, "
+				  << manager.getNumLimited() << " textures limited" << std::endl;
+		ensure("last frame within budget", manager.getBudget() <= 0 || manager.getPlannedBytes() <= manager.getBudget());
+	}
+}
@@ -0,0 +1,382 @@
+/**
+ * @file llvocache_test.cpp
+ * @brief Tests of the region object cache file, LLVOCacheFile
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llvocache.h"
+// Dependencies
+#include "llfile.h"
+#include "../llviewercontrol.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+LLControlGroup::LLControlGroup(const std::string& name)
+	: LLInstanceTracker<LLControlGroup, std::string>(name) {}
+LLControlGroup::~LLControlGroup() {}
+BOOL LLControlGroup::getBOOL(const std::string& name) { return FALSE; }
+LLControlGroup gSavedSettings("Global");
+
+namespace
+{
+	const char* TEST_CACHE_FILENAME = "llvocache_test.slm";
+	const char* TEST_LEGACY_FILENAME = "llvocache_test.slc";
+
+	// The on-disk format, as written by LLVOCacheFile
+	const U32 REGION_CACHE_MAGIC = 0x46434f56; // "VOCF"
+	const U32 REGION_CACHE_VERSION = 1;
+	const U32 REGION_CACHE_MIN_SLOTS = 1024;
+
+	struct TestHeader
+	{
+		U32 mMagic;
+		U32 mVersion;
+		LLUUID mRegionID;
+		U32 mNumSlots;
+		U32 mNumEntries;
+		U32 mDataEnd;
+		U32 mDeadSize;
+		U32 mClean;
+		U32 mPad;
+	};
+
+	struct TestSlot
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		U32 mOffset;
+		U32 mSize;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mChecksum;
+	};
+
+	const U32 RECORDS_START = sizeof(TestHeader) + REGION_CACHE_MIN_SLOTS * sizeof(TestSlot);
+
+	// The object update of local_id, different for each crc
+	void make_update(U32 local_id, U32 crc, S32 size, std::vector<U8>& data)
+	{
+		data.resize(size);
+		for (S32 i = 0; i < size; i++)
+		{
+			data[i] = (U8)(local_id * 31 + crc * 7 + i);
+		}
+	}
+
+	LLVOCacheEntry* make_entry(U32 local_id, U32 crc, S32 size)
+	{
+		std::vector<U8> data;
+		make_update(local_id, crc, size, data);
+		LLDataPackerBinaryBuffer dp(&data[0], size);
+		return new LLVOCacheEntry(local_id, crc, dp);
+	}
+
+	bool read_file(const std::string& filename, std::vector<U8>& data)
+	{
+		data.clear();
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (!fp)
+		{
+			return false;
+		}
+		U8 buffer[4096];
+		size_t bytes;
+		while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		{
+			data.insert(data.end(), buffer, buffer + bytes);
+		}
+		fclose(fp);
+		return true;
+	}
+
+	bool write_file(const std::string& filename, const std::vector<U8>& data)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "wb");
+		if (!fp)
+		{
+			return false;
+		}
+		bool success = fwrite(&data[0], 1, data.size(), fp) == data.size();
+		fclose(fp);
+		return success;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct vocache_test
+	{
+		LLUUID mRegionID;
+
+		vocache_test()
+		{
+			mRegionID.generate();
+			removeFiles();
+		}
+		~vocache_test()
+		{
+			removeFiles();
+		}
+
+		void removeFiles()
+		{
+			LLFile::remove(TEST_CACHE_FILENAME);
+			LLFile::remove(std::string(TEST_CACHE_FILENAME) + ".tmp");
+			LLFile::remove(TEST_LEGACY_FILENAME);
+		}
+
+		// Checks that the entry of local_id holds the update for crc
+		void ensureEntry(const LLVOCacheFile& cache_file, U32 local_id, U32 crc, S32 size)
+		{
+			std::string name = llformat("entry %d", local_id);
+			U32 cached_crc = 0;
+			ensure(name + " found", cache_file.getCRC(local_id, cached_crc));
+			ensure_equals(name + " crc", cached_crc, crc);
+
+			LLVOCacheEntry* entry = cache_file.readEntry(local_id);
+			ensure(name + " read", entry != NULL);
+			std::vector<U8> data;
+			make_update(local_id, crc, size, data);
+			LLDataPackerBinaryBuffer* dp = entry->getDP(crc);
+			ensure(name + " data", dp != NULL);
+			ensure_equals(name + " size", dp->getBufferSize(), size);
+			std::vector<U8> cached(size);
+			dp->unpackBinaryDataFixed(&cached[0], size, "data");
+			ensure(name + " data intact", cached == data);
+			delete entry;
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<vocache_test> vocache_t;
+	typedef vocache_t::object vocache_object_t;
+	tut::vocache_t tut_vocache("LLVOCacheFile");
+
+	// Entries and counters survive closing the file, and the file is laid
+	// out as documented in llvocache.h
+	template<> template<>
+	void vocache_object_t::test<1>()
+	{
+		const U32 COUNT = 3000; // grows the table twice
+		{
+			LLVOCacheFile cache_file;
+			ensure("created", cache_file.open(TEST_CACHE_FILENAME, mRegionID, false));
+			ensure_equals("empty", cache_file.getNumEntries(), (U32)0);
+			for (U32 local_id = 1; local_id <= COUNT; local_id++)
+			{
+				LLVOCacheEntry* entry = make_entry(local_id, local_id + 100, 50 + local_id % 200);
+				ensure("written", cache_file.writeEntry(*entry));
+				entry->recordHit();
+				entry->recordDupe();
+				cache_file.updateCounts(*entry);
+				delete entry;
+			}
+			ensure_equals("all entries", cache_file.getNumEntries(), COUNT);
+		}
+
+		std::vector<U8> data;
+		ensure("file read", read_file(TEST_CACHE_FILENAME, data));
+		ensure("header", data.size() >= sizeof(TestHeader));
+		const TestHeader* header = (const TestHeader*)&data[0];
+		ensure_equals("magic", header->mMagic, REGION_CACHE_MAGIC);
+		ensure_equals("version", header->mVersion, REGION_CACHE_VERSION);
+		ensure("region id", header->mRegionID == mRegionID);
+		ensure_equals("slots grown", header->mNumSlots, REGION_CACHE_MIN_SLOTS * 4);
+		ensure_equals("entries", header->mNumEntries, COUNT);
+		ensure_equals("closed", header->mClean, (U32)1);
+		ensure_equals("reserved room dropped", (U32)data.size(), header->mDataEnd);
+
+		LLVOCacheFile cache_file;
+		ensure("opened read only", cache_file.open(TEST_CACHE_FILENAME, mRegionID, true));
+		ensure_equals("all entries back", cache_file.getNumEntries(), COUNT);
+		for (U32 local_id = 1; local_id <= COUNT; local_id++)
+		{
+			ensureEntry(cache_file, local_id, local_id + 100, 50 + local_id % 200);
+		}
+		LLVOCacheEntry* entry = cache_file.readEntry(COUNT / 2);
+		ensure_equals("hits", entry->getHitCount(), 1);
+		delete entry;
+		U32 crc;
+		ensure("unknown local id", !cache_file.getCRC(COUNT + 1, crc));
+		ensure("no entry for unknown local id", cache_file.readEntry(COUNT + 1) == NULL);
+		entry = make_entry(1, 1, 10);
+		ensure("read only", !cache_file.writeEntry(*entry));
+		delete entry;
+		cache_file.close();
+
+		LLUUID other_id;
+		other_id.generate();
+		ensure("opened for another region", cache_file.open(TEST_CACHE_FILENAME, other_id, false));
+		ensure_equals("emptied for another region", cache_file.getNumEntries(), (U32)0);
+	}
+
+	// Replaced records are dropped by compaction, through a temporary file
+	template<> template<>
+	void vocache_object_t::test<2>()
+	{
+		const U32 COUNT = 200;
+		const S32 SIZE = 1000;
+		LLVOCacheFile cache_file;
+		ensure("created", cache_file.open(TEST_CACHE_FILENAME, mRegionID, false));
+		for (U32 crc = 1; crc <= 4; crc++)
+		{
+			for (U32 local_id = 1; local_id <= COUNT; local_id++)
+			{
+				LLVOCacheEntry* entry = make_entry(local_id, crc, SIZE);
+				ensure("written", cache_file.writeEntry(*entry));
+				delete entry;
+			}
+		}
+		ensure_equals("replaced in place", cache_file.getNumEntries(), COUNT);
+		ensure("compacted", cache_file.compact());
+		ensure("nothing left to compact", !cache_file.compact());
+		ensure("no temporary file left", !LLFile::isfile(std::string(TEST_CACHE_FILENAME) + ".tmp"));
+		for (U32 local_id = 1; local_id <= COUNT; local_id++)
+		{
+			ensureEntry(cache_file, local_id, 4, SIZE);
+		}
+		cache_file.close();
+
+		std::vector<U8> data;
+		ensure("file read", read_file(TEST_CACHE_FILENAME, data));
+		ensure_equals("only the live records", (U32)data.size(), RECORDS_START + COUNT * SIZE);
+		ensure_equals("no dead records", ((const TestHeader*)&data[0])->mDeadSize, (U32)0);
+	}
+
+	// A file left open by a crash is repaired, torn records are dropped
+	template<> template<>
+	void vocache_object_t::test<3>()
+	{
+		const U32 COUNT = 100;
+		const S32 SIZE = 100;
+		std::vector<U8> data;
+		{
+			LLVOCacheFile cache_file;
+			ensure("created", cache_file.open(TEST_CACHE_FILENAME, mRegionID, false));
+			for (U32 local_id = 1; local_id <= COUNT; local_id++)
+			{
+				LLVOCacheEntry* entry = make_entry(local_id, 1, SIZE);
+				ensure("written", cache_file.writeEntry(*entry));
+				delete entry;
+			}
+			// What is on disk when the viewer crashes now
+			ensure("file read", read_file(TEST_CACHE_FILENAME, data));
+		}
+		ensure_equals("not closed", ((const TestHeader*)&data[0])->mClean, (U32)0);
+		// Tear the record of the first entry
+		data[RECORDS_START + SIZE / 2] ^= 0xff;
+		ensure("file written", write_file(TEST_CACHE_FILENAME, data));
+
+		LLVOCacheFile cache_file;
+		ensure("not opened read only", !cache_file.open(TEST_CACHE_FILENAME, mRegionID, true));
+		ensure("repaired", cache_file.open(TEST_CACHE_FILENAME, mRegionID, false));
+		ensure_equals("torn entry dropped", cache_file.getNumEntries(), COUNT - 1);
+		U32 crc;
+		ensure("no torn entry", !cache_file.getCRC(1, crc));
+		for (U32 local_id = 2; local_id <= COUNT; local_id++)
+		{
+			ensureEntry(cache_file, local_id, 1, SIZE);
+		}
+	}
+
+	// A table without free slots is not searched
+	template<> template<>
+	void vocache_object_t::test<4>()
+	{
+		std::vector<U8> data(RECORDS_START);
+		TestHeader* header = (TestHeader*)&data[0];
+		header->mMagic = REGION_CACHE_MAGIC;
+		header->mVersion = REGION_CACHE_VERSION;
+		header->mRegionID = mRegionID;
+		header->mNumSlots = REGION_CACHE_MIN_SLOTS;
+		header->mNumEntries = REGION_CACHE_MIN_SLOTS;
+		header->mDataEnd = RECORDS_START;
+		header->mClean = 1;
+		TestSlot* slots = (TestSlot*)&data[sizeof(TestHeader)];
+		for (U32 i = 0; i < REGION_CACHE_MIN_SLOTS; i++)
+		{
+			slots[i].mLocalID = i + 1;
+		}
+		ensure("file written", write_file(TEST_CACHE_FILENAME, data));
+
+		LLVOCacheFile cache_file;
+		ensure("not opened read only", !cache_file.open(TEST_CACHE_FILENAME, mRegionID, true));
+		ensure("rebuilt", cache_file.open(TEST_CACHE_FILENAME, mRegionID, false));
+		ensure_equals("slots without records dropped", cache_file.getNumEntries(), (U32)0);
+		U32 crc;
+		ensure("lookup ends", !cache_file.getCRC(REGION_CACHE_MIN_SLOTS * 2, crc));
+		LLVOCacheEntry* entry = make_entry(5, 1, 10);
+		ensure("written", cache_file.writeEntry(*entry));
+		delete entry;
+		ensureEntry(cache_file, 5, 1, 10);
+	}
+
+	// The cache files of the previous format are converted
+	template<> template<>
+	void vocache_object_t::test<5>()
+	{
+		const S32 COUNT = 50;
+		{
+			LLAPRFile apr_file(TEST_LEGACY_FILENAME, APR_CREATE|APR_WRITE|APR_BINARY);
+			ensure_equals("id written", apr_file.write(mRegionID.mData, UUID_BYTES), UUID_BYTES);
+			S32 num_entries = COUNT;
+			ensure_equals("count written", apr_file.write(&num_entries, sizeof(S32)), (S32)sizeof(S32));
+			for (S32 local_id = 1; local_id <= COUNT; local_id++)
+			{
+				LLVOCacheEntry* entry = make_entry(local_id, 7, 20 + local_id);
+				ensure("entry written", entry->writeToFile(&apr_file));
+				delete entry;
+			}
+		}
+
+		LLVOCacheFile cache_file;
+		ensure("created", cache_file.open(TEST_CACHE_FILENAME, mRegionID, false));
+		LLUUID other_id;
+		other_id.generate();
+		ensure_equals("other region not imported", cache_file.importLegacyFile(TEST_LEGACY_FILENAME, other_id), -1);
+		ensure_equals("missing file not imported", cache_file.importLegacyFile("llvocache_test_missing.slc", mRegionID), -1);
+		ensure_equals("imported", cache_file.importLegacyFile(TEST_LEGACY_FILENAME, mRegionID), COUNT);
+		ensure_equals("all entries", cache_file.getNumEntries(), (U32)COUNT);
+		for (S32 local_id = 1; local_id <= COUNT; local_id++)
+		{
+			ensureEntry(cache_file, local_id, 7, 20 + local_id);
+		}
+	}
+}
@@ -35,6 +35,7 @@
 #include "lltemplatemessagebuilder.h"
 #include "lltemplatemessagereader.h"
 #include "llversionserver.h"
+#include "message.h"
 #include "message_prehash.h"
 #include "u64.h"
 #include "v3dmath.h"
@@ -966,5 +967,48 @@ namespace tut
 		ensure_equals("Ensure unchanged buffer ", strlen(outBuffer), 0);
 		delete reader;
 	}
+
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<46>()
+		// read repeated blocks by field
+	{
+		LLMessageTemplate messageTemplate = defaultTemplate();
+		LLMessageBlock* block = defaultBlock(MVT_U32, 4);
+		block->addVariable(_PREHASH_Test1, MVT_F32, 4);
+		messageTemplate.addBlock(block);
+		LLTemplateMessageBuilder* builder = defaultBuilder(messageTemplate);
+		for (U32 i = 0; i < 3; i++)
+		{
+			if (i)
+			{
+				builder->nextBlock(_PREHASH_Test0);
+			}
+			builder->addU32(_PREHASH_Test0, 0xbbbbbbbb + i);
+			builder->addF32(_PREHASH_Test1, 1.5f * i);
+		}
+		LLTemplateMessageReader* reader = setReader(messageTemplate, builder);
+
+		LLMessageField u32_field(_PREHASH_Test0, _PREHASH_Test0);
+		LLMessageField f32_field(_PREHASH_Test0, _PREHASH_Test1);
+		LLMessageField missing_field(_PREHASH_Test1, _PREHASH_Test0);
+		ensure_equals("Ensure number of blocks", reader->getNumberOfBlocks(_PREHASH_Test0), 3);
+		for (S32 i = 0; i < 3; i++)
+		{
+			U32 outU32, nameU32;
+			F32 outF32;
+			reader->getU32(u32_field, outU32, i);
+			reader->getU32(_PREHASH_Test0, _PREHASH_Test0, nameU32, i);
+			reader->getF32(f32_field, outF32, i);
+			ensure_equals("Ensure U32", outU32, 0xbbbbbbbb + i);
+			ensure_equals("Ensure U32 by name", nameU32, outU32);
+			ensure_equals("Ensure F32", outF32, 1.5f * i);
+			ensure_equals("Ensure size", reader->getSize(u32_field, i), 4);
+		}
+		ensure_equals("Ensure missing block", reader->getSize(missing_field, 0), 
+					  LL_BLOCK_NOT_IN_MESSAGE);
+		ensure_equals("Ensure missing repeat", reader->getSize(u32_field, 3), 
+					  LL_BLOCK_NOT_IN_MESSAGE);
+		delete reader;
+	}
 }
 
@@ -0,0 +1,59 @@
+/**
+ * @file lltestrand.h
+ * @brief Repeatable pseudo random numbers for tests and benchmarks
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTESTRAND_H
+#define LL_LLTESTRAND_H
+
+// The same sequence for a seed on every platform and C library, unlike
+// rand(), so that failures and benchmark inputs can be reproduced.
+class LLTestRand
+{
+public:
+	LLTestRand(U32 seed = 1) : mSeed(seed) {}
+
+	void seed(U32 seed) { mSeed = seed; }
+
+	// 24 random bits
+	U32 next()
+	{
+		mSeed = mSeed * 1103515245 + 12345;
+		return mSeed >> 8;
+	}
+
+	// [0, range)
+	U32 rand(U32 range) { return next() % range; }
+
+	// [low, high]
+	F32 frand(F32 low, F32 high)
+	{
+		return low + (high - low) * (F32)(next() & 0xffff) / 65535.f;
+	}
+
+private:
+	U32 mSeed;
+};
+
+#endif // LL_LLTESTRAND_H
@@ -0,0 +1,63 @@
+/**
+ * @file lltestvolumeparams.h
+ * @brief Random prim shapes for volume tests and benchmarks
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTESTVOLUMEPARAMS_H
+#define LL_LLTESTVOLUMEPARAMS_H
+
+#include "llvolume.h"
+#include "lltestrand.h"
+
+// The kinds of shapes people build from the viewer's tool floater
+inline LLVolumeParams ll_random_volume_params(LLTestRand& rand)
+{
+	static const U8 holes[] = { LL_PCODE_HOLE_SAME, LL_PCODE_HOLE_CIRCLE, LL_PCODE_HOLE_SQUARE, LL_PCODE_HOLE_TRIANGLE };
+	static const U8 paths[] = { LL_PCODE_PATH_LINE, LL_PCODE_PATH_CIRCLE, LL_PCODE_PATH_CIRCLE2 };
+
+	LLVolumeParams params;
+	U8 profile = (U8)rand.rand(LL_PCODE_PROFILE_MAX + 1) | holes[rand.rand(4)];
+	U8 path = paths[rand.rand(3)];
+	params.setType(profile, path);
+	F32 begin = rand.rand(2) ? rand.frand(0.f, 0.4f) : 0.f;
+	params.setBeginAndEndS(begin, rand.rand(2) ? rand.frand(begin + 0.1f, 1.f) : 1.f);
+	begin = rand.rand(2) ? rand.frand(0.f, 0.4f) : 0.f;
+	params.setBeginAndEndT(begin, rand.rand(2) ? rand.frand(begin + 0.1f, 1.f) : 1.f);
+	params.setHollow(rand.rand(2) ? rand.frand(0.f, 0.9f) : 0.f);
+	params.setTwistBegin(rand.rand(4) ? 0.f : rand.frand(-1.f, 1.f));
+	params.setTwistEnd(rand.rand(2) ? 0.f : rand.frand(-1.f, 1.f));
+	if (path == LL_PCODE_PATH_LINE)
+	{
+		params.setRatio(rand.frand(0.f, 2.f), rand.frand(0.f, 2.f));
+		params.setShear(rand.frand(-0.5f, 0.5f), rand.frand(-0.5f, 0.5f));
+	}
+	else
+	{
+		params.setRatio(1.f, rand.frand(0.05f, 0.5f));
+		params.setRevolutions(rand.rand(4) ? 1.f : rand.frand(1.f, 4.f));
+	}
+	return params;
+}
+
+#endif // LL_LLTESTVOLUMEPARAMS_H